@@ -912,6 +912,8 @@ struct aes_gcm_key_avx10 {
 #define FLAG_RFC4106	BIT(0)
 #define FLAG_ENC	BIT(1)
 #define FLAG_AVX	BIT(2)
+/* Called by gcm_crypt_batch(): the FPU is already held, the walk is atomic */
+#define FLAG_BATCH	BIT(5)
 #if defined(CONFIG_AS_VAES) && defined(CONFIG_AS_VPCLMULQDQ)
 #  define FLAG_AVX10_256	BIT(3)
 #  define FLAG_AVX10_512	BIT(4)
@@ -1363,9 +1365,9 @@ gcm_crypt(struct aead_request *req, int flags)
 
 	/* Begin walking through the plaintext or ciphertext. */
 	if (flags & FLAG_ENC)
-		err = skcipher_walk_aead_encrypt(&walk, req, false);
+		err = skcipher_walk_aead_encrypt(&walk, req, flags & FLAG_BATCH);
 	else
-		err = skcipher_walk_aead_decrypt(&walk, req, false);
+		err = skcipher_walk_aead_decrypt(&walk, req, flags & FLAG_BATCH);
 	if (err)
 		return err;
 
@@ -1376,8 +1378,10 @@ gcm_crypt(struct aead_request *req, int flags)
 	 * three calls in the same kernel FPU section if possible.  We close the
 	 * section and start a new one if there are multiple data segments or if
 	 * rescheduling is needed while processing the associated data.
+	 * In a batch, the caller keeps one section open for all requests.
 	 */
-	kernel_fpu_begin();
+	if (!(flags & FLAG_BATCH))
+		kernel_fpu_begin();
 
 	/* Pass the associated data through GHASH. */
 	gcm_process_assoc(key, ghash_acc, req->src, assoclen, flags);
@@ -1395,11 +1399,13 @@ gcm_crypt(struct aead_request *req, int flags)
 		aes_gcm_update(key, le_ctr, ghash_acc, walk.src.virt.addr,
 			       walk.dst.virt.addr, nbytes, flags);
 		le_ctr[0] += nbytes / AES_BLOCK_SIZE;
-		kernel_fpu_end();
+		if (!(flags & FLAG_BATCH))
+			kernel_fpu_end();
 		err = skcipher_walk_done(&walk, walk.nbytes - nbytes);
 		if (err)
 			return err;
-		kernel_fpu_begin();
+		if (!(flags & FLAG_BATCH))
+			kernel_fpu_begin();
 	}
 	/* Last segment: process all remaining data. */
 	aes_gcm_update(key, le_ctr, ghash_acc, walk.src.virt.addr,
@@ -1435,12 +1441,52 @@ gcm_crypt(struct aead_request *req, int flags)
 				       datalen, tag, taglen, flags))
 			err = -EBADMSG;
 	}
-	kernel_fpu_end();
+	if (!(flags & FLAG_BATCH))
+		kernel_fpu_end();
 	if (nbytes)
 		skcipher_walk_done(&walk, 0);
 	return err;
 }
 
+/*
+ * Bytes of associated data and text a batch processes in one kernel FPU
+ * section, to bound the time with preemption disabled.
+ */
+#define GCM_BATCH_FPU_BYTES	4096
+
+/*
+ * Process several small requests in one kernel FPU section.  The walks are
+ * atomic so that nothing sleeps inside the section.  The section is ended
+ * after GCM_BATCH_FPU_BYTES or when a reschedule is pending, and requests
+ * larger than that are processed on their own as by gcm_crypt().
+ */
+static __always_inline void
+gcm_crypt_batch(struct aead_request **reqs, int *errs, unsigned int n,
+		int flags)
+{
+	unsigned int i, len, bytes = 0;
+
+	kernel_fpu_begin();
+	for (i = 0; i < n; i++) {
+		len = reqs[i]->assoclen + reqs[i]->cryptlen;
+		if (len > GCM_BATCH_FPU_BYTES) {
+			kernel_fpu_end();
+			errs[i] = gcm_crypt(reqs[i], flags);
+			kernel_fpu_begin();
+			bytes = 0;
+			continue;
+		}
+		if (bytes + len > GCM_BATCH_FPU_BYTES || need_resched()) {
+			kernel_fpu_end();
+			kernel_fpu_begin();
+			bytes = 0;
+		}
+		errs[i] = gcm_crypt(reqs[i], flags | FLAG_BATCH);
+		bytes += len;
+	}
+	kernel_fpu_end();
+}
+
 #define DEFINE_GCM_ALGS(suffix, flags, generic_driver_name, rfc_driver_name,   \
 			ctxsize, priority)				       \
 									       \
@@ -1460,6 +1506,18 @@ static int gcm_decrypt_##suffix(struct aead_request *req)		       \
 	return gcm_crypt(req, (flags));					       \
 }									       \
 									       \
+static void gcm_encrypt_batch_##suffix(struct aead_request **reqs,	       \
+				       int *errs, unsigned int n)	       \
+{									       \
+	gcm_crypt_batch(reqs, errs, n, (flags) | FLAG_ENC);		       \
+}									       \
+									       \
+static void gcm_decrypt_batch_##suffix(struct aead_request **reqs,	       \
+				       int *errs, unsigned int n)	       \
+{									       \
+	gcm_crypt_batch(reqs, errs, n, (flags));			       \
+}									       \
+									       \
 static int rfc4106_setkey_##suffix(struct crypto_aead *tfm, const u8 *raw_key, \
 				   unsigned int keylen)			       \
 {									       \
@@ -1476,11 +1534,25 @@ static int rfc4106_decrypt_##suffix(struct aead_request *req)		       \
 	return gcm_crypt(req, (flags) | FLAG_RFC4106);			       \
 }									       \
 									       \
+static void rfc4106_encrypt_batch_##suffix(struct aead_request **reqs,	       \
+					   int *errs, unsigned int n)	       \
+{									       \
+	gcm_crypt_batch(reqs, errs, n, (flags) | FLAG_RFC4106 | FLAG_ENC);     \
+}									       \
+									       \
+static void rfc4106_decrypt_batch_##suffix(struct aead_request **reqs,	       \
+					   int *errs, unsigned int n)	       \
+{									       \
+	gcm_crypt_batch(reqs, errs, n, (flags) | FLAG_RFC4106);		       \
+}									       \
+									       \
 static struct aead_alg aes_gcm_algs_##suffix[] = { {			       \
 	.setkey			= gcm_setkey_##suffix,			       \
 	.setauthsize		= generic_gcmaes_set_authsize,		       \
 	.encrypt		= gcm_encrypt_##suffix,			       \
 	.decrypt		= gcm_decrypt_##suffix,			       \
+	.encrypt_batch		= gcm_encrypt_batch_##suffix,		       \
+	.decrypt_batch		= gcm_decrypt_batch_##suffix,		       \
 	.ivsize			= GCM_AES_IV_SIZE,			       \
 	.chunksize		= AES_BLOCK_SIZE,			       \
 	.maxauthsize		= 16,					       \
@@ -1498,6 +1570,8 @@ static struct aead_alg aes_gcm_algs_##suffix[] = { {			       \
 	.setauthsize		= common_rfc4106_set_authsize,		       \
 	.encrypt		= rfc4106_encrypt_##suffix,		       \
 	.decrypt		= rfc4106_decrypt_##suffix,		       \
+	.encrypt_batch		= rfc4106_encrypt_batch_##suffix,	       \
+	.decrypt_batch		= rfc4106_decrypt_batch_##suffix,	       \
 	.ivsize			= GCM_RFC4106_IV_SIZE,			       \
 	.chunksize		= AES_BLOCK_SIZE,			       \
 	.maxauthsize		= 16,					       \
@@ -357,14 +357,94 @@ static int sha256_ni_digest(struct shash_desc *desc, const u8 *data,
 	       sha256_ni_finup(desc, data, len, out);
 }
 
+asmlinkage void sha256_ni_transform_2x(u32 *digest_a, u32 *digest_b,
+				       const u8 *data_a, const u8 *data_b,
+				       int blocks);
+
+/*
+ * Finish two messages of the same length, both continuing from the state in
+ * @desc, with their blocks compressed together by sha256_ni_transform_2x().
+ */
+static int sha256_ni_finup_mb(struct shash_desc *desc,
+			      const u8 * const data[], unsigned int len,
+			      u8 * const outs[], unsigned int num_msgs)
+{
+	const struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->count % SHA256_BLOCK_SIZE;
+	unsigned int i, n, off = 0, buffered = 0, blocks;
+	u8 final[2][2 * SHA256_BLOCK_SIZE];
+	u32 state[2][SHA256_DIGEST_SIZE / 4];
+	u64 bits = (sctx->count + len) << 3;
+
+	if (num_msgs != 2 || !crypto_simd_usable())
+		return -EOPNOTSUPP;
+
+	for (i = 0; i < 2; i++)
+		memcpy(state[i], sctx->state, sizeof(state[i]));
+
+	kernel_fpu_begin();
+
+	/* Complete the block buffered in @desc, e.g. a salt */
+	if (partial) {
+		n = min(len, SHA256_BLOCK_SIZE - partial);
+		for (i = 0; i < 2; i++) {
+			memcpy(final[i], sctx->buf, partial);
+			memcpy(final[i] + partial, data[i], n);
+		}
+		off = n;
+		buffered = partial + n;
+		if (buffered == SHA256_BLOCK_SIZE) {
+			sha256_ni_transform_2x(state[0], state[1],
+					       final[0], final[1], 1);
+			buffered = 0;
+		}
+	}
+
+	/* Otherwise all of the data was buffered */
+	if (!buffered) {
+		blocks = (len - off) / SHA256_BLOCK_SIZE;
+		if (blocks)
+			sha256_ni_transform_2x(state[0], state[1],
+					       data[0] + off, data[1] + off,
+					       blocks);
+		off += blocks * SHA256_BLOCK_SIZE;
+		buffered = len - off;
+		for (i = 0; i < 2; i++)
+			memcpy(final[i], data[i] + off, buffered);
+	}
+
+	/* Pad, which takes a second block if the length doesn't fit */
+	blocks = buffered < SHA256_BLOCK_SIZE - sizeof(bits) ? 1 : 2;
+	for (i = 0; i < 2; i++) {
+		final[i][buffered] = 0x80;
+		memset(final[i] + buffered + 1, 0,
+		       blocks * SHA256_BLOCK_SIZE - sizeof(bits) - buffered - 1);
+		put_unaligned_be64(bits, final[i] + blocks * SHA256_BLOCK_SIZE -
+				   sizeof(bits));
+	}
+	sha256_ni_transform_2x(state[0], state[1], final[0], final[1], blocks);
+
+	kernel_fpu_end();
+
+	for (i = 0; i < 2; i++)
+		for (n = 0; n < SHA256_DIGEST_SIZE / 4; n++)
+			put_unaligned_be32(state[i][n], outs[i] + n * 4);
+
+	memzero_explicit(final, sizeof(final));
+	memzero_explicit(state, sizeof(state));
+	return 0;
+}
+
 static struct shash_alg sha256_ni_algs[] = { {
 	.digestsize	=	SHA256_DIGEST_SIZE,
 	.init		=	sha256_base_init,
 	.update		=	sha256_ni_update,
 	.final		=	sha256_ni_final,
 	.finup		=	sha256_ni_finup,
+	.finup_mb	=	sha256_ni_finup_mb,
 	.digest		=	sha256_ni_digest,
 	.descsize	=	sizeof(struct sha256_state),
+	.mb_max_msgs	=	2,
 	.base		=	{
 		.cra_name	=	"sha256",
 		.cra_driver_name =	"sha256-ni",
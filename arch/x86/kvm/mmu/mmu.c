@@ -6652,11 +6652,8 @@ void kvm_mmu_slot_remove_write_access(struct kvm *kvm,
 		write_unlock(&kvm->mmu_lock);
 	}
 
-	if (tdp_mmu_enabled) {
-		read_lock(&kvm->mmu_lock);
+	if (tdp_mmu_enabled)
 		kvm_tdp_mmu_wrprot_slot(kvm, memslot, start_level);
-		read_unlock(&kvm->mmu_lock);
-	}
 }
 
 static inline bool need_topup(struct kvm_mmu_memory_cache *cache, int min)
@@ -7018,11 +7015,8 @@ void kvm_mmu_slot_leaf_clear_dirty(struct kvm *kvm,
 		write_unlock(&kvm->mmu_lock);
 	}
 
-	if (tdp_mmu_enabled) {
-		read_lock(&kvm->mmu_lock);
+	if (tdp_mmu_enabled)
 		kvm_tdp_mmu_clear_dirty_slot(kvm, memslot);
-		read_unlock(&kvm->mmu_lock);
-	}
 
 	/*
 	 * The caller will flush the TLBs after this function returns.
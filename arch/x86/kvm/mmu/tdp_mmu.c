@@ -8,6 +8,7 @@
 #include "tdp_mmu.h"
 #include "spte.h"
 
+#include <linux/padata.h>
 #include <asm/cmpxchg.h>
 #include <trace/events/kvm.h>
 
@@ -1318,24 +1319,85 @@ static bool wrprot_gfn_range(struct kvm *kvm, struct kvm_mmu_page *root,
 	return spte_set;
 }
 
+/*
+ * Write-protecting or clearing the dirty state of a whole memslot only needs
+ * mmu_lock for read, so large slots are split by GFN across padata helpers.
+ * Chunks are aligned to 1GiB so that no two helpers walk the same upper
+ * level page tables, and slots smaller than two chunks are done serially.
+ */
+#define TDP_MMU_SLOT_MT_CHUNK		KVM_PAGES_PER_HPAGE(PG_LEVEL_1G)
+#define TDP_MMU_SLOT_MT_MAX_THREADS	16
+
+static bool clear_dirty_gfn_range(struct kvm *kvm, struct kvm_mmu_page *root,
+				  gfn_t start, gfn_t end);
+
+struct tdp_mmu_slot_mt {
+	struct kvm *kvm;
+	const struct kvm_memory_slot *slot;
+	int min_level;
+	bool clear_dirty;
+	bool spte_set;
+};
+
+static void tdp_mmu_slot_mt_fn(unsigned long start, unsigned long end,
+			       void *arg)
+{
+	struct tdp_mmu_slot_mt *mt = arg;
+	struct kvm *kvm = mt->kvm;
+	struct kvm_mmu_page *root;
+	bool spte_set = false;
+
+	read_lock(&kvm->mmu_lock);
+	for_each_valid_tdp_mmu_root_yield_safe(kvm, root, mt->slot->as_id) {
+		if (mt->clear_dirty)
+			spte_set |= clear_dirty_gfn_range(kvm, root, start, end);
+		else
+			spte_set |= wrprot_gfn_range(kvm, root, start, end,
+						     mt->min_level);
+	}
+	read_unlock(&kvm->mmu_lock);
+
+	if (spte_set)
+		WRITE_ONCE(mt->spte_set, true);
+}
+
+static bool tdp_mmu_slot_mt(struct tdp_mmu_slot_mt *mt)
+{
+	struct padata_mt_job job = {
+		.thread_fn	= tdp_mmu_slot_mt_fn,
+		.fn_arg		= mt,
+		.start		= mt->slot->base_gfn,
+		.size		= mt->slot->npages,
+		.align		= TDP_MMU_SLOT_MT_CHUNK,
+		.min_chunk	= TDP_MMU_SLOT_MT_CHUNK,
+		.max_threads	= min_t(int, num_online_cpus(),
+					TDP_MMU_SLOT_MT_MAX_THREADS),
+	};
+
+	/* The helpers take mmu_lock, waiting on them with it held can deadlock */
+	lockdep_assert_not_held(&mt->kvm->mmu_lock);
+
+	padata_do_multithreaded(&job);
+	return READ_ONCE(mt->spte_set);
+}
+
 /*
  * Remove write access from all the SPTEs mapping GFNs in the memslot. Will
- * only affect leaf SPTEs down to min_level.
+ * only affect leaf SPTEs down to min_level. Takes mmu_lock for read.
  * Returns true if an SPTE has been changed and the TLBs need to be flushed.
  */
 bool kvm_tdp_mmu_wrprot_slot(struct kvm *kvm,
 			     const struct kvm_memory_slot *slot, int min_level)
 {
-	struct kvm_mmu_page *root;
-	bool spte_set = false;
+	struct tdp_mmu_slot_mt mt = {
+		.kvm		= kvm,
+		.slot		= slot,
+		.min_level	= min_level,
+	};
 
-	lockdep_assert_held_read(&kvm->mmu_lock);
-
-	for_each_valid_tdp_mmu_root_yield_safe(kvm, root, slot->as_id)
-		spte_set |= wrprot_gfn_range(kvm, root, slot->base_gfn,
-			     slot->base_gfn + slot->npages, min_level);
+	BUG_ON(min_level > KVM_MAX_HUGEPAGE_LEVEL);
 
-	return spte_set;
+	return tdp_mmu_slot_mt(&mt);
 }
 
 static struct kvm_mmu_page *tdp_mmu_alloc_sp_for_split(void)
@@ -1505,7 +1567,7 @@ static bool tdp_mmu_need_write_protect(struct kvm_mmu_page *sp)
 }
 
 static bool clear_dirty_gfn_range(struct kvm *kvm, struct kvm_mmu_page *root,
-			   gfn_t start, gfn_t end)
+				  gfn_t start, gfn_t end)
 {
 	const u64 dbit = tdp_mmu_need_write_protect(root) ? PT_WRITABLE_MASK :
 							    shadow_dirty_mask;
@@ -1541,21 +1603,19 @@ static bool clear_dirty_gfn_range(struct kvm *kvm, struct kvm_mmu_page *root,
 
 /*
  * Clear the dirty status (D-bit or W-bit) of all the SPTEs mapping GFNs in the
- * memslot. Returns true if an SPTE has been changed and the TLBs need to be
- * flushed.
+ * memslot. Takes mmu_lock for read. Returns true if an SPTE has been changed
+ * and the TLBs need to be flushed.
  */
 bool kvm_tdp_mmu_clear_dirty_slot(struct kvm *kvm,
 				  const struct kvm_memory_slot *slot)
 {
-	struct kvm_mmu_page *root;
-	bool spte_set = false;
+	struct tdp_mmu_slot_mt mt = {
+		.kvm		= kvm,
+		.slot		= slot,
+		.clear_dirty	= true,
+	};
 
-	lockdep_assert_held_read(&kvm->mmu_lock);
-	for_each_valid_tdp_mmu_root_yield_safe(kvm, root, slot->as_id)
-		spte_set |= clear_dirty_gfn_range(kvm, root, slot->base_gfn,
-				slot->base_gfn + slot->npages);
-
-	return spte_set;
+	return tdp_mmu_slot_mt(&mt);
 }
 
 static void clear_dirty_pt_masked(struct kvm *kvm, struct kvm_mmu_page *root,
@@ -570,12 +570,11 @@ static int emit_jump(u8 **pprog, void *func, void *ip)
 	return emit_patch(pprog, func, ip, 0xE9);
 }
 
-static int __bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
-				void *old_addr, void *new_addr)
+static int bpf_text_poke_insns(void *ip, enum bpf_text_poke_type t,
+			       void *old_addr, void *new_addr,
+			       u8 *old_insn, u8 *new_insn)
 {
 	const u8 *nop_insn = x86_nops[5];
-	u8 old_insn[X86_PATCH_SIZE];
-	u8 new_insn[X86_PATCH_SIZE];
 	u8 *prog;
 	int ret;
 
@@ -598,6 +597,19 @@ static int __bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
 		if (ret)
 			return ret;
 	}
+	return 0;
+}
+
+static int __bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
+				void *old_addr, void *new_addr)
+{
+	u8 old_insn[X86_PATCH_SIZE];
+	u8 new_insn[X86_PATCH_SIZE];
+	int ret;
+
+	ret = bpf_text_poke_insns(ip, t, old_addr, new_addr, old_insn, new_insn);
+	if (ret)
+		return ret;
 
 	ret = -EBUSY;
 	mutex_lock(&text_mutex);
@@ -613,13 +625,12 @@ static int __bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
 	return ret;
 }
 
-int bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
-		       void *old_addr, void *new_addr)
+static void *bpf_text_poke_ip(void *ip)
 {
 	if (!is_kernel_text((long)ip) &&
 	    !is_bpf_text_address((long)ip))
 		/* BPF poking in modules is not supported */
-		return -EINVAL;
+		return NULL;
 
 	/*
 	 * See emit_prologue(), for IBT builds the trampoline hook is preceded
@@ -627,10 +638,60 @@ int bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
 	 */
 	if (is_endbr(*(u32 *)ip))
 		ip += ENDBR_INSN_SIZE;
+	return ip;
+}
+
+int bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
+		       void *old_addr, void *new_addr)
+{
+	ip = bpf_text_poke_ip(ip);
+	if (!ip)
+		return -EINVAL;
 
 	return __bpf_arch_text_poke(ip, t, old_addr, new_addr);
 }
 
+/*
+ * Same as bpf_arch_text_poke() on each of @pokes, but all of them go through
+ * text_poke_queue(), so that patching them costs one round of sync IPIs
+ * rather than one per site. text_poke_queue() flushes the batch early if the
+ * sites are not in ascending order, callers should sort @pokes by ip.
+ */
+void bpf_arch_text_poke_batch(struct bpf_text_poke_desc *pokes, u32 cnt)
+{
+	u8 old_insn[X86_PATCH_SIZE];
+	u8 new_insn[X86_PATCH_SIZE];
+	struct bpf_text_poke_desc *p;
+	void *ip;
+	u32 i;
+
+	mutex_lock(&text_mutex);
+	for (i = 0; i < cnt; i++) {
+		p = &pokes[i];
+		ip = bpf_text_poke_ip(p->ip);
+		if (!ip) {
+			p->ret = -EINVAL;
+			continue;
+		}
+		p->ret = bpf_text_poke_insns(ip, p->t, p->old_addr, p->new_addr,
+					     old_insn, new_insn);
+		if (p->ret)
+			continue;
+		if (memcmp(ip, old_insn, X86_PATCH_SIZE)) {
+			p->ret = -EBUSY;
+			continue;
+		}
+		p->ret = 1;
+		if (memcmp(ip, new_insn, X86_PATCH_SIZE)) {
+			/* the queue keeps its own copy of new_insn */
+			text_poke_queue(ip, new_insn, X86_PATCH_SIZE, NULL);
+			p->ret = 0;
+		}
+	}
+	text_poke_finish();
+	mutex_unlock(&text_mutex);
+}
+
 #define EMIT_LFENCE()	EMIT3(0x0F, 0xAE, 0xE8)
 
 static void emit_indirect_jump(u8 **pprog, int reg, u8 *ip)
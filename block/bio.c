@@ -1259,67 +1259,50 @@ static int bio_iov_add_zone_append_folio(struct bio *bio, struct folio *folio,
 	return 0;
 }
 
-static unsigned int get_contig_folio_len(unsigned int *num_pages,
-					 struct page **pages, unsigned int i,
-					 struct folio *folio, size_t left,
-					 size_t offset)
+/*
+ * Drop the pins on the pages of @f that are not covered by its first @used
+ * bytes, which have been added to @bio.
+ */
+static void bio_release_folio_tail(struct bio *bio,
+				   const struct iov_iter_folio *f, size_t used)
 {
-	size_t bytes = left;
-	size_t contig_sz = min_t(size_t, PAGE_SIZE - offset, bytes);
-	unsigned int j;
-
-	/*
-	 * We might COW a single page in the middle of
-	 * a large folio, so we have to check that all
-	 * pages belong to the same folio.
-	 */
-	bytes -= contig_sz;
-	for (j = i + 1; j < i + *num_pages; j++) {
-		size_t next = min_t(size_t, PAGE_SIZE, bytes);
-
-		if (page_folio(pages[j]) != folio ||
-		    pages[j] != pages[j - 1] + 1) {
-			break;
-		}
-		contig_sz += next;
-		bytes -= next;
-	}
-	*num_pages = j - i;
+	unsigned int nr = iov_iter_folio_nr_pages(f);
 
-	return contig_sz;
+	if (!bio_flagged(bio, BIO_PAGE_PINNED))
+		return;
+	if (used)
+		nr -= (f->offset + used - 1) / PAGE_SIZE - f->offset / PAGE_SIZE + 1;
+	if (nr)
+		unpin_user_folio(f->folio, nr);
 }
 
-#define PAGE_PTRS_PER_BVEC     (sizeof(struct bio_vec) / sizeof(struct page *))
-
 /**
  * __bio_iov_iter_get_pages - pin user or kernel pages and add them to a bio
  * @bio: bio to add pages to
  * @iter: iov iterator describing the region to be mapped
  *
- * Extracts pages from *iter and appends them to @bio's bvec array.  The pages
- * will have to be cleaned up in the way indicated by the BIO_PAGE_PINNED flag.
- * For a multi-segment *iter, this function only adds pages from the next
- * non-empty segment of the iov iterator.
+ * Extracts folio ranges from *iter and appends them to @bio's bvec array.
+ * The pages will have to be cleaned up in the way indicated by the
+ * BIO_PAGE_PINNED flag.  For a multi-segment *iter, this function only adds
+ * pages from the next non-empty segment of the iov iterator.
  */
 static int __bio_iov_iter_get_pages(struct bio *bio, struct iov_iter *iter)
 {
 	iov_iter_extraction_t extraction_flags = 0;
-	unsigned short nr_pages = bio->bi_max_vecs - bio->bi_vcnt;
 	unsigned short entries_left = bio->bi_max_vecs - bio->bi_vcnt;
-	struct bio_vec *bv = bio->bi_io_vec + bio->bi_vcnt;
-	struct page **pages = (struct page **)bv;
+	struct iov_iter_folio *folios;
+	unsigned int nr_folios, i;
 	ssize_t size;
-	unsigned int num_pages, i = 0;
-	size_t offset, folio_offset, left, len;
+	size_t left;
 	int ret = 0;
 
 	/*
-	 * Move page array up in the allocated memory for the bio vecs as far as
-	 * possible so that we can start filling biovecs from the beginning
-	 * without overwriting the temporary page array.
+	 * The ranges are extracted into the free bvecs of the bio.  Range i is
+	 * read before bvec i or an earlier one is filled in, so they can share
+	 * the memory as long as the two are the same size.
 	 */
-	BUILD_BUG_ON(PAGE_PTRS_PER_BVEC < 2);
-	pages += entries_left * (PAGE_PTRS_PER_BVEC - 1);
+	BUILD_BUG_ON(sizeof(struct iov_iter_folio) != sizeof(struct bio_vec));
+	folios = (struct iov_iter_folio *)(bio->bi_io_vec + bio->bi_vcnt);
 
 	if (bio->bi_bdev && blk_queue_pci_p2pdma(bio->bi_bdev->bd_disk->queue))
 		extraction_flags |= ITER_ALLOW_P2PDMA;
@@ -1331,56 +1314,42 @@ static int __bio_iov_iter_get_pages(struct bio *bio, struct iov_iter *iter)
 	 * result to ensure the bio's total size is correct. The remainder of
 	 * the iov data will be picked up in the next bio iteration.
 	 */
-	size = iov_iter_extract_pages(iter, &pages,
-				      UINT_MAX - bio->bi_iter.bi_size,
-				      nr_pages, extraction_flags, &offset);
+	size = iov_iter_extract_folios(iter, folios, entries_left,
+				       UINT_MAX - bio->bi_iter.bi_size,
+				       extraction_flags, &nr_folios);
 	if (unlikely(size <= 0))
 		return size ? size : -EFAULT;
 
-	nr_pages = DIV_ROUND_UP(offset + size, PAGE_SIZE);
-
 	if (bio->bi_bdev) {
 		size_t trim = size & (bdev_logical_block_size(bio->bi_bdev) - 1);
 		iov_iter_revert(iter, trim);
 		size -= trim;
 	}
 
-	if (unlikely(!size)) {
+	if (unlikely(!size))
 		ret = -EFAULT;
-		goto out;
-	}
-
-	for (left = size, i = 0; left > 0; left -= len, i += num_pages) {
-		struct page *page = pages[i];
-		struct folio *folio = page_folio(page);
-
-		folio_offset = ((size_t)folio_page_idx(folio, page) <<
-			       PAGE_SHIFT) + offset;
-
-		len = min(folio_size(folio) - folio_offset, left);
-
-		num_pages = DIV_ROUND_UP(offset + len, PAGE_SIZE);
 
-		if (num_pages > 1)
-			len = get_contig_folio_len(&num_pages, pages, i,
-						   folio, left, offset);
+	for (left = size, i = 0; i < nr_folios; i++) {
+		struct iov_iter_folio f = folios[i];
+		size_t len = 0;
 
-		if (bio_op(bio) == REQ_OP_ZONE_APPEND) {
-			ret = bio_iov_add_zone_append_folio(bio, folio, len,
-					folio_offset);
+		if (!ret && left) {
+			len = min_t(size_t, f.length, left);
+			if (bio_op(bio) == REQ_OP_ZONE_APPEND)
+				ret = bio_iov_add_zone_append_folio(bio,
+						f.folio, len, f.offset);
+			else
+				bio_iov_add_folio(bio, f.folio, len, f.offset);
 			if (ret)
-				break;
-		} else
-			bio_iov_add_folio(bio, folio, len, folio_offset);
-
-		offset = 0;
+				len = 0;
+			else
+				left -= len;
+		}
+		if (len < f.length)
+			bio_release_folio_tail(bio, &f, len);
 	}
 
 	iov_iter_revert(iter, left);
-out:
-	while (i < nr_pages)
-		bio_release_page(bio, pages[i++]);
-
 	return ret;
 }
 
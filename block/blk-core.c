@@ -257,6 +257,7 @@ static void blk_free_queue_rcu(struct rcu_head *rcu_head)
 static void blk_free_queue(struct request_queue *q)
 {
 	blk_free_queue_stats(q->stats);
+	free_percpu(q->split_stats);
 	if (queue_is_mq(q))
 		blk_mq_release(q);
 
@@ -414,9 +415,15 @@ struct request_queue *blk_alloc_queue(struct queue_limits *lim, int node_id)
 		goto fail_id;
 	}
 
+	q->split_stats = alloc_percpu(struct blk_split_stats);
+	if (!q->split_stats) {
+		error = -ENOMEM;
+		goto fail_stats;
+	}
+
 	error = blk_set_default_limits(lim);
 	if (error)
-		goto fail_stats;
+		goto fail_split_stats;
 	q->limits = *lim;
 
 	q->node = node_id;
@@ -448,7 +455,7 @@ struct request_queue *blk_alloc_queue(struct queue_limits *lim, int node_id)
 				blk_queue_usage_counter_release,
 				PERCPU_REF_INIT_ATOMIC, GFP_KERNEL);
 	if (error)
-		goto fail_stats;
+		goto fail_split_stats;
 	lockdep_register_key(&q->io_lock_cls_key);
 	lockdep_register_key(&q->q_lock_cls_key);
 	lockdep_init_map(&q->io_lockdep_map, "&q->q_usage_counter(io)",
@@ -457,9 +464,12 @@ struct request_queue *blk_alloc_queue(struct queue_limits *lim, int node_id)
 			 &q->q_lock_cls_key, 0);
 
 	q->nr_requests = BLKDEV_DEFAULT_RQ;
+	q->poll_nsec = BLK_MQ_POLL_CLASSIC;
 
 	return q;
 
+fail_split_stats:
+	free_percpu(q->split_stats);
 fail_stats:
 	blk_free_queue_stats(q->stats);
 fail_id:
@@ -227,6 +227,12 @@ enum {
 
 	INUSE_ADJ_STEP_PCT	= 25,
 
+	/*
+	 * A CPU can take a slice of up to 1/8 of the min margin out of its
+	 * iocg's budget, see iocg_refill_vslice().
+	 */
+	VSLICE_MARGIN_DIV	= 8,
+
 	/* Have some play in timer operations */
 	TIMER_SLACK_PCT		= 1,
 
@@ -449,6 +455,8 @@ struct ioc {
 
 struct iocg_pcpu_stat {
 	local64_t			abs_vusage;
+	/* vtime already charged to iocg->vtime but not yet used by an IO */
+	atomic64_t			vslice;
 };
 
 struct iocg_stat {
@@ -727,6 +735,70 @@ static void iocg_commit_bio(struct ioc_gq *iocg, struct bio *bio,
 	put_cpu_ptr(gcs);
 }
 
+/*
+ * Charge @bio against this CPU's slice of @iocg's budget, which doesn't touch
+ * the shared iocg->vtime. Returns false if the slice can't cover @cost.
+ */
+static bool iocg_commit_bio_vslice(struct ioc_gq *iocg, struct bio *bio,
+				   u64 abs_cost, u64 cost)
+{
+	struct iocg_pcpu_stat *gcs;
+	bool committed = false;
+	s64 vslice;
+
+	gcs = get_cpu_ptr(iocg->pcpu_stat);
+	vslice = atomic64_read(&gcs->vslice);
+	do {
+		if (vslice < (s64)cost)
+			goto out;
+	} while (!atomic64_try_cmpxchg(&gcs->vslice, &vslice, vslice - cost));
+
+	bio->bi_iocost_cost = cost;
+	local64_add(abs_cost, &gcs->abs_vusage);
+	committed = true;
+out:
+	put_cpu_ptr(gcs);
+	return committed;
+}
+
+/*
+ * Move a slice of @iocg's budget to this CPU so that the following IOs issued
+ * here can be charged with iocg_commit_bio_vslice(). The budget beyond the min
+ * margin is shared out this way, and ioc_timer_fn() returns unused slices
+ * every period.
+ */
+static void iocg_refill_vslice(struct ioc_gq *iocg, u64 vtime,
+			       struct ioc_now *now)
+{
+	struct ioc_margins *margins = &iocg->ioc->margins;
+	struct iocg_pcpu_stat *gcs;
+	s64 avail = now->vnow - vtime - margins->min;
+	u64 slice;
+
+	if (avail <= 0)
+		return;
+
+	slice = min_t(u64, avail, margins->min / VSLICE_MARGIN_DIV);
+	atomic64_add(slice, &iocg->vtime);
+
+	gcs = get_cpu_ptr(iocg->pcpu_stat);
+	atomic64_add(slice, &gcs->vslice);
+	put_cpu_ptr(gcs);
+}
+
+/* Give the unused per-cpu budget slices back to @iocg's vtime */
+static void iocg_drain_vslices(struct ioc_gq *iocg)
+{
+	s64 unused = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		unused += atomic64_xchg(&per_cpu_ptr(iocg->pcpu_stat, cpu)->vslice, 0);
+
+	if (unused)
+		atomic64_sub(unused, &iocg->vtime);
+}
+
 static void iocg_lock(struct ioc_gq *iocg, bool lock_ioc, unsigned long *flags)
 {
 	if (lock_ioc) {
@@ -2270,6 +2342,10 @@ static void ioc_timer_fn(struct timer_list *timer)
 		return;
 	}
 
+	/* bring vtime up-to-date before looking at the budgets */
+	list_for_each_entry(iocg, &ioc->active_iocgs, active_list)
+		iocg_drain_vslices(iocg);
+
 	nr_debtors = ioc_check_iocgs(ioc, &now);
 
 	/*
@@ -2633,14 +2709,19 @@ static void ioc_rqos_throttle(struct rq_qos *rqos, struct bio *bio)
 	cost = adjust_inuse_and_calc_cost(iocg, vtime, abs_cost, &now);
 
 	/*
-	 * If no one's waiting and within budget, issue right away.  The
-	 * tests are racy but the races aren't systemic - we only miss once
-	 * in a while which is fine.
+	 * If no one's waiting and within budget, issue right away, out of
+	 * this CPU's slice of the budget if possible.  The tests are racy
+	 * but the races aren't systemic - we only miss once in a while
+	 * which is fine.
 	 */
-	if (!waitqueue_active(&iocg->waitq) && !iocg->abs_vdebt &&
-	    time_before_eq64(vtime + cost, now.vnow)) {
-		iocg_commit_bio(iocg, bio, abs_cost, cost);
-		return;
+	if (!waitqueue_active(&iocg->waitq) && !iocg->abs_vdebt) {
+		if (iocg_commit_bio_vslice(iocg, bio, abs_cost, cost))
+			return;
+		if (time_before_eq64(vtime + cost, now.vnow)) {
+			iocg_commit_bio(iocg, bio, abs_cost, cost);
+			iocg_refill_vslice(iocg, vtime + cost, &now);
+			return;
+		}
 	}
 
 	/*
@@ -105,7 +105,8 @@ static unsigned int bio_allowed_max_sectors(const struct queue_limits *lim)
 	return round_down(UINT_MAX, lim->logical_block_size) >> SECTOR_SHIFT;
 }
 
-static struct bio *bio_submit_split(struct bio *bio, int split_sectors)
+static struct bio *bio_submit_split(struct bio *bio, int split_sectors,
+		enum blk_split_reason reason)
 {
 	if (unlikely(split_sectors < 0)) {
 		bio->bi_status = errno_to_blk_status(split_sectors);
@@ -119,6 +120,7 @@ static struct bio *bio_submit_split(struct bio *bio, int split_sectors)
 		split = bio_split(bio, split_sectors, GFP_NOIO,
 				&bio->bi_bdev->bd_disk->bio_split);
 		split->bi_opf |= REQ_NOMERGE;
+		this_cpu_inc(bio->bi_bdev->bd_disk->queue->split_stats->nr[reason]);
 		blkcg_bio_issue_init(split);
 		bio_chain(split, bio);
 		trace_block_split(split, bio->bi_iter.bi_sector);
@@ -163,7 +165,7 @@ struct bio *bio_split_discard(struct bio *bio, const struct queue_limits *lim,
 	if (split_sectors > tmp)
 		split_sectors -= tmp;
 
-	return bio_submit_split(bio, split_sectors);
+	return bio_submit_split(bio, split_sectors, BLK_SPLIT_DISCARD);
 }
 
 static inline unsigned int blk_boundary_sectors(const struct queue_limits *lim,
@@ -295,32 +297,43 @@ static unsigned int bio_split_alignment(struct bio *bio,
 	return lim->logical_block_size;
 }
 
-/**
- * bio_split_rw_at - check if and where to split a read/write bio
- * @bio:  [in] bio to be split
- * @lim:  [in] queue limits to split based on
- * @segs: [out] number of segments in the bio with the first half of the sectors
- * @max_bytes: [in] maximum number of bytes per bio
- *
- * Find out if @bio needs to be split to fit the queue limits in @lim and a
- * maximum size of @max_bytes.  Returns a negative error number if @bio can't be
- * split, 0 if the bio doesn't have to be split, or a positive sector offset if
- * @bio needs to be split.
+/*
+ * With BLK_FLAG_TRIVIAL_SPLIT each bvec is one segment, so a bio that still
+ * has all of its own bvecs and fits the size and segment limits has bi_vcnt
+ * segments.  Cloned bios share their bvecs, walk them as usual.
  */
-int bio_split_rw_at(struct bio *bio, const struct queue_limits *lim,
-		unsigned *segs, unsigned max_bytes)
+static inline bool bio_split_trivial(struct bio *bio,
+		const struct queue_limits *lim, unsigned max_bytes)
+{
+	return (lim->flags & BLK_FLAG_TRIVIAL_SPLIT) &&
+		!bio_flagged(bio, BIO_CLONED) &&
+		!bio->bi_iter.bi_idx && !bio->bi_iter.bi_bvec_done &&
+		bio->bi_iter.bi_size <= max_bytes &&
+		bio->bi_vcnt <= lim->max_segments;
+}
+
+static int __bio_split_rw_at(struct bio *bio, const struct queue_limits *lim,
+		unsigned *segs, unsigned max_bytes,
+		enum blk_split_reason *reason)
 {
 	struct bio_vec bv, bvprv, *bvprvp = NULL;
 	struct bvec_iter iter;
 	unsigned nsegs = 0, bytes = 0;
 
+	if (bio_split_trivial(bio, lim, max_bytes)) {
+		*segs = bio->bi_vcnt;
+		return 0;
+	}
+
 	bio_for_each_bvec(bv, bio, iter) {
 		/*
 		 * If the queue doesn't support SG gaps and adding this
 		 * offset would create a gap, disallow it.
 		 */
-		if (bvprvp && bvec_gap_to_prev(lim, bvprvp, bv.bv_offset))
+		if (bvprvp && bvec_gap_to_prev(lim, bvprvp, bv.bv_offset)) {
+			*reason = BLK_SPLIT_GAP;
 			goto split;
+		}
 
 		if (nsegs < lim->max_segments &&
 		    bytes + bv.bv_len <= max_bytes &&
@@ -329,8 +342,11 @@ int bio_split_rw_at(struct bio *bio, const struct queue_limits *lim,
 			bytes += bv.bv_len;
 		} else {
 			if (bvec_split_segs(lim, &bv, &nsegs, &bytes,
-					lim->max_segments, max_bytes))
+					lim->max_segments, max_bytes)) {
+				*reason = nsegs < lim->max_segments ?
+					BLK_SPLIT_SIZE : BLK_SPLIT_SEGMENTS;
 				goto split;
+			}
 		}
 
 		bvprv = bv;
@@ -367,14 +383,37 @@ int bio_split_rw_at(struct bio *bio, const struct queue_limits *lim,
 	bio_clear_polled(bio);
 	return bytes >> SECTOR_SHIFT;
 }
+
+/**
+ * bio_split_rw_at - check if and where to split a read/write bio
+ * @bio:  [in] bio to be split
+ * @lim:  [in] queue limits to split based on
+ * @segs: [out] number of segments in the bio with the first half of the sectors
+ * @max_bytes: [in] maximum number of bytes per bio
+ *
+ * Find out if @bio needs to be split to fit the queue limits in @lim and a
+ * maximum size of @max_bytes.  Returns a negative error number if @bio can't be
+ * split, 0 if the bio doesn't have to be split, or a positive sector offset if
+ * @bio needs to be split.
+ */
+int bio_split_rw_at(struct bio *bio, const struct queue_limits *lim,
+		unsigned *segs, unsigned max_bytes)
+{
+	enum blk_split_reason reason;
+
+	return __bio_split_rw_at(bio, lim, segs, max_bytes, &reason);
+}
 EXPORT_SYMBOL_GPL(bio_split_rw_at);
 
 struct bio *bio_split_rw(struct bio *bio, const struct queue_limits *lim,
 		unsigned *nr_segs)
 {
+	enum blk_split_reason reason = BLK_SPLIT_SIZE;
+
 	return bio_submit_split(bio,
-		bio_split_rw_at(bio, lim, nr_segs,
-			get_max_io_size(bio, lim) << SECTOR_SHIFT));
+		__bio_split_rw_at(bio, lim, nr_segs,
+			get_max_io_size(bio, lim) << SECTOR_SHIFT, &reason),
+		reason);
 }
 
 /*
@@ -394,7 +433,7 @@ struct bio *bio_split_zone_append(struct bio *bio,
 			max_sectors << SECTOR_SHIFT);
 	if (WARN_ON_ONCE(split_sectors > 0))
 		split_sectors = -EINVAL;
-	return bio_submit_split(bio, split_sectors);
+	return bio_submit_split(bio, split_sectors, BLK_SPLIT_SIZE);
 }
 
 struct bio *bio_split_write_zeroes(struct bio *bio,
@@ -414,7 +453,7 @@ struct bio *bio_split_write_zeroes(struct bio *bio,
 		return bio;
 	if (bio_sectors(bio) <= max_sectors)
 		return bio;
-	return bio_submit_split(bio, max_sectors);
+	return bio_submit_split(bio, max_sectors, BLK_SPLIT_WRITE_ZEROES);
 }
 
 /**
@@ -13,9 +13,40 @@
 #include "blk-mq-debugfs.h"
 #include "blk-mq-sched.h"
 #include "blk-rq-qos.h"
+#include "blk-stat.h"
 
 static int queue_poll_stat_show(void *data, struct seq_file *m)
 {
+	struct request_queue *q = data;
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long i;
+
+	queue_for_each_hw_ctx(q, hctx, i) {
+		if (hctx->type != HCTX_TYPE_POLL)
+			continue;
+		seq_printf(m, "hctx%lu: samples=%u p50=%llu p90=%llu p99=%llu\n",
+			   i, READ_ONCE(hctx->poll_hist.nr_samples),
+			   blk_rq_hist_percentile(&hctx->poll_hist, 50),
+			   blk_rq_hist_percentile(&hctx->poll_hist, 90),
+			   blk_rq_hist_percentile(&hctx->poll_hist, 99));
+	}
+	return 0;
+}
+
+/* Raw log2 nanosecond buckets of each stage, bucket i holds [2^(i-1), 2^i) */
+static int queue_stage_hist_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	u64 counts[BLK_RQ_HIST_BUCKETS];
+	int stage, i;
+
+	for (stage = 0; stage < BLK_STAGE_NR; stage++) {
+		blk_stage_stats_read(q, stage, counts);
+		seq_printf(m, "%s:", blk_stage_name[stage]);
+		for (i = 0; i < BLK_RQ_HIST_BUCKETS; i++)
+			seq_printf(m, " %llu", counts[i]);
+		seq_putc(m, '\n');
+	}
 	return 0;
 }
 
@@ -78,6 +109,30 @@ static int queue_pm_only_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static const char *const blk_split_reason_name[] = {
+	[BLK_SPLIT_SIZE]		= "size",
+	[BLK_SPLIT_SEGMENTS]		= "segments",
+	[BLK_SPLIT_GAP]			= "gap",
+	[BLK_SPLIT_DISCARD]		= "discard",
+	[BLK_SPLIT_WRITE_ZEROES]	= "write_zeroes",
+};
+
+static int queue_split_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	int i, cpu;
+
+	BUILD_BUG_ON(ARRAY_SIZE(blk_split_reason_name) != BLK_SPLIT_NR_REASONS);
+	for (i = 0; i < BLK_SPLIT_NR_REASONS; i++) {
+		unsigned long nr = 0;
+
+		for_each_possible_cpu(cpu)
+			nr += per_cpu_ptr(q->split_stats, cpu)->nr[i];
+		seq_printf(m, "%s %lu\n", blk_split_reason_name[i], nr);
+	}
+	return 0;
+}
+
 #define QUEUE_FLAG_NAME(name) [QUEUE_FLAG_##name] = #name
 static const char *const blk_queue_flag_name[] = {
 	QUEUE_FLAG_NAME(DYING),
@@ -93,6 +148,7 @@ static const char *const blk_queue_flag_name[] = {
 	QUEUE_FLAG_NAME(RQ_ALLOC_TIME),
 	QUEUE_FLAG_NAME(HCTX_ACTIVE),
 	QUEUE_FLAG_NAME(SQ_SCHED),
+	QUEUE_FLAG_NAME(STAGE_STATS),
 };
 #undef QUEUE_FLAG_NAME
 
@@ -147,6 +203,8 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_queue_attrs[] = {
 	{ "poll_stat", 0400, queue_poll_stat_show },
 	{ "requeue_list", 0400, .seq_ops = &queue_requeue_list_seq_ops },
 	{ "pm_only", 0600, queue_pm_only_show, NULL },
+	{ "split", 0400, queue_split_show },
+	{ "stage_hist", 0400, queue_stage_hist_show },
 	{ "state", 0600, queue_state_show, queue_state_write },
 	{ "zone_wplugs", 0400, queue_zone_wplugs_show, NULL },
 	{ },
@@ -257,6 +315,7 @@ static const char *const rqf_name[] = {
 	RQF_NAME(SPECIAL_PAYLOAD),
 	RQF_NAME(ZONE_WRITE_PLUGGING),
 	RQF_NAME(TIMED_OUT),
+	RQF_NAME(MQ_POLL_SLEPT),
 	RQF_NAME(RESV),
 };
 #undef RQF_NAME
@@ -461,6 +461,8 @@ int blk_mq_init_sched(struct request_queue *q, struct elevator_type *e)
 	}
 
 	queue_for_each_hw_ctx(q, hctx, i) {
+		/* Driver tags are now only allocated at dispatch */
+		blk_mq_tag_cache_drain_all(hctx->tags);
 		ret = blk_mq_sched_alloc_map_and_rqs(q, hctx, i);
 		if (ret)
 			goto err_free_map_and_rqs;
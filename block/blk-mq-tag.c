@@ -13,6 +13,23 @@
 #include "blk.h"
 #include "blk-mq.h"
 #include "blk-mq-sched.h"
+#include "blk-stat.h"
+
+/*
+ * Per-cpu cache of driver tags. A plug batches request allocation, but only
+ * for unshared tag maps and only while it is active. Everything else takes
+ * one tag at a time from the shared sbitmap words. Instead, each cpu grabs a
+ * few tags at once with __sbitmap_queue_get_batch() and hands them out one
+ * by one, whichever queue of the tag set they are for. Only free tags are
+ * cached, completed requests still return their tag to the sbitmap.
+ */
+struct blk_mq_tag_cache {
+	spinlock_t lock;
+	unsigned long mask;
+	unsigned int offset;
+};
+
+#define BLK_MQ_TAG_CACHE_BATCH	8
 
 /*
  * Recalculate wakeup batch when tag is shared by hctx.
@@ -131,6 +148,115 @@ unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
 	return ret;
 }
 
+/**
+ * blk_mq_init_tag_cache - set up the per-cpu tag cache of a driver tag map
+ * @tags: the tag map
+ * @nr_cpus: number of cpus expected to allocate from @tags
+ *
+ * The caches hold at most half of the tags. If that doesn't leave room for
+ * a useful batch per cpu, or the allocation fails, tags are simply not
+ * cached.
+ */
+void blk_mq_init_tag_cache(struct blk_mq_tags *tags, unsigned int nr_cpus)
+{
+	unsigned int depth = tags->nr_tags - tags->nr_reserved_tags;
+	unsigned int batch;
+	int cpu;
+
+	batch = min(depth / (2 * max(nr_cpus, 1U)), BLK_MQ_TAG_CACHE_BATCH);
+	if (batch < 2)
+		return;
+
+	tags->cache = alloc_percpu_gfp(struct blk_mq_tag_cache,
+				       GFP_NOIO | __GFP_NOWARN);
+	if (!tags->cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(tags->cache, cpu)->lock);
+	tags->cache_batch = batch;
+}
+
+/*
+ * Fast path of blk_mq_get_tag() for a plain driver tag. Never sleeps,
+ * returns BLK_MQ_NO_TAG for the caller to fall back to blk_mq_get_tag().
+ */
+unsigned int blk_mq_get_cached_tag(struct blk_mq_alloc_data *data)
+{
+	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
+	struct sbitmap_queue *bt = &tags->bitmap_tags;
+	struct blk_mq_tag_cache *cache;
+	unsigned long flags;
+	unsigned int tag;
+
+	if (!tags->cache || (data->rq_flags & RQF_SCHED_TAGS) ||
+	    data->shallow_depth || (data->flags & BLK_MQ_REQ_RESERVED))
+		return BLK_MQ_NO_TAG;
+
+	if (!hctx_may_queue(data->hctx, bt))
+		return BLK_MQ_NO_TAG;
+
+	/* We may have been preempted, the lock covers remote users */
+	cache = per_cpu_ptr(tags->cache, data->ctx->cpu);
+	spin_lock_irqsave(&cache->lock, flags);
+	if (!cache->mask)
+		cache->mask = __sbitmap_queue_get_batch(bt, tags->cache_batch,
+							&cache->offset);
+	if (unlikely(!cache->mask)) {
+		spin_unlock_irqrestore(&cache->lock, flags);
+		return BLK_MQ_NO_TAG;
+	}
+	tag = cache->offset + __ffs(cache->mask);
+	cache->mask &= cache->mask - 1;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	/* Same as blk_mq_get_tag(), the caller retries on an active hctx */
+	if (unlikely(test_bit(BLK_MQ_S_INACTIVE, &data->hctx->state))) {
+		sbitmap_queue_clear(bt, tag, data->ctx->cpu);
+		return BLK_MQ_NO_TAG;
+	}
+	return tag + tags->nr_reserved_tags;
+}
+
+static void __blk_mq_tag_cache_drain(struct blk_mq_tags *tags, int cpu)
+{
+	struct blk_mq_tag_cache *cache = per_cpu_ptr(tags->cache, cpu);
+	unsigned long flags, mask;
+	unsigned int offset;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	mask = cache->mask;
+	offset = cache->offset;
+	cache->mask = 0;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	for (; mask; mask &= mask - 1)
+		sbitmap_queue_clear(&tags->bitmap_tags, offset + __ffs(mask),
+				    cpu);
+}
+
+/* Return the tags cached by @cpu, e.g. when it goes offline */
+void blk_mq_tag_cache_drain(struct blk_mq_tags *tags, int cpu)
+{
+	if (tags && tags->cache)
+		__blk_mq_tag_cache_drain(tags, cpu);
+}
+
+/*
+ * Return all cached tags: before the bitmap is resized, and when driver tags
+ * stop being allocated from the submission path because of an I/O scheduler.
+ */
+void blk_mq_tag_cache_drain_all(struct blk_mq_tags *tags)
+{
+	int cpu;
+
+	if (!tags || !tags->cache)
+		return;
+
+	for_each_possible_cpu(cpu)
+		__blk_mq_tag_cache_drain(tags, cpu);
+}
+
 unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 {
 	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
@@ -138,6 +264,7 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 	struct sbq_wait_state *ws;
 	DEFINE_SBQ_WAIT(wait);
 	unsigned int tag_offset;
+	u64 wait_start_ns = 0;
 	int tag;
 
 	if (data->flags & BLK_MQ_REQ_RESERVED) {
@@ -159,6 +286,9 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 	if (data->flags & BLK_MQ_REQ_NOWAIT)
 		return BLK_MQ_NO_TAG;
 
+	if (blk_queue_stage_stats(data->q))
+		wait_start_ns = blk_time_get_ns();
+
 	ws = bt_wait_ptr(bt, data->hctx);
 	do {
 		struct sbitmap_queue *bt_prev;
@@ -211,6 +341,10 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 
 	sbitmap_finish_wait(bt, ws, &wait);
 
+	if (wait_start_ns)
+		blk_stage_stat_add(data->q, BLK_STAGE_TAG,
+				   blk_time_get_ns() - wait_start_ns);
+
 found_tag:
 	/*
 	 * Give up this allocation if the hctx is inactive.  The caller will
@@ -594,6 +728,7 @@ struct blk_mq_tags *blk_mq_init_tags(unsigned int total_tags,
 
 void blk_mq_free_tags(struct blk_mq_tags *tags)
 {
+	free_percpu(tags->cache);
 	sbitmap_queue_free(&tags->bitmap_tags);
 	sbitmap_queue_free(&tags->breserved_tags);
 	kfree(tags);
@@ -644,6 +779,7 @@ int blk_mq_tag_update_depth(struct blk_mq_hw_ctx *hctx,
 		 * Don't need (or can't) update reserved tags here, they
 		 * remain static and should never need resizing.
 		 */
+		blk_mq_tag_cache_drain_all(tags);
 		sbitmap_queue_resize(&tags->bitmap_tags,
 				tdepth - tags->nr_reserved_tags);
 	}
@@ -655,6 +791,7 @@ void blk_mq_tag_resize_shared_tags(struct blk_mq_tag_set *set, unsigned int size
 {
 	struct blk_mq_tags *tags = set->shared_tags;
 
+	blk_mq_tag_cache_drain_all(tags);
 	sbitmap_queue_resize(&tags->bitmap_tags, size - set->reserved_tags);
 }
 
@@ -51,7 +51,8 @@ static void blk_mq_request_bypass_insert(struct request *rq,
 static void blk_mq_try_issue_list_directly(struct blk_mq_hw_ctx *hctx,
 		struct list_head *list);
 static int blk_hctx_poll(struct request_queue *q, struct blk_mq_hw_ctx *hctx,
-			 struct io_comp_batch *iob, unsigned int flags);
+			 struct request *rq, struct io_comp_batch *iob,
+			 unsigned int flags);
 
 /*
  * Check if any of the ctx, dispatch list or elevator
@@ -581,7 +582,9 @@ static struct request *__blk_mq_alloc_requests(struct blk_mq_alloc_data *data)
 	 * case just retry the hctx assignment and tag allocation as CPU hotplug
 	 * should have migrated us to an online CPU by now.
 	 */
-	tag = blk_mq_get_tag(data);
+	tag = blk_mq_get_cached_tag(data);
+	if (tag == BLK_MQ_NO_TAG)
+		tag = blk_mq_get_tag(data);
 	if (tag == BLK_MQ_NO_TAG) {
 		if (data->flags & BLK_MQ_REQ_NOWAIT)
 			return NULL;
@@ -1449,7 +1452,7 @@ EXPORT_SYMBOL_GPL(blk_rq_is_poll);
 static void blk_rq_poll_completion(struct request *rq, struct completion *wait)
 {
 	do {
-		blk_hctx_poll(rq->q, rq->mq_hctx, NULL, 0);
+		blk_hctx_poll(rq->q, rq->mq_hctx, rq, NULL, 0);
 		cond_resched();
 	} while (!completion_done(wait));
 }
@@ -3058,10 +3061,14 @@ void blk_mq_submit_bio(struct bio *bio)
 	struct blk_plug *plug = current->plug;
 	const int is_sync = op_is_sync(bio->bi_opf);
 	struct blk_mq_hw_ctx *hctx;
+	u64 submit_time_ns = 0;
 	unsigned int nr_segs;
 	struct request *rq;
 	blk_status_t ret;
 
+	if (blk_queue_stage_stats(q))
+		submit_time_ns = blk_time_get_ns();
+
 	/*
 	 * If the plug has a cached request for this queue, try to use it.
 	 */
@@ -3124,6 +3131,9 @@ void blk_mq_submit_bio(struct bio *bio)
 
 	trace_block_getrq(bio);
 
+	if (submit_time_ns)
+		blk_stage_stat_submit(rq, submit_time_ns);
+
 	rq_qos_track(q, rq, bio);
 
 	blk_mq_bio_to_request(rq, bio, nr_segs);
@@ -3480,6 +3490,13 @@ static struct blk_mq_tags *blk_mq_alloc_rq_map(struct blk_mq_tag_set *set,
 	if (!tags)
 		return NULL;
 
+	/*
+	 * Tags shared by all hardware queues are allocated from every node,
+	 * keep each node on its own part of the bitmap.
+	 */
+	if (hctx_idx == BLK_MQ_NO_HCTX_IDX)
+		sbitmap_set_numa(&tags->bitmap_tags.sb);
+
 	tags->rqs = kcalloc_node(nr_tags, sizeof(struct request *),
 				 GFP_NOIO | __GFP_NOWARN | __GFP_NORETRY,
 				 node);
@@ -3723,6 +3740,8 @@ static int blk_mq_hctx_notify_dead(unsigned int cpu, struct hlist_node *node)
 	ctx = __blk_mq_get_ctx(hctx->queue, cpu);
 	type = hctx->type;
 
+	blk_mq_tag_cache_drain(hctx->tags, cpu);
+
 	spin_lock(&ctx->lock);
 	if (!list_empty(&ctx->rq_lists[type])) {
 		list_splice_init(&ctx->rq_lists[type], &tmp);
@@ -4061,8 +4080,13 @@ static bool __blk_mq_alloc_map_and_rqs(struct blk_mq_tag_set *set,
 
 	set->tags[hctx_idx] = blk_mq_alloc_map_and_rqs(set, hctx_idx,
 						       set->queue_depth);
+	if (!set->tags[hctx_idx])
+		return false;
 
-	return set->tags[hctx_idx];
+	blk_mq_init_tag_cache(set->tags[hctx_idx],
+			      DIV_ROUND_UP(num_possible_cpus(),
+					   set->nr_hw_queues));
+	return true;
 }
 
 void blk_mq_free_map_and_rqs(struct blk_mq_tag_set *set,
@@ -4585,6 +4609,7 @@ static int __blk_mq_alloc_rq_maps(struct blk_mq_tag_set *set)
 						set->queue_depth);
 		if (!set->shared_tags)
 			return -ENOMEM;
+		blk_mq_init_tag_cache(set->shared_tags, num_possible_cpus());
 	}
 
 	for (i = 0; i < set->nr_hw_queues; i++) {
@@ -5080,12 +5105,76 @@ void blk_mq_update_nr_hw_queues(struct blk_mq_tag_set *set, int nr_hw_queues)
 }
 EXPORT_SYMBOL_GPL(blk_mq_update_nr_hw_queues);
 
+/* Samples needed before adaptive hybrid polling trusts the histogram */
+#define BLK_MQ_POLL_MIN_SAMPLES	16
+
+static u64 blk_mq_poll_nsecs(struct request_queue *q,
+			     struct blk_mq_hw_ctx *hctx)
+{
+	int poll_nsec = READ_ONCE(q->poll_nsec);
+
+	if (poll_nsec > 0)
+		return poll_nsec;
+	if (READ_ONCE(hctx->poll_hist.nr_samples) < BLK_MQ_POLL_MIN_SAMPLES)
+		return 0;
+
+	/*
+	 * Sleep for half the median completion time and spin for the rest,
+	 * the histogram decays so this follows the load of the hctx.
+	 */
+	return blk_rq_hist_percentile(&hctx->poll_hist, 50) / 2;
+}
+
+/*
+ * Sleep once per request, the first time it is polled.  Later polls of the
+ * same request are a caller that got back to it early, they spin.
+ */
+static void blk_mq_poll_hybrid(struct request_queue *q,
+			       struct blk_mq_hw_ctx *hctx, struct request *rq,
+			       long state)
+{
+	struct hrtimer_sleeper hs;
+	u64 nsecs;
+
+	if (READ_ONCE(q->poll_nsec) == BLK_MQ_POLL_CLASSIC ||
+	    (rq->rq_flags & RQF_MQ_POLL_SLEPT))
+		return;
+	nsecs = blk_mq_poll_nsecs(q, hctx);
+	if (!nsecs)
+		return;
+
+	rq->rq_flags |= RQF_MQ_POLL_SLEPT;
+
+	hrtimer_init_sleeper_on_stack(&hs, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsecs));
+	do {
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		hrtimer_sleeper_start_expires(&hs, HRTIMER_MODE_REL);
+		if (hs.task)
+			io_schedule();
+		hrtimer_cancel(&hs.timer);
+	} while (hs.task && !signal_pending(current));
+	destroy_hrtimer_on_stack(&hs.timer);
+
+	/* the caller may have set its state before polling, restore it */
+	__set_current_state(state);
+}
+
 static int blk_hctx_poll(struct request_queue *q, struct blk_mq_hw_ctx *hctx,
-			 struct io_comp_batch *iob, unsigned int flags)
+			 struct request *rq, struct io_comp_batch *iob,
+			 unsigned int flags)
 {
 	long state = get_current_state();
 	int ret;
 
+	/*
+	 * A oneshot poll doesn't spin, so it has nothing to save by sleeping.
+	 * Cookie polls don't know their request, and would sleep on every
+	 * call, they only spin.
+	 */
+	if (rq && !(flags & BLK_POLL_ONESHOT))
+		blk_mq_poll_hybrid(q, hctx, rq, state);
+
 	do {
 		ret = q->mq_ops->poll(hctx, iob);
 		if (ret > 0) {
@@ -5112,7 +5201,7 @@ int blk_mq_poll(struct request_queue *q, blk_qc_t cookie,
 {
 	struct blk_mq_hw_ctx *hctx = xa_load(&q->hctx_table, cookie);
 
-	return blk_hctx_poll(q, hctx, iob, flags);
+	return blk_hctx_poll(q, hctx, NULL, iob, flags);
 }
 
 int blk_rq_poll(struct request *rq, struct io_comp_batch *iob,
@@ -5126,7 +5215,7 @@ int blk_rq_poll(struct request *rq, struct io_comp_batch *iob,
 	if (!percpu_ref_tryget(&q->q_usage_counter))
 		return 0;
 
-	ret = blk_hctx_poll(q, rq->mq_hctx, iob, poll_flags);
+	ret = blk_hctx_poll(q, rq->mq_hctx, rq, iob, poll_flags);
 	blk_queue_exit(q);
 
 	return ret;
@@ -170,6 +170,10 @@ int blk_mq_init_bitmaps(struct sbitmap_queue *bitmap_tags,
 		unsigned int reserved, int node, int alloc_policy);
 
 unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data);
+void blk_mq_init_tag_cache(struct blk_mq_tags *tags, unsigned int nr_cpus);
+unsigned int blk_mq_get_cached_tag(struct blk_mq_alloc_data *data);
+void blk_mq_tag_cache_drain(struct blk_mq_tags *tags, int cpu);
+void blk_mq_tag_cache_drain_all(struct blk_mq_tags *tags);
 unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
 		unsigned int *offset);
 void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
@@ -366,6 +366,16 @@ static int blk_validate_limits(struct queue_limits *lim)
 	if (!(lim->features & BLK_FEAT_WRITE_CACHE))
 		lim->features &= ~BLK_FEAT_FUA;
 
+	/*
+	 * Without these limits every bvec is exactly one segment, which lets
+	 * bio_split_rw_at() skip walking the bvecs of most bios.
+	 */
+	if (!lim->virt_boundary_mask && lim->seg_boundary_mask == ULONG_MAX &&
+	    lim->max_segment_size == UINT_MAX)
+		lim->flags |= BLK_FLAG_TRIVIAL_SPLIT;
+	else
+		lim->flags &= ~BLK_FLAG_TRIVIAL_SPLIT;
+
 	blk_validate_atomic_write_limits(lim);
 
 	err = blk_validate_integrity_limits(lim);
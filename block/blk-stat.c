@@ -11,10 +11,23 @@
 #include "blk-mq.h"
 #include "blk.h"
 
+const char *const blk_stage_name[BLK_STAGE_NR] = {
+	[BLK_STAGE_SUBMIT]	= "submit",
+	[BLK_STAGE_TAG]		= "tag",
+	[BLK_STAGE_QUEUE]	= "queue",
+	[BLK_STAGE_DEVICE]	= "device",
+};
+
+struct blk_stage_stats {
+	u64 buckets[BLK_STAGE_NR][BLK_RQ_HIST_BUCKETS];
+};
+
 struct blk_queue_stats {
 	struct list_head callbacks;
 	spinlock_t lock;
 	int accounting;
+	/* allocated when stage stats are first enabled, kept until release */
+	struct blk_stage_stats __percpu *stage_stats;
 };
 
 void blk_rq_stat_init(struct blk_rq_stat *stat)
@@ -47,6 +60,176 @@ void blk_rq_stat_add(struct blk_rq_stat *stat, u64 value)
 	stat->nr_samples++;
 }
 
+/* Halve the histogram once this many samples were added */
+#define BLK_RQ_HIST_DECAY	1024
+
+/*
+ * Histograms are updated without locking from every CPU completing into
+ * them, a lost update only makes them a little less precise.
+ */
+void blk_rq_hist_add(struct blk_rq_hist *hist, u64 value)
+{
+	unsigned int i, bucket = min(fls64(value), BLK_RQ_HIST_BUCKETS - 1);
+
+	if (++hist->nr_samples >= BLK_RQ_HIST_DECAY) {
+		hist->nr_samples = 0;
+		for (i = 0; i < BLK_RQ_HIST_BUCKETS; i++) {
+			hist->buckets[i] >>= 1;
+			hist->nr_samples += hist->buckets[i];
+		}
+	}
+	hist->buckets[bucket]++;
+}
+
+/* bucket i of a log2 histogram holds [2^(i-1), 2^i) */
+static u64 blk_hist_quantile(const u64 *counts, u64 total, unsigned int num,
+			     unsigned int den)
+{
+	u64 target, seen = 0;
+	unsigned int i;
+
+	if (!total)
+		return 0;
+
+	target = DIV_ROUND_UP_ULL(total * num, den);
+	for (i = 0; i < BLK_RQ_HIST_BUCKETS; i++) {
+		u64 lo, hi;
+
+		if (seen + counts[i] < target) {
+			seen += counts[i];
+			continue;
+		}
+		lo = i ? 1ULL << (i - 1) : 0;
+		hi = 1ULL << i;
+		return lo + div64_u64((hi - lo) * (target - seen), counts[i]);
+	}
+	return 1ULL << (BLK_RQ_HIST_BUCKETS - 1);
+}
+
+/**
+ * blk_rq_hist_percentile - estimate a percentile of a latency histogram
+ * @hist: the histogram
+ * @pct: the percentile, 1 to 100
+ *
+ * The value is interpolated linearly inside the bucket it falls in.
+ *
+ * Return: the estimate in nanoseconds, 0 if @hist is empty.
+ */
+u64 blk_rq_hist_percentile(const struct blk_rq_hist *hist, unsigned int pct)
+{
+	u64 counts[BLK_RQ_HIST_BUCKETS];
+	u64 total = 0;
+	unsigned int i;
+
+	for (i = 0; i < BLK_RQ_HIST_BUCKETS; i++) {
+		counts[i] = READ_ONCE(hist->buckets[i]);
+		total += counts[i];
+	}
+	return blk_hist_quantile(counts, total, pct, 100);
+}
+
+void blk_stage_stat_add(struct request_queue *q, enum blk_stage stage,
+			u64 value)
+{
+	struct blk_stage_stats __percpu *stats = READ_ONCE(q->stats->stage_stats);
+	unsigned int bucket = min(fls64(value), BLK_RQ_HIST_BUCKETS - 1);
+
+	if (stats)
+		this_cpu_inc(stats->buckets[stage][bucket]);
+}
+
+/**
+ * blk_stage_stat_submit - account the submit stage of a new request
+ * @rq: the request just allocated for a bio
+ * @submit_time_ns: when the bio entered blk_mq_submit_bio()
+ */
+void blk_stage_stat_submit(struct request *rq, u64 submit_time_ns)
+{
+	/* the queue and device stages are measured from start_time_ns */
+	if (!rq->start_time_ns)
+		rq->start_time_ns = blk_time_get_ns();
+
+	blk_stage_stat_add(rq->q, BLK_STAGE_SUBMIT,
+			   rq->start_time_ns > submit_time_ns ?
+			   rq->start_time_ns - submit_time_ns : 0);
+}
+
+/**
+ * blk_stage_stats_enable - start attributing request latency to stages
+ * @q: the queue
+ *
+ * Enabling clears the histograms gathered so far.
+ *
+ * Return: 0 or -ENOMEM.
+ */
+int blk_stage_stats_enable(struct request_queue *q)
+{
+	struct blk_stage_stats __percpu *stats = q->stats->stage_stats;
+	int cpu;
+
+	if (!stats) {
+		stats = alloc_percpu(struct blk_stage_stats);
+		if (!stats)
+			return -ENOMEM;
+		if (cmpxchg(&q->stats->stage_stats, NULL, stats)) {
+			free_percpu(stats);
+			stats = q->stats->stage_stats;
+		}
+	}
+
+	if (test_bit(QUEUE_FLAG_STAGE_STATS, &q->queue_flags))
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(stats, cpu), 0, sizeof(struct blk_stage_stats));
+
+	if (!test_and_set_bit(QUEUE_FLAG_STAGE_STATS, &q->queue_flags))
+		blk_stat_enable_accounting(q);
+	return 0;
+}
+
+void blk_stage_stats_disable(struct request_queue *q)
+{
+	if (test_and_clear_bit(QUEUE_FLAG_STAGE_STATS, &q->queue_flags))
+		blk_stat_disable_accounting(q);
+}
+
+/**
+ * blk_stage_stats_read - sum up the histogram of a stage
+ * @q: the queue
+ * @stage: the stage
+ * @counts: BLK_RQ_HIST_BUCKETS log2 nanosecond buckets to fill in
+ *
+ * Return: the number of samples.
+ */
+u64 blk_stage_stats_read(struct request_queue *q, enum blk_stage stage,
+			 u64 *counts)
+{
+	struct blk_stage_stats __percpu *stats = READ_ONCE(q->stats->stage_stats);
+	u64 total = 0;
+	unsigned int i;
+	int cpu;
+
+	memset(counts, 0, BLK_RQ_HIST_BUCKETS * sizeof(*counts));
+	if (!stats)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		for (i = 0; i < BLK_RQ_HIST_BUCKETS; i++)
+			counts[i] += READ_ONCE(per_cpu_ptr(stats, cpu)->buckets[stage][i]);
+	}
+	for (i = 0; i < BLK_RQ_HIST_BUCKETS; i++)
+		total += counts[i];
+	return total;
+}
+
+/* Estimate the @permille quantile of a histogram from blk_stage_stats_read() */
+u64 blk_stage_stats_quantile(const u64 *counts, u64 total,
+			     unsigned int permille)
+{
+	return blk_hist_quantile(counts, total, permille, 1000);
+}
+
 void blk_stat_add(struct request *rq, u64 now)
 {
 	struct request_queue *q = rq->q;
@@ -57,6 +240,16 @@ void blk_stat_add(struct request *rq, u64 now)
 
 	value = (now >= rq->io_start_time_ns) ? now - rq->io_start_time_ns : 0;
 
+	if ((rq->cmd_flags & REQ_POLLED) && q->poll_nsec == 0)
+		blk_rq_hist_add(&rq->mq_hctx->poll_hist, value);
+
+	if (blk_queue_stage_stats(q) && rq->start_time_ns) {
+		blk_stage_stat_add(q, BLK_STAGE_QUEUE,
+				   rq->io_start_time_ns > rq->start_time_ns ?
+				   rq->io_start_time_ns - rq->start_time_ns : 0);
+		blk_stage_stat_add(q, BLK_STAGE_DEVICE, value);
+	}
+
 	rcu_read_lock();
 	cpu = get_cpu();
 	list_for_each_entry_rcu(cb, &q->stats->callbacks, list) {
@@ -214,6 +407,7 @@ struct blk_queue_stats *blk_alloc_queue_stats(void)
 	INIT_LIST_HEAD(&stats->callbacks);
 	spin_lock_init(&stats->lock);
 	stats->accounting = 0;
+	stats->stage_stats = NULL;
 
 	return stats;
 }
@@ -225,5 +419,6 @@ void blk_free_queue_stats(struct blk_queue_stats *stats)
 
 	WARN_ON(!list_empty(&stats->callbacks));
 
+	free_percpu(stats->stage_stats);
 	kfree(stats);
 }
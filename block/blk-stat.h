@@ -8,6 +8,20 @@
 #include <linux/rcupdate.h>
 #include <linux/timer.h>
 
+/*
+ * Stages of a request's life that the per-queue stage histograms attribute
+ * time to, see blk_stage_stats_enable().
+ */
+enum blk_stage {
+	BLK_STAGE_SUBMIT,	/* blk_mq_submit_bio() to request allocated */
+	BLK_STAGE_TAG,		/* sleeping for a tag, only allocations that slept */
+	BLK_STAGE_QUEUE,	/* allocated to dispatched: plug, scheduler, requeue */
+	BLK_STAGE_DEVICE,	/* dispatched to completed: driver and device */
+	BLK_STAGE_NR,
+};
+
+extern const char *const blk_stage_name[BLK_STAGE_NR];
+
 /**
  * struct blk_stat_callback - Block statistics callback.
  *
@@ -169,4 +183,17 @@ void blk_rq_stat_add(struct blk_rq_stat *, u64);
 void blk_rq_stat_sum(struct blk_rq_stat *, struct blk_rq_stat *);
 void blk_rq_stat_init(struct blk_rq_stat *);
 
+void blk_rq_hist_add(struct blk_rq_hist *hist, u64 value);
+u64 blk_rq_hist_percentile(const struct blk_rq_hist *hist, unsigned int pct);
+
+void blk_stage_stat_add(struct request_queue *q, enum blk_stage stage,
+			u64 value);
+void blk_stage_stat_submit(struct request *rq, u64 submit_time_ns);
+int blk_stage_stats_enable(struct request_queue *q);
+void blk_stage_stats_disable(struct request_queue *q);
+u64 blk_stage_stats_read(struct request_queue *q, enum blk_stage stage,
+			 u64 *counts);
+u64 blk_stage_stats_quantile(const u64 *counts, u64 total,
+			     unsigned int permille);
+
 #endif
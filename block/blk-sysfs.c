@@ -16,6 +16,7 @@
 #include "blk-mq-debugfs.h"
 #include "blk-mq-sched.h"
 #include "blk-rq-qos.h"
+#include "blk-stat.h"
 #include "blk-wbt.h"
 #include "blk-cgroup.h"
 #include "blk-throttle.h"
@@ -150,7 +151,6 @@ static ssize_t queue_##_name##_show(struct gendisk *disk, char *page)	\
 /* deprecated fields */
 QUEUE_SYSFS_SHOW_CONST(discard_zeroes_data, 0)
 QUEUE_SYSFS_SHOW_CONST(write_same_max, 0)
-QUEUE_SYSFS_SHOW_CONST(poll_delay, -1)
 
 static ssize_t queue_max_discard_sectors_store(struct gendisk *disk,
 		const char *page, size_t count)
@@ -331,9 +331,41 @@ queue_rq_affinity_store(struct gendisk *disk, const char *page, size_t count)
 	return ret;
 }
 
+static ssize_t queue_poll_delay_show(struct gendisk *disk, char *page)
+{
+	int poll_nsec = READ_ONCE(disk->queue->poll_nsec);
+
+	if (poll_nsec == BLK_MQ_POLL_CLASSIC)
+		return sprintf(page, "%d\n", BLK_MQ_POLL_CLASSIC);
+	return sprintf(page, "%d\n", poll_nsec / NSEC_PER_USEC);
+}
+
 static ssize_t queue_poll_delay_store(struct gendisk *disk, const char *page,
 				size_t count)
 {
+	struct request_queue *q = disk->queue;
+	int err, val, poll_nsec;
+
+	if (!queue_is_mq(q) || !(q->limits.features & BLK_FEAT_POLL))
+		return -EINVAL;
+
+	err = kstrtoint(page, 10, &val);
+	if (err < 0)
+		return err;
+
+	if (val == BLK_MQ_POLL_CLASSIC)
+		poll_nsec = BLK_MQ_POLL_CLASSIC;
+	else if (val >= 0 && val <= INT_MAX / NSEC_PER_USEC)
+		poll_nsec = val * NSEC_PER_USEC;
+	else
+		return -EINVAL;
+
+	/* adaptive hybrid polling sizes its sleep from completion latencies */
+	if (poll_nsec == 0 && q->poll_nsec != 0)
+		blk_stat_enable_accounting(q);
+	else if (poll_nsec != 0 && q->poll_nsec == 0)
+		blk_stat_disable_accounting(q);
+	WRITE_ONCE(q->poll_nsec, poll_nsec);
 	return count;
 }
 
@@ -401,6 +433,55 @@ static ssize_t queue_wc_store(struct gendisk *disk, const char *page,
 	return count;
 }
 
+/*
+ * One line per stage: the stage, the number of samples, and the p50, p90,
+ * p99 and p99.9 latencies in nanoseconds.  Just "0" while the stage
+ * histograms are disabled, writing 1 enables and resets them.
+ */
+static ssize_t queue_stage_stats_show(struct gendisk *disk, char *page)
+{
+	struct request_queue *q = disk->queue;
+	u64 counts[BLK_RQ_HIST_BUCKETS];
+	ssize_t len = 0;
+	u64 total;
+	int stage;
+
+	if (!blk_queue_stage_stats(q))
+		return sprintf(page, "0\n");
+
+	for (stage = 0; stage < BLK_STAGE_NR; stage++) {
+		total = blk_stage_stats_read(q, stage, counts);
+		len += sysfs_emit_at(page, len, "%s %llu %llu %llu %llu %llu\n",
+				blk_stage_name[stage], total,
+				blk_stage_stats_quantile(counts, total, 500),
+				blk_stage_stats_quantile(counts, total, 900),
+				blk_stage_stats_quantile(counts, total, 990),
+				blk_stage_stats_quantile(counts, total, 999));
+	}
+	return len;
+}
+
+static ssize_t queue_stage_stats_store(struct gendisk *disk, const char *page,
+				       size_t count)
+{
+	unsigned long val;
+	ssize_t ret;
+	int err;
+
+	ret = queue_var_store(&val, page, count);
+	if (ret < 0)
+		return ret;
+
+	if (val) {
+		err = blk_stage_stats_enable(disk->queue);
+		if (err)
+			return err;
+	} else {
+		blk_stage_stats_disable(disk->queue);
+	}
+	return ret;
+}
+
 #define QUEUE_RO_ENTRY(_prefix, _name)			\
 static struct queue_sysfs_entry _prefix##_entry = {	\
 	.attr	= { .name = _name, .mode = 0444 },	\
@@ -467,6 +548,7 @@ QUEUE_RW_ENTRY(queue_wc, "write_cache");
 QUEUE_RO_ENTRY(queue_fua, "fua");
 QUEUE_RO_ENTRY(queue_dax, "dax");
 QUEUE_RW_ENTRY(queue_io_timeout, "io_timeout");
+QUEUE_RW_ENTRY(queue_stage_stats, "stage_stats");
 QUEUE_RO_ENTRY(queue_virt_boundary_mask, "virt_boundary_mask");
 QUEUE_RO_ENTRY(queue_dma_alignment, "dma_alignment");
 
@@ -605,6 +687,7 @@ static struct attribute *blk_mq_queue_attrs[] = {
 	&elv_iosched_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_io_timeout_entry.attr,
+	&queue_stage_stats_entry.attr,
 #ifdef CONFIG_BLK_WBT
 	&queue_wb_lat_entry.attr,
 #endif
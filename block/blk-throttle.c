@@ -250,6 +250,10 @@ static struct blkg_policy_data *throtl_pd_alloc(struct gendisk *disk,
 	if (blkg_rwstat_init(&tg->stat_ios, gfp))
 		goto err_exit_stat_bytes;
 
+	tg->tokens = alloc_percpu_gfp(struct throtl_tokens, gfp);
+	if (!tg->tokens)
+		goto err_exit_stat_ios;
+
 	throtl_service_queue_init(&tg->service_queue);
 
 	for (rw = READ; rw <= WRITE; rw++) {
@@ -265,6 +269,8 @@ static struct blkg_policy_data *throtl_pd_alloc(struct gendisk *disk,
 
 	return &tg->pd;
 
+err_exit_stat_ios:
+	blkg_rwstat_exit(&tg->stat_ios);
 err_exit_stat_bytes:
 	blkg_rwstat_exit(&tg->stat_bytes);
 err_free_tg:
@@ -336,6 +342,7 @@ static void throtl_pd_free(struct blkg_policy_data *pd)
 	del_timer_sync(&tg->service_queue.pending_timer);
 	blkg_rwstat_exit(&tg->stat_bytes);
 	blkg_rwstat_exit(&tg->stat_ios);
+	free_percpu(tg->tokens);
 	kfree(tg);
 }
 
@@ -478,6 +485,7 @@ static inline void throtl_start_new_slice_with_credit(struct throtl_grp *tg,
 {
 	tg->bytes_disp[rw] = 0;
 	tg->io_disp[rw] = 0;
+	WRITE_ONCE(tg->tokens_gen[rw], tg->tokens_gen[rw] + 1);
 	tg->carryover_bytes[rw] = 0;
 	tg->carryover_ios[rw] = 0;
 
@@ -502,6 +510,7 @@ static inline void throtl_start_new_slice(struct throtl_grp *tg, bool rw,
 {
 	tg->bytes_disp[rw] = 0;
 	tg->io_disp[rw] = 0;
+	WRITE_ONCE(tg->tokens_gen[rw], tg->tokens_gen[rw] + 1);
 	tg->slice_start[rw] = jiffies;
 	tg->slice_end[rw] = jiffies + tg->td->throtl_slice;
 	if (clear_carryover) {
@@ -819,6 +828,115 @@ static void throtl_charge_bio(struct throtl_grp *tg, struct bio *bio)
 	tg->last_io_disp[rw]++;
 }
 
+/*
+ * Top up this CPU's tokens of @tg from what is left of the current slice.
+ * Each CPU holds at most 1 / (2 * nr_online_cpus) of a slice's budget, so
+ * that the tokens sitting unused on other CPUs can't starve the group.
+ * Called with the queue_lock held.
+ */
+static void tg_refill_tokens(struct throtl_grp *tg, bool rw)
+{
+	struct throtl_tokens *tk = this_cpu_ptr(tg->tokens);
+	unsigned int share = 2 * num_online_cpus();
+	unsigned long slice = tg->td->throtl_slice;
+	u64 bps_limit = tg_bps_limit(tg, rw);
+	u32 iops_limit = tg_iops_limit(tg, rw);
+	unsigned long jiffy_elapsed_rnd;
+	long long bytes_allowed;
+	int io_allowed;
+	u64 bytes;
+	unsigned int ios;
+
+	if (bps_limit == U64_MAX && iops_limit == UINT_MAX)
+		return;
+
+	if (tk->gen[rw] != tg->tokens_gen[rw]) {
+		tk->bytes[rw] = 0;
+		tk->ios[rw] = 0;
+		tk->gen[rw] = tg->tokens_gen[rw];
+	}
+
+	jiffy_elapsed_rnd = roundup(jiffies - tg->slice_start[rw] + 1, slice);
+
+	if (bps_limit != U64_MAX) {
+		bytes = div_u64(calculate_bytes_allowed(bps_limit, slice), share);
+		bytes_allowed = calculate_bytes_allowed(bps_limit,
+							jiffy_elapsed_rnd) +
+				tg->carryover_bytes[rw];
+		if (bytes > tk->bytes[rw] && bytes_allowed > 0 &&
+		    tg->bytes_disp[rw] + bytes - tk->bytes[rw] <= bytes_allowed) {
+			tg->bytes_disp[rw] += bytes - tk->bytes[rw];
+			tk->bytes[rw] = bytes;
+		}
+	}
+
+	if (iops_limit != UINT_MAX) {
+		ios = calculate_io_allowed(iops_limit, slice) / share;
+		io_allowed = calculate_io_allowed(iops_limit, jiffy_elapsed_rnd) +
+			     tg->carryover_ios[rw];
+		if (ios > tk->ios[rw] && io_allowed > 0 &&
+		    tg->io_disp[rw] + ios - tk->ios[rw] <= io_allowed) {
+			tg->io_disp[rw] += ios - tk->ios[rw];
+			tk->ios[rw] = ios;
+		}
+	}
+}
+
+/* Whether this CPU's tokens of @tg cover @bio, only limited resources count */
+static bool tg_tokens_cover(struct throtl_grp *tg, struct bio *bio, bool rw)
+{
+	struct throtl_tokens *tk = this_cpu_ptr(tg->tokens);
+	bool need_bytes = tg_bps_limit(tg, rw) != U64_MAX &&
+			  !bio_flagged(bio, BIO_BPS_THROTTLED);
+	bool need_ios = tg_iops_limit(tg, rw) != UINT_MAX;
+
+	if (!need_bytes && !need_ios)
+		return true;
+	if (tk->gen[rw] != READ_ONCE(tg->tokens_gen[rw]))
+		return false;
+	if (need_bytes && tk->bytes[rw] < throtl_bio_data_size(bio))
+		return false;
+	if (need_ios && !tk->ios[rw])
+		return false;
+	return true;
+}
+
+/*
+ * Lockless fast path: if @bio is covered by this CPU's tokens all the way up
+ * the hierarchy, and nothing is queued that it would overtake, consume the
+ * tokens and let @bio through.  Limit changes racing with this may let one
+ * more bio through on the old budget, which stays within the precision of
+ * the slice accounting.
+ */
+static bool throtl_bio_use_tokens(struct throtl_grp *tg, struct bio *bio)
+{
+	bool rw = bio_data_dir(bio);
+	struct throtl_tokens *tk;
+	struct throtl_grp *pos;
+	unsigned long flags;
+	bool ret = false;
+
+	local_irq_save(flags);
+	for (pos = tg; pos; pos = sq_to_tg(pos->service_queue.parent_sq)) {
+		if (READ_ONCE(pos->service_queue.nr_queued[rw]) ||
+		    !tg_tokens_cover(pos, bio, rw))
+			goto out;
+	}
+
+	for (pos = tg; pos; pos = sq_to_tg(pos->service_queue.parent_sq)) {
+		tk = this_cpu_ptr(pos->tokens);
+		if (tg_bps_limit(pos, rw) != U64_MAX &&
+		    !bio_flagged(bio, BIO_BPS_THROTTLED))
+			tk->bytes[rw] -= throtl_bio_data_size(bio);
+		if (tg_iops_limit(pos, rw) != UINT_MAX)
+			tk->ios[rw]--;
+	}
+	ret = true;
+out:
+	local_irq_restore(flags);
+	return ret;
+}
+
 /**
  * throtl_add_bio_tg - add a bio to the specified throtl_grp
  * @bio: bio to add
@@ -1612,6 +1730,12 @@ bool __blk_throtl_bio(struct bio *bio)
 	struct throtl_data *td = tg->td;
 
 	rcu_read_lock();
+	if (throtl_bio_use_tokens(tg, bio)) {
+		bio_set_flag(bio, BIO_BPS_THROTTLED);
+		rcu_read_unlock();
+		return false;
+	}
+
 	spin_lock_irq(&q->queue_lock);
 	sq = &tg->service_queue;
 
@@ -1632,6 +1756,7 @@ bool __blk_throtl_bio(struct bio *bio)
 			 * So keep on trimming slice even if bio is not queued.
 			 */
 			throtl_trim_slice(tg, rw);
+			tg_refill_tokens(tg, rw);
 		} else if (bio_issue_as_root_blkg(bio)) {
 			/*
 			 * IOs which may cause priority inversions are
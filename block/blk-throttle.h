@@ -58,6 +58,18 @@ enum tg_state_flags {
 	THROTL_TG_CANCELING	= 1 << 2,	/* starts to cancel bio */
 };
 
+/*
+ * Budget pre-charged to a throtl_grp's slice and handed to one CPU, so that
+ * bios within it can pass the group without taking the queue_lock.  The
+ * tokens are only valid while ->gen matches the group's tokens_gen[], which
+ * is bumped whenever the slice the tokens were charged to is discarded.
+ */
+struct throtl_tokens {
+	uint64_t bytes[2];
+	unsigned int ios[2];
+	unsigned int gen[2];
+};
+
 struct throtl_grp {
 	/* must be the first member */
 	struct blkg_policy_data pd;
@@ -120,6 +132,10 @@ struct throtl_grp {
 
 	unsigned long last_check_time;
 
+	/* per-cpu budget pre-charged to bytes_disp[] and io_disp[] */
+	struct throtl_tokens __percpu *tokens;
+	unsigned int tokens_gen[2];
+
 	/* When did we start a new slice */
 	unsigned long slice_start[2];
 	unsigned long slice_end[2];
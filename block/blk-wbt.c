@@ -15,6 +15,13 @@
  *   scaling step of 0 if reads show up or the heavy writers finish. Unlike
  *   positive scaling steps where we shrink the monitoring window, a negative
  *   scaling step retains the default step==0 window size.
+ * - Background writeback is queued per cgroup.  If the latency target is
+ *   exceeded while several cgroups write back, the one that completed more
+ *   than its share of the writes in the window gets its limit halved before
+ *   the whole device is scaled down, and penalties are undone before the
+ *   device is scaled up again.  So a cgroup flooding the device with dirty
+ *   pages is throttled first, and the others keep their throughput.  The
+ *   cgroup queues together stay within the limit of the device.
  *
  * Copyright (C) 2016 Jens Axboe
  *
@@ -24,7 +31,9 @@
 #include <linux/slab.h>
 #include <linux/backing-dev.h>
 #include <linux/swap.h>
+#include <linux/hash.h>
 
+#include "blk-cgroup.h"
 #include "blk-stat.h"
 #include "blk-wbt.h"
 #include "blk-rq-qos.h"
@@ -43,9 +52,23 @@ enum wbt_flags {
 	WBT_NR_BITS		= 4,	/* number of bits */
 };
 
+/*
+ * Background writeback is queued to one of WBT_NR_CG queues by a hash of the
+ * cgroup, which is kept in the wbt_flags bits above WBT_NR_BITS.
+ */
+#ifdef CONFIG_BLK_CGROUP
+#define WBT_CG_BITS		3
+#else
+#define WBT_CG_BITS		0
+#endif
+#define WBT_NR_CG		(1U << WBT_CG_BITS)
+
+/* A cgroup's background limit is shifted down by at most this much */
+#define WBT_CG_MAX_SHIFT	3
+
 enum {
 	WBT_RWQ_BG		= 0,
-	WBT_RWQ_SWAP,
+	WBT_RWQ_SWAP		= WBT_RWQ_BG + WBT_NR_CG,
 	WBT_RWQ_DISCARD,
 	WBT_NUM_RWQ,
 };
@@ -91,6 +114,12 @@ struct rq_wb {
 	struct rq_qos rqos;
 	struct rq_wait rq_wait[WBT_NUM_RWQ];
 	struct rq_depth rq_depth;
+
+	/* per cgroup queue: limit shift and writes completed this window */
+	unsigned int cg_shift[WBT_NR_CG];
+	atomic_t cg_done[WBT_NR_CG];
+	/* background writes in flight on all cgroup queues */
+	atomic_t bg_inflight;
 };
 
 static inline struct rq_wb *RQWB(struct rq_qos *rqos)
@@ -118,6 +147,11 @@ static inline bool wbt_is_read(struct request *rq)
 	return rq->wbt_flags & WBT_READ;
 }
 
+static inline unsigned int wbt_cg(enum wbt_flags wb_acct)
+{
+	return (wb_acct >> WBT_NR_BITS) & (WBT_NR_CG - 1);
+}
+
 enum {
 	/*
 	 * Default setting, we'll scale up (to 75% of QD max) or down (min 1)
@@ -177,7 +211,23 @@ static inline struct rq_wait *get_rq_wait(struct rq_wb *rwb,
 	else if (wb_acct & WBT_DISCARD)
 		return &rwb->rq_wait[WBT_RWQ_DISCARD];
 
-	return &rwb->rq_wait[WBT_RWQ_BG];
+	return &rwb->rq_wait[WBT_RWQ_BG + wbt_cg(wb_acct)];
+}
+
+static inline bool wbt_is_cg_queue(enum wbt_flags wb_acct)
+{
+	return !(wb_acct & (WBT_SWAP | WBT_DISCARD));
+}
+
+/* Scale a background limit down by the cgroup's penalty */
+static inline unsigned int wbt_cg_limit(struct rq_wb *rwb,
+					enum wbt_flags wb_acct,
+					unsigned int limit)
+{
+	if (!wbt_is_cg_queue(wb_acct))
+		return limit;
+
+	return limit ? max(limit >> rwb->cg_shift[wbt_cg(wb_acct)], 1U) : 0;
 }
 
 static void rwb_wake_all(struct rq_wb *rwb)
@@ -192,6 +242,27 @@ static void rwb_wake_all(struct rq_wb *rwb)
 	}
 }
 
+/*
+ * The cgroup queues share the limit of the device, so when a background
+ * write completes, the waiters of the other cgroups may be able to go.
+ */
+static void wbt_bg_done(struct rq_wb *rwb, struct rq_wait *rqw, int limit)
+{
+	int inflight = atomic_dec_return(&rwb->bg_inflight);
+	unsigned int i;
+
+	if (inflight && (inflight >= limit ||
+			 limit - inflight < rwb->wb_background / 2))
+		return;
+
+	for (i = 0; i < WBT_NR_CG; i++) {
+		struct rq_wait *other = &rwb->rq_wait[WBT_RWQ_BG + i];
+
+		if (other != rqw && wq_has_sleeper(&other->wait))
+			wake_up_all(&other->wait);
+	}
+}
+
 static void wbt_rqw_done(struct rq_wb *rwb, struct rq_wait *rqw,
 			 enum wbt_flags wb_acct)
 {
@@ -211,6 +282,9 @@ static void wbt_rqw_done(struct rq_wb *rwb, struct rq_wait *rqw,
 		limit = 0;
 	else
 		limit = rwb->wb_normal;
+	if (wbt_is_cg_queue(wb_acct))
+		wbt_bg_done(rwb, rqw, limit);
+	limit = wbt_cg_limit(rwb, wb_acct, limit);
 
 	/*
 	 * Don't wake anyone up if we are above the normal limit.
@@ -256,6 +330,8 @@ static void wbt_done(struct rq_qos *rqos, struct request *rq)
 			wb_timestamp(rwb, &rwb->last_comp);
 	} else {
 		WARN_ON_ONCE(rq == rwb->sync_cookie);
+		if (wbt_is_cg_queue(wbt_flags(rq)))
+			atomic_inc(&rwb->cg_done[wbt_cg(wbt_flags(rq))]);
 		__wbt_done(rqos, wbt_flags(rq));
 	}
 	wbt_clear_state(rq);
@@ -394,6 +470,74 @@ static void scale_down(struct rq_wb *rwb, bool hard_throttle)
 	rwb_trace_step(rwb, tracepoint_string("scale down"));
 }
 
+/*
+ * The latency target was exceeded: if one cgroup completed more than its
+ * share of the background writes in the window, halve its limit.
+ *
+ * Return: whether a cgroup got throttled, otherwise the device has to be
+ * scaled down.
+ */
+static bool wbt_throttle_top_writer(struct rq_wb *rwb, unsigned int *done)
+{
+	unsigned int i, top = 0, active = 0, total = 0;
+
+	for (i = 0; i < WBT_NR_CG; i++) {
+		if (!done[i])
+			continue;
+		active++;
+		total += done[i];
+		if (done[i] > done[top])
+			top = i;
+	}
+
+	if (active < 2 || done[top] * active <= total ||
+	    rwb->cg_shift[top] >= WBT_CG_MAX_SHIFT)
+		return false;
+
+	rwb->cg_shift[top]++;
+	rwb->unknown_cnt = 0;
+	rwb_trace_step(rwb, tracepoint_string("throttle cgroup"));
+	return true;
+}
+
+/*
+ * Latencies are fine: undo a step of the cgroup penalties.
+ *
+ * Return: whether there were any, otherwise the device can be scaled up.
+ */
+static bool wbt_relax_writers(struct rq_wb *rwb)
+{
+	bool relaxed = false;
+	unsigned int i;
+
+	for (i = 0; i < WBT_NR_CG; i++) {
+		struct rq_wait *rqw = &rwb->rq_wait[WBT_RWQ_BG + i];
+
+		if (!rwb->cg_shift[i])
+			continue;
+		rwb->cg_shift[i]--;
+		relaxed = true;
+		if (wq_has_sleeper(&rqw->wait))
+			wake_up_all(&rqw->wait);
+	}
+
+	if (relaxed) {
+		rwb->unknown_cnt = 0;
+		rwb_trace_step(rwb, tracepoint_string("relax cgroups"));
+	}
+	return relaxed;
+}
+
+static bool wbt_cg_throttled(struct rq_wb *rwb)
+{
+	unsigned int i;
+
+	for (i = 0; i < WBT_NR_CG; i++)
+		if (rwb->cg_shift[i])
+			return true;
+	return false;
+}
+
 static void rwb_arm_timer(struct rq_wb *rwb)
 {
 	struct rq_depth *rqd = &rwb->rq_depth;
@@ -423,11 +567,16 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 	struct rq_wb *rwb = cb->data;
 	struct rq_depth *rqd = &rwb->rq_depth;
 	unsigned int inflight = wbt_inflight(rwb);
+	unsigned int done[WBT_NR_CG];
+	unsigned int i;
 	int status;
 
 	if (!rwb->rqos.disk)
 		return;
 
+	for (i = 0; i < WBT_NR_CG; i++)
+		done[i] = atomic_xchg(&rwb->cg_done[i], 0);
+
 	status = latency_exceeded(rwb, cb->stat);
 
 	trace_wbt_timer(rwb->rqos.disk->bdi, status, rqd->scale_step, inflight);
@@ -439,10 +588,12 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 	 */
 	switch (status) {
 	case LAT_EXCEEDED:
-		scale_down(rwb, true);
+		if (!wbt_throttle_top_writer(rwb, done))
+			scale_down(rwb, true);
 		break;
 	case LAT_OK:
-		scale_up(rwb);
+		if (!wbt_relax_writers(rwb))
+			scale_up(rwb);
 		break;
 	case LAT_UNKNOWN_WRITES:
 		/*
@@ -450,7 +601,8 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 		 * read/write sample, but we do have writes going on.
 		 * Allow step to go negative, to increase write perf.
 		 */
-		scale_up(rwb);
+		if (!wbt_relax_writers(rwb))
+			scale_up(rwb);
 		break;
 	case LAT_UNKNOWN:
 		if (++rwb->unknown_cnt < RWB_UNKNOWN_BUMP)
@@ -470,9 +622,9 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 	}
 
 	/*
-	 * Re-arm timer, if we have IO in flight
+	 * Re-arm timer, if we have IO in flight or cgroups to relax
 	 */
-	if (rqd->scale_step || inflight)
+	if (rqd->scale_step || inflight || wbt_cg_throttled(rwb))
 		rwb_arm_timer(rwb);
 }
 
@@ -482,6 +634,7 @@ static void wbt_update_limits(struct rq_wb *rwb)
 
 	rqd->scale_step = 0;
 	rqd->scaled_max = false;
+	memset(rwb->cg_shift, 0, sizeof(rwb->cg_shift));
 
 	rq_depth_calc_max_depth(rqd);
 	calc_wb_limits(rwb);
@@ -568,7 +721,24 @@ struct wbt_wait_data {
 static bool wbt_inflight_cb(struct rq_wait *rqw, void *private_data)
 {
 	struct wbt_wait_data *data = private_data;
-	return rq_wait_inc_below(rqw, get_limit(data->rwb, data->opf));
+	struct rq_wb *rwb = data->rwb;
+	unsigned int limit = get_limit(rwb, data->opf);
+
+	if (!wbt_is_cg_queue(data->wb_acct))
+		return rq_wait_inc_below(rqw, limit);
+
+	/*
+	 * Each cgroup queue has its own, possibly shifted, limit, and all of
+	 * them together must stay within the limit of the device.  Racing
+	 * writers of different cgroups may overshoot the shared limit by a
+	 * request or so, like the limits of the other rq_qos users.
+	 */
+	if (atomic_read(&rwb->bg_inflight) >= limit ||
+	    !rq_wait_inc_below(rqw, wbt_cg_limit(rwb, data->wb_acct, limit)))
+		return false;
+
+	atomic_inc(&rwb->bg_inflight);
+	return true;
 }
 
 static void wbt_cleanup_cb(struct rq_wait *rqw, void *private_data)
@@ -612,6 +782,15 @@ static inline bool wbt_should_throttle(struct bio *bio)
 	}
 }
 
+static unsigned int wbt_bio_cg(struct bio *bio)
+{
+#ifdef CONFIG_BLK_CGROUP
+	if (bio->bi_blkg)
+		return hash_32(bio->bi_blkg->blkcg->css.id, WBT_CG_BITS);
+#endif
+	return 0;
+}
+
 static enum wbt_flags bio_to_wbt_flags(struct rq_wb *rwb, struct bio *bio)
 {
 	enum wbt_flags flags = 0;
@@ -626,7 +805,7 @@ static enum wbt_flags bio_to_wbt_flags(struct rq_wb *rwb, struct bio *bio)
 			flags |= WBT_SWAP;
 		if (bio_op(bio) == REQ_OP_DISCARD)
 			flags |= WBT_DISCARD;
-		flags |= WBT_TRACKED;
+		flags |= WBT_TRACKED | (wbt_bio_cg(bio) << WBT_NR_BITS);
 	}
 	return flags;
 }
@@ -824,6 +1003,17 @@ static int wbt_inflight_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int wbt_cg_shift_show(void *data, struct seq_file *m)
+{
+	struct rq_qos *rqos = data;
+	struct rq_wb *rwb = RQWB(rqos);
+	int i;
+
+	for (i = 0; i < WBT_NR_CG; i++)
+		seq_printf(m, "%d: shift %u\n", i, rwb->cg_shift[i]);
+	return 0;
+}
+
 static int wbt_min_lat_nsec_show(void *data, struct seq_file *m)
 {
 	struct rq_qos *rqos = data;
@@ -865,6 +1055,7 @@ static const struct blk_mq_debugfs_attr wbt_debugfs_attrs[] = {
 	{"enabled", 0400, wbt_enabled_show},
 	{"id", 0400, wbt_id_show},
 	{"inflight", 0400, wbt_inflight_show},
+	{"cg_shift", 0400, wbt_cg_shift_show},
 	{"min_lat_nsec", 0400, wbt_min_lat_nsec_show},
 	{"unknown_cnt", 0400, wbt_unknown_cnt_show},
 	{"wb_normal", 0400, wbt_normal_show},
@@ -906,6 +1097,8 @@ int wbt_init(struct gendisk *disk)
 
 	for (i = 0; i < WBT_NUM_RWQ; i++)
 		rq_wait_init(&rwb->rq_wait[i]);
+	for (i = 0; i < WBT_NR_CG; i++)
+		atomic_set(&rwb->cg_done[i], 0);
 
 	rwb->last_comp = rwb->last_issue = jiffies;
 	rwb->win_nsec = RWB_WINDOW_NSEC;
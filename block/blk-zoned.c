@@ -55,6 +55,8 @@ static const char *const zone_cond_name[] = {
  * @zone_no: The number of the zone the plug is managing.
  * @wp_offset: The zone write pointer location relative to the start of the zone
  *             as a number of 512B sectors.
+ * @nr_inflight: The number of write requests (or BIOs for BIO-based devices)
+ *               issued from the plug and not completed yet.
  * @bio_list: The list of BIOs that are currently plugged.
  * @bio_work: Work struct to handle issuing of plugged BIOs
  * @rcu_head: RCU head to free zone write plugs with an RCU grace period.
@@ -67,6 +69,7 @@ struct blk_zone_wplug {
 	unsigned int		flags;
 	unsigned int		zone_no;
 	unsigned int		wp_offset;
+	unsigned int		nr_inflight;
 	struct bio_list		bio_list;
 	struct work_struct	bio_work;
 	struct rcu_head		rcu_head;
@@ -92,6 +95,12 @@ struct blk_zone_wplug {
 #define BLK_ZONE_WPLUG_NEED_WP_UPDATE	(1U << 1)
 #define BLK_ZONE_WPLUG_UNHASHED		(1U << 2)
 
+/*
+ * Maximum number of writes in flight per zone for devices that execute zone
+ * writes in the order they are dispatched.
+ */
+#define BLK_ZONE_WPLUG_MAX_INFLIGHT	8
+
 /**
  * blk_zone_cond_str - Return string XXX in BLK_ZONE_COND_XXX.
  * @zone_cond: BLK_ZONE_COND_XXX.
@@ -569,6 +578,7 @@ static struct blk_zone_wplug *disk_get_and_lock_zone_wplug(struct gendisk *disk,
 	zwplug->flags = 0;
 	zwplug->zone_no = zno;
 	zwplug->wp_offset = bdev_offset_from_zone_start(disk->part0, sector);
+	zwplug->nr_inflight = 0;
 	bio_list_init(&zwplug->bio_list);
 	INIT_WORK(&zwplug->bio_work, blk_zone_wplug_bio_work);
 	zwplug->disk = disk;
@@ -756,17 +766,38 @@ static bool blk_zone_wplug_handle_reset_all(struct bio *bio)
 	return false;
 }
 
+/*
+ * Return how many writes a zone write plug may have in flight. Writes can only
+ * be pipelined if nothing between the plug and the media can reorder them:
+ * the driver must execute zone writes in dispatch order without requeueing
+ * them, and the requests must go through a single hardware queue without an
+ * I/O scheduler. All pipelined writes are then issued in order from the plug
+ * BIO work.
+ */
+static unsigned int disk_zone_wplug_max_inflight(struct gendisk *disk)
+{
+	struct request_queue *q = disk->queue;
+
+	if (!(q->limits.features & BLK_FEAT_ORDERED_ZONE_WRITES) ||
+	    !queue_is_mq(q) || q->nr_hw_queues != 1 || q->elevator)
+		return 1;
+	return BLK_ZONE_WPLUG_MAX_INFLIGHT;
+}
+
 static void disk_zone_wplug_schedule_bio_work(struct gendisk *disk,
 					      struct blk_zone_wplug *zwplug)
 {
 	/*
 	 * Take a reference on the zone write plug and schedule the submission
 	 * of the next plugged BIO. blk_zone_wplug_bio_work() will release the
-	 * reference we take here.
+	 * reference we take here. With pipelined writes, several completions
+	 * may schedule the work before it runs, in which case the work already
+	 * holds its reference.
 	 */
 	WARN_ON_ONCE(!(zwplug->flags & BLK_ZONE_WPLUG_PLUGGED));
 	refcount_inc(&zwplug->ref);
-	queue_work(disk->zone_wplugs_wq, &zwplug->bio_work);
+	if (!queue_work(disk->zone_wplugs_wq, &zwplug->bio_work))
+		refcount_dec(&zwplug->ref);
 }
 
 static inline void disk_zone_wplug_add_bio(struct gendisk *disk,
@@ -816,6 +847,10 @@ static inline void disk_zone_wplug_add_bio(struct gendisk *disk,
 
 	zwplug->flags |= BLK_ZONE_WPLUG_PLUGGED;
 
+	/* With pipelined writes, issue the BIO if the plug has room for it. */
+	if (zwplug->nr_inflight < disk_zone_wplug_max_inflight(disk))
+		schedule_bio_work = true;
+
 	if (schedule_bio_work)
 		disk_zone_wplug_schedule_bio_work(disk, zwplug);
 }
@@ -1028,11 +1063,13 @@ static bool blk_zone_wplug_handle_write(struct bio *bio, unsigned int nr_segs)
 	/*
 	 * If the zone is already plugged, add the BIO to the plug BIO list.
 	 * Do the same for REQ_NOWAIT BIOs to ensure that we will not see a
-	 * BLK_STS_AGAIN failure if we let the BIO execute.
+	 * BLK_STS_AGAIN failure if we let the BIO execute, and for pipelined
+	 * writes, which must all be issued in order from the plug BIO work.
 	 * Otherwise, plug and let the BIO execute.
 	 */
 	if ((zwplug->flags & BLK_ZONE_WPLUG_PLUGGED) ||
-	    (bio->bi_opf & REQ_NOWAIT))
+	    (bio->bi_opf & REQ_NOWAIT) ||
+	    disk_zone_wplug_max_inflight(disk) > 1)
 		goto plug;
 
 	if (!blk_zone_wplug_prepare_bio(zwplug, bio)) {
@@ -1042,6 +1079,7 @@ static bool blk_zone_wplug_handle_write(struct bio *bio, unsigned int nr_segs)
 	}
 
 	zwplug->flags |= BLK_ZONE_WPLUG_PLUGGED;
+	zwplug->nr_inflight++;
 
 	spin_unlock_irqrestore(&zwplug->lock, flags);
 
@@ -1139,9 +1177,19 @@ static void disk_zone_wplug_unplug_bio(struct gendisk *disk,
 
 	spin_lock_irqsave(&zwplug->lock, flags);
 
+	if (!WARN_ON_ONCE(!zwplug->nr_inflight))
+		zwplug->nr_inflight--;
+
 	/* Schedule submission of the next plugged BIO if we have one. */
 	if (!bio_list_empty(&zwplug->bio_list)) {
-		disk_zone_wplug_schedule_bio_work(disk, zwplug);
+		if (zwplug->nr_inflight < disk_zone_wplug_max_inflight(disk))
+			disk_zone_wplug_schedule_bio_work(disk, zwplug);
+		spin_unlock_irqrestore(&zwplug->lock, flags);
+		return;
+	}
+
+	/* Pipelined writes are still being executed. */
+	if (zwplug->nr_inflight) {
 		spin_unlock_irqrestore(&zwplug->lock, flags);
 		return;
 	}
@@ -1233,20 +1281,28 @@ static void blk_zone_wplug_bio_work(struct work_struct *work)
 {
 	struct blk_zone_wplug *zwplug =
 		container_of(work, struct blk_zone_wplug, bio_work);
+	unsigned int max_inflight = disk_zone_wplug_max_inflight(zwplug->disk);
 	struct block_device *bdev;
 	unsigned long flags;
 	struct bio *bio;
 
 	/*
-	 * Submit the next plugged BIO. If we do not have any, clear
-	 * the plugged flag.
+	 * Submit the next plugged BIOs, as many as the plug may have in flight.
+	 * If we do not have any and nothing is in flight, clear the plugged
+	 * flag.
 	 */
 	spin_lock_irqsave(&zwplug->lock, flags);
 
 again:
+	if (zwplug->nr_inflight >= max_inflight) {
+		spin_unlock_irqrestore(&zwplug->lock, flags);
+		goto put_zwplug;
+	}
+
 	bio = bio_list_pop(&zwplug->bio_list);
 	if (!bio) {
-		zwplug->flags &= ~BLK_ZONE_WPLUG_PLUGGED;
+		if (!zwplug->nr_inflight)
+			zwplug->flags &= ~BLK_ZONE_WPLUG_PLUGGED;
 		spin_unlock_irqrestore(&zwplug->lock, flags);
 		goto put_zwplug;
 	}
@@ -1256,6 +1312,7 @@ static void blk_zone_wplug_bio_work(struct work_struct *work)
 		goto again;
 	}
 
+	zwplug->nr_inflight++;
 	spin_unlock_irqrestore(&zwplug->lock, flags);
 
 	bdev = bio->bi_bdev;
@@ -1270,6 +1327,9 @@ static void blk_zone_wplug_bio_work(struct work_struct *work)
 	if (bdev_test_flag(bdev, BD_HAS_SUBMIT_BIO))
 		blk_queue_exit(bdev->bd_disk->queue);
 
+	spin_lock_irqsave(&zwplug->lock, flags);
+	goto again;
+
 put_zwplug:
 	/* Drop the reference we took in disk_zone_wplug_schedule_bio_work(). */
 	disk_put_zone_wplug(zwplug);
@@ -1801,7 +1861,7 @@ int queue_zone_wplugs_show(void *data, struct seq_file *m)
 	struct request_queue *q = data;
 	struct gendisk *disk = q->disk;
 	struct blk_zone_wplug *zwplug;
-	unsigned int zwp_wp_offset, zwp_flags;
+	unsigned int zwp_wp_offset, zwp_flags, zwp_nr_inflight;
 	unsigned int zwp_zone_no, zwp_ref;
 	unsigned int zwp_bio_list_size, i;
 	unsigned long flags;
@@ -1818,12 +1878,14 @@ int queue_zone_wplugs_show(void *data, struct seq_file *m)
 			zwp_flags = zwplug->flags;
 			zwp_ref = refcount_read(&zwplug->ref);
 			zwp_wp_offset = zwplug->wp_offset;
+			zwp_nr_inflight = zwplug->nr_inflight;
 			zwp_bio_list_size = bio_list_size(&zwplug->bio_list);
 			spin_unlock_irqrestore(&zwplug->lock, flags);
 
-			seq_printf(m, "%u 0x%x %u %u %u\n",
+			seq_printf(m, "%u 0x%x %u %u %u %u\n",
 				   zwp_zone_no, zwp_flags, zwp_ref,
-				   zwp_wp_offset, zwp_bio_list_size);
+				   zwp_wp_offset, zwp_bio_list_size,
+				   zwp_nr_inflight);
 		}
 	}
 	rcu_read_unlock();
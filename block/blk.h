@@ -337,6 +337,20 @@ ssize_t part_timeout_show(struct device *, struct device_attribute *, char *);
 ssize_t part_timeout_store(struct device *, struct device_attribute *,
 				const char *, size_t);
 
+enum blk_split_reason {
+	BLK_SPLIT_SIZE,		/* max_sectors, chunk_sectors and the like */
+	BLK_SPLIT_SEGMENTS,	/* max_segments */
+	BLK_SPLIT_GAP,		/* virt_boundary_mask */
+	BLK_SPLIT_DISCARD,
+	BLK_SPLIT_WRITE_ZEROES,
+	BLK_SPLIT_NR_REASONS,
+};
+
+/* Number of bios split per reason, shown in debugfs */
+struct blk_split_stats {
+	unsigned long		nr[BLK_SPLIT_NR_REASONS];
+};
+
 struct bio *bio_split_discard(struct bio *bio, const struct queue_limits *lim,
 		unsigned *nsegs);
 struct bio *bio_split_write_zeroes(struct bio *bio,
@@ -38,6 +38,18 @@ static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
 
+/*
+ * Number of hardware queues that share one scheduling domain, 0 for a single
+ * domain per request queue. Every domain has its own lock, sort lists and
+ * FIFOs, so that dispatch from different groups of hardware queues doesn't
+ * serialize. Requests expire against the FIFO of their own domain only, and
+ * scheduler merging is left to plug merging. Applies when the scheduler is
+ * attached to a request queue.
+ */
+static unsigned int hctxs_per_domain;
+module_param(hctxs_per_domain, uint, 0644);
+MODULE_PARM_DESC(hctxs_per_domain, "hardware queues per scheduling domain, 0 for one domain per queue");
+
 enum dd_data_dir {
 	DD_READ		= READ,
 	DD_WRITE	= WRITE,
@@ -101,9 +113,30 @@ struct deadline_data {
 	u32 async_depth;
 	int prio_aging_expire;
 
+	/* one of several domains, see hctxs_per_domain */
+	bool sharded;
+
 	spinlock_t lock;
 };
 
+/* elevator_data, the domains of a request queue */
+struct dd_domains {
+	unsigned int hctxs_per_domain;
+	unsigned int nr;
+	struct deadline_data *dd[];
+};
+
+/*
+ * The domain for request queue wide state, only meaningful with a single
+ * domain. Sysfs and debugfs attributes show the first domain.
+ */
+static inline struct deadline_data *dd_queue_data(struct request_queue *q)
+{
+	struct dd_domains *domains = q->elevator->elevator_data;
+
+	return domains->dd[0];
+}
+
 /* Maps an I/O priority class to a deadline scheduler priority. */
 static const enum dd_prio ioprio_class_to_prio[] = {
 	[IOPRIO_CLASS_NONE]	= DD_BE_PRIO,
@@ -189,7 +222,7 @@ static void deadline_remove_request(struct request_queue *q,
 static void dd_request_merged(struct request_queue *q, struct request *req,
 			      enum elv_merge type)
 {
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = req->mq_hctx->sched_data;
 	const u8 ioprio_class = dd_rq_ioclass(req);
 	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];
@@ -209,7 +242,7 @@ static void dd_request_merged(struct request_queue *q, struct request *req,
 static void dd_merged_requests(struct request_queue *q, struct request *req,
 			       struct request *next)
 {
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = req->mq_hctx->sched_data;
 	const u8 ioprio_class = dd_rq_ioclass(next);
 	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
 
@@ -457,11 +490,11 @@ static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
  * One confusing aspect here is that we get called for a specific
  * hardware queue, but we may return a request that is for a
  * different hardware queue. This is because mq-deadline has shared
- * state for all hardware queues, in terms of sorting, FIFOs, etc.
+ * state for all hardware queues of a domain, in terms of sorting, FIFOs, etc.
  */
 static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 {
-	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct deadline_data *dd = hctx->sched_data;
 	const unsigned long now = jiffies;
 	struct request *rq;
 	enum dd_prio prio;
@@ -507,7 +540,7 @@ static int dd_to_word_depth(struct blk_mq_hw_ctx *hctx, unsigned int qdepth)
  */
 static void dd_limit_depth(blk_opf_t opf, struct blk_mq_alloc_data *data)
 {
-	struct deadline_data *dd = data->q->elevator->elevator_data;
+	struct deadline_data *dd = data->hctx->sched_data;
 
 	/* Do not throttle synchronous reads. */
 	if (op_is_sync(opf) && !op_is_write(opf))
@@ -524,7 +557,7 @@ static void dd_limit_depth(blk_opf_t opf, struct blk_mq_alloc_data *data)
 static void dd_depth_updated(struct blk_mq_hw_ctx *hctx)
 {
 	struct request_queue *q = hctx->queue;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = hctx->sched_data;
 	struct blk_mq_tags *tags = hctx->sched_tags;
 
 	dd->async_depth = q->nr_requests;
@@ -535,13 +568,15 @@ static void dd_depth_updated(struct blk_mq_hw_ctx *hctx)
 /* Called by blk_mq_init_hctx() and blk_mq_init_sched(). */
 static int dd_init_hctx(struct blk_mq_hw_ctx *hctx, unsigned int hctx_idx)
 {
+	struct dd_domains *domains = hctx->queue->elevator->elevator_data;
+
+	hctx->sched_data = domains->dd[hctx_idx / domains->hctxs_per_domain];
 	dd_depth_updated(hctx);
 	return 0;
 }
 
-static void dd_exit_sched(struct elevator_queue *e)
+static void dd_free_domain(struct deadline_data *dd)
 {
-	struct deadline_data *dd = e->elevator_data;
 	enum dd_prio prio;
 
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
@@ -565,25 +600,25 @@ static void dd_exit_sched(struct elevator_queue *e)
 	kfree(dd);
 }
 
-/*
- * initialize elevator private data (deadline_data).
- */
-static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
+static void dd_exit_sched(struct elevator_queue *e)
+{
+	struct dd_domains *domains = e->elevator_data;
+	unsigned int i;
+
+	for (i = 0; i < domains->nr; i++)
+		dd_free_domain(domains->dd[i]);
+	kfree(domains);
+}
+
+static struct deadline_data *dd_alloc_domain(struct request_queue *q,
+					     bool sharded)
 {
 	struct deadline_data *dd;
-	struct elevator_queue *eq;
 	enum dd_prio prio;
-	int ret = -ENOMEM;
-
-	eq = elevator_alloc(q, e);
-	if (!eq)
-		return ret;
 
 	dd = kzalloc_node(sizeof(*dd), GFP_KERNEL, q->node);
 	if (!dd)
-		goto put_eq;
-
-	eq->elevator_data = dd;
+		return NULL;
 
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
 		struct dd_per_prio *per_prio = &dd->per_prio[prio];
@@ -601,14 +636,60 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	dd->last_dir = DD_WRITE;
 	dd->fifo_batch = fifo_batch;
 	dd->prio_aging_expire = prio_aging_expire;
+	dd->sharded = sharded;
 	spin_lock_init(&dd->lock);
 
-	/* We dispatch from request queue wide instead of hw queue */
-	blk_queue_flag_set(QUEUE_FLAG_SQ_SCHED, q);
+	return dd;
+}
+
+/*
+ * initialize elevator private data (deadline_data).
+ */
+static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
+{
+	unsigned int per_domain = READ_ONCE(hctxs_per_domain);
+	struct dd_domains *domains;
+	struct elevator_queue *eq;
+	unsigned int i, nr;
+	int ret = -ENOMEM;
+
+	if (!per_domain || per_domain > q->nr_hw_queues)
+		per_domain = q->nr_hw_queues;
+	nr = DIV_ROUND_UP(q->nr_hw_queues, per_domain);
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return ret;
+
+	domains = kzalloc_node(struct_size(domains, dd, nr), GFP_KERNEL,
+			       q->node);
+	if (!domains)
+		goto put_eq;
+	domains->hctxs_per_domain = per_domain;
+
+	for (i = 0; i < nr; i++) {
+		domains->dd[i] = dd_alloc_domain(q, nr > 1);
+		if (!domains->dd[i])
+			goto free_domains;
+		domains->nr++;
+	}
+
+	eq->elevator_data = domains;
+
+	/*
+	 * With a single domain we dispatch from request queue wide instead
+	 * of hw queue.
+	 */
+	if (nr == 1)
+		blk_queue_flag_set(QUEUE_FLAG_SQ_SCHED, q);
 
 	q->elevator = eq;
 	return 0;
 
+free_domains:
+	for (i = 0; i < domains->nr; i++)
+		kfree(domains->dd[i]);
+	kfree(domains);
 put_eq:
 	kobject_put(&eq->kobj);
 	return ret;
@@ -621,7 +702,7 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 static int dd_request_merge(struct request_queue *q, struct request **rq,
 			    struct bio *bio)
 {
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = dd_queue_data(q);
 	const u8 ioprio_class = IOPRIO_PRIO_CLASS(bio->bi_ioprio);
 	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];
@@ -653,10 +734,14 @@ static int dd_request_merge(struct request_queue *q, struct request **rq,
 static bool dd_bio_merge(struct request_queue *q, struct bio *bio,
 		unsigned int nr_segs)
 {
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = dd_queue_data(q);
 	struct request *free = NULL;
 	bool ret;
 
+	/* the elevator merge hash and q->last_merge are queue wide */
+	if (dd->sharded)
+		return false;
+
 	spin_lock(&dd->lock);
 	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
 	spin_unlock(&dd->lock);
@@ -674,7 +759,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 			      blk_insert_t flags, struct list_head *free)
 {
 	struct request_queue *q = hctx->queue;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = hctx->sched_data;
 	const enum dd_data_dir data_dir = rq_data_dir(rq);
 	u16 ioprio = req_get_ioprio(rq);
 	u8 ioprio_class = IOPRIO_PRIO_CLASS(ioprio);
@@ -690,7 +775,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		rq->elv.priv[0] = (void *)(uintptr_t)1;
 	}
 
-	if (blk_mq_sched_try_insert_merge(q, rq, free))
+	if (!dd->sharded && blk_mq_sched_try_insert_merge(q, rq, free))
 		return;
 
 	trace_block_rq_insert(rq);
@@ -703,7 +788,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 
 		deadline_add_rq_rb(per_prio, rq);
 
-		if (rq_mergeable(rq)) {
+		if (!dd->sharded && rq_mergeable(rq)) {
 			elv_rqhash_add(q, rq);
 			if (!q->last_merge)
 				q->last_merge = rq;
@@ -725,8 +810,7 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 			       struct list_head *list,
 			       blk_insert_t flags)
 {
-	struct request_queue *q = hctx->queue;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = hctx->sched_data;
 	LIST_HEAD(free);
 
 	spin_lock(&dd->lock);
@@ -753,8 +837,7 @@ static void dd_prepare_request(struct request *rq)
  */
 static void dd_finish_request(struct request *rq)
 {
-	struct request_queue *q = rq->q;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = rq->mq_hctx->sched_data;
 	const u8 ioprio_class = dd_rq_ioclass(rq);
 	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];
@@ -777,7 +860,7 @@ static bool dd_has_work_for_prio(struct dd_per_prio *per_prio)
 
 static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 {
-	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
+	struct deadline_data *dd = hctx->sched_data;
 	enum dd_prio prio;
 
 	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
@@ -793,7 +876,8 @@ static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 #define SHOW_INT(__FUNC, __VAR)						\
 static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
 {									\
-	struct deadline_data *dd = e->elevator_data;			\
+	struct dd_domains *domains = e->elevator_data;			\
+	struct deadline_data *dd = domains->dd[0];			\
 									\
 	return sysfs_emit(page, "%d\n", __VAR);				\
 }
@@ -811,8 +895,10 @@ SHOW_INT(deadline_fifo_batch_show, dd->fifo_batch);
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
 static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
 {									\
-	struct deadline_data *dd = e->elevator_data;			\
+	struct dd_domains *domains = e->elevator_data;			\
+	struct deadline_data *dd;					\
 	int __data, __ret;						\
+	unsigned int i;							\
 									\
 	__ret = kstrtoint(page, 0, &__data);				\
 	if (__ret < 0)							\
@@ -821,7 +907,10 @@ static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)
 		__data = (MIN);						\
 	else if (__data > (MAX))					\
 		__data = (MAX);						\
-	*(__PTR) = __CONV(__data);					\
+	for (i = 0; i < domains->nr; i++) {				\
+		dd = domains->dd[i];					\
+		*(__PTR) = __CONV(__data);				\
+	}								\
 	return count;							\
 }
 #define STORE_INT(__FUNC, __PTR, MIN, MAX)				\
@@ -860,7 +949,7 @@ static void *deadline_##name##_fifo_start(struct seq_file *m,		\
 	__acquires(&dd->lock)						\
 {									\
 	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct deadline_data *dd = dd_queue_data(q);			\
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];		\
 									\
 	spin_lock(&dd->lock);						\
@@ -871,7 +960,7 @@ static void *deadline_##name##_fifo_next(struct seq_file *m, void *v,	\
 					 loff_t *pos)			\
 {									\
 	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct deadline_data *dd = dd_queue_data(q);			\
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];		\
 									\
 	return seq_list_next(v, &per_prio->fifo_list[data_dir], pos);	\
@@ -881,7 +970,7 @@ static void deadline_##name##_fifo_stop(struct seq_file *m, void *v)	\
 	__releases(&dd->lock)						\
 {									\
 	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct deadline_data *dd = dd_queue_data(q);			\
 									\
 	spin_unlock(&dd->lock);						\
 }									\
@@ -897,7 +986,7 @@ static int deadline_##name##_next_rq_show(void *data,			\
 					  struct seq_file *m)		\
 {									\
 	struct request_queue *q = data;					\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct deadline_data *dd = dd_queue_data(q);			\
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];		\
 	struct request *rq;						\
 									\
@@ -919,7 +1008,7 @@ DEADLINE_DEBUGFS_DDIR_ATTRS(DD_IDLE_PRIO, DD_WRITE, write2);
 static int deadline_batching_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = dd_queue_data(q);
 
 	seq_printf(m, "%u\n", dd->batching);
 	return 0;
@@ -928,7 +1017,7 @@ static int deadline_batching_show(void *data, struct seq_file *m)
 static int deadline_starved_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = dd_queue_data(q);
 
 	seq_printf(m, "%u\n", dd->starved);
 	return 0;
@@ -937,7 +1026,7 @@ static int deadline_starved_show(void *data, struct seq_file *m)
 static int dd_async_depth_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = dd_queue_data(q);
 
 	seq_printf(m, "%u\n", dd->async_depth);
 	return 0;
@@ -946,7 +1035,7 @@ static int dd_async_depth_show(void *data, struct seq_file *m)
 static int dd_queued_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = dd_queue_data(q);
 	u32 rt, be, idle;
 
 	spin_lock(&dd->lock);
@@ -974,7 +1063,7 @@ static u32 dd_owned_by_driver(struct deadline_data *dd, enum dd_prio prio)
 static int dd_owned_by_driver_show(void *data, struct seq_file *m)
 {
 	struct request_queue *q = data;
-	struct deadline_data *dd = q->elevator->elevator_data;
+	struct deadline_data *dd = dd_queue_data(q);
 	u32 rt, be, idle;
 
 	spin_lock(&dd->lock);
@@ -994,7 +1083,7 @@ static void *deadline_dispatch##prio##_start(struct seq_file *m,	\
 	__acquires(&dd->lock)						\
 {									\
 	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct deadline_data *dd = dd_queue_data(q);			\
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];		\
 									\
 	spin_lock(&dd->lock);						\
@@ -1005,7 +1094,7 @@ static void *deadline_dispatch##prio##_next(struct seq_file *m,		\
 					    void *v, loff_t *pos)	\
 {									\
 	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct deadline_data *dd = dd_queue_data(q);			\
 	struct dd_per_prio *per_prio = &dd->per_prio[prio];		\
 									\
 	return seq_list_next(v, &per_prio->dispatch, pos);		\
@@ -1015,7 +1104,7 @@ static void deadline_dispatch##prio##_stop(struct seq_file *m, void *v)	\
 	__releases(&dd->lock)						\
 {									\
 	struct request_queue *q = m->private;				\
-	struct deadline_data *dd = q->elevator->elevator_data;		\
+	struct deadline_data *dd = dd_queue_data(q);			\
 									\
 	spin_unlock(&dd->lock);						\
 }									\
@@ -105,6 +105,76 @@ int crypto_aead_decrypt(struct aead_request *req)
 }
 EXPORT_SYMBOL_GPL(crypto_aead_decrypt);
 
+static bool crypto_aead_batch_nokey(struct crypto_aead *aead, int *errs,
+				    unsigned int n)
+{
+	unsigned int i;
+
+	if (!(crypto_aead_get_flags(aead) & CRYPTO_TFM_NEED_KEY))
+		return false;
+
+	for (i = 0; i < n; i++)
+		errs[i] = -ENOKEY;
+	return true;
+}
+
+void crypto_aead_encrypt_batch(struct aead_request **reqs, int *errs,
+			       unsigned int n)
+{
+	struct crypto_aead *aead;
+	struct aead_alg *alg;
+	unsigned int i;
+
+	if (!n)
+		return;
+
+	aead = crypto_aead_reqtfm(reqs[0]);
+	alg = crypto_aead_alg(aead);
+
+	if (crypto_aead_batch_nokey(aead, errs, n))
+		return;
+
+	if (alg->encrypt_batch) {
+		alg->encrypt_batch(reqs, errs, n);
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+		errs[i] = alg->encrypt(reqs[i]);
+}
+EXPORT_SYMBOL_NS_GPL(crypto_aead_encrypt_batch, CRYPTO_INTERNAL);
+
+void crypto_aead_decrypt_batch(struct aead_request **reqs, int *errs,
+			       unsigned int n)
+{
+	struct crypto_aead *aead;
+	struct aead_alg *alg;
+	unsigned int i;
+
+	if (!n)
+		return;
+
+	aead = crypto_aead_reqtfm(reqs[0]);
+	alg = crypto_aead_alg(aead);
+
+	if (crypto_aead_batch_nokey(aead, errs, n))
+		return;
+
+	/* Let the rare batch with a short request take the slow path */
+	for (i = 0; i < n; i++)
+		if (reqs[i]->cryptlen < crypto_aead_authsize(aead))
+			break;
+
+	if (alg->decrypt_batch && i == n) {
+		alg->decrypt_batch(reqs, errs, n);
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+		errs[i] = crypto_aead_decrypt(reqs[i]);
+}
+EXPORT_SYMBOL_NS_GPL(crypto_aead_decrypt_batch, CRYPTO_INTERNAL);
+
 static void crypto_aead_exit_tfm(struct crypto_tfm *tfm)
 {
 	struct crypto_aead *aead = __crypto_aead_cast(tfm);
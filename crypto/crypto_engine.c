@@ -18,6 +18,8 @@
 #include <linux/device.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/overflow.h>
+#include <linux/smp.h>
 #include <uapi/linux/sched/types.h>
 #include "internal.h"
 
@@ -466,34 +468,14 @@ int crypto_engine_stop(struct crypto_engine *engine)
 }
 EXPORT_SYMBOL_GPL(crypto_engine_stop);
 
-/**
- * crypto_engine_alloc_init_and_set - allocate crypto hardware engine structure
- * and initialize it by setting the maximum number of entries in the software
- * crypto-engine queue.
- * @dev: the device attached with one hardware engine
- * @retry_support: whether hardware has support for retry mechanism
- * @cbk_do_batch: pointer to a callback function to be invoked when executing
- *                a batch of requests.
- *                This has the form:
- *                callback(struct crypto_engine *engine)
- *                where:
- *                engine: the crypto engine structure.
- * @rt: whether this queue is set to run as a realtime task
- * @qlen: maximum size of the crypto-engine queue
- *
- * This must be called from context that can sleep.
- * Return: the crypto engine structure on success, else NULL.
- */
-struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
-						       bool retry_support,
-						       int (*cbk_do_batch)(struct crypto_engine *engine),
-						       bool rt, int qlen)
+static struct crypto_engine *
+crypto_engine_create(struct device *dev, unsigned int hw_queue, bool mq,
+		     bool retry_support,
+		     int (*cbk_do_batch)(struct crypto_engine *engine),
+		     bool rt, int qlen)
 {
 	struct crypto_engine *engine;
 
-	if (!dev)
-		return NULL;
-
 	engine = devm_kzalloc(dev, sizeof(*engine), GFP_KERNEL);
 	if (!engine)
 		return NULL;
@@ -510,9 +492,14 @@ struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
 	 * hardware has support for retry mechanism.
 	 */
 	engine->do_batch_requests = retry_support ? cbk_do_batch : NULL;
+	engine->hw_queue = hw_queue;
 
-	snprintf(engine->name, sizeof(engine->name),
-		 "%s-engine", dev_name(dev));
+	if (mq)
+		snprintf(engine->name, sizeof(engine->name),
+			 "%s-engine%u", dev_name(dev), hw_queue);
+	else
+		snprintf(engine->name, sizeof(engine->name),
+			 "%s-engine", dev_name(dev));
 
 	crypto_init_queue(&engine->queue, qlen);
 	spin_lock_init(&engine->queue_lock);
@@ -531,6 +518,36 @@ struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
 
 	return engine;
 }
+
+/**
+ * crypto_engine_alloc_init_and_set - allocate crypto hardware engine structure
+ * and initialize it by setting the maximum number of entries in the software
+ * crypto-engine queue.
+ * @dev: the device attached with one hardware engine
+ * @retry_support: whether hardware has support for retry mechanism
+ * @cbk_do_batch: pointer to a callback function to be invoked when executing
+ *                a batch of requests.
+ *                This has the form:
+ *                callback(struct crypto_engine *engine)
+ *                where:
+ *                engine: the crypto engine structure.
+ * @rt: whether this queue is set to run as a realtime task
+ * @qlen: maximum size of the crypto-engine queue
+ *
+ * This must be called from context that can sleep.
+ * Return: the crypto engine structure on success, else NULL.
+ */
+struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
+						       bool retry_support,
+						       int (*cbk_do_batch)(struct crypto_engine *engine),
+						       bool rt, int qlen)
+{
+	if (!dev)
+		return NULL;
+
+	return crypto_engine_create(dev, 0, false, retry_support,
+				    cbk_do_batch, rt, qlen);
+}
 EXPORT_SYMBOL_GPL(crypto_engine_alloc_init_and_set);
 
 /**
@@ -565,6 +582,170 @@ void crypto_engine_exit(struct crypto_engine *engine)
 }
 EXPORT_SYMBOL_GPL(crypto_engine_exit);
 
+/**
+ * crypto_engine_hw_queue - hardware queue fed by an engine
+ * @engine: the hardware engine, e.g. as passed to do_one_request()
+ *
+ * Return: the index of the hardware queue @engine was allocated for by
+ * crypto_engine_mq_alloc_init_and_set(), 0 for a single queue engine.
+ */
+unsigned int crypto_engine_hw_queue(struct crypto_engine *engine)
+{
+	return engine->hw_queue;
+}
+EXPORT_SYMBOL_GPL(crypto_engine_hw_queue);
+
+/**
+ * crypto_engine_mq_alloc_init_and_set - allocate a multi-queue crypto engine
+ * @dev: the device attached with the hardware queues
+ * @nr_hw_queues: number of hardware queues (rings) of the device
+ * @retry_support: see crypto_engine_alloc_init_and_set()
+ * @cbk_do_batch: see crypto_engine_alloc_init_and_set()
+ * @rt: see crypto_engine_alloc_init_and_set()
+ * @qlen: maximum size of the software queue of each hardware queue
+ *
+ * Allocate one crypto engine per hardware queue, each with its own software
+ * queue, lock and request pump, and map every possible CPU onto one of them,
+ * keeping neighbouring CPUs on the same hardware queue.  Drivers submit a
+ * request to the engine of the current CPU with crypto_engine_mq_get() and
+ * find the hardware queue to use in do_one_request() with
+ * crypto_engine_hw_queue().
+ *
+ * This must be called from context that can sleep.
+ * Return: the multi-queue engine on success, else NULL.
+ */
+struct crypto_engine_mq *crypto_engine_mq_alloc_init_and_set(struct device *dev,
+							     unsigned int nr_hw_queues,
+							     bool retry_support,
+							     int (*cbk_do_batch)(struct crypto_engine *engine),
+							     bool rt, int qlen)
+{
+	struct crypto_engine_mq *mq;
+	unsigned int i;
+	int cpu;
+
+	if (!dev || !nr_hw_queues)
+		return NULL;
+
+	mq = devm_kzalloc(dev, struct_size(mq, engines, nr_hw_queues),
+			  GFP_KERNEL);
+	if (!mq)
+		return NULL;
+
+	mq->cpu_map = devm_kcalloc(dev, nr_cpu_ids, sizeof(*mq->cpu_map),
+				   GFP_KERNEL);
+	if (!mq->cpu_map)
+		return NULL;
+
+	for_each_possible_cpu(cpu)
+		mq->cpu_map[cpu] = (u64)cpu * nr_hw_queues / nr_cpu_ids;
+
+	for (i = 0; i < nr_hw_queues; i++) {
+		mq->engines[i] = crypto_engine_create(dev, i, true,
+						      retry_support,
+						      cbk_do_batch, rt, qlen);
+		if (!mq->engines[i])
+			goto err;
+	}
+	mq->nr_hw_queues = nr_hw_queues;
+
+	return mq;
+
+err:
+	while (i--)
+		kthread_destroy_worker(mq->engines[i]->kworker);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(crypto_engine_mq_alloc_init_and_set);
+
+/**
+ * crypto_engine_mq_start - start all queues of a multi-queue engine
+ * @mq: the multi-queue engine
+ *
+ * Return 0 on success, else on fail.
+ */
+int crypto_engine_mq_start(struct crypto_engine_mq *mq)
+{
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < mq->nr_hw_queues; i++) {
+		ret = crypto_engine_start(mq->engines[i]);
+		if (ret)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	while (i--)
+		crypto_engine_stop(mq->engines[i]);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(crypto_engine_mq_start);
+
+/**
+ * crypto_engine_mq_stop - stop all queues of a multi-queue engine
+ * @mq: the multi-queue engine
+ *
+ * Return 0 on success, else the error of the last queue failing to stop.
+ */
+int crypto_engine_mq_stop(struct crypto_engine_mq *mq)
+{
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < mq->nr_hw_queues; i++) {
+		int err = crypto_engine_stop(mq->engines[i]);
+
+		if (err)
+			ret = err;
+	}
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(crypto_engine_mq_stop);
+
+/**
+ * crypto_engine_mq_exit - free the resources of a multi-queue engine
+ * @mq: the multi-queue engine
+ */
+void crypto_engine_mq_exit(struct crypto_engine_mq *mq)
+{
+	unsigned int i;
+
+	for (i = 0; i < mq->nr_hw_queues; i++)
+		crypto_engine_exit(mq->engines[i]);
+}
+EXPORT_SYMBOL_GPL(crypto_engine_mq_exit);
+
+/**
+ * crypto_engine_mq_get - engine for requests submitted on this CPU
+ * @mq: the multi-queue engine
+ *
+ * The result is only a placement hint, the caller may be migrated after
+ * the lookup and still use the returned engine.
+ */
+struct crypto_engine *crypto_engine_mq_get(struct crypto_engine_mq *mq)
+{
+	return mq->engines[mq->cpu_map[raw_smp_processor_id()]];
+}
+EXPORT_SYMBOL_GPL(crypto_engine_mq_get);
+
+/**
+ * crypto_engine_mq_queue - engine of one hardware queue
+ * @mq: the multi-queue engine
+ * @hw_queue: index of the hardware queue
+ *
+ * E.g. to finalize a request from the completion handler of @hw_queue.
+ */
+struct crypto_engine *crypto_engine_mq_queue(struct crypto_engine_mq *mq,
+					     unsigned int hw_queue)
+{
+	return mq->engines[hw_queue];
+}
+EXPORT_SYMBOL_GPL(crypto_engine_mq_queue);
+
 int crypto_engine_register_aead(struct aead_engine_alg *alg)
 {
 	if (!alg->op.do_one_request)
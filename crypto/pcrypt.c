@@ -15,22 +15,29 @@
 #include <linux/slab.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/topology.h>
 #include <crypto/pcrypt.h>
 
 static struct padata_instance *pencrypt;
 static struct padata_instance *pdecrypt;
 static struct kset           *pcrypt_kset;
 
+/*
+ * One padata shell per NUMA node and direction.  Each tfm is pinned to the
+ * node of its callback CPU, so the requests of one flow are parallelized
+ * and reordered within that node only.
+ */
 struct pcrypt_instance_ctx {
 	struct crypto_aead_spawn spawn;
-	struct padata_shell *psenc;
-	struct padata_shell *psdec;
+	struct padata_shell **psenc;
+	struct padata_shell **psdec;
 	atomic_t tfm_count;
 };
 
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
 	unsigned int cb_cpu;
+	int node;
 };
 
 static inline struct pcrypt_instance_ctx *pcrypt_tfm_ictx(
@@ -114,7 +121,7 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
-	err = padata_do_parallel(ictx->psenc, padata, &ctx->cb_cpu);
+	err = padata_do_parallel(ictx->psenc[ctx->node], padata, &ctx->cb_cpu);
 	if (!err)
 		return -EINPROGRESS;
 	if (err == -EBUSY) {
@@ -165,7 +172,7 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
-	err = padata_do_parallel(ictx->psdec, padata, &ctx->cb_cpu);
+	err = padata_do_parallel(ictx->psdec[ctx->node], padata, &ctx->cb_cpu);
 	if (!err)
 		return -EINPROGRESS;
 	if (err == -EBUSY) {
@@ -190,6 +197,7 @@ static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 	ctx->cb_cpu = cpumask_first(cpu_online_mask);
 	for (cpu = 0; cpu < cpu_index; cpu++)
 		ctx->cb_cpu = cpumask_next(ctx->cb_cpu, cpu_online_mask);
+	ctx->node = cpu_to_node(ctx->cb_cpu);
 
 	cipher = crypto_spawn_aead(&ictx->spawn);
 
@@ -211,13 +219,45 @@ static void pcrypt_aead_exit_tfm(struct crypto_aead *tfm)
 	crypto_free_aead(ctx->child);
 }
 
+static void pcrypt_free_shells(struct padata_shell **ps)
+{
+	int node;
+
+	if (!ps)
+		return;
+
+	for_each_node(node)
+		padata_free_shell(ps[node]);
+	kfree(ps);
+}
+
+static struct padata_shell **pcrypt_alloc_shells(struct padata_instance *pinst)
+{
+	struct padata_shell **ps;
+	int node;
+
+	ps = kcalloc(nr_node_ids, sizeof(*ps), GFP_KERNEL);
+	if (!ps)
+		return NULL;
+
+	for_each_node(node) {
+		ps[node] = padata_alloc_shell_node(pinst, node);
+		if (!ps[node]) {
+			pcrypt_free_shells(ps);
+			return NULL;
+		}
+	}
+
+	return ps;
+}
+
 static void pcrypt_free(struct aead_instance *inst)
 {
 	struct pcrypt_instance_ctx *ctx = aead_instance_ctx(inst);
 
 	crypto_drop_aead(&ctx->spawn);
-	padata_free_shell(ctx->psdec);
-	padata_free_shell(ctx->psenc);
+	pcrypt_free_shells(ctx->psdec);
+	pcrypt_free_shells(ctx->psenc);
 	kfree(inst);
 }
 
@@ -253,11 +293,11 @@ static int pcrypt_create_aead(struct crypto_template *tmpl, struct rtattr **tb,
 	err = -ENOMEM;
 
 	ctx = aead_instance_ctx(inst);
-	ctx->psenc = padata_alloc_shell(pencrypt);
+	ctx->psenc = pcrypt_alloc_shells(pencrypt);
 	if (!ctx->psenc)
 		goto err_free_inst;
 
-	ctx->psdec = padata_alloc_shell(pdecrypt);
+	ctx->psdec = pcrypt_alloc_shells(pdecrypt);
 	if (!ctx->psdec)
 		goto err_free_inst;
 
@@ -327,6 +327,56 @@ static int simd_aead_decrypt(struct aead_request *req)
 	return crypto_aead_decrypt(subreq);
 }
 
+/* Number of requests handed to the child at once by the batch helpers */
+#define SIMD_AEAD_BATCH		16
+
+static void simd_aead_crypt_batch(struct aead_request **reqs, int *errs,
+				  unsigned int n, bool enc)
+{
+	struct crypto_aead *tfm = crypto_aead_reqtfm(reqs[0]);
+	struct simd_aead_ctx *ctx = crypto_aead_ctx(tfm);
+	struct aead_request *subreqs[SIMD_AEAD_BATCH];
+	struct crypto_aead *child;
+	unsigned int i, j, nr;
+
+	if (!crypto_simd_usable() ||
+	    (in_atomic() && cryptd_aead_queued(ctx->cryptd_tfm))) {
+		for (i = 0; i < n; i++)
+			errs[i] = enc ? simd_aead_encrypt(reqs[i]) :
+					simd_aead_decrypt(reqs[i]);
+		return;
+	}
+
+	child = cryptd_aead_child(ctx->cryptd_tfm);
+
+	for (i = 0; i < n; i += nr) {
+		nr = min(n - i, SIMD_AEAD_BATCH);
+
+		for (j = 0; j < nr; j++) {
+			subreqs[j] = aead_request_ctx(reqs[i + j]);
+			*subreqs[j] = *reqs[i + j];
+			aead_request_set_tfm(subreqs[j], child);
+		}
+
+		if (enc)
+			crypto_aead_encrypt_batch(subreqs, errs + i, nr);
+		else
+			crypto_aead_decrypt_batch(subreqs, errs + i, nr);
+	}
+}
+
+static void simd_aead_encrypt_batch(struct aead_request **reqs, int *errs,
+				    unsigned int n)
+{
+	simd_aead_crypt_batch(reqs, errs, n, true);
+}
+
+static void simd_aead_decrypt_batch(struct aead_request **reqs, int *errs,
+				    unsigned int n)
+{
+	simd_aead_crypt_batch(reqs, errs, n, false);
+}
+
 static void simd_aead_exit(struct crypto_aead *tfm)
 {
 	struct simd_aead_ctx *ctx = crypto_aead_ctx(tfm);
@@ -407,6 +457,8 @@ static struct simd_aead_alg *simd_aead_create_compat(struct aead_alg *ialg,
 	alg->setauthsize = simd_aead_setauthsize;
 	alg->encrypt = simd_aead_encrypt;
 	alg->decrypt = simd_aead_decrypt;
+	alg->encrypt_batch = simd_aead_encrypt_batch;
+	alg->decrypt_batch = simd_aead_decrypt_batch;
 
 	err = crypto_register_aead(alg);
 	if (err)
@@ -479,3 +531,4 @@ EXPORT_SYMBOL_GPL(simd_unregister_aeads);
 
 MODULE_DESCRIPTION("Shared crypto SIMD helpers");
 MODULE_LICENSE("GPL");
+MODULE_IMPORT_NS(CRYPTO_INTERNAL);
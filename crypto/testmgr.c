@@ -33,6 +33,7 @@
 #include <crypto/akcipher.h>
 #include <crypto/kpp.h>
 #include <crypto/acompress.h>
+#include <crypto/internal/aead.h>
 #include <crypto/internal/cipher.h>
 #include <crypto/internal/simd.h>
 
@@ -1439,6 +1440,128 @@ static int test_shash_vec_cfg(const struct hash_testvec *vec,
 				 driver, cfg);
 }
 
+/*
+ * Test crypto_shash_finup_mb() against crypto_shash_finup().  The messages share
+ * the first @split bytes of the test vector.  The first one continues with the
+ * rest of the vector, the others with a variation of it, and each digest must
+ * match the one a finup() from the same state gives.
+ */
+static int test_shash_vec_finup_mb(const struct hash_testvec *vec,
+				   const char *vec_name, unsigned int split,
+				   bool nosimd, struct shash_desc *desc,
+				   u8 *hashstate)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	const unsigned int digestsize = crypto_shash_digestsize(tfm);
+	const unsigned int num_msgs = crypto_shash_mb_max_msgs(tfm);
+	const unsigned int len = vec->psize - split;
+	const char *driver = crypto_shash_driver_name(tfm);
+	u8 expected[HASH_MAX_MB_MSGS][HASH_MAX_DIGESTSIZE];
+	u8 result[HASH_MAX_MB_MSGS][HASH_MAX_DIGESTSIZE];
+	const u8 *data[HASH_MAX_MB_MSGS];
+	u8 *outs[HASH_MAX_MB_MSGS];
+	u8 *bufs;
+	unsigned int i, j;
+	int err;
+
+	bufs = kmalloc_array(num_msgs, max(len, 1U), GFP_KERNEL);
+	if (!bufs)
+		return -ENOMEM;
+
+	for (i = 0; i < num_msgs; i++) {
+		for (j = 0; j < len; j++)
+			bufs[i * len + j] = vec->plaintext[split + j] ^ i;
+		data[i] = &bufs[i * len];
+		outs[i] = result[i];
+	}
+
+	/* The state all messages continue from, and their digests one by one */
+	err = crypto_shash_init(desc);
+	if (!err)
+		err = crypto_shash_update(desc, vec->plaintext, split);
+	if (!err)
+		err = crypto_shash_export(desc, hashstate);
+	for (i = 0; i < num_msgs && !err; i++) {
+		err = crypto_shash_import(desc, hashstate);
+		if (!err)
+			err = crypto_shash_finup(desc, data[i], len,
+						 expected[i]);
+	}
+	if (err) {
+		pr_err("alg: shash: %s failed with err %d hashing test vector %s one message at a time, split=%u\n",
+		       driver, err, vec_name, split);
+		goto out;
+	}
+	if (memcmp(expected[0], vec->digest, digestsize)) {
+		pr_err("alg: shash: %s finup() test failed for test vector %s, split=%u\n",
+		       driver, vec_name, split);
+		err = -EINVAL;
+		goto out;
+	}
+
+	testmgr_poison(result, sizeof(result));
+	err = crypto_shash_import(desc, hashstate);
+	if (err)
+		goto out;
+	if (nosimd)
+		crypto_disable_simd_for_test();
+	err = crypto_shash_finup_mb(desc, data, len, outs, num_msgs);
+	if (nosimd)
+		crypto_reenable_simd_for_test();
+	if (err) {
+		pr_err("alg: shash: %s finup_mb() failed with err %d on test vector %s, split=%u, nosimd=%d\n",
+		       driver, err, vec_name, split, nosimd);
+		goto out;
+	}
+
+	for (i = 0; i < num_msgs; i++) {
+		if (memcmp(result[i], expected[i], digestsize)) {
+			pr_err("alg: shash: %s finup_mb() gave the wrong digest for message %u of test vector %s, split=%u, nosimd=%d\n",
+			       driver, i, vec_name, split, nosimd);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+out:
+	kfree(bufs);
+	return err;
+}
+
+static int test_shash_finup_mb(const struct hash_testvec *vec,
+			       unsigned int vec_num, struct shash_desc *desc,
+			       u8 *hashstate)
+{
+	const unsigned int splits[] = { 0, 1, vec->psize / 2, vec->psize };
+	char vec_name[16];
+	unsigned int i;
+	int err;
+
+	if (crypto_shash_mb_max_msgs(desc->tfm) < 2 || vec->setkey_error ||
+	    vec->digest_error)
+		return 0;
+
+	sprintf(vec_name, "%u", vec_num);
+
+	if (vec->ksize) {
+		err = crypto_shash_setkey(desc->tfm, vec->key, vec->ksize);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(splits); i++) {
+		if (splits[i] > vec->psize)
+			continue;
+		err = test_shash_vec_finup_mb(vec, vec_name, splits[i], false,
+					      desc, hashstate);
+		if (!err)
+			err = test_shash_vec_finup_mb(vec, vec_name, splits[i],
+						      true, desc, hashstate);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
 static int do_ahash_op(int (*op)(struct ahash_request *req),
 		       struct ahash_request *req,
 		       struct crypto_wait *wait, bool nosimd)
@@ -1991,6 +2114,11 @@ static int __alg_test_hash(const struct hash_testvec *vecs,
 		err = test_hash_vec(&vecs[i], i, req, desc, tsgl, hashstate);
 		if (err)
 			goto out;
+		if (desc) {
+			err = test_shash_finup_mb(&vecs[i], i, desc, hashstate);
+			if (err)
+				goto out;
+		}
 		cond_resched();
 	}
 	err = test_hash_vs_generic_impl(generic_driver, maxkeysize, req,
@@ -2689,6 +2817,132 @@ static int test_aead(int enc, const struct aead_test_suite *suite,
 	return 0;
 }
 
+/* Number of copies of a test vector passed to the AEAD batch functions */
+#define AEAD_BATCH_SIZE		4
+
+/*
+ * Run copies of a test vector through crypto_aead_{en,de}crypt_batch(), each
+ * in its own linear buffer, and check every request on its own.
+ */
+static int test_aead_vec_batch(int enc, const struct aead_testvec *vec,
+			       unsigned int vec_num, struct crypto_aead *tfm,
+			       bool nosimd)
+{
+	const unsigned int ivsize = crypto_aead_ivsize(tfm);
+	const unsigned int inlen = enc ? vec->plen : vec->clen;
+	const unsigned int outlen = enc ? vec->clen : vec->plen;
+	const char *driver = crypto_aead_driver_name(tfm);
+	const char *op = enc ? "encryption" : "decryption";
+	struct aead_request *reqs[AEAD_BATCH_SIZE] = {};
+	struct crypto_wait waits[AEAD_BATCH_SIZE];
+	struct scatterlist sgs[AEAD_BATCH_SIZE];
+	u8 ivs[AEAD_BATCH_SIZE][MAX_IVLEN];
+	u8 *bufs[AEAD_BATCH_SIZE] = {};
+	int errs[AEAD_BATCH_SIZE];
+	unsigned int i;
+	int err;
+
+	if ((enc && vec->novrfy) || vec->setkey_error || vec->setauthsize_error)
+		return 0;
+	if (WARN_ON(ivsize > MAX_IVLEN))
+		return -EINVAL;
+
+	if (vec->wk)
+		crypto_aead_set_flags(tfm, CRYPTO_TFM_REQ_FORBID_WEAK_KEYS);
+	else
+		crypto_aead_clear_flags(tfm, CRYPTO_TFM_REQ_FORBID_WEAK_KEYS);
+	err = crypto_aead_setkey(tfm, vec->key, vec->klen);
+	if (!err)
+		err = crypto_aead_setauthsize(tfm, vec->clen - vec->plen);
+	if (err) {
+		pr_err("alg: aead: %s batch setkey failed on test vector %u; err=%d\n",
+		       driver, vec_num, err);
+		return err;
+	}
+
+	for (i = 0; i < AEAD_BATCH_SIZE; i++) {
+		reqs[i] = aead_request_alloc(tfm, GFP_KERNEL);
+		bufs[i] = kmalloc(vec->alen + max(inlen, outlen) + 1, GFP_KERNEL);
+		if (!reqs[i] || !bufs[i]) {
+			err = -ENOMEM;
+			goto out;
+		}
+
+		memcpy(bufs[i], vec->assoc, vec->alen);
+		memcpy(bufs[i] + vec->alen, enc ? vec->ptext : vec->ctext, inlen);
+		if (vec->iv)
+			memcpy(ivs[i], vec->iv, ivsize);
+		else
+			memset(ivs[i], 0, ivsize);
+		sg_init_one(&sgs[i], bufs[i], vec->alen + max(inlen, outlen));
+
+		crypto_init_wait(&waits[i]);
+		aead_request_set_callback(reqs[i], CRYPTO_TFM_REQ_MAY_BACKLOG,
+					  crypto_req_done, &waits[i]);
+		aead_request_set_crypt(reqs[i], &sgs[i], &sgs[i], inlen, ivs[i]);
+		aead_request_set_ad(reqs[i], vec->alen);
+	}
+
+	if (nosimd)
+		crypto_disable_simd_for_test();
+	if (enc)
+		crypto_aead_encrypt_batch(reqs, errs, AEAD_BATCH_SIZE);
+	else
+		crypto_aead_decrypt_batch(reqs, errs, AEAD_BATCH_SIZE);
+	if (nosimd)
+		crypto_reenable_simd_for_test();
+
+	for (i = 0; i < AEAD_BATCH_SIZE; i++)
+		errs[i] = crypto_wait_req(errs[i], &waits[i]);
+
+	for (i = 0; i < AEAD_BATCH_SIZE; i++) {
+		if (vec->novrfy ? errs[i] != -EBADMSG && errs[i] != vec->crypt_error :
+				  errs[i] != vec->crypt_error) {
+			pr_err("alg: aead: %s batch %s failed on test vector %u, request %u; expected_error=%d, actual_error=%d, nosimd=%d\n",
+			       driver, op, vec_num, i,
+			       vec->novrfy ? -EBADMSG : vec->crypt_error,
+			       errs[i], nosimd);
+			err = errs[i] ?: -EINVAL;
+			goto out;
+		}
+		if (errs[i])
+			continue;
+		if (memcmp(bufs[i] + vec->alen, enc ? vec->ctext : vec->ptext,
+			   outlen)) {
+			pr_err("alg: aead: %s batch %s test failed (wrong result) on test vector %u, request %u, nosimd=%d\n",
+			       driver, op, vec_num, i, nosimd);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+out:
+	for (i = 0; i < AEAD_BATCH_SIZE; i++) {
+		kfree(bufs[i]);
+		aead_request_free(reqs[i]);
+	}
+	return err;
+}
+
+static int test_aead_batch(int enc, const struct aead_test_suite *suite,
+			   struct crypto_aead *tfm)
+{
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < suite->count; i++) {
+		err = test_aead_vec_batch(enc, &suite->vecs[i], i, tfm, false);
+#ifdef CONFIG_CRYPTO_MANAGER_EXTRA_TESTS
+		if (!err && !noextratests)
+			err = test_aead_vec_batch(enc, &suite->vecs[i], i, tfm,
+						  true);
+#endif
+		if (err)
+			return err;
+		cond_resched();
+	}
+	return 0;
+}
+
 static int alg_test_aead(const struct alg_test_desc *desc, const char *driver,
 			 u32 type, u32 mask)
 {
@@ -2737,6 +2991,14 @@ static int alg_test_aead(const struct alg_test_desc *desc, const char *driver,
 	if (err)
 		goto out;
 
+	err = test_aead_batch(ENCRYPT, suite, tfm);
+	if (err)
+		goto out;
+
+	err = test_aead_batch(DECRYPT, suite, tfm);
+	if (err)
+		goto out;
+
 	err = test_aead_extra(desc, req, tsgls);
 out:
 	free_cipher_test_sglists(tsgls);
@@ -973,6 +973,7 @@ static int hmat_calculate_adistance(struct notifier_block *self,
 	mutex_unlock(&target_lock);
 
 	perf = &target->coord[ACCESS_COORDINATE_CPU];
+	mt_set_node_perf(nid, perf);
 
 	if (mt_perf_to_adistance(perf, adist))
 		return NOTIFY_OK;
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Device latency emulation for irqmode=2 (timer completion).
+ *
+ * completion_nsec is the median service time of a command.  On top of it
+ * the following configfs attributes shape how commands are served:
+ *
+ *   latency_sigma	service times are lognormally distributed with this
+ *			shape parameter, in 1/1000 units (0: fixed)
+ *   tail_nsec		service time of a latency spike
+ *   tail_permille	per mille of the commands that hit a spike; with a
+ *			fixed service time this gives a bimodal distribution
+ *   channels		number of channels serving commands one at a time,
+ *			commands map to channels by 64KiB stripes
+ *   gc_interval_mb	every gc_interval_mb of writes, all channels stall ...
+ *   gc_stall_nsec	... for gc_stall_nsec
+ *   write_cache_nsec	the device has a volatile write cache: writes complete
+ *			after write_cache_nsec while their service time is spent
+ *			in the background, and a flush completes once all
+ *			channels are idle
+ */
+#include <linux/math64.h>
+#include <linux/random.h>
+#include "null_blk.h"
+
+/* 64KiB channel stripes */
+#define NULL_CHANNEL_STRIPE_SHIFT	(16 - SECTOR_SHIFT)
+
+/* How far a channel may fall behind before cached writes have to wait */
+#define NULL_WRITE_CACHE_BACKLOG_NSEC	(10 * NSEC_PER_MSEC)
+
+struct nullb_channel {
+	spinlock_t lock;
+	/* time the last command queued on the channel is done */
+	u64 busy_until;
+} ____cacheline_aligned_in_smp;
+
+int null_init_latency(struct nullb *nullb)
+{
+	struct nullb_device *dev = nullb->dev;
+	unsigned int i;
+
+	if (!dev->channels)
+		return 0;
+
+	nullb->channels = kcalloc_node(dev->channels, sizeof(*nullb->channels),
+				       GFP_KERNEL, dev->home_node);
+	if (!nullb->channels)
+		return -ENOMEM;
+
+	for (i = 0; i < dev->channels; i++)
+		spin_lock_init(&nullb->channels[i].lock);
+	atomic64_set(&nullb->gc_written, 0);
+
+	return 0;
+}
+
+void null_free_latency(struct nullb *nullb)
+{
+	kfree(nullb->channels);
+	nullb->channels = NULL;
+}
+
+/* 2^(f / 2^16) in 16.16 fixed point, for 0 <= f < 2^16 */
+static u64 null_exp2_frac(u64 f)
+{
+	u64 p = 3638;			/* ln(2)^3 / 6 */
+
+	p = 15743 + ((p * f) >> 16);	/* ln(2)^2 / 2 */
+	p = 45426 + ((p * f) >> 16);	/* ln(2) */
+	return 65536 + ((p * f) >> 16);
+}
+
+static u64 null_lognormal(u64 median, unsigned int sigma)
+{
+	s64 z = 0, x;
+	int i, n;
+	u64 v;
+
+	/* The sum of 12 uniform samples, minus 6, is close enough to N(0, 1) */
+	for (i = 0; i < 6; i++) {
+		u32 r = get_random_u32();
+
+		z += (r & 0xffff) + (r >> 16);
+	}
+	z -= 6 << 16;
+
+	/* median * e^(sigma * z) = median * 2^(sigma * z * log2(e)) */
+	x = div_s64(z * sigma, 1000);
+	x = div_s64(x * 94548, 65536);
+	n = x >> 16;
+
+	v = (median * null_exp2_frac(x & 0xffff)) >> 16;
+	if (n >= 0)
+		return v << n;
+	return v >> -n;
+}
+
+static void null_gc_stall(struct nullb *nullb, u64 now)
+{
+	struct nullb_device *dev = nullb->dev;
+	struct nullb_channel *ch;
+	unsigned int i;
+
+	for (i = 0; i < dev->channels; i++) {
+		ch = &nullb->channels[i];
+		spin_lock(&ch->lock);
+		ch->busy_until = max(ch->busy_until, now) + dev->gc_stall_nsec;
+		spin_unlock(&ch->lock);
+	}
+}
+
+/* Time until all channels are idle */
+static u64 null_channels_busy(struct nullb *nullb, u64 now)
+{
+	u64 busy_until = now;
+	unsigned int i;
+
+	for (i = 0; i < nullb->dev->channels; i++)
+		busy_until = max(busy_until,
+				 READ_ONCE(nullb->channels[i].busy_until));
+
+	return busy_until - now;
+}
+
+/**
+ * null_cmd_latency - time until a command completes
+ * @cmd: the command, done processing
+ *
+ * Return: the delay in ns.
+ */
+u64 null_cmd_latency(struct nullb_cmd *cmd)
+{
+	struct request *rq = blk_mq_rq_from_pdu(cmd);
+	struct nullb_device *dev = cmd->nq->dev;
+	struct nullb *nullb = dev->nullb;
+	u64 service = dev->completion_nsec;
+	struct nullb_channel *ch;
+	u64 now, start, done;
+
+	if (dev->latency_sigma)
+		service = null_lognormal(service, dev->latency_sigma);
+	if (dev->tail_permille &&
+	    get_random_u32_below(1000) < dev->tail_permille)
+		service = dev->tail_nsec;
+
+	if (!nullb->channels)
+		return service;
+
+	now = ktime_get_ns();
+	if (req_op(rq) == REQ_OP_FLUSH && dev->write_cache_nsec)
+		return null_channels_busy(nullb, now);
+
+	if (op_is_write(req_op(rq)) && dev->gc_interval_mb && dev->gc_stall_nsec) {
+		u64 interval = (u64)dev->gc_interval_mb << 20;
+		u64 written = atomic64_add_return(blk_rq_bytes(rq),
+						  &nullb->gc_written);
+
+		if (div64_u64(written - blk_rq_bytes(rq), interval) !=
+		    div64_u64(written, interval))
+			null_gc_stall(nullb, now);
+	}
+
+	ch = &nullb->channels[(blk_rq_pos(rq) >> NULL_CHANNEL_STRIPE_SHIFT) %
+			      dev->channels];
+	spin_lock(&ch->lock);
+	start = max(ch->busy_until, now);
+	done = start + service;
+	ch->busy_until = done;
+	spin_unlock(&ch->lock);
+
+	if (dev->write_cache_nsec && op_is_write(req_op(rq)) &&
+	    !(rq->cmd_flags & REQ_FUA) &&
+	    start - now < NULL_WRITE_CACHE_BACKLOG_NSEC)
+		return dev->write_cache_nsec;
+
+	return done - now;
+}
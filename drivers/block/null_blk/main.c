@@ -468,6 +468,13 @@ NULLB_DEVICE_ATTR(no_sched, bool, NULL);
 NULLB_DEVICE_ATTR(shared_tags, bool, NULL);
 NULLB_DEVICE_ATTR(shared_tag_bitmap, bool, NULL);
 NULLB_DEVICE_ATTR(fua, bool, NULL);
+NULLB_DEVICE_ATTR(latency_sigma, uint, NULL);
+NULLB_DEVICE_ATTR(tail_nsec, ulong, NULL);
+NULLB_DEVICE_ATTR(tail_permille, uint, NULL);
+NULLB_DEVICE_ATTR(channels, uint, NULL);
+NULLB_DEVICE_ATTR(gc_interval_mb, uint, NULL);
+NULLB_DEVICE_ATTR(gc_stall_nsec, ulong, NULL);
+NULLB_DEVICE_ATTR(write_cache_nsec, ulong, NULL);
 
 static ssize_t nullb_device_power_show(struct config_item *item, char *page)
 {
@@ -621,6 +628,13 @@ static struct configfs_attribute *nullb_device_attrs[] = {
 	&nullb_device_attr_shared_tags,
 	&nullb_device_attr_shared_tag_bitmap,
 	&nullb_device_attr_fua,
+	&nullb_device_attr_latency_sigma,
+	&nullb_device_attr_tail_nsec,
+	&nullb_device_attr_tail_permille,
+	&nullb_device_attr_channels,
+	&nullb_device_attr_gc_interval_mb,
+	&nullb_device_attr_gc_stall_nsec,
+	&nullb_device_attr_write_cache_nsec,
 	NULL,
 };
 
@@ -699,12 +713,14 @@ nullb_group_drop_item(struct config_group *group, struct config_item *item)
 static ssize_t memb_group_features_show(struct config_item *item, char *page)
 {
 	return snprintf(page, PAGE_SIZE,
-			"badblocks,blocking,blocksize,cache_size,fua,"
-			"completion_nsec,discard,home_node,hw_queue_depth,"
-			"irqmode,max_sectors,mbps,memory_backed,no_sched,"
+			"badblocks,blocking,blocksize,cache_size,channels,fua,"
+			"completion_nsec,discard,gc_interval_mb,gc_stall_nsec,"
+			"home_node,hw_queue_depth,irqmode,latency_sigma,"
+			"max_sectors,mbps,memory_backed,no_sched,"
 			"poll_queues,power,queue_mode,shared_tag_bitmap,"
-			"shared_tags,size,submit_queues,use_per_node_hctx,"
-			"virt_boundary,zoned,zone_capacity,zone_max_active,"
+			"shared_tags,size,submit_queues,tail_nsec,tail_permille,"
+			"use_per_node_hctx,virt_boundary,write_cache_nsec,"
+			"zoned,zone_capacity,zone_max_active,"
 			"zone_max_open,zone_nr_conv,zone_offline,zone_readonly,"
 			"zone_size,zone_append_max_sectors,zone_full\n");
 }
@@ -817,7 +833,9 @@ static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
 
 static void null_cmd_end_timer(struct nullb_cmd *cmd)
 {
-	ktime_t kt = cmd->nq->dev->completion_nsec;
+	struct nullb_device *dev = cmd->nq->dev;
+	ktime_t kt = null_latency_enabled(dev) ? null_cmd_latency(cmd) :
+						 dev->completion_nsec;
 
 	hrtimer_start(&cmd->timer, kt, HRTIMER_MODE_REL);
 }
@@ -1717,6 +1735,7 @@ static void null_del_dev(struct nullb *nullb)
 	kfree(nullb->queues);
 	if (null_cache_active(nullb))
 		null_free_device_storage(nullb->dev, true);
+	null_free_latency(nullb);
 	kfree(nullb);
 	dev->nullb = NULL;
 }
@@ -1854,6 +1873,16 @@ static int null_validate_conf(struct nullb_device *dev)
 						dev->cache_size);
 	dev->mbps = min_t(unsigned int, 1024 * 40, dev->mbps);
 
+	dev->latency_sigma = min_t(unsigned int, 2000, dev->latency_sigma);
+	dev->tail_permille = min_t(unsigned int, 1000, dev->tail_permille);
+	dev->channels = min_t(unsigned int, 256, dev->channels);
+	/* gc stalls and the write cache are emulated on the channels */
+	if (!dev->channels &&
+	    ((dev->gc_interval_mb && dev->gc_stall_nsec) || dev->write_cache_nsec))
+		dev->channels = 1;
+	if (null_latency_enabled(dev) && dev->irqmode != NULL_IRQ_TIMER)
+		pr_warn("latency emulation needs irqmode=%d\n", NULL_IRQ_TIMER);
+
 	if (dev->zoned &&
 	    (!dev->zone_size || !is_power_of_2(dev->zone_size))) {
 		pr_err("zone_size must be power-of-two\n");
@@ -1915,10 +1944,14 @@ static int null_add_dev(struct nullb_device *dev)
 
 	spin_lock_init(&nullb->lock);
 
-	rv = setup_queues(nullb);
+	rv = null_init_latency(nullb);
 	if (rv)
 		goto out_free_nullb;
 
+	rv = setup_queues(nullb);
+	if (rv)
+		goto out_free_latency;
+
 	rv = null_setup_tagset(nullb);
 	if (rv)
 		goto out_cleanup_queues;
@@ -1937,6 +1970,10 @@ static int null_add_dev(struct nullb_device *dev)
 		lim.features |= BLK_FEAT_WRITE_CACHE;
 		if (dev->fua)
 			lim.features |= BLK_FEAT_FUA;
+	} else if (dev->write_cache_nsec) {
+		lim.features |= BLK_FEAT_WRITE_CACHE;
+		if (dev->fua)
+			lim.features |= BLK_FEAT_FUA;
 	}
 
 	nullb->disk = blk_mq_alloc_disk(nullb->tag_set, &lim, nullb);
@@ -2004,6 +2041,8 @@ static int null_add_dev(struct nullb_device *dev)
 		blk_mq_free_tag_set(nullb->tag_set);
 out_cleanup_queues:
 	kfree(nullb->queues);
+out_free_latency:
+	null_free_latency(nullb);
 out_free_nullb:
 	kfree(nullb);
 	dev->nullb = NULL;
@@ -95,6 +95,13 @@ struct nullb_device {
 	unsigned int hw_queue_depth; /* queue depth */
 	unsigned int index; /* index of the disk, only valid with a disk */
 	unsigned int mbps; /* Bandwidth throttle cap (in MB/s) */
+	unsigned int latency_sigma; /* lognormal shape of service times, in 1/1000 */
+	unsigned long tail_nsec; /* service time of a latency spike */
+	unsigned int tail_permille; /* per mille of commands hitting a spike */
+	unsigned int channels; /* number of channels serving commands */
+	unsigned int gc_interval_mb; /* MB written between gc stalls */
+	unsigned long gc_stall_nsec; /* length of a gc stall */
+	unsigned long write_cache_nsec; /* completion time of cached writes */
 	bool blocking; /* blocking blk-mq device */
 	bool use_per_node_hctx; /* use per-node allocation for hardware context */
 	bool power; /* power on/off the device */
@@ -122,10 +129,23 @@ struct nullb {
 	unsigned long cache_flush_pos;
 	spinlock_t lock;
 
+	/* latency emulation state */
+	struct nullb_channel *channels;
+	atomic64_t gc_written;
+
 	struct nullb_queue *queues;
 	char disk_name[DISK_NAME_LEN];
 };
 
+static inline bool null_latency_enabled(struct nullb_device *dev)
+{
+	return dev->latency_sigma || dev->tail_permille || dev->channels;
+}
+
+int null_init_latency(struct nullb *nullb);
+void null_free_latency(struct nullb *nullb);
+u64 null_cmd_latency(struct nullb_cmd *cmd);
+
 blk_status_t null_handle_discard(struct nullb_device *dev, sector_t sector,
 				 sector_t nr_sectors);
 blk_status_t null_process_cmd(struct nullb_cmd *cmd, enum req_op op,
@@ -165,6 +165,12 @@ int null_init_zoned_dev(struct nullb_device *dev,
 	}
 
 	lim->features |= BLK_FEAT_ZONED;
+	/*
+	 * Writes are executed in ->queue_rq(), so with a single submit queue
+	 * they are executed in dispatch order, unless throttled by mbps.
+	 */
+	if (dev->submit_queues == 1 && !dev->mbps)
+		lim->features |= BLK_FEAT_ORDERED_ZONE_WRITES;
 	lim->chunk_sectors = dev->zone_size_sects;
 	lim->max_zone_append_sectors = dev->zone_append_max_sectors;
 	lim->max_open_zones = dev->zone_max_open;
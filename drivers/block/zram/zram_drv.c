@@ -34,6 +34,7 @@
 #include <linux/cpuhotplug.h>
 #include <linux/part_stat.h>
 #include <linux/kernel_read_file.h>
+#include <linux/kthread.h>
 
 #include "zram_drv.h"
 
@@ -562,19 +563,35 @@ static ssize_t backing_dev_store(struct device *dev,
 	return err;
 }
 
-static unsigned long alloc_block_bdev(struct zram *zram)
+/*
+ * Allocate a run of up to *@nr contiguous blocks on the backing device and
+ * return the first one, or 0 if there is no free block left. *@nr is set to
+ * the length of the run, which gets shorter when the bitmap is fragmented.
+ *
+ * Blocks are only allocated by writeback, which does not run concurrently
+ * (see pp_in_progress), and a concurrent free can only make more blocks
+ * available, so the area we found cannot be taken from under us.
+ */
+static unsigned long alloc_block_bdev(struct zram *zram, unsigned int *nr)
 {
-	unsigned long blk_idx = 1;
-retry:
-	/* skip 0 bit to confuse zram.handle = 0 */
-	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
-	if (blk_idx == zram->nr_pages)
+	unsigned long blk_idx;
+	unsigned int want, i;
+
+	for (want = *nr; want; want /= 2) {
+		/* skip 0 bit to confuse zram.handle = 0 */
+		blk_idx = bitmap_find_next_zero_area(zram->bitmap,
+						     zram->nr_pages, 1, want, 0);
+		if (blk_idx + want <= zram->nr_pages)
+			break;
+	}
+	if (!want)
 		return 0;
 
-	if (test_and_set_bit(blk_idx, zram->bitmap))
-		goto retry;
+	for (i = 0; i < want; i++)
+		WARN_ON_ONCE(test_and_set_bit(blk_idx + i, zram->bitmap));
 
-	atomic64_inc(&zram->stats.bd_count);
+	atomic64_add(want, &zram->stats.bd_count);
+	*nr = want;
 	return blk_idx;
 }
 
@@ -606,18 +623,271 @@ static void read_from_bdev_async(struct zram *zram, struct page *page,
 #define IDLE_WRITEBACK			(1<<1)
 #define INCOMPRESSIBLE_WRITEBACK	(1<<2)
 
+/* Maximum number of pages written back with a single bio */
+#define ZRAM_WB_MAX_RUN		32U
+#define ZRAM_WB_MAX_QUEUE_DEPTH	64U
+#define ZRAM_WB_DEF_QUEUE_DEPTH	8U
+
+/*
+ * A writeback request covers a run of contiguous blocks on the backing
+ * device, which is written with one bio.
+ */
+struct zram_wb_req {
+	unsigned long blk_idx;
+	unsigned int nr_blks;
+	unsigned int nr_pages;
+	u32 index[ZRAM_WB_MAX_RUN];
+	struct page *pages[ZRAM_WB_MAX_RUN];
+	struct bio_vec bvecs[ZRAM_WB_MAX_RUN];
+	struct bio bio;
+	struct list_head entry;
+};
+
+struct zram_wb_ctl {
+	/* pages per request, at most ZRAM_WB_MAX_RUN */
+	unsigned int run_len;
+	struct list_head idle_reqs;
+	/* completed requests, filled from bio completion */
+	struct list_head done_reqs;
+	spinlock_t done_lock;
+	wait_queue_head_t done_wait;
+	unsigned int num_inflight;
+};
+
+static void zram_wb_req_free(struct zram_wb_req *req)
+{
+	unsigned int i;
+
+	for (i = 0; i < ZRAM_WB_MAX_RUN; i++) {
+		if (req->pages[i])
+			__free_page(req->pages[i]);
+	}
+	kfree(req);
+}
+
+static void zram_wb_ctl_free(struct zram_wb_ctl *ctl)
+{
+	struct zram_wb_req *req, *tmp;
+
+	list_for_each_entry_safe(req, tmp, &ctl->idle_reqs, entry) {
+		list_del(&req->entry);
+		zram_wb_req_free(req);
+	}
+	kfree(ctl);
+}
+
+static struct zram_wb_ctl *zram_wb_ctl_alloc(unsigned int queue_depth,
+					     unsigned int run_len)
+{
+	struct zram_wb_ctl *ctl;
+	struct zram_wb_req *req;
+	unsigned int i, j;
+
+	ctl = kzalloc(sizeof(*ctl), GFP_KERNEL);
+	if (!ctl)
+		return NULL;
+
+	ctl->run_len = run_len;
+	INIT_LIST_HEAD(&ctl->idle_reqs);
+	INIT_LIST_HEAD(&ctl->done_reqs);
+	spin_lock_init(&ctl->done_lock);
+	init_waitqueue_head(&ctl->done_wait);
+
+	for (i = 0; i < queue_depth; i++) {
+		req = kzalloc(sizeof(*req), GFP_KERNEL);
+		if (!req)
+			break;
+
+		for (j = 0; j < run_len; j++) {
+			req->pages[j] = alloc_page(GFP_KERNEL);
+			if (!req->pages[j])
+				break;
+		}
+		if (j < run_len) {
+			zram_wb_req_free(req);
+			break;
+		}
+
+		list_add(&req->entry, &ctl->idle_reqs);
+	}
+
+	/* A shallower queue still does the job, just slower */
+	if (list_empty(&ctl->idle_reqs)) {
+		kfree(ctl);
+		return NULL;
+	}
+
+	return ctl;
+}
+
+static void zram_writeback_endio(struct bio *bio)
+{
+	struct zram_wb_req *req = container_of(bio, struct zram_wb_req, bio);
+	struct zram_wb_ctl *ctl = bio->bi_private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctl->done_lock, flags);
+	list_add_tail(&req->entry, &ctl->done_reqs);
+	spin_unlock_irqrestore(&ctl->done_lock, flags);
+
+	wake_up(&ctl->done_wait);
+}
+
+static void zram_wb_refund_limit(struct zram *zram, unsigned int nr_pages)
+{
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable)
+		zram->bd_wb_limit += nr_pages << (PAGE_SHIFT - 12);
+	spin_unlock(&zram->wb_limit_lock);
+}
+
+/*
+ * Charge one page against the writeback limit. The charge is refunded if
+ * the page does not make it to the backing device in the end.
+ */
+static bool zram_wb_charge_limit(struct zram *zram)
+{
+	bool ret = true;
+
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable) {
+		if (zram->bd_wb_limit < 1UL << (PAGE_SHIFT - 12))
+			ret = false;
+		else
+			zram->bd_wb_limit -= 1UL << (PAGE_SHIFT - 12);
+	}
+	spin_unlock(&zram->wb_limit_lock);
+
+	return ret;
+}
+
+static void zram_wb_submit_req(struct zram *zram, struct zram_wb_ctl *ctl,
+			       struct zram_wb_req *req)
+{
+	unsigned int i;
+
+	/* Give back the tail of the run we could not fill */
+	for (i = req->nr_pages; i < req->nr_blks; i++)
+		free_block_bdev(zram, req->blk_idx + i);
+	req->nr_blks = req->nr_pages;
+
+	bio_init(&req->bio, zram->bdev, req->bvecs, req->nr_pages,
+		 REQ_OP_WRITE | REQ_SYNC);
+	req->bio.bi_iter.bi_sector = req->blk_idx * (PAGE_SIZE >> 9);
+	req->bio.bi_end_io = zram_writeback_endio;
+	req->bio.bi_private = ctl;
+	for (i = 0; i < req->nr_pages; i++)
+		__bio_add_page(&req->bio, req->pages[i], PAGE_SIZE, 0);
+
+	ctl->num_inflight++;
+	submit_bio(&req->bio);
+}
+
+static int zram_wb_complete_req(struct zram *zram, struct zram_wb_req *req)
+{
+	int err = blk_status_to_errno(req->bio.bi_status);
+	unsigned int i, nr_written = 0;
+
+	for (i = 0; i < req->nr_pages; i++) {
+		u32 index = req->index[i];
+
+		zram_slot_lock(zram, index);
+		/*
+		 * We released zram_slot_lock so need to check if the slot was
+		 * changed. If there is freeing for the slot, we can catch it
+		 * easily by zram_allocated.
+		 * A subtle case is the slot is freed/reallocated/marked as
+		 * ZRAM_IDLE again. To close the race, idle_store doesn't
+		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+		 * Thus, we could close the race by checking ZRAM_IDLE bit.
+		 */
+		if (err || !zram_allocated(zram, index) ||
+		    !zram_test_flag(zram, index, ZRAM_IDLE)) {
+			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+			zram_clear_flag(zram, index, ZRAM_IDLE);
+			zram_slot_unlock(zram, index);
+			free_block_bdev(zram, req->blk_idx + i);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_set_flag(zram, index, ZRAM_WB);
+		zram_set_element(zram, index, req->blk_idx + i);
+		atomic64_inc(&zram->stats.pages_stored);
+		zram_slot_unlock(zram, index);
+		nr_written++;
+	}
+
+	if (!err)
+		atomic64_add(req->nr_pages, &zram->stats.bd_writes);
+	zram_wb_refund_limit(zram, req->nr_pages - nr_written);
+	atomic64_add(nr_written, &zram->stats.bd_wb_run_pages);
+
+	req->nr_pages = 0;
+	req->nr_blks = 0;
+	return err;
+}
+
+static bool zram_wb_has_done(struct zram_wb_ctl *ctl)
+{
+	bool done;
+
+	spin_lock_irq(&ctl->done_lock);
+	done = !list_empty(&ctl->done_reqs);
+	spin_unlock_irq(&ctl->done_lock);
+
+	return done;
+}
+
+/*
+ * Process completed requests and put them back on the idle list. Waits for
+ * at least one completion when @wait is set and no request is idle.
+ *
+ * BIO errors are not fatal, we continue and simply attempt to writeback the
+ * remaining objects (pages). At the same time we need to signal user-space
+ * that some writes (at least one, but also could be all of them) were not
+ * successful and we do so by returning the most recent BIO error.
+ */
+static int zram_wb_reap(struct zram *zram, struct zram_wb_ctl *ctl, bool wait)
+{
+	struct zram_wb_req *req;
+	int ret = 0, err;
+
+	if (wait && list_empty(&ctl->idle_reqs))
+		wait_event(ctl->done_wait, zram_wb_has_done(ctl));
+
+	for (;;) {
+		spin_lock_irq(&ctl->done_lock);
+		req = list_first_entry_or_null(&ctl->done_reqs,
+					       struct zram_wb_req, entry);
+		if (req)
+			list_del(&req->entry);
+		spin_unlock_irq(&ctl->done_lock);
+		if (!req)
+			break;
+
+		ctl->num_inflight--;
+		err = zram_wb_complete_req(zram, req);
+		if (err)
+			ret = err;
+		list_add(&req->entry, &ctl->idle_reqs);
+	}
+
+	return ret;
+}
+
 static ssize_t writeback_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
 	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	struct zram_wb_req *req = NULL;
+	struct zram_wb_ctl *ctl;
 	unsigned long index = 0;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct page *page;
+	u64 start, elapsed, written;
 	ssize_t ret = len;
 	int mode, err;
-	unsigned long blk_idx = 0;
 
 	if (sysfs_streq(buf, "idle"))
 		mode = IDLE_WRITEBACK;
@@ -656,27 +926,33 @@ static ssize_t writeback_store(struct device *dev,
 		goto release_init_lock;
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
+	ctl = zram_wb_ctl_alloc(READ_ONCE(zram->wb_queue_depth),
+				min_t(unsigned long, nr_pages, ZRAM_WB_MAX_RUN));
+	if (!ctl) {
 		ret = -ENOMEM;
 		goto release_init_lock;
 	}
 
-	for (; nr_pages != 0; index++, nr_pages--) {
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && !zram->bd_wb_limit) {
-			spin_unlock(&zram->wb_limit_lock);
-			ret = -EIO;
-			break;
-		}
-		spin_unlock(&zram->wb_limit_lock);
+	atomic64_set(&zram->stats.bd_wb_run_pages, 0);
+	start = ktime_get_ns();
 
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
+	for (; nr_pages != 0; index++, nr_pages--) {
+		if (!req) {
+			err = zram_wb_reap(zram, ctl, true);
+			if (err)
+				ret = err;
+
+			req = list_first_entry(&ctl->idle_reqs,
+					       struct zram_wb_req, entry);
+			req->nr_blks = min_t(unsigned long, nr_pages,
+					     ctl->run_len);
+			req->blk_idx = alloc_block_bdev(zram, &req->nr_blks);
+			if (!req->blk_idx) {
+				req = NULL;
 				ret = -ENOSPC;
 				break;
 			}
+			list_del(&req->entry);
 		}
 
 		zram_slot_lock(zram, index);
@@ -698,6 +974,12 @@ static ssize_t writeback_store(struct device *dev,
 		    !zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
 			goto next;
 
+		if (!zram_wb_charge_limit(zram)) {
+			zram_slot_unlock(zram, index);
+			ret = -EIO;
+			break;
+		}
+
 		/*
 		 * Clearing ZRAM_UNDER_WB is duty of caller.
 		 * IOW, zram_free_page never clear it.
@@ -706,76 +988,51 @@ static ssize_t writeback_store(struct device *dev,
 		/* Need for hugepage writeback racing */
 		zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
-		if (zram_read_page(zram, page, index, NULL)) {
+		if (zram_read_page(zram, req->pages[req->nr_pages], index,
+				   NULL)) {
 			zram_slot_lock(zram, index);
 			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
 			zram_clear_flag(zram, index, ZRAM_IDLE);
 			zram_slot_unlock(zram, index);
+			zram_wb_refund_limit(zram, 1);
 			continue;
 		}
 
-		bio_init(&bio, zram->bdev, &bio_vec, 1,
-			 REQ_OP_WRITE | REQ_SYNC);
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
-		__bio_add_page(&bio, page, PAGE_SIZE, 0);
-
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		err = submit_bio_wait(&bio);
-		if (err) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			/*
-			 * BIO errors are not fatal, we continue and simply
-			 * attempt to writeback the remaining objects (pages).
-			 * At the same time we need to signal user-space that
-			 * some writes (at least one, but also could be all of
-			 * them) were not successful and we do so by returning
-			 * the most recent BIO error.
-			 */
-			ret = err;
-			continue;
+		req->index[req->nr_pages++] = index;
+		if (req->nr_pages == req->nr_blks) {
+			zram_wb_submit_req(zram, ctl, req);
+			req = NULL;
 		}
+		continue;
+next:
+		zram_slot_unlock(zram, index);
+	}
 
-		atomic64_inc(&zram->stats.bd_writes);
-		/*
-		 * We released zram_slot_lock so need to check if the slot was
-		 * changed. If there is freeing for the slot, we can catch it
-		 * easily by zram_allocated.
-		 * A subtle case is the slot is freed/reallocated/marked as
-		 * ZRAM_IDLE again. To close the race, idle_store doesn't
-		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
-		 * Thus, we could close the race by checking ZRAM_IDLE bit.
-		 */
-		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
-			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
+	if (req) {
+		if (req->nr_pages) {
+			zram_wb_submit_req(zram, ctl, req);
+		} else {
+			while (req->nr_blks--)
+				free_block_bdev(zram, req->blk_idx + req->nr_blks);
+			req->nr_blks = 0;
+			list_add(&req->entry, &ctl->idle_reqs);
 		}
+	}
 
-		zram_free_page(zram, index);
-		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-		zram_set_flag(zram, index, ZRAM_WB);
-		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
-		atomic64_inc(&zram->stats.pages_stored);
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
-			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
-		spin_unlock(&zram->wb_limit_lock);
-next:
-		zram_slot_unlock(zram, index);
+	while (ctl->num_inflight) {
+		wait_event(ctl->done_wait, zram_wb_has_done(ctl));
+		err = zram_wb_reap(zram, ctl, false);
+		if (err)
+			ret = err;
 	}
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
-	__free_page(page);
+	/* Throughput of this run in KiB/s */
+	elapsed = ktime_get_ns() - start;
+	written = atomic64_read(&zram->stats.bd_wb_run_pages) * (PAGE_SIZE >> 10);
+	atomic64_set(&zram->stats.bd_wb_run_kbps,
+		     elapsed ? div64_u64(written * NSEC_PER_SEC, elapsed) : 0);
+
+	zram_wb_ctl_free(ctl);
 release_init_lock:
 	atomic_set(&zram->pp_in_progress, 0);
 	up_read(&zram->init_lock);
@@ -783,6 +1040,30 @@ static ssize_t writeback_store(struct device *dev,
 	return ret;
 }
 
+static ssize_t writeback_queue_depth_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val))
+		return -EINVAL;
+
+	if (!val || val > ZRAM_WB_MAX_QUEUE_DEPTH)
+		return -EINVAL;
+
+	WRITE_ONCE(zram->wb_queue_depth, val);
+	return len;
+}
+
+static ssize_t writeback_queue_depth_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sysfs_emit(buf, "%u\n", READ_ONCE(zram->wb_queue_depth));
+}
+
 struct zram_work {
 	struct work_struct work;
 	struct zram *zram;
@@ -1285,10 +1566,12 @@ static ssize_t bd_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-		"%8llu %8llu %8llu\n",
+		"%8llu %8llu %8llu %8llu %8llu\n",
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_count)),
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_reads)),
-			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)));
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_wb_run_pages)),
+			(u64)atomic64_read(&zram->stats.bd_wb_run_kbps));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1838,6 +2121,65 @@ static int zram_recompress(struct zram *zram, u32 index, struct page *page,
 #define RECOMPRESS_IDLE		(1 << 0)
 #define RECOMPRESS_HUGE		(1 << 1)
 
+/*
+ * Recompress the slot at @index if it matches @mode and is not excluded
+ * from post-processing. Takes the slot lock.
+ */
+static int zram_recompress_slot(struct zram *zram, u32 index,
+				struct page *page, u64 *num_recomp_pages,
+				u32 mode, u32 threshold, u32 prio, u32 prio_max)
+{
+	int err = 0;
+
+	zram_slot_lock(zram, index);
+
+	if (!zram_allocated(zram, index))
+		goto out;
+
+	if (mode & RECOMPRESS_IDLE &&
+	    !zram_test_flag(zram, index, ZRAM_IDLE))
+		goto out;
+
+	if (mode & RECOMPRESS_HUGE &&
+	    !zram_test_flag(zram, index, ZRAM_HUGE))
+		goto out;
+
+	if (zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+	    zram_test_flag(zram, index, ZRAM_SAME) ||
+	    zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
+		goto out;
+
+	err = zram_recompress(zram, index, page, num_recomp_pages,
+			      threshold, prio, prio_max);
+out:
+	zram_slot_unlock(zram, index);
+	return err;
+}
+
+/*
+ * Narrow the [@prio, @prio_max) range down to the secondary algorithm
+ * named @algo. Callers should hold the zram init lock in read mode.
+ */
+static int zram_recompress_find_algo(struct zram *zram, const char *algo,
+				     u32 *prio, u32 *prio_max)
+{
+	u32 p;
+
+	for (p = *prio; p < ZRAM_MAX_COMPS; p++) {
+		if (!zram->comp_algs[p])
+			continue;
+
+		if (!strcmp(zram->comp_algs[p], algo)) {
+			*prio = p;
+			*prio_max = min(p + 1, ZRAM_MAX_COMPS);
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
 static ssize_t recompress_store(struct device *dev,
 				struct device_attribute *attr,
 				const char *buf, size_t len)
@@ -1925,23 +2267,9 @@ static ssize_t recompress_store(struct device *dev,
 	}
 
 	if (algo) {
-		bool found = false;
-
-		for (; prio < ZRAM_MAX_COMPS; prio++) {
-			if (!zram->comp_algs[prio])
-				continue;
-
-			if (!strcmp(zram->comp_algs[prio], algo)) {
-				prio_max = min(prio + 1, ZRAM_MAX_COMPS);
-				found = true;
-				break;
-			}
-		}
-
-		if (!found) {
-			ret = -EINVAL;
+		ret = zram_recompress_find_algo(zram, algo, &prio, &prio_max);
+		if (ret)
 			goto release_init_lock;
-		}
 	}
 
 	page = alloc_page(GFP_KERNEL);
@@ -1952,34 +2280,13 @@ static ssize_t recompress_store(struct device *dev,
 
 	ret = len;
 	for (index = 0; index < nr_pages; index++) {
-		int err = 0;
+		int err;
 
 		if (!num_recomp_pages)
 			break;
 
-		zram_slot_lock(zram, index);
-
-		if (!zram_allocated(zram, index))
-			goto next;
-
-		if (mode & RECOMPRESS_IDLE &&
-		    !zram_test_flag(zram, index, ZRAM_IDLE))
-			goto next;
-
-		if (mode & RECOMPRESS_HUGE &&
-		    !zram_test_flag(zram, index, ZRAM_HUGE))
-			goto next;
-
-		if (zram_test_flag(zram, index, ZRAM_WB) ||
-		    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
-		    zram_test_flag(zram, index, ZRAM_SAME) ||
-		    zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
-			goto next;
-
-		err = zram_recompress(zram, index, page, &num_recomp_pages,
-				      threshold, prio, prio_max);
-next:
-		zram_slot_unlock(zram, index);
+		err = zram_recompress_slot(zram, index, page, &num_recomp_pages,
+					   mode, threshold, prio, prio_max);
 		if (err) {
 			ret = err;
 			break;
@@ -1995,6 +2302,365 @@ static ssize_t recompress_store(struct device *dev,
 	up_read(&zram->init_lock);
 	return ret;
 }
+
+/*
+ * Background recompression.
+ *
+ * Instead of walking the whole device from a sysfs write, a set of low
+ * priority kernel threads continuously recompresses the slots that match
+ * the configured type. Each worker owns a contiguous shard of the slot
+ * table and spends at most budget percent of a CPU on it, sleeping for
+ * interval seconds between two passes over its shard.
+ *
+ * The daemon counts as a post-processing action for its whole lifetime,
+ * so writeback and manual recompression are refused while it runs.
+ */
+#define ZRAM_RECOMPD_MAX_WORKERS	16U
+#define ZRAM_RECOMPD_BATCH		256U
+
+struct zram_recompd;
+
+struct zram_recompd_worker {
+	struct zram_recompd *rd;
+	struct task_struct *task;
+	struct page *page;
+	unsigned int id;
+	/* throttle sleep time not yet served, in ns */
+	u64 sleep_debt;
+};
+
+struct zram_recompd {
+	struct zram *zram;
+	u32 mode;
+	u32 threshold;
+	u32 prio;
+	u32 prio_max;
+	unsigned int budget;
+	unsigned int interval;
+	unsigned int nr_workers;
+	atomic64_t num_passes;
+	atomic64_t num_attempts;
+	struct zram_recompd_worker workers[] __counted_by(nr_workers);
+};
+
+/*
+ * Sleep long enough that the time spent working on the last batch is
+ * only budget percent of the total.
+ */
+static void zram_recompd_throttle(struct zram_recompd_worker *w, u64 busy)
+{
+	struct zram_recompd *rd = w->rd;
+	unsigned long timeout;
+
+	if (rd->budget >= 100) {
+		cond_resched();
+		return;
+	}
+
+	w->sleep_debt += div_u64(busy * (100 - rd->budget), rd->budget);
+	timeout = nsecs_to_jiffies(w->sleep_debt);
+	if (!timeout) {
+		cond_resched();
+		return;
+	}
+
+	w->sleep_debt -= jiffies_to_nsecs(timeout);
+	schedule_timeout_idle(timeout);
+}
+
+static void zram_recompd_pass(struct zram_recompd_worker *w)
+{
+	struct zram_recompd *rd = w->rd;
+	struct zram *zram = rd->zram;
+	unsigned long index = 0;
+
+	/*
+	 * Shard boundaries are recomputed for every batch under the init
+	 * lock, so they always match the current disksize.
+	 */
+	for (;;) {
+		unsigned long nr_pages, shard_end, end;
+		u64 num_recomp_pages = ULLONG_MAX;
+		u64 start;
+
+		if (kthread_should_stop())
+			return;
+
+		/* reset stops the daemon, do not stand in its way */
+		if (!down_read_trylock(&zram->init_lock))
+			return;
+
+		if (!init_done(zram)) {
+			up_read(&zram->init_lock);
+			return;
+		}
+
+		nr_pages = zram->disksize >> PAGE_SHIFT;
+		index = max_t(unsigned long, index,
+			      div_u64((u64)nr_pages * w->id, rd->nr_workers));
+		shard_end = div_u64((u64)nr_pages * (w->id + 1), rd->nr_workers);
+		end = min_t(unsigned long, index + ZRAM_RECOMPD_BATCH, shard_end);
+
+		start = ktime_get_ns();
+		for (; index < end; index++) {
+			if (zram_recompress_slot(zram, index, w->page,
+						 &num_recomp_pages, rd->mode,
+						 rd->threshold, rd->prio,
+						 rd->prio_max))
+				break;
+		}
+		up_read(&zram->init_lock);
+
+		/* zram_recompress() counts down every attempt */
+		atomic64_add(ULLONG_MAX - num_recomp_pages, &rd->num_attempts);
+
+		if (index < end || index >= shard_end)
+			return;
+
+		zram_recompd_throttle(w, ktime_get_ns() - start);
+	}
+}
+
+static int zram_recompd_fn(void *data)
+{
+	struct zram_recompd_worker *w = data;
+	struct zram_recompd *rd = w->rd;
+
+	set_user_nice(current, MAX_NICE);
+
+	while (!kthread_should_stop()) {
+		zram_recompd_pass(w);
+		atomic64_inc(&rd->num_passes);
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule_timeout(rd->interval * HZ);
+		__set_current_state(TASK_RUNNING);
+	}
+
+	return 0;
+}
+
+static void zram_recompd_free(struct zram_recompd *rd)
+{
+	unsigned int i;
+
+	for (i = 0; i < rd->nr_workers; i++) {
+		if (rd->workers[i].task)
+			kthread_stop(rd->workers[i].task);
+		if (rd->workers[i].page)
+			__free_page(rd->workers[i].page);
+	}
+	kfree(rd);
+}
+
+/* Callers should hold zram->recompd_lock */
+static void zram_recompd_stop(struct zram *zram)
+{
+	struct zram_recompd *rd = zram->recompd;
+
+	lockdep_assert_held(&zram->recompd_lock);
+
+	if (!rd)
+		return;
+
+	zram->recompd = NULL;
+	zram_recompd_free(rd);
+	atomic_set(&zram->pp_in_progress, 0);
+}
+
+static ssize_t recompress_daemon_show(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_recompd *rd;
+	ssize_t ret;
+
+	mutex_lock(&zram->recompd_lock);
+	rd = zram->recompd;
+	if (rd)
+		ret = sysfs_emit(buf,
+			"workers=%u budget=%u interval=%u passes=%llu attempted=%llu\n",
+			rd->nr_workers, rd->budget, rd->interval,
+			(u64)atomic64_read(&rd->num_passes),
+			(u64)atomic64_read(&rd->num_attempts));
+	else
+		ret = sysfs_emit(buf, "stopped\n");
+	mutex_unlock(&zram->recompd_lock);
+
+	return ret;
+}
+
+static ssize_t recompress_daemon_store(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t len)
+{
+	u32 prio = ZRAM_SECONDARY_COMP, prio_max = ZRAM_MAX_COMPS;
+	unsigned int nr_workers = 1, budget = 10, interval = 60;
+	struct zram *zram = dev_to_zram(dev);
+	char *args, *param, *val, *algo = NULL;
+	u32 mode = RECOMPRESS_IDLE, threshold = 0;
+	struct zram_recompd *rd;
+	unsigned int i;
+	ssize_t ret;
+
+	if (sysfs_streq(buf, "stop")) {
+		mutex_lock(&zram->recompd_lock);
+		zram_recompd_stop(zram);
+		mutex_unlock(&zram->recompd_lock);
+		return len;
+	}
+
+	args = skip_spaces(buf);
+	while (*args) {
+		args = next_arg(args, &param, &val);
+
+		if (!val || !*val)
+			return -EINVAL;
+
+		if (!strcmp(param, "type")) {
+			if (!strcmp(val, "idle"))
+				mode = RECOMPRESS_IDLE;
+			else if (!strcmp(val, "huge"))
+				mode = RECOMPRESS_HUGE;
+			else if (!strcmp(val, "huge_idle"))
+				mode = RECOMPRESS_IDLE | RECOMPRESS_HUGE;
+			else
+				return -EINVAL;
+			continue;
+		}
+
+		if (!strcmp(param, "threshold")) {
+			ret = kstrtouint(val, 10, &threshold);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		if (!strcmp(param, "algo")) {
+			algo = val;
+			continue;
+		}
+
+		if (!strcmp(param, "priority")) {
+			ret = kstrtouint(val, 10, &prio);
+			if (ret)
+				return ret;
+
+			if (prio == ZRAM_PRIMARY_COMP)
+				prio = ZRAM_SECONDARY_COMP;
+
+			prio_max = min(prio + 1, ZRAM_MAX_COMPS);
+			continue;
+		}
+
+		if (!strcmp(param, "workers")) {
+			ret = kstrtouint(val, 10, &nr_workers);
+			if (ret)
+				return ret;
+			if (!nr_workers || nr_workers > ZRAM_RECOMPD_MAX_WORKERS)
+				return -EINVAL;
+			continue;
+		}
+
+		if (!strcmp(param, "budget")) {
+			/* percent of a CPU each worker may use */
+			ret = kstrtouint(val, 10, &budget);
+			if (ret)
+				return ret;
+			if (!budget || budget > 100)
+				return -EINVAL;
+			continue;
+		}
+
+		if (!strcmp(param, "interval")) {
+			/* seconds between two passes over a shard */
+			ret = kstrtouint(val, 10, &interval);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		return -EINVAL;
+	}
+
+	if (threshold >= huge_class_size)
+		return -EINVAL;
+
+	rd = kzalloc(struct_size(rd, workers, nr_workers), GFP_KERNEL);
+	if (!rd)
+		return -ENOMEM;
+
+	rd->zram = zram;
+	rd->mode = mode;
+	rd->threshold = threshold;
+	rd->budget = budget;
+	rd->interval = interval;
+	rd->nr_workers = nr_workers;
+	atomic64_set(&rd->num_passes, 0);
+	atomic64_set(&rd->num_attempts, 0);
+
+	for (i = 0; i < nr_workers; i++) {
+		rd->workers[i].rd = rd;
+		rd->workers[i].id = i;
+		rd->workers[i].page = alloc_page(GFP_KERNEL);
+		if (!rd->workers[i].page) {
+			zram_recompd_free(rd);
+			return -ENOMEM;
+		}
+	}
+
+	mutex_lock(&zram->recompd_lock);
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto out_free;
+	}
+
+	if (algo) {
+		ret = zram_recompress_find_algo(zram, algo, &prio, &prio_max);
+		if (ret)
+			goto out_free;
+	}
+	rd->prio = prio;
+	rd->prio_max = prio_max;
+
+	/* Restarting with new parameters keeps post-processing ownership */
+	if (zram->recompd) {
+		zram_recompd_free(zram->recompd);
+		zram->recompd = NULL;
+	} else if (atomic_xchg(&zram->pp_in_progress, 1)) {
+		ret = -EAGAIN;
+		goto out_free;
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		struct task_struct *task;
+
+		task = kthread_create(zram_recompd_fn, &rd->workers[i],
+				      "%s_recompd/%u", zram->disk->disk_name, i);
+		if (IS_ERR(task)) {
+			ret = PTR_ERR(task);
+			atomic_set(&zram->pp_in_progress, 0);
+			goto out_free;
+		}
+		rd->workers[i].task = task;
+	}
+
+	zram->recompd = rd;
+	for (i = 0; i < nr_workers; i++)
+		wake_up_process(rd->workers[i].task);
+
+	up_read(&zram->init_lock);
+	mutex_unlock(&zram->recompd_lock);
+	return len;
+
+out_free:
+	up_read(&zram->init_lock);
+	mutex_unlock(&zram->recompd_lock);
+	zram_recompd_free(rd);
+	return ret;
+}
 #endif
 
 static void zram_bio_discard(struct zram *zram, struct bio *bio)
@@ -2171,6 +2837,12 @@ static void zram_destroy_comps(struct zram *zram)
 
 static void zram_reset_device(struct zram *zram)
 {
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	mutex_lock(&zram->recompd_lock);
+	zram_recompd_stop(zram);
+	mutex_unlock(&zram->recompd_lock);
+#endif
+
 	down_write(&zram->init_lock);
 
 	zram->limit_pages = 0;
@@ -2319,10 +2991,12 @@ static DEVICE_ATTR_RW(backing_dev);
 static DEVICE_ATTR_WO(writeback);
 static DEVICE_ATTR_RW(writeback_limit);
 static DEVICE_ATTR_RW(writeback_limit_enable);
+static DEVICE_ATTR_RW(writeback_queue_depth);
 #endif
 #ifdef CONFIG_ZRAM_MULTI_COMP
 static DEVICE_ATTR_RW(recomp_algorithm);
 static DEVICE_ATTR_WO(recompress);
+static DEVICE_ATTR_RW(recompress_daemon);
 #endif
 static DEVICE_ATTR_WO(algorithm_params);
 
@@ -2341,6 +3015,7 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_writeback.attr,
 	&dev_attr_writeback_limit.attr,
 	&dev_attr_writeback_limit_enable.attr,
+	&dev_attr_writeback_queue_depth.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -2351,6 +3026,7 @@ static struct attribute *zram_disk_attrs[] = {
 #ifdef CONFIG_ZRAM_MULTI_COMP
 	&dev_attr_recomp_algorithm.attr,
 	&dev_attr_recompress.attr,
+	&dev_attr_recompress_daemon.attr,
 #endif
 	&dev_attr_algorithm_params.attr,
 	NULL,
@@ -2403,6 +3079,10 @@ static int zram_add(void)
 	init_rwsem(&zram->init_lock);
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
+	zram->wb_queue_depth = ZRAM_WB_DEF_QUEUE_DEPTH;
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	mutex_init(&zram->recompd_lock);
 #endif
 
 	/* gendisk structure */
@@ -89,6 +89,8 @@ struct zram_stats {
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
 	atomic64_t bd_writes;		/* no. of writes from backing device */
+	atomic64_t bd_wb_run_pages;	/* no. of pages written by last writeback */
+	atomic64_t bd_wb_run_kbps;	/* throughput of last writeback, KiB/s */
 #endif
 };
 
@@ -132,12 +134,18 @@ struct zram {
 	spinlock_t wb_limit_lock;
 	bool wb_limit_enable;
 	u64 bd_wb_limit;
+	unsigned int wb_queue_depth;	/* max. writeback bios in flight */
 	struct block_device *bdev;
 	unsigned long *bitmap;
 	unsigned long nr_pages;
 #endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
+#endif
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	/* background recompression, protected by recompd_lock */
+	struct zram_recompd *recompd;
+	struct mutex recompd_lock;
 #endif
 	atomic_t pp_in_progress;
 };
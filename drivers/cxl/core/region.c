@@ -2447,6 +2447,7 @@ static int cxl_region_calculate_adistance(struct notifier_block *nb,
 		return NOTIFY_OK;
 
 	perf = &cxlr->coord[ACCESS_COORDINATE_CPU];
+	mt_set_node_perf(nid, perf);
 
 	if (mt_perf_to_adistance(perf, adist))
 		return NOTIFY_OK;
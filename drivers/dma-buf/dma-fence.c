@@ -479,6 +479,60 @@ int dma_fence_signal(struct dma_fence *fence)
 }
 EXPORT_SYMBOL(dma_fence_signal);
 
+/**
+ * dma_fence_signal_batch - signal completion of several fences
+ * @fences: array of fences to signal, NULL entries are skipped
+ * @count: number of entries in @fences
+ *
+ * Same as calling dma_fence_signal() on each fence in @fences in order, but
+ * all fences get the same timestamp and &dma_fence.lock is only dropped and
+ * taken again between fences which don't share it. Fences of one context
+ * usually share their lock, so a driver retiring a run of completed fences
+ * of a context takes it once instead of once per fence. Fences which are
+ * already signalled are skipped without taking their lock.
+ *
+ * The caller must hold a reference on every fence in @fences.
+ *
+ * Returns the number of fences signalled by this call.
+ */
+unsigned int dma_fence_signal_batch(struct dma_fence **fences,
+				    unsigned int count)
+{
+	ktime_t timestamp = ktime_get();
+	unsigned int i, signalled = 0;
+	spinlock_t *lock = NULL;
+	unsigned long flags;
+	bool tmp;
+
+	tmp = dma_fence_begin_signalling();
+
+	for (i = 0; i < count; i++) {
+		struct dma_fence *fence = fences[i];
+
+		if (!fence ||
+		    test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &fence->flags))
+			continue;
+
+		if (fence->lock != lock) {
+			if (lock)
+				spin_unlock_irqrestore(lock, flags);
+			lock = fence->lock;
+			spin_lock_irqsave(lock, flags);
+		}
+
+		if (!dma_fence_signal_timestamp_locked(fence, timestamp))
+			signalled++;
+	}
+
+	if (lock)
+		spin_unlock_irqrestore(lock, flags);
+
+	dma_fence_end_signalling(tmp);
+
+	return signalled;
+}
+EXPORT_SYMBOL(dma_fence_signal_batch);
+
 /**
  * dma_fence_wait_timeout - sleep until the fence gets signaled
  * or until timeout elapses
@@ -184,6 +184,65 @@ static int test_add_callback(void *arg)
 	return err;
 }
 
+static int test_signal_batch(void *arg)
+{
+	struct simple_cb cb[4] = {};
+	struct dma_fence *f[5] = {};
+	unsigned int i;
+	int err = -EINVAL;
+
+	/* The last entry is left NULL on purpose */
+	for (i = 0; i < ARRAY_SIZE(cb); i++) {
+		f[i] = mock_fence();
+		if (!f[i]) {
+			err = -ENOMEM;
+			goto err_free;
+		}
+
+		if (dma_fence_add_callback(f[i], &cb[i].cb, simple_callback)) {
+			pr_err("Failed to add callback, fence already signaled!\n");
+			goto err_free;
+		}
+	}
+
+	dma_fence_signal(f[1]);
+	cb[1].seen = false;
+
+	if (dma_fence_signal_batch(f, ARRAY_SIZE(f)) != ARRAY_SIZE(cb) - 1) {
+		pr_err("Batch signaled an unexpected number of fences\n");
+		goto err_free;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(cb); i++) {
+		if (!dma_fence_is_signaled(f[i])) {
+			pr_err("Fence %u not reporting signaled\n", i);
+			goto err_free;
+		}
+
+		if (cb[i].seen != (i != 1)) {
+			pr_err("Callback %u %s!\n", i,
+			       i == 1 ? "called twice" : "failed");
+			goto err_free;
+		}
+	}
+
+	if (f[0]->timestamp != f[3]->timestamp) {
+		pr_err("Batch signaled fences with different timestamps\n");
+		goto err_free;
+	}
+
+	if (dma_fence_signal_batch(f, ARRAY_SIZE(f))) {
+		pr_err("Batch signaled already signaled fences\n");
+		goto err_free;
+	}
+
+	err = 0;
+err_free:
+	for (i = 0; i < ARRAY_SIZE(f); i++)
+		dma_fence_put(f[i]);
+	return err;
+}
+
 static int test_late_add_callback(void *arg)
 {
 	struct simple_cb cb = {};
@@ -569,6 +628,7 @@ int dma_fence(void)
 		SUBTEST(sanitycheck),
 		SUBTEST(test_signaling),
 		SUBTEST(test_add_callback),
+		SUBTEST(test_signal_batch),
 		SUBTEST(test_late_add_callback),
 		SUBTEST(test_rm_callback),
 		SUBTEST(test_late_rm_callback),
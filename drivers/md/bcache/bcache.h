@@ -547,7 +547,7 @@ struct cache_set {
 	/* For the btree cache */
 	struct shrinker		*shrink;
 
-	/* For the btree cache and anything allocation related */
+	/* For anything allocation related */
 	struct mutex		bucket_lock;
 
 	/* log2(bucket_size), in sectors */
@@ -582,6 +582,13 @@ struct cache_set {
 	struct list_head	btree_cache_freeable;
 	struct list_head	btree_cache_freed;
 
+	/*
+	 * Protects the lists above and the insertions into bucket_hash.
+	 * Nests inside bucket_lock, so that filling the btree cache doesn't
+	 * wait for gc or the allocator walking the buckets.
+	 */
+	struct mutex		btree_cache_lock;
+
 	/* Number of elements in btree_cache + btree_cache_freeable lists */
 	unsigned int		btree_cache_used;
 
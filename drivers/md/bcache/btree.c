@@ -610,7 +610,7 @@ static int mca_reap(struct btree *b, unsigned int min_order, bool flush)
 	struct closure cl;
 
 	closure_init_stack(&cl);
-	lockdep_assert_held(&b->c->bucket_lock);
+	lockdep_assert_held(&b->c->btree_cache_lock);
 
 	if (!down_write_trylock(&b->lock))
 		return -ENOMEM;
@@ -681,8 +681,8 @@ static unsigned long bch_mca_scan(struct shrinker *shrink,
 
 	/* Return -1 if we can't do anything right now */
 	if (sc->gfp_mask & __GFP_IO)
-		mutex_lock(&c->bucket_lock);
-	else if (!mutex_trylock(&c->bucket_lock))
+		mutex_lock(&c->btree_cache_lock);
+	else if (!mutex_trylock(&c->btree_cache_lock))
 		return -1;
 
 	/*
@@ -727,7 +727,7 @@ static unsigned long bch_mca_scan(struct shrinker *shrink,
 		i++;
 	}
 out:
-	mutex_unlock(&c->bucket_lock);
+	mutex_unlock(&c->btree_cache_lock);
 	return freed * c->btree_pages;
 }
 
@@ -755,7 +755,7 @@ void bch_btree_cache_free(struct cache_set *c)
 	if (c->shrink)
 		shrinker_free(c->shrink);
 
-	mutex_lock(&c->bucket_lock);
+	mutex_lock(&c->btree_cache_lock);
 
 #ifdef CONFIG_BCACHE_DEBUG
 	if (c->verify_data)
@@ -790,7 +790,7 @@ void bch_btree_cache_free(struct cache_set *c)
 		kfree(b);
 	}
 
-	mutex_unlock(&c->bucket_lock);
+	mutex_unlock(&c->btree_cache_lock);
 }
 
 int bch_btree_cache_alloc(struct cache_set *c)
@@ -928,7 +928,7 @@ static struct btree *mca_alloc(struct cache_set *c, struct btree_op *op,
 
 	BUG_ON(current->bio_list);
 
-	lockdep_assert_held(&c->bucket_lock);
+	lockdep_assert_held(&c->btree_cache_lock);
 
 	if (mca_find(c, k))
 		return NULL;
@@ -1019,9 +1019,9 @@ struct btree *bch_btree_node_get(struct cache_set *c, struct btree_op *op,
 		if (current->bio_list)
 			return ERR_PTR(-EAGAIN);
 
-		mutex_lock(&c->bucket_lock);
+		mutex_lock(&c->btree_cache_lock);
 		b = mca_alloc(c, op, k, level);
-		mutex_unlock(&c->bucket_lock);
+		mutex_unlock(&c->btree_cache_lock);
 
 		if (!b)
 			goto retry;
@@ -1065,9 +1065,9 @@ static void btree_node_prefetch(struct btree *parent, struct bkey *k)
 {
 	struct btree *b;
 
-	mutex_lock(&parent->c->bucket_lock);
+	mutex_lock(&parent->c->btree_cache_lock);
 	b = mca_alloc(parent->c, NULL, k, parent->level - 1);
-	mutex_unlock(&parent->c->bucket_lock);
+	mutex_unlock(&parent->c->btree_cache_lock);
 
 	if (!IS_ERR_OR_NULL(b)) {
 		b->parent = parent;
@@ -1108,9 +1108,15 @@ static void btree_node_free(struct btree *b)
 
 	cancel_delayed_work(&b->work);
 
+	/*
+	 * The node has to leave the hash before its bucket can be allocated
+	 * again, so take both locks.
+	 */
 	mutex_lock(&b->c->bucket_lock);
+	mutex_lock(&b->c->btree_cache_lock);
 	bch_bucket_free(b->c, &b->key);
 	mca_bucket_free(b);
+	mutex_unlock(&b->c->btree_cache_lock);
 	mutex_unlock(&b->c->bucket_lock);
 }
 
@@ -1135,7 +1141,9 @@ struct btree *__bch_btree_node_alloc(struct cache_set *c, struct btree_op *op,
 	bkey_put(c, &k.key);
 	SET_KEY_SIZE(&k.key, c->btree_pages * PAGE_SECTORS);
 
+	mutex_lock(&c->btree_cache_lock);
 	b = mca_alloc(c, op, &k.key, level);
+	mutex_unlock(&c->btree_cache_lock);
 	if (IS_ERR(b))
 		goto err_free;
 
@@ -2543,9 +2551,9 @@ void bch_btree_set_root(struct btree *b)
 	for (i = 0; i < KEY_PTRS(&b->key); i++)
 		BUG_ON(PTR_BUCKET(b->c, &b->key, i)->prio != BTREE_PRIO);
 
-	mutex_lock(&b->c->bucket_lock);
+	mutex_lock(&b->c->btree_cache_lock);
 	list_del_init(&b->list);
-	mutex_unlock(&b->c->bucket_lock);
+	mutex_unlock(&b->c->btree_cache_lock);
 
 	b->c->root = b;
 
@@ -14,6 +14,8 @@
 #include <linux/jiffies.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
 #include <linux/vmalloc.h>
 #include <linux/math64.h>
 
@@ -785,6 +787,23 @@ static struct entry *get_entry(struct entry_alloc *ea, unsigned int index)
 
 /*----------------------------------------------------------------*/
 
+/*
+ * Hits found by the lockless lookup are not requeued straight away.  Each
+ * cpu buffers the cblocks it hit, along with the hit stats, and the buffers
+ * are applied under mq->lock by the tick, or when one fills up.
+ */
+#define HIT_BUFFER_SIZE 256u
+
+struct hit_buffer {
+	spinlock_t lock;
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int nr_cblocks;
+	unsigned int cblocks[HIT_BUFFER_SIZE];
+};
+
+/*----------------------------------------------------------------*/
+
 #define NR_HOTSPOT_LEVELS 64u
 #define NR_CACHE_LEVELS 64u
 
@@ -843,6 +862,13 @@ struct smq_policy {
 	struct smq_hash_table table;
 	struct smq_hash_table hotspot_table;
 
+	/*
+	 * Bumped around every change to the chains of the table, so
+	 * smq_lookup() can walk them without the lock.
+	 */
+	seqcount_t table_seq;
+	struct hit_buffer __percpu *hit_buffers;
+
 	bool current_writeback_sentinels;
 	unsigned long next_writeback_period;
 
@@ -969,10 +995,41 @@ static void push_queue(struct smq_policy *mq, struct entry *e)
 		q_push(&mq->clean, e);
 }
 
+/*
+ * Writers of the cache table are serialised by mq->lock, or run before the
+ * policy is in use (load_mapping).  The raw seqcount variants are used
+ * because of the latter.
+ */
+static void table_insert(struct smq_policy *mq, struct entry *e)
+{
+	raw_write_seqcount_begin(&mq->table_seq);
+	h_insert(&mq->table, e);
+	raw_write_seqcount_end(&mq->table_seq);
+}
+
+static void table_remove(struct smq_policy *mq, struct entry *e)
+{
+	raw_write_seqcount_begin(&mq->table_seq);
+	h_remove(&mq->table, e);
+	raw_write_seqcount_end(&mq->table_seq);
+}
+
+static struct entry *table_lookup(struct smq_policy *mq, dm_oblock_t oblock)
+{
+	struct entry *e;
+
+	/* h_lookup() may move the entry to the front of its bucket */
+	raw_write_seqcount_begin(&mq->table_seq);
+	e = h_lookup(&mq->table, oblock);
+	raw_write_seqcount_end(&mq->table_seq);
+
+	return e;
+}
+
 // !h, !q, a -> h, q, a
 static void push(struct smq_policy *mq, struct entry *e)
 {
-	h_insert(&mq->table, e);
+	table_insert(mq, e);
 	if (!e->pending_work)
 		push_queue(mq, e);
 }
@@ -987,7 +1044,7 @@ static void push_queue_front(struct smq_policy *mq, struct entry *e)
 
 static void push_front(struct smq_policy *mq, struct entry *e)
 {
-	h_insert(&mq->table, e);
+	table_insert(mq, e);
 	if (!e->pending_work)
 		push_queue_front(mq, e);
 }
@@ -997,6 +1054,18 @@ static dm_cblock_t infer_cblock(struct smq_policy *mq, struct entry *e)
 	return to_cblock(get_index(&mq->cache_alloc, e));
 }
 
+static void requeue_entry(struct smq_policy *mq, struct entry *e)
+{
+	if (!e->dirty) {
+		q_requeue(&mq->clean, e, 1u, NULL, NULL);
+		return;
+	}
+
+	q_requeue(&mq->dirty, e, 1u,
+		  get_sentinel(&mq->writeback_sentinel_alloc, e->level, !mq->current_writeback_sentinels),
+		  get_sentinel(&mq->writeback_sentinel_alloc, e->level, mq->current_writeback_sentinels));
+}
+
 static void requeue(struct smq_policy *mq, struct entry *e)
 {
 	/*
@@ -1005,18 +1074,116 @@ static void requeue(struct smq_policy *mq, struct entry *e)
 	if (e->pending_work)
 		return;
 
-	if (!test_and_set_bit(from_cblock(infer_cblock(mq, e)), mq->cache_hit_bits)) {
-		if (!e->dirty) {
-			q_requeue(&mq->clean, e, 1u, NULL, NULL);
-			return;
+	if (!test_and_set_bit(from_cblock(infer_cblock(mq, e)), mq->cache_hit_bits))
+		requeue_entry(mq, e);
+}
+
+/*
+ * Called with mq->lock held.
+ */
+static void apply_hit_buffer(struct smq_policy *mq, struct hit_buffer *hb)
+{
+	struct entry *e;
+	unsigned int i;
+
+	spin_lock(&hb->lock);
+	mq->cache_stats.hits += hb->hits;
+	mq->cache_stats.misses += hb->misses;
+
+	for (i = 0; i < hb->nr_cblocks; i++) {
+		/*
+		 * The entry may have been demoted, or had background work
+		 * queued, since it was hit.
+		 */
+		e = get_entry(&mq->cache_alloc, hb->cblocks[i]);
+		if (e->allocated && !e->pending_work)
+			requeue_entry(mq, e);
+	}
+
+	hb->hits = hb->misses = hb->nr_cblocks = 0u;
+	spin_unlock(&hb->lock);
+}
+
+static void apply_hit_buffers(struct smq_policy *mq)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		apply_hit_buffer(mq, per_cpu_ptr(mq->hit_buffers, cpu));
+}
+
+/*
+ * The lockless counterpart of stats_level_accessed() + requeue().
+ */
+static void buffer_hit(struct smq_policy *mq, struct entry *e, dm_cblock_t cblock)
+{
+	struct hit_buffer *hb;
+	unsigned long flags;
+	bool full = false;
+
+	hb = raw_cpu_ptr(mq->hit_buffers);
+	spin_lock_irqsave(&hb->lock, flags);
+	if (e->level >= mq->cache_stats.hit_threshold)
+		hb->hits++;
+	else
+		hb->misses++;
+
+	/*
+	 * cache_hit_bits still makes sure a block is only requeued once
+	 * per cache period.
+	 */
+	if (!test_and_set_bit(from_cblock(cblock), mq->cache_hit_bits)) {
+		if (hb->nr_cblocks < HIT_BUFFER_SIZE)
+			hb->cblocks[hb->nr_cblocks++] = from_cblock(cblock);
+		else {
+			clear_bit(from_cblock(cblock), mq->cache_hit_bits);
+			full = true;
 		}
+	}
+	spin_unlock_irqrestore(&hb->lock, flags);
 
-		q_requeue(&mq->dirty, e, 1u,
-			  get_sentinel(&mq->writeback_sentinel_alloc, e->level, !mq->current_writeback_sentinels),
-			  get_sentinel(&mq->writeback_sentinel_alloc, e->level, mq->current_writeback_sentinels));
+	if (full) {
+		spin_lock_irqsave(&mq->lock, flags);
+		apply_hit_buffer(mq, hb);
+		spin_unlock_irqrestore(&mq->lock, flags);
 	}
 }
 
+/*
+ * Walks the table without mq->lock.  Returns false if the block isn't
+ * mapped, or the table changed under us, in which case the caller falls
+ * back to the locked lookup.
+ */
+static bool lockless_hit(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblock)
+{
+	struct smq_hash_table *ht = &mq->table;
+	unsigned int h = hash_64(from_oblock(oblock), ht->hash_bits);
+	unsigned int steps = 0, seq;
+	struct entry *e;
+
+	if (!mq->hit_buffers)
+		return false;
+
+	seq = raw_read_seqcount_begin(&mq->table_seq);
+	for (e = to_entry(ht->es, READ_ONCE(ht->buckets[h])); e; e = h_next(ht, e)) {
+		if (READ_ONCE(e->oblock) == oblock)
+			break;
+
+		/* a chain torn by a concurrent writer may loop */
+		if (++steps > from_cblock(mq->cache_size)) {
+			e = NULL;
+			break;
+		}
+	}
+
+	if (!e || read_seqcount_retry(&mq->table_seq, seq))
+		return false;
+
+	*cblock = infer_cblock(mq, e);
+	buffer_hit(mq, e, *cblock);
+	return true;
+}
+
 static unsigned int default_promote_level(struct smq_policy *mq)
 {
 	/*
@@ -1363,6 +1530,7 @@ static void smq_destroy(struct dm_cache_policy *p)
 	struct smq_policy *mq = to_smq_policy(p);
 
 	btracker_destroy(mq->bg_work);
+	free_percpu(mq->hit_buffers);
 	h_exit(&mq->hotspot_table);
 	h_exit(&mq->table);
 	free_bitset(mq->hotspot_hit_bits);
@@ -1382,7 +1550,7 @@ static int __lookup(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblo
 
 	*background_work = false;
 
-	e = h_lookup(&mq->table, oblock);
+	e = table_lookup(mq, oblock);
 	if (e) {
 		stats_level_accessed(&mq->cache_stats, e->level);
 
@@ -1416,6 +1584,11 @@ static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
+	if (lockless_hit(mq, oblock, cblock)) {
+		*background_work = false;
+		return 0;
+	}
+
 	spin_lock_irqsave(&mq->lock, flags);
 	r = __lookup(mq, oblock, cblock,
 		     data_dir, fast_copy,
@@ -1491,7 +1664,7 @@ static void __complete_background_work(struct smq_policy *mq,
 	case POLICY_DEMOTE:
 		// h, !q, a
 		if (success) {
-			h_remove(&mq->table, e);
+			table_remove(mq, e);
 			free_entry(&mq->cache_alloc, e);
 			// !h, !q, !a
 		} else {
@@ -1595,7 +1768,7 @@ static int smq_invalidate_mapping(struct dm_cache_policy *p, dm_cblock_t cblock)
 
 	// FIXME: what if this block has pending background work?
 	del_queue(mq, e);
-	h_remove(&mq->table, e);
+	table_remove(mq, e);
 	free_entry(&mq->cache_alloc, e);
 	return 0;
 }
@@ -1630,6 +1803,8 @@ static void smq_tick(struct dm_cache_policy *p, bool can_block)
 	unsigned long flags;
 
 	spin_lock_irqsave(&mq->lock, flags);
+	if (mq->hit_buffers)
+		apply_hit_buffers(mq);
 	mq->tick++;
 	update_sentinels(mq);
 	end_hotspot_period(mq);
@@ -1733,6 +1908,7 @@ __smq_create(dm_cblock_t cache_size, sector_t origin_size, sector_t cache_block_
 	     bool mimic_mq, bool migrations_allowed, bool cleaner)
 {
 	unsigned int i;
+	int cpu;
 	unsigned int nr_sentinels_per_queue = 2u * NR_CACHE_LEVELS;
 	unsigned int total_sentinels = 2u * nr_sentinels_per_queue;
 	struct smq_policy *mq = kzalloc(sizeof(*mq), GFP_KERNEL);
@@ -1812,6 +1988,17 @@ __smq_create(dm_cblock_t cache_size, sector_t origin_size, sector_t cache_block_
 	mq->next_hotspot_period = jiffies;
 	mq->next_cache_period = jiffies;
 
+	seqcount_init(&mq->table_seq);
+	if (mq->cache_hit_bits) {
+		mq->hit_buffers = alloc_percpu(struct hit_buffer);
+		if (!mq->hit_buffers)
+			goto bad_hit_buffers;
+
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(mq->hit_buffers, cpu)->lock);
+	} else
+		mq->hit_buffers = NULL;
+
 	mq->bg_work = btracker_create(4096); /* FIXME: hard coded value */
 	if (!mq->bg_work)
 		goto bad_btracker;
@@ -1822,6 +2009,8 @@ __smq_create(dm_cblock_t cache_size, sector_t origin_size, sector_t cache_block_
 	return &mq->policy;
 
 bad_btracker:
+	free_percpu(mq->hit_buffers);
+bad_hit_buffers:
 	h_exit(&mq->hotspot_table);
 bad_alloc_hotspot_table:
 	h_exit(&mq->table);
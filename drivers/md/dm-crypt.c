@@ -148,6 +148,7 @@ enum cipher_flags {
 	CRYPT_IV_LARGE_SECTORS,		/* Calculate IV from sector_size, not 512B sectors */
 	CRYPT_ENCRYPT_PREPROCESS,	/* Must preprocess data for encryption (elephant) */
 	CRYPT_KEY_MAC_SIZE_SET,		/* The integrity_key_size option was used */
+	CRYPT_BATCH_UNITS,		/* Convert a whole bvec per request (skcipher) */
 };
 
 /*
@@ -237,6 +238,8 @@ struct crypt_config {
 #define MIN_IOS		64
 #define MAX_TAG_SIZE	480
 #define POOL_ENTRY_SIZE	512
+/* Bounds the time spent in crypt_convert() between two cond_resched() */
+#define DM_CRYPT_BATCH_UNITS	256U
 
 static DEFINE_SPINLOCK(dm_crypt_clients_lock);
 static unsigned int dm_crypt_clients_n;
@@ -1422,23 +1425,20 @@ static int crypt_convert_block_aead(struct crypt_config *cc,
 	return r;
 }
 
-static int crypt_convert_block_skcipher(struct crypt_config *cc,
-					struct convert_context *ctx,
-					struct skcipher_request *req,
-					unsigned int tag_offset)
+/* Encrypt or decrypt the data unit at @page_in/@off_in to @page_out/@off_out */
+static int crypt_convert_unit_skcipher(struct crypt_config *cc,
+				       struct convert_context *ctx,
+				       struct skcipher_request *req,
+				       unsigned int tag_offset,
+				       struct page *page_in, unsigned int off_in,
+				       struct page *page_out, unsigned int off_out)
 {
-	struct bio_vec bv_in = bio_iter_iovec(ctx->bio_in, ctx->iter_in);
-	struct bio_vec bv_out = bio_iter_iovec(ctx->bio_out, ctx->iter_out);
 	struct scatterlist *sg_in, *sg_out;
 	struct dm_crypt_request *dmreq;
 	u8 *iv, *org_iv, *tag_iv;
 	__le64 *sector;
 	int r = 0;
 
-	/* Reject unexpected unaligned bio. */
-	if (unlikely(bv_in.bv_len & (cc->sector_size - 1)))
-		return -EIO;
-
 	dmreq = dmreq_of_req(cc, req);
 	dmreq->iv_sector = ctx->cc_sector;
 	if (test_bit(CRYPT_IV_LARGE_SECTORS, &cc->cipher_flags))
@@ -1459,10 +1459,10 @@ static int crypt_convert_block_skcipher(struct crypt_config *cc,
 	sg_out = &dmreq->sg_out[0];
 
 	sg_init_table(sg_in, 1);
-	sg_set_page(sg_in, bv_in.bv_page, cc->sector_size, bv_in.bv_offset);
+	sg_set_page(sg_in, page_in, cc->sector_size, off_in);
 
 	sg_init_table(sg_out, 1);
-	sg_set_page(sg_out, bv_out.bv_page, cc->sector_size, bv_out.bv_offset);
+	sg_set_page(sg_out, page_out, cc->sector_size, off_out);
 
 	if (cc->iv_gen_ops) {
 		/* For READs use IV stored in integrity metadata */
@@ -1493,12 +1493,79 @@ static int crypt_convert_block_skcipher(struct crypt_config *cc,
 	if (!r && cc->iv_gen_ops && cc->iv_gen_ops->post)
 		r = cc->iv_gen_ops->post(cc, org_iv, dmreq);
 
+	return r;
+}
+
+static int crypt_convert_block_skcipher(struct crypt_config *cc,
+					struct convert_context *ctx,
+					struct skcipher_request *req,
+					unsigned int tag_offset)
+{
+	struct bio_vec bv_in = bio_iter_iovec(ctx->bio_in, ctx->iter_in);
+	struct bio_vec bv_out = bio_iter_iovec(ctx->bio_out, ctx->iter_out);
+	int r;
+
+	/* Reject unexpected unaligned bio. */
+	if (unlikely(bv_in.bv_len & (cc->sector_size - 1)))
+		return -EIO;
+
+	r = crypt_convert_unit_skcipher(cc, ctx, req, tag_offset,
+					bv_in.bv_page, bv_in.bv_offset,
+					bv_out.bv_page, bv_out.bv_offset);
+
 	bio_advance_iter(ctx->bio_in, &ctx->iter_in, cc->sector_size);
 	bio_advance_iter(ctx->bio_out, &ctx->iter_out, cc->sector_size);
 
 	return r;
 }
 
+/*
+ * Convert all the data units of the current multi-page bvecs with one
+ * request and one pass through crypt_convert(), instead of one pass per
+ * page-sized bvec and per unit.  This matters for bios of large folios.
+ *
+ * Units that complete synchronously are accounted here, the last unit, or
+ * the first one that doesn't complete synchronously, is returned to
+ * crypt_convert() to be handled like a single block.
+ */
+static int crypt_convert_batch_skcipher(struct crypt_config *cc,
+					struct convert_context *ctx,
+					struct skcipher_request *req,
+					unsigned int tag_offset)
+{
+	struct bio_vec bv_in = mp_bvec_iter_bvec(ctx->bio_in->bi_io_vec,
+						 ctx->iter_in);
+	struct bio_vec bv_out = mp_bvec_iter_bvec(ctx->bio_out->bi_io_vec,
+						  ctx->iter_out);
+	unsigned int sector_step = cc->sector_size >> SECTOR_SHIFT;
+	unsigned int i, nr, off_in, off_out;
+	int r;
+
+	nr = min(bv_in.bv_len, bv_out.bv_len) / cc->sector_size;
+	/* Reject unexpected unaligned bio. */
+	if (unlikely(!nr))
+		return -EIO;
+	nr = min(nr, DM_CRYPT_BATCH_UNITS);
+
+	for (i = 0; ; i++) {
+		off_in = bv_in.bv_offset + i * cc->sector_size;
+		off_out = bv_out.bv_offset + i * cc->sector_size;
+		r = crypt_convert_unit_skcipher(cc, ctx, req, tag_offset,
+				nth_page(bv_in.bv_page, off_in >> PAGE_SHIFT),
+				offset_in_page(off_in),
+				nth_page(bv_out.bv_page, off_out >> PAGE_SHIFT),
+				offset_in_page(off_out));
+		if (r || i == nr - 1)
+			break;
+		ctx->cc_sector += sector_step;
+	}
+
+	bio_advance_iter(ctx->bio_in, &ctx->iter_in, (i + 1) * cc->sector_size);
+	bio_advance_iter(ctx->bio_out, &ctx->iter_out, (i + 1) * cc->sector_size);
+
+	return r;
+}
+
 static void kcryptd_async_done(void *async_req, int error);
 
 static int crypt_alloc_req_skcipher(struct crypt_config *cc,
@@ -1612,6 +1679,8 @@ static blk_status_t crypt_convert(struct crypt_config *cc,
 
 		if (crypt_integrity_aead(cc))
 			r = crypt_convert_block_aead(cc, ctx, ctx->r.req_aead, tag_offset);
+		else if (test_bit(CRYPT_BATCH_UNITS, &cc->cipher_flags))
+			r = crypt_convert_batch_skcipher(cc, ctx, ctx->r.req, tag_offset);
 		else
 			r = crypt_convert_block_skcipher(cc, ctx, ctx->r.req, tag_offset);
 
@@ -3488,6 +3557,14 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	if (test_bit(DM_CRYPT_HIGH_PRIORITY, &cc->flags))
 		set_user_nice(cc->write_thread, MIN_NICE);
 
+	/*
+	 * Data units can be converted a bvec at a time when they all use the
+	 * same tfm and don't carry per-unit integrity tags.
+	 */
+	if (!crypt_integrity_aead(cc) && cc->tfms_count == 1 &&
+	    !cc->used_tag_size)
+		set_bit(CRYPT_BATCH_UNITS, &cc->cipher_flags);
+
 	ti->num_flush_bios = 1;
 	ti->limit_swap_bios = true;
 	ti->accounts_remapped_io = true;
@@ -16,6 +16,7 @@
 #include <linux/pfn_t.h>
 #include <linux/libnvdimm.h>
 #include <linux/delay.h>
+#include <linux/list_sort.h>
 #include "dm-io-tracker.h"
 
 #define DM_MSG_PREFIX "writecache"
@@ -31,6 +32,7 @@
 #define MAX_AGE_DIV			16
 #define MAX_AGE_UNSPECIFIED		-1UL
 #define PAUSE_WRITEBACK			(HZ * 3)
+#define MAX_WRITEBACK_THREADS		16
 
 #define BITMAP_GRANULARITY	65536
 #if BITMAP_GRANULARITY < PAGE_SIZE
@@ -174,6 +176,7 @@ struct dm_writecache {
 	bool cleaner_set:1;
 	bool metadata_only:1;
 	bool pause_set:1;
+	bool writeback_threads_set:1;
 
 	unsigned int high_wm_percent_value;
 	unsigned int low_wm_percent_value;
@@ -186,6 +189,16 @@ struct dm_writecache {
 	struct work_struct writeback_work;
 	struct work_struct flush_work;
 
+	/*
+	 * Runs flush_work, so that commits aren't queued behind writeback,
+	 * and the writeback workers.
+	 */
+	struct workqueue_struct *worker_wq;
+	unsigned int writeback_threads;
+	struct writeback_worker *writeback_workers;
+	/* entries picked for writeback but not submitted yet */
+	atomic_long_t writeback_queued;
+
 	struct dm_io_tracker iot;
 
 	struct dm_io_client *dm_io;
@@ -220,6 +233,19 @@ struct dm_writecache {
 
 #define WB_LIST_INLINE		16
 
+struct writeback_list {
+	struct list_head list;
+	size_t size;
+	/* size when writeback_queued was last updated */
+	size_t throttled;
+};
+
+struct writeback_worker {
+	struct work_struct work;
+	struct dm_writecache *wc;
+	struct writeback_list wbl;
+};
+
 struct writeback_struct {
 	struct list_head endio_entry;
 	struct dm_writecache *wc;
@@ -869,7 +895,7 @@ static void writecache_autocommit_timer(struct timer_list *t)
 	struct dm_writecache *wc = from_timer(wc, t, autocommit_timer);
 
 	if (!writecache_has_error(wc))
-		queue_work(wc->writeback_wq, &wc->flush_work);
+		queue_work(wc->worker_wq, &wc->flush_work);
 }
 
 static void writecache_schedule_autocommit(struct dm_writecache *wc)
@@ -941,6 +967,7 @@ static void writecache_suspend(struct dm_target *ti)
 	wc_unlock(wc);
 
 	drain_workqueue(wc->writeback_wq);
+	flush_work(&wc->flush_work);
 
 	wc_lock(wc);
 	if (flush_on_suspend)
@@ -1427,7 +1454,7 @@ static void writecache_bio_copy_ssd(struct dm_writecache *wc, struct bio *bio,
 
 	if (unlikely(wc->uncommitted_blocks >= wc->autocommit_blocks)) {
 		wc->uncommitted_blocks = 0;
-		queue_work(wc->writeback_wq, &wc->flush_work);
+		queue_work(wc->worker_wq, &wc->flush_work);
 	} else {
 		writecache_schedule_autocommit(wc);
 	}
@@ -1809,17 +1836,21 @@ static bool wc_add_block(struct writeback_struct *wb, struct wc_entry *e)
 			    block_size, persistent_memory_page_offset(address)) != 0;
 }
 
-struct writeback_list {
-	struct list_head list;
-	size_t size;
-};
-
 static void __writeback_throttle(struct dm_writecache *wc, struct writeback_list *wbl)
 {
+	/*
+	 * The entries that other workers haven't submitted yet mustn't be
+	 * counted as in flight, or the workers could wait for each other.
+	 */
+	atomic_long_sub(wbl->throttled - wbl->size, &wc->writeback_queued);
+	wbl->throttled = wbl->size;
+
 	if (unlikely(wc->max_writeback_jobs)) {
-		if (READ_ONCE(wc->writeback_size) - wbl->size >= wc->max_writeback_jobs) {
+		if (READ_ONCE(wc->writeback_size) - atomic_long_read(&wc->writeback_queued) >=
+		    wc->max_writeback_jobs) {
 			wc_lock(wc);
-			while (wc->writeback_size - wbl->size >= wc->max_writeback_jobs)
+			while (wc->writeback_size - atomic_long_read(&wc->writeback_queued) >=
+			       wc->max_writeback_jobs)
 				writecache_wait_on_freelist(wc);
 			wc_unlock(wc);
 		}
@@ -1940,10 +1971,90 @@ static void __writecache_writeback_ssd(struct dm_writecache *wc, struct writebac
 	}
 }
 
+static void __writecache_writeback(struct dm_writecache *wc, struct writeback_list *wbl)
+{
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+
+	if (WC_MODE_PMEM(wc))
+		__writecache_writeback_pmem(wc, wbl);
+	else
+		__writecache_writeback_ssd(wc, wbl);
+
+	blk_finish_plug(&plug);
+}
+
+static void writecache_writeback_worker(struct work_struct *work)
+{
+	struct writeback_worker *w = container_of(work, struct writeback_worker, work);
+
+	__writecache_writeback(w->wc, &w->wbl);
+}
+
+/* The list is consumed from its tail, so sort it by descending sector */
+static int writecache_writeback_cmp(void *priv, const struct list_head *a,
+				    const struct list_head *b)
+{
+	struct dm_writecache *wc = priv;
+	struct wc_entry *ea = container_of(a, struct wc_entry, lru);
+	struct wc_entry *eb = container_of(b, struct wc_entry, lru);
+
+	return read_original_sector(wc, ea) < read_original_sector(wc, eb);
+}
+
+/*
+ * Sort the entries picked for writeback by origin sector and split them
+ * into ranges of about the same size, one per worker.  A range only ends
+ * where the sectors aren't contiguous, so the runs that
+ * writecache_writeback() built stay whole.  The caller writes back the
+ * first range itself.
+ */
+static void writecache_writeback_split(struct dm_writecache *wc, struct writeback_list *wbl)
+{
+	unsigned int nr = min_t(size_t, wc->writeback_threads, wbl->size);
+	size_t per_worker = DIV_ROUND_UP(wbl->size, nr);
+	struct writeback_list *cur;
+	struct wc_entry *e;
+	sector_t next_sector = 0;
+	unsigned int i, w = 0;
+
+	list_sort(wc, &wbl->list, writecache_writeback_cmp);
+
+	for (i = 0; i < nr; i++) {
+		INIT_LIST_HEAD(&wc->writeback_workers[i].wbl.list);
+		wc->writeback_workers[i].wbl.size = 0;
+	}
+
+	cur = &wc->writeback_workers[0].wbl;
+	while (wbl->size) {
+		e = container_of(wbl->list.prev, struct wc_entry, lru);
+		if (cur->size >= per_worker && w + 1 < nr &&
+		    read_original_sector(wc, e) != next_sector)
+			cur = &wc->writeback_workers[++w].wbl;
+
+		list_move(&e->lru, &cur->list);
+		cur->size++;
+		wbl->size--;
+		next_sector = read_original_sector(wc, e) + (wc->block_size >> SECTOR_SHIFT);
+	}
+
+	for (i = 0; i <= w; i++) {
+		cur = &wc->writeback_workers[i].wbl;
+		cur->throttled = cur->size;
+		if (i)
+			queue_work(wc->worker_wq, &wc->writeback_workers[i].work);
+	}
+
+	__writecache_writeback(wc, &wc->writeback_workers[0].wbl);
+
+	for (i = 1; i <= w; i++)
+		flush_work(&wc->writeback_workers[i].work);
+}
+
 static void writecache_writeback(struct work_struct *work)
 {
 	struct dm_writecache *wc = container_of(work, struct dm_writecache, writeback_work);
-	struct blk_plug plug;
 	struct wc_entry *f, *g, *e = NULL;
 	struct rb_node *node, *next_node;
 	struct list_head skipped;
@@ -2094,14 +2205,16 @@ static void writecache_writeback(struct work_struct *work)
 
 	wc_unlock(wc);
 
-	blk_start_plug(&plug);
+	atomic_long_set(&wc->writeback_queued, wbl.size);
+	wbl.throttled = wbl.size;
 
-	if (WC_MODE_PMEM(wc))
-		__writecache_writeback_pmem(wc, &wbl);
+	if (wc->writeback_threads > 1 && wbl.size > 1)
+		writecache_writeback_split(wc, &wbl);
 	else
-		__writecache_writeback_ssd(wc, &wbl);
+		__writecache_writeback(wc, &wbl);
 
-	blk_finish_plug(&plug);
+	/* Entries past the end of the origin are dropped without a throttle */
+	atomic_long_set(&wc->writeback_queued, 0);
 
 	if (unlikely(wc->writeback_all)) {
 		wc_lock(wc);
@@ -2200,6 +2313,11 @@ static void writecache_dtr(struct dm_target *ti)
 	if (wc->writeback_wq)
 		destroy_workqueue(wc->writeback_wq);
 
+	if (wc->worker_wq)
+		destroy_workqueue(wc->worker_wq);
+
+	kfree(wc->writeback_workers);
+
 	if (wc->dev)
 		dm_put_device(ti, wc->dev);
 
@@ -2241,7 +2359,7 @@ static int writecache_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	struct wc_memory_superblock s;
 
 	static struct dm_arg _args[] = {
-		{0, 18, "Invalid number of feature args"},
+		{0, 20, "Invalid number of feature args"},
 	};
 
 	as.argc = argc;
@@ -2285,6 +2403,14 @@ static int writecache_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	INIT_WORK(&wc->writeback_work, writecache_writeback);
 	INIT_WORK(&wc->flush_work, writecache_flush_work);
 
+	wc->worker_wq = alloc_workqueue("writecache-worker", WQ_MEM_RECLAIM | WQ_UNBOUND,
+					MAX_WRITEBACK_THREADS);
+	if (!wc->worker_wq) {
+		r = -ENOMEM;
+		ti->error = "Could not allocate worker workqueue";
+		goto bad;
+	}
+
 	dm_iot_init(&wc->iot);
 
 	raw_spin_lock_init(&wc->endio_list_lock);
@@ -2490,6 +2616,13 @@ static int writecache_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 			wc->pause = msecs_to_jiffies(pause_msecs);
 			wc->pause_set = true;
 			wc->pause_value = pause_msecs;
+		} else if (!strcasecmp(string, "writeback_threads") && opt_params >= 1) {
+			string = dm_shift_arg(&as), opt_params--;
+			if (sscanf(string, "%u%c", &wc->writeback_threads, &dummy) != 1)
+				goto invalid_optional;
+			if (!wc->writeback_threads || wc->writeback_threads > MAX_WRITEBACK_THREADS)
+				goto invalid_optional;
+			wc->writeback_threads_set = true;
 		} else {
 invalid_optional:
 			r = -EINVAL;
@@ -2504,6 +2637,22 @@ static int writecache_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	if (!wc->writeback_threads)
+		wc->writeback_threads = 1;
+	if (wc->writeback_threads > 1) {
+		wc->writeback_workers = kcalloc(wc->writeback_threads,
+						sizeof(struct writeback_worker), GFP_KERNEL);
+		if (!wc->writeback_workers) {
+			r = -ENOMEM;
+			ti->error = "Could not allocate writeback workers";
+			goto bad;
+		}
+		for (i = 0; i < wc->writeback_threads; i++) {
+			wc->writeback_workers[i].wc = wc;
+			INIT_WORK(&wc->writeback_workers[i].work, writecache_writeback_worker);
+		}
+	}
+
 	if (WC_MODE_PMEM(wc)) {
 		if (!dax_synchronous(wc->ssd_dev->dax_dev)) {
 			r = -EOPNOTSUPP;
@@ -2727,6 +2876,8 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 			extra_args++;
 		if (wc->pause_set)
 			extra_args += 2;
+		if (wc->writeback_threads_set)
+			extra_args += 2;
 
 		DMEMIT("%u", extra_args);
 		if (wc->start_sector_set)
@@ -2751,6 +2902,8 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 			DMEMIT(" metadata_only");
 		if (wc->pause_set)
 			DMEMIT(" pause_writeback %u", wc->pause_value);
+		if (wc->writeback_threads_set)
+			DMEMIT(" writeback_threads %u", wc->writeback_threads);
 		break;
 	case STATUSTYPE_IMA:
 		*result = '\0';
@@ -2760,7 +2913,7 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 
 static struct target_type writecache_target = {
 	.name			= "writecache",
-	.version		= {1, 6, 0},
+	.version		= {1, 7, 0},
 	.module			= THIS_MODULE,
 	.ctr			= writecache_ctr,
 	.dtr			= writecache_dtr,
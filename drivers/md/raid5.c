@@ -1143,7 +1143,7 @@ static void ops_run_io(struct stripe_head *sh, struct stripe_head_state *s)
 	struct stripe_head *head_sh = sh;
 	struct bio_list pending_bios = BIO_EMPTY_LIST;
 	struct r5dev *dev;
-	bool should_defer;
+	bool should_defer, written = false;
 
 	might_sleep();
 
@@ -1176,6 +1176,8 @@ static void ops_run_io(struct stripe_head *sh, struct stripe_head_state *s)
 			continue;
 		if (test_and_clear_bit(R5_SyncIO, &sh->dev[i].flags))
 			op_flags |= REQ_SYNC;
+		if (op == REQ_OP_WRITE)
+			written = true;
 
 again:
 		dev = &sh->dev[i];
@@ -1363,6 +1365,15 @@ static void ops_run_io(struct stripe_head *sh, struct stripe_head_state *s)
 
 	if (should_defer && !bio_list_empty(&pending_bios))
 		defer_issue_bios(conf, head_sh->sector, &pending_bios);
+
+	if (written) {
+		unsigned long nr = 1;
+
+		if (head_sh->batch_head)
+			list_for_each_entry(sh, &head_sh->batch_list, batch_list)
+				nr++;
+		this_cpu_add(conf->percpu->stripes_written, nr);
+	}
 }
 
 static struct dma_async_tx_descriptor *
@@ -6646,11 +6657,11 @@ static int handle_active_stripes(struct r5conf *conf, int group,
 				 struct list_head *temp_inactive_list)
 		__must_hold(&conf->device_lock)
 {
-	struct stripe_head *batch[MAX_STRIPE_BATCH], *sh;
+	struct stripe_head *batch[MAX_STRIPE_HANDLE_BATCH], *sh;
 	int i, batch_size = 0, hash;
 	bool release_inactive = false;
 
-	while (batch_size < MAX_STRIPE_BATCH &&
+	while (batch_size < MAX_STRIPE_HANDLE_BATCH &&
 			(sh = __get_priority_stripe(conf, group)) != NULL)
 		batch[batch_size++] = sh;
 
@@ -7141,6 +7152,27 @@ stripe_cache_active_show(struct mddev *mddev, char *page)
 static struct md_sysfs_entry
 raid5_stripecache_active = __ATTR_RO(stripe_cache_active);
 
+static ssize_t
+stripes_written_show(struct mddev *mddev, char *page)
+{
+	struct r5conf *conf;
+	unsigned long written = 0;
+	int cpu, ret = 0;
+
+	spin_lock(&mddev->lock);
+	conf = mddev->private;
+	if (conf && conf->percpu) {
+		for_each_possible_cpu(cpu)
+			written += per_cpu_ptr(conf->percpu, cpu)->stripes_written;
+		ret = sprintf(page, "%lu\n", written);
+	}
+	spin_unlock(&mddev->lock);
+	return ret;
+}
+
+static struct md_sysfs_entry
+raid5_stripes_written = __ATTR_RO(stripes_written);
+
 static ssize_t
 raid5_show_group_thread_cnt(struct mddev *mddev, char *page)
 {
@@ -7215,6 +7247,7 @@ raid5_group_thread_cnt = __ATTR(group_thread_cnt, S_IRUGO | S_IWUSR,
 static struct attribute *raid5_attrs[] =  {
 	&raid5_stripecache_size.attr,
 	&raid5_stripecache_active.attr,
+	&raid5_stripes_written.attr,
 	&raid5_preread_bypass_threshold.attr,
 	&raid5_group_thread_cnt.attr,
 	&raid5_skip_copy.attr,
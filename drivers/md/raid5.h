@@ -495,6 +495,11 @@ struct disk_info {
 #define NR_HASH			(PAGE_SIZE / sizeof(struct hlist_head))
 #define HASH_MASK		(NR_HASH - 1)
 #define MAX_STRIPE_BATCH	8
+/*
+ * Stripes taken off the lists per device_lock round trip by raid5d and the
+ * group workers.  Workers are still woken per MAX_STRIPE_BATCH stripes.
+ */
+#define MAX_STRIPE_HANDLE_BATCH	(MAX_STRIPE_BATCH * 2)
 
 /* NOTE NR_STRIPE_HASH_LOCKS must remain below 64.
  * This is because we sometimes take all the spinlocks
@@ -569,6 +574,7 @@ struct raid5_percpu {
 				     */
 	int             scribble_obj_size;
 	local_lock_t    lock;
+	unsigned long	stripes_written; /* stripes that issued writes */
 };
 
 struct r5conf {
@@ -99,7 +99,8 @@ static void tun_default_link_ksettings(struct net_device *dev,
 #define TUN_VNET_BE     0x40000000
 
 #define TUN_FEATURES (IFF_NO_PI | IFF_ONE_QUEUE | IFF_VNET_HDR | \
-		      IFF_MULTI_QUEUE | IFF_NAPI | IFF_NAPI_FRAGS)
+		      IFF_MULTI_QUEUE | IFF_NAPI | IFF_NAPI_FRAGS | \
+		      IFF_MULTI_PKT)
 
 #define GOODCOPY_LEN 128
 
@@ -1400,6 +1401,8 @@ static void tun_net_initialize(struct net_device *dev)
 		dev->xdp_features = NETDEV_XDP_ACT_BASIC |
 				    NETDEV_XDP_ACT_REDIRECT |
 				    NETDEV_XDP_ACT_NDO_XMIT;
+		/* Readers only copy redirected frames out */
+		dev->xdp_xmit_shared = 1;
 
 		break;
 	}
@@ -1576,6 +1579,33 @@ static void tun_rx_batched(struct tun_struct *tun, struct tun_file *tfile,
 	}
 }
 
+/* Deliver what tun_get_user() held back for a batch that was cut short */
+static void tun_rx_flush(struct tun_file *tfile)
+{
+	struct sk_buff_head *queue = &tfile->sk.sk_write_queue;
+	struct sk_buff_head process_queue;
+	struct sk_buff *skb;
+
+	if (tfile->napi_enabled) {
+		local_bh_disable();
+		napi_schedule(&tfile->napi);
+		local_bh_enable();
+		return;
+	}
+
+	__skb_queue_head_init(&process_queue);
+	spin_lock(&queue->lock);
+	skb_queue_splice_tail_init(queue, &process_queue);
+	spin_unlock(&queue->lock);
+
+	local_bh_disable();
+	while ((skb = __skb_dequeue(&process_queue))) {
+		skb_record_rx_queue(skb, tfile->queue_index);
+		netif_receive_skb(skb);
+	}
+	local_bh_enable();
+}
+
 static bool tun_can_build_skb(struct tun_struct *tun, struct tun_file *tfile,
 			      int len, int noblock, bool zerocopy)
 {
@@ -2036,6 +2066,51 @@ static ssize_t tun_get_user(struct tun_struct *tun, struct tun_file *tfile,
 	return err ?: total_len;
 }
 
+/* IFF_MULTI_PKT: a write() is a sequence of struct tun_mpkt_hdr + packet */
+static ssize_t tun_get_user_multi(struct tun_struct *tun,
+				  struct tun_file *tfile,
+				  struct iov_iter *from, int noblock)
+{
+	struct tun_mpkt_hdr hdr;
+	ssize_t total = 0, ret = 0;
+	bool pending = false;
+
+	while (iov_iter_count(from) >= sizeof(hdr)) {
+		struct iov_iter pkt;
+		bool more;
+
+		if (!copy_from_iter_full(&hdr, sizeof(hdr), from)) {
+			ret = -EFAULT;
+			break;
+		}
+		if (!hdr.len || hdr.len > iov_iter_count(from)) {
+			ret = -EINVAL;
+			break;
+		}
+
+		pkt = *from;
+		iov_iter_truncate(&pkt, hdr.len);
+		iov_iter_advance(from, hdr.len);
+
+		/* Let the rx batching hold packets until the last one */
+		more = iov_iter_count(from) >= sizeof(hdr);
+		ret = tun_get_user(tun, tfile, NULL, &pkt, noblock, more);
+		if (ret < 0)
+			break;
+
+		pending = more;
+		total += sizeof(hdr) + hdr.len;
+	}
+
+	if (pending)
+		tun_rx_flush(tfile);
+
+	if (!total && !ret && iov_iter_count(from))
+		ret = -EINVAL;
+
+	return total ?: ret;
+}
+
 static ssize_t tun_chr_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
 	struct file *file = iocb->ki_filp;
@@ -2050,7 +2125,10 @@ static ssize_t tun_chr_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	if ((file->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT))
 		noblock = 1;
 
-	result = tun_get_user(tun, tfile, NULL, from, noblock, false);
+	if (tun->flags & IFF_MULTI_PKT)
+		result = tun_get_user_multi(tun, tfile, from, noblock);
+	else
+		result = tun_get_user(tun, tfile, NULL, from, noblock, false);
 
 	tun_put(tun);
 	return result;
@@ -2257,6 +2335,89 @@ static ssize_t tun_do_read(struct tun_struct *tun, struct tun_file *tfile,
 	return ret;
 }
 
+static int tun_ptr_peek_len(void *ptr)
+{
+	if (likely(ptr)) {
+		if (tun_is_xdp_frame(ptr)) {
+			struct xdp_frame *xdpf = tun_ptr_to_xdp(ptr);
+
+			return xdpf->len;
+		}
+		return __skb_array_len_with_tag(ptr);
+	} else {
+		return 0;
+	}
+}
+
+/* Consume the next entry of the tx ring, if it fits in @room bytes */
+static void *tun_ring_consume_fit(struct tun_file *tfile, size_t hdr_len,
+				  size_t room)
+{
+	struct ptr_ring *ring = &tfile->tx_ring;
+	void *ptr;
+
+	spin_lock(&ring->consumer_lock);
+	ptr = __ptr_ring_peek(ring);
+	if (ptr && hdr_len + tun_ptr_peek_len(ptr) <= room)
+		ptr = __ptr_ring_consume(ring);
+	else
+		ptr = NULL;
+	spin_unlock(&ring->consumer_lock);
+
+	return ptr;
+}
+
+/* IFF_MULTI_PKT: fill a read() with as many whole packets as fit, each after
+ * a struct tun_mpkt_hdr.  Only the first packet may be truncated.
+ */
+static ssize_t tun_do_read_multi(struct tun_struct *tun,
+				 struct tun_file *tfile,
+				 struct iov_iter *to, int noblock)
+{
+	struct tun_mpkt_hdr hdr;
+	size_t hdr_len = 0;
+	ssize_t total = 0, ret;
+	void *ptr;
+	int err;
+
+	if (iov_iter_count(to) <= sizeof(hdr))
+		return -EINVAL;
+
+	if (!(tun->flags & IFF_NO_PI))
+		hdr_len += sizeof(struct tun_pi);
+	if (tun->flags & IFF_VNET_HDR)
+		hdr_len += READ_ONCE(tun->vnet_hdr_sz);
+
+	ptr = tun_ring_recv(tfile, noblock, &err);
+	if (!ptr)
+		return err;
+
+	do {
+		struct iov_iter hdr_iter = *to;
+		size_t room = iov_iter_count(to) - sizeof(hdr);
+
+		/* The header goes in front once the packet length is known */
+		iov_iter_advance(to, sizeof(hdr));
+		ret = tun_do_read(tun, tfile, to, noblock, ptr);
+		if (ret < 0)
+			break;
+
+		hdr.len = min_t(size_t, ret, room);
+		if (copy_to_iter(&hdr, sizeof(hdr), &hdr_iter) != sizeof(hdr)) {
+			ret = -EFAULT;
+			break;
+		}
+		total += sizeof(hdr) + hdr.len;
+
+		if (iov_iter_count(to) <= sizeof(hdr))
+			break;
+		ptr = tun_ring_consume_fit(tfile, hdr_len,
+					   iov_iter_count(to) - sizeof(hdr));
+	} while (ptr);
+
+	return total ?: ret;
+}
+
 static ssize_t tun_chr_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
 	struct file *file = iocb->ki_filp;
@@ -2271,7 +2432,10 @@ static ssize_t tun_chr_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	if ((file->f_flags & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT))
 		noblock = 1;
 
-	ret = tun_do_read(tun, tfile, to, noblock, NULL);
+	if (tun->flags & IFF_MULTI_PKT)
+		ret = tun_do_read_multi(tun, tfile, to, noblock);
+	else
+		ret = tun_do_read(tun, tfile, to, noblock, NULL);
 	ret = min_t(ssize_t, ret, len);
 	if (ret > 0)
 		iocb->ki_pos = ret;
@@ -2654,20 +2818,6 @@ static int tun_recvmsg(struct socket *sock, struct msghdr *m, size_t total_len,
 	return ret;
 }
 
-static int tun_ptr_peek_len(void *ptr)
-{
-	if (likely(ptr)) {
-		if (tun_is_xdp_frame(ptr)) {
-			struct xdp_frame *xdpf = tun_ptr_to_xdp(ptr);
-
-			return xdpf->len;
-		}
-		return __skb_array_len_with_tag(ptr);
-	} else {
-		return 0;
-	}
-}
-
 static int tun_peek_len(struct socket *sock)
 {
 	struct tun_file *tfile = container_of(sock, struct tun_file, socket);
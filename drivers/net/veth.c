@@ -38,6 +38,11 @@
 
 #define VETH_XDP_TX_BULK_SIZE	16
 #define VETH_XDP_BATCH		16
+#define VETH_XMIT_BULK_SIZE	16
+
+static bool gro = true;
+module_param(gro, bool, 0644);
+MODULE_PARM_DESC(gro, "Enable GRO (and NAPI) on new veth pairs");
 
 struct veth_stats {
 	u64	rx_drops;
@@ -78,6 +83,18 @@ struct veth_priv {
 	unsigned int		requested_headroom;
 };
 
+/* skbs queued by veth_xmit() for the NAPI ring of a peer rq, flushed with a
+ * single producer lock hold when the stack has no more packets for us.
+ */
+struct veth_xmit_bq {
+	struct veth_rq		*rq;
+	struct veth_priv	*priv;
+	unsigned int		count;
+	struct sk_buff		*q[VETH_XMIT_BULK_SIZE];
+};
+
+static DEFINE_PER_CPU(struct veth_xmit_bq, veth_xmit_bq);
+
 struct veth_xdp_tx_bq {
 	struct xdp_frame *q[VETH_XDP_TX_BULK_SIZE];
 	unsigned int count;
@@ -304,22 +321,52 @@ static void __veth_xdp_flush(struct veth_rq *rq)
 	}
 }
 
-static int veth_xdp_rx(struct veth_rq *rq, struct sk_buff *skb)
+static void veth_xmit_bq_flush(struct veth_xmit_bq *bq)
 {
-	if (unlikely(ptr_ring_produce(&rq->xdp_ring, skb))) {
-		dev_kfree_skb_any(skb);
-		return NET_RX_DROP;
+	struct veth_rq *rq = bq->rq;
+	unsigned int i, n = 0;
+
+	spin_lock(&rq->xdp_ring.producer_lock);
+	for (i = 0; i < bq->count; i++) {
+		if (unlikely(__ptr_ring_produce(&rq->xdp_ring, bq->q[i])))
+			break;
+		n++;
+	}
+	spin_unlock(&rq->xdp_ring.producer_lock);
+
+	for (; i < bq->count; i++) {
+		dev_kfree_skb_any(bq->q[i]);
+		atomic64_inc(&bq->priv->dropped);
 	}
 
-	return NET_RX_SUCCESS;
+	if (n)
+		__veth_xdp_flush(rq);
+	bq->count = 0;
+	bq->rq = NULL;
 }
 
-static int veth_forward_skb(struct net_device *dev, struct sk_buff *skb,
-			    struct veth_rq *rq, bool xdp)
+/* Called in the xmit path, BH disabled. veth_xmit() flushes the queue
+ * whenever netdev_xmit_more() is false, so nothing is left on it past the
+ * current dev_hard_start_xmit() run.
+ */
+static void veth_xmit_bq_enqueue(struct veth_xmit_bq *bq,
+				 struct veth_priv *priv, struct veth_rq *rq,
+				 struct sk_buff *skb)
 {
-	return __dev_forward_skb(dev, skb) ?: xdp ?
-		veth_xdp_rx(rq, skb) :
-		__netif_rx(skb);
+	if (bq->count && bq->rq != rq)
+		veth_xmit_bq_flush(bq);
+
+	bq->rq = rq;
+	bq->priv = priv;
+	bq->q[bq->count++] = skb;
+
+	if (bq->count == VETH_XMIT_BULK_SIZE)
+		veth_xmit_bq_flush(bq);
+}
+
+static int veth_forward_skb(struct net_device *dev, struct sk_buff *skb)
+{
+	return __dev_forward_skb(dev, skb) ?: __netif_rx(skb);
 }
 
 /* return true if the specified skb has chances of GRO aggregation
@@ -331,18 +378,23 @@ static int veth_forward_skb(struct net_device *dev, struct sk_buff *skb,
  * in UDP aggregation, explicitly check for that if the skb is suspected
  * - the sock_wfree destructor is used by UDP, ICMP and XDP sockets -
  * to belong to locally generated UDP traffic.
+ * Locally generated TCP always goes through NAPI: segments that were not
+ * built by TSO can still be merged, and keeping the whole flow on one path
+ * avoids reordering its packets.
  */
 static bool veth_skb_is_eligible_for_gro(const struct net_device *dev,
 					 const struct net_device *rcv,
 					 const struct sk_buff *skb)
 {
 	return !(dev->features & NETIF_F_ALL_TSO) ||
+		(skb->sk && sk_fullsock(skb->sk) && sk_is_tcp(skb->sk)) ||
 		(skb->destructor == sock_wfree &&
 		 rcv->features & (NETIF_F_GRO_FRAGLIST | NETIF_F_GRO_UDP_FWD));
 }
 
 static netdev_tx_t veth_xmit(struct sk_buff *skb, struct net_device *dev)
 {
+	struct veth_xmit_bq *bq = this_cpu_ptr(&veth_xmit_bq);
 	struct veth_priv *rcv_priv, *priv = netdev_priv(dev);
 	struct veth_rq *rq = NULL;
 	int ret = NETDEV_TX_OK;
@@ -372,17 +424,21 @@ static netdev_tx_t veth_xmit(struct sk_buff *skb, struct net_device *dev)
 	}
 
 	skb_tx_timestamp(skb);
-	if (likely(veth_forward_skb(rcv, skb, rq, use_napi) == NET_RX_SUCCESS)) {
-		if (!use_napi)
-			dev_sw_netstats_tx_add(dev, 1, length);
-		else
-			__veth_xdp_flush(rq);
+	if (use_napi) {
+		if (unlikely(__dev_forward_skb(rcv, skb)))
+			goto drop;
+		veth_xmit_bq_enqueue(bq, priv, rq, skb);
+	} else if (likely(veth_forward_skb(rcv, skb) == NET_RX_SUCCESS)) {
+		dev_sw_netstats_tx_add(dev, 1, length);
 	} else {
 drop:
 		atomic64_inc(&priv->dropped);
 		ret = NET_XMIT_DROP;
 	}
 
+	if (bq->count && !netdev_xmit_more())
+		veth_xmit_bq_flush(bq);
+
 	rcu_read_unlock();
 
 	return ret;
@@ -1833,10 +1889,11 @@ static int veth_newlink(struct net *src_net, struct net_device *dev,
 	if (err < 0)
 		goto err_register_peer;
 
-	/* keep GRO disabled by default to be consistent with the established
-	 * veth behavior
+	/* GRO, hence NAPI, can be left off by default to be consistent with
+	 * the established veth behavior
 	 */
-	veth_disable_gro(peer);
+	if (!gro)
+		veth_disable_gro(peer);
 	netif_carrier_off(peer);
 
 	err = rtnl_configure_link(peer, ifmp, 0, NULL);
@@ -1880,7 +1937,8 @@ static int veth_newlink(struct net *src_net, struct net_device *dev,
 	if (err)
 		goto err_queues;
 
-	veth_disable_gro(dev);
+	if (!gro)
+		veth_disable_gro(dev);
 	/* update XDP supported features */
 	veth_set_xdp_features(dev);
 	veth_set_xdp_features(peer);
@@ -40,6 +40,7 @@
 
 #define FDB_AGE_DEFAULT 300 /* 5 min */
 #define FDB_AGE_INTERVAL (10 * HZ)	/* rescan interval */
+#define FDB_USED_INTERVAL HZ		/* granularity of fdb->used */
 
 /* UDP port for VXLAN traffic.
  * The IANA assigned port is 4789, but the Linux default is 8472
@@ -433,9 +434,12 @@ static struct vxlan_fdb *vxlan_find_mac(struct vxlan_dev *vxlan,
 {
 	struct vxlan_fdb *f;
 
+	/* Refreshing the entry from every cpu on every jiffy bounces it
+	 * between all of them; aging only needs to know about once a rescan.
+	 */
 	f = __vxlan_find_mac(vxlan, mac, vni);
-	if (f && f->used != jiffies)
-		f->used = jiffies;
+	if (f && time_after(jiffies, READ_ONCE(f->used) + FDB_USED_INTERVAL))
+		WRITE_ONCE(f->used, jiffies);
 
 	return f;
 }
@@ -1433,6 +1437,39 @@ static int vxlan_fdb_get(struct sk_buff *skb,
 	return err;
 }
 
+/* Move a learnt entry to the remote it was last seen behind. Rare enough
+ * to take the hash lock, unlike the refresh of an entry that didn't move.
+ */
+static void vxlan_snoop_migrate(struct vxlan_dev *vxlan, struct vxlan_fdb *f,
+				union vxlan_addr *src_ip, u32 ifindex)
+{
+	u32 hash_index = fdb_head_index(vxlan, f->eth_addr, f->vni);
+	struct vxlan_rdst *rdst;
+
+	spin_lock(&vxlan->hash_lock[hash_index]);
+
+	/* Recheck against a concurrent migration, update or removal */
+	if (__vxlan_find_mac(vxlan, f->eth_addr, f->vni) != f)
+		goto out;
+
+	rdst = first_remote_rtnl(f);
+	if (!rdst ||
+	    (vxlan_addr_equal(&rdst->remote_ip, src_ip) &&
+	     rdst->remote_ifindex == ifindex))
+		goto out;
+
+	if (net_ratelimit())
+		netdev_info(vxlan->dev,
+			    "%pM migrated from %pIS to %pIS\n",
+			    f->eth_addr, &rdst->remote_ip.sa, &src_ip->sa);
+
+	rdst->remote_ip = *src_ip;
+	f->updated = jiffies;
+	vxlan_fdb_notify(vxlan, f, rdst, RTM_NEWNEIGH, true, NULL);
+out:
+	spin_unlock(&vxlan->hash_lock[hash_index]);
+}
+
 /* Watch incoming packets to learn mapping between Ethernet address
  * and Tunnel endpoint.
  * Return true if packet is bogus and should be dropped.
@@ -1471,14 +1508,7 @@ static bool vxlan_snoop(struct net_device *dev,
 		if (rcu_access_pointer(f->nh))
 			return true;
 
-		if (net_ratelimit())
-			netdev_info(dev,
-				    "%pM migrated from %pIS to %pIS\n",
-				    src_mac, &rdst->remote_ip.sa, &src_ip->sa);
-
-		rdst->remote_ip = *src_ip;
-		f->updated = jiffies;
-		vxlan_fdb_notify(vxlan, f, rdst, RTM_NEWNEIGH, true, NULL);
+		vxlan_snoop_migrate(vxlan, f, src_ip, ifindex);
 	} else {
 		u32 hash_index = fdb_head_index(vxlan, src_mac, vni);
 
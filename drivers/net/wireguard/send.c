@@ -239,6 +239,53 @@ void wg_packet_send_keepalive(struct wg_peer *peer)
 	wg_packet_send_staged_packets(peer);
 }
 
+#define WG_GSO_MAX_SEGS 64
+
+/* Chains the packets following @head that have its length, the last one may
+ * be shorter, onto its frag_list as a single UDP GSO packet. The whole train
+ * then takes one trip down the IP output path and gets split back into the
+ * same datagrams by GSO, in hardware if the device can. Returns the first
+ * packet that was not chained.
+ */
+static struct sk_buff *wg_packet_gso_chain(struct sk_buff *head)
+{
+	struct sk_buff *skb = head->next, **tail;
+	unsigned int len = head->len, segs = 1;
+	bool short_seg;
+
+	if (!skb || skb_has_frag_list(head))
+		return skb;
+
+	tail = &skb_shinfo(head)->frag_list;
+	while (skb && skb->len <= len && !skb_has_frag_list(skb) &&
+	       PACKET_CB(skb)->ds == PACKET_CB(head)->ds &&
+	       segs < WG_GSO_MAX_SEGS &&
+	       head->len + skb->len <= GSO_LEGACY_MAX_SIZE - SKB_HEADER_LEN) {
+		*tail = skb;
+		tail = &skb->next;
+		head->len += skb->len;
+		head->data_len += skb->len;
+		head->truesize += skb->truesize;
+		++segs;
+		short_seg = skb->len < len;
+		skb = skb->next;
+		if (short_seg) /* Only the last segment may be short. */
+			break;
+	}
+	if (segs == 1)
+		return skb;
+	*tail = NULL;
+
+	skb_shinfo(head)->gso_type = SKB_GSO_UDP_L4;
+	skb_shinfo(head)->gso_size = len;
+	skb_shinfo(head)->gso_segs = segs;
+	/* The UDP header is pushed in front of the data by the tunnel xmit. */
+	head->ip_summed = CHECKSUM_PARTIAL;
+	head->csum_start = skb_headroom(head) - sizeof(struct udphdr);
+	head->csum_offset = offsetof(struct udphdr, check);
+	return skb;
+}
+
 static void wg_packet_create_data_done(struct wg_peer *peer, struct sk_buff *first)
 {
 	struct sk_buff *skb, *next;
@@ -246,8 +293,9 @@ static void wg_packet_create_data_done(struct wg_peer *peer, struct sk_buff *fir
 
 	wg_timers_any_authenticated_packet_traversal(peer);
 	wg_timers_any_authenticated_packet_sent(peer);
-	skb_list_walk_safe(first, skb, next) {
+	for (skb = first; skb; skb = next) {
 		is_keepalive = skb->len == message_data_len(0);
+		next = wg_packet_gso_chain(skb);
 		if (likely(!wg_socket_send_skb_to_peer(peer, skb,
 				PACKET_CB(skb)->ds) && !is_keepalive))
 			data_sent = true;
@@ -344,6 +344,12 @@ static void set_sock_opts(struct socket *sock)
 	sock->sk->sk_allocation = GFP_ATOMIC;
 	sock->sk->sk_sndbuf = INT_MAX;
 	sk_set_memalloc(sock->sk);
+	/* Let the outer UDP packets of a peer be aggregated by GRO. We don't
+	 * set UDP_FLAGS_ACCEPT_L4, so the socket splits them up again and
+	 * wg_receive() still sees one message at a time, but the batch makes
+	 * a single trip through the IP and UDP receive path.
+	 */
+	udp_set_bit(GRO_ENABLED, sock->sk);
 }
 
 int wg_socket_init(struct wg_device *wg, u16 port)
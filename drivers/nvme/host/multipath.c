@@ -18,8 +18,14 @@ static const char *nvme_iopolicy_names[] = {
 	[NVME_IOPOLICY_NUMA]	= "numa",
 	[NVME_IOPOLICY_RR]	= "round-robin",
 	[NVME_IOPOLICY_QD]      = "queue-depth",
+	[NVME_IOPOLICY_ST]	= "service-time",
 };
 
+/* Weight of a new sample in the service time EWMA, 1/8 */
+#define NVME_ST_EWMA_SHIFT	3
+/* Service time of a path not used for this long is no longer trusted */
+#define NVME_ST_STALE		HZ
+
 static int iopolicy = NVME_IOPOLICY_NUMA;
 
 static int nvme_set_iopolicy(const char *val, const struct kernel_param *kp)
@@ -32,6 +38,8 @@ static int nvme_set_iopolicy(const char *val, const struct kernel_param *kp)
 		iopolicy = NVME_IOPOLICY_RR;
 	else if (!strncmp(val, "queue-depth", 11))
 		iopolicy = NVME_IOPOLICY_QD;
+	else if (!strncmp(val, "service-time", 12))
+		iopolicy = NVME_IOPOLICY_ST;
 	else
 		return -EINVAL;
 
@@ -46,7 +54,7 @@ static int nvme_get_iopolicy(char *buf, const struct kernel_param *kp)
 module_param_call(iopolicy, nvme_set_iopolicy, nvme_get_iopolicy,
 	&iopolicy, 0644);
 MODULE_PARM_DESC(iopolicy,
-	"Default multipath I/O policy; 'numa' (default), 'round-robin' or 'queue-depth'");
+	"Default multipath I/O policy; 'numa' (default), 'round-robin', 'queue-depth' or 'service-time'");
 
 void nvme_mpath_default_iopolicy(struct nvme_subsystem *subsys)
 {
@@ -130,12 +138,18 @@ void nvme_mpath_start_request(struct request *rq)
 {
 	struct nvme_ns *ns = rq->q->queuedata;
 	struct gendisk *disk = ns->head->disk;
+	int policy = READ_ONCE(ns->head->subsys->iopolicy);
 
-	if (READ_ONCE(ns->head->subsys->iopolicy) == NVME_IOPOLICY_QD) {
+	if (policy == NVME_IOPOLICY_QD || policy == NVME_IOPOLICY_ST) {
 		atomic_inc(&ns->ctrl->nr_active);
 		nvme_req(rq)->flags |= NVME_MPATH_CNT_ACTIVE;
 	}
 
+	if (policy == NVME_IOPOLICY_ST && !blk_rq_is_passthrough(rq)) {
+		nvme_req(rq)->flags |= NVME_MPATH_SERVICE_TIME;
+		nvme_req(rq)->mpath_start_ns = ktime_get_ns();
+	}
+
 	if (!blk_queue_io_stat(disk->queue) || blk_rq_is_passthrough(rq))
 		return;
 
@@ -145,6 +159,24 @@ void nvme_mpath_start_request(struct request *rq)
 }
 EXPORT_SYMBOL_GPL(nvme_mpath_start_request);
 
+/*
+ * Concurrent completions may lose each other's update, which an estimate
+ * can live with.
+ */
+static void nvme_mpath_update_service_time(struct nvme_ns *ns, u64 sample)
+{
+	u64 ewma = READ_ONCE(ns->service_time_ns);
+
+	if (ewma && time_before(jiffies, READ_ONCE(ns->service_time_stamp) +
+					 NVME_ST_STALE))
+		ewma += (s64)(sample - ewma) >> NVME_ST_EWMA_SHIFT;
+	else
+		ewma = sample;
+
+	WRITE_ONCE(ns->service_time_ns, ewma);
+	WRITE_ONCE(ns->service_time_stamp, jiffies);
+}
+
 void nvme_mpath_end_request(struct request *rq)
 {
 	struct nvme_ns *ns = rq->q->queuedata;
@@ -152,6 +184,10 @@ void nvme_mpath_end_request(struct request *rq)
 	if (nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE)
 		atomic_dec_if_positive(&ns->ctrl->nr_active);
 
+	if (nvme_req(rq)->flags & NVME_MPATH_SERVICE_TIME)
+		nvme_mpath_update_service_time(ns,
+			ktime_get_ns() - nvme_req(rq)->mpath_start_ns);
+
 	if (!(nvme_req(rq)->flags & NVME_MPATH_IO_STATS))
 		return;
 	bdev_end_io_acct(ns->head->disk->part0, req_op(rq),
@@ -391,6 +427,59 @@ static struct nvme_ns *nvme_queue_depth_path(struct nvme_ns_head *head)
 	return best_opt ? best_opt : best_nonopt;
 }
 
+/*
+ * Expected time to complete one more I/O on @ns: its completion latency
+ * times the I/Os it would queue behind, plus itself. A path without a
+ * recent sample costs nothing, so it gets probed again.
+ */
+static u64 nvme_service_time(struct nvme_ns *ns)
+{
+	u64 ewma = READ_ONCE(ns->service_time_ns);
+
+	if (time_after_eq(jiffies, READ_ONCE(ns->service_time_stamp) +
+				   NVME_ST_STALE))
+		return 0;
+
+	return ewma * (atomic_read(&ns->ctrl->nr_active) + 1);
+}
+
+static struct nvme_ns *nvme_service_time_path(struct nvme_ns_head *head)
+{
+	struct nvme_ns *best_opt = NULL, *best_nonopt = NULL, *ns;
+	u64 min_opt = U64_MAX, min_nonopt = U64_MAX;
+	u64 st;
+
+	list_for_each_entry_srcu(ns, &head->list, siblings,
+				 srcu_read_lock_held(&head->srcu)) {
+		if (nvme_path_is_disabled(ns))
+			continue;
+
+		st = nvme_service_time(ns);
+
+		switch (ns->ana_state) {
+		case NVME_ANA_OPTIMIZED:
+			if (st < min_opt) {
+				min_opt = st;
+				best_opt = ns;
+			}
+			break;
+		case NVME_ANA_NONOPTIMIZED:
+			if (st < min_nonopt) {
+				min_nonopt = st;
+				best_nonopt = ns;
+			}
+			break;
+		default:
+			break;
+		}
+
+		if (min_opt == 0)
+			return best_opt;
+	}
+
+	return best_opt ? best_opt : best_nonopt;
+}
+
 static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 {
 	return nvme_ctrl_state(ns->ctrl) == NVME_CTRL_LIVE &&
@@ -415,6 +504,8 @@ inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 	switch (READ_ONCE(head->subsys->iopolicy)) {
 	case NVME_IOPOLICY_QD:
 		return nvme_queue_depth_path(head);
+	case NVME_IOPOLICY_ST:
+		return nvme_service_time_path(head);
 	case NVME_IOPOLICY_RR:
 		return nvme_round_robin_path(head);
 	default:
@@ -957,6 +1048,15 @@ static ssize_t ana_state_show(struct device *dev, struct device_attribute *attr,
 }
 DEVICE_ATTR_RO(ana_state);
 
+static ssize_t service_time_ns_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct nvme_ns *ns = nvme_get_ns_from_dev(dev);
+
+	return sysfs_emit(buf, "%llu\n", READ_ONCE(ns->service_time_ns));
+}
+DEVICE_ATTR_RO(service_time_ns);
+
 static int nvme_lookup_ana_group_desc(struct nvme_ctrl *ctrl,
 		struct nvme_ana_group_desc *desc, void *data)
 {
@@ -45,6 +45,10 @@
 #define NVME_MAX_SEGS	128
 #define NVME_MAX_NR_ALLOCATIONS	5
 
+/* Descriptor arenas are allocated in huge page sized chunks */
+#define NVME_DESC_CHUNK_SIZE	SZ_2M
+#define NVME_DESC_CHUNK_SLOTS	(NVME_DESC_CHUNK_SIZE / NVME_CTRL_PAGE_SIZE)
+
 static int use_threaded_interrupts;
 module_param(use_threaded_interrupts, int, 0444);
 
@@ -105,6 +109,12 @@ static bool noacpi;
 module_param(noacpi, bool, 0444);
 MODULE_PARM_DESC(noacpi, "disable acpi bios quirks");
 
+static bool desc_arena;
+module_param(desc_arena, bool, 0444);
+MODULE_PARM_DESC(desc_arena,
+	"Preallocate the first PRP/SGL list page of every I/O queue entry, "
+	"instead of allocating it per I/O (costs a page per entry)");
+
 struct nvme_dev;
 struct nvme_queue;
 
@@ -215,6 +225,14 @@ struct nvme_queue {
 	__le32 *dbbuf_sq_ei;
 	__le32 *dbbuf_cq_ei;
 	struct completion delete_done;
+	/* one list page per tag, see nvme_desc_slot() */
+	struct nvme_desc_chunk *desc_chunks;
+	unsigned int nr_desc_chunks;
+};
+
+struct nvme_desc_chunk {
+	void *virt;
+	dma_addr_t dma;
 };
 
 union nvme_descriptor {
@@ -234,6 +252,7 @@ struct nvme_iod {
 	bool aborted;
 	s8 nr_allocations;	/* PRP list pool allocations. 0 means small
 				   pool in use */
+	bool desc_slot;		/* list[0] is the queue's slot for this tag */
 	unsigned int dma_len;	/* length of single DMA segment mapping */
 	dma_addr_t first_dma;
 	dma_addr_t meta_dma;
@@ -522,6 +541,40 @@ static inline bool nvme_pci_use_sgls(struct nvme_dev *dev, struct request *req,
 	return true;
 }
 
+/*
+ * The list page preallocated for the tag of @req, replacing the first
+ * prp_page_pool allocation of the request.
+ */
+static void *nvme_desc_slot(struct request *req, dma_addr_t *dma)
+{
+	struct nvme_queue *nvmeq = req->mq_hctx->driver_data;
+	unsigned int chunk = req->tag / NVME_DESC_CHUNK_SLOTS;
+	unsigned int offset;
+
+	if (chunk >= nvmeq->nr_desc_chunks)
+		return NULL;
+
+	offset = (req->tag % NVME_DESC_CHUNK_SLOTS) * NVME_CTRL_PAGE_SIZE;
+	*dma = nvmeq->desc_chunks[chunk].dma + offset;
+	return nvmeq->desc_chunks[chunk].virt + offset;
+}
+
+/* Get the first PRP/SGL list of @req: its slot, or from @pool */
+static void *nvme_alloc_desc(struct request *req, struct dma_pool *pool,
+			     dma_addr_t *dma)
+{
+	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
+	void *list;
+
+	list = nvme_desc_slot(req, dma);
+	if (list) {
+		iod->desc_slot = true;
+		iod->nr_allocations = 1;
+		return list;
+	}
+	return dma_pool_alloc(pool, GFP_ATOMIC, dma);
+}
+
 static void nvme_free_prps(struct nvme_dev *dev, struct request *req)
 {
 	const int last_prp = NVME_CTRL_PAGE_SIZE / sizeof(__le64) - 1;
@@ -533,7 +586,8 @@ static void nvme_free_prps(struct nvme_dev *dev, struct request *req)
 		__le64 *prp_list = iod->list[i].prp_list;
 		dma_addr_t next_dma_addr = le64_to_cpu(prp_list[last_prp]);
 
-		dma_pool_free(dev->prp_page_pool, prp_list, dma_addr);
+		if (i || !iod->desc_slot)
+			dma_pool_free(dev->prp_page_pool, prp_list, dma_addr);
 		dma_addr = next_dma_addr;
 	}
 }
@@ -555,6 +609,8 @@ static void nvme_unmap_data(struct nvme_dev *dev, struct request *req)
 	if (iod->nr_allocations == 0)
 		dma_pool_free(dev->prp_small_pool, iod->list[0].sg_list,
 			      iod->first_dma);
+	else if (iod->nr_allocations == 1 && iod->desc_slot)
+		;
 	else if (iod->nr_allocations == 1)
 		dma_pool_free(dev->prp_page_pool, iod->list[0].sg_list,
 			      iod->first_dma);
@@ -620,11 +676,13 @@ static blk_status_t nvme_pci_setup_prps(struct nvme_dev *dev,
 		iod->nr_allocations = 1;
 	}
 
-	prp_list = dma_pool_alloc(pool, GFP_ATOMIC, &prp_dma);
+	prp_list = nvme_alloc_desc(req, pool, &prp_dma);
 	if (!prp_list) {
 		iod->nr_allocations = -1;
 		return BLK_STS_RESOURCE;
 	}
+	/* chained pages always come from the page pool */
+	pool = dev->prp_page_pool;
 	iod->list[0].prp_list = prp_list;
 	iod->first_dma = prp_dma;
 	i = 0;
@@ -710,7 +768,7 @@ static blk_status_t nvme_pci_setup_sgls(struct nvme_dev *dev,
 		iod->nr_allocations = 1;
 	}
 
-	sg_list = dma_pool_alloc(pool, GFP_ATOMIC, &sgl_dma);
+	sg_list = nvme_alloc_desc(req, pool, &sgl_dma);
 	if (!sg_list) {
 		iod->nr_allocations = -1;
 		return BLK_STS_RESOURCE;
@@ -843,6 +901,7 @@ static blk_status_t nvme_prep_rq(struct nvme_dev *dev, struct request *req)
 
 	iod->aborted = false;
 	iod->nr_allocations = -1;
+	iod->desc_slot = false;
 	iod->sgt.nents = 0;
 
 	ret = nvme_setup_cmd(req->q->queuedata, req);
@@ -1438,8 +1497,52 @@ static enum blk_eh_timer_return nvme_timeout(struct request *req)
 	return BLK_EH_DONE;
 }
 
+static void nvme_free_desc_arena(struct nvme_queue *nvmeq)
+{
+	unsigned int i;
+
+	for (i = 0; i < nvmeq->nr_desc_chunks; i++)
+		dma_free_coherent(nvmeq->dev->dev, NVME_DESC_CHUNK_SIZE,
+				  nvmeq->desc_chunks[i].virt,
+				  nvmeq->desc_chunks[i].dma);
+	kfree(nvmeq->desc_chunks);
+	nvmeq->desc_chunks = NULL;
+	nvmeq->nr_desc_chunks = 0;
+}
+
+/*
+ * Best effort: tags without a slot, or all of them if this fails, allocate
+ * their lists from the dma pools as before.
+ */
+static void nvme_alloc_desc_arena(struct nvme_dev *dev,
+				  struct nvme_queue *nvmeq)
+{
+	unsigned int nr = DIV_ROUND_UP(nvmeq->q_depth, NVME_DESC_CHUNK_SLOTS);
+	unsigned int i;
+
+	nvmeq->desc_chunks = kcalloc_node(nr, sizeof(*nvmeq->desc_chunks),
+					  GFP_KERNEL, dev_to_node(dev->dev));
+	if (!nvmeq->desc_chunks)
+		return;
+
+	for (i = 0; i < nr; i++) {
+		nvmeq->desc_chunks[i].virt =
+			dma_alloc_coherent(dev->dev, NVME_DESC_CHUNK_SIZE,
+					   &nvmeq->desc_chunks[i].dma,
+					   GFP_KERNEL | __GFP_NOWARN);
+		if (!nvmeq->desc_chunks[i].virt)
+			break;
+	}
+	nvmeq->nr_desc_chunks = i;
+	if (!i) {
+		kfree(nvmeq->desc_chunks);
+		nvmeq->desc_chunks = NULL;
+	}
+}
+
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	nvme_free_desc_arena(nvmeq);
 	dma_free_coherent(nvmeq->dev->dev, CQ_SIZE(nvmeq),
 				(void *)nvmeq->cqes, nvmeq->cq_dma_addr);
 	if (!nvmeq->sq_cmds)
@@ -1581,6 +1684,8 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	nvmeq->cq_phase = 1;
 	nvmeq->q_db = &dev->dbs[qid * 2 * dev->db_stride];
 	nvmeq->qid = qid;
+	if (qid && desc_arena)
+		nvme_alloc_desc_arena(dev, nvmeq);
 	dev->ctrl.queue_count++;
 
 	return 0;
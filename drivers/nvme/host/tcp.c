@@ -9,6 +9,8 @@
 #include <linux/slab.h>
 #include <linux/err.h>
 #include <linux/key.h>
+#include <linux/kthread.h>
+#include <linux/debugfs.h>
 #include <linux/nvme-tcp.h>
 #include <linux/nvme-keyring.h>
 #include <net/sock.h>
@@ -44,6 +46,19 @@ static bool wq_unbound;
 module_param(wq_unbound, bool, 0644);
 MODULE_PARM_DESC(wq_unbound, "Use unbound workqueue for nvme-tcp IO context (default false)");
 
+/*
+ * Drive each I/O queue from its own kthread bound to the queue io_cpu instead
+ * of nvme_tcp_wq. An idle kthread busy-polls the socket for io_poll_usecs
+ * before going to sleep. Takes effect on the next queue (re)connect.
+ */
+static bool io_kthread;
+module_param(io_kthread, bool, 0644);
+MODULE_PARM_DESC(io_kthread, "Use a per-queue kthread for nvme-tcp IO context (default false)");
+
+static unsigned int io_poll_usecs = 50;
+module_param(io_poll_usecs, uint, 0644);
+MODULE_PARM_DESC(io_poll_usecs, "Busy-poll time of an idle IO kthread in usecs (default 50)");
+
 /*
  * TLS handshake timeout
  */
@@ -114,6 +129,8 @@ struct nvme_tcp_request {
 	struct llist_node	lentry;
 	__le32			ddgst;
 
+	u64			start_ns;
+
 	struct bio		*curr_bio;
 	struct iov_iter		iter;
 
@@ -135,10 +152,22 @@ enum nvme_tcp_recv_state {
 	NVME_TCP_RECV_DDGST,
 };
 
+/* Max number of command PDUs coalesced into one sendmsg */
+#define NVME_TCP_CMD_BATCH	16
+
+struct nvme_tcp_queue_stats {
+	u64			cmds;		/* command PDUs sent */
+	u64			cmd_sends;	/* sendmsg calls that sent them */
+	u64			completions;
+	u64			lat_ns;		/* sum of completion latencies */
+	u64			lat_max_ns;
+};
+
 struct nvme_tcp_ctrl;
 struct nvme_tcp_queue {
 	struct socket		*sock;
 	struct work_struct	io_work;
+	struct task_struct	*io_thread;
 	int			io_cpu;
 
 	struct mutex		queue_lock;
@@ -173,6 +202,7 @@ struct nvme_tcp_queue {
 	struct completion       tls_complete;
 	int                     tls_err;
 	struct page_frag_cache	pf_cache;
+	struct nvme_tcp_queue_stats stats;
 
 	void (*state_change)(struct sock *);
 	void (*data_ready)(struct sock *);
@@ -195,11 +225,13 @@ struct nvme_tcp_ctrl {
 	struct delayed_work	connect_work;
 	struct nvme_tcp_request async_req;
 	u32			io_queues[HCTX_MAX_TYPES];
+	struct dentry		*debugfs;
 };
 
 static LIST_HEAD(nvme_tcp_ctrl_list);
 static DEFINE_MUTEX(nvme_tcp_ctrl_mutex);
 static struct workqueue_struct *nvme_tcp_wq;
+static struct dentry *nvme_tcp_debugfs;
 static const struct blk_mq_ops nvme_tcp_mq_ops;
 static const struct blk_mq_ops nvme_tcp_admin_mq_ops;
 static int nvme_tcp_try_send(struct nvme_tcp_queue *queue);
@@ -387,6 +419,24 @@ static inline bool nvme_tcp_queue_more(struct nvme_tcp_queue *queue)
 		nvme_tcp_queue_has_pending(queue);
 }
 
+/*
+ * Hand the queue to its IO context, the io kthread or io_work.  The kthread
+ * is only stopped a grace period after it was unpublished, see
+ * nvme_tcp_stop_io_thread().
+ */
+static inline void nvme_tcp_kick_io(struct nvme_tcp_queue *queue)
+{
+	struct task_struct *io_thread;
+
+	rcu_read_lock();
+	io_thread = READ_ONCE(queue->io_thread);
+	if (io_thread)
+		wake_up_process(io_thread);
+	else
+		queue_work_on(queue->io_cpu, nvme_tcp_wq, &queue->io_work);
+	rcu_read_unlock();
+}
+
 static inline void nvme_tcp_queue_request(struct nvme_tcp_request *req,
 		bool sync, bool last)
 {
@@ -408,7 +458,7 @@ static inline void nvme_tcp_queue_request(struct nvme_tcp_request *req,
 	}
 
 	if (last && nvme_tcp_queue_has_pending(queue))
-		queue_work_on(queue->io_cpu, nvme_tcp_wq, &queue->io_work);
+		nvme_tcp_kick_io(queue);
 }
 
 static void nvme_tcp_process_req_list(struct nvme_tcp_queue *queue)
@@ -595,6 +645,18 @@ static void nvme_tcp_error_recovery(struct nvme_ctrl *ctrl)
 	queue_work(nvme_reset_wq, &to_tcp_ctrl(ctrl)->err_work);
 }
 
+static inline void nvme_tcp_account_completion(struct nvme_tcp_queue *queue,
+		struct request *rq)
+{
+	struct nvme_tcp_request *req = blk_mq_rq_to_pdu(rq);
+	u64 lat = ktime_get_ns() - req->start_ns;
+
+	queue->stats.completions++;
+	queue->stats.lat_ns += lat;
+	if (lat > queue->stats.lat_max_ns)
+		queue->stats.lat_max_ns = lat;
+}
+
 static int nvme_tcp_process_nvme_cqe(struct nvme_tcp_queue *queue,
 		struct nvme_completion *cqe)
 {
@@ -614,6 +676,7 @@ static int nvme_tcp_process_nvme_cqe(struct nvme_tcp_queue *queue,
 	if (req->status == cpu_to_le16(NVME_SC_SUCCESS))
 		req->status = cqe->status;
 
+	nvme_tcp_account_completion(queue, rq);
 	if (!nvme_try_complete_req(rq, req->status, cqe->result))
 		nvme_complete_rq(rq);
 	queue->nr_cqe++;
@@ -878,6 +941,7 @@ static int nvme_tcp_recv_data(struct nvme_tcp_queue *queue, struct sk_buff *skb,
 			queue->ddgst_remaining = NVME_TCP_DIGEST_LENGTH;
 		} else {
 			if (pdu->hdr.flags & NVME_TCP_F_DATA_SUCCESS) {
+				nvme_tcp_account_completion(queue, rq);
 				nvme_tcp_end_request(rq,
 						le16_to_cpu(req->status));
 				queue->nr_cqe++;
@@ -926,6 +990,7 @@ static int nvme_tcp_recv_ddgst(struct nvme_tcp_queue *queue,
 					pdu->command_id);
 		struct nvme_tcp_request *req = blk_mq_rq_to_pdu(rq);
 
+		nvme_tcp_account_completion(queue, rq);
 		nvme_tcp_end_request(rq, le16_to_cpu(req->status));
 		queue->nr_cqe++;
 	}
@@ -980,7 +1045,7 @@ static void nvme_tcp_data_ready(struct sock *sk)
 	queue = sk->sk_user_data;
 	if (likely(queue && queue->rd_enabled) &&
 	    !test_bit(NVME_TCP_Q_POLLING, &queue->flags))
-		queue_work_on(queue->io_cpu, nvme_tcp_wq, &queue->io_work);
+		nvme_tcp_kick_io(queue);
 	read_unlock_bh(&sk->sk_callback_lock);
 }
 
@@ -992,7 +1057,7 @@ static void nvme_tcp_write_space(struct sock *sk)
 	queue = sk->sk_user_data;
 	if (likely(queue && sk_stream_is_writeable(sk))) {
 		clear_bit(SOCK_NOSPACE, &sk->sk_socket->flags);
-		queue_work_on(queue->io_cpu, nvme_tcp_wq, &queue->io_work);
+		nvme_tcp_kick_io(queue);
 	}
 	read_unlock_bh(&sk->sk_callback_lock);
 }
@@ -1131,8 +1196,10 @@ static int nvme_tcp_try_send_cmd_pdu(struct nvme_tcp_request *req)
 	if (unlikely(ret <= 0))
 		return ret;
 
+	queue->stats.cmd_sends++;
 	len -= ret;
 	if (!len) {
+		queue->stats.cmds++;
 		if (inline_data) {
 			req->state = NVME_TCP_SEND_DATA;
 			if (queue->data_digest)
@@ -1214,6 +1281,76 @@ static int nvme_tcp_try_send_ddgst(struct nvme_tcp_request *req)
 	return -EAGAIN;
 }
 
+static inline bool nvme_tcp_cmd_batchable(struct nvme_tcp_request *req)
+{
+	return req->state == NVME_TCP_SEND_CMD_PDU && !req->offset &&
+		!nvme_tcp_has_inline_data(req);
+}
+
+/*
+ * Send the command PDU of queue->request together with those of the
+ * requests without inline data that follow it on the send_list, in a
+ * single sendmsg. Requests that were not sent at all go back to the head
+ * of the send_list and a partially sent one becomes queue->request.
+ */
+static int nvme_tcp_try_send_cmd_batch(struct nvme_tcp_queue *queue)
+{
+	struct nvme_tcp_request *reqs[NVME_TCP_CMD_BATCH], *next;
+	struct bio_vec bvecs[NVME_TCP_CMD_BATCH];
+	struct msghdr msg = { .msg_flags = MSG_DONTWAIT | MSG_SPLICE_PAGES, };
+	int len = sizeof(struct nvme_tcp_cmd_pdu) + nvme_tcp_hdgst_len(queue);
+	int i, n = 0, sent, ret;
+
+	reqs[n++] = queue->request;
+	while (n < NVME_TCP_CMD_BATCH) {
+		next = list_first_entry_or_null(&queue->send_list,
+				struct nvme_tcp_request, entry);
+		if (!next) {
+			nvme_tcp_process_req_list(queue);
+			next = list_first_entry_or_null(&queue->send_list,
+					struct nvme_tcp_request, entry);
+		}
+		if (!next || !nvme_tcp_cmd_batchable(next))
+			break;
+		list_del(&next->entry);
+		reqs[n++] = next;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct nvme_tcp_cmd_pdu *pdu = nvme_tcp_req_cmd_pdu(reqs[i]);
+
+		if (queue->hdr_digest)
+			nvme_tcp_hdgst(queue->snd_hash, pdu, sizeof(*pdu));
+		bvec_set_virt(&bvecs[i], pdu, len);
+	}
+
+	if (nvme_tcp_queue_more(queue))
+		msg.msg_flags |= MSG_MORE;
+	else
+		msg.msg_flags |= MSG_EOR;
+
+	iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, bvecs, n, n * len);
+	ret = sock_sendmsg(queue->sock, &msg);
+	sent = ret > 0 ? ret / len : 0;
+
+	/* fully sent requests may already be completing, don't touch them */
+	for (i = n - 1; i > sent; i--)
+		list_add(&reqs[i]->entry, &queue->send_list);
+	if (unlikely(ret <= 0))
+		return ret;
+
+	queue->stats.cmd_sends++;
+	queue->stats.cmds += sent;
+	if (sent < n) {
+		reqs[sent]->offset = ret - sent * len;
+		queue->request = reqs[sent];
+		return -EAGAIN;
+	}
+
+	nvme_tcp_done_send_req(queue);
+	return 1;
+}
+
 static int nvme_tcp_try_send(struct nvme_tcp_queue *queue)
 {
 	struct nvme_tcp_request *req;
@@ -1228,6 +1365,13 @@ static int nvme_tcp_try_send(struct nvme_tcp_queue *queue)
 	req = queue->request;
 
 	noreclaim_flag = memalloc_noreclaim_save();
+	if (nvme_tcp_cmd_batchable(req) && nvme_tcp_queue_more(queue)) {
+		ret = nvme_tcp_try_send_cmd_batch(queue);
+		if (ret <= 0)
+			goto done;
+		goto out;
+	}
+
 	if (req->state == NVME_TCP_SEND_CMD_PDU) {
 		ret = nvme_tcp_try_send_cmd_pdu(req);
 		if (ret <= 0)
@@ -1313,6 +1457,71 @@ static void nvme_tcp_io_work(struct work_struct *w)
 	queue_work_on(queue->io_cpu, nvme_tcp_wq, &queue->io_work);
 }
 
+static bool nvme_tcp_io_thread_has_work(struct nvme_tcp_queue *queue)
+{
+	struct sock *sk = queue->sock->sk;
+
+	if (!queue->rd_enabled)
+		return false;
+	if (!skb_queue_empty_lockless(&sk->sk_receive_queue))
+		return true;
+	/* a blocked send is resumed by ->write_space */
+	return nvme_tcp_queue_has_pending(queue) && sk_stream_is_writeable(sk);
+}
+
+static int nvme_tcp_io_thread(void *data)
+{
+	struct nvme_tcp_queue *queue = data;
+	struct sock *sk = queue->sock->sk;
+	u64 poll_start = 0;
+
+	while (!kthread_should_stop()) {
+		bool pending = false;
+		int result;
+
+		if (mutex_trylock(&queue->send_mutex)) {
+			result = nvme_tcp_try_send(queue);
+			mutex_unlock(&queue->send_mutex);
+			if (result > 0)
+				pending = true;
+		}
+
+		if (queue->rd_enabled && nvme_tcp_try_recv(queue) > 0)
+			pending = true;
+
+		if (pending) {
+			poll_start = 0;
+			cond_resched();
+			continue;
+		}
+
+		/* busy-poll the socket for a while before going to sleep */
+		if (queue->rd_enabled && io_poll_usecs) {
+			u64 now = ktime_get_ns();
+
+			if (!poll_start)
+				poll_start = now;
+			if (now - poll_start < io_poll_usecs * NSEC_PER_USEC) {
+				if (sk_can_busy_loop(sk))
+					sk_busy_loop(sk, true);
+				else
+					cpu_relax();
+				cond_resched();
+				continue;
+			}
+		}
+
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!nvme_tcp_io_thread_has_work(queue) &&
+		    !kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+		poll_start = 0;
+	}
+
+	return 0;
+}
+
 static void nvme_tcp_free_crypto(struct nvme_tcp_queue *queue)
 {
 	struct crypto_ahash *tfm = crypto_ahash_reqtfm(queue->rcv_hash);
@@ -1829,10 +2038,48 @@ static void nvme_tcp_restore_sock_ops(struct nvme_tcp_queue *queue)
 	write_unlock_bh(&sock->sk->sk_callback_lock);
 }
 
+static void nvme_tcp_start_io_thread(struct nvme_tcp_queue *queue)
+{
+	struct nvme_tcp_ctrl *ctrl = queue->ctrl;
+	int qid = nvme_tcp_queue_id(queue);
+	struct task_struct *task;
+
+	if (!io_kthread || !qid || nvme_tcp_poll_queue(queue) ||
+	    nvme_tcp_queue_tls(queue))
+		return;
+
+	task = kthread_create(nvme_tcp_io_thread, queue, "nvme%dq%d-tcp",
+			      ctrl->ctrl.instance, qid);
+	if (IS_ERR(task)) {
+		dev_warn(ctrl->ctrl.device,
+			 "queue %d: failed to create io thread, using io_work\n",
+			 qid);
+		return;
+	}
+	if (queue->io_cpu != WORK_CPU_UNBOUND)
+		kthread_bind(task, queue->io_cpu);
+	set_user_nice(task, MIN_NICE);
+	WRITE_ONCE(queue->io_thread, task);
+	wake_up_process(task);
+}
+
+static void nvme_tcp_stop_io_thread(struct nvme_tcp_queue *queue)
+{
+	struct task_struct *task = queue->io_thread;
+
+	if (!task)
+		return;
+	WRITE_ONCE(queue->io_thread, NULL);
+	/* Wait for nvme_tcp_kick_io() callers that may still wake it up */
+	synchronize_rcu();
+	kthread_stop(task);
+}
+
 static void __nvme_tcp_stop_queue(struct nvme_tcp_queue *queue)
 {
 	kernel_sock_shutdown(queue->sock, SHUT_RDWR);
 	nvme_tcp_restore_sock_ops(queue);
+	nvme_tcp_stop_io_thread(queue);
 	cancel_work_sync(&queue->io_work);
 }
 
@@ -1876,6 +2123,7 @@ static int nvme_tcp_start_queue(struct nvme_ctrl *nctrl, int idx)
 
 	queue->rd_enabled = true;
 	nvme_tcp_init_recv_ctx(queue);
+	nvme_tcp_start_io_thread(queue);
 	nvme_tcp_setup_sock_ops(queue);
 
 	if (idx)
@@ -2383,10 +2631,33 @@ static void nvme_tcp_stop_ctrl(struct nvme_ctrl *ctrl)
 	cancel_delayed_work_sync(&to_tcp_ctrl(ctrl)->connect_work);
 }
 
+static int nvme_tcp_stats_show(struct seq_file *m, void *unused)
+{
+	struct nvme_tcp_ctrl *ctrl = m->private;
+	int i;
+
+	seq_puts(m, "qid cmds cmd_sends completions lat_avg_ns lat_max_ns\n");
+	for (i = 0; i < ctrl->ctrl.queue_count; i++) {
+		struct nvme_tcp_queue_stats *stats = &ctrl->queues[i].stats;
+		u64 completions = READ_ONCE(stats->completions);
+		u64 lat_ns = READ_ONCE(stats->lat_ns);
+
+		seq_printf(m, "%d %llu %llu %llu %llu %llu\n", i,
+			   READ_ONCE(stats->cmds), READ_ONCE(stats->cmd_sends),
+			   completions,
+			   completions ? div64_u64(lat_ns, completions) : 0,
+			   READ_ONCE(stats->lat_max_ns));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(nvme_tcp_stats);
+
 static void nvme_tcp_free_ctrl(struct nvme_ctrl *nctrl)
 {
 	struct nvme_tcp_ctrl *ctrl = to_tcp_ctrl(nctrl);
 
+	debugfs_remove(ctrl->debugfs);
+
 	if (list_empty(&ctrl->list))
 		goto free_ctrl;
 
@@ -2586,7 +2857,7 @@ static void nvme_tcp_commit_rqs(struct blk_mq_hw_ctx *hctx)
 	struct nvme_tcp_queue *queue = hctx->driver_data;
 
 	if (!llist_empty(&queue->req_list))
-		queue_work_on(queue->io_cpu, nvme_tcp_wq, &queue->io_work);
+		nvme_tcp_kick_io(queue);
 }
 
 static blk_status_t nvme_tcp_queue_rq(struct blk_mq_hw_ctx *hctx,
@@ -2607,6 +2878,7 @@ static blk_status_t nvme_tcp_queue_rq(struct blk_mq_hw_ctx *hctx,
 		return ret;
 
 	nvme_start_request(rq);
+	req->start_ns = ktime_get_ns();
 
 	nvme_tcp_queue_request(req, true, bd->last);
 
@@ -2812,6 +3084,9 @@ static struct nvme_ctrl *nvme_tcp_create_ctrl(struct device *dev,
 	if (ret)
 		goto out_put_ctrl;
 
+	ctrl->debugfs = debugfs_create_file(dev_name(ctrl->ctrl.device), 0400,
+			nvme_tcp_debugfs, ctrl, &nvme_tcp_stats_fops);
+
 	if (!nvme_change_ctrl_state(&ctrl->ctrl, NVME_CTRL_CONNECTING)) {
 		WARN_ON_ONCE(1);
 		ret = -EINTR;
@@ -2873,6 +3148,7 @@ static int __init nvme_tcp_init_module(void)
 	if (!nvme_tcp_wq)
 		return -ENOMEM;
 
+	nvme_tcp_debugfs = debugfs_create_dir("nvme_tcp", NULL);
 	nvmf_register_transport(&nvme_tcp_transport);
 	return 0;
 }
@@ -2889,6 +3165,7 @@ static void __exit nvme_tcp_cleanup_module(void)
 	mutex_unlock(&nvme_tcp_ctrl_mutex);
 	flush_workqueue(nvme_delete_wq);
 
+	debugfs_remove_recursive(nvme_tcp_debugfs);
 	destroy_workqueue(nvme_tcp_wq);
 }
 
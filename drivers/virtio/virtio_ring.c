@@ -70,6 +70,7 @@
 struct vring_desc_state_split {
 	void *data;			/* Data for callback. */
 	struct vring_desc *indir_desc;	/* Indirect descriptor, if any. */
+	u32 total_in_len;		/* Device writable length, for in order. */
 };
 
 struct vring_desc_state_packed {
@@ -99,6 +100,17 @@ struct vring_virtqueue_split {
 	 */
 	u16 avail_idx_shadow;
 
+	/*
+	 * VIRTIO_F_IN_ORDER: head of the oldest buffer not yet returned, and
+	 * the last used entry read, whose id may be several buffers ahead.
+	 * batch_last.id is UINT_MAX when no used entry is pending.
+	 */
+	u16 in_order_head;
+	struct {
+		u32 id;
+		u32 len;
+	} batch_last;
+
 	/* Per-descriptor state. */
 	struct vring_desc_state_split *desc_state;
 	struct vring_desc_extra *desc_extra;
@@ -172,6 +184,9 @@ struct vring_virtqueue {
 	/* Host publishes avail event idx */
 	bool event;
 
+	/* Device uses buffers in the order they were made available */
+	bool in_order;
+
 	/* Do DMA mapping by driver */
 	bool premapped;
 
@@ -554,6 +569,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 	struct scatterlist *sg;
 	struct vring_desc *desc;
 	unsigned int i, n, avail, descs_used, prev, err_idx;
+	u32 total_in_len = 0;
 	int head;
 	bool indirect;
 
@@ -630,6 +646,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 			if (vring_map_one_sg(vq, sg, DMA_FROM_DEVICE, &addr))
 				goto unmap_release;
 
+			total_in_len += sg->length;
 			prev = i;
 			/* Note that we trust indirect descriptor
 			 * table since it use stream DMA mapping.
@@ -677,6 +694,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 
 	/* Store token and indirect buffer state. */
 	vq->split.desc_state[head].data = data;
+	vq->split.desc_state[head].total_in_len = total_in_len;
 	if (indirect)
 		vq->split.desc_state[head].indir_desc = desc;
 	else
@@ -762,9 +780,15 @@ static bool virtqueue_kick_prepare_split(struct virtqueue *_vq)
 	return needs_kick;
 }
 
-static void detach_buf_split(struct vring_virtqueue *vq, unsigned int head,
-			     void **ctx)
+/*
+ * Returns the last descriptor of the chain. With VIRTIO_F_IN_ORDER chains are
+ * taken in ring order and come back in the same order, so the chain is not put
+ * back on the free list: it is already linked in front of vq->free_head.
+ */
+static unsigned int detach_buf_split(struct vring_virtqueue *vq,
+				     unsigned int head, void **ctx)
 {
+	unsigned int tail;
 	unsigned int i, j;
 	__virtio16 nextflag = cpu_to_virtio16(vq->vq.vdev, VRING_DESC_F_NEXT);
 
@@ -781,8 +805,11 @@ static void detach_buf_split(struct vring_virtqueue *vq, unsigned int head,
 	}
 
 	vring_unmap_one_split(vq, i);
-	vq->split.desc_extra[i].next = vq->free_head;
-	vq->free_head = head;
+	if (!vq->in_order) {
+		vq->split.desc_extra[i].next = vq->free_head;
+		vq->free_head = head;
+	}
+	tail = i;
 
 	/* Plus final descriptor */
 	vq->vq.num_free++;
@@ -794,7 +821,7 @@ static void detach_buf_split(struct vring_virtqueue *vq, unsigned int head,
 
 		/* Free the indirect table, if any, now that it's unmapped. */
 		if (!indir_desc)
-			return;
+			return tail;
 
 		len = vq->split.desc_extra[head].len;
 
@@ -812,14 +839,90 @@ static void detach_buf_split(struct vring_virtqueue *vq, unsigned int head,
 	} else if (ctx) {
 		*ctx = vq->split.desc_state[head].indir_desc;
 	}
+	return tail;
 }
 
 static bool more_used_split(const struct vring_virtqueue *vq)
 {
-	return vq->last_used_idx != virtio16_to_cpu(vq->vq.vdev,
+	return vq->split.batch_last.id != UINT_MAX ||
+	       vq->last_used_idx != virtio16_to_cpu(vq->vq.vdev,
 			vq->split.vring.used->idx);
 }
 
+/*
+ * With VIRTIO_F_IN_ORDER the device may write one used entry for a batch of
+ * buffers, naming the last one. Buffers are returned one by one from the
+ * oldest, without touching the used ring until the batch is drained. The
+ * ones the device did not name report their whole device writable length.
+ */
+static void *virtqueue_get_buf_ctx_split_in_order(struct virtqueue *_vq,
+						  unsigned int *len,
+						  void **ctx)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	unsigned int i, tail;
+	u16 last_used;
+	void *ret;
+
+	START_USE(vq);
+
+	if (unlikely(vq->broken)) {
+		END_USE(vq);
+		return NULL;
+	}
+
+	if (vq->split.batch_last.id == UINT_MAX) {
+		if (!more_used_split(vq)) {
+			pr_debug("No more buffers in queue\n");
+			END_USE(vq);
+			return NULL;
+		}
+
+		/* Only get used array entries after they have been exposed by host. */
+		virtio_rmb(vq->weak_barriers);
+
+		last_used = (vq->last_used_idx & (vq->split.vring.num - 1));
+		vq->split.batch_last.id = virtio32_to_cpu(_vq->vdev,
+				vq->split.vring.used->ring[last_used].id);
+		vq->split.batch_last.len = virtio32_to_cpu(_vq->vdev,
+				vq->split.vring.used->ring[last_used].len);
+		vq->last_used_idx++;
+
+		/* As in virtqueue_get_buf_ctx_split() */
+		if (!(vq->split.avail_flags_shadow & VRING_AVAIL_F_NO_INTERRUPT))
+			virtio_store_mb(vq->weak_barriers,
+					&vring_used_event(&vq->split.vring),
+					cpu_to_virtio16(_vq->vdev, vq->last_used_idx));
+	}
+
+	i = vq->split.in_order_head;
+	if (unlikely(vq->split.batch_last.id >= vq->split.vring.num)) {
+		BAD_RING(vq, "id %u out of range\n", vq->split.batch_last.id);
+		return NULL;
+	}
+	if (unlikely(!vq->split.desc_state[i].data)) {
+		BAD_RING(vq, "id %u is not a head!\n", i);
+		return NULL;
+	}
+
+	if (i == vq->split.batch_last.id) {
+		*len = vq->split.batch_last.len;
+		vq->split.batch_last.id = UINT_MAX;
+	} else {
+		*len = vq->split.desc_state[i].total_in_len;
+	}
+
+	/* detach_buf_split clears data, so grab it now. */
+	ret = vq->split.desc_state[i].data;
+	tail = detach_buf_split(vq, i, ctx);
+	vq->split.in_order_head = vq->split.desc_extra[tail].next;
+
+	LAST_ADD_TIME_INVALID(vq);
+
+	END_USE(vq);
+	return ret;
+}
+
 static void *virtqueue_get_buf_ctx_split(struct virtqueue *_vq,
 					 unsigned int *len,
 					 void **ctx)
@@ -829,6 +932,9 @@ static void *virtqueue_get_buf_ctx_split(struct virtqueue *_vq,
 	unsigned int i;
 	u16 last_used;
 
+	if (vq->in_order)
+		return virtqueue_get_buf_ctx_split_in_order(_vq, len, ctx);
+
 	START_USE(vq);
 
 	if (unlikely(vq->broken)) {
@@ -931,6 +1037,10 @@ static bool virtqueue_poll_split(struct virtqueue *_vq, unsigned int last_used_i
 {
 	struct vring_virtqueue *vq = to_vvq(_vq);
 
+	/* the rest of an in order batch is not in used->idx any more */
+	if (vq->split.batch_last.id != UINT_MAX)
+		return true;
+
 	return (u16)last_used_idx != virtio16_to_cpu(_vq->vdev,
 			vq->split.vring.used->idx);
 }
@@ -961,7 +1071,8 @@ static bool virtqueue_enable_cb_delayed_split(struct virtqueue *_vq)
 			&vring_used_event(&vq->split.vring),
 			cpu_to_virtio16(_vq->vdev, vq->last_used_idx + bufs));
 
-	if (unlikely((u16)(virtio16_to_cpu(_vq->vdev, vq->split.vring.used->idx)
+	if (unlikely(vq->split.batch_last.id != UINT_MAX ||
+		     (u16)(virtio16_to_cpu(_vq->vdev, vq->split.vring.used->idx)
 					- vq->last_used_idx) > bufs)) {
 		END_USE(vq);
 		return false;
@@ -1038,6 +1149,12 @@ static void virtqueue_reinit_split(struct vring_virtqueue *vq)
 	virtqueue_init(vq, num);
 
 	virtqueue_vring_init_split(&vq->split, vq);
+
+	/* In order descriptors start over from the beginning of the ring. */
+	if (vq->in_order)
+		vq->free_head = 0;
+	vq->split.in_order_head = 0;
+	vq->split.batch_last.id = UINT_MAX;
 }
 
 static void virtqueue_vring_attach_split(struct vring_virtqueue *vq,
@@ -1047,6 +1164,8 @@ static void virtqueue_vring_attach_split(struct vring_virtqueue *vq,
 
 	/* Put everything in free lists. */
 	vq->free_head = 0;
+	vq->split.in_order_head = 0;
+	vq->split.batch_last.id = UINT_MAX;
 }
 
 static int vring_alloc_state_extra_split(struct vring_virtqueue_split *vring_split)
@@ -2096,6 +2215,7 @@ static struct virtqueue *vring_create_virtqueue_packed(
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
 		!context;
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->in_order = false;
 
 	if (virtio_has_feature(vdev, VIRTIO_F_ORDER_PLATFORM))
 		vq->weak_barriers = false;
@@ -2641,6 +2761,7 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
 		!context;
 	vq->event = virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+	vq->in_order = virtio_has_feature(vdev, VIRTIO_F_IN_ORDER);
 
 	if (virtio_has_feature(vdev, VIRTIO_F_ORDER_PLATFORM))
 		vq->weak_barriers = false;
@@ -2960,11 +3081,17 @@ void vring_transport_features(struct virtio_device *vdev)
 			break;
 		case VIRTIO_F_NOTIFICATION_DATA:
 			break;
+		case VIRTIO_F_IN_ORDER:
+			break;
 		default:
 			/* We don't understand this bit. */
 			__virtio_clear_bit(vdev, i);
 		}
 	}
+
+	/* Only the split ring has an in order mode. */
+	if (__virtio_test_bit(vdev, VIRTIO_F_RING_PACKED))
+		__virtio_clear_bit(vdev, VIRTIO_F_IN_ORDER);
 }
 EXPORT_SYMBOL_GPL(vring_transport_features);
 
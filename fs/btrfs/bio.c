@@ -264,6 +264,109 @@ static struct btrfs_failed_bio *repair_one_sector(struct btrfs_bio *failed_bbio,
 	return fbio;
 }
 
+/* Reads of at least this many sectors get their checksums verified in parallel */
+#define BTRFS_CSUM_PARALLEL_SECTORS	128
+#define BTRFS_CSUM_MAX_WORKERS		8
+
+struct btrfs_csum_work {
+	struct work_struct work;
+	struct btrfs_bio *bbio;
+	struct bvec_iter iter;
+	u32 first_sector;
+	u32 nr_sectors;
+	unsigned long *bad;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+static void btrfs_csum_verify_range(struct btrfs_csum_work *cw)
+{
+	struct btrfs_fs_info *fs_info = cw->bbio->fs_info;
+	u32 sectorsize = fs_info->sectorsize;
+	u8 csum[BTRFS_CSUM_SIZE];
+	u32 sector;
+
+	for (sector = cw->first_sector;
+	     sector < cw->first_sector + cw->nr_sectors; sector++) {
+		struct bio_vec bv = bio_iter_iovec(&cw->bbio->bio, cw->iter);
+
+		if (btrfs_check_sector_csum(fs_info, bv.bv_page, bv.bv_offset,
+					    csum, cw->bbio->csum +
+					    sector * fs_info->csum_size))
+			set_bit(sector, cw->bad);
+		bio_advance_iter_single(&cw->bbio->bio, &cw->iter, sectorsize);
+	}
+}
+
+static void btrfs_csum_work_fn(struct work_struct *work)
+{
+	struct btrfs_csum_work *cw = container_of(work, struct btrfs_csum_work,
+						  work);
+
+	btrfs_csum_verify_range(cw);
+	if (atomic_dec_and_test(cw->pending))
+		complete(cw->done);
+}
+
+/*
+ * Verify the checksums of a large read on several CPUs.
+ *
+ * Return a bitmap of the sectors that failed verification, to be handled
+ * (reported, zeroed and repaired) one by one by the caller, or NULL if the
+ * read is too small to be worth it or there is no memory for the bitmap.
+ */
+static unsigned long *btrfs_csum_verify_parallel(struct btrfs_bio *bbio)
+{
+	struct btrfs_fs_info *fs_info = bbio->fs_info;
+	u32 nr_sectors = bbio->saved_iter.bi_size >> fs_info->sectorsize_bits;
+	struct btrfs_csum_work works[BTRFS_CSUM_MAX_WORKERS];
+	struct bvec_iter iter = bbio->saved_iter;
+	DECLARE_COMPLETION_ONSTACK(done);
+	unsigned int nr_works, i;
+	unsigned long *bad;
+	atomic_t pending;
+	u32 chunk, sector = 0;
+
+	if (nr_sectors < BTRFS_CSUM_PARALLEL_SECTORS)
+		return NULL;
+	nr_works = min_t(unsigned int, num_online_cpus(), BTRFS_CSUM_MAX_WORKERS);
+	if (nr_works < 2)
+		return NULL;
+	bad = bitmap_zalloc(nr_sectors, GFP_NOFS);
+	if (!bad)
+		return NULL;
+
+	chunk = DIV_ROUND_UP(nr_sectors, nr_works);
+	atomic_set(&pending, nr_works - 1);
+	for (i = 0; i < nr_works; i++) {
+		struct btrfs_csum_work *cw = &works[i];
+
+		cw->bbio = bbio;
+		cw->iter = iter;
+		cw->first_sector = sector;
+		cw->nr_sectors = min(chunk, nr_sectors - sector);
+		cw->bad = bad;
+		cw->pending = &pending;
+		cw->done = &done;
+		bio_advance_iter(&bbio->bio, &iter,
+				 cw->nr_sectors << fs_info->sectorsize_bits);
+		sector += cw->nr_sectors;
+
+		/* The last chunk is ours */
+		if (i < nr_works - 1) {
+			INIT_WORK_ONSTACK(&cw->work, btrfs_csum_work_fn);
+			queue_work(fs_info->csum_workers, &cw->work);
+		}
+	}
+
+	btrfs_csum_verify_range(&works[nr_works - 1]);
+	wait_for_completion(&done);
+	for (i = 0; i < nr_works - 1; i++)
+		destroy_work_on_stack(&works[i].work);
+
+	return bad;
+}
+
 static void btrfs_check_read_bio(struct btrfs_bio *bbio, struct btrfs_device *dev)
 {
 	struct btrfs_inode *inode = bbio->inode;
@@ -272,6 +375,7 @@ static void btrfs_check_read_bio(struct btrfs_bio *bbio, struct btrfs_device *de
 	struct bvec_iter *iter = &bbio->saved_iter;
 	blk_status_t status = bbio->bio.bi_status;
 	struct btrfs_failed_bio *fbio = NULL;
+	unsigned long *bad = NULL;
 	u32 offset = 0;
 
 	/* Read-repair requires the inode field to be set by the submitter. */
@@ -289,16 +393,27 @@ static void btrfs_check_read_bio(struct btrfs_bio *bbio, struct btrfs_device *de
 	/* Clear the I/O error. A failed repair will reset it. */
 	bbio->bio.bi_status = BLK_STS_OK;
 
+	/*
+	 * The data reloc inode has ranges without checksums that only the
+	 * sector by sector check below knows about.
+	 */
+	if (!status && bbio->csum && !btrfs_is_data_reloc_root(inode->root))
+		bad = btrfs_csum_verify_parallel(bbio);
+
 	while (iter->bi_size) {
 		struct bio_vec bv = bio_iter_iovec(&bbio->bio, *iter);
 
 		bv.bv_len = min(bv.bv_len, sectorsize);
-		if (status || !btrfs_data_csum_ok(bbio, dev, offset, &bv))
+		/* Sectors that passed the parallel check need no second look */
+		if (status ||
+		    ((!bad || test_bit(offset >> fs_info->sectorsize_bits, bad)) &&
+		     !btrfs_data_csum_ok(bbio, dev, offset, &bv)))
 			fbio = repair_one_sector(bbio, offset, &bv, fbio);
 
 		bio_advance_iter_single(&bbio->bio, iter, sectorsize);
 		offset += sectorsize;
 	}
+	bitmap_free(bad);
 
 	if (bbio->csum != bbio->csum_inline)
 		kfree(bbio->csum);
@@ -2233,6 +2233,85 @@ int btrfs_run_delayed_refs(struct btrfs_trans_handle *trans, u64 min_bytes)
 	return 0;
 }
 
+/* Ready heads each helper of btrfs_run_delayed_refs_parallel() is worth */
+#define BTRFS_DELAYED_REFS_PER_WORKER	1024
+#define BTRFS_DELAYED_REFS_MAX_WORKERS	8
+
+struct btrfs_delayed_refs_work {
+	struct btrfs_work work;
+	struct btrfs_fs_info *fs_info;
+	struct btrfs_transaction *transaction;
+	atomic_t *pending;
+	struct completion *done;
+};
+
+static void btrfs_delayed_refs_work_fn(struct btrfs_work *work)
+{
+	struct btrfs_delayed_refs_work *drw;
+	struct btrfs_trans_handle *trans;
+
+	drw = container_of(work, struct btrfs_delayed_refs_work, work);
+	/* Errors abort the transaction, which the committer will notice */
+	trans = btrfs_join_transaction_nostart(drw->fs_info->tree_root);
+	if (!IS_ERR(trans)) {
+		if (trans->transaction == drw->transaction)
+			btrfs_run_delayed_refs(trans, 0);
+		btrfs_end_transaction(trans);
+	}
+	if (atomic_dec_and_test(drw->pending))
+		complete(drw->done);
+}
+
+/*
+ * Run the delayed refs queued so far with the help of the fs workers.
+ *
+ * Used by the transaction commit for its first pass over the delayed refs,
+ * while the transaction is still running and others may join it. Each helper
+ * joins the transaction and runs delayed refs like the space flushing code
+ * does, btrfs_obtain_ref_head() hands every one of them a different head.
+ */
+int btrfs_run_delayed_refs_parallel(struct btrfs_trans_handle *trans)
+{
+	struct btrfs_fs_info *fs_info = trans->fs_info;
+	struct btrfs_delayed_ref_root *delayed_refs;
+	struct btrfs_delayed_refs_work *works;
+	DECLARE_COMPLETION_ONSTACK(done);
+	unsigned int nr_works, i;
+	atomic_t pending;
+	int ret;
+
+	delayed_refs = &trans->transaction->delayed_refs;
+	nr_works = READ_ONCE(delayed_refs->num_heads_ready) /
+		   BTRFS_DELAYED_REFS_PER_WORKER;
+	nr_works = min3(nr_works, num_online_cpus() - 1,
+			min_t(unsigned int, fs_info->thread_pool_size,
+			      BTRFS_DELAYED_REFS_MAX_WORKERS));
+	if (!nr_works)
+		return btrfs_run_delayed_refs(trans, 0);
+
+	works = kcalloc(nr_works, sizeof(*works), GFP_NOFS);
+	if (!works)
+		return btrfs_run_delayed_refs(trans, 0);
+
+	atomic_set(&pending, nr_works);
+	for (i = 0; i < nr_works; i++) {
+		works[i].fs_info = fs_info;
+		works[i].transaction = trans->transaction;
+		works[i].pending = &pending;
+		works[i].done = &done;
+		btrfs_init_work(&works[i].work, btrfs_delayed_refs_work_fn, NULL);
+		btrfs_queue_work(fs_info->workers, &works[i].work);
+	}
+
+	ret = btrfs_run_delayed_refs(trans, 0);
+	wait_for_completion(&done);
+	kfree(works);
+
+	if (!ret && TRANS_ABORTED(trans->transaction))
+		ret = trans->transaction->aborted;
+	return ret;
+}
+
 int btrfs_set_disk_extent_flags(struct btrfs_trans_handle *trans,
 				struct extent_buffer *eb, u64 flags)
 {
@@ -2185,8 +2185,13 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans)
 	trans->block_rsv = NULL;
 
 	/*
-	 * We only want one transaction commit doing the flushing so we do not
-	 * waste a bunch of time on lock contention on the extent root node.
+	 * We only want one transaction commit doing the flushing, so that
+	 * concurrent committers don't each start a pass over the same heads.
+	 * The pass itself is spread over several runners.  They contend on
+	 * the extent tree locks, as the space flushers already do when they
+	 * run delayed refs during a commit, so
+	 * btrfs_run_delayed_refs_parallel() only adds a runner per thousand
+	 * or so ready heads.
 	 */
 	if (!test_and_set_bit(BTRFS_DELAYED_REFS_FLUSHING,
 			      &cur_trans->delayed_refs.flags)) {
@@ -2194,7 +2199,7 @@ int btrfs_commit_transaction(struct btrfs_trans_handle *trans)
 		 * Make a pass through all the delayed refs we have so far.
 		 * Any running threads may add more while we are here.
 		 */
-		ret = btrfs_run_delayed_refs(trans, 0);
+		ret = btrfs_run_delayed_refs_parallel(trans);
 		if (ret)
 			goto lockdep_trans_commit_start_release;
 	}
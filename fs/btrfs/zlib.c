@@ -18,6 +18,9 @@
 #include <linux/pagemap.h>
 #include <linux/bio.h>
 #include <linux/refcount.h>
+#include <linux/scatterlist.h>
+#include <linux/unaligned.h>
+#include <crypto/acompress.h>
 #include "btrfs_inode.h"
 #include "compression.h"
 #include "fs.h"
@@ -26,12 +29,24 @@
 /* workspace buffer size for s390 zlib hardware support */
 #define ZLIB_DFLTCC_BUF_SIZE    (4 * PAGE_SIZE)
 
+/* Pages of an extent compressed by a deflate accelerator */
+#define ZLIB_ACOMP_MAX_PAGES	(BTRFS_MAX_UNCOMPRESSED >> PAGE_SHIFT)
+/* zlib stream header (deflate, 32K window) and adler32 trailer */
+#define ZLIB_HEADER_SIZE	2
+#define ZLIB_TRAILER_SIZE	4
+
 struct workspace {
 	z_stream strm;
 	char *buf;
 	unsigned int buf_size;
 	struct list_head list;
 	int level;
+	/* Raw deflate offloaded to a compression accelerator, if any */
+	struct crypto_acomp *acomp;
+	struct acomp_req *req;
+	struct scatterlist *sg_in;
+	struct scatterlist *sg_out;
+	struct folio **in_folios;
 };
 
 static struct workspace_manager wsm;
@@ -50,11 +65,61 @@ void zlib_free_workspace(struct list_head *ws)
 {
 	struct workspace *workspace = list_entry(ws, struct workspace, list);
 
+	if (workspace->req)
+		acomp_request_free(workspace->req);
+	if (workspace->acomp)
+		crypto_free_acomp(workspace->acomp);
+	kfree(workspace->sg_in);
+	kfree(workspace->sg_out);
+	kfree(workspace->in_folios);
 	kvfree(workspace->strm.workspace);
 	kfree(workspace->buf);
 	kfree(workspace);
 }
 
+/*
+ * Use the acomp API for compression only if the best "deflate" is provided
+ * by an accelerator, the software ones are slower than the zlib code.
+ */
+static void zlib_alloc_acomp(struct workspace *workspace)
+{
+	static bool no_deflate;
+	struct crypto_acomp *tfm;
+	const char *driver;
+
+	if (READ_ONCE(no_deflate))
+		return;
+
+	tfm = crypto_alloc_acomp("deflate", 0, 0);
+	if (IS_ERR(tfm)) {
+		/* Don't go looking for a module again on each allocation */
+		if (PTR_ERR(tfm) == -ENOENT)
+			WRITE_ONCE(no_deflate, true);
+		return;
+	}
+	driver = crypto_tfm_alg_driver_name(crypto_acomp_tfm(tfm));
+	if (!strcmp(driver, "deflate-generic") || !strcmp(driver, "deflate-scomp"))
+		goto fail;
+
+	workspace->req = acomp_request_alloc(tfm);
+	workspace->sg_in = kcalloc(ZLIB_ACOMP_MAX_PAGES, sizeof(struct scatterlist),
+				   GFP_KERNEL);
+	workspace->sg_out = kcalloc(ZLIB_ACOMP_MAX_PAGES, sizeof(struct scatterlist),
+				    GFP_KERNEL);
+	workspace->in_folios = kcalloc(ZLIB_ACOMP_MAX_PAGES, sizeof(struct folio *),
+				       GFP_KERNEL);
+	if (!workspace->req || !workspace->sg_in || !workspace->sg_out ||
+	    !workspace->in_folios)
+		goto fail;
+	workspace->acomp = tfm;
+	return;
+fail:
+	if (workspace->req)
+		acomp_request_free(workspace->req);
+	workspace->req = NULL;
+	crypto_free_acomp(tfm);
+}
+
 struct list_head *zlib_alloc_workspace(unsigned int level)
 {
 	struct workspace *workspace;
@@ -86,6 +151,7 @@ struct list_head *zlib_alloc_workspace(unsigned int level)
 	if (!workspace->strm.workspace || !workspace->buf)
 		goto fail;
 
+	zlib_alloc_acomp(workspace);
 	INIT_LIST_HEAD(&workspace->list);
 
 	return &workspace->list;
@@ -94,6 +160,137 @@ struct list_head *zlib_alloc_workspace(unsigned int level)
 	return ERR_PTR(-ENOMEM);
 }
 
+/*
+ * Compress through the acomp API, wrapping the raw deflate output of the
+ * accelerator in the zlib stream header and adler32 trailer, same on-disk
+ * format as zlib_deflate() produces.
+ *
+ * Accelerators compress at a fixed level of their own, so they are only
+ * used up to the default level.  Higher levels ask for a better ratio than
+ * they give and use the zlib code.
+ *
+ * Returns -EOPNOTSUPP when the zlib code has to be used instead.
+ */
+static int zlib_compress_folios_acomp(struct workspace *workspace,
+				      struct address_space *mapping, u64 start,
+				      struct folio **folios,
+				      unsigned long *out_folios,
+				      unsigned long *total_in,
+				      unsigned long *total_out)
+{
+	const unsigned long len = *total_out;
+	const unsigned int nr_in = DIV_ROUND_UP(len, PAGE_SIZE);
+	unsigned int nr_out, nr_used, i, got = 0, alloced = 0;
+	struct acomp_req *req = workspace->req;
+	DECLARE_CRYPTO_WAIT(wait);
+	unsigned long out_len;
+	u32 adler = 1;
+	u8 trailer[ZLIB_TRAILER_SIZE];
+	u8 *kaddr;
+	int ret;
+
+	if (workspace->level > BTRFS_ZLIB_DEFAULT_LEVEL ||
+	    btrfs_is_subpage(inode_to_fs_info(mapping->host), mapping) ||
+	    !IS_ALIGNED(start, PAGE_SIZE) || nr_in > ZLIB_ACOMP_MAX_PAGES)
+		return -EOPNOTSUPP;
+
+	sg_init_table(workspace->sg_in, nr_in);
+	for (i = 0; i < nr_in; i++) {
+		struct folio *folio;
+		unsigned int cur_len = min_t(unsigned long, PAGE_SIZE,
+					     len - i * PAGE_SIZE);
+
+		ret = btrfs_compress_filemap_get_folio(mapping,
+						       start + i * PAGE_SIZE,
+						       &folio);
+		if (ret < 0)
+			goto out;
+		workspace->in_folios[got++] = folio;
+		if (folio_test_large(folio)) {
+			ret = -EOPNOTSUPP;
+			goto out;
+		}
+		kaddr = kmap_local_folio(folio, 0);
+		adler = zlib_adler32(adler, kaddr, cur_len);
+		kunmap_local(kaddr);
+		sg_set_page(&workspace->sg_in[i], folio_page(folio, 0), cur_len, 0);
+	}
+
+	/* It must come out smaller than it went in to be worth it */
+	nr_out = min_t(unsigned long, *out_folios, nr_in);
+	sg_init_table(workspace->sg_out, nr_out);
+	for (i = 0; i < nr_out; i++) {
+		folios[i] = btrfs_alloc_compr_folio();
+		if (!folios[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		alloced++;
+		if (i == 0)
+			sg_set_page(&workspace->sg_out[i], folio_page(folios[i], 0),
+				    PAGE_SIZE - ZLIB_HEADER_SIZE, ZLIB_HEADER_SIZE);
+		else
+			sg_set_page(&workspace->sg_out[i], folio_page(folios[i], 0),
+				    PAGE_SIZE, 0);
+	}
+
+	acomp_request_set_params(req, workspace->sg_in, workspace->sg_out, len,
+				 nr_out * PAGE_SIZE - ZLIB_HEADER_SIZE -
+				 ZLIB_TRAILER_SIZE);
+	acomp_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   crypto_req_done, &wait);
+	ret = crypto_wait_req(crypto_acomp_compress(req), &wait);
+	if (ret == -ENOSPC || ret == -EOVERFLOW) {
+		/* Didn't fit in fewer pages than the input, zlib won't do it either */
+		ret = -E2BIG;
+		goto out;
+	} else if (ret) {
+		/* The accelerator failed us, let zlib have a go */
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	out_len = ZLIB_HEADER_SIZE + req->dlen + ZLIB_TRAILER_SIZE;
+	if (out_len >= len) {
+		ret = -E2BIG;
+		goto out;
+	}
+
+	/* FLEVEL is informational, 0x01 is the fastest, 0x5e the levels 2 to 5 */
+	kaddr = folio_address(folios[0]);
+	kaddr[0] = 0x78;
+	kaddr[1] = workspace->level < 2 ? 0x01 : 0x5e;
+	put_unaligned_be32(adler, trailer);
+	for (i = 0; i < ZLIB_TRAILER_SIZE; i++) {
+		unsigned long off = ZLIB_HEADER_SIZE + req->dlen + i;
+
+		kaddr = folio_address(folios[off >> PAGE_SHIFT]);
+		kaddr[offset_in_page(off)] = trailer[i];
+	}
+
+	nr_used = DIV_ROUND_UP(out_len, PAGE_SIZE);
+	for (i = nr_used; i < alloced; i++) {
+		btrfs_free_compr_folio(folios[i]);
+		folios[i] = NULL;
+	}
+	alloced = nr_used;
+	*total_in = len;
+	*total_out = out_len;
+	ret = 0;
+out:
+	if (ret) {
+		for (i = 0; i < alloced; i++) {
+			btrfs_free_compr_folio(folios[i]);
+			folios[i] = NULL;
+		}
+		alloced = 0;
+	}
+	*out_folios = alloced;
+	for (i = 0; i < got; i++)
+		folio_put(workspace->in_folios[i]);
+	return ret;
+}
+
 int zlib_compress_folios(struct list_head *ws, struct address_space *mapping,
 			 u64 start, struct folio **folios, unsigned long *out_folios,
 			 unsigned long *total_in, unsigned long *total_out)
@@ -112,6 +309,13 @@ int zlib_compress_folios(struct list_head *ws, struct address_space *mapping,
 	const unsigned long max_out = nr_dest_folios * PAGE_SIZE;
 	const u64 orig_end = start + len;
 
+	if (workspace->acomp) {
+		ret = zlib_compress_folios_acomp(workspace, mapping, start, folios,
+						 out_folios, total_in, total_out);
+		if (ret != -EOPNOTSUPP)
+			return ret;
+	}
+
 	*out_folios = 0;
 	*total_out = 0;
 	*total_in = 0;
@@ -59,6 +59,17 @@ static void erofs_fileio_rq_submit(struct erofs_fileio_rq *rq)
 	iov_iter_bvec(&iter, ITER_DEST, rq->bvecs, rq->bio.bi_vcnt,
 		      rq->bio.bi_iter.bi_size);
 	ret = vfs_iocb_iter_read(rq->iocb.ki_filp, &rq->iocb, &iter);
+	/*
+	 * Tail extents and sub-page blocks may not meet the DIO alignment of
+	 * the backing file, which is then reported before any I/O is issued.
+	 * Read those few through the page cache rather than failing them.
+	 */
+	if (ret == -EINVAL && (rq->iocb.ki_flags & IOCB_DIRECT)) {
+		rq->iocb.ki_flags &= ~IOCB_DIRECT;
+		iov_iter_bvec(&iter, ITER_DEST, rq->bvecs, rq->bio.bi_vcnt,
+			      rq->bio.bi_iter.bi_size);
+		ret = vfs_iocb_iter_read(rq->iocb.ki_filp, &rq->iocb, &iter);
+	}
 	if (ret != -EIOCBQUEUED)
 		erofs_fileio_ki_complete(&rq->iocb, ret);
 }
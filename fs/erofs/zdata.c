@@ -1314,6 +1314,88 @@ static int z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 	return err;
 }
 
+static void z_erofs_decompressqueue_work(struct work_struct *work);
+
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+static void z_erofs_decompressqueue_kthread_work(struct kthread_work *work)
+{
+	z_erofs_decompressqueue_work((struct work_struct *)work);
+}
+#endif
+
+/* hand a background queue over to the worker of @cpu, or the workqueue */
+static void z_erofs_queue_bg(struct z_erofs_decompressqueue *io, int cpu)
+{
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+	struct kthread_worker *worker;
+
+	rcu_read_lock();
+	worker = rcu_dereference(z_erofs_pcpu_workers[cpu]);
+	if (!worker) {
+		INIT_WORK(&io->u.work, z_erofs_decompressqueue_work);
+		queue_work(z_erofs_workqueue, &io->u.work);
+	} else {
+		kthread_queue_work(worker, &io->u.kthread_work);
+	}
+	rcu_read_unlock();
+#else
+	queue_work(z_erofs_workqueue, &io->u.work);
+#endif
+}
+
+/*
+ * Once I/O is done, pclusters of a queue decompress independently of each
+ * other.  Rather than having one worker go through a long readahead chain,
+ * keep a share of it for the current worker and pass the rest on to the
+ * worker of the next online CPU, which splits it again in turn.
+ */
+#define Z_EROFS_SPLIT_PCLUSTERS		4
+
+static void z_erofs_split_queue(struct z_erofs_decompressqueue *bgq)
+{
+	unsigned int nr_cpus = num_online_cpus(), nr = 0, keep;
+	z_erofs_next_pcluster_t owned = bgq->head;
+	struct z_erofs_decompressqueue *q;
+	struct z_erofs_pcluster *pcl;
+	int cpu;
+
+	if (nr_cpus < 2)
+		return;
+	while (owned != Z_EROFS_PCLUSTER_TAIL) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		++nr;
+	}
+	if (nr < 2 * Z_EROFS_SPLIT_PCLUSTERS)
+		return;
+
+	q = kvzalloc(sizeof(*q), GFP_NOWAIT | __GFP_NOWARN);
+	if (!q)
+		return;
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+	kthread_init_work(&q->u.kthread_work,
+			  z_erofs_decompressqueue_kthread_work);
+#else
+	INIT_WORK(&q->u.work, z_erofs_decompressqueue_work);
+#endif
+	q->sb = bgq->sb;
+	q->eio = bgq->eio;
+
+	keep = max(DIV_ROUND_UP(nr, nr_cpus), Z_EROFS_SPLIT_PCLUSTERS);
+	owned = bgq->head;
+	do {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+	} while (--keep);
+	q->head = owned;
+	WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL);
+
+	cpu = cpumask_next(raw_smp_processor_id(), cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		cpu = cpumask_first(cpu_online_mask);
+	z_erofs_queue_bg(q, cpu);
+}
+
 static void z_erofs_decompressqueue_work(struct work_struct *work)
 {
 	struct z_erofs_decompressqueue *bgq =
@@ -1321,18 +1403,12 @@ static void z_erofs_decompressqueue_work(struct work_struct *work)
 	struct page *pagepool = NULL;
 
 	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL);
+	z_erofs_split_queue(bgq);
 	z_erofs_decompress_queue(bgq, &pagepool);
 	erofs_release_pages(&pagepool);
 	kvfree(bgq);
 }
 
-#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
-static void z_erofs_decompressqueue_kthread_work(struct kthread_work *work)
-{
-	z_erofs_decompressqueue_work((struct work_struct *)work);
-}
-#endif
-
 static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 				       int bios)
 {
@@ -1349,22 +1425,7 @@ static void z_erofs_decompress_kickoff(struct z_erofs_decompressqueue *io,
 		return;
 	/* Use (kthread_)work and sync decompression for atomic contexts only */
 	if (!in_task() || irqs_disabled() || rcu_read_lock_any_held()) {
-#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
-		struct kthread_worker *worker;
-
-		rcu_read_lock();
-		worker = rcu_dereference(
-				z_erofs_pcpu_workers[raw_smp_processor_id()]);
-		if (!worker) {
-			INIT_WORK(&io->u.work, z_erofs_decompressqueue_work);
-			queue_work(z_erofs_workqueue, &io->u.work);
-		} else {
-			kthread_queue_work(worker, &io->u.kthread_work);
-		}
-		rcu_read_unlock();
-#else
-		queue_work(z_erofs_workqueue, &io->u.work);
-#endif
+		z_erofs_queue_bg(io, raw_smp_processor_id());
 		/* enable sync decompression for readahead */
 		if (sbi->opt.sync_decompress == EROFS_SYNC_DECOMPRESS_AUTO)
 			sbi->opt.sync_decompress = EROFS_SYNC_DECOMPRESS_FORCE_ON;
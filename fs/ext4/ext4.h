@@ -1117,6 +1117,7 @@ struct ext4_inode_info {
 	/* extents status tree */
 	struct ext4_es_tree i_es_tree;
 	rwlock_t i_es_lock;
+	seqcount_rwlock_t i_es_seq;	/* for lockless i_es_tree lookups */
 	struct list_head i_es_list;
 	unsigned int i_es_all_nr;	/* protected by i_es_lock */
 	unsigned int i_es_shk_nr;	/* protected by i_es_lock */
@@ -1621,6 +1622,9 @@ struct ext4_sb_info {
 	atomic_t s_bal_p2_aligned_bad_suggestions;
 	atomic_t s_bal_goal_fast_bad_suggestions;
 	atomic_t s_bal_best_avail_bad_suggestions;
+	atomic_t s_bal_busy_skips;	/* groups skipped, their lock was busy */
+	atomic_t s_bal_cpu_group_tries;	/* scans started at the cpu's group */
+	atomic_t s_bal_cpu_group_hits;	/* ... and allocated from it */
 	atomic64_t s_bal_cX_groups_considered[EXT4_MB_NUM_CRS];
 	atomic64_t s_bal_cX_hits[EXT4_MB_NUM_CRS];
 	atomic64_t s_bal_cX_failed[EXT4_MB_NUM_CRS];		/* cX loop didn't find blocks */
@@ -1633,6 +1637,8 @@ struct ext4_sb_info {
 
 	/* locality groups */
 	struct ext4_locality_group __percpu *s_locality_groups;
+	/* group each cpu last found blocks in by scanning */
+	ext4_group_t __percpu *s_mb_cpu_groups;
 
 	/* for write statistics */
 	unsigned long s_sectors_written_start;
@@ -1731,6 +1737,15 @@ struct ext4_sb_info {
 
 	/* Ext4 fast commit sub transaction ID */
 	atomic_t s_fc_subtid;
+	/*
+	 * Number of fast commits started, and that number for the last one
+	 * that completed. A fast commit that started after an fsync() was
+	 * called covers it.
+	 */
+	atomic_t s_fc_started;
+	atomic_t s_fc_covered;
+	/* Tasks in ext4_fc_commit(), for group commit batching */
+	atomic_t s_fc_committers;
 
 	/*
 	 * After commit starts, the main queue gets locked, and the further
@@ -2910,6 +2925,7 @@ void ext4_fc_del(struct inode *inode);
 bool ext4_fc_replay_check_excluded(struct super_block *sb, ext4_fsblk_t block);
 void ext4_fc_replay_cleanup(struct super_block *sb);
 int ext4_fc_commit(journal_t *journal, tid_t commit_tid);
+ssize_t ext4_fc_hist_show(struct ext4_sb_info *sbi, char *buf);
 int __init ext4_fc_init_dentry_cache(void);
 void ext4_fc_destroy_dentry_cache(void);
 int ext4_fc_record_regions(struct super_block *sb, int ino,
@@ -3502,6 +3518,16 @@ static inline void ext4_lock_group(struct super_block *sb, ext4_group_t group)
 	}
 }
 
+static inline bool ext4_try_lock_group(struct super_block *sb,
+				       ext4_group_t group)
+{
+	if (!spin_trylock(ext4_group_lock_ptr(sb, group)))
+		return false;
+	/* We're able to grab the lock right away, drop the contention counter */
+	atomic_add_unless(&EXT4_SB(sb)->s_lock_busy, -1, 0);
+	return true;
+}
+
 static inline void ext4_unlock_group(struct super_block *sb,
 					ext4_group_t group)
 {
@@ -113,7 +113,11 @@
  *	next extent, adding a extent(a range of blocks) and removing a extent.
  *
  *   --	race on a extent status tree
- *	Extent status tree is protected by inode->i_es_lock.
+ *	Extent status tree is protected by inode->i_es_lock.  Writers also
+ *	bump inode->i_es_seq, so that ext4_es_lookup_extent() can walk the
+ *	tree under RCU and only retry with the lock taken when it raced with
+ *	a writer.  Extents are freed to a SLAB_TYPESAFE_BY_RCU cache, so a
+ *	lockless walk always sees struct extent_status memory.
  *
  *   --	memory consumption
  *      Fragmented extent tree will make extent status tree cost too much
@@ -158,7 +162,8 @@ static int __revise_pending(struct inode *inode, ext4_lblk_t lblk,
 
 int __init ext4_init_es(void)
 {
-	ext4_es_cachep = KMEM_CACHE(extent_status, SLAB_RECLAIM_ACCOUNT);
+	ext4_es_cachep = KMEM_CACHE(extent_status,
+				    SLAB_RECLAIM_ACCOUNT | SLAB_TYPESAFE_BY_RCU);
 	if (ext4_es_cachep == NULL)
 		return -ENOMEM;
 	return 0;
@@ -198,6 +203,26 @@ static void ext4_es_print_tree(struct inode *inode)
 #define ext4_es_print_tree(inode)
 #endif
 
+static inline void ext4_es_write_lock(struct ext4_inode_info *ei)
+{
+	write_lock(&ei->i_es_lock);
+	write_seqcount_begin(&ei->i_es_seq);
+}
+
+static inline bool ext4_es_write_trylock(struct ext4_inode_info *ei)
+{
+	if (!write_trylock(&ei->i_es_lock))
+		return false;
+	write_seqcount_begin(&ei->i_es_seq);
+	return true;
+}
+
+static inline void ext4_es_write_unlock(struct ext4_inode_info *ei)
+{
+	write_seqcount_end(&ei->i_es_seq);
+	write_unlock(&ei->i_es_lock);
+}
+
 static inline ext4_lblk_t ext4_es_end(struct extent_status *es)
 {
 	BUG_ON(es->es_lblk + es->es_len < es->es_lblk);
@@ -834,7 +859,7 @@ static int __es_insert_extent(struct inode *inode, struct extent_status *newes,
 	ext4_es_init_extent(inode, es, newes->es_lblk, newes->es_len,
 			    newes->es_pblk);
 
-	rb_link_node(&es->rb_node, parent, p);
+	rb_link_node_rcu(&es->rb_node, parent, p);
 	rb_insert_color(&es->rb_node, &tree->root);
 
 out:
@@ -890,7 +915,7 @@ void ext4_es_insert_extent(struct inode *inode, ext4_lblk_t lblk,
 		es2 = __es_alloc_extent(true);
 	if ((err1 || err2 || err3 < 0) && revise_pending && !pr)
 		pr = __alloc_pending(true);
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_lock(EXT4_I(inode));
 
 	err1 = __es_remove_extent(inode, lblk, end, &resv_used, es1);
 	if (err1 != 0)
@@ -925,7 +950,7 @@ void ext4_es_insert_extent(struct inode *inode, ext4_lblk_t lblk,
 		pending = err3;
 	}
 error:
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_unlock(EXT4_I(inode));
 	/*
 	 * Reduce the reserved cluster count to reflect successful deferred
 	 * allocation of delayed allocated clusters or direct allocation of
@@ -980,12 +1005,99 @@ void ext4_es_cache_extent(struct inode *inode, ext4_lblk_t lblk,
 
 	BUG_ON(end < lblk);
 
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_lock(EXT4_I(inode));
 
 	es = __es_tree_search(&EXT4_I(inode)->i_es_tree.root, lblk);
 	if (!es || es->es_lblk > end)
 		__es_insert_extent(inode, &newes, NULL);
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_unlock(EXT4_I(inode));
+}
+
+/*
+ * Bound on the nodes visited by a lockless walk, which may be led astray by
+ * concurrent rotations: the height of an rbtree is below 2 * log2(n + 1).
+ */
+#define EXT4_ES_LOCKLESS_MAX_DEPTH	64
+
+/*
+ * Lockless version of the lookup below. Returns 1 on found, 0 on not, and
+ * -EAGAIN if it raced with a writer or the extent isn't marked referenced
+ * yet, which needs the lock.
+ */
+static int ext4_es_lookup_extent_rcu(struct ext4_inode_info *ei,
+				     ext4_lblk_t lblk, ext4_lblk_t *next_lblk,
+				     struct extent_status *es)
+{
+	struct extent_status *es1, *next = NULL;
+	struct extent_status found = {};
+	struct rb_node *node;
+	ext4_lblk_t next_start = 0;
+	unsigned int seq;
+	int depth = 0;
+	int ret = 0;
+
+	seq = raw_read_seqcount(&ei->i_es_seq);
+	if (seq & 1)
+		return -EAGAIN;
+
+	rcu_read_lock();
+	es1 = READ_ONCE(ei->i_es_tree.cache_es);
+	if (es1 && !next_lblk) {
+		found.es_lblk = READ_ONCE(es1->es_lblk);
+		found.es_len = READ_ONCE(es1->es_len);
+		if (lblk - found.es_lblk < found.es_len) {
+			found.es_pblk = READ_ONCE(es1->es_pblk);
+			ret = 1;
+			goto out;
+		}
+	}
+
+	node = READ_ONCE(ei->i_es_tree.root.rb_node);
+	while (node) {
+		if (++depth > EXT4_ES_LOCKLESS_MAX_DEPTH)
+			goto retry;
+		es1 = rb_entry(node, struct extent_status, rb_node);
+		found.es_lblk = READ_ONCE(es1->es_lblk);
+		found.es_len = READ_ONCE(es1->es_len);
+		if (lblk < found.es_lblk) {
+			next = es1;
+			node = READ_ONCE(node->rb_left);
+		} else if (lblk - found.es_lblk >= found.es_len) {
+			node = READ_ONCE(node->rb_right);
+		} else {
+			found.es_pblk = READ_ONCE(es1->es_pblk);
+			ret = 1;
+			break;
+		}
+	}
+	if (!ret || !next_lblk)
+		goto out;
+
+	/* The successor is the leftmost extent right of the one found */
+	node = READ_ONCE(es1->rb_node.rb_right);
+	while (node) {
+		if (++depth > EXT4_ES_LOCKLESS_MAX_DEPTH)
+			goto retry;
+		next = rb_entry(node, struct extent_status, rb_node);
+		node = READ_ONCE(node->rb_left);
+	}
+	if (next)
+		next_start = READ_ONCE(next->es_lblk);
+out:
+	rcu_read_unlock();
+	if (read_seqcount_retry(&ei->i_es_seq, seq))
+		return -EAGAIN;
+	if (ret) {
+		if (!ext4_es_is_referenced(&found))
+			return -EAGAIN;
+		*es = found;
+		if (next_lblk)
+			*next_lblk = next_start;
+	}
+	return ret;
+retry:
+	rcu_read_unlock();
+	return -EAGAIN;
 }
 
 /*
@@ -1011,11 +1123,23 @@ int ext4_es_lookup_extent(struct inode *inode, ext4_lblk_t lblk,
 	trace_ext4_es_lookup_extent_enter(inode, lblk);
 	es_debug("lookup extent in block %u\n", lblk);
 
+	es->es_lblk = es->es_len = es->es_pblk = 0;
+	stats = &EXT4_SB(inode->i_sb)->s_es_stats;
+	found = ext4_es_lookup_extent_rcu(EXT4_I(inode), lblk, next_lblk, es);
+	if (found >= 0) {
+		if (found)
+			percpu_counter_inc(&stats->es_stats_cache_hits);
+		else
+			percpu_counter_inc(&stats->es_stats_cache_misses);
+		trace_ext4_es_lookup_extent_exit(inode, es, found);
+		return found;
+	}
+	found = 0;
+
 	tree = &EXT4_I(inode)->i_es_tree;
 	read_lock(&EXT4_I(inode)->i_es_lock);
 
 	/* find extent in cache firstly */
-	es->es_lblk = es->es_len = es->es_pblk = 0;
 	es1 = READ_ONCE(tree->cache_es);
 	if (es1 && in_range(lblk, es1->es_lblk, es1->es_len)) {
 		es_debug("%u cached by [%u/%u)\n",
@@ -1038,7 +1162,6 @@ int ext4_es_lookup_extent(struct inode *inode, ext4_lblk_t lblk,
 	}
 
 out:
-	stats = &EXT4_SB(inode->i_sb)->s_es_stats;
 	if (found) {
 		BUG_ON(!es1);
 		es->es_lblk = es1->es_lblk;
@@ -1537,7 +1660,7 @@ void ext4_es_remove_extent(struct inode *inode, ext4_lblk_t lblk,
 	 * so that we are sure __es_shrink() is done with the inode before it
 	 * is reclaimed.
 	 */
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_lock(EXT4_I(inode));
 	err = __es_remove_extent(inode, lblk, end, &reserved, es);
 	/* Free preallocated extent if it didn't get used. */
 	if (es) {
@@ -1545,7 +1668,7 @@ void ext4_es_remove_extent(struct inode *inode, ext4_lblk_t lblk,
 			__es_free_extent(es);
 		es = NULL;
 	}
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_unlock(EXT4_I(inode));
 	if (err)
 		goto retry;
 
@@ -1591,7 +1714,7 @@ static int __es_shrink(struct ext4_sb_info *sbi, int nr_to_scan,
 			continue;
 		}
 
-		if (ei == locked_ei || !write_trylock(&ei->i_es_lock)) {
+		if (ei == locked_ei || !ext4_es_write_trylock(ei)) {
 			nr_skipped++;
 			continue;
 		}
@@ -1602,7 +1725,7 @@ static int __es_shrink(struct ext4_sb_info *sbi, int nr_to_scan,
 		spin_unlock(&sbi->s_es_lock);
 
 		nr_shrunk += es_reclaim_extents(ei, &nr_to_scan);
-		write_unlock(&ei->i_es_lock);
+		ext4_es_write_unlock(ei);
 
 		if (nr_to_scan <= 0)
 			goto out;
@@ -1860,7 +1983,7 @@ void ext4_clear_inode_es(struct inode *inode)
 	struct ext4_es_tree *tree;
 	struct rb_node *node;
 
-	write_lock(&ei->i_es_lock);
+	ext4_es_write_lock(ei);
 	tree = &EXT4_I(inode)->i_es_tree;
 	tree->cache_es = NULL;
 	node = rb_first(&tree->root);
@@ -1873,7 +1996,7 @@ void ext4_clear_inode_es(struct inode *inode)
 		}
 	}
 	ext4_clear_inode_state(inode, EXT4_STATE_EXT_PRECACHED);
-	write_unlock(&ei->i_es_lock);
+	ext4_es_write_unlock(ei);
 }
 
 #ifdef ES_DEBUG__
@@ -2126,7 +2249,7 @@ void ext4_es_insert_delayed_extent(struct inode *inode, ext4_lblk_t lblk,
 		if (end_allocated && !pr2)
 			pr2 = __alloc_pending(true);
 	}
-	write_lock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_lock(EXT4_I(inode));
 
 	err1 = __es_remove_extent(inode, lblk, end, NULL, es1);
 	if (err1 != 0)
@@ -2167,7 +2290,7 @@ void ext4_es_insert_delayed_extent(struct inode *inode, ext4_lblk_t lblk,
 		}
 	}
 error:
-	write_unlock(&EXT4_I(inode)->i_es_lock);
+	ext4_es_write_unlock(EXT4_I(inode));
 	if (err1 || err2 || err3 < 0)
 		goto retry;
 
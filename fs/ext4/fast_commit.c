@@ -7,6 +7,7 @@
  *
  * Ext4 fast commits routines.
  */
+#include <linux/hrtimer.h>
 #include "ext4.h"
 #include "ext4_jbd2.h"
 #include "ext4_extents.h"
@@ -1169,6 +1170,15 @@ static int ext4_fc_perform_commit(journal_t *journal)
 	return ret;
 }
 
+static unsigned int ext4_fc_hist_bucket(u64 commit_time)
+{
+	u64 us = div_u64(commit_time, NSEC_PER_USEC);
+
+	if (!us)
+		return 0;
+	return min_t(unsigned int, ilog2(us) + 1, EXT4_FC_HIST_BUCKETS - 1);
+}
+
 static void ext4_fc_update_stats(struct super_block *sb, int status,
 				 u64 commit_time, int nblks, tid_t commit_tid)
 {
@@ -1185,6 +1195,7 @@ static void ext4_fc_update_stats(struct super_block *sb, int status,
 				 stats->s_fc_avg_commit_time * 3) / 4;
 		else
 			stats->s_fc_avg_commit_time = commit_time;
+		stats->fc_commit_hist[ext4_fc_hist_bucket(commit_time)]++;
 	} else if (status == EXT4_FC_STATUS_FAILED ||
 		   status == EXT4_FC_STATUS_INELIGIBLE) {
 		if (status == EXT4_FC_STATUS_FAILED)
@@ -1197,25 +1208,50 @@ static void ext4_fc_update_stats(struct super_block *sb, int status,
 }
 
 /*
- * The main commit entry point. Performs a fast commit for transaction
- * commit_tid if needed. If it's not possible to perform a fast commit
- * due to various reasons, we fall back to full commit. Returns 0
- * on success, error otherwise.
+ * Group commit: when other tasks are fsync()ing as well, give them about the
+ * time of a fast commit to get their updates in, so that a single commit
+ * covers them all. The wait is bounded by the min_batch_time and
+ * max_batch_time mount options, like jbd2 does for synchronous handles.
  */
-int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
+static void ext4_fc_batch(journal_t *journal, struct ext4_sb_info *sbi)
+{
+	u64 batch_time;
+	ktime_t expires;
+
+	if (!journal->j_max_batch_time ||
+	    atomic_read(&sbi->s_fc_committers) < 2 ||
+	    READ_ONCE(journal->j_flags) & JBD2_FAST_COMMIT_ONGOING)
+		return;
+
+	batch_time = clamp_t(u64, READ_ONCE(sbi->s_fc_stats.s_fc_avg_commit_time),
+			     (u64)journal->j_min_batch_time * NSEC_PER_USEC,
+			     (u64)journal->j_max_batch_time * NSEC_PER_USEC);
+	expires = ktime_add_ns(ktime_get(), batch_time);
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+}
+
+static int __ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 {
 	struct super_block *sb = journal->j_private;
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	int nblks = 0, ret, bsize = journal->j_blocksize;
 	int subtid = atomic_read(&sbi->s_fc_subtid);
+	int started = atomic_read(&sbi->s_fc_started);
 	int status = EXT4_FC_STATUS_OK, fc_bufs_before = 0;
 	ktime_t start_time, commit_time;
-
-	if (!test_opt2(sb, JOURNAL_FAST_COMMIT))
-		return jbd2_complete_transaction(journal, commit_tid);
+	int seq;
 
 	trace_ext4_fc_commit_start(sb, commit_tid);
 
+	ext4_fc_batch(journal, sbi);
+	if (atomic_read(&sbi->s_fc_covered) - started > 0) {
+		/* A fast commit that started after us already covered us */
+		ext4_fc_update_stats(sb, EXT4_FC_STATUS_SKIPPED, 0, 0,
+				commit_tid);
+		return 0;
+	}
+
 	start_time = ktime_get();
 
 restart_fc:
@@ -1238,6 +1274,8 @@ int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 		return jbd2_complete_transaction(journal, commit_tid);
 	}
 
+	seq = atomic_inc_return(&sbi->s_fc_started);
+
 	/*
 	 * After establishing journal barrier via jbd2_fc_begin_commit(), check
 	 * if we are fast commit ineligible.
@@ -1260,6 +1298,7 @@ int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 		goto fallback;
 	}
 	atomic_inc(&sbi->s_fc_subtid);
+	atomic_set(&sbi->s_fc_covered, seq);
 	ret = jbd2_fc_end_commit(journal);
 	/*
 	 * weight the commit time higher than the average time so we
@@ -1275,6 +1314,47 @@ int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
 	return ret;
 }
 
+/*
+ * The main commit entry point. Performs a fast commit for transaction
+ * commit_tid if needed. If it's not possible to perform a fast commit
+ * due to various reasons, we fall back to full commit. Returns 0
+ * on success, error otherwise.
+ */
+int ext4_fc_commit(journal_t *journal, tid_t commit_tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int ret;
+
+	if (!test_opt2(sb, JOURNAL_FAST_COMMIT))
+		return jbd2_complete_transaction(journal, commit_tid);
+
+	atomic_inc(&sbi->s_fc_committers);
+	ret = __ext4_fc_commit(journal, commit_tid);
+	atomic_dec(&sbi->s_fc_committers);
+	return ret;
+}
+
+/**
+ * ext4_fc_hist_show - print the fast commit latency histogram
+ * @sbi: the filesystem
+ * @buf: sysfs buffer
+ *
+ * One count per bucket, bucket i counting commits that took [2^(i-1), 2^i)
+ * microseconds, the last one everything longer.
+ */
+ssize_t ext4_fc_hist_show(struct ext4_sb_info *sbi, char *buf)
+{
+	struct ext4_fc_stats *stats = &sbi->s_fc_stats;
+	int i, len = 0;
+
+	for (i = 0; i < EXT4_FC_HIST_BUCKETS; i++)
+		len += sysfs_emit_at(buf, len, "%lu%c",
+				     READ_ONCE(stats->fc_commit_hist[i]),
+				     i == EXT4_FC_HIST_BUCKETS - 1 ? '\n' : ' ');
+	return len;
+}
+
 /*
  * Fast commit cleanup routine. This is called after every fast commit and
  * full commit. full is true if we are called after a full commit.
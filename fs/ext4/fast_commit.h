@@ -115,6 +115,9 @@ struct ext4_fc_dentry_update {
 	struct list_head fcd_dilist;
 };
 
+/* log2 buckets of fast commit latency, bucket i counts [2^(i-1), 2^i) us */
+#define EXT4_FC_HIST_BUCKETS	20
+
 struct ext4_fc_stats {
 	unsigned int fc_ineligible_reason_count[EXT4_FC_REASON_MAX];
 	unsigned long fc_num_commits;
@@ -123,6 +126,7 @@ struct ext4_fc_stats {
 	unsigned long fc_skipped_commits;
 	unsigned long fc_numblks;
 	u64 s_fc_avg_commit_time;
+	unsigned long fc_commit_hist[EXT4_FC_HIST_BUCKETS];
 };
 
 #define EXT4_FC_REPLAY_REALLOC_INCREMENT	4
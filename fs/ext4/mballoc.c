@@ -2800,6 +2800,7 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 	enum criteria new_cr, cr = CR_GOAL_LEN_FAST;
 	int err = 0, first_err = 0;
 	unsigned int nr = 0, prefetch_ios = 0;
+	ext4_group_t cpu_group = ~0U;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
 	struct ext4_buddy e4b;
@@ -2849,6 +2850,22 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
 		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
 		spin_unlock(&sbi->s_md_lock);
+	} else if (spin_is_locked(ext4_group_lock_ptr(sb, ac->ac_g_ex.fe_group))) {
+		/*
+		 * Someone else is allocating from the goal group. Rather than
+		 * piling up on its lock with everybody writing near the same
+		 * goal, start scanning from the group this CPU last found
+		 * blocks in, which tends to be left to this CPU.
+		 */
+		cpu_group = this_cpu_read(*sbi->s_mb_cpu_groups);
+		if (cpu_group < ngroups && cpu_group != ac->ac_g_ex.fe_group) {
+			ac->ac_g_ex.fe_group = cpu_group;
+			ac->ac_g_ex.fe_start = 0;
+			if (sbi->s_mb_stats)
+				atomic_inc(&sbi->s_bal_cpu_group_tries);
+		} else {
+			cpu_group = ~0U;
+		}
 	}
 
 	/*
@@ -2911,7 +2928,20 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 			if (err)
 				goto out;
 
-			ext4_lock_group(sb, group);
+			/*
+			 * Skip groups somebody else is allocating from, until
+			 * we are down to taking any free block.
+			 */
+			if (cr < CR_ANY_FREE) {
+				if (!ext4_try_lock_group(sb, group)) {
+					if (sbi->s_mb_stats)
+						atomic_inc(&sbi->s_bal_busy_skips);
+					ext4_mb_unload_buddy(&e4b);
+					continue;
+				}
+			} else {
+				ext4_lock_group(sb, group);
+			}
 
 			/*
 			 * We need to check again after locking the
@@ -2987,6 +3017,12 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 		}
 	}
 
+	if (ac->ac_status == AC_STATUS_FOUND) {
+		this_cpu_write(*sbi->s_mb_cpu_groups, ac->ac_b_ex.fe_group);
+		if (sbi->s_mb_stats && ac->ac_b_ex.fe_group == cpu_group)
+			atomic_inc(&sbi->s_bal_cpu_group_hits);
+	}
+
 	if (sbi->s_mb_stats && ac->ac_status == AC_STATUS_FOUND)
 		atomic64_inc(&sbi->s_bal_cX_hits[ac->ac_criteria]);
 out:
@@ -3110,6 +3146,12 @@ int ext4_seq_mb_stats_show(struct seq_file *seq, void *offset)
 
 	seq_printf(seq, "\tgroups_scanned: %u\n",
 		   atomic_read(&sbi->s_bal_groups_scanned));
+	seq_printf(seq, "\tlock_busy_skips: %u\n",
+		   atomic_read(&sbi->s_bal_busy_skips));
+	seq_printf(seq, "\tcpu_group_tries: %u\n",
+		   atomic_read(&sbi->s_bal_cpu_group_tries));
+	seq_printf(seq, "\tcpu_group_hits: %u\n",
+		   atomic_read(&sbi->s_bal_cpu_group_hits));
 
 	/* CR_POWER2_ALIGNED stats */
 	seq_puts(seq, "\tcr_p2_aligned_stats:\n");
@@ -3725,6 +3767,16 @@ int ext4_mb_init(struct super_block *sb)
 		spin_lock_init(&lg->lg_prealloc_lock);
 	}
 
+	sbi->s_mb_cpu_groups = alloc_percpu(ext4_group_t);
+	if (sbi->s_mb_cpu_groups == NULL) {
+		ret = -ENOMEM;
+		goto out_free_locality_groups;
+	}
+	/* spread the CPUs over the groups until they found their own */
+	for_each_possible_cpu(i)
+		*per_cpu_ptr(sbi->s_mb_cpu_groups, i) =
+			i % ext4_get_groups_count(sb);
+
 	if (bdev_nonrot(sb->s_bdev))
 		sbi->s_mb_max_linear_groups = 0;
 	else
@@ -3732,10 +3784,13 @@ int ext4_mb_init(struct super_block *sb)
 	/* init file for buddy data */
 	ret = ext4_mb_init_backend(sb);
 	if (ret != 0)
-		goto out_free_locality_groups;
+		goto out_free_cpu_groups;
 
 	return 0;
 
+out_free_cpu_groups:
+	free_percpu(sbi->s_mb_cpu_groups);
+	sbi->s_mb_cpu_groups = NULL;
 out_free_locality_groups:
 	free_percpu(sbi->s_locality_groups);
 	sbi->s_locality_groups = NULL;
@@ -3842,6 +3897,7 @@ void ext4_mb_release(struct super_block *sb)
 				atomic_read(&sbi->s_mb_discarded));
 	}
 
+	free_percpu(sbi->s_mb_cpu_groups);
 	free_percpu(sbi->s_locality_groups);
 }
 
@@ -35,6 +35,7 @@ MODULE_ALIAS("devname:fuse");
 static struct kmem_cache *fuse_req_cachep;
 
 static void end_requests(struct list_head *head);
+static bool fuse_ring_queue_req(struct fuse_iqueue *fiq, struct fuse_req *req);
 
 static struct fuse_dev *fuse_get_dev(struct file *file)
 {
@@ -286,6 +287,9 @@ static void fuse_dev_queue_interrupt(struct fuse_iqueue *fiq, struct fuse_req *r
 
 static void fuse_dev_queue_req(struct fuse_iqueue *fiq, struct fuse_req *req)
 {
+	if (fuse_ring_queue_req(fiq, req))
+		return;
+
 	spin_lock(&fiq->lock);
 	if (fiq->connected) {
 		if (req->in.h.opcode != FUSE_NOTIFY_REPLY)
@@ -704,6 +708,8 @@ struct fuse_copy_state {
 	unsigned len;
 	unsigned offset;
 	unsigned move_pages:1;
+	/* Copying to or from the shared ring, whose pages are not page cache */
+	unsigned ring:1;
 };
 
 static void fuse_copy_init(struct fuse_copy_state *cs, int write,
@@ -726,7 +732,8 @@ static void fuse_copy_finish(struct fuse_copy_state *cs)
 	} else if (cs->pg) {
 		if (cs->write) {
 			flush_dcache_page(cs->pg);
-			set_page_dirty_lock(cs->pg);
+			if (!cs->ring)
+				set_page_dirty_lock(cs->pg);
 		}
 		put_page(cs->pg);
 	}
@@ -2075,6 +2082,156 @@ static ssize_t fuse_dev_write(struct kiocb *iocb, struct iov_iter *from)
 	return fuse_dev_do_write(fud, &cs, iov_iter_count(from));
 }
 
+/*
+ * Post a request to the shared ring of the current CPU, if there is one
+ * and the request fits in a slot.  The request goes straight to the
+ * processing queue of the ring's device, the daemon is only woken up when
+ * the ring was empty.
+ *
+ * Called from ->send_req(), possibly in atomic context: the copy can't
+ * fault since the slots are kernel pages.
+ */
+static bool fuse_ring_queue_req(struct fuse_iqueue *fiq, struct fuse_req *req)
+{
+	struct fuse_conn *fc = container_of(fiq, struct fuse_conn, iq);
+	struct fuse_ring __rcu **rings = READ_ONCE(fc->rings);
+	struct fuse_args *args = req->args;
+	struct fuse_copy_state cs;
+	struct fuse_pqueue *fpq;
+	struct fuse_ring *ring;
+	struct iov_iter iter;
+	bool queued = false;
+	u32 prod, cons;
+	int err;
+
+	if (!rings || req->in.h.opcode == FUSE_NOTIFY_REPLY ||
+	    !test_bit(FR_ISREPLY, &req->flags))
+		return false;
+
+	rcu_read_lock();
+	ring = rcu_dereference(rings[raw_smp_processor_id()]);
+	if (!ring || req->in.h.len > ring->entry_size)
+		goto out;
+
+	spin_lock(&ring->lock);
+	prod = ring->req_next;
+	/* Pairs with the daemon's store-release of the consumer position */
+	cons = smp_load_acquire(ring->req_cons);
+	if (prod - cons >= ring->nr_entries)
+		goto out_unlock;
+
+	req->in.h.unique = fuse_get_unique(fiq);
+	fuse_ring_iter(ring, false, prod, req->in.h.len, &iter);
+	fuse_copy_init(&cs, 1, &iter);
+	cs.ring = 1;
+	cs.req = req;
+	err = fuse_copy_one(&cs, &req->in.h, sizeof(req->in.h));
+	if (!err)
+		err = fuse_copy_args(&cs, args->in_numargs, args->in_pages,
+				     (struct fuse_arg *) args->in_args, 0);
+	fuse_copy_finish(&cs);
+	clear_bit(FR_LOCKED, &req->flags);
+	if (err)
+		goto out_unlock;
+
+	/* A disconnected device leaves ending the request to the slow path */
+	fpq = &ring->fud->pq;
+	spin_lock(&fpq->lock);
+	if (!fpq->connected) {
+		spin_unlock(&fpq->lock);
+		goto out_unlock;
+	}
+	clear_bit(FR_PENDING, &req->flags);
+	list_add_tail(&req->list,
+		      &fpq->processing[fuse_req_hash(req->in.h.unique)]);
+	__fuse_get_request(req);
+	set_bit(FR_SENT, &req->flags);
+	spin_unlock(&fpq->lock);
+
+	/* Publish the request before the position that covers it */
+	WRITE_ONCE(ring->req_next, prod + 1);
+	smp_store_release(ring->req_prod, prod + 1);
+	spin_unlock(&ring->lock);
+	/*
+	 * The daemon may have consumed everything up to @prod since @cons was
+	 * read, and gone to sleep without seeing the new request.  Pairs with
+	 * the barrier in the waiter's set_current_state(): either it sees the
+	 * new req_next, or we see the consumer position it stored.
+	 */
+	smp_mb();
+	cons = READ_ONCE(*ring->req_cons);
+	if (prod == cons) {
+		wake_up(&ring->waitq);
+		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
+	}
+	queued = true;
+
+	/* matches barrier in request_wait_answer() */
+	smp_mb__after_atomic();
+	if (test_bit(FR_INTERRUPTED, &req->flags))
+		queue_interrupt(req);
+	fuse_put_request(req);
+	goto out;
+
+out_unlock:
+	spin_unlock(&ring->lock);
+out:
+	rcu_read_unlock();
+	return queued;
+}
+
+/*
+ * Complete the replies the daemon posted to the ring.  A malformed reply
+ * is consumed and its error returned, like write() would.
+ */
+static int fuse_ring_complete_replies(struct fuse_dev *fud,
+				      struct fuse_ring *ring)
+{
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	u32 prod, cons, len;
+	ssize_t ret;
+	int err = 0;
+
+	mutex_lock(&ring->reply_mutex);
+	cons = ring->reply_next;
+	/* Pairs with the daemon's store-release of the producer position */
+	prod = smp_load_acquire(ring->reply_prod);
+	if (prod - cons > ring->nr_entries) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	while (cons != prod) {
+		struct fuse_out_header *oh = fuse_ring_slot(ring, true, cons);
+
+		len = READ_ONCE(oh->len);
+		if (len < sizeof(*oh) || len > ring->entry_size) {
+			err = -EINVAL;
+		} else {
+			fuse_ring_iter(ring, true, cons, len, &iter);
+			fuse_copy_init(&cs, 0, &iter);
+			cs.ring = 1;
+			ret = fuse_dev_do_write(fud, &cs, len);
+			if (ret < 0)
+				err = ret;
+		}
+		ring->reply_next = ++cons;
+		/* Hand the slot back to the daemon */
+		smp_store_release(ring->reply_cons, cons);
+		if (err)
+			break;
+	}
+out:
+	mutex_unlock(&ring->reply_mutex);
+	return err;
+}
+
+static bool fuse_ring_has_req(struct fuse_ring *ring)
+{
+	return READ_ONCE(ring->req_next) != READ_ONCE(*ring->req_cons);
+}
+
 static ssize_t fuse_dev_splice_write(struct pipe_inode_info *pipe,
 				     struct file *out, loff_t *ppos,
 				     size_t len, unsigned int flags)
@@ -2180,11 +2337,14 @@ static __poll_t fuse_dev_poll(struct file *file, poll_table *wait)
 
 	fiq = &fud->fc->iq;
 	poll_wait(file, &fiq->waitq, wait);
+	if (fud->ring)
+		poll_wait(file, &fud->ring->waitq, wait);
 
 	spin_lock(&fiq->lock);
 	if (!fiq->connected)
 		mask = EPOLLERR;
-	else if (request_pending(fiq))
+	else if (request_pending(fiq) ||
+		 (fud->ring && fuse_ring_has_req(fud->ring)))
 		mask |= EPOLLIN | EPOLLRDNORM;
 	spin_unlock(&fiq->lock);
 
@@ -2274,6 +2434,8 @@ void fuse_abort_conn(struct fuse_conn *fc)
 				list_splice_tail_init(&fpq->processing[i],
 						      &to_end);
 			spin_unlock(&fpq->lock);
+			if (fud->ring)
+				wake_up_all(&fud->ring->waitq);
 		}
 		spin_lock(&fc->bg_lock);
 		fc->blocked = 0;
@@ -2316,9 +2478,18 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 	if (fud) {
 		struct fuse_conn *fc = fud->fc;
 		struct fuse_pqueue *fpq = &fud->pq;
+		struct fuse_ring *ring = fud->ring;
 		LIST_HEAD(to_end);
 		unsigned int i;
 
+		if (ring) {
+			/* No more requests are posted once readers are gone */
+			spin_lock(&fc->lock);
+			RCU_INIT_POINTER(fc->rings[ring->cpu], NULL);
+			spin_unlock(&fc->lock);
+			synchronize_rcu();
+		}
+
 		spin_lock(&fpq->lock);
 		WARN_ON(!list_empty(&fpq->io));
 		for (i = 0; i < FUSE_PQ_HASH_SIZE; i++)
@@ -2332,6 +2503,7 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 			WARN_ON(fc->iq.fasync != NULL);
 			fuse_abort_conn(fc);
 		}
+		fuse_ring_free(ring);
 		fuse_dev_free(fud);
 	}
 	return 0;
@@ -2433,6 +2605,93 @@ static long fuse_dev_ioctl_backing_close(struct file *file, __u32 __user *argp)
 	return fuse_backing_close(fud->fc, backing_id);
 }
 
+static long fuse_dev_ioctl_ring(struct file *file,
+				struct fuse_ring_setup __user *argp)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_ring __rcu **rings = NULL;
+	struct fuse_ring_setup setup;
+	struct fuse_conn *fc;
+	struct fuse_ring *ring;
+	int err;
+
+	if (!fud)
+		return -EPERM;
+
+	if (copy_from_user(&setup, argp, sizeof(setup)))
+		return -EFAULT;
+
+	ring = fuse_ring_alloc(&setup);
+	if (IS_ERR(ring))
+		return PTR_ERR(ring);
+	ring->fud = fud;
+
+	fc = fud->fc;
+	if (!READ_ONCE(fc->rings)) {
+		rings = kcalloc(nr_cpu_ids, sizeof(*rings), GFP_KERNEL_ACCOUNT);
+		if (!rings) {
+			fuse_ring_free(ring);
+			return -ENOMEM;
+		}
+	}
+
+	spin_lock(&fc->lock);
+	if (!fc->rings) {
+		WRITE_ONCE(fc->rings, rings);
+		rings = NULL;
+	}
+	err = -EBUSY;
+	if (!fud->ring && !rcu_access_pointer(fc->rings[ring->cpu])) {
+		fud->ring = ring;
+		rcu_assign_pointer(fc->rings[ring->cpu], ring);
+		ring = NULL;
+		err = 0;
+	}
+	spin_unlock(&fc->lock);
+
+	kfree(rings);
+	fuse_ring_free(ring);
+	return err;
+}
+
+static long fuse_dev_ioctl_ring_enter(struct file *file, __u32 __user *argp)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_ring *ring;
+	__u32 flags;
+	int err;
+
+	if (!fud)
+		return -EPERM;
+
+	ring = READ_ONCE(fud->ring);
+	if (!ring)
+		return -EINVAL;
+
+	if (get_user(flags, argp))
+		return -EFAULT;
+
+	if (flags & ~FUSE_RING_ENTER_GETREQ)
+		return -EINVAL;
+
+	err = fuse_ring_complete_replies(fud, ring);
+	if (err || !(flags & FUSE_RING_ENTER_GETREQ))
+		return err;
+
+	if (!fuse_ring_has_req(ring) && (file->f_flags & O_NONBLOCK))
+		return -EAGAIN;
+
+	err = wait_event_interruptible(ring->waitq, fuse_ring_has_req(ring) ||
+				       !READ_ONCE(fud->pq.connected));
+	if (err)
+		return err;
+
+	if (!READ_ONCE(fud->pq.connected))
+		return fud->fc->aborted ? -ECONNABORTED : -ENODEV;
+
+	return READ_ONCE(ring->req_next) - READ_ONCE(*ring->req_cons);
+}
+
 static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 			   unsigned long arg)
 {
@@ -2448,11 +2707,32 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 	case FUSE_DEV_IOC_BACKING_CLOSE:
 		return fuse_dev_ioctl_backing_close(file, argp);
 
+	case FUSE_DEV_IOC_RING:
+		return fuse_dev_ioctl_ring(file, argp);
+
+	case FUSE_DEV_IOC_RING_ENTER:
+		return fuse_dev_ioctl_ring_enter(file, argp);
+
 	default:
 		return -ENOTTY;
 	}
 }
 
+static int fuse_dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_ring *ring;
+
+	if (!fud)
+		return -EPERM;
+
+	ring = READ_ONCE(fud->ring);
+	if (!ring)
+		return -ENODEV;
+
+	return fuse_ring_mmap(ring, vma);
+}
+
 const struct file_operations fuse_dev_operations = {
 	.owner		= THIS_MODULE,
 	.open		= fuse_dev_open,
@@ -2461,6 +2741,7 @@ const struct file_operations fuse_dev_operations = {
 	.write_iter	= fuse_dev_write,
 	.splice_write	= fuse_dev_splice_write,
 	.poll		= fuse_dev_poll,
+	.mmap		= fuse_dev_mmap,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
 	.unlocked_ioctl = fuse_dev_ioctl,
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * FUSE shared request/reply ring.
+ *
+ * Instead of a read() and a write() per request, a daemon thread bound to
+ * a CPU sets up a ring on its (cloned) fuse device, and requests submitted
+ * on that CPU are posted to the ring's request slots.  Replies are posted
+ * to the reply slots, and FUSE_DEV_IOC_RING_ENTER completes them and waits
+ * for more requests in one syscall.  The daemon is only woken up when the
+ * request ring goes from empty to non-empty.
+ *
+ * The mapping layout is described in <uapi/linux/fuse.h>.  This file deals
+ * with the memory of the ring, posting and completing is done in dev.c with
+ * the regular copy helpers.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/bvec.h>
+#include <linux/slab.h>
+#include <linux/uio.h>
+#include <linux/vmalloc.h>
+
+/* Control page */
+#define FUSE_RING_META_PAGES	1
+
+/**
+ * fuse_ring_alloc - allocate a shared ring
+ * @setup: the FUSE_DEV_IOC_RING argument
+ *
+ * Return: the ring, or an ERR_PTR().
+ */
+struct fuse_ring *fuse_ring_alloc(const struct fuse_ring_setup *setup)
+{
+	unsigned int entry_pages, nr_pages;
+	struct fuse_ring *ring;
+	int i;
+
+	if (setup->flags || setup->cpu >= nr_cpu_ids ||
+	    !cpu_possible(setup->cpu))
+		return ERR_PTR(-EINVAL);
+	if (!is_power_of_2(setup->nr_entries) ||
+	    !setup->entry_size || !PAGE_ALIGNED(setup->entry_size))
+		return ERR_PTR(-EINVAL);
+
+	entry_pages = setup->entry_size >> PAGE_SHIFT;
+	if (setup->nr_entries > FUSE_RING_MAX_PAGES / 2 / entry_pages)
+		return ERR_PTR(-EINVAL);
+	nr_pages = FUSE_RING_META_PAGES + 2 * setup->nr_entries * entry_pages;
+	if (nr_pages > FUSE_RING_MAX_PAGES)
+		return ERR_PTR(-EINVAL);
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL_ACCOUNT);
+	if (!ring)
+		return ERR_PTR(-ENOMEM);
+
+	ring->req_bvec = kcalloc(entry_pages, sizeof(struct bio_vec),
+				 GFP_KERNEL_ACCOUNT);
+	ring->reply_bvec = kcalloc(entry_pages, sizeof(struct bio_vec),
+				   GFP_KERNEL_ACCOUNT);
+	ring->pages = kvcalloc(nr_pages, sizeof(*ring->pages),
+			       GFP_KERNEL_ACCOUNT);
+	if (!ring->req_bvec || !ring->reply_bvec || !ring->pages)
+		goto err_free;
+
+	for (i = 0; i < nr_pages; i++) {
+		ring->pages[i] = alloc_page(GFP_KERNEL_ACCOUNT | __GFP_ZERO);
+		if (!ring->pages[i])
+			goto err_free_pages;
+	}
+
+	ring->base = vmap(ring->pages, nr_pages, VM_MAP | VM_USERMAP,
+			  PAGE_KERNEL);
+	if (!ring->base)
+		goto err_free_pages;
+
+	spin_lock_init(&ring->lock);
+	mutex_init(&ring->reply_mutex);
+	init_waitqueue_head(&ring->waitq);
+	ring->cpu = setup->cpu;
+	ring->nr_entries = setup->nr_entries;
+	ring->entry_size = setup->entry_size;
+	ring->nr_pages = nr_pages;
+	ring->req_prod = ring->base + FUSE_RING_REQ_PROD;
+	ring->req_cons = ring->base + FUSE_RING_REQ_CONS;
+	ring->reply_prod = ring->base + FUSE_RING_REPLY_PROD;
+	ring->reply_cons = ring->base + FUSE_RING_REPLY_CONS;
+	return ring;
+
+err_free_pages:
+	while (i--)
+		__free_page(ring->pages[i]);
+err_free:
+	kvfree(ring->pages);
+	kfree(ring->reply_bvec);
+	kfree(ring->req_bvec);
+	kfree(ring);
+	return ERR_PTR(-ENOMEM);
+}
+
+void fuse_ring_free(struct fuse_ring *ring)
+{
+	unsigned int i;
+
+	if (!ring)
+		return;
+
+	vunmap(ring->base);
+	for (i = 0; i < ring->nr_pages; i++)
+		__free_page(ring->pages[i]);
+	kvfree(ring->pages);
+	kfree(ring->reply_bvec);
+	kfree(ring->req_bvec);
+	kfree(ring);
+}
+
+/**
+ * fuse_ring_mmap - map a shared ring into the daemon
+ * @ring: the ring
+ * @vma: the vma to map it into, from the device's ->mmap()
+ */
+int fuse_ring_mmap(struct fuse_ring *ring, struct vm_area_struct *vma)
+{
+	/* remap_vmalloc_range() checks size and offset constraints */
+	return remap_vmalloc_range(vma, ring->base, vma->vm_pgoff);
+}
+
+/* Index of the first page of the slot at @pos */
+static unsigned int fuse_ring_slot_page(struct fuse_ring *ring, bool reply,
+					u32 pos)
+{
+	unsigned int slot = pos & (ring->nr_entries - 1);
+
+	if (reply)
+		slot += ring->nr_entries;
+	return FUSE_RING_META_PAGES + slot * (ring->entry_size >> PAGE_SHIFT);
+}
+
+/**
+ * fuse_ring_slot - kernel address of a slot
+ * @ring: the ring
+ * @reply: reply slot rather than request slot
+ * @pos: position of the slot
+ */
+void *fuse_ring_slot(struct fuse_ring *ring, bool reply, u32 pos)
+{
+	return ring->base +
+		((size_t)fuse_ring_slot_page(ring, reply, pos) << PAGE_SHIFT);
+}
+
+/**
+ * fuse_ring_iter - set up an iterator over a slot
+ * @ring: the ring
+ * @reply: reply slot to copy from, rather than request slot to copy to
+ * @pos: position of the slot
+ * @len: bytes to copy, at most the entry size
+ * @iter: the iterator
+ *
+ * The iterator uses the ring's page vector of that direction, so the
+ * caller must hold ring->lock for requests, and ring->reply_mutex for
+ * replies, until it is done with it.
+ */
+void fuse_ring_iter(struct fuse_ring *ring, bool reply, u32 pos, size_t len,
+		    struct iov_iter *iter)
+{
+	unsigned int first = fuse_ring_slot_page(ring, reply, pos);
+	unsigned int i, nr = ring->entry_size >> PAGE_SHIFT;
+	struct bio_vec *bv = reply ? ring->reply_bvec : ring->req_bvec;
+
+	for (i = 0; i < nr; i++)
+		bvec_set_page(&bv[i], ring->pages[first + i], PAGE_SIZE, 0);
+	iov_iter_bvec(iter, reply ? ITER_SOURCE : ITER_DEST, bv, nr, len);
+}
@@ -1311,6 +1311,22 @@ static int fuse_update_get_attr(struct mnt_idmap *idmap, struct inode *inode,
 
 	/* FUSE only supports basic stats and possibly btime */
 	request_mask &= STATX_BASIC_STATS | STATX_BTIME;
+
+	/* The server may leave attributes of passthrough inodes to the backing file */
+	if (stat && idmap == &nop_mnt_idmap && fuse_inode_backing(fi)) {
+		struct fuse_backing *fb;
+
+		rcu_read_lock();
+		fb = fuse_backing_get(fuse_inode_backing(fi));
+		rcu_read_unlock();
+		if (fb && (fb->flags & FUSE_BACKING_ATTR)) {
+			err = fuse_passthrough_getattr(inode, fb, stat,
+						       request_mask, flags);
+			fuse_backing_put(fb);
+			return err;
+		}
+		fuse_backing_put(fb);
+	}
 retry:
 	if (fc->no_statx)
 		request_mask &= STATX_BASIC_STATS;
@@ -1682,6 +1698,14 @@ static int fuse_dir_open(struct inode *inode, struct file *file)
 			nonseekable_open(inode, file);
 		if (!(ff->open_flags & FOPEN_KEEP_CACHE))
 			invalidate_inode_pages2(inode->i_mapping);
+
+		/* fsyncdir on a backing directory */
+		if (IS_ENABLED(CONFIG_FUSE_PASSTHROUGH) &&
+		    (ff->open_flags & FOPEN_PASSTHROUGH) &&
+		    fuse_passthrough_opendir(inode, file)) {
+			fuse_release_common(file, true);
+			err = -EIO;
+		}
 	}
 
 	return err;
@@ -1704,6 +1728,9 @@ static int fuse_dir_fsync(struct file *file, loff_t start, loff_t end,
 	if (fuse_is_bad(inode))
 		return -EIO;
 
+	if (fuse_file_passthrough(file->private_data))
+		return fuse_passthrough_fsync(file, start, end, datasync);
+
 	if (fc->no_fsyncdir)
 		return 0;
 
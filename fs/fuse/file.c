@@ -585,6 +585,10 @@ static int fuse_fsync(struct file *file, loff_t start, loff_t end,
 	if (fuse_is_bad(inode))
 		return -EIO;
 
+	/* No page cache in passthrough io mode, the data is all in the backing file */
+	if (fuse_file_passthrough(file->private_data))
+		return fuse_passthrough_fsync(file, start, end, datasync);
+
 	inode_lock(inode);
 
 	/*
@@ -747,7 +751,7 @@ static struct fuse_io_args *fuse_io_alloc(struct fuse_io_priv *io,
 
 static void fuse_io_free(struct fuse_io_args *ia)
 {
-	kfree(ia->ap.pages);
+	kvfree(ia->ap.pages);
 	kfree(ia);
 }
 
@@ -1310,7 +1314,7 @@ static ssize_t fuse_perform_write(struct kiocb *iocb, struct iov_iter *ii)
 					err = -EIO;
 			}
 		}
-		kfree(ap->pages);
+		kvfree(ap->pages);
 	} while (!err && iov_iter_count(ii));
 
 	fuse_write_update_attr(inode, pos, res);
@@ -1789,7 +1793,7 @@ static void fuse_writepage_free(struct fuse_writepage_args *wpa)
 
 	fuse_file_put(wpa->ia.ff, false);
 
-	kfree(ap->pages);
+	kvfree(ap->pages);
 	kfree(wpa);
 }
 
@@ -2189,7 +2193,7 @@ static bool fuse_pages_realloc(struct fuse_fill_wb_data *data)
 
 	memcpy(pages, ap->pages, sizeof(struct page *) * ap->num_pages);
 	memcpy(descs, ap->descs, sizeof(struct fuse_page_desc) * ap->num_pages);
-	kfree(ap->pages);
+	kvfree(ap->pages);
 	ap->pages = pages;
 	ap->descs = descs;
 	data->max_pages = npages;
@@ -2399,9 +2403,9 @@ static int fuse_writepages(struct address_space *mapping,
 	data.ff = NULL;
 
 	err = -ENOMEM;
-	data.orig_pages = kcalloc(fc->max_pages,
-				  sizeof(struct page *),
-				  GFP_NOFS);
+	data.orig_pages = kvcalloc(fc->max_pages,
+				   sizeof(struct page *),
+				   GFP_NOFS);
 	if (!data.orig_pages)
 		goto out;
 
@@ -2413,7 +2417,7 @@ static int fuse_writepages(struct address_space *mapping,
 	if (data.ff)
 		fuse_file_put(data.ff, false);
 
-	kfree(data.orig_pages);
+	kvfree(data.orig_pages);
 out:
 	return err;
 }
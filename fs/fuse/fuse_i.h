@@ -36,7 +36,10 @@
 #define FUSE_DEFAULT_MAX_PAGES_PER_REQ 32
 
 /** Maximum of max_pages received in init_out */
-#define FUSE_MAX_MAX_PAGES 256
+#define FUSE_MAX_MAX_PAGES U16_MAX
+
+/** Default limit on max_pages, see the max_pages_limit module parameter */
+#define FUSE_DEFAULT_MAX_PAGES_LIMIT 256
 
 /** Bias for fi->writectr, meaning new writepages must not be sent */
 #define FUSE_NOWRITE INT_MIN
@@ -56,6 +59,7 @@ extern struct mutex fuse_mutex;
 /** Module parameters */
 extern unsigned max_user_bgreq;
 extern unsigned max_user_congthresh;
+extern unsigned int fuse_max_pages_limit;
 
 /* One forget request */
 struct fuse_forget_link {
@@ -81,6 +85,9 @@ struct fuse_backing {
 	struct file *file;
 	struct cred *cred;
 
+	/** FUSE_BACKING_* flags */
+	unsigned int flags;
+
 	/** refcount */
 	refcount_t count;
 	struct rcu_head rcu;
@@ -528,6 +535,56 @@ struct fuse_pqueue {
 	struct list_head io;
 };
 
+/** Limit on the pages of a shared ring, control page included */
+#define FUSE_RING_MAX_PAGES 8192
+
+/**
+ * Shared request/reply ring of a fuse device, see dev_ring.c
+ */
+struct fuse_ring {
+	/** Serializes posting requests */
+	spinlock_t lock;
+
+	/** Serializes completing replies */
+	struct mutex reply_mutex;
+
+	/** The daemon waits for requests on this */
+	wait_queue_head_t waitq;
+
+	/** Device whose processing queue ring requests go to */
+	struct fuse_dev *fud;
+
+	/** CPU whose requests are posted to this ring */
+	unsigned int cpu;
+
+	/** Number of slots in each direction, a power of two */
+	unsigned int nr_entries;
+
+	/** Size of a slot, a multiple of PAGE_SIZE */
+	unsigned int entry_size;
+
+	/** Number of pages and the pages of the mapping */
+	unsigned int nr_pages;
+	struct page **pages;
+
+	/** vmap of all pages, the layout userspace maps */
+	void *base;
+
+	/** Kernel copies of the positions the kernel owns */
+	u32 req_next;
+	u32 reply_next;
+
+	/** Positions in the control page */
+	u32 *req_prod;
+	u32 *req_cons;
+	u32 *reply_prod;
+	u32 *reply_cons;
+
+	/** Slot page vectors of the request producer and reply consumer */
+	struct bio_vec *req_bvec;
+	struct bio_vec *reply_bvec;
+};
+
 /**
  * Fuse device instance
  */
@@ -540,6 +597,9 @@ struct fuse_dev {
 
 	/** list entry on fc->devices */
 	struct list_head entry;
+
+	/** Shared ring, set once under fc->lock */
+	struct fuse_ring *ring;
 };
 
 enum fuse_dax_mode {
@@ -636,6 +696,9 @@ struct fuse_conn {
 	/** Input queue */
 	struct fuse_iqueue iq;
 
+	/** Shared rings of the fuse devices, indexed by CPU */
+	struct fuse_ring __rcu **rings;
+
 	/** The next unique kernel file handle */
 	atomic64_t khctr;
 
@@ -1006,8 +1069,9 @@ static inline struct page **fuse_pages_alloc(unsigned int npages, gfp_t flags,
 {
 	struct page **pages;
 
-	pages = kzalloc(npages * (sizeof(struct page *) +
-				  sizeof(struct fuse_page_desc)), flags);
+	/* Requests of more than a few hundred pages need a large array */
+	pages = kvzalloc(npages * (sizeof(struct page *) +
+				   sizeof(struct fuse_page_desc)), flags);
 	*desc = (void *) (pages + npages);
 
 	return pages;
@@ -1225,6 +1289,14 @@ struct fuse_dev *fuse_dev_alloc_install(struct fuse_conn *fc);
 struct fuse_dev *fuse_dev_alloc(void);
 void fuse_dev_install(struct fuse_dev *fud, struct fuse_conn *fc);
 void fuse_dev_free(struct fuse_dev *fud);
+
+/* dev_ring.c */
+struct fuse_ring *fuse_ring_alloc(const struct fuse_ring_setup *setup);
+void fuse_ring_free(struct fuse_ring *ring);
+int fuse_ring_mmap(struct fuse_ring *ring, struct vm_area_struct *vma);
+void fuse_ring_iter(struct fuse_ring *ring, bool reply, u32 pos, size_t len,
+		    struct iov_iter *iter);
+void *fuse_ring_slot(struct fuse_ring *ring, bool reply, u32 pos);
 void fuse_send_init(struct fuse_mount *fm);
 
 /**
@@ -1485,5 +1557,11 @@ ssize_t fuse_passthrough_splice_write(struct pipe_inode_info *pipe,
 				      struct file *out, loff_t *ppos,
 				      size_t len, unsigned int flags);
 ssize_t fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+int fuse_passthrough_fsync(struct file *file, loff_t start, loff_t end,
+			   int datasync);
+int fuse_passthrough_opendir(struct inode *inode, struct file *file);
+int fuse_passthrough_getattr(struct inode *inode, struct fuse_backing *fb,
+			     struct kstat *stat, u32 request_mask,
+			     unsigned int flags);
 
 #endif /* _FS_FUSE_I_H */
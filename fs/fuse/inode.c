@@ -51,6 +51,19 @@ MODULE_PARM_DESC(max_user_congthresh,
  "Global limit for the maximum congestion threshold an "
  "unprivileged user can set");
 
+static int set_max_pages_limit(const char *val, const struct kernel_param *kp)
+{
+	return param_set_uint_minmax(val, kp, 1, FUSE_MAX_MAX_PAGES);
+}
+
+unsigned int fuse_max_pages_limit = FUSE_DEFAULT_MAX_PAGES_LIMIT;
+module_param_call(max_pages_limit, set_max_pages_limit, param_get_uint,
+		  &fuse_max_pages_limit, 0644);
+__MODULE_PARM_TYPE(max_pages_limit, "uint");
+MODULE_PARM_DESC(max_pages_limit,
+ "Limit for the maximum number of pages of a single request that a "
+ "filesystem can negotiate");
+
 #define FUSE_DEFAULT_BLKSIZE 512
 
 /** Maximum number of outstanding background requests */
@@ -944,7 +957,7 @@ void fuse_conn_init(struct fuse_conn *fc, struct fuse_mount *fm,
 	fc->pid_ns = get_pid_ns(task_active_pid_ns(current));
 	fc->user_ns = get_user_ns(user_ns);
 	fc->max_pages = FUSE_DEFAULT_MAX_PAGES_PER_REQ;
-	fc->max_pages_limit = FUSE_MAX_MAX_PAGES;
+	fc->max_pages_limit = READ_ONCE(fuse_max_pages_limit);
 
 	if (IS_ENABLED(CONFIG_FUSE_PASSTHROUGH))
 		fuse_backing_files_init(fc);
@@ -981,6 +994,7 @@ void fuse_conn_put(struct fuse_conn *fc)
 		}
 		if (IS_ENABLED(CONFIG_FUSE_PASSTHROUGH))
 			fuse_backing_files_free(fc);
+		kfree(fc->rings);
 		call_rcu(&fc->rcu, delayed_release);
 	}
 }
@@ -1362,6 +1376,9 @@ static void process_init_reply(struct fuse_mount *fm, struct fuse_args *args,
 
 		fm->sb->s_bdi->ra_pages =
 				min(fm->sb->s_bdi->ra_pages, ra_pages);
+		/* Let large reads issue readahead as big as a request */
+		fm->sb->s_bdi->io_pages = min_t(unsigned long, fc->max_pages,
+						fc->max_read / PAGE_SIZE);
 		fc->minor = arg->minor;
 		fc->max_write = arg->minor < 5 ? 4096 : arg->max_write;
 		fc->max_write = max_t(unsigned, 4096, fc->max_write);
@@ -140,7 +140,7 @@ static int fuse_setup_enable_verity(unsigned long arg, struct iovec *iov,
 {
 	struct fsverity_enable_arg enable;
 	struct fsverity_enable_arg __user *uarg = (void __user *)arg;
-	const __u32 max_buffer_len = FUSE_MAX_MAX_PAGES * PAGE_SIZE;
+	const __u32 max_buffer_len = FUSE_DEFAULT_MAX_PAGES_LIMIT * PAGE_SIZE;
 
 	if (copy_from_user(&enable, uarg, sizeof(enable)))
 		return -EFAULT;
@@ -402,7 +402,7 @@ long fuse_do_ioctl(struct file *file, unsigned int cmd, unsigned long arg,
 	free_page((unsigned long) iov_page);
 	while (ap.num_pages)
 		__free_page(ap.pages[--ap.num_pages]);
-	kfree(ap.pages);
+	kvfree(ap.pages);
 
 	return err ? err : outarg.result;
 }
@@ -140,6 +140,80 @@ ssize_t fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
 	return backing_file_mmap(backing_file, vma, &ctx);
 }
 
+int fuse_passthrough_fsync(struct file *file, loff_t start, loff_t end,
+			   int datasync)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *backing_file = fuse_file_passthrough(ff);
+	const struct cred *old_cred;
+	int ret;
+
+	pr_debug("%s: backing_file=0x%p, start=%lld, end=%lld\n", __func__,
+		 backing_file, start, end);
+
+	old_cred = override_creds(ff->cred);
+	ret = vfs_fsync_range(backing_file, start, end, datasync);
+	revert_creds(old_cred);
+
+	return ret;
+}
+
+/*
+ * Setup fsyncdir passthrough to a backing directory.
+ *
+ * readdir still goes to the server: the entries of the backing directory
+ * carry its inode numbers, not those of the fuse inodes.
+ *
+ * A directory has no io mode, so unlike for regular files the fuse inode
+ * keeps no reference to the backing object.
+ */
+int fuse_passthrough_opendir(struct inode *inode, struct file *file)
+{
+	struct fuse_file *ff = file->private_data;
+	struct fuse_conn *fc = ff->fm->fc;
+	struct fuse_backing *fb;
+
+	if (!fc->passthrough || !ff->args)
+		return -EINVAL;
+
+	fb = fuse_passthrough_open(file, inode,
+				   ff->args->open_outarg.backing_id);
+	if (IS_ERR(fb))
+		return PTR_ERR(fb);
+	fuse_backing_put(fb);
+
+	if (!S_ISDIR(file_inode(ff->passthrough)->i_mode)) {
+		fuse_passthrough_release(ff, NULL);
+		return -ENOTDIR;
+	}
+
+	return 0;
+}
+
+/*
+ * Answer getattr from a backing file marked with FUSE_BACKING_ATTR.  The
+ * inode number and device stay those of the fuse inode.
+ */
+int fuse_passthrough_getattr(struct inode *inode, struct fuse_backing *fb,
+			     struct kstat *stat, u32 request_mask,
+			     unsigned int flags)
+{
+	struct fuse_inode *fi = get_fuse_inode(inode);
+	const struct cred *old_cred;
+	int err;
+
+	old_cred = override_creds(fb->cred);
+	err = vfs_getattr(&fb->file->f_path, stat, request_mask, flags);
+	revert_creds(old_cred);
+	if (err)
+		return err;
+
+	stat->dev = inode->i_sb->s_dev;
+	stat->ino = fi->orig_ino;
+
+	return 0;
+}
+
 struct fuse_backing *fuse_backing_get(struct fuse_backing *fb)
 {
 	if (fb && refcount_inc_not_zero(&fb->count))
@@ -225,7 +299,7 @@ int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
 		goto out;
 
 	res = -EINVAL;
-	if (map->flags || map->padding)
+	if ((map->flags & ~FUSE_BACKING_ATTR) || map->padding)
 		goto out;
 
 	file = fget_raw(map->fd);
@@ -245,6 +319,7 @@ int fuse_backing_open(struct fuse_conn *fc, struct fuse_backing_map *map)
 
 	fb->file = file;
 	fb->cred = prepare_creds();
+	fb->flags = map->flags;
 	refcount_set(&fb->count, 1);
 
 	res = fuse_backing_id_alloc(fc, fb);
@@ -704,6 +704,28 @@ static int __iomap_write_begin(const struct iomap_iter *iter, loff_t pos,
 	    pos + len >= folio_pos(folio) + folio_size(folio))
 		return 0;
 
+	if (!(iter->flags & IOMAP_UNSHARE) && !folio->private) {
+		/*
+		 * A dirty folio without per-block state is dirty as a whole,
+		 * so a write into it can't dirty anything more.  This is the
+		 * common case for the tail folio of sequential writes.
+		 */
+		if (folio_test_uptodate(folio) && folio_test_dirty(folio))
+			return 0;
+
+		/*
+		 * A write starting a folio that lies entirely beyond EOF only
+		 * leaves blocks past the new EOF uncovered.  Writeback skips
+		 * those, so zeroing them is all the tracking they need, and
+		 * iomap_write_end() marks the whole folio uptodate.
+		 */
+		if (!folio_test_uptodate(folio) && pos == folio_pos(folio) &&
+		    folio_pos(folio) >= i_size_read(iter->inode)) {
+			folio_zero_segment(folio, to, folio_size(folio));
+			return 0;
+		}
+	}
+
 	ifs = ifs_alloc(iter->inode, folio, iter->flags);
 	if ((iter->flags & IOMAP_NOWAIT) && !ifs && nr_blocks > 1)
 		return -EAGAIN;
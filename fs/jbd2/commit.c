@@ -339,6 +339,17 @@ static void jbd2_block_tag_csum_set(journal_t *j, journal_block_tag_t *tag,
 	else
 		tag->t_checksum = cpu_to_be16(csum32);
 }
+
+/* Time in ns since *since, which moves on to now */
+static u64 jbd2_phase_time(ktime_t *since)
+{
+	ktime_t now = ktime_get();
+	u64 delta = ktime_to_ns(ktime_sub(now, *since));
+
+	*since = now;
+	return delta;
+}
+
 /*
  * jbd2_journal_commit_transaction
  *
@@ -356,7 +367,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	int escape;
 	int err;
 	unsigned long long blocknr;
-	ktime_t start_time;
+	ktime_t start_time, phase_time;
 	u64 commit_time;
 	char *tagp = NULL;
 	journal_block_tag_t *tag = NULL;
@@ -567,6 +578,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 					       stats.run.rs_logging);
 	stats.run.rs_blocks = commit_transaction->t_nr_buffers;
 	stats.run.rs_blocks_logged = 0;
+	phase_time = ktime_get();
 
 	J_ASSERT(commit_transaction->t_nr_buffers <=
 		 atomic_read(&commit_transaction->t_outstanding_credits));
@@ -739,6 +751,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		}
 	}
 
+	stats.run.rs_log_submit = jbd2_phase_time(&phase_time);
+
 	err = journal_finish_inode_data_buffers(journal, commit_transaction);
 	if (err) {
 		printk(KERN_WARNING
@@ -877,6 +891,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	commit_transaction->t_state = T_COMMIT_JFLUSH;
 	write_unlock(&journal->j_state_lock);
 
+	stats.run.rs_log_wait = jbd2_phase_time(&phase_time);
 	if (!jbd2_has_feature_async_commit(journal)) {
 		err = journal_submit_commit_record(journal, commit_transaction,
 						&cbh, crc32_sum);
@@ -890,6 +905,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	    journal->j_flags & JBD2_BARRIER) {
 		blkdev_issue_flush(journal->j_dev);
 	}
+	stats.run.rs_commit_record = jbd2_phase_time(&phase_time);
 
 	if (err)
 		jbd2_journal_abort(journal, err);
@@ -1094,6 +1110,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	commit_transaction->t_start = jiffies;
 	stats.run.rs_logging = jbd2_time_diff(stats.run.rs_logging,
 					      commit_transaction->t_start);
+	stats.run.rs_finish = jbd2_phase_time(&phase_time);
 
 	/*
 	 * File the transaction statistics
@@ -1159,6 +1176,10 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	journal->j_stats.run.rs_locked += stats.run.rs_locked;
 	journal->j_stats.run.rs_flushing += stats.run.rs_flushing;
 	journal->j_stats.run.rs_logging += stats.run.rs_logging;
+	journal->j_stats.run.rs_log_submit += stats.run.rs_log_submit;
+	journal->j_stats.run.rs_log_wait += stats.run.rs_log_wait;
+	journal->j_stats.run.rs_commit_record += stats.run.rs_commit_record;
+	journal->j_stats.run.rs_finish += stats.run.rs_finish;
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
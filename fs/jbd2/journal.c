@@ -1145,6 +1145,14 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    jiffies_to_msecs(s->stats->run.rs_flushing / s->stats->ts_tid));
 	seq_printf(seq, "  %ums logging transaction\n",
 	    jiffies_to_msecs(s->stats->run.rs_logging / s->stats->ts_tid));
+	seq_printf(seq, "    %lluus submitting log blocks\n",
+	    div64_u64(s->stats->run.rs_log_submit, s->stats->ts_tid * 1000ULL));
+	seq_printf(seq, "    %lluus waiting for data and log blocks\n",
+	    div64_u64(s->stats->run.rs_log_wait, s->stats->ts_tid * 1000ULL));
+	seq_printf(seq, "    %lluus writing commit record\n",
+	    div64_u64(s->stats->run.rs_commit_record, s->stats->ts_tid * 1000ULL));
+	seq_printf(seq, "    %lluus checkpoint processing\n",
+	    div64_u64(s->stats->run.rs_finish, s->stats->ts_tid * 1000ULL));
 	seq_printf(seq, "  %lluus average transaction commit time\n",
 		   div_u64(s->journal->j_average_commit_time, 1000));
 	seq_printf(seq, "  %lu handles per transaction\n",
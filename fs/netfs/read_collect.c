@@ -174,8 +174,15 @@ static bool netfs_consume_read_data(struct netfs_io_subrequest *subreq, bool was
 
 	if (start + avail >= fend) {
 		if (fpos == start) {
-			/* Flush, unlock and mark for caching any folio we've just read. */
+			/* Flush, unlock and mark for caching any folio we've just read.
+			 * This doesn't wait for earlier subrequests, note when
+			 * one of them is still outstanding.
+			 */
 			subreq->consumed = fend - subreq->start;
+			netfs_stat(&netfs_n_rh_unlock);
+			if (data_race(!list_is_first(&subreq->rreq_link,
+						     &rreq->subrequests)))
+				netfs_stat(&netfs_n_rh_unlock_ooo);
 			netfs_unlock_read_folio(subreq, rreq, folioq, slot);
 			folioq_mark2(folioq, slot);
 			if (subreq->consumed >= subreq->len)
@@ -201,6 +208,7 @@ static bool netfs_consume_read_data(struct netfs_io_subrequest *subreq, bool was
 
 			prev = list_prev_entry(subreq, rreq_link);
 			WRITE_ONCE(prev->next_donated, prev->next_donated + excess);
+			netfs_stat(&netfs_n_rh_donate);
 			subreq->start += excess;
 			subreq->len -= excess;
 			subreq->transferred -= excess;
@@ -261,6 +269,7 @@ static bool netfs_consume_read_data(struct netfs_io_subrequest *subreq, bool was
 	    !list_is_first(&subreq->rreq_link, &rreq->subrequests)) {
 		prev = list_prev_entry(subreq, rreq_link);
 		WRITE_ONCE(prev->next_donated, prev->next_donated + subreq->len);
+		netfs_stat(&netfs_n_rh_donate);
 		subreq->start += subreq->len;
 		subreq->len = 0;
 		subreq->transferred = 0;
@@ -276,6 +285,7 @@ static bool netfs_consume_read_data(struct netfs_io_subrequest *subreq, bool was
 	if (!subreq->consumed)
 		excess += prev_donated;
 
+	netfs_stat(&netfs_n_rh_donate);
 	if (list_is_last(&subreq->rreq_link, &rreq->subrequests)) {
 		rreq->prev_donated = excess;
 		trace_netfs_donate(rreq, subreq, NULL, excess,
@@ -28,6 +28,9 @@ atomic_t netfs_n_rh_write_begin;
 atomic_t netfs_n_rh_write_done;
 atomic_t netfs_n_rh_write_failed;
 atomic_t netfs_n_rh_write_zskip;
+atomic_t netfs_n_rh_unlock;
+atomic_t netfs_n_rh_unlock_ooo;
+atomic_t netfs_n_rh_donate;
 atomic_t netfs_n_wh_buffered_write;
 atomic_t netfs_n_wh_writethrough;
 atomic_t netfs_n_wh_dio_write;
@@ -67,6 +70,10 @@ int netfs_stats_show(struct seq_file *m, void *v)
 		   atomic_read(&netfs_n_rh_download_done),
 		   atomic_read(&netfs_n_rh_download_failed),
 		   atomic_read(&netfs_n_rh_download_instead));
+	seq_printf(m, "RdColl : ul=%u ooo=%u dn=%u\n",
+		   atomic_read(&netfs_n_rh_unlock),
+		   atomic_read(&netfs_n_rh_unlock_ooo),
+		   atomic_read(&netfs_n_rh_donate));
 	seq_printf(m, "CaRdOps: RD=%u rs=%u rf=%u\n",
 		   atomic_read(&netfs_n_rh_read),
 		   atomic_read(&netfs_n_rh_read_done),
@@ -1061,6 +1061,12 @@ struct dentry *ovl_lookup(struct inode *dir, struct dentry *dentry,
 	if (dentry->d_name.len > ofs->namelen)
 		return ERR_PTR(-ENAMETOOLONG);
 
+	/* Not in any layer according to the last readdir of the parent */
+	if (ovl_dir_cache_miss(dir, &dentry->d_name)) {
+		ovl_dentry_init_reval(dentry, NULL, NULL);
+		return d_splice_alias(NULL, dentry);
+	}
+
 	old_cred = ovl_override_creds(dentry->d_sb);
 	upperdir = ovl_dentry_upper(dentry->d_parent);
 	if (upperdir) {
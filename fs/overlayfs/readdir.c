@@ -15,6 +15,11 @@
 #include <linux/ratelimit.h>
 #include "overlayfs.h"
 
+static bool ovl_dir_lookup_cache;
+module_param_named(dir_lookup_cache, ovl_dir_lookup_cache, bool, 0644);
+MODULE_PARM_DESC(dir_lookup_cache,
+		 "Keep merge dir entries after readdir to answer negative lookups");
+
 struct ovl_cache_entry {
 	unsigned int len;
 	unsigned int type;
@@ -32,6 +37,8 @@ struct ovl_cache_entry {
 struct ovl_dir_cache {
 	long refcount;
 	u64 version;
+	/* entries of all layers, not just the impure ones */
+	bool merged;
 	struct list_head entries;
 	struct rb_root root;
 };
@@ -202,17 +209,23 @@ static bool ovl_fill_lowest(struct ovl_readdir_data *rdd,
 			   const char *name, int namelen,
 			   loff_t offset, u64 ino, unsigned int d_type)
 {
+	struct rb_node **newp = &rdd->root->rb_node;
+	struct rb_node *parent = NULL;
 	struct ovl_cache_entry *p;
 
-	p = ovl_cache_entry_find(rdd->root, name, namelen);
-	if (p) {
+	if (ovl_cache_entry_find_link(name, namelen, &newp, &parent)) {
+		p = ovl_cache_entry_from_node(*newp);
 		list_move_tail(&p->l_node, &rdd->middle);
 	} else {
 		p = ovl_cache_entry_new(rdd, name, namelen, ino, d_type);
-		if (p == NULL)
+		if (p == NULL) {
 			rdd->err = -ENOMEM;
-		else
+		} else {
 			list_add_tail(&p->l_node, &rdd->middle);
+			/* Names of all layers, for ovl_dir_cache_miss() */
+			rb_link_node(&p->node, parent, newp);
+			rb_insert_color(&p->node, rdd->root);
+		}
 	}
 
 	return rdd->err == 0;
@@ -246,8 +259,13 @@ static void ovl_cache_put(struct ovl_dir_file *od, struct inode *inode)
 	WARN_ON(cache->refcount <= 0);
 	cache->refcount--;
 	if (!cache->refcount) {
-		if (ovl_dir_cache(inode) == cache)
+		if (ovl_dir_cache(inode) == cache) {
+			/* Keep it around for ovl_dir_cache_miss() */
+			if (ovl_dir_lookup_cache &&
+			    ovl_inode_version_get(inode) == cache->version)
+				return;
 			ovl_set_dir_cache(inode, NULL);
+		}
 
 		ovl_cache_free(&cache->entries);
 		kfree(cache);
@@ -405,10 +423,12 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 
 	cache = ovl_dir_cache(inode);
 	if (cache && ovl_inode_version_get(inode) == cache->version) {
-		WARN_ON(!cache->refcount);
 		cache->refcount++;
 		return cache;
 	}
+	/* A stale cache kept for lookups is not owned by any open file */
+	if (cache && !cache->refcount)
+		ovl_dir_cache_free(inode);
 	ovl_set_dir_cache(d_inode(dentry), NULL);
 
 	cache = kzalloc(sizeof(struct ovl_dir_cache), GFP_KERNEL);
@@ -427,11 +447,33 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 	}
 
 	cache->version = ovl_inode_version_get(inode);
+	cache->merged = true;
 	ovl_set_dir_cache(inode, cache);
 
 	return cache;
 }
 
+/**
+ * ovl_dir_cache_miss - whether cached entries of a merge dir rule out a name
+ * @dir: the merge dir, locked
+ * @name: the name to look up
+ *
+ * With dir_lookup_cache, the merged entries of the last readdir stay on the
+ * inode until the dir is modified, and ovl_lookup() can return a negative
+ * dentry for a name that is in none of the layers without probing each of
+ * them.  Whiteouts are among the cached names, so they are never ruled out.
+ */
+bool ovl_dir_cache_miss(struct inode *dir, const struct qstr *name)
+{
+	struct ovl_dir_cache *cache = ovl_dir_cache(dir);
+
+	if (!cache || !cache->merged ||
+	    ovl_inode_version_get(dir) != cache->version)
+		return false;
+
+	return !ovl_cache_entry_find(&cache->root, name->name, name->len);
+}
+
 /* Map inode number to lower fs unique range */
 static u64 ovl_remap_lower_ino(u64 ino, int xinobits, int fsid,
 			       const char *name, int namelen, bool warn)
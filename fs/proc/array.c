@@ -92,6 +92,7 @@
 #include <linux/fs_struct.h>
 #include <linux/kthread.h>
 #include <linux/mmu_context.h>
+#include <linux/proc_task_stat.h>
 
 #include <asm/processor.h>
 #include "internal.h"
@@ -680,6 +681,86 @@ int proc_tgid_stat(struct seq_file *m, struct pid_namespace *ns,
 	return do_task_stat(m, ns, pid, task, 1);
 }
 
+/**
+ * proc_task_stat_fill - fill in a /proc/task_stat record of a thread group
+ * @ns: pid namespace of the reader
+ * @task: the group leader
+ * @st: the record
+ *
+ * The same numbers as /proc/<pid>/stat, without the fields that need
+ * ptrace access there.  The I/O accounting fields are left to the caller.
+ */
+void proc_task_stat_fill(struct pid_namespace *ns, struct task_struct *task,
+			 struct proc_task_stat *st)
+{
+	struct signal_struct *sig = task->signal;
+	unsigned long min_flt, maj_flt, nvcsw, nivcsw;
+	u64 cutime, cstime, utime, stime;
+	unsigned int seq = 1;
+	struct mm_struct *mm;
+	struct task_struct *t;
+	unsigned long flags;
+
+	memset(st, 0, sizeof(*st));
+	st->size = sizeof(*st);
+	st->version = PROC_TASK_STAT_VERSION;
+	st->pid = task_tgid_nr_ns(task, ns);
+	st->state = task_state_index(task);
+	st->task_flags = task->flags;
+	st->prio = task_prio(task);
+	st->nice = task_nice(task);
+	__get_task_comm(st->comm, sizeof(st->comm), task);
+	st->start_time = timens_add_boottime_ns(task->start_boottime);
+
+	mm = get_task_mm(task);
+	if (mm) {
+		st->vsize = task_vsize(mm);
+		st->rss = get_mm_rss(mm);
+		mmput(mm);
+	}
+
+	if (lock_task_sighand(task, &flags)) {
+		st->num_threads = get_nr_threads(task);
+		st->sid = task_session_nr_ns(task, ns);
+		st->ppid = task_tgid_nr_ns(task->real_parent, ns);
+		st->pgid = task_pgrp_nr_ns(task, ns);
+		unlock_task_sighand(task, &flags);
+	}
+
+	do {
+		seq++; /* 2 on the 1st/lockless path, otherwise odd */
+		flags = read_seqbegin_or_lock_irqsave(&sig->stats_lock, &seq);
+
+		cutime = sig->cutime;
+		cstime = sig->cstime;
+		min_flt = sig->min_flt;
+		maj_flt = sig->maj_flt;
+		nvcsw = sig->nvcsw;
+		nivcsw = sig->nivcsw;
+
+		rcu_read_lock();
+		__for_each_thread(sig, t) {
+			min_flt += t->min_flt;
+			maj_flt += t->maj_flt;
+			nvcsw += t->nvcsw;
+			nivcsw += t->nivcsw;
+		}
+		rcu_read_unlock();
+	} while (need_seqretry(&sig->stats_lock, seq));
+	done_seqretry_irqrestore(&sig->stats_lock, seq, flags);
+
+	thread_group_cputime_adjusted(task, &utime, &stime);
+
+	st->utime = utime;
+	st->stime = stime;
+	st->cutime = cutime;
+	st->cstime = cstime;
+	st->min_flt = min_flt;
+	st->maj_flt = maj_flt;
+	st->nvcsw = nvcsw;
+	st->nivcsw = nivcsw;
+}
+
 int proc_pid_statm(struct seq_file *m, struct pid_namespace *ns,
 			struct pid *pid, struct task_struct *task)
 {
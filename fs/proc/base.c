@@ -743,9 +743,9 @@ int proc_setattr(struct mnt_idmap *idmap, struct dentry *dentry,
  * May current process learn task's sched/cmdline info (for hide_pid_min=1)
  * or euid/egid (for hide_pid_min=2)?
  */
-static bool has_pid_permissions(struct proc_fs_info *fs_info,
-				 struct task_struct *task,
-				 enum proc_hidepid hide_pid_min)
+bool has_pid_permissions(struct proc_fs_info *fs_info,
+			 struct task_struct *task,
+			 enum proc_hidepid hide_pid_min)
 {
 	/*
 	 * If 'hidpid' mount option is set force a ptrace check,
@@ -3027,6 +3027,29 @@ static const struct file_operations proc_coredump_filter_operations = {
 #endif
 
 #ifdef CONFIG_TASK_IO_ACCOUNTING
+/* Sum of the I/O accounting of a thread group, dead threads included */
+void proc_tgid_io_accounting(struct task_struct *task,
+			     struct task_io_accounting *acct)
+{
+	struct signal_struct *sig = task->signal;
+	struct task_struct *t;
+	unsigned int seq = 1;
+	unsigned long flags;
+
+	rcu_read_lock();
+	do {
+		seq++; /* 2 on the 1st/lockless path, otherwise odd */
+		flags = read_seqbegin_or_lock_irqsave(&sig->stats_lock, &seq);
+
+		*acct = sig->ioac;
+		__for_each_thread(sig, t)
+			task_io_accounting_add(acct, &t->ioac);
+
+	} while (need_seqretry(&sig->stats_lock, seq));
+	done_seqretry_irqrestore(&sig->stats_lock, seq, flags);
+	rcu_read_unlock();
+}
+
 static int do_io_accounting(struct task_struct *task, struct seq_file *m, int whole)
 {
 	struct task_io_accounting acct;
@@ -3041,27 +3064,10 @@ static int do_io_accounting(struct task_struct *task, struct seq_file *m, int wh
 		goto out_unlock;
 	}
 
-	if (whole) {
-		struct signal_struct *sig = task->signal;
-		struct task_struct *t;
-		unsigned int seq = 1;
-		unsigned long flags;
-
-		rcu_read_lock();
-		do {
-			seq++; /* 2 on the 1st/lockless path, otherwise odd */
-			flags = read_seqbegin_or_lock_irqsave(&sig->stats_lock, &seq);
-
-			acct = sig->ioac;
-			__for_each_thread(sig, t)
-				task_io_accounting_add(&acct, &t->ioac);
-
-		} while (need_seqretry(&sig->stats_lock, seq));
-		done_seqretry_irqrestore(&sig->stats_lock, seq, flags);
-		rcu_read_unlock();
-	} else {
+	if (whole)
+		proc_tgid_io_accounting(task, &acct);
+	else
 		acct = task->ioac;
-	}
 
 	seq_printf(m,
 		   "rchar: %llu\n"
@@ -3348,6 +3354,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
 	REG("smaps",      S_IRUGO, proc_pid_smaps_operations),
 	REG("smaps_rollup", S_IRUGO, proc_pid_smaps_rollup_operations),
+	REG("smaps_rollup_approx", S_IRUGO, proc_pid_smaps_rollup_approx_operations),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
 #endif
 #ifdef CONFIG_SECURITY
@@ -3537,11 +3544,7 @@ struct dentry *proc_pid_lookup(struct dentry *dentry, unsigned int flags)
  * Find the first task with tgid >= tgid
  *
  */
-struct tgid_iter {
-	unsigned int tgid;
-	struct task_struct *task;
-};
-static struct tgid_iter next_tgid(struct pid_namespace *ns, struct tgid_iter iter)
+struct tgid_iter next_tgid(struct pid_namespace *ns, struct tgid_iter iter)
 {
 	struct pid *pid;
 
@@ -3713,6 +3716,7 @@ static const struct pid_entry tid_base_stuff[] = {
 	REG("clear_refs", S_IWUSR, proc_clear_refs_operations),
 	REG("smaps",     S_IRUGO, proc_pid_smaps_operations),
 	REG("smaps_rollup", S_IRUGO, proc_pid_smaps_rollup_operations),
+	REG("smaps_rollup_approx", S_IRUGO, proc_pid_smaps_rollup_approx_operations),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
 #endif
 #ifdef CONFIG_SECURITY
@@ -189,6 +189,9 @@ extern int proc_pid_status(struct seq_file *, struct pid_namespace *,
 			   struct pid *, struct task_struct *);
 extern int proc_pid_statm(struct seq_file *, struct pid_namespace *,
 			  struct pid *, struct task_struct *);
+struct proc_task_stat;
+extern void proc_task_stat_fill(struct pid_namespace *, struct task_struct *,
+				struct proc_task_stat *);
 
 /*
  * base.c
@@ -203,6 +206,16 @@ extern struct inode *proc_pid_make_inode(struct super_block *, struct task_struc
 extern void pid_update_inode(struct task_struct *, struct inode *);
 extern int pid_delete_dentry(const struct dentry *);
 extern int proc_pid_readdir(struct file *, struct dir_context *);
+struct tgid_iter {
+	unsigned int tgid;
+	struct task_struct *task;
+};
+extern struct tgid_iter next_tgid(struct pid_namespace *, struct tgid_iter);
+extern bool has_pid_permissions(struct proc_fs_info *, struct task_struct *,
+				enum proc_hidepid);
+struct task_io_accounting;
+extern void proc_tgid_io_accounting(struct task_struct *,
+				    struct task_io_accounting *);
 struct dentry *proc_pid_lookup(struct dentry *, unsigned int);
 extern loff_t mem_lseek(struct file *, loff_t, int);
 
@@ -333,6 +346,7 @@ extern const struct file_operations proc_pid_maps_operations;
 extern const struct file_operations proc_pid_numa_maps_operations;
 extern const struct file_operations proc_pid_smaps_operations;
 extern const struct file_operations proc_pid_smaps_rollup_operations;
+extern const struct file_operations proc_pid_smaps_rollup_approx_operations;
 extern const struct file_operations proc_clear_refs_operations;
 extern const struct file_operations proc_pagemap_operations;
 
@@ -1283,6 +1283,57 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 
 	return ret;
 }
+
+/*
+ * The rollup of the page counts that the mm keeps up to date already, for
+ * readers that poll large processes often and can do without Pss and the
+ * clean/dirty split.  No page tables are walked, so a read costs the same
+ * whatever the size of the mm.  The counters are per-CPU and may be off by
+ * a batch per CPU, the precise numbers are in smaps_rollup.
+ */
+static int show_smaps_rollup_approx(struct seq_file *m, void *v)
+{
+	struct proc_maps_private *priv = m->private;
+	struct mm_struct *mm = priv->mm;
+	unsigned long anon, file, shmem, swap;
+	unsigned long start = 0, end = 0;
+	struct vm_area_struct *vma, *prev;
+	int ret;
+
+	if (!mm || !mmget_not_zero(mm))
+		return -ESRCH;
+
+	ret = mmap_read_lock_killable(mm);
+	if (ret)
+		goto out_put_mm;
+	vma = find_vma(mm, 0);
+	if (vma) {
+		start = vma->vm_start;
+		find_vma_prev(mm, ULONG_MAX, &prev);
+		end = prev->vm_end;
+	}
+	mmap_read_unlock(mm);
+
+	anon = get_mm_counter(mm, MM_ANONPAGES);
+	file = get_mm_counter(mm, MM_FILEPAGES);
+	shmem = get_mm_counter(mm, MM_SHMEMPAGES);
+	swap = get_mm_counter(mm, MM_SWAPENTS);
+
+	show_vma_header_prefix(m, start, end, 0, 0, 0, 0);
+	seq_pad(m, ' ');
+	seq_puts(m, "[rollup]\n");
+
+	SEQ_PUT_DEC("Rss:            ", (anon + file + shmem) << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nRss_Anon:       ", anon << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nRss_File:       ", file << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nRss_Shmem:      ", shmem << PAGE_SHIFT);
+	SEQ_PUT_DEC(" kB\nSwap:           ", swap << PAGE_SHIFT);
+	seq_puts(m, " kB\n");
+
+out_put_mm:
+	mmput(mm);
+	return ret;
+}
 #undef SEQ_PUT_DEC
 
 static const struct seq_operations proc_pid_smaps_op = {
@@ -1297,7 +1348,8 @@ static int pid_smaps_open(struct inode *inode, struct file *file)
 	return do_maps_open(inode, file, &proc_pid_smaps_op);
 }
 
-static int smaps_rollup_open(struct inode *inode, struct file *file)
+static int __smaps_rollup_open(struct inode *inode, struct file *file,
+			       int (*show)(struct seq_file *, void *))
 {
 	int ret;
 	struct proc_maps_private *priv;
@@ -1306,7 +1358,7 @@ static int smaps_rollup_open(struct inode *inode, struct file *file)
 	if (!priv)
 		return -ENOMEM;
 
-	ret = single_open(file, show_smaps_rollup, priv);
+	ret = single_open(file, show, priv);
 	if (ret)
 		goto out_free;
 
@@ -1326,6 +1378,16 @@ static int smaps_rollup_open(struct inode *inode, struct file *file)
 	return ret;
 }
 
+static int smaps_rollup_open(struct inode *inode, struct file *file)
+{
+	return __smaps_rollup_open(inode, file, show_smaps_rollup);
+}
+
+static int smaps_rollup_approx_open(struct inode *inode, struct file *file)
+{
+	return __smaps_rollup_open(inode, file, show_smaps_rollup_approx);
+}
+
 static int smaps_rollup_release(struct inode *inode, struct file *file)
 {
 	struct seq_file *seq = file->private_data;
@@ -1352,6 +1414,13 @@ const struct file_operations proc_pid_smaps_rollup_operations = {
 	.release	= smaps_rollup_release,
 };
 
+const struct file_operations proc_pid_smaps_rollup_approx_operations = {
+	.open		= smaps_rollup_approx_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= smaps_rollup_release,
+};
+
 enum clear_refs_types {
 	CLEAR_REFS_ALL = 1,
 	CLEAR_REFS_ANON,
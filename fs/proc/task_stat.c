@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * /proc/task_stat: fixed layout records of many thread groups per read(),
+ * for monitoring agents that would otherwise open, read and parse
+ * /proc/<pid>/stat, status and io of every task.
+ *
+ * The record layout is in <uapi/linux/proc_task_stat.h>.
+ */
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/pid_namespace.h>
+#include <linux/proc_fs.h>
+#include <linux/proc_task_stat.h>
+#include <linux/ptrace.h>
+#include <linux/sched/signal.h>
+#include <linux/sched/task.h>
+#include <linux/task_io_accounting_ops.h>
+#include <linux/uaccess.h>
+#include "internal.h"
+
+static void proc_task_stat_io(struct task_struct *task,
+			      struct proc_task_stat *st)
+{
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+	struct task_io_accounting acct;
+
+	/* Same rules as /proc/<pid>/io, but fields are skipped, not failed */
+	if (down_read_killable(&task->signal->exec_update_lock))
+		return;
+	if (ptrace_may_access(task, PTRACE_MODE_READ_FSCREDS |
+				    PTRACE_MODE_NOAUDIT)) {
+		proc_tgid_io_accounting(task, &acct);
+		st->flags |= PROC_TASK_STAT_IO;
+		st->rchar = acct.rchar;
+		st->wchar = acct.wchar;
+		st->syscr = acct.syscr;
+		st->syscw = acct.syscw;
+		st->read_bytes = acct.read_bytes;
+		st->write_bytes = acct.write_bytes;
+		st->cancelled_write_bytes = acct.cancelled_write_bytes;
+	}
+	up_read(&task->signal->exec_update_lock);
+#endif
+}
+
+static ssize_t proc_task_stat_read(struct file *file, char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct super_block *sb = file_inode(file)->i_sb;
+	struct proc_fs_info *fs_info = proc_sb_info(sb);
+	struct pid_namespace *ns = proc_pid_ns(sb);
+	struct proc_task_stat st;
+	struct tgid_iter iter;
+	ssize_t copied = 0;
+
+	if (count < sizeof(st))
+		return -EINVAL;
+	if (*ppos < 0 || *ppos >= PID_MAX_LIMIT)
+		return 0;
+
+	iter.tgid = *ppos;
+	iter.task = NULL;
+	for (iter = next_tgid(ns, iter);
+	     iter.task;
+	     iter.tgid += 1, iter = next_tgid(ns, iter)) {
+		if (count - copied < sizeof(st)) {
+			put_task_struct(iter.task);
+			return copied;
+		}
+
+		cond_resched();
+		/* Only the tasks whose /proc/<pid>/stat could be opened */
+		if (!has_pid_permissions(fs_info, iter.task, HIDEPID_NO_ACCESS))
+			continue;
+
+		proc_task_stat_fill(ns, iter.task, &st);
+		proc_task_stat_io(iter.task, &st);
+		if (copy_to_user(buf + copied, &st, sizeof(st))) {
+			put_task_struct(iter.task);
+			return copied ?: -EFAULT;
+		}
+		copied += sizeof(st);
+		*ppos = iter.tgid + 1;
+	}
+	*ppos = PID_MAX_LIMIT;
+	return copied;
+}
+
+static const struct proc_ops proc_task_stat_ops = {
+	.proc_flags	= PROC_ENTRY_PERMANENT,
+	.proc_read	= proc_task_stat_read,
+	.proc_lseek	= default_llseek,
+};
+
+static int __init proc_task_stat_init(void)
+{
+	proc_create("task_stat", 0444, NULL, &proc_task_stat_ops);
+	return 0;
+}
+fs_initcall(proc_task_stat_init);
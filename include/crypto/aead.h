@@ -119,6 +119,13 @@ struct aead_request {
  * @setkey: see struct skcipher_alg
  * @encrypt: see struct skcipher_alg
  * @decrypt: see struct skcipher_alg
+ * @encrypt_batch: Optional. Encrypt @n requests of the same transformation
+ *		   and store what @encrypt would have returned for each of them
+ *		   in the matching entry of @errs. Used to amortize per-request
+ *		   setup, such as entering an FPU section, over many small
+ *		   requests. If unset, the requests are passed to @encrypt one
+ *		   by one.
+ * @decrypt_batch: Optional. Same as @encrypt_batch for decryption.
  * @ivsize: see struct skcipher_alg
  * @chunksize: see struct skcipher_alg
  * @init: Initialize the cryptographic transformation object. This function
@@ -134,7 +141,8 @@ struct aead_request {
  *	  @init.
  * @base: Definition of a generic crypto cipher algorithm.
  *
- * All fields except @ivsize is mandatory and must be filled.
+ * All fields except @ivsize, @encrypt_batch and @decrypt_batch are
+ * mandatory and must be filled.
  */
 struct aead_alg {
 	int (*setkey)(struct crypto_aead *tfm, const u8 *key,
@@ -142,6 +150,10 @@ struct aead_alg {
 	int (*setauthsize)(struct crypto_aead *tfm, unsigned int authsize);
 	int (*encrypt)(struct aead_request *req);
 	int (*decrypt)(struct aead_request *req);
+	void (*encrypt_batch)(struct aead_request **reqs, int *errs,
+			      unsigned int n);
+	void (*decrypt_batch)(struct aead_request **reqs, int *errs,
+			      unsigned int n);
 	int (*init)(struct crypto_aead *tfm);
 	void (*exit)(struct crypto_aead *tfm);
 
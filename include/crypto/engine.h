@@ -15,6 +15,7 @@
 #include <linux/types.h>
 
 struct crypto_engine;
+struct crypto_engine_mq;
 struct device;
 
 /*
@@ -79,6 +80,19 @@ struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
 						       int (*cbk_do_batch)(struct crypto_engine *engine),
 						       bool rt, int qlen);
 void crypto_engine_exit(struct crypto_engine *engine);
+unsigned int crypto_engine_hw_queue(struct crypto_engine *engine);
+
+struct crypto_engine_mq *crypto_engine_mq_alloc_init_and_set(struct device *dev,
+							     unsigned int nr_hw_queues,
+							     bool retry_support,
+							     int (*cbk_do_batch)(struct crypto_engine *engine),
+							     bool rt, int qlen);
+int crypto_engine_mq_start(struct crypto_engine_mq *mq);
+int crypto_engine_mq_stop(struct crypto_engine_mq *mq);
+void crypto_engine_mq_exit(struct crypto_engine_mq *mq);
+struct crypto_engine *crypto_engine_mq_get(struct crypto_engine_mq *mq);
+struct crypto_engine *crypto_engine_mq_queue(struct crypto_engine_mq *mq,
+					     unsigned int hw_queue);
 
 int crypto_engine_register_aead(struct aead_engine_alg *alg);
 void crypto_engine_unregister_aead(struct aead_engine_alg *alg);
@@ -164,6 +164,9 @@ struct shash_desc {
  */
 #define HASH_MAX_DESCSIZE	(sizeof(struct shash_desc) + 360)
 
+/* Most messages any ->finup_mb() hashes at once */
+#define HASH_MAX_MB_MSGS	2
+
 #define SHASH_DESC_ON_STACK(shash, ctx)					     \
 	char __##shash##_desc[sizeof(struct shash_desc) + HASH_MAX_DESCSIZE] \
 		__aligned(__alignof__(struct shash_desc));		     \
@@ -175,6 +178,11 @@ struct shash_desc {
  * @update: see struct ahash_alg
  * @final: see struct ahash_alg
  * @finup: see struct ahash_alg
+ * @finup_mb: **[optional]** Finish hashing @num_msgs messages of the same
+ *	      length, each continuing from the state in @desc, which isn't
+ *	      modified.  Called with 2 to @mb_max_msgs messages.  May return
+ *	      -EOPNOTSUPP, e.g. when SIMD can't be used, to have the caller
+ *	      hash the messages one by one.
  * @digest: see struct ahash_alg
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
@@ -194,6 +202,8 @@ struct shash_desc {
  * @descsize: Size of the operational state for the message digest. This state
  * 	      size is the memory size that needs to be allocated for
  *	      shash_desc.__ctx
+ * @mb_max_msgs: Most messages @finup_mb can hash at once, at most
+ *		 HASH_MAX_MB_MSGS.  1 if @finup_mb isn't implemented.
  * @halg: see struct hash_alg_common
  * @HASH_ALG_COMMON: see struct hash_alg_common
  */
@@ -204,6 +214,9 @@ struct shash_alg {
 	int (*final)(struct shash_desc *desc, u8 *out);
 	int (*finup)(struct shash_desc *desc, const u8 *data,
 		     unsigned int len, u8 *out);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 	int (*digest)(struct shash_desc *desc, const u8 *data,
 		      unsigned int len, u8 *out);
 	int (*export)(struct shash_desc *desc, void *out);
@@ -215,6 +228,7 @@ struct shash_alg {
 	int (*clone_tfm)(struct crypto_shash *dst, struct crypto_shash *src);
 
 	unsigned int descsize;
+	unsigned int mb_max_msgs;
 
 	union {
 		struct HASH_ALG_COMMON;
@@ -792,6 +806,18 @@ static inline void *shash_desc_ctx(struct shash_desc *desc)
 	return desc->__ctx;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain how many messages can be hashed at once
+ * @tfm: cipher handle
+ *
+ * Return: the most messages crypto_shash_finup_mb() hashes in an interleaved
+ *	   fashion, 1 if the algorithm only hashes one message at a time.
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 /**
  * crypto_shash_setkey() - set key for message digest
  * @tfm: cipher handle
@@ -944,6 +970,27 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - finish hashing several messages of the same length
+ * @desc: operational state handle, with the state common to all messages
+ * @data: the data of each message
+ * @len: length of each message in bytes
+ * @outs: output buffer of each message digest
+ * @num_msgs: number of messages, 1 to crypto_shash_mb_max_msgs()
+ *
+ * Calculate the digests of @num_msgs messages that each start with the data
+ * already hashed into @desc and continue with @len bytes from @data.  This is
+ * equivalent to, but can be faster than, calling crypto_shash_finup() on a
+ * copy of @desc for each message, since the algorithm may interleave them.
+ * @desc is left in an unspecified state.
+ *
+ * Context: Any context.
+ * Return: 0 on success; < 0 if an error occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void shash_desc_zero(struct shash_desc *desc)
 {
 	memzero_explicit(desc,
@@ -164,5 +164,34 @@ void crypto_unregister_aeads(struct aead_alg *algs, int count);
 int aead_register_instance(struct crypto_template *tmpl,
 			   struct aead_instance *inst);
 
+/**
+ * crypto_aead_encrypt_batch() - encrypt several independent requests
+ * @reqs: array of @n aead_request handles, all for the same cipher handle
+ * @errs: array of @n return values, one per request
+ * @n: number of requests
+ *
+ * Same as calling crypto_aead_encrypt() on every request of @reqs and
+ * storing the result in the matching entry of @errs, but lets the
+ * implementation process the requests together, e.g. in a single FPU
+ * section.  Requests for which -EINPROGRESS or -EBUSY is stored complete
+ * through their own completion callback.
+ *
+ * There is no user outside of the crypto API yet, so this is only exported
+ * to the CRYPTO_INTERNAL namespace.
+ */
+void crypto_aead_encrypt_batch(struct aead_request **reqs, int *errs,
+			       unsigned int n);
+
+/**
+ * crypto_aead_decrypt_batch() - decrypt several independent requests
+ * @reqs: array of @n aead_request handles, all for the same cipher handle
+ * @errs: array of @n return values, one per request
+ * @n: number of requests
+ *
+ * Same as crypto_aead_encrypt_batch() for crypto_aead_decrypt().
+ */
+void crypto_aead_decrypt_batch(struct aead_request **reqs, int *errs,
+			       unsigned int n);
+
 #endif	/* _CRYPTO_INTERNAL_AEAD_H */
 
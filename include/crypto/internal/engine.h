@@ -43,6 +43,8 @@ struct device;
  * @pump_requests: work struct for scheduling work to the request pump
  * @priv_data: the engine private data
  * @cur_req: the current request which is on processing
+ * @hw_queue: the hardware queue fed by this engine, 0 unless the engine is
+ * part of a crypto_engine_mq
  */
 struct crypto_engine {
 	char			name[ENGINE_NAME_LEN];
@@ -69,6 +71,21 @@ struct crypto_engine {
 
 	void				*priv_data;
 	struct crypto_async_request	*cur_req;
+
+	unsigned int			hw_queue;
+};
+
+/*
+ * struct crypto_engine_mq - crypto engine with one queue per hardware queue
+ * @nr_hw_queues: number of hardware queues, and of entries in @engines
+ * @cpu_map: the hardware queue fed by requests submitted on each CPU
+ * @engines: one engine, with its own request queue, lock and pump thread,
+ * for each hardware queue
+ */
+struct crypto_engine_mq {
+	unsigned int		nr_hw_queues;
+	unsigned int		*cpu_map;
+	struct crypto_engine	*engines[];
 };
 
 #endif
@@ -0,0 +1,102 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * KUnit benchmark API.
+ *
+ * Time-bounded microbenchmarks which run inside a KUnit test case and
+ * report the cost of an operation as KTAP diagnostics.
+ */
+#ifndef _KUNIT_BENCHMARK_H
+#define _KUNIT_BENCHMARK_H
+
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/types.h>
+
+/**
+ * struct kunit_bench - state of one run of a benchmark function
+ * @iters: number of operations the benchmark function has to perform.
+ *
+ * The remaining fields are private to KUnit.
+ */
+struct kunit_bench {
+	u64 iters;
+
+	/* private: internal use only. */
+	u64 start_ns;
+	u64 elapsed_ns;
+	bool running;
+};
+
+/**
+ * typedef kunit_bench_fn_t - a benchmark function
+ * @test: the test case the benchmark runs in.
+ * @bench: the current run, performs @bench->iters operations.
+ * @ctx: the context passed to kunit_run_bench().
+ *
+ * The function is called several times with different @bench->iters.  It
+ * is timed from start to end, setup it does not want to count can be
+ * bracketed with kunit_bench_stop_timer() and kunit_bench_start_timer().
+ */
+typedef void (*kunit_bench_fn_t)(struct kunit *test, struct kunit_bench *bench,
+				 void *ctx);
+
+/**
+ * struct kunit_bench_result - summary of a benchmark
+ * @runs: number of timed runs.
+ * @iters: operations per run.
+ * @mean_ps: mean cost of one operation in picoseconds.
+ * @stddev_ps: standard deviation between runs, in picoseconds.
+ * @min_ps: cost of one operation in the fastest run.
+ */
+struct kunit_bench_result {
+	unsigned int runs;
+	u64 iters;
+	u64 mean_ps;
+	u64 stddev_ps;
+	u64 min_ps;
+};
+
+static inline void kunit_bench_stop_timer(struct kunit_bench *bench)
+{
+	if (bench->running) {
+		bench->elapsed_ns += ktime_get_ns() - bench->start_ns;
+		bench->running = false;
+	}
+}
+
+static inline void kunit_bench_start_timer(struct kunit_bench *bench)
+{
+	if (!bench->running) {
+		bench->start_ns = ktime_get_ns();
+		bench->running = true;
+	}
+}
+
+/**
+ * kunit_run_bench() - calibrate, run and report a benchmark
+ * @test: the test case the benchmark runs in.
+ * @name: name of the benchmark, unique within @test.
+ * @fn: the benchmark function.
+ * @ctx: passed to @fn.
+ * @result: if not NULL, filled in with the summary.
+ *
+ * Runs @fn for about kunit.bench_time_ms and prints the mean and standard
+ * deviation of the cost of one operation as a diagnostic of @test.  If
+ * kunit.bench_baseline has an entry "<test>.<name>=<ns/op>" and the mean
+ * exceeds it by more than kunit.bench_tolerance percent, @test fails.
+ *
+ * Return: 0, or -ERANGE if the benchmark was over its baseline.
+ */
+int kunit_run_bench(struct kunit *test, const char *name, kunit_bench_fn_t fn,
+		    void *ctx, struct kunit_bench_result *result);
+
+/**
+ * KUNIT_BENCH_CASE - declare a test case which runs benchmarks
+ * @test_name: the test function.
+ *
+ * Benchmark cases take as long as kunit.bench_time_ms per benchmark, so
+ * they are marked slow and can be left out with kunit.filter=speed>slow.
+ */
+#define KUNIT_BENCH_CASE(test_name) KUNIT_CASE_SLOW(test_name)
+
+#endif /* _KUNIT_BENCHMARK_H */
@@ -60,6 +60,8 @@ enum {
 	__RQF_ZONE_WRITE_PLUGGING,
 	/* ->timeout has been called, don't expire again */
 	__RQF_TIMED_OUT,
+	/* already went through the hybrid polling sleep */
+	__RQF_MQ_POLL_SLEPT,
 	__RQF_RESV,
 	__RQF_BITS
 };
@@ -81,6 +83,7 @@ enum {
 #define RQF_ZONE_WRITE_PLUGGING	\
 			((__force req_flags_t)(1 << __RQF_ZONE_WRITE_PLUGGING))
 #define RQF_TIMED_OUT		((__force req_flags_t)(1 << __RQF_TIMED_OUT))
+#define RQF_MQ_POLL_SLEPT	((__force req_flags_t)(1 << __RQF_MQ_POLL_SLEPT))
 #define RQF_RESV		((__force req_flags_t)(1 << __RQF_RESV))
 
 /* flags that prevent us from merging requests: */
@@ -383,6 +386,11 @@ struct blk_mq_hw_ctx {
 	 * Average algorithm.
 	 */
 	unsigned int		dispatch_busy;
+	/**
+	 * @poll_hist: Completion latency histogram of polled requests, used
+	 * to size the sleep of adaptive hybrid polling.
+	 */
+	struct blk_rq_hist	poll_hist;
 
 	/** @type: HCTX_TYPE_* flags. Type of hardware queue. */
 	unsigned short		type;
@@ -765,6 +773,10 @@ struct blk_mq_tags {
 	struct sbitmap_queue bitmap_tags;
 	struct sbitmap_queue breserved_tags;
 
+	/* per-cpu batches of free bitmap_tags, see blk_mq_get_cached_tag() */
+	struct blk_mq_tag_cache __percpu *cache;
+	unsigned int cache_batch;
+
 	struct request **rqs;
 	struct request **static_rqs;
 	struct list_head page_list;
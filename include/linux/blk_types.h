@@ -497,4 +497,12 @@ struct blk_rq_stat {
 	u64 batch;
 };
 
+/* log2 nanosecond buckets, the last one catches everything above ~1s */
+#define BLK_RQ_HIST_BUCKETS	31
+
+struct blk_rq_hist {
+	u32 nr_samples;
+	u32 buckets[BLK_RQ_HIST_BUCKETS];
+};
+
 #endif /* __LINUX_BLK_TYPES_H */
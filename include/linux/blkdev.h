@@ -331,6 +331,12 @@ typedef unsigned int __bitwise blk_features_t;
 #define BLK_FEAT_RAID_PARTIAL_STRIPES_EXPENSIVE \
 	((__force blk_features_t)(1u << 15))
 
+/*
+ * zone writes are executed in the order they are dispatched and never
+ * requeued, so several writes per zone may be in flight
+ */
+#define BLK_FEAT_ORDERED_ZONE_WRITES	((__force blk_features_t)(1u << 16))
+
 /*
  * Flags automatically inherited when stacking limits.
  */
@@ -348,6 +354,9 @@ typedef unsigned int __bitwise blk_flags_t;
 /* I/O topology is misaligned */
 #define BLK_FLAG_MISALIGNED		((__force blk_flags_t)(1u << 1))
 
+/* no limit can split a bvec into several segments */
+#define BLK_FLAG_TRIVIAL_SPLIT		((__force blk_flags_t)(1u << 2))
+
 struct queue_limits {
 	blk_features_t		features;
 	blk_flags_t		flags;
@@ -469,6 +478,9 @@ struct request_queue {
 	unsigned int		nr_hw_queues;
 	struct xarray		hctx_table;
 
+	/* hybrid polling sleep, BLK_MQ_POLL_CLASSIC, 0 (adaptive) or nsecs */
+	int			poll_nsec;
+
 	struct percpu_ref	q_usage_counter;
 	struct lock_class_key	io_lock_cls_key;
 	struct lockdep_map	io_lockdep_map;
@@ -503,6 +515,7 @@ struct request_queue {
 	atomic_t		pm_only;
 
 	struct blk_queue_stats	*stats;
+	struct blk_split_stats __percpu *split_stats;
 	struct rq_qos		*rq_qos;
 	struct mutex		rq_qos_mutex;
 
@@ -610,6 +623,7 @@ enum {
 	QUEUE_FLAG_RQ_ALLOC_TIME,	/* record rq->alloc_time_ns */
 	QUEUE_FLAG_HCTX_ACTIVE,		/* at least one blk-mq hctx is active */
 	QUEUE_FLAG_SQ_SCHED,		/* single queue style io dispatch */
+	QUEUE_FLAG_STAGE_STATS,		/* per-stage latency histograms */
 	QUEUE_FLAG_MAX
 };
 
@@ -641,6 +655,8 @@ void blk_queue_flag_clear(unsigned int flag, struct request_queue *q);
 #define blk_queue_pm_only(q)	atomic_read(&(q)->pm_only)
 #define blk_queue_registered(q)	test_bit(QUEUE_FLAG_REGISTERED, &(q)->queue_flags)
 #define blk_queue_sq_sched(q)	test_bit(QUEUE_FLAG_SQ_SCHED, &(q)->queue_flags)
+#define blk_queue_stage_stats(q)	\
+	test_bit(QUEUE_FLAG_STAGE_STATS, &(q)->queue_flags)
 #define blk_queue_skip_tagset_quiesce(q) \
 	((q)->limits.features & BLK_FEAT_SKIP_TAGSET_QUIESCE)
 
@@ -880,6 +896,8 @@ const char *blk_status_to_str(blk_status_t status);
 
 /* only poll the hardware once, don't continue until a completion was found */
 #define BLK_POLL_ONESHOT		(1 << 0)
+/* io_poll_delay value for spinning without any hybrid sleep */
+#define BLK_MQ_POLL_CLASSIC		-1
 int bio_poll(struct bio *bio, struct io_comp_batch *iob, unsigned int flags);
 int iocb_bio_iopoll(struct kiocb *kiocb, struct io_comp_batch *iob,
 			unsigned int flags);
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_BOOT_TIMES_H
+#define _LINUX_BOOT_TIMES_H
+
+#include <linux/init.h>
+#include <linux/types.h>
+
+/* Level of the initcalls run before SMP bringup, in boot_times_initcall() */
+#define BOOT_TIMES_LEVEL_EARLY	-1
+
+#ifdef CONFIG_BOOT_TIMES
+#include <linux/sched/clock.h>
+
+static inline u64 boot_times_clock(void)
+{
+	return local_clock();
+}
+
+void boot_times_phase(const char *name);
+void boot_times_initcall(initcall_t fn, int level, int ret, u64 start_ns);
+#else
+static inline u64 boot_times_clock(void)
+{
+	return 0;
+}
+
+static inline void boot_times_phase(const char *name) { }
+static inline void boot_times_initcall(initcall_t fn, int level, int ret,
+				       u64 start_ns) { }
+#endif
+
+#endif /* _LINUX_BOOT_TIMES_H */
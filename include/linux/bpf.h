@@ -121,6 +121,8 @@ struct bpf_map_ops {
 	u32 (*map_fd_sys_lookup_elem)(void *ptr);
 	void (*map_seq_show_elem)(struct bpf_map *map, void *key,
 				  struct seq_file *m);
+	/* Map type specific lines of the map fd's fdinfo */
+	void (*map_show_fdinfo)(const struct bpf_map *map, struct seq_file *m);
 	int (*map_check_btf)(const struct bpf_map *map,
 			     const struct btf *btf,
 			     const struct btf_type *key_type,
@@ -1306,6 +1308,10 @@ int bpf_trampoline_link_prog(struct bpf_tramp_link *link,
 int bpf_trampoline_unlink_prog(struct bpf_tramp_link *link,
 			       struct bpf_trampoline *tr,
 			       struct bpf_prog *tgt_prog);
+int bpf_trampoline_multi_link_prog(struct bpf_tramp_link *links,
+				   struct bpf_trampoline **trs, u32 cnt);
+void bpf_trampoline_multi_unlink_prog(struct bpf_tramp_link *links,
+				      struct bpf_trampoline **trs, u32 cnt);
 struct bpf_trampoline *bpf_trampoline_get(u64 key,
 					  struct bpf_attach_target_info *tgt_info);
 void bpf_trampoline_put(struct bpf_trampoline *tr);
@@ -1398,6 +1404,15 @@ static inline int bpf_trampoline_unlink_prog(struct bpf_tramp_link *link,
 {
 	return -ENOTSUPP;
 }
+static inline int bpf_trampoline_multi_link_prog(struct bpf_tramp_link *links,
+						 struct bpf_trampoline **trs,
+						 u32 cnt)
+{
+	return -ENOTSUPP;
+}
+static inline void bpf_trampoline_multi_unlink_prog(struct bpf_tramp_link *links,
+						    struct bpf_trampoline **trs,
+						    u32 cnt) {}
 static inline struct bpf_trampoline *bpf_trampoline_get(u64 key,
 							struct bpf_attach_target_info *tgt_info)
 {
@@ -3411,6 +3426,21 @@ enum bpf_text_poke_type {
 int bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
 		       void *addr1, void *addr2);
 
+/* One call site for bpf_arch_text_poke_batch(). @ret is set on return as
+ * bpf_arch_text_poke() returns it: < 0 on error, 0 once patched and 1 if
+ * the site already had the new insn.
+ */
+struct bpf_text_poke_desc {
+	void *ip;
+	void *old_addr;
+	void *new_addr;
+	enum bpf_text_poke_type t;
+	u32 idx;		/* free for use by the caller */
+	int ret;
+};
+
+void bpf_arch_text_poke_batch(struct bpf_text_poke_desc *pokes, u32 cnt);
+
 void bpf_arch_poke_desc_update(struct bpf_jit_poke_descriptor *poke,
 			       struct bpf_prog *new, struct bpf_prog *old);
 
@@ -16,7 +16,13 @@
 #include <linux/bpf_mem_alloc.h>
 #include <uapi/linux/btf.h>
 
-#define BPF_LOCAL_STORAGE_CACHE_SIZE	16
+/* The cache of each bpf_local_storage is 2-way set associative: a map owns
+ * a set, and lookups check both of its slots, which share a cacheline.
+ */
+#define BPF_LOCAL_STORAGE_CACHE_SETS	16
+#define BPF_LOCAL_STORAGE_CACHE_WAYS	2
+#define BPF_LOCAL_STORAGE_CACHE_SIZE	\
+	(BPF_LOCAL_STORAGE_CACHE_SETS * BPF_LOCAL_STORAGE_CACHE_WAYS)
 
 #define bpf_rcu_lock_held()                                                    \
 	(rcu_read_lock_held() || rcu_read_lock_trace_held() ||                 \
@@ -55,7 +61,7 @@ struct bpf_local_storage_map {
 	struct bpf_local_storage_map_bucket *buckets;
 	u32 bucket_log;
 	u16 elem_size;
-	u16 cache_idx;
+	u16 cache_idx;		/* The cache set, not a slot */
 	struct bpf_mem_alloc selem_ma;
 	struct bpf_mem_alloc storage_ma;
 	bool bpf_ma;
@@ -78,7 +84,8 @@ struct bpf_local_storage_elem {
 	struct hlist_node snode;	/* Linked to bpf_local_storage */
 	struct bpf_local_storage __rcu *local_storage;
 	struct rcu_head rcu;
-	/* 8 bytes hole */
+	u32 map_bucket;		/* Index of the bucket in the map */
+	/* 4 bytes hole */
 	/* The data is stored in another cacheline to minimize
 	 * the number of cachelines access during a cache hit.
 	 */
@@ -109,11 +116,9 @@ struct bpf_local_storage {
 	container_of((_SDATA), struct bpf_local_storage_elem, sdata)
 #define SDATA(_SELEM) (&(_SELEM)->sdata)
 
-#define BPF_LOCAL_STORAGE_CACHE_SIZE	16
-
 struct bpf_local_storage_cache {
 	spinlock_t idx_lock;
-	u64 idx_usage_counts[BPF_LOCAL_STORAGE_CACHE_SIZE];
+	u64 idx_usage_counts[BPF_LOCAL_STORAGE_CACHE_SETS];
 };
 
 #define DEFINE_BPF_STORAGE_CACHE(name)				\
@@ -138,14 +143,19 @@ bpf_local_storage_lookup(struct bpf_local_storage *local_storage,
 			 struct bpf_local_storage_map *smap,
 			 bool cacheit_lockit)
 {
+	struct bpf_local_storage_data __rcu **cache;
 	struct bpf_local_storage_data *sdata;
 	struct bpf_local_storage_elem *selem;
+	int i;
 
 	/* Fast path (cache hit) */
-	sdata = rcu_dereference_check(local_storage->cache[smap->cache_idx],
-				      bpf_rcu_lock_held());
-	if (sdata && rcu_access_pointer(sdata->smap) == smap)
-		return sdata;
+	cache = &local_storage->cache[smap->cache_idx *
+				      BPF_LOCAL_STORAGE_CACHE_WAYS];
+	for (i = 0; i < BPF_LOCAL_STORAGE_CACHE_WAYS; i++) {
+		sdata = rcu_dereference_check(cache[i], bpf_rcu_lock_held());
+		if (sdata && rcu_access_pointer(sdata->smap) == smap)
+			return sdata;
+	}
 
 	/* Slow path (cache miss) */
 	hlist_for_each_entry_rcu(selem, &local_storage->list, snode,
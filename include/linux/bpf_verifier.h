@@ -510,6 +510,7 @@ struct bpf_verifier_state_list {
 	struct bpf_verifier_state state;
 	struct bpf_verifier_state_list *next;
 	int miss_cnt, hit_cnt;
+	u32 sig; /* state_signature() of state */
 };
 
 struct bpf_loop_inline_state {
@@ -756,6 +757,10 @@ struct bpf_verifier_env {
 	u32 prev_jmps_processed, jmps_processed;
 	/* total verification time */
 	u64 verification_time;
+	/* time before, in and after do_check(), and in is_state_visited(),
+	 * which is only measured with BPF_LOG_STATS
+	 */
+	u64 prep_time, check_time, fixup_time, prune_time;
 	/* maximum number of verifier states kept in 'branching' instructions */
 	u32 max_states_per_insn;
 	/* total number of allocated verifier states */
@@ -857,6 +862,7 @@ int bpf_check_attach_target(struct bpf_verifier_log *log,
 			    const struct bpf_prog *tgt_prog,
 			    u32 btf_id,
 			    struct bpf_attach_target_info *tgt_info);
+bool bpf_tracing_btf_id_denied(u32 btf_id);
 void bpf_free_kfunc_btf_tab(struct bpf_kfunc_btf_tab *tab);
 
 int mark_chain_precision(struct bpf_verifier_env *env, int regno);
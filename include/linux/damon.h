@@ -18,6 +18,8 @@
 #define DAMON_MIN_REGION	PAGE_SIZE
 /* Max priority score for DAMON-based operation schemes */
 #define DAMOS_MAX_SCORE		(99)
+/* Max number of threads sharing the access sampling of a context */
+#define DAMON_MAX_SAMPLE_WORKERS	16
 
 /* Get a random number in [l, r) */
 static inline unsigned long damon_rand(unsigned long l, unsigned long r)
@@ -452,6 +454,8 @@ struct damon_ctx;
  * @update:			Update operations-related data structures.
  * @prepare_access_checks:	Prepare next access check of target regions.
  * @check_accesses:		Check the accesses to target regions.
+ * @prepare_access_checks_shard: Prepare next access check of a shard.
+ * @check_accesses_shard:	Check the accesses to a shard.
  * @reset_aggregated:		Reset aggregated accesses monitoring results.
  * @get_scheme_score:		Get the score of a region for a scheme.
  * @apply_scheme:		Apply a DAMON-based operation scheme.
@@ -480,6 +484,13 @@ struct damon_ctx;
  * last preparation and update the number of observed accesses of each region.
  * It should also return max number of observed accesses that made as a result
  * of its update.  The value will be used for regions adjustment threshold.
+ * @prepare_access_checks_shard and @check_accesses_shard are optional, and do
+ * the same as @prepare_access_checks and @check_accesses, but only for the
+ * part of the regions that belongs to the given shard.  How the regions are
+ * split into shards is up to the operations set, but the split must be the
+ * same for the two callbacks, and a region must belong to only one shard.
+ * If both are provided and &damon_attrs.nr_sample_workers is larger than
+ * one, the shards are checked in parallel.
  * @reset_aggregated should reset the access monitoring results that aggregated
  * by @check_accesses.
  * @get_scheme_score should return the priority score of a region for a scheme
@@ -498,6 +509,10 @@ struct damon_operations {
 	void (*update)(struct damon_ctx *context);
 	void (*prepare_access_checks)(struct damon_ctx *context);
 	unsigned int (*check_accesses)(struct damon_ctx *context);
+	void (*prepare_access_checks_shard)(struct damon_ctx *context,
+			unsigned int shard, unsigned int nr_shards);
+	unsigned int (*check_accesses_shard)(struct damon_ctx *context,
+			unsigned int shard, unsigned int nr_shards);
 	void (*reset_aggregated)(struct damon_ctx *context);
 	int (*get_scheme_score)(struct damon_ctx *context,
 			struct damon_target *t, struct damon_region *r,
@@ -562,6 +577,8 @@ struct damon_callback {
  *				regions.
  * @max_nr_regions:		The maximum number of adaptive monitoring
  *				regions.
+ * @nr_sample_workers:		The number of threads sharing the access
+ *				sampling.
  *
  * For each @sample_interval, DAMON checks whether each region is accessed or
  * not during the last @sample_interval.  If such access is found, DAMON
@@ -572,6 +589,10 @@ struct damon_callback {
  * and applies the changes for each @ops_update_interval.  All time intervals
  * are in micro-seconds.  Please refer to &struct damon_operations and &struct
  * damon_callback for more detail.
+ *
+ * If @nr_sample_workers is larger than one and the operations set supports
+ * it, the access sampling of each @sample_interval is split across that many
+ * threads, up to %DAMON_MAX_SAMPLE_WORKERS, including the kdamond itself.
  */
 struct damon_attrs {
 	unsigned long sample_interval;
@@ -579,6 +600,7 @@ struct damon_attrs {
 	unsigned long ops_update_interval;
 	unsigned long min_nr_regions;
 	unsigned long max_nr_regions;
+	unsigned long nr_sample_workers;
 };
 
 /**
@@ -631,6 +653,8 @@ struct damon_ctx {
 	struct completion kdamond_started;
 	/* for scheme quotas prioritization */
 	unsigned long *regions_score_histogram;
+	/* for the parallel access sampling */
+	struct damon_sample_work *sample_works;
 
 /* public: */
 	struct task_struct *kdamond;
@@ -11,6 +11,7 @@
  */
 
 struct irq_affinity_notify;
+struct irq_balance;
 struct proc_dir_entry;
 struct module;
 struct irq_desc;
@@ -106,6 +107,9 @@ struct irq_desc {
 	struct dentry		*debugfs_file;
 	const char		*dev_name;
 #endif
+#ifdef CONFIG_IRQ_BALANCE
+	struct irq_balance	*balance;
+#endif
 #ifdef CONFIG_SPARSE_IRQ
 	struct rcu_head		rcu;
 	struct kobject		kobj;
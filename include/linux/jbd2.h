@@ -715,6 +715,11 @@ struct transaction_run_stats_s {
 	unsigned long		rs_locked;
 	unsigned long		rs_flushing;
 	unsigned long		rs_logging;
+	/* The logging phase split up, in ns */
+	u64			rs_log_submit;
+	u64			rs_log_wait;
+	u64			rs_commit_record;
+	u64			rs_finish;
 
 	__u32			rs_handle_count;
 	__u32			rs_blocks;
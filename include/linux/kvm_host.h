@@ -594,6 +594,8 @@ struct kvm_memory_slot {
 	gfn_t base_gfn;
 	unsigned long npages;
 	unsigned long *dirty_bitmap;
+	/* GFNs pushed to a dirty ring and not yet reset */
+	unsigned long *dirty_ring_bitmap;
 	struct kvm_arch_memory_slot arch;
 	unsigned long userspace_addr;
 	u32 flags;
@@ -846,6 +848,7 @@ struct kvm {
 	unsigned int max_halt_poll_ns;
 	u32 dirty_ring_size;
 	bool dirty_ring_with_bitmap;
+	bool dirty_ring_coalesce;
 	bool vm_bugged;
 	bool vm_dead;
 
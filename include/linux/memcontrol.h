@@ -210,6 +210,12 @@ struct mem_cgroup {
 	 * swap, and from being swapped out on zswap store failures.
 	 */
 	bool zswap_writeback;
+
+	/*
+	 * Compressor and zpool used for this memcg and its descendants, or
+	 * NULL to inherit from the parent (eventually the global pool).
+	 */
+	struct zswap_pool __rcu *zswap_pool;
 #endif
 
 	/* vmpressure notifications */
@@ -694,6 +700,28 @@ static inline int mem_cgroup_charge(struct folio *folio, struct mm_struct *mm,
 	return __mem_cgroup_charge(folio, mm, gfp);
 }
 
+int __mem_cgroup_charge_folios(struct folio_batch *folios,
+			       struct mm_struct *mm, gfp_t gfp);
+
+/**
+ * mem_cgroup_charge_folios - Charge a batch of new folios to a cgroup.
+ * @folios: Folios to charge.
+ * @mm: mm context of the allocating task.
+ * @gfp: Reclaim mode.
+ *
+ * Like mem_cgroup_charge(), but charges all of @folios to the same memcg
+ * with a single page counter update. Either all folios are charged or none.
+ *
+ * Return: 0 on success. Otherwise, an error code is returned.
+ */
+static inline int mem_cgroup_charge_folios(struct folio_batch *folios,
+					   struct mm_struct *mm, gfp_t gfp)
+{
+	if (mem_cgroup_disabled())
+		return 0;
+	return __mem_cgroup_charge_folios(folios, mm, gfp);
+}
+
 int mem_cgroup_hugetlb_try_charge(struct mem_cgroup *memcg, gfp_t gfp,
 		long nr_pages);
 
@@ -996,6 +1024,9 @@ unsigned long lruvec_page_state_local(struct lruvec *lruvec,
 void mem_cgroup_flush_stats(struct mem_cgroup *memcg);
 void mem_cgroup_flush_stats_ratelimited(struct mem_cgroup *memcg);
 
+void mem_cgroup_count_refault(struct mem_cgroup *memcg, unsigned long distance,
+			      bool lru_gen, long nr);
+
 void __mod_lruvec_kmem_state(void *p, enum node_stat_item idx, int val);
 
 static inline void mod_lruvec_kmem_state(void *p, enum node_stat_item idx,
@@ -1195,6 +1226,12 @@ static inline int mem_cgroup_charge(struct folio *folio,
 	return 0;
 }
 
+static inline int mem_cgroup_charge_folios(struct folio_batch *folios,
+		struct mm_struct *mm, gfp_t gfp)
+{
+	return 0;
+}
+
 static inline int mem_cgroup_hugetlb_try_charge(struct mem_cgroup *memcg,
 		gfp_t gfp, long nr_pages)
 {
@@ -1465,6 +1502,12 @@ static inline void mem_cgroup_flush_stats_ratelimited(struct mem_cgroup *memcg)
 {
 }
 
+static inline void mem_cgroup_count_refault(struct mem_cgroup *memcg,
+					    unsigned long distance,
+					    bool lru_gen, long nr)
+{
+}
+
 static inline void __mod_lruvec_kmem_state(void *p, enum node_stat_item idx,
 					   int val)
 {
@@ -1048,6 +1048,16 @@ static inline int vma_iter_bulk_store(struct vma_iterator *vmi,
 	return 0;
 }
 
+/*
+ * Point the range the iterator just found at @vma, which must cover the
+ * same range as the vma there.
+ */
+static inline void vma_iter_replace(struct vma_iterator *vmi,
+				    struct vm_area_struct *vma)
+{
+	mas_replace_entry(&vmi->mas, vma);
+}
+
 static inline void vma_iter_invalidate(struct vma_iterator *vmi)
 {
 	mas_pause(&vmi->mas);
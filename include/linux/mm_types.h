@@ -817,6 +817,7 @@ struct mm_cid {
 
 struct kioctx_table;
 struct iommu_mm_data;
+struct futex_private_hash;
 struct mm_struct {
 	struct {
 		/*
@@ -968,6 +969,10 @@ struct mm_struct {
 		spinlock_t			ioctx_lock;
 		struct kioctx_table __rcu	*ioctx_table;
 #endif
+#ifdef CONFIG_FUTEX
+		/* Private futex hash, NULL while the global one is used */
+		struct futex_private_hash	*futex_phash;
+#endif
 #ifdef CONFIG_MEMCG
 		/*
 		 * "owner" points to a task that is regarded as the canonical
@@ -385,6 +385,7 @@ enum lruvec_flags {
 
 struct lruvec;
 struct page_vma_mapped_walk;
+struct seq_file;
 
 #define LRU_GEN_MASK		((BIT(LRU_GEN_WIDTH) - 1) << LRU_GEN_PGOFF)
 #define LRU_REFS_MASK		((BIT(LRU_REFS_WIDTH) - 1) << LRU_REFS_PGOFF)
@@ -563,6 +564,7 @@ void lru_gen_online_memcg(struct mem_cgroup *memcg);
 void lru_gen_offline_memcg(struct mem_cgroup *memcg);
 void lru_gen_release_memcg(struct mem_cgroup *memcg);
 void lru_gen_soft_reclaim(struct mem_cgroup *memcg, int nid);
+void lru_gen_memcg_show(struct seq_file *m, struct mem_cgroup *memcg);
 
 #else /* !CONFIG_LRU_GEN */
 
@@ -656,10 +658,16 @@ enum zone_watermarks {
  * One per migratetype for each PAGE_ALLOC_COSTLY_ORDER. Two additional lists
  * are added for THP. One PCP list is used by GPF_MOVABLE, and the other PCP list
  * is used by GFP_UNMOVABLE and GFP_RECLAIMABLE.
+ *
+ * With THP, another pair of lists exists for each of the NR_PCP_MTHP_ORDERS
+ * orders above PAGE_ALLOC_COSTLY_ORDER, used for mTHP sizes up to the
+ * vm.percpu_pagelist_mthp_max_order sysctl.
  */
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
-#define NR_PCP_THP 2
+#define NR_PCP_MTHP_ORDERS 5
+#define NR_PCP_THP (2 + 2 * NR_PCP_MTHP_ORDERS)
 #else
+#define NR_PCP_MTHP_ORDERS 0
 #define NR_PCP_THP 0
 #endif
 #define NR_LOWORDER_PCP_LISTS (MIGRATE_PCPTYPES * (PAGE_ALLOC_COSTLY_ORDER + 1))
@@ -1350,6 +1358,7 @@ typedef struct pglist_data {
 	struct mutex kswapd_lock;
 #endif
 	struct task_struct *kswapd;	/* Protected by kswapd_lock */
+	struct kswapd_workers *kswapd_workers; /* Protected by kswapd_lock */
 	int kswapd_order;
 	enum zone_type kswapd_highest_zoneidx;
 
@@ -40,6 +40,7 @@ struct modversion_info {
 };
 
 struct module;
+struct module_export;
 struct exception_table_entry;
 
 struct module_kobject {
@@ -449,6 +450,9 @@ struct module {
 	const s32 *gpl_crcs;
 	bool using_gplonly_symbols;
 
+	/* Entries of both export tables in the exported symbol hash. */
+	struct module_export *exports;
+
 #ifdef CONFIG_MODULE_SIG
 	/* Signature was verified. */
 	bool sig_ok;
@@ -373,6 +373,10 @@ struct napi_struct {
 	unsigned int		napi_id;
 	struct hrtimer		timer;
 	struct task_struct	*thread;
+	/* threaded busy-poll: idle time before re-enabling the IRQ, stats */
+	u32			busy_poll_idle_usecs;
+	unsigned long		busy_poll_productive;
+	unsigned long		busy_poll_empty;
 	/* control-path-only fields follow */
 	struct list_head	dev_list;
 	struct hlist_node	napi_hash_node;
@@ -390,6 +394,7 @@ enum {
 	NAPI_STATE_PREFER_BUSY_POLL,	/* prefer busy-polling over softirq processing*/
 	NAPI_STATE_THREADED,		/* The poll is performed inside its own thread*/
 	NAPI_STATE_SCHED_THREADED,	/* Napi is currently scheduled in threaded mode */
+	NAPI_STATE_THREADED_BUSY_POLL,	/* The thread busy polls with the IRQ suspended */
 };
 
 enum {
@@ -403,6 +408,7 @@ enum {
 	NAPIF_STATE_PREFER_BUSY_POLL	= BIT(NAPI_STATE_PREFER_BUSY_POLL),
 	NAPIF_STATE_THREADED		= BIT(NAPI_STATE_THREADED),
 	NAPIF_STATE_SCHED_THREADED	= BIT(NAPI_STATE_SCHED_THREADED),
+	NAPIF_STATE_THREADED_BUSY_POLL	= BIT(NAPI_STATE_THREADED_BUSY_POLL),
 };
 
 enum gro_result {
@@ -552,6 +558,8 @@ static inline bool napi_complete(struct napi_struct *n)
 }
 
 int dev_set_threaded(struct net_device *dev, bool threaded);
+int napi_set_threaded(struct napi_struct *napi,
+		      enum netdev_napi_threaded threaded);
 
 /**
  *	napi_disable - prevent NAPI from scheduling
@@ -1970,6 +1978,10 @@ enum netdev_reg_state {
  *	@change_proto_down: device supports setting carrier via IFLA_PROTO_DOWN
  *	@netns_local: interface can't change network namespaces
  *	@fcoe_mtu:	device supports maximum FCoE MTU, 2158 bytes
+ *	@netmem_tx:	device can transmit net_iov frags, see
+ *			netmem_dma_unmap_page_attrs()
+ *	@xdp_xmit_shared: ndo_xdp_xmit() treats frames as read-only, so devmap
+ *			broadcast may queue the same frame to several devices
  *
  *	@net_notifier_list:	List of per-net netdev notifier block
  *				that follow this device when it is moved
@@ -2365,6 +2377,8 @@ struct net_device {
 	unsigned long		change_proto_down:1;
 	unsigned long		netns_local:1;
 	unsigned long		fcoe_mtu:1;
+	unsigned long		netmem_tx:1;
+	unsigned long		xdp_xmit_shared:1;
 
 	struct list_head	net_notifier_list;
 
@@ -2619,6 +2633,9 @@ static inline void netif_napi_set_irq(struct napi_struct *napi, int irq)
  */
 #define NAPI_POLL_WEIGHT 64
 
+/* Default idle time before a busy-polling NAPI thread re-enables the IRQ */
+#define NAPI_BUSY_POLL_IDLE_USECS 1000
+
 void netif_napi_add_weight(struct net_device *dev, struct napi_struct *napi,
 			   int (*poll)(struct napi_struct *, int), int weight);
 
@@ -3088,6 +3105,8 @@ u16 dev_pick_tx_zero(struct net_device *dev, struct sk_buff *skb,
 
 int __dev_queue_xmit(struct sk_buff *skb, struct net_device *sb_dev);
 int __dev_direct_xmit(struct sk_buff *skb, u16 queue_id);
+struct sk_buff *__dev_direct_xmit_list(struct sk_buff *skb, u16 queue_id,
+				       int *ret);
 
 static inline int dev_queue_xmit(struct sk_buff *skb)
 {
@@ -3208,6 +3227,13 @@ struct softnet_data {
 #endif
 
 	unsigned int		received_rps;
+	/* backlog enqueues of skb lists, and the skbs they queued */
+	unsigned int		rps_batches;
+	unsigned int		rps_batched;
+	/* GRO aggregates flushed, their bytes, and frags coalesced into them */
+	unsigned int		gro_merged;
+	unsigned int		gro_merged_bytes;
+	unsigned int		gro_coalesced;
 	bool			in_net_rx_action;
 	bool			in_napi_threaded_poll;
 
@@ -13,6 +13,7 @@
 #include <linux/netfilter.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/stringify.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/vmalloc.h>
 #include <net/netlink.h>
 #include <uapi/linux/netfilter/ipset/ip_set.h>
@@ -66,6 +67,8 @@ enum ip_set_extension {
 #define SET_WITH_COMMENT(s)	((s)->extensions & IPSET_EXT_COMMENT)
 #define SET_WITH_SKBINFO(s)	((s)->extensions & IPSET_EXT_SKBINFO)
 #define SET_WITH_FORCEADD(s)	((s)->flags & IPSET_CREATE_FLAG_FORCEADD)
+#define SET_WITH_PERCPU_COUNTER(s)	\
+	((s)->flags & IPSET_CREATE_FLAG_PERCPU_COUNTERS)
 
 /* Extension id, in size order */
 enum ip_set_ext_id {
@@ -91,9 +94,26 @@ struct ip_set_ext_type {
 
 extern const struct ip_set_ext_type ip_set_extensions[];
 
+struct ip_set_counter_cpu {
+	u64_stats_t bytes;
+	u64_stats_t packets;
+	struct u64_stats_sync syncp;
+};
+
+struct ip_set_counter_pcpu {
+	struct rcu_head rcu;
+	struct ip_set_counter_cpu __percpu *cpu;
+};
+
 struct ip_set_counter {
-	atomic64_t bytes;
-	atomic64_t packets;
+	union {
+		struct {
+			atomic64_t bytes;
+			atomic64_t packets;
+		};
+		/* Sets created with IPSET_FLAG_WITH_PERCPU_COUNTERS */
+		struct ip_set_counter_pcpu __rcu *pcpu;
+	};
 };
 
 struct ip_set_comment_rcu {
@@ -293,6 +313,11 @@ ip_set_ext_destroy(struct ip_set *set, void *data)
 
 		ip_set_extensions[IPSET_EXT_ID_COMMENT].destroy(set, c);
 	}
+	if (SET_WITH_PERCPU_COUNTER(set)) {
+		struct ip_set_counter *counter = ext_counter(data, set);
+
+		ip_set_extensions[IPSET_EXT_ID_COUNTER].destroy(set, counter);
+	}
 }
 
 int ip_set_put_flags(struct sk_buff *skb, struct ip_set *set);
@@ -502,10 +527,18 @@ ip_set_timeout_set(unsigned long *timeout, u32 value)
 void ip_set_init_comment(struct ip_set *set, struct ip_set_comment *comment,
 			 const struct ip_set_ext *ext);
 
+void ip_set_init_percpu_counter(struct ip_set *set,
+				struct ip_set_counter *counter,
+				const struct ip_set_ext *ext);
+
 static inline void
-ip_set_init_counter(struct ip_set_counter *counter,
+ip_set_init_counter(struct ip_set *set, struct ip_set_counter *counter,
 		    const struct ip_set_ext *ext)
 {
+	if (SET_WITH_PERCPU_COUNTER(set)) {
+		ip_set_init_percpu_counter(set, counter, ext);
+		return;
+	}
 	if (ext->bytes != ULLONG_MAX)
 		atomic64_set(&(counter)->bytes, (long long)(ext->bytes));
 	if (ext->packets != ULLONG_MAX)
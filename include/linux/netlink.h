@@ -292,6 +292,9 @@ struct netlink_callback {
 	unsigned int		prev_seq, seq;
 	int			flags;
 	bool			strict_check;
+	/* shard of a sharded dump, see netlink_dump_shard_range() */
+	u16			shard;
+	u16			nr_shards;
 	union {
 		u8		ctx[48];
 
@@ -324,8 +327,40 @@ struct netlink_dump_control {
 	struct module *module;
 	u32 min_dump_alloc;
 	int flags;
+	/* Split the dump into up to @nr_shards callbacks that are filled in
+	 * parallel.  Each gets a copy of the cb->ctx left by ->start(), and
+	 * ->done() only runs on the original callback.
+	 */
+	unsigned int nr_shards;
 };
 
+#define NETLINK_DUMP_MAX_SHARDS	16
+
+/**
+ * netlink_dump_shard_range - the part of a table a dump shard covers
+ * @cb: the dump callback
+ * @n: number of entries, e.g. hash buckets, in the table
+ * @start: first entry of the shard
+ * @end: one past the last entry of the shard
+ *
+ * The split only depends on @n and the shard, so the cursor a shard keeps
+ * in cb->ctx stays valid across ->dump() calls as long as @n does.
+ */
+static inline void netlink_dump_shard_range(const struct netlink_callback *cb,
+					    unsigned long n,
+					    unsigned long *start,
+					    unsigned long *end)
+{
+	if (cb->nr_shards <= 1) {
+		*start = 0;
+		*end = n;
+		return;
+	}
+
+	*start = n * cb->shard / cb->nr_shards;
+	*end = n * (cb->shard + 1) / cb->nr_shards;
+}
+
 int __netlink_dump_start(struct sock *ssk, struct sk_buff *skb,
 				const struct nlmsghdr *nlh,
 				struct netlink_dump_control *control);
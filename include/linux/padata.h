@@ -115,12 +115,14 @@ struct parallel_data {
  * @pd: Actual parallel_data structure which may be substituted on the fly.
  * @opd: Pointer to old pd to be freed by padata_replace.
  * @list: List entry in padata_instance list.
+ * @node: NUMA node the shell's CPUs are restricted to, or NUMA_NO_NODE.
  */
 struct padata_shell {
 	struct padata_instance		*pinst;
 	struct parallel_data __rcu	*pd;
 	struct parallel_data		*opd;
 	struct list_head		list;
+	int				node;
 };
 
 /**
@@ -183,16 +185,18 @@ extern void __init padata_init(void);
 extern struct padata_instance *padata_alloc(const char *name);
 extern void padata_free(struct padata_instance *pinst);
 extern struct padata_shell *padata_alloc_shell(struct padata_instance *pinst);
+extern struct padata_shell *padata_alloc_shell_node(struct padata_instance *pinst,
+						    int node);
 extern void padata_free_shell(struct padata_shell *ps);
 extern int padata_do_parallel(struct padata_shell *ps,
 			      struct padata_priv *padata, int *cb_cpu);
 extern void padata_do_serial(struct padata_priv *padata);
-extern void __init padata_do_multithreaded(struct padata_mt_job *job);
+extern void padata_do_multithreaded(struct padata_mt_job *job);
 extern int padata_set_cpumask(struct padata_instance *pinst, int cpumask_type,
 			      cpumask_var_t cpumask);
 #else
 static inline void __init padata_init(void) {}
-static inline void __init padata_do_multithreaded(struct padata_mt_job *job)
+static inline void padata_do_multithreaded(struct padata_mt_job *job)
 {
 	job->thread_fn(job->start, job->start + job->size, job->fn_arg);
 }
@@ -13,6 +13,8 @@
 #include <linux/threads.h>
 #include <linux/percpu.h>
 #include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/cache.h>
 
 /* percpu_counter batch for local add or sub */
 #define PERCPU_COUNTER_LOCAL_BATCH	INT_MAX
@@ -130,6 +132,46 @@ static inline bool percpu_counter_initialized(struct percpu_counter *fbc)
 	return (fbc->counters != NULL);
 }
 
+/*
+ * A percpu_node_counter folds the per-cpu counts into per-node counts, and
+ * those into the global count, so reads can trade accuracy for cost:
+ *
+ *  percpu_node_counter_read()		O(1), off by less than
+ *					nodes * node_batch + cpus * batch
+ *  percpu_node_counter_read_nodes()	O(nodes), off by less than cpus * batch
+ *  percpu_node_counter_sum()		O(cpus), exact without concurrent updates
+ *
+ * Nothing takes a lock, so neither updates nor reads serialize against
+ * each other.
+ */
+struct percpu_node_count {
+	atomic64_t count;
+} ____cacheline_aligned_in_smp;
+
+struct percpu_node_counter {
+	atomic64_t count;
+	s32 batch;
+	s32 node_batch;
+#ifdef CONFIG_HOTPLUG_CPU
+	struct list_head list;	/* All percpu_node_counters are on a list */
+#endif
+	struct percpu_node_count *nodes;
+	s32 __percpu *counters;
+};
+
+int percpu_node_counter_init(struct percpu_node_counter *pnc, s64 amount,
+			     s32 batch, gfp_t gfp);
+void percpu_node_counter_destroy(struct percpu_node_counter *pnc);
+void percpu_node_counter_add(struct percpu_node_counter *pnc, s64 amount);
+s64 percpu_node_counter_read_nodes(struct percpu_node_counter *pnc);
+s64 percpu_node_counter_sum(struct percpu_node_counter *pnc);
+int percpu_node_counter_compare(struct percpu_node_counter *pnc, s64 rhs);
+
+static inline s64 percpu_node_counter_read(struct percpu_node_counter *pnc)
+{
+	return atomic64_read(&pnc->count);
+}
+
 #else /* !CONFIG_SMP */
 
 struct percpu_counter {
@@ -260,6 +302,58 @@ static inline bool percpu_counter_initialized(struct percpu_counter *fbc)
 static inline void percpu_counter_sync(struct percpu_counter *fbc)
 {
 }
+
+struct percpu_node_counter {
+	s64 count;
+};
+
+static inline int percpu_node_counter_init(struct percpu_node_counter *pnc,
+					   s64 amount, s32 batch, gfp_t gfp)
+{
+	pnc->count = amount;
+	return 0;
+}
+
+static inline void percpu_node_counter_destroy(struct percpu_node_counter *pnc)
+{
+}
+
+static inline void
+percpu_node_counter_add(struct percpu_node_counter *pnc, s64 amount)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	pnc->count += amount;
+	local_irq_restore(flags);
+}
+
+static inline s64 percpu_node_counter_read(struct percpu_node_counter *pnc)
+{
+	return pnc->count;
+}
+
+static inline s64
+percpu_node_counter_read_nodes(struct percpu_node_counter *pnc)
+{
+	return pnc->count;
+}
+
+static inline s64 percpu_node_counter_sum(struct percpu_node_counter *pnc)
+{
+	return pnc->count;
+}
+
+static inline int
+percpu_node_counter_compare(struct percpu_node_counter *pnc, s64 rhs)
+{
+	if (pnc->count > rhs)
+		return 1;
+	else if (pnc->count < rhs)
+		return -1;
+	else
+		return 0;
+}
 #endif	/* CONFIG_SMP */
 
 static inline void percpu_counter_inc(struct percpu_counter *fbc)
@@ -1210,6 +1210,9 @@ struct perf_sample_data {
 	 */
 	u64				ip;
 	struct perf_callchain_entry	*callchain;
+	u64				stack_id;
+	struct perf_buffer		*stack_rb;
+	bool				stack_id_seen;
 	struct perf_raw_record		*raw;
 	struct perf_branch_stack	*br_stack;
 	u64				*br_stack_cntr;
@@ -1259,6 +1262,7 @@ static inline void perf_sample_save_callchain(struct perf_sample_data *data,
 	int size = 1;
 
 	data->callchain = perf_callchain(event, regs);
+	data->stack_id = 0;
 	size += data->callchain->nr;
 
 	data->dyn_size += size * sizeof(u64);
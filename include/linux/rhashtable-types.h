@@ -102,6 +102,18 @@ struct rhltable {
 	struct rhashtable ht;
 };
 
+/**
+ * struct rhashtable_sharded - Hash table split into independent shards
+ * @shards: The tables, each resized on its own
+ * @shard_shift: log2 of the number of shards
+ * @hash_rnd: Seed of the hash selecting the shard
+ */
+struct rhashtable_sharded {
+	struct rhashtable		*shards;
+	unsigned int			shard_shift;
+	u32				hash_rnd;
+};
+
 /**
  * struct rhashtable_walker - Hash table walker
  * @list: List entry on list of walkers
@@ -139,4 +151,10 @@ int rhltable_init_noprof(struct rhltable *hlt,
 		  const struct rhashtable_params *params);
 #define rhltable_init(...)	alloc_hooks(rhltable_init_noprof(__VA_ARGS__))
 
+int rhashtable_sharded_init_noprof(struct rhashtable_sharded *sht,
+			const struct rhashtable_params *params,
+			unsigned int nr_shards);
+#define rhashtable_sharded_init(...)	\
+	alloc_hooks(rhashtable_sharded_init_noprof(__VA_ARGS__))
+
 #endif /* _LINUX_RHASHTABLE_TYPES_H */
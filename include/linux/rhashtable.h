@@ -260,6 +260,10 @@ void rhashtable_free_and_destroy(struct rhashtable *ht,
 				 void (*free_fn)(void *ptr, void *arg),
 				 void *arg);
 void rhashtable_destroy(struct rhashtable *ht);
+void rhashtable_sharded_free_and_destroy(struct rhashtable_sharded *sht,
+					 void (*free_fn)(void *ptr, void *arg),
+					 void *arg);
+void rhashtable_sharded_destroy(struct rhashtable_sharded *sht);
 
 struct rhash_lock_head __rcu **rht_bucket_nested(
 	const struct bucket_table *tbl, unsigned int hash);
@@ -1283,4 +1287,119 @@ static inline void rhltable_destroy(struct rhltable *hlt)
 	return rhltable_free_and_destroy(hlt, NULL, NULL);
 }
 
+/*
+ * Sharded tables spread the objects over several rhashtables by a hash of
+ * their key, and each shard grows and shrinks on its own.  A rehash thus
+ * only ever moves the objects of one shard, and only the lookups and
+ * inserts hitting that shard see two bucket tables.
+ */
+
+static inline struct rhashtable *rht_shard(struct rhashtable_sharded *sht,
+					   unsigned int hash)
+{
+	return sht->shards + (sht->shard_shift ?
+			      hash >> (32 - sht->shard_shift) : 0);
+}
+
+static inline struct rhashtable *rht_key_shard(
+	struct rhashtable_sharded *sht, const void *key,
+	const struct rhashtable_params params)
+{
+	return rht_shard(sht, rht_key_get_hash(sht->shards, key, params,
+					       sht->hash_rnd));
+}
+
+static inline struct rhashtable *rht_head_shard(
+	struct rhashtable_sharded *sht, const struct rhash_head *he,
+	const struct rhashtable_params params)
+{
+	struct rhashtable *ht = sht->shards;
+	const char *ptr = rht_obj(ht, he);
+
+	if (likely(params.obj_hashfn))
+		return rht_shard(sht, params.obj_hashfn(ptr, params.key_len ?:
+							     ht->p.key_len,
+							sht->hash_rnd));
+	return rht_key_shard(sht, ptr + params.key_offset, params);
+}
+
+/**
+ * rhashtable_sharded_lookup - search a sharded hash table
+ * @sht:	sharded hash table
+ * @key:	the pointer to the key
+ * @params:	hash table parameters
+ *
+ * Same as rhashtable_lookup(), on the shard of @key.
+ */
+static inline void *rhashtable_sharded_lookup(
+	struct rhashtable_sharded *sht, const void *key,
+	const struct rhashtable_params params)
+{
+	return rhashtable_lookup(rht_key_shard(sht, key, params), key, params);
+}
+
+/**
+ * rhashtable_sharded_lookup_fast - search a sharded hash table, RCU locked
+ * @sht:	sharded hash table
+ * @key:	the pointer to the key
+ * @params:	hash table parameters
+ *
+ * Same as rhashtable_lookup_fast(), on the shard of @key.
+ */
+static inline void *rhashtable_sharded_lookup_fast(
+	struct rhashtable_sharded *sht, const void *key,
+	const struct rhashtable_params params)
+{
+	return rhashtable_lookup_fast(rht_key_shard(sht, key, params), key,
+				      params);
+}
+
+/**
+ * rhashtable_sharded_insert_fast - insert object into a sharded hash table
+ * @sht:	sharded hash table
+ * @obj:	pointer to hash head inside object
+ * @params:	hash table parameters
+ *
+ * Same as rhashtable_insert_fast(), on the shard of @obj.
+ */
+static inline int rhashtable_sharded_insert_fast(
+	struct rhashtable_sharded *sht, struct rhash_head *obj,
+	const struct rhashtable_params params)
+{
+	return rhashtable_insert_fast(rht_head_shard(sht, obj, params), obj,
+				      params);
+}
+
+/**
+ * rhashtable_sharded_lookup_insert_fast - insert object if its key is new
+ * @sht:	sharded hash table
+ * @obj:	pointer to hash head inside object
+ * @params:	hash table parameters
+ *
+ * Same as rhashtable_lookup_insert_fast(), on the shard of @obj.
+ */
+static inline int rhashtable_sharded_lookup_insert_fast(
+	struct rhashtable_sharded *sht, struct rhash_head *obj,
+	const struct rhashtable_params params)
+{
+	return rhashtable_lookup_insert_fast(rht_head_shard(sht, obj, params),
+					     obj, params);
+}
+
+/**
+ * rhashtable_sharded_remove_fast - remove object from a sharded hash table
+ * @sht:	sharded hash table
+ * @obj:	pointer to hash head inside object
+ * @params:	hash table parameters
+ *
+ * Same as rhashtable_remove_fast(), on the shard of @obj.
+ */
+static inline int rhashtable_sharded_remove_fast(
+	struct rhashtable_sharded *sht, struct rhash_head *obj,
+	const struct rhashtable_params params)
+{
+	return rhashtable_remove_fast(rht_head_shard(sht, obj, params), obj,
+				      params);
+}
+
 #endif /* _LINUX_RHASHTABLE_H */
@@ -70,6 +70,12 @@ struct sbitmap {
 	 */
 	bool round_robin;
 
+	/**
+	 * @numa: The words are split in one group per NUMA node, and CPUs
+	 * allocate from the group of their node before the other groups.
+	 */
+	bool numa;
+
 	/**
 	 * @map: Allocated bitmap.
 	 */
@@ -199,6 +205,18 @@ static inline void sbitmap_free(struct sbitmap *sb)
  */
 void sbitmap_resize(struct sbitmap *sb, unsigned int depth);
 
+/**
+ * sbitmap_set_numa() - Allocate bits node local first.
+ * @sb: Bitmap to set up, not in use yet.
+ *
+ * Splits the words of @sb in one group per NUMA node, so that CPUs of
+ * different nodes normally allocate from, and dirty, different cachelines.
+ * A CPU only takes bits from the words of other nodes once the words of
+ * its own node are full.  Does nothing for round robin bitmaps, bitmaps
+ * without allocation hints, or with fewer words than nodes.
+ */
+void sbitmap_set_numa(struct sbitmap *sb);
+
 /**
  * sbitmap_get() - Try to allocate a free bit from a &struct sbitmap.
  * @sb: Bitmap to allocate from.
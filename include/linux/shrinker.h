@@ -57,6 +57,10 @@ struct shrink_control {
 
 #define SHRINK_STOP (~0UL)
 #define SHRINK_EMPTY (~0UL - 1)
+
+/* Number of log2 buckets of the CONFIG_SHRINKER_DEBUG latency histogram */
+#define SHRINKER_NR_LATENCY	16
+
 /*
  * A callback you can register to apply pressure to ageable caches.
  *
@@ -112,6 +116,8 @@ struct shrinker {
 	int debugfs_id;
 	const char *name;
 	struct dentry *debugfs_entry;
+	/* log2 histogram of do_shrink_slab() latencies, in microseconds */
+	atomic_long_t latency[SHRINKER_NR_LATENCY];
 #endif
 	/* objs pending delete, per node */
 	atomic_long_t *nr_deferred;
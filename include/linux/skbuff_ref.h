@@ -9,6 +9,27 @@
 
 #include <linux/skbuff.h>
 
+void __get_netmem_iov(netmem_ref netmem);
+void __put_netmem_iov(netmem_ref netmem);
+
+static inline void get_netmem(netmem_ref netmem)
+{
+	if (netmem_is_net_iov(netmem)) {
+		__get_netmem_iov(netmem);
+		return;
+	}
+	get_page(netmem_to_page(netmem));
+}
+
+static inline void put_netmem(netmem_ref netmem)
+{
+	if (netmem_is_net_iov(netmem)) {
+		__put_netmem_iov(netmem);
+		return;
+	}
+	put_page(netmem_to_page(netmem));
+}
+
 /**
  * __skb_frag_ref - take an addition reference on a paged fragment.
  * @frag: the paged fragment
@@ -17,7 +38,7 @@
  */
 static inline void __skb_frag_ref(skb_frag_t *frag)
 {
-	get_page(skb_frag_page(frag));
+	get_netmem(skb_frag_netmem(frag));
 }
 
 /**
@@ -40,7 +61,7 @@ static inline void skb_page_unref(netmem_ref netmem, bool recycle)
 	if (recycle && napi_pp_put_page(netmem))
 		return;
 #endif
-	put_page(netmem_to_page(netmem));
+	put_netmem(netmem);
 }
 
 /**
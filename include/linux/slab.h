@@ -309,6 +309,19 @@ struct kmem_cache_args {
 	 * %NULL means no constructor.
 	 */
 	void (*ctor)(void *);
+	/**
+	 * @sheaf_capacity: Enable per-cpu sheaves of the given capacity.
+	 *
+	 * With a non-zero value, the cache keeps per-cpu arrays ("sheaves")
+	 * of up to @sheaf_capacity free objects in front of the cpu slab and
+	 * exchanges full and empty sheaves between cpus through per-node
+	 * barns. This makes allocations and frees on the local node cheaper
+	 * at the cost of keeping more free objects cached.
+	 *
+	 * %0 means no sheaves. The setting is ignored for caches with
+	 * debugging enabled and with CONFIG_SLUB_TINY.
+	 */
+	unsigned int sheaf_capacity;
 };
 
 struct kmem_cache *__kmem_cache_create_args(const char *name,
@@ -13,4 +13,20 @@ void sort(void *base, size_t num, size_t size,
 	  cmp_func_t cmp_func,
 	  swap_func_t swap_func);
 
+void introsort_r(void *base, size_t num, size_t size,
+		 cmp_r_func_t cmp_func,
+		 swap_r_func_t swap_func,
+		 const void *priv);
+
+void introsort(void *base, size_t num, size_t size,
+	       cmp_func_t cmp_func,
+	       swap_func_t swap_func);
+
+void sort_r_parallel(void *base, size_t num, size_t size,
+		     cmp_r_func_t cmp_func, const void *priv,
+		     unsigned int max_threads);
+
+void sort_parallel(void *base, size_t num, size_t size,
+		   cmp_func_t cmp_func, unsigned int max_threads);
+
 #endif
@@ -9,6 +9,7 @@
 #define SWAP_SLOTS_CACHE_SIZE			SWAP_BATCH
 #define THRESHOLD_ACTIVATE_SWAP_SLOTS_CACHE	(5*SWAP_SLOTS_CACHE_SIZE)
 #define THRESHOLD_DEACTIVATE_SWAP_SLOTS_CACHE	(2*SWAP_SLOTS_CACHE_SIZE)
+#define SWAP_LARGE_SLOTS_CACHE_SIZE		8
 
 struct swap_slots_cache {
 	bool		lock_initialized;
@@ -19,6 +20,11 @@ struct swap_slots_cache {
 	spinlock_t	free_lock;  /* protects slots_ret, n_ret */
 	swp_entry_t	*slots_ret;
 	int		n_ret;
+#ifdef CONFIG_THP_SWAP
+	/* ranges for large folios, per order, also protected by alloc_lock */
+	swp_entry_t	large_slots[SWAP_NR_ORDERS][SWAP_LARGE_SLOTS_CACHE_SIZE];
+	int		large_nr[SWAP_NR_ORDERS];
+#endif
 };
 
 void disable_swap_slots_cache_lock(void);
@@ -53,6 +53,12 @@ struct udp_sock {
 
 	unsigned long	 udp_flags;
 
+	/* Connected sockets, hashed on (local addr, local port, remote
+	 * addr, remote port) in udp_table.hash4
+	 */
+	struct hlist_node udp_lrpa_node;
+	unsigned int	 udp_lrpa_hash;
+
 	int		 pending;	/* Any pending frames ? */
 	__u8		 encap_type;	/* Is this an Encapsulation socket? */
 
@@ -383,6 +383,36 @@ ssize_t iov_iter_extract_pages(struct iov_iter *i, struct page ***pages,
 			       iov_iter_extraction_t extraction_flags,
 			       size_t *offset0);
 
+/**
+ * struct iov_iter_folio - A contiguous range of a folio
+ * @folio: The folio
+ * @offset: Offset of the range from the start of the folio
+ * @length: Length of the range
+ *
+ * Filled in by iov_iter_extract_folios().  It has the size of a bio_vec, so
+ * that a bio's free vectors can be used to hold the extracted ranges.
+ */
+struct iov_iter_folio {
+	struct folio	*folio;
+	unsigned int	offset;
+	unsigned int	length;
+};
+
+/*
+ * Number of pages spanned by @f.  Each of them holds a pin if the range was
+ * extracted from an iterator for which iov_iter_extract_will_pin() is true.
+ */
+static inline unsigned int iov_iter_folio_nr_pages(const struct iov_iter_folio *f)
+{
+	return (f->offset + f->length - 1) / PAGE_SIZE - f->offset / PAGE_SIZE + 1;
+}
+
+ssize_t iov_iter_extract_folios(struct iov_iter *i,
+				struct iov_iter_folio *folios,
+				unsigned int maxfolios, size_t maxsize,
+				iov_iter_extraction_t extraction_flags,
+				unsigned int *nr_folios);
+
 /**
  * iov_iter_extract_will_pin - Indicate how pages from the iterator will be retained
  * @iter: The iterator
@@ -100,9 +100,11 @@ enum rp_check {
 };
 
 struct xol_area;
+struct uprobe_cache;
 
 struct uprobes_state {
 	struct xol_area		*xol_area;
+	struct uprobe_cache	*cache;
 };
 
 extern void __init uprobes_init(void);
@@ -130,8 +130,34 @@ extern ssize_t mfill_atomic_continue(struct userfaultfd_ctx *ctx, unsigned long
 				     unsigned long len, uffd_flags_t flags);
 extern ssize_t mfill_atomic_poison(struct userfaultfd_ctx *ctx, unsigned long start,
 				   unsigned long len, uffd_flags_t flags);
+
+/* One range of a vectored fill, see mfill_atomic_vec() */
+struct mfill_atomic_range {
+	unsigned long dst;
+	unsigned long src;
+	unsigned long len;
+	ssize_t ret;
+};
+
+extern unsigned long mfill_atomic_vec(struct userfaultfd_ctx *ctx,
+				      struct mfill_atomic_range *ranges,
+				      unsigned long nr, uffd_flags_t flags);
 extern int mwriteprotect_range(struct userfaultfd_ctx *ctx, unsigned long start,
 			       unsigned long len, bool enable_wp);
+
+/* Fault message ring, see mm/userfaultfd_ring.c */
+#define UFFD_RING_MAX_ENTRIES	(1UL << 20)
+/* Don't wake up poll()/read() waiters when posting to the ring */
+#define UFFD_RING_MODE_BUSY_POLL	(1U << 0)
+
+struct uffd_ring;
+
+extern struct uffd_ring *uffd_ring_alloc(unsigned long nr_entries,
+					 unsigned int mode);
+extern void uffd_ring_free(struct uffd_ring *ring);
+extern int uffd_ring_mmap(struct uffd_ring *ring, struct vm_area_struct *vma);
+extern bool uffd_ring_post(struct uffd_ring *ring, const struct uffd_msg *msg);
+extern bool uffd_ring_needs_wakeup(struct uffd_ring *ring);
 extern long uffd_wp_range(struct vm_area_struct *vma,
 			  unsigned long start, unsigned long len, bool enable_wp);
 
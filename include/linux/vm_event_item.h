@@ -49,6 +49,14 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PGSCAN_FILE,
 		PGSTEAL_ANON,
 		PGSTEAL_FILE,
+		PGSCAN_KSWAPD_WORKER1,
+		PGSCAN_KSWAPD_WORKER2,
+		PGSCAN_KSWAPD_WORKER3,
+		PGSCAN_KSWAPD_WORKER4,
+		PGSTEAL_KSWAPD_WORKER1,
+		PGSTEAL_KSWAPD_WORKER2,
+		PGSTEAL_KSWAPD_WORKER3,
+		PGSTEAL_KSWAPD_WORKER4,
 #ifdef CONFIG_NUMA
 		PGSCAN_ZONE_RECLAIM_SUCCESS,
 		PGSCAN_ZONE_RECLAIM_FAILED,
@@ -58,6 +66,19 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PAGEOUTRUN, PGROTATED,
 		DROP_PAGECACHE, DROP_SLAB,
 		OOM_KILL,
+		/* zone->lock hold time of pcp refills and drains, per order */
+		ZONE_LOCK_NS_ORDER0,
+		ZONE_LOCK_NS_ORDER1,
+		ZONE_LOCK_NS_ORDER2,
+		ZONE_LOCK_NS_ORDER3,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+		ZONE_LOCK_NS_ORDER4,
+		ZONE_LOCK_NS_ORDER5,
+		ZONE_LOCK_NS_ORDER6,
+		ZONE_LOCK_NS_ORDER7,
+		ZONE_LOCK_NS_ORDER8,
+		ZONE_LOCK_NS_PMD,
+#endif
 #ifdef CONFIG_NUMA_BALANCING
 		NUMA_PTE_UPDATES,
 		NUMA_HUGE_PTE_UPDATES,
@@ -117,6 +138,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		THP_ZERO_PAGE_ALLOC_FAILED,
 		THP_SWPOUT,
 		THP_SWPOUT_FALLBACK,
+		THP_SWPIN,
+		THP_SWPIN_FALLBACK,
 #endif
 #ifdef CONFIG_MEMORY_BALLOON
 		BALLOON_INFLATE,
@@ -157,6 +180,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		VMA_LOCK_ABORT,
 		VMA_LOCK_RETRY,
 		VMA_LOCK_MISS,
+		VMA_LOCK_MADVISE,
+		VMA_LOCK_MADVISE_FALLBACK,
 #endif
 #ifdef CONFIG_DEBUG_STACK_USAGE
 		KSTACK_1K,
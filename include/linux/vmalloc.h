@@ -38,6 +38,7 @@ struct iov_iter;		/* in uio.h */
 #define VM_DEFER_KMEMLEAK	0
 #endif
 #define VM_SPARSE		0x00001000	/* sparse vm_area. not all pages are present. */
+#define VM_CACHED		0x00002000	/* freed, held by the vmalloc per-CPU cache */
 
 /* bits [20..32] reserved for arch specific ioremap internals */
 
@@ -20,6 +20,9 @@ struct work_struct {
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map lockdep_map;
 #endif
+#ifdef CONFIG_WQ_LATENCY_HIST
+	u64 queued_at;
+#endif
 };
 
 #endif /* _LINUX_WORKQUEUE_TYPES_H */
@@ -357,6 +357,10 @@ void *xa_store(struct xarray *, unsigned long index, void *entry, gfp_t);
 void *xa_erase(struct xarray *, unsigned long index);
 void *xa_store_range(struct xarray *, unsigned long first, unsigned long last,
 			void *entry, gfp_t);
+int xa_store_batch(struct xarray *, unsigned long first, void **entries,
+			unsigned int nr, gfp_t);
+unsigned long xa_erase_range(struct xarray *, unsigned long first,
+			unsigned long last);
 bool xa_get_mark(struct xarray *, unsigned long index, xa_mark_t);
 void xa_set_mark(struct xarray *, unsigned long index, xa_mark_t);
 void xa_clear_mark(struct xarray *, unsigned long index, xa_mark_t);
@@ -217,6 +217,41 @@ zstd_cctx *zstd_init_cctx(void *workspace, size_t workspace_size);
 size_t zstd_compress_cctx(zstd_cctx *cctx, void *dst, size_t dst_capacity,
 	const void *src, size_t src_size, const zstd_parameters *parameters);
 
+/**
+ * zstd_compress_mt() - compress src into dst with several workers
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of the destination buffer. May be any size, but
+ *                zstd_compress_mt_bound(srcSize, nr_workers) is guaranteed
+ *                to be large enough.
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ * @parameters:   The compression parameters to be used for each job.
+ * @nr_workers:   The maximum number of jobs compressed in parallel.
+ *
+ * Inputs larger than ZSTD_MT_MIN_JOB_SIZE are split into at most
+ * @nr_workers independent jobs of at least that size, which are compressed
+ * on an unbound workqueue into one frame each, and concatenated in dst.
+ * zstd decompresses concatenated frames as their concatenated content.
+ *
+ * Context:       Process context, may sleep. Allocates a compression
+ *                workspace and an output buffer per job.
+ * Return:        The compressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+#define ZSTD_MT_MIN_JOB_SIZE	(128 * 1024)
+size_t zstd_compress_mt(void *dst, size_t dst_capacity, const void *src,
+	size_t src_size, const zstd_parameters *parameters,
+	unsigned int nr_workers);
+
+/**
+ * zstd_compress_mt_bound() - maximum compressed size for zstd_compress_mt()
+ * @src_size:   The size of the data to compress.
+ * @nr_workers: As passed to zstd_compress_mt().
+ *
+ * Return:      The maximum compressed size in the worst case scenario.
+ */
+size_t zstd_compress_mt_bound(size_t src_size, unsigned int nr_workers);
+
 /**
  * zstd_create_cctx_advanced() - Create compression context
  * @custom_mem:   Custom allocator.
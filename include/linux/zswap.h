@@ -6,6 +6,7 @@
 #include <linux/mm_types.h>
 
 struct lruvec;
+struct seq_file;
 
 extern atomic_t zswap_stored_pages;
 
@@ -31,6 +32,8 @@ void zswap_invalidate(swp_entry_t swp);
 int zswap_swapon(int type, unsigned long nr_pages);
 void zswap_swapoff(int type);
 void zswap_memcg_offline_cleanup(struct mem_cgroup *memcg);
+int zswap_memcg_compressor_show(struct seq_file *m, struct mem_cgroup *memcg);
+int zswap_memcg_set_compressor(struct mem_cgroup *memcg, char *buf);
 void zswap_lruvec_state_init(struct lruvec *lruvec);
 void zswap_folio_swapin(struct folio *folio);
 bool zswap_is_enabled(void);
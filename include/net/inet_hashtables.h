@@ -304,6 +304,18 @@ int __inet_hash(struct sock *sk, struct sock *osk);
 int inet_hash(struct sock *sk);
 void inet_unhash(struct sock *sk);
 
+void __inet_ehash_cache_evict(struct sock *sk);
+void inet_ehash_cache_set(bool enable);
+
+/* Must be called after @sk is taken out of the ehash */
+static inline void inet_ehash_cache_evict(struct sock *sk)
+{
+	/* Pairs with the barrier in inet_ehash_cache_insert() */
+	smp_mb();
+	if (unlikely(READ_ONCE(sk->sk_ehash_cache_cpu)))
+		__inet_ehash_cache_evict(sk);
+}
+
 struct sock *__inet_lookup_listener(const struct net *net,
 				    struct inet_hashinfo *hashinfo,
 				    struct sk_buff *skb, int doff,
@@ -222,6 +222,8 @@ struct neigh_table {
 	int			gc_thresh3;
 	unsigned long		last_flush;
 	struct delayed_work	gc_work;
+	/* next hash bucket for neigh_periodic_work() */
+	unsigned int		gc_bucket;
 	struct delayed_work	managed_work;
 	struct timer_list 	proxy_timer;
 	struct sk_buff_head	proxy_queue;
@@ -515,6 +515,10 @@ static inline int rt_genid_ipv6(const struct net *net)
 
 static inline void rt_genid_bump_ipv4(struct net *net)
 {
+	/* Order the flushed change before the new generation, see the per-CPU
+	 * lookup cache in net/ipv4/fib_rules.c.
+	 */
+	smp_mb__before_atomic();
 	atomic_inc(&net->ipv4.rt_genid);
 }
 
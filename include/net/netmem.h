@@ -8,6 +8,7 @@
 #ifndef _NET_NETMEM_H
 #define _NET_NETMEM_H
 
+#include <linux/dma-mapping.h>
 #include <linux/mm.h>
 #include <net/net_debug.h>
 
@@ -171,4 +172,27 @@ static inline unsigned long netmem_get_dma_addr(netmem_ref netmem)
 	return __netmem_clear_lsb(netmem)->dma_addr;
 }
 
+/* A net_iov frag is mapped for the lifetime of its dma-buf binding, so a
+ * driver TX path that supports them (netdev->netmem_tx) records a zero
+ * unmap address for it, and skips the unmap on completion.
+ */
+#define netmem_dma_unmap_addr_set(NETMEM, PTR, ADDR_NAME, VAL)	\
+	do {							\
+		if (!netmem_is_net_iov(NETMEM))			\
+			dma_unmap_addr_set(PTR, ADDR_NAME, VAL);	\
+		else						\
+			dma_unmap_addr_set(PTR, ADDR_NAME, 0);	\
+	} while (0)
+
+static inline void netmem_dma_unmap_page_attrs(struct device *dev,
+					       dma_addr_t addr, size_t size,
+					       enum dma_data_direction dir,
+					       unsigned long attrs)
+{
+	if (!addr)
+		return;
+
+	dma_unmap_page_attrs(dev, addr, size, dir, attrs);
+}
+
 #endif /* _NET_NETMEM_H */
@@ -15,6 +15,7 @@
 struct ctl_table_header;
 struct ipv4_devconf;
 struct fib_rules_ops;
+struct fib4_lookup_cache;
 struct hlist_head;
 struct fib_table;
 struct sock;
@@ -96,6 +97,7 @@ struct netns_ipv4 {
 	struct mutex		ra_mutex;
 #ifdef CONFIG_IP_MULTIPLE_TABLES
 	struct fib_rules_ops	*rules_ops;
+	struct fib4_lookup_cache __percpu *fib_lookup_cache;
 	struct fib_table __rcu	*fib_main;
 	struct fib_table __rcu	*fib_default;
 	unsigned int		fib_rules_require_fldissect;
@@ -46,11 +46,21 @@
  * this array, as it shares the same softirq/NAPI protection.  If
  * cache is already full (or partly full) then the XDP_DROP recycles
  * would have to take a slower code path.
+ *
+ * How much of the array is actually used is adapted at runtime, see
+ * page_pool_alloc_cache_adapt(): @target starts at PP_ALLOC_CACHE_DEF and
+ * moves between PP_ALLOC_CACHE_MIN and PP_ALLOC_CACHE_SIZE depending on
+ * how the cache misses of the pool end up being served.
  */
-#define PP_ALLOC_CACHE_SIZE	128
+#define PP_ALLOC_CACHE_SIZE	256
+#define PP_ALLOC_CACHE_DEF	128
+#define PP_ALLOC_CACHE_MIN	16
 #define PP_ALLOC_CACHE_REFILL	64
 struct pp_alloc_cache {
 	u32 count;
+	u32 target;
+	u16 nr_refill;
+	u16 nr_slow;
 	netmem_ref cache[PP_ALLOC_CACHE_SIZE];
 };
 
@@ -7,6 +7,8 @@
 
 /* 1 MB per cpu, in page units */
 #define SK_MEMORY_PCPU_RESERVE (1 << (20 - PAGE_SHIFT))
+/* How far beyond net.core.mem_pcpu_rsv the reserve may grow */
+#define SK_MEMORY_PCPU_RESERVE_SCALE 16
 
 static inline bool sk_has_memory_pressure(const struct sock *sk)
 {
@@ -50,6 +52,18 @@ sk_memory_allocated(const struct sock *sk)
 	return proto_memory_allocated(sk->sk_prot);
 }
 
+/* How many pages a cpu may account for before it folds them into
+ * memory_allocated. This is net.core.mem_pcpu_rsv, raised by
+ * proto_memory_pcpu_adjust() while the protocol is far from its limits.
+ */
+static inline int proto_memory_pcpu_rsv(const struct proto *proto)
+{
+	return max(READ_ONCE(proto->per_cpu_fw_rsv),
+		   READ_ONCE(net_hotdata.sysctl_mem_pcpu_rsv));
+}
+
+void proto_memory_pcpu_adjust(struct proto *proto);
+
 static inline void proto_memory_pcpu_drain(struct proto *proto)
 {
 	int val = this_cpu_xchg(*proto->per_cpu_fw_alloc, 0);
@@ -65,8 +79,10 @@ sk_memory_allocated_add(const struct sock *sk, int val)
 
 	val = this_cpu_add_return(*proto->per_cpu_fw_alloc, val);
 
-	if (unlikely(val >= READ_ONCE(net_hotdata.sysctl_mem_pcpu_rsv)))
+	if (unlikely(val >= proto_memory_pcpu_rsv(proto))) {
 		proto_memory_pcpu_drain(proto);
+		proto_memory_pcpu_adjust(proto);
+	}
 }
 
 static inline void
@@ -76,8 +92,10 @@ sk_memory_allocated_sub(const struct sock *sk, int val)
 
 	val = this_cpu_sub_return(*proto->per_cpu_fw_alloc, val);
 
-	if (unlikely(val <= -READ_ONCE(net_hotdata.sysctl_mem_pcpu_rsv)))
+	if (unlikely(val <= -proto_memory_pcpu_rsv(proto))) {
 		proto_memory_pcpu_drain(proto);
+		proto_memory_pcpu_adjust(proto);
+	}
 }
 
 #endif /* _PROTO_MEMORY_H */
@@ -246,6 +246,8 @@ struct sk_filter;
   *	@sk_rx_dst: receive input route used by early demux
   *	@sk_rx_dst_ifindex: ifindex for @sk_rx_dst
   *	@sk_rx_dst_cookie: cookie for @sk_rx_dst
+  *	@sk_ehash_cache_cpu: CPU + 1 whose established lookup cache holds
+  *		this socket, 0 if none
   *	@sk_dst_cache: destination cache
   *	@sk_dst_pending_confirm: need to confirm neighbour
   *	@sk_policy: flow policy
@@ -408,6 +410,7 @@ struct sock {
 	struct dst_entry __rcu	*sk_rx_dst;
 	int			sk_rx_dst_ifindex;
 	u32			sk_rx_dst_cookie;
+	int			sk_ehash_cache_cpu;
 
 #ifdef CONFIG_NET_RX_BUSY_POLL
 	unsigned int		sk_ll_usec;
@@ -1288,6 +1291,8 @@ struct proto {
 	void			(*leave_memory_pressure)(struct sock *sk);
 	atomic_long_t		*memory_allocated;	/* Current allocated memory. */
 	int  __percpu		*per_cpu_fw_alloc;
+	/* Adaptive bound of *per_cpu_fw_alloc, see proto_memory_pcpu_rsv() */
+	int			per_cpu_fw_rsv;
 	struct percpu_counter	*sockets_allocated;	/* Current number of sockets. */
 
 	/*
@@ -1804,6 +1809,7 @@ struct sockcm_cookie {
 	u64 transmit_time;
 	u32 mark;
 	u32 tsflags;
+	u32 dmabuf_id;
 };
 
 static inline void sockcm_init(struct sockcm_cookie *sockc,
@@ -247,6 +247,23 @@ struct sk_buff *xdp_build_skb_from_frame(struct xdp_frame *xdpf,
 					 struct net_device *dev);
 int xdp_alloc_skb_bulk(void **skbs, int n_skb, gfp_t gfp);
 struct xdp_frame *xdpf_clone(struct xdp_frame *xdpf);
+void xdpf_get(struct xdp_frame *xdpf);
+
+/* Whether xdpf_get() can take another reference on the memory of @xdpf */
+static inline bool xdpf_can_get(struct xdp_frame *xdpf)
+{
+	if (xdp_frame_has_frags(xdpf))
+		return false;
+
+	switch (xdpf->mem.type) {
+	case MEM_TYPE_PAGE_SHARED:
+	case MEM_TYPE_PAGE_ORDER0:
+	case MEM_TYPE_PAGE_POOL:
+		return true;
+	default:
+		return false;
+	}
+}
 
 static inline
 void xdp_convert_frame_to_buff(struct xdp_frame *frame, struct xdp_buff *xdp)
@@ -220,6 +220,9 @@
  *
  *  7.41
  *  - add FUSE_ALLOW_IDMAP
+ *
+ *  7.42
+ *  - allow FOPEN_PASSTHROUGH on opendir, add FUSE_BACKING_ATTR backing flag
  */
 
 #ifndef _LINUX_FUSE_H
@@ -255,7 +258,7 @@
 #define FUSE_KERNEL_VERSION 7
 
 /** Minor version number of this interface */
-#define FUSE_KERNEL_MINOR_VERSION 41
+#define FUSE_KERNEL_MINOR_VERSION 42
 
 /** The node ID of the root inode */
 #define FUSE_ROOT_ID 1
@@ -362,7 +365,8 @@ struct fuse_file_lock {
  * FOPEN_STREAM: the file is stream-like (no file position at all)
  * FOPEN_NOFLUSH: don't flush data cache on close (unless FUSE_WRITEBACK_CACHE)
  * FOPEN_PARALLEL_DIRECT_WRITES: Allow concurrent direct writes on the same inode
- * FOPEN_PASSTHROUGH: passthrough read/write io for this open file
+ * FOPEN_PASSTHROUGH: passthrough read/write io, fsync and mmap for this open
+ *		      file, or fsync for this open directory
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
@@ -1093,18 +1097,58 @@ struct fuse_notify_retrieve_in {
 	uint64_t	dummy4;
 };
 
+/**
+ * Backing file flags
+ *
+ * FUSE_BACKING_ATTR: getattr and statx of an inode in passthrough mode are
+ *		      answered from this backing file
+ */
+#define FUSE_BACKING_ATTR	(1 << 0)
+
 struct fuse_backing_map {
 	int32_t		fd;
 	uint32_t	flags;
 	uint64_t	padding;
 };
 
+/*
+ * Shared request/reply ring of a fuse device, set up with FUSE_DEV_IOC_RING
+ * and mapped with mmap() of the device at offset 0:
+ *
+ *   page 0	free running uint32_t positions at the offsets below
+ *   page 1..	nr_entries request slots of entry_size bytes, each holding
+ *		a request as read() would return it
+ *   then	nr_entries reply slots of entry_size bytes, each holding a
+ *		reply as it would be passed to write()
+ *
+ * The slot of a position is at (pos & (nr_entries - 1)).  The kernel posts
+ * requests submitted on @cpu that fit in a slot, everything else is still
+ * delivered through read().  FUSE_DEV_IOC_RING_ENTER completes the posted
+ * replies and, with FUSE_RING_ENTER_GETREQ, waits for requests.
+ */
+struct fuse_ring_setup {
+	uint32_t	nr_entries;
+	uint32_t	entry_size;
+	uint32_t	cpu;
+	uint32_t	flags;
+};
+
+#define FUSE_RING_REQ_PROD	0	/* written by the kernel */
+#define FUSE_RING_REQ_CONS	64	/* written by the daemon */
+#define FUSE_RING_REPLY_PROD	128	/* written by the daemon */
+#define FUSE_RING_REPLY_CONS	192	/* written by the kernel */
+
+#define FUSE_RING_ENTER_GETREQ	(1 << 0)
+
 /* Device ioctls: */
 #define FUSE_DEV_IOC_MAGIC		229
 #define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, uint32_t)
 #define FUSE_DEV_IOC_BACKING_OPEN	_IOW(FUSE_DEV_IOC_MAGIC, 1, \
 					     struct fuse_backing_map)
 #define FUSE_DEV_IOC_BACKING_CLOSE	_IOW(FUSE_DEV_IOC_MAGIC, 2, uint32_t)
+#define FUSE_DEV_IOC_RING		_IOW(FUSE_DEV_IOC_MAGIC, 3, \
+					     struct fuse_ring_setup)
+#define FUSE_DEV_IOC_RING_ENTER		_IOW(FUSE_DEV_IOC_MAGIC, 4, uint32_t)
 
 struct fuse_lseek_in {
 	uint64_t	fh;
@@ -131,6 +131,7 @@ struct tpacket_auxdata {
 
 /* Rx ring - feature request bits */
 #define TP_FT_REQ_FILL_RXHASH	0x1
+#define TP_FT_REQ_PERCPU_BLK	0x2
 
 struct tpacket_hdr {
 	unsigned long	tp_status;
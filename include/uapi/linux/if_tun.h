@@ -69,6 +69,8 @@
 #define IFF_NAPI_FRAGS	0x0020
 /* Used in TUNSETIFF to bring up tun/tap without carrier */
 #define IFF_NO_CARRIER	0x0040
+/* read() and write() carry several packets, each after a struct tun_mpkt_hdr */
+#define IFF_MULTI_PKT	0x0080
 #define IFF_NO_PI	0x1000
 /* This flag has no real effect */
 #define IFF_ONE_QUEUE	0x2000
@@ -100,6 +102,11 @@ struct tun_pi {
 	__be16 proto;
 };
 
+/* Length of the next packet, including tun_pi and vnet header (IFF_MULTI_PKT) */
+struct tun_mpkt_hdr {
+	__u32 len;
+};
+
 /*
  * Filter spec (used for SETXXFILTER ioctls)
  * This stuff is applicable only to the TAP (Ethernet) devices.
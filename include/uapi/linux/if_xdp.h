@@ -31,6 +31,13 @@
  * such frames will be dropped.
  */
 #define XDP_USE_SG	(1 << 4)
+/* Together with XDP_SHARED_UMEM, bind to another queue of the same
+ * netdev, taking buffers from the fill ring of the socket whose umem is
+ * shared instead of from a fill ring of its own.  Queues that see more
+ * traffic then simply consume more of the shared fill ring.  The socket
+ * still needs its own completion ring.
+ */
+#define XDP_SHARED_FQ	(1 << 5)
 
 /* Flags for xsk_umem_config flags */
 #define XDP_UMEM_UNALIGNED_CHUNK_FLAG	(1 << 0)
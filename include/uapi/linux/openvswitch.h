@@ -112,7 +112,7 @@ struct ovs_dp_megaflow_stats {
 	__u32 n_masks;		 /* Number of masks for the datapath. */
 	__u32 pad0;		 /* Pad for future expension. */
 	__u64 n_cache_hit;       /* Number of cache matches for flow lookups. */
-	__u64 pad1;		 /* Pad for future expension. */
+	__u64 n_emc_hit;	 /* Number of exact match cache hits. */
 };
 
 struct ovs_vport_stats {
@@ -138,6 +138,9 @@ struct ovs_vport_stats {
 /* Allow per-cpu dispatch of upcalls */
 #define OVS_DP_F_DISPATCH_UPCALL_PER_CPU	(1 << 3)
 
+/* Look up flows in a per-cpu exact match cache before the mask lookup */
+#define OVS_DP_F_EXACT_MATCH_CACHE	(1 << 4)
+
 /* Fixed logical ports. */
 #define OVSP_LOCAL      ((__u32)0)
 
@@ -460,7 +460,8 @@ struct perf_event_attr {
 				inherit_thread :  1, /* children only inherit if cloned with CLONE_THREAD */
 				remove_on_exec :  1, /* event is removed from task on exec */
 				sigtrap        :  1, /* send synchronous SIGTRAP on event */
-				__reserved_1   : 26;
+				callchain_dedup:  1, /* write repeated callchains as stack ids */
+				__reserved_1   : 25;
 
 	union {
 		__u32		wakeup_events;	  /* wakeup every n events */
@@ -969,6 +970,9 @@ enum perf_event_type {
 	 *	{ u64			nr,
 	 *	  u64			ips[nr];  } && PERF_SAMPLE_CALLCHAIN
 	 *
+	 *	With attr::callchain_dedup, ips[] may start with
+	 *	PERF_CONTEXT_STACK_ID, see enum perf_callchain_context.
+	 *
 	 *	#
 	 *	# The RAW record below is opaque data wrt the ABI
 	 *	#
@@ -1248,6 +1252,16 @@ enum perf_callchain_context {
 	PERF_CONTEXT_KERNEL		= (__u64)-128,
 	PERF_CONTEXT_USER		= (__u64)-512,
 
+	/*
+	 * With attr::callchain_dedup, a callchain starting with
+	 * { PERF_CONTEXT_STACK_ID, id } is either { ..., id, ips[] }, which
+	 * defines @id as ips[], or just { ..., id } (nr == 2), which repeats
+	 * the callchain an earlier record in the same ring buffer defined
+	 * as @id.  Ids are never 0, { ..., 0 } is a callchain that was lost
+	 * because the event was redirected to another ring buffer.
+	 */
+	PERF_CONTEXT_STACK_ID		= (__u64)-1024,
+
 	PERF_CONTEXT_GUEST		= (__u64)-2048,
 	PERF_CONTEXT_GUEST_KERNEL	= (__u64)-2176,
 	PERF_CONTEXT_GUEST_USER		= (__u64)-2560,
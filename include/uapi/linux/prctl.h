@@ -328,4 +328,13 @@ struct prctl_mm_map {
 # define PR_PPC_DEXCR_CTRL_CLEAR_ONEXEC	0x10 /* Clear the aspect on exec */
 # define PR_PPC_DEXCR_CTRL_MASK		0x1f
 
+/* Per-process hash table for private futexes */
+#define PR_FUTEX_HASH			74
+# define PR_FUTEX_HASH_SET_PRIVATE	1 /* arg3: expected number of threads */
+# define PR_FUTEX_HASH_GET_SLOTS	2
+
+/* Copy the page tables of large anonymous mappings in parallel on fork */
+#define PR_SET_PARALLEL_FORK		75
+#define PR_GET_PARALLEL_FORK		76
+
 #endif /* _LINUX_PRCTL_H */
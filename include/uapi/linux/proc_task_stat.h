@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_PROC_TASK_STAT_H
+#define _UAPI_LINUX_PROC_TASK_STAT_H
+
+#include <linux/types.h>
+
+/*
+ * Records read from /proc/task_stat, one per thread group visible in the
+ * pid namespace of the procfs mount, in ascending tgid order.
+ *
+ * A read() returns as many whole records as fit in the buffer, and fails
+ * with EINVAL if not even one fits.  The file position is the tgid to
+ * resume from, so a reader can lseek() to a tgid and start there.
+ *
+ * New fields are only added at the end of the record, with a new version.
+ * Readers must step from one record to the next by @size.
+ */
+
+#define PROC_TASK_STAT_VERSION	1
+
+/* The I/O accounting fields are valid, the reader may ptrace the task */
+#define PROC_TASK_STAT_IO	(1U << 0)
+
+struct proc_task_stat {
+	__u32	size;
+	__u32	version;
+	__u32	flags;			/* PROC_TASK_STAT_* */
+	__s32	pid;			/* tgid */
+	__s32	ppid;
+	__s32	pgid;
+	__s32	sid;
+	__u32	state;			/* index into "RSDTtXZPI" */
+	__u32	task_flags;		/* PF_* of the group leader */
+	__s32	prio;
+	__s32	nice;
+	__u32	num_threads;
+	char	comm[16];
+
+	/* Times in ns, start_time since boot */
+	__u64	start_time;
+	__u64	utime;
+	__u64	stime;
+	__u64	cutime;
+	__u64	cstime;
+
+	__u64	min_flt;
+	__u64	maj_flt;
+	__u64	nvcsw;
+	__u64	nivcsw;
+	__u64	vsize;			/* bytes */
+	__u64	rss;			/* pages */
+
+	/* As in /proc/<pid>/io */
+	__u64	rchar;
+	__u64	wchar;
+	__u64	syscr;
+	__u64	syscw;
+	__u64	read_bytes;
+	__u64	write_bytes;
+	__u64	cancelled_write_bytes;
+};
+
+#endif /* _UAPI_LINUX_PROC_TASK_STAT_H */
@@ -302,6 +302,12 @@ enum
 	LINUX_MIB_TCPAOKEYNOTFOUND,		/* TCPAOKeyNotFound */
 	LINUX_MIB_TCPAOGOOD,			/* TCPAOGood */
 	LINUX_MIB_TCPAODROPPEDICMPS,		/* TCPAODroppedIcmps */
+	LINUX_MIB_TCPEHASHCACHEHIT,		/* TCPEhashCacheHit */
+	LINUX_MIB_TCPEHASHCACHEMISS,		/* TCPEhashCacheMiss */
+	LINUX_MIB_TCPCONNECTPROBES1,		/* TCPConnectProbes1 */
+	LINUX_MIB_TCPCONNECTPROBES16,		/* TCPConnectProbes16 */
+	LINUX_MIB_TCPCONNECTPROBES256,		/* TCPConnectProbes256 */
+	LINUX_MIB_TCPCONNECTPROBESMORE,		/* TCPConnectProbesMore */
 	__LINUX_MIB_MAX
 };
 
@@ -358,6 +364,10 @@ enum
 	LINUX_MIB_TLSRXDEVICERESYNC,		/* TlsRxDeviceResync */
 	LINUX_MIB_TLSDECRYPTRETRY,		/* TlsDecryptRetry */
 	LINUX_MIB_TLSRXNOPADVIOL,		/* TlsRxNoPadViolation */
+	LINUX_MIB_TLSRXZEROCOPY,		/* TlsRxZeroCopy */
+	LINUX_MIB_TLSRXZEROCOPYBYTES,		/* TlsRxZeroCopyBytes */
+	LINUX_MIB_TLSRXCOPY,			/* TlsRxCopy */
+	LINUX_MIB_TLSRXSTRPCOPY,		/* TlsRxStrpCopy */
 	__LINUX_MIB_TLSMAX
 };
 
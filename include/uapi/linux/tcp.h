@@ -471,6 +471,10 @@ struct tcp_ao_repair { /* {s,g}etsockopt(TCP_AO_REPAIR) */
 /* setsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, ...) */
 
 #define TCP_RECEIVE_ZEROCOPY_FLAG_TLB_CLEAN_HINT 0x1
+/* Copy unaligned data in front of the mapped pages into the copybuf too,
+ * copybuf_head_len reports how much of the copybuf precedes the mapping.
+ */
+#define TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD 0x2
 struct tcp_zerocopy_receive {
 	__u64 address;		/* in: address of mapping */
 	__u32 length;		/* in/out: number of bytes to map/mapped */
@@ -484,5 +488,7 @@ struct tcp_zerocopy_receive {
 	__u64 msg_controllen;
 	__u32 msg_flags;
 	__u32 reserved; /* set to 0 for now */
+	__u32 copybuf_head_len; /* out: copybuf bytes before the mapping */
+	__u32 reserved2; /* set to 0 for now */
 };
 #endif /* _UAPI_LINUX_TCP_H */
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_TMPFS_H
+#define _UAPI_LINUX_TMPFS_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * Folio orders of a tmpfs file: bit n set allows folios of 2^n pages.
+ * Allocation tries the highest allowed order that fits first and falls
+ * back to lower ones, order 0 always being the last resort.  0 means the
+ * file follows the huge= mount option and the shmem_enabled policies.  Files
+ * on a huge=never mount only get order 0, whatever their mask.
+ */
+#define TMPFS_IOC_GET_FOLIO_ORDERS	_IOR(0xe8, 1, __u64)
+#define TMPFS_IOC_SET_FOLIO_ORDERS	_IOW(0xe8, 1, __u64)
+
+#endif /* _UAPI_LINUX_TMPFS_H */
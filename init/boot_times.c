@@ -0,0 +1,147 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Boot phase and initcall timing report.
+ *
+ * start_kernel() and kernel_init() mark the end of each boot phase, and
+ * every built-in initcall is recorded with its level, start, duration and
+ * return value.  Both are shown in /sys/kernel/debug/boot_times/
+ * so that boot time regressions can be tracked without initcall_debug.
+ */
+
+#include <linux/boot_times.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+
+#define BOOT_TIMES_MAX_PHASES	32
+
+struct boot_phase {
+	const char *name;
+	u64 end_ns;
+};
+
+struct boot_initcall {
+	struct list_head list;
+	const char *name;
+	int level;
+	int ret;
+	u64 start_ns;
+	u64 duration_ns;
+};
+
+static struct boot_phase boot_phases[BOOT_TIMES_MAX_PHASES];
+static unsigned int nr_boot_phases;
+
+static LIST_HEAD(boot_initcalls);
+static DEFINE_MUTEX(boot_initcalls_lock);
+static unsigned int boot_initcalls_dropped;
+
+/* Copy of initcall_level_names[], which is __initdata. */
+static const char * const boot_initcall_levels[] = {
+	"pure", "core", "postcore", "arch", "subsys", "fs", "device", "late",
+};
+
+/*
+ * Phases are marked in order by the boot CPU and then by init, the report
+ * may be read concurrently.
+ */
+void boot_times_phase(const char *name)
+{
+	unsigned int nr = nr_boot_phases;
+
+	if (WARN_ON_ONCE(nr >= BOOT_TIMES_MAX_PHASES))
+		return;
+
+	boot_phases[nr].name = name;
+	boot_phases[nr].end_ns = local_clock();
+	smp_store_release(&nr_boot_phases, nr + 1);
+}
+
+void boot_times_initcall(initcall_t fn, int level, int ret, u64 start_ns)
+{
+	u64 end_ns = local_clock();
+	struct boot_initcall *bi;
+
+	bi = kmalloc(sizeof(*bi), GFP_KERNEL);
+	if (bi)
+		/* Init text is freed before the report is read. */
+		bi->name = kasprintf(GFP_KERNEL, "%ps", fn);
+	if (!bi || !bi->name) {
+		kfree(bi);
+		mutex_lock(&boot_initcalls_lock);
+		boot_initcalls_dropped++;
+		mutex_unlock(&boot_initcalls_lock);
+		return;
+	}
+
+	bi->level = level;
+	bi->ret = ret;
+	bi->start_ns = start_ns;
+	bi->duration_ns = end_ns - start_ns;
+
+	mutex_lock(&boot_initcalls_lock);
+	list_add_tail(&bi->list, &boot_initcalls);
+	mutex_unlock(&boot_initcalls_lock);
+}
+
+static const char *boot_initcall_level(int level)
+{
+	if (level >= 0 && level < ARRAY_SIZE(boot_initcall_levels))
+		return boot_initcall_levels[level];
+	return "early";
+}
+
+static int boot_phases_show(struct seq_file *m, void *v)
+{
+	unsigned int i, nr = smp_load_acquire(&nr_boot_phases);
+	u64 prev_ns = 0;
+
+	seq_printf(m, "%-24s %14s %14s\n", "# phase", "end_us", "duration_us");
+	for (i = 0; i < nr; i++) {
+		const struct boot_phase *p = &boot_phases[i];
+
+		seq_printf(m, "%-24s %14llu %14llu\n", p->name,
+			   div_u64(p->end_ns, NSEC_PER_USEC),
+			   div_u64(p->end_ns - prev_ns, NSEC_PER_USEC));
+		prev_ns = p->end_ns;
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(boot_phases);
+
+static int boot_initcalls_show(struct seq_file *m, void *v)
+{
+	struct boot_initcall *bi;
+
+	mutex_lock(&boot_initcalls_lock);
+	seq_printf(m, "%-8s %14s %14s %6s %s\n", "# level", "start_us",
+		   "duration_us", "ret", "function");
+	list_for_each_entry(bi, &boot_initcalls, list) {
+		seq_printf(m, "%-8s %14llu %14llu %6d %s\n",
+			   boot_initcall_level(bi->level),
+			   div_u64(bi->start_ns, NSEC_PER_USEC),
+			   div_u64(bi->duration_ns, NSEC_PER_USEC),
+			   bi->ret, bi->name);
+	}
+	if (boot_initcalls_dropped)
+		seq_printf(m, "# %u initcalls not recorded\n",
+			   boot_initcalls_dropped);
+	mutex_unlock(&boot_initcalls_lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(boot_initcalls);
+
+static int __init boot_times_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("boot_times", NULL);
+
+	debugfs_create_file("phases", 0400, dir, NULL, &boot_phases_fops);
+	debugfs_create_file("initcalls", 0400, dir, NULL, &boot_initcalls_fops);
+	return 0;
+}
+late_initcall(boot_times_debugfs_init);
@@ -83,6 +83,7 @@
 #include <linux/ptrace.h>
 #include <linux/pti.h>
 #include <linux/blkdev.h>
+#include <linux/boot_times.h>
 #include <linux/sched/clock.h>
 #include <linux/sched/task.h>
 #include <linux/sched/task_stack.h>
@@ -923,6 +924,7 @@ void start_kernel(void)
 	page_address_init();
 	pr_notice("%s", linux_banner);
 	setup_arch(&command_line);
+	boot_times_phase("setup_arch");
 	/* Static keys and static calls are needed by LSMs */
 	jump_label_init();
 	static_call_init();
@@ -962,6 +964,7 @@ void start_kernel(void)
 	sort_main_extable();
 	trap_init();
 	mm_core_init();
+	boot_times_phase("mm_core_init");
 	poking_init();
 	ftrace_init();
 
@@ -1102,6 +1105,7 @@ void start_kernel(void)
 	kcsan_init();
 
 	/* Do the rest non-__init'ed, we're now alive */
+	boot_times_phase("start_kernel");
 	rest_init();
 
 	/*
@@ -1327,8 +1331,12 @@ static void __init do_initcall_level(int level, char *command_line)
 		   NULL, ignore_unknown_bootoption);
 
 	trace_initcall_level(initcall_level_names[level]);
-	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
-		do_one_initcall(initcall_from_entry(fn));
+	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++) {
+		u64 start = boot_times_clock();
+		int ret = do_one_initcall(initcall_from_entry(fn));
+
+		boot_times_initcall(initcall_from_entry(fn), level, ret, start);
+	}
 }
 
 static void __init do_initcalls(void)
@@ -1371,8 +1379,13 @@ static void __init do_pre_smp_initcalls(void)
 	initcall_entry_t *fn;
 
 	trace_initcall_level("early");
-	for (fn = __initcall_start; fn < __initcall0_start; fn++)
-		do_one_initcall(initcall_from_entry(fn));
+	for (fn = __initcall_start; fn < __initcall0_start; fn++) {
+		u64 start = boot_times_clock();
+		int ret = do_one_initcall(initcall_from_entry(fn));
+
+		boot_times_initcall(initcall_from_entry(fn),
+				    BOOT_TIMES_LEVEL_EARLY, ret, start);
+	}
 }
 
 static int run_init_process(const char *init_filename)
@@ -1469,6 +1482,7 @@ static int __ref kernel_init(void *unused)
 	kernel_init_freeable();
 	/* need to finish all async __init code before freeing the memory */
 	async_synchronize_full();
+	boot_times_phase("async_init");
 
 	system_state = SYSTEM_FREEING_INITMEM;
 	kprobe_free_init_mem();
@@ -1488,6 +1502,7 @@ static int __ref kernel_init(void *unused)
 	numa_default_policy();
 
 	rcu_end_inkernel_boot();
+	boot_times_phase("free_initmem");
 
 	do_sysctl_args();
 
@@ -1571,13 +1586,16 @@ static noinline void __init kernel_init_freeable(void)
 
 	smp_init();
 	sched_init_smp();
+	boot_times_phase("smp_init");
 
 	workqueue_init_topology();
 	async_init();
 	padata_init();
 	page_alloc_init_late();
+	boot_times_phase("page_alloc_init_late");
 
 	do_basic_setup();
+	boot_times_phase("initcalls");
 
 	kunit_run_all_tests();
 
@@ -1603,4 +1621,5 @@ static noinline void __init kernel_init_freeable(void)
 	 */
 
 	integrity_load_keys();
+	boot_times_phase("rootfs");
 }
@@ -40,6 +40,7 @@
 #include <linux/slab.h>
 #include <linux/err.h>
 #include <linux/kthread.h>
+#include <linux/llist.h>
 #include <linux/kernel.h>
 #include <linux/syscalls.h>
 #include <linux/spinlock.h>
@@ -146,6 +147,9 @@ static struct kmem_cache *audit_buffer_cache;
 
 /* queue msgs to send via kauditd_task */
 static struct sk_buff_head audit_queue;
+/* msgs from audit_log_end() not yet moved to audit_queue, newest first */
+static LLIST_HEAD(audit_queue_new);
+static atomic_t audit_queue_new_len = ATOMIC_INIT(0);
 /* queue msgs due to temporary unicast send problems */
 static struct sk_buff_head audit_retry_queue;
 /* queue msgs waiting for new auditd connection */
@@ -725,6 +729,42 @@ static int auditd_send_unicast_skb(struct sk_buff *skb)
 	return rc;
 }
 
+/**
+ * audit_backlog - Number of records waiting for kauditd
+ */
+static unsigned int audit_backlog(void)
+{
+	return skb_queue_len(&audit_queue) + atomic_read(&audit_queue_new_len);
+}
+
+/**
+ * kauditd_splice_new - Move the records from audit_log_end() to audit_queue
+ *
+ * Description:
+ * Records are collected locklessly by audit_log_end() and moved to the main
+ * queue in one batch, in the order they were logged.
+ */
+static void kauditd_splice_new(void)
+{
+	struct llist_node *node;
+	struct sk_buff *skb, *tmp;
+	unsigned long flags;
+	int n = 0;
+
+	node = llist_del_all(&audit_queue_new);
+	if (!node)
+		return;
+	node = llist_reverse_order(node);
+
+	spin_lock_irqsave(&audit_queue.lock, flags);
+	llist_for_each_entry_safe(skb, tmp, node, ll_node) {
+		__skb_queue_tail(&audit_queue, skb);
+		n++;
+	}
+	spin_unlock_irqrestore(&audit_queue.lock, flags);
+	atomic_sub(n, &audit_queue_new_len);
+}
+
 /**
  * kauditd_send_queue - Helper for kauditd_thread to flush skb queues
  * @sk: the sending sock
@@ -883,6 +923,8 @@ static int kauditd_thread(void *dummy)
 		}
 
 main_queue:
+		kauditd_splice_new();
+
 		/* process the main queue - do the multicast send and attempt
 		 * unicast, dump failed record sends to the retry queue; if
 		 * sk == NULL due to previous failures we will just do the
@@ -909,7 +951,8 @@ static int kauditd_thread(void *dummy)
 		 *       do the multicast send and rotate records from the
 		 *       main queue to the retry/hold queues */
 		wait_event_freezable(kauditd_wait,
-				     (skb_queue_len(&audit_queue) ? 1 : 0));
+				     (skb_queue_len(&audit_queue) ||
+				      !llist_empty(&audit_queue_new)));
 	}
 
 	return 0;
@@ -1244,7 +1287,7 @@ static int audit_receive_msg(struct sk_buff *skb, struct nlmsghdr *nlh,
 		s.rate_limit		   = audit_rate_limit;
 		s.backlog_limit		   = audit_backlog_limit;
 		s.lost			   = atomic_read(&audit_lost);
-		s.backlog		   = skb_queue_len(&audit_queue);
+		s.backlog		   = audit_backlog();
 		s.feature_bitmap	   = AUDIT_FEATURE_BITMAP_ALL;
 		s.backlog_wait_time	   = audit_backlog_wait_time;
 		s.backlog_wait_time_actual = atomic_read(&audit_backlog_wait_time_actual);
@@ -1581,7 +1624,7 @@ static void audit_receive(struct sk_buff *skb)
 
 	/* can't block with the ctrl lock, so penalize the sender now */
 	if (audit_backlog_limit &&
-	    (skb_queue_len(&audit_queue) > audit_backlog_limit)) {
+	    (audit_backlog() > audit_backlog_limit)) {
 		DECLARE_WAITQUEUE(wait, current);
 
 		/* wake kauditd to try and flush the queue */
@@ -1881,7 +1924,7 @@ struct audit_buffer *audit_log_start(struct audit_context *ctx, gfp_t gfp_mask,
 		long stime = audit_backlog_wait_time;
 
 		while (audit_backlog_limit &&
-		       (skb_queue_len(&audit_queue) > audit_backlog_limit)) {
+		       (audit_backlog() > audit_backlog_limit)) {
 			/* wake kauditd to try and flush the queue */
 			wake_up_interruptible(&kauditd_wait);
 
@@ -1901,7 +1944,7 @@ struct audit_buffer *audit_log_start(struct audit_context *ctx, gfp_t gfp_mask,
 			} else {
 				if (audit_rate_check() && printk_ratelimit())
 					pr_warn("audit_backlog=%d > audit_backlog_limit=%d\n",
-						skb_queue_len(&audit_queue),
+						audit_backlog(),
 						audit_backlog_limit);
 				audit_log_lost("backlog limit exceeded");
 				return NULL;
@@ -2418,6 +2461,9 @@ int audit_signal_info(int sig, struct task_struct *t)
  * arg, flags, is not set to MSG_DONTWAIT), so the audit buffer is placed on a
  * queue and a kthread is scheduled to remove them from the queue outside the
  * irq context.  May be called in any context.
+ *
+ * The queue is a lockless list, and kauditd is only woken by the record that
+ * makes it non-empty; the rest are picked up in the same batch.
  */
 void audit_log_end(struct audit_buffer *ab)
 {
@@ -2437,8 +2483,9 @@ void audit_log_end(struct audit_buffer *ab)
 		nlh->nlmsg_len = skb->len - NLMSG_HDRLEN;
 
 		/* queue the netlink packet and poke the kauditd thread */
-		skb_queue_tail(&audit_queue, skb);
-		wake_up_interruptible(&kauditd_wait);
+		atomic_inc(&audit_queue_new_len);
+		if (llist_add(&skb->ll_node, &audit_queue_new))
+			wake_up_interruptible(&kauditd_wait);
 	} else
 		audit_log_lost("rate limit exceeded");
 
@@ -253,6 +253,54 @@ static void arena_vm_close(struct vm_area_struct *vma)
 
 #define MT_ENTRY ((void *)&arena_map_ops) /* unused. has to be valid pointer */
 
+/* Aligned window of pages mapped together on a user fault */
+#define ARENA_FAULT_AROUND_PAGES 16
+
+/*
+ * Map the pages already allocated around a faulting address into the user
+ * vma, in runs of contiguous pages, so that user space touching an arena
+ * populated by bpf_arena_alloc_pages() does not fault on every page.
+ * Nothing is allocated here, holes stay holes.
+ */
+static void arena_fault_around(struct bpf_arena *arena, struct vm_fault *vmf)
+{
+	struct page *pages[ARENA_FAULT_AROUND_PAGES];
+	unsigned long fault_addr = vmf->address & PAGE_MASK;
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long start, end, addr, run, nr, left;
+	long kbase = bpf_arena_get_kern_vm_start(arena);
+	struct page *page;
+	int err;
+
+	start = ALIGN_DOWN(fault_addr, ARENA_FAULT_AROUND_PAGES * PAGE_SIZE);
+	end = min(start + ARENA_FAULT_AROUND_PAGES * PAGE_SIZE, vma->vm_end);
+	start = max(start, vma->vm_start);
+
+	for (addr = start; addr < end;) {
+		for (run = addr, nr = 0; addr < end && addr != fault_addr;
+		     addr += PAGE_SIZE, nr++) {
+			page = vmalloc_to_page((void *)kbase + (u32)addr);
+			if (!page)
+				break;
+			pages[nr] = page;
+		}
+		if (!nr) {
+			/* a hole, or the page the fault itself maps */
+			addr += PAGE_SIZE;
+			continue;
+		}
+
+		left = nr;
+		err = vm_insert_pages(vma, run, pages, &left);
+		if (!err)
+			continue;
+		if (err != -EBUSY)
+			return;
+		/* already mapped by an earlier fault, go on after it */
+		addr = run + (nr - left + 1) * PAGE_SIZE;
+	}
+}
+
 static vm_fault_t arena_vm_fault(struct vm_fault *vmf)
 {
 	struct bpf_map *map = vmf->vma->vm_file->private_data;
@@ -294,6 +342,7 @@ static vm_fault_t arena_vm_fault(struct vm_fault *vmf)
 out:
 	page_ref_add(page, 1);
 	vmf->page = page;
+	arena_fault_around(arena, vmf);
 	return 0;
 }
 
@@ -369,9 +418,11 @@ static int arena_map_mmap(struct bpf_map *map, struct vm_area_struct *vma)
 	/*
 	 * bpf_map_mmap() checks that it's being mmaped as VM_SHARED and
 	 * clears VM_MAYEXEC. Set VM_DONTEXPAND as well to avoid
-	 * potential change of user_vm_start.
+	 * potential change of user_vm_start. VM_MIXEDMAP lets
+	 * arena_fault_around() insert pages with only the mmap or vma
+	 * read lock held.
 	 */
-	vm_flags_set(vma, VM_DONTEXPAND);
+	vm_flags_set(vma, VM_DONTEXPAND | VM_MIXEDMAP);
 	vma->vm_ops = &arena_vm_ops;
 	return 0;
 }
@@ -21,7 +21,15 @@ static struct bpf_local_storage_map_bucket *
 select_bucket(struct bpf_local_storage_map *smap,
 	      struct bpf_local_storage_elem *selem)
 {
-	return &smap->buckets[hash_ptr(selem, smap->bucket_log)];
+	return &smap->buckets[selem->map_bucket];
+}
+
+static struct bpf_local_storage_data __rcu **
+storage_cache_set(struct bpf_local_storage *local_storage,
+		  struct bpf_local_storage_map *smap)
+{
+	return &local_storage->cache[smap->cache_idx *
+				     BPF_LOCAL_STORAGE_CACHE_WAYS];
 }
 
 static int mem_charge(struct bpf_local_storage_map *smap, void *owner, u32 size)
@@ -254,9 +262,11 @@ static bool bpf_selem_unlink_storage_nolock(struct bpf_local_storage *local_stor
 					    struct bpf_local_storage_elem *selem,
 					    bool uncharge_mem, bool reuse_now)
 {
+	struct bpf_local_storage_data __rcu **cache;
 	struct bpf_local_storage_map *smap;
 	bool free_local_storage;
 	void *owner;
+	int i;
 
 	smap = rcu_dereference_check(SDATA(selem)->smap, bpf_rcu_lock_held());
 	owner = local_storage->owner;
@@ -292,9 +302,10 @@ static bool bpf_selem_unlink_storage_nolock(struct bpf_local_storage *local_stor
 		 */
 	}
 	hlist_del_init_rcu(&selem->snode);
-	if (rcu_access_pointer(local_storage->cache[smap->cache_idx]) ==
-	    SDATA(selem))
-		RCU_INIT_POINTER(local_storage->cache[smap->cache_idx], NULL);
+	cache = storage_cache_set(local_storage, smap);
+	for (i = 0; i < BPF_LOCAL_STORAGE_CACHE_WAYS; i++)
+		if (rcu_access_pointer(cache[i]) == SDATA(selem))
+			RCU_INIT_POINTER(cache[i], NULL);
 
 	bpf_selem_free(selem, smap, reuse_now);
 
@@ -392,12 +403,20 @@ static void bpf_selem_unlink_map(struct bpf_local_storage_elem *selem)
 	raw_spin_unlock_irqrestore(&b->lock, flags);
 }
 
+/* The map buckets only track selems for map destruction, so a selem goes
+ * to the bucket of the CPU that creates it.  Storage created for new owners
+ * on different CPUs then does not contend on, or bounce, the same lock.
+ */
 void bpf_selem_link_map(struct bpf_local_storage_map *smap,
 			struct bpf_local_storage_elem *selem)
 {
-	struct bpf_local_storage_map_bucket *b = select_bucket(smap, selem);
+	struct bpf_local_storage_map_bucket *b;
 	unsigned long flags;
 
+	selem->map_bucket = raw_smp_processor_id() &
+			    ((1U << smap->bucket_log) - 1);
+	b = select_bucket(smap, selem);
+
 	raw_spin_lock_irqsave(&b->lock, flags);
 	RCU_INIT_POINTER(SDATA(selem)->smap, smap);
 	hlist_add_head_rcu(&selem->map_node, &b->list);
@@ -418,6 +437,8 @@ void __bpf_local_storage_insert_cache(struct bpf_local_storage *local_storage,
 				      struct bpf_local_storage_map *smap,
 				      struct bpf_local_storage_elem *selem)
 {
+	struct bpf_local_storage_data __rcu **cache;
+	struct bpf_local_storage_data *mru;
 	unsigned long flags;
 
 	/* spinlock is needed to avoid racing with the
@@ -426,8 +447,23 @@ void __bpf_local_storage_insert_cache(struct bpf_local_storage *local_storage,
 	 * problem in the next bpf_local_storage_lookup().
 	 */
 	raw_spin_lock_irqsave(&local_storage->lock, flags);
-	if (selem_linked_to_storage(selem))
-		rcu_assign_pointer(local_storage->cache[smap->cache_idx], SDATA(selem));
+	if (!selem_linked_to_storage(selem))
+		goto unlock;
+
+	/* Insert in the first way and move what was there to the second,
+	 * evicting the least recently inserted map of the set.
+	 */
+	cache = storage_cache_set(local_storage, smap);
+	mru = rcu_dereference_protected(cache[0],
+					lockdep_is_held(&local_storage->lock));
+	if (mru == SDATA(selem))
+		goto unlock;
+	if (mru)
+		RCU_INIT_POINTER(cache[1], mru);
+	else if (rcu_access_pointer(cache[1]) == SDATA(selem))
+		RCU_INIT_POINTER(cache[1], NULL);
+	rcu_assign_pointer(cache[0], SDATA(selem));
+unlock:
 	raw_spin_unlock_irqrestore(&local_storage->lock, flags);
 }
 
@@ -643,7 +679,7 @@ static u16 bpf_local_storage_cache_idx_get(struct bpf_local_storage_cache *cache
 
 	spin_lock(&cache->idx_lock);
 
-	for (i = 0; i < BPF_LOCAL_STORAGE_CACHE_SIZE; i++) {
+	for (i = 0; i < BPF_LOCAL_STORAGE_CACHE_SETS; i++) {
 		if (cache->idx_usage_counts[i] < min_usage) {
 			min_usage = cache->idx_usage_counts[i];
 			res = i;
@@ -778,7 +814,7 @@ bpf_local_storage_map_alloc(union bpf_attr *attr,
 	bpf_map_init_from_attr(&smap->map, attr);
 
 	nbuckets = roundup_pow_of_two(num_possible_cpus());
-	/* Use at least 2 buckets, select_bucket() is undefined behavior with 1 bucket */
+	/* Use at least 2 buckets, one per CPU when there are enough */
 	nbuckets = max_t(u32, 2, nbuckets);
 	smap->bucket_log = ilog2(nbuckets);
 
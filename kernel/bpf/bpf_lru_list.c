@@ -2,6 +2,7 @@
 /* Copyright (c) 2016 Facebook
  */
 #include <linux/cpumask.h>
+#include <linux/jiffies.h>
 #include <linux/spinlock.h>
 #include <linux/percpu.h>
 
@@ -94,6 +95,7 @@ static void __bpf_lru_node_move_in(struct bpf_lru_list *l,
 
 	bpf_lru_list_count_inc(l, tgt_type);
 	node->type = tgt_type;
+	node->stamp = jiffies;
 	bpf_lru_node_clear_ref(node);
 	list_move(&node->list, &l->lists[tgt_type]);
 }
@@ -115,6 +117,8 @@ static void __bpf_lru_node_move(struct bpf_lru_list *l,
 		bpf_lru_list_count_inc(l, tgt_type);
 		node->type = tgt_type;
 	}
+	if (tgt_type == BPF_LRU_LIST_T_ACTIVE && bpf_lru_node_is_ref(node))
+		node->stamp = jiffies;
 	bpf_lru_node_clear_ref(node);
 
 	/* If the moving node is the next_inactive_rotation candidate,
@@ -320,27 +324,42 @@ static void bpf_lru_list_push_free(struct bpf_lru_list *l,
 	raw_spin_unlock_irqrestore(&l->lock, flags);
 }
 
-static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
-					   struct bpf_lru_locallist *loc_l)
+/* Move up to @tgt_nfree nodes from the free list of @l to the local list */
+static unsigned int __local_list_take_free(struct bpf_lru_list *l,
+					   struct bpf_lru_locallist *loc_l,
+					   unsigned int tgt_nfree)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
 	struct bpf_lru_node *node, *tmp_node;
 	unsigned int nfree = 0;
 
-	raw_spin_lock(&l->lock);
-
-	__local_list_flush(l, loc_l);
-
-	__bpf_lru_list_rotate(lru, l);
+	if (!tgt_nfree)
+		return 0;
 
 	list_for_each_entry_safe(node, tmp_node, &l->lists[BPF_LRU_LIST_T_FREE],
 				 list) {
 		__bpf_lru_node_move_to_free(l, node, local_free_list(loc_l),
 					    BPF_LRU_LOCAL_LIST_T_FREE);
-		if (++nfree == LOCAL_FREE_TARGET)
+		if (++nfree == tgt_nfree)
 			break;
 	}
 
+	return nfree;
+}
+
+static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
+					   struct bpf_lru_locallist *loc_l)
+{
+	struct bpf_lru_list *l = &lru->common_lru.lru_list;
+	unsigned int nfree;
+
+	raw_spin_lock(&l->lock);
+
+	__local_list_flush(l, loc_l);
+
+	__bpf_lru_list_rotate(lru, l);
+
+	nfree = __local_list_take_free(l, loc_l, LOCAL_FREE_TARGET);
+
 	if (nfree < LOCAL_FREE_TARGET)
 		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
 				      local_free_list(loc_l),
@@ -349,6 +368,94 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 	raw_spin_unlock(&l->lock);
 }
 
+/* The stamp of the node @l would evict first, if it has one */
+static bool bpf_lru_list_tail_stamp(const struct bpf_lru_list *l, u32 *stamp)
+{
+	const struct list_head *h = &l->lists[BPF_LRU_LIST_T_INACTIVE];
+
+	if (list_empty(h))
+		h = &l->lists[BPF_LRU_LIST_T_ACTIVE];
+	if (list_empty(h))
+		return false;
+
+	*stamp = list_last_entry(h, struct bpf_lru_node, list)->stamp;
+	return true;
+}
+
+/* Whether the coldest node of @a is older than the coldest node of @b */
+static bool bpf_lru_list_colder(const struct bpf_lru_list *a,
+				const struct bpf_lru_list *b)
+{
+	u32 sa, sb;
+
+	if (!bpf_lru_list_tail_stamp(a, &sa))
+		return false;
+	if (!bpf_lru_list_tail_stamp(b, &sb))
+		return true;
+	return (s32)(sa - sb) < 0;
+}
+
+/* Sharded LRU: like bpf_lru_list_pop_free_to_local(), but each CPU has its
+ * own LRU list (shard), flushes its pending nodes there and only ever
+ * waits for that shard's lock.
+ *
+ * To approximate a global LRU, each refill also samples the shard of one
+ * other CPU, round robin, with a trylock.  Its free nodes are taken, and
+ * if its coldest node is older than the home shard's coldest, nodes are
+ * evicted from that shard instead of the home one.  The nodes then move
+ * to this CPU, so shards of CPUs that insert a lot grow at the expense of
+ * shards of CPUs that hold old entries.
+ */
+static void bpf_lru_shard_pop_free_to_local(struct bpf_lru *lru,
+					    struct bpf_lru_locallist *loc_l,
+					    int cpu)
+{
+	struct bpf_common_lru *clru = &lru->common_lru;
+	struct bpf_lru_list *l = per_cpu_ptr(clru->shards, cpu), *remote;
+	unsigned int nfree;
+	bool evicted = false;
+	int rcpu;
+
+	raw_spin_lock(&l->lock);
+
+	__local_list_flush(l, loc_l);
+
+	__bpf_lru_list_rotate(lru, l);
+
+	nfree = __local_list_take_free(l, loc_l, LOCAL_FREE_TARGET);
+	if (nfree == LOCAL_FREE_TARGET)
+		goto out;
+
+	rcpu = get_next_cpu(loc_l->next_shard);
+	if (rcpu == cpu)
+		rcpu = get_next_cpu(rcpu);
+	loc_l->next_shard = rcpu;
+	remote = per_cpu_ptr(clru->shards, rcpu);
+
+	if (rcpu != cpu && raw_spin_trylock(&remote->lock)) {
+		nfree += __local_list_take_free(remote, loc_l,
+						LOCAL_FREE_TARGET - nfree);
+		if (nfree < LOCAL_FREE_TARGET &&
+		    bpf_lru_list_colder(remote, l)) {
+			__bpf_lru_list_rotate(lru, remote);
+			nfree += __bpf_lru_list_shrink(lru, remote,
+						       LOCAL_FREE_TARGET - nfree,
+						       local_free_list(loc_l),
+						       BPF_LRU_LOCAL_LIST_T_FREE);
+			evicted = true;
+		}
+		raw_spin_unlock(&remote->lock);
+	}
+
+	if (nfree < LOCAL_FREE_TARGET && !evicted)
+		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
+				      local_free_list(loc_l),
+				      BPF_LRU_LOCAL_LIST_T_FREE);
+
+out:
+	raw_spin_unlock(&l->lock);
+}
+
 static void __local_list_add_pending(struct bpf_lru *lru,
 				     struct bpf_lru_locallist *loc_l,
 				     int cpu,
@@ -449,7 +556,10 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 
 	node = __local_list_pop_free(loc_l);
 	if (!node) {
-		bpf_lru_list_pop_free_to_local(lru, loc_l);
+		if (lru->sharded)
+			bpf_lru_shard_pop_free_to_local(lru, loc_l, cpu);
+		else
+			bpf_lru_list_pop_free_to_local(lru, loc_l);
 		node = __local_list_pop_free(loc_l);
 	}
 
@@ -535,7 +645,11 @@ static void bpf_common_lru_push_free(struct bpf_lru *lru,
 	}
 
 check_lru_list:
-	bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
+	if (lru->sharded)
+		bpf_lru_list_push_free(per_cpu_ptr(lru->common_lru.shards,
+						   node->cpu), node);
+	else
+		bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
 }
 
 static void bpf_percpu_lru_push_free(struct bpf_lru *lru,
@@ -579,6 +693,28 @@ static void bpf_common_lru_populate(struct bpf_lru *lru, void *buf,
 	}
 }
 
+/* Spread the nodes evenly over the shards */
+static void bpf_sharded_lru_populate(struct bpf_lru *lru, void *buf,
+				     u32 node_offset, u32 elem_size,
+				     u32 nr_elems)
+{
+	int cpu = cpumask_first(cpu_possible_mask);
+	u32 i;
+
+	for (i = 0; i < nr_elems; i++) {
+		struct bpf_lru_list *l = per_cpu_ptr(lru->common_lru.shards, cpu);
+		struct bpf_lru_node *node;
+
+		node = (struct bpf_lru_node *)(buf + node_offset);
+		node->cpu = cpu;
+		node->type = BPF_LRU_LIST_T_FREE;
+		bpf_lru_node_clear_ref(node);
+		list_add(&node->list, &l->lists[BPF_LRU_LIST_T_FREE]);
+		buf += elem_size;
+		cpu = get_next_cpu(cpu);
+	}
+}
+
 static void bpf_percpu_lru_populate(struct bpf_lru *lru, void *buf,
 				    u32 node_offset, u32 elem_size,
 				    u32 nr_elems)
@@ -616,6 +752,9 @@ void bpf_lru_populate(struct bpf_lru *lru, void *buf, u32 node_offset,
 	if (lru->percpu)
 		bpf_percpu_lru_populate(lru, buf, node_offset, elem_size,
 					nr_elems);
+	else if (lru->sharded)
+		bpf_sharded_lru_populate(lru, buf, node_offset, elem_size,
+					 nr_elems);
 	else
 		bpf_common_lru_populate(lru, buf, node_offset, elem_size,
 					nr_elems);
@@ -629,6 +768,7 @@ static void bpf_lru_locallist_init(struct bpf_lru_locallist *loc_l, int cpu)
 		INIT_LIST_HEAD(&loc_l->lists[i]);
 
 	loc_l->next_steal = cpu;
+	loc_l->next_shard = cpu;
 
 	raw_spin_lock_init(&loc_l->lock);
 }
@@ -648,8 +788,9 @@ static void bpf_lru_list_init(struct bpf_lru_list *l)
 	raw_spin_lock_init(&l->lock);
 }
 
-int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
-		 del_from_htab_func del_from_htab, void *del_arg)
+int bpf_lru_init(struct bpf_lru *lru, bool percpu, bool sharded,
+		 u32 hash_offset, del_from_htab_func del_from_htab,
+		 void *del_arg)
 {
 	int cpu;
 
@@ -681,9 +822,23 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 
 		bpf_lru_list_init(&clru->lru_list);
 		lru->nr_scans = LOCAL_NR_SCANS;
+
+		clru->shards = NULL;
+		if (sharded) {
+			clru->shards = alloc_percpu(struct bpf_lru_list);
+			if (!clru->shards) {
+				free_percpu(clru->local_list);
+				return -ENOMEM;
+			}
+
+			for_each_possible_cpu(cpu)
+				bpf_lru_list_init(per_cpu_ptr(clru->shards,
+							      cpu));
+		}
 	}
 
 	lru->percpu = percpu;
+	lru->sharded = !percpu && sharded;
 	lru->del_from_htab = del_from_htab;
 	lru->del_arg = del_arg;
 	lru->hash_offset = hash_offset;
@@ -693,8 +848,10 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 
 void bpf_lru_destroy(struct bpf_lru *lru)
 {
-	if (lru->percpu)
+	if (lru->percpu) {
 		free_percpu(lru->percpu_lru);
-	else
+	} else {
+		free_percpu(lru->common_lru.shards);
 		free_percpu(lru->common_lru.local_list);
+	}
 }
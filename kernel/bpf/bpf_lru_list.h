@@ -26,6 +26,8 @@ struct bpf_lru_node {
 	u16 cpu;
 	u8 type;
 	u8 ref;
+	/* jiffies when last added or found referenced, for sharded LRUs */
+	u32 stamp;
 };
 
 struct bpf_lru_list {
@@ -40,12 +42,16 @@ struct bpf_lru_list {
 struct bpf_lru_locallist {
 	struct list_head lists[NR_BPF_LRU_LOCAL_LIST_T];
 	u16 next_steal;
+	/* The next remote shard to compare with, for sharded LRUs */
+	u16 next_shard;
 	raw_spinlock_t lock;
 };
 
 struct bpf_common_lru {
 	struct bpf_lru_list lru_list;
 	struct bpf_lru_locallist __percpu *local_list;
+	/* Per-CPU LRU lists used instead of lru_list, for sharded LRUs */
+	struct bpf_lru_list __percpu *shards;
 };
 
 typedef bool (*del_from_htab_func)(void *arg, struct bpf_lru_node *node);
@@ -60,6 +66,7 @@ struct bpf_lru {
 	unsigned int hash_offset;
 	unsigned int nr_scans;
 	bool percpu;
+	bool sharded;
 };
 
 static inline void bpf_lru_node_set_ref(struct bpf_lru_node *node)
@@ -68,8 +75,9 @@ static inline void bpf_lru_node_set_ref(struct bpf_lru_node *node)
 		WRITE_ONCE(node->ref, 1);
 }
 
-int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
-		 del_from_htab_func del_from_htab, void *delete_arg);
+int bpf_lru_init(struct bpf_lru *lru, bool percpu, bool sharded,
+		 u32 hash_offset, del_from_htab_func del_from_htab,
+		 void *delete_arg);
 void bpf_lru_populate(struct bpf_lru *lru, void *buf, u32 node_offset,
 		      u32 elem_size, u32 nr_elems);
 void bpf_lru_destroy(struct bpf_lru *lru);
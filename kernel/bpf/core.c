@@ -3034,6 +3034,17 @@ int __weak bpf_arch_text_poke(void *ip, enum bpf_text_poke_type t,
 	return -ENOTSUPP;
 }
 
+/* Architectures that can patch many sites with one sync override this. */
+void __weak bpf_arch_text_poke_batch(struct bpf_text_poke_desc *pokes, u32 cnt)
+{
+	u32 i;
+
+	for (i = 0; i < cnt; i++)
+		pokes[i].ret = bpf_arch_text_poke(pokes[i].ip, pokes[i].t,
+						  pokes[i].old_addr,
+						  pokes[i].new_addr);
+}
+
 void * __weak bpf_arch_text_copy(void *dst, void *src, size_t len)
 {
 	return ERR_PTR(-ENOTSUPP);
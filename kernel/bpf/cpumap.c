@@ -24,6 +24,7 @@
 #include <linux/filter.h>
 #include <linux/ptr_ring.h>
 #include <net/xdp.h>
+#include <net/gro.h>
 #include <net/hotdata.h>
 
 #include <linux/sched.h>
@@ -69,6 +70,11 @@ struct bpf_cpu_map_entry {
 	struct bpf_cpumap_val value;
 	struct bpf_prog *prog;
 
+	/* BPF_CPUMAP_F_GRO: only used by the kthread for its GRO state, it is
+	 * never scheduled or added to a device.
+	 */
+	struct napi_struct gro;
+
 	struct completion kthread_running;
 	struct rcu_work free_work;
 };
@@ -87,7 +93,9 @@ static struct bpf_map *cpu_map_alloc(union bpf_attr *attr)
 	/* check sanity of attributes */
 	if (attr->max_entries == 0 || attr->key_size != 4 ||
 	    (value_size != offsetofend(struct bpf_cpumap_val, qsize) &&
-	     value_size != offsetofend(struct bpf_cpumap_val, bpf_prog.fd)) ||
+	     value_size != offsetofend(struct bpf_cpumap_val, bpf_prog.fd) &&
+	     value_size != offsetofend(struct bpf_cpumap_val, flags) &&
+	     value_size != sizeof(struct bpf_cpumap_val)) ||
 	    attr->map_flags & ~BPF_F_NUMA_NODE)
 		return ERR_PTR(-EINVAL);
 
@@ -261,6 +269,43 @@ static int cpu_map_bpf_prog_run(struct bpf_cpu_map_entry *rcpu, void **frames,
 	return nframes;
 }
 
+static void cpu_map_gro_init(struct napi_struct *napi)
+{
+	int i;
+
+	for (i = 0; i < GRO_HASH_BUCKETS; i++)
+		INIT_LIST_HEAD(&napi->gro_hash[i].list);
+	INIT_LIST_HEAD(&napi->rx_list);
+}
+
+/* Pass the skbs through GRO, and flush what it holds once the queue is
+ * empty, or when it has been held for a jiffy while the queue is kept busy,
+ * like napi_complete_done() with a timeout.
+ */
+static void cpu_map_gro_receive(struct bpf_cpu_map_entry *rcpu,
+				struct list_head *listp)
+{
+	struct sk_buff *skb, *tmp;
+	u64 merged = 0;
+
+	list_for_each_entry_safe(skb, tmp, listp, list) {
+		skb_list_del_init(skb);
+		switch (napi_gro_receive(&rcpu->gro, skb)) {
+		case GRO_MERGED:
+		case GRO_MERGED_FREE:
+			merged++;
+			break;
+		default:
+			break;
+		}
+	}
+
+	napi_gro_flush(&rcpu->gro, !__ptr_ring_empty(rcpu->queue));
+	gro_normal_list(&rcpu->gro);
+
+	WRITE_ONCE(rcpu->value.gro_merged, rcpu->value.gro_merged + merged);
+}
+
 static int cpu_map_kthread_run(void *data)
 {
 	struct bpf_cpu_map_entry *rcpu = data;
@@ -276,7 +321,7 @@ static int cpu_map_kthread_run(void *data)
 	 */
 	while (!kthread_should_stop() || !__ptr_ring_empty(rcpu->queue)) {
 		struct xdp_cpumap_stats stats = {}; /* zero stats */
-		unsigned int kmem_alloc_drops = 0, sched = 0;
+		unsigned int kmem_alloc_drops = 0, sched = 0, drops = 0;
 		gfp_t gfp = __GFP_ZERO | GFP_ATOMIC;
 		int i, n, m, nframes, xdp_n;
 		void *frames[CPUMAP_BATCH];
@@ -349,6 +394,9 @@ static int cpu_map_kthread_run(void *data)
 							 xdpf->dev_rx);
 			if (!skb) {
 				xdp_return_frame(xdpf);
+				/* No skb at all is in kmem_alloc_drops */
+				if (skbs[i])
+					drops++;
 				continue;
 			}
 
@@ -361,8 +409,15 @@ static int cpu_map_kthread_run(void *data)
 		trace_xdp_cpumap_kthread(rcpu->map_id, n, kmem_alloc_drops,
 					 sched, &stats);
 
-		netif_receive_skb_list(&list);
+		if (rcpu->value.flags & BPF_CPUMAP_F_GRO)
+			cpu_map_gro_receive(rcpu, &list);
+		else
+			netif_receive_skb_list(&list);
 		local_bh_enable(); /* resched point, may call do_softirq() */
+
+		WRITE_ONCE(rcpu->value.packets, rcpu->value.packets + n);
+		WRITE_ONCE(rcpu->value.drops, rcpu->value.drops +
+			   kmem_alloc_drops + drops + stats.drop);
 	}
 	__set_current_state(TASK_RUNNING);
 
@@ -430,6 +485,8 @@ __cpu_map_entry_alloc(struct bpf_map *map, struct bpf_cpumap_val *value,
 	rcpu->cpu    = cpu;
 	rcpu->map_id = map->id;
 	rcpu->value.qsize  = value->qsize;
+	rcpu->value.flags  = value->flags;
+	cpu_map_gro_init(&rcpu->gro);
 
 	if (fd > 0 && __cpu_map_load_bpf_program(rcpu, map, fd))
 		goto free_ptr_ring;
@@ -547,6 +604,8 @@ static long cpu_map_update_elem(struct bpf_map *map, void *key, void *value,
 		return -EEXIST;
 	if (unlikely(cpumap_value.qsize > 16384)) /* sanity limit on qsize */
 		return -EOVERFLOW;
+	if (unlikely(cpumap_value.flags & ~BPF_CPUMAP_F_GRO))
+		return -EINVAL;
 
 	/* Make sure CPU is a valid possible cpu */
 	if (key_cpu >= nr_cpumask_bits || !cpu_possible(key_cpu))
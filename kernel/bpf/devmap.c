@@ -43,12 +43,19 @@
  * densely packed instead of having holes in the lookup array for unused
  * ifindexes. The setup and packet enqueue/send code is shared between the two
  * types of devmap; only the lookup and insertion is different.
+ *
+ * A broadcast redirect (BPF_F_BROADCAST) queues the frame on every device of
+ * the map. Devices flagged xdp_xmit_shared, without an egress program, are
+ * handed the same frame with an extra reference on its memory; the others
+ * get a copy each. The fdinfo of the map shows how many copies were saved.
  */
 #include <linux/bpf.h>
 #include <net/xdp.h>
 #include <linux/filter.h>
 #include <trace/events/xdp.h>
 #include <linux/btf_ids.h>
+#include <linux/seq_file.h>
+#include <linux/u64_stats_sync.h>
 
 #define DEV_CREATE_FLAG_MASK \
 	(BPF_F_NUMA_NODE | BPF_F_RDONLY | BPF_F_WRONLY)
@@ -71,10 +78,17 @@ struct bpf_dtab_netdev {
 	struct bpf_devmap_val val;
 };
 
+struct dev_map_stats {
+	u64_stats_t multi_shared;
+	u64_stats_t multi_cloned;
+	struct u64_stats_sync syncp;
+};
+
 struct bpf_dtab {
 	struct bpf_map map;
 	struct bpf_dtab_netdev __rcu **netdev_map; /* DEVMAP type only */
 	struct list_head list;
+	struct dev_map_stats __percpu *stats;
 
 	/* these are only used for DEVMAP_HASH type maps */
 	struct hlist_head *dev_index_head;
@@ -133,19 +147,30 @@ static int dev_map_alloc_check(union bpf_attr *attr)
 
 static int dev_map_init_map(struct bpf_dtab *dtab, union bpf_attr *attr)
 {
+	int cpu;
+
 	/* Lookup returns a pointer straight to dev->ifindex, so make sure the
 	 * verifier prevents writes from the BPF side
 	 */
 	attr->map_flags |= BPF_F_RDONLY_PROG;
 	bpf_map_init_from_attr(&dtab->map, attr);
 
+	dtab->stats = bpf_map_alloc_percpu(&dtab->map, sizeof(*dtab->stats),
+					   __alignof__(*dtab->stats),
+					   GFP_USER | __GFP_NOWARN);
+	if (!dtab->stats)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(dtab->stats, cpu)->syncp);
+
 	if (attr->map_type == BPF_MAP_TYPE_DEVMAP_HASH) {
 		/* Hash table size must be power of 2 */
 		dtab->n_buckets = roundup_pow_of_two(dtab->map.max_entries);
 		dtab->dev_index_head = dev_map_create_hash(dtab->n_buckets,
 							   dtab->map.numa_node);
 		if (!dtab->dev_index_head)
-			return -ENOMEM;
+			goto free_stats;
 
 		spin_lock_init(&dtab->index_lock);
 	} else {
@@ -153,10 +178,14 @@ static int dev_map_init_map(struct bpf_dtab *dtab, union bpf_attr *attr)
 						      sizeof(struct bpf_dtab_netdev *),
 						      dtab->map.numa_node);
 		if (!dtab->netdev_map)
-			return -ENOMEM;
+			goto free_stats;
 	}
 
 	return 0;
+
+free_stats:
+	free_percpu(dtab->stats);
+	return -ENOMEM;
 }
 
 static struct bpf_map *dev_map_alloc(union bpf_attr *attr)
@@ -248,6 +277,7 @@ static void dev_map_free(struct bpf_map *map)
 		bpf_map_area_free(dtab->netdev_map);
 	}
 
+	free_percpu(dtab->stats);
 	bpf_map_area_free(dtab);
 }
 
@@ -603,16 +633,85 @@ static int get_upper_ifindexes(struct net_device *dev, int *indexes)
 	return n;
 }
 
+/* Destinations that may be handed a frame shared with other destinations */
+static bool dev_map_can_share(struct bpf_dtab_netdev *obj)
+{
+	struct xdp_dev_bulk_queue *bq = this_cpu_ptr(obj->dev->xdp_bulkq);
+
+	/* An egress program may rewrite the frame, that includes one the bq
+	 * was bound to by an earlier redirect of this NAPI poll.
+	 */
+	return obj->dev->xdp_xmit_shared && !obj->xdp_prog && !bq->xdp_prog;
+}
+
+struct dev_map_multi {
+	struct xdp_frame *xdpf;
+	struct net_device *dev_rx;
+	/* destination of the frame itself if nothing shares it */
+	struct bpf_dtab_netdev *last_dst;
+	bool can_share;
+	unsigned int nr_shared;
+	unsigned int nr_cloned;
+};
+
+static int dev_map_enqueue_one(struct dev_map_multi *mm,
+			       struct bpf_dtab_netdev *dst)
+{
+	int err;
+
+	if (mm->can_share && dev_map_can_share(dst)) {
+		/* Each queued instance holds its own reference: a flush in
+		 * bq_enqueue() may complete and return it before we're done.
+		 */
+		xdpf_get(mm->xdpf);
+		bq_enqueue(dst->dev, mm->xdpf, mm->dev_rx, NULL);
+		mm->nr_shared++;
+		return 0;
+	}
+
+	/* we only need n-1 clones; last_dst enqueued below */
+	if (!mm->last_dst) {
+		mm->last_dst = dst;
+		return 0;
+	}
+
+	err = dev_map_enqueue_clone(mm->last_dst, mm->dev_rx, mm->xdpf);
+	if (err)
+		return err;
+
+	mm->nr_cloned++;
+	mm->last_dst = dst;
+	return 0;
+}
+
+static void dev_map_multi_stats(struct bpf_dtab *dtab, struct dev_map_multi *mm)
+{
+	struct dev_map_stats *stats = this_cpu_ptr(dtab->stats);
+
+	if (!mm->nr_shared && !mm->nr_cloned)
+		return;
+
+	u64_stats_update_begin(&stats->syncp);
+	u64_stats_add(&stats->multi_shared, mm->nr_shared);
+	u64_stats_add(&stats->multi_cloned, mm->nr_cloned);
+	u64_stats_update_end(&stats->syncp);
+}
+
 int dev_map_enqueue_multi(struct xdp_frame *xdpf, struct net_device *dev_rx,
 			  struct bpf_map *map, bool exclude_ingress)
 {
 	struct bpf_dtab *dtab = container_of(map, struct bpf_dtab, map);
-	struct bpf_dtab_netdev *dst, *last_dst = NULL;
+	struct dev_map_multi mm = {
+		.xdpf = xdpf,
+		.dev_rx = dev_rx,
+		.can_share = xdpf_can_get(xdpf),
+	};
 	int excluded_devices[1+MAX_NEST_DEV];
+	struct bpf_dtab_netdev *dst;
 	struct hlist_head *head;
 	int num_excluded = 0;
 	unsigned int i;
-	int err;
+	int err = 0;
 
 	if (exclude_ingress) {
 		num_excluded = get_upper_ifindexes(dev_rx, excluded_devices);
@@ -629,17 +728,9 @@ int dev_map_enqueue_multi(struct xdp_frame *xdpf, struct net_device *dev_rx,
 			if (is_ifindex_excluded(excluded_devices, num_excluded, dst->dev->ifindex))
 				continue;
 
-			/* we only need n-1 clones; last_dst enqueued below */
-			if (!last_dst) {
-				last_dst = dst;
-				continue;
-			}
-
-			err = dev_map_enqueue_clone(last_dst, dev_rx, xdpf);
+			err = dev_map_enqueue_one(&mm, dst);
 			if (err)
-				return err;
-
-			last_dst = dst;
+				goto out;
 		}
 	} else { /* BPF_MAP_TYPE_DEVMAP_HASH */
 		for (i = 0; i < dtab->n_buckets; i++) {
@@ -653,28 +744,31 @@ int dev_map_enqueue_multi(struct xdp_frame *xdpf, struct net_device *dev_rx,
 							dst->dev->ifindex))
 					continue;
 
-				/* we only need n-1 clones; last_dst enqueued below */
-				if (!last_dst) {
-					last_dst = dst;
-					continue;
-				}
-
-				err = dev_map_enqueue_clone(last_dst, dev_rx, xdpf);
+				err = dev_map_enqueue_one(&mm, dst);
 				if (err)
-					return err;
-
-				last_dst = dst;
+					goto out;
 			}
 		}
 	}
 
-	/* consume the last copy of the frame */
-	if (last_dst)
-		bq_enqueue(last_dst->dev, xdpf, dev_rx, last_dst->xdp_prog);
-	else
-		xdp_return_frame_rx_napi(xdpf); /* dtab is empty */
+	/* The last copy may only consume the frame itself if no other
+	 * destination is reading it.
+	 */
+	if (mm.last_dst && mm.nr_shared) {
+		err = dev_map_enqueue_clone(mm.last_dst, dev_rx, xdpf);
+		if (err)
+			goto out;
+		mm.nr_cloned++;
+		mm.last_dst = NULL;
+	}
 
-	return 0;
+	if (mm.last_dst)
+		bq_enqueue(mm.last_dst->dev, xdpf, dev_rx, mm.last_dst->xdp_prog);
+	else
+		xdp_return_frame_rx_napi(xdpf); /* dtab is empty, or shared */
+out:
+	dev_map_multi_stats(dtab, &mm);
+	return err;
 }
 
 int dev_map_generic_redirect(struct bpf_dtab_netdev *dst, struct sk_buff *skb,
@@ -1038,9 +1132,35 @@ static u64 dev_map_mem_usage(const struct bpf_map *map)
 		usage += (u64)map->max_entries * sizeof(struct bpf_dtab_netdev *);
 	usage += atomic_read((atomic_t *)&dtab->items) *
 			 (u64)sizeof(struct bpf_dtab_netdev);
+	usage += (u64)num_possible_cpus() * sizeof(struct dev_map_stats);
 	return usage;
 }
 
+static void dev_map_show_fdinfo(const struct bpf_map *map, struct seq_file *m)
+{
+	struct bpf_dtab *dtab = container_of(map, struct bpf_dtab, map);
+	u64 shared = 0, cloned = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct dev_map_stats *stats = per_cpu_ptr(dtab->stats, cpu);
+		unsigned int start;
+		u64 s, c;
+
+		do {
+			start = u64_stats_fetch_begin(&stats->syncp);
+			s = u64_stats_read(&stats->multi_shared);
+			c = u64_stats_read(&stats->multi_cloned);
+		} while (u64_stats_fetch_retry(&stats->syncp, start));
+
+		shared += s;
+		cloned += c;
+	}
+
+	seq_printf(m, "multi_shared:\t%llu\n", shared);
+	seq_printf(m, "multi_cloned:\t%llu\n", cloned);
+}
+
 BTF_ID_LIST_SINGLE(dev_map_btf_ids, struct, bpf_dtab)
 const struct bpf_map_ops dev_map_ops = {
 	.map_meta_equal = bpf_map_meta_equal,
@@ -1053,6 +1173,7 @@ const struct bpf_map_ops dev_map_ops = {
 	.map_delete_elem = dev_map_delete_elem,
 	.map_check_btf = map_check_no_btf,
 	.map_mem_usage = dev_map_mem_usage,
+	.map_show_fdinfo = dev_map_show_fdinfo,
 	.map_btf_id = &dev_map_btf_ids[0],
 	.map_redirect = dev_map_redirect,
 };
@@ -1068,6 +1189,7 @@ const struct bpf_map_ops dev_map_hash_ops = {
 	.map_delete_elem = dev_map_hash_delete_elem,
 	.map_check_btf = map_check_no_btf,
 	.map_mem_usage = dev_map_mem_usage,
+	.map_show_fdinfo = dev_map_show_fdinfo,
 	.map_btf_id = &dev_map_btf_ids[0],
 	.map_redirect = dev_hash_map_redirect,
 };
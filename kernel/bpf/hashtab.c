@@ -6,9 +6,11 @@
 #include <linux/btf.h>
 #include <linux/jhash.h>
 #include <linux/filter.h>
+#include <linux/irq_work.h>
 #include <linux/rculist_nulls.h>
 #include <linux/rcupdate_wait.h>
 #include <linux/random.h>
+#include <linux/workqueue.h>
 #include <uapi/linux/btf.h>
 #include <linux/rcupdate_trace.h>
 #include <linux/btf_ids.h>
@@ -19,7 +21,8 @@
 
 #define HTAB_CREATE_FLAG_MASK						\
 	(BPF_F_NO_PREALLOC | BPF_F_NO_COMMON_LRU | BPF_F_NUMA_NODE |	\
-	 BPF_F_ACCESS_MASK | BPF_F_ZERO_SEED)
+	 BPF_F_ACCESS_MASK | BPF_F_ZERO_SEED | BPF_F_SHARDED_LRU |	\
+	 BPF_F_RESIZABLE)
 
 #define BATCH_OPS(_name)			\
 	.map_lookup_batch =			\
@@ -84,11 +87,34 @@ struct bucket {
 #define HASHTAB_MAP_LOCK_COUNT 8
 #define HASHTAB_MAP_LOCK_MASK (HASHTAB_MAP_LOCK_COUNT - 1)
 
+/* The buckets of a BPF_F_RESIZABLE map.  While it is being resized, @future
+ * is the table the elements move to, and the buckets below @rehash have
+ * been moved.  Lookups search the table, then the future table.  Writers
+ * lock the bucket in the table, then, if it was moved, the one in the
+ * future table as well.
+ */
+struct htab_table {
+	struct htab_table __rcu *future;
+	u32 n_buckets;
+	u32 rehash;
+	u32 nulls;	/* 0 or HTAB_TABLE_NULLS_BIT */
+	struct bucket buckets[];
+};
+
+/* A table and its future table use different nulls values, so that a
+ * lockless lookup that followed a moved element into the future table
+ * restarts rather than stops early.
+ */
+#define HTAB_TABLE_NULLS_BIT	(1U << 30)
+#define HTAB_RESIZABLE_MAX_ENTRIES	HTAB_TABLE_NULLS_BIT
+#define HTAB_MIN_BUCKETS	16
+
 struct bpf_htab {
 	struct bpf_map map;
 	struct bpf_mem_alloc ma;
 	struct bpf_mem_alloc pcpu_ma;
 	struct bucket *buckets;
+	struct htab_table __rcu *tbl;	/* instead of buckets if resizable */
 	void *elems;
 	union {
 		struct pcpu_freelist freelist;
@@ -101,9 +127,12 @@ struct bpf_htab {
 	struct percpu_counter pcount;
 	atomic_t count;
 	bool use_percpu_counter;
-	u32 n_buckets;	/* number of hash buckets */
+	u32 n_buckets;	/* number of hash buckets, the maximum if resizable */
 	u32 elem_size;	/* size of each element in bytes */
 	u32 hashrnd;
+	bool resize_queued;
+	struct irq_work resize_irq_work;
+	struct work_struct resize_work;
 	struct lock_class_key lockdep_key;
 	int __percpu *map_locked[HASHTAB_MAP_LOCK_COUNT];
 };
@@ -134,14 +163,20 @@ static inline bool htab_is_prealloc(const struct bpf_htab *htab)
 	return !(htab->map.map_flags & BPF_F_NO_PREALLOC);
 }
 
-static void htab_init_buckets(struct bpf_htab *htab)
+static inline bool htab_is_resizable(const struct bpf_htab *htab)
+{
+	return htab->map.map_flags & BPF_F_RESIZABLE;
+}
+
+static void htab_init_buckets(struct bpf_htab *htab, struct bucket *buckets,
+			      u32 n_buckets, u32 nulls)
 {
 	unsigned int i;
 
-	for (i = 0; i < htab->n_buckets; i++) {
-		INIT_HLIST_NULLS_HEAD(&htab->buckets[i].head, i);
-		raw_spin_lock_init(&htab->buckets[i].raw_lock);
-		lockdep_set_class(&htab->buckets[i].raw_lock,
+	for (i = 0; i < n_buckets; i++) {
+		INIT_HLIST_NULLS_HEAD(&buckets[i].head, nulls | i);
+		raw_spin_lock_init(&buckets[i].raw_lock);
+		lockdep_set_class(&buckets[i].raw_lock,
 					  &htab->lockdep_key);
 		cond_resched();
 	}
@@ -181,6 +216,140 @@ static inline void htab_unlock_bucket(const struct bpf_htab *htab,
 	preempt_enable();
 }
 
+/* Dereference @p, a table of @htab, in any reader context, or while the
+ * map is freed.
+ */
+#define htab_table_dereference(htab, p)					\
+	rcu_dereference_check(p, rcu_read_lock_trace_held() ||		\
+			      rcu_read_lock_bh_held() ||		\
+			      !atomic64_read(&(htab)->map.refcnt))
+
+static inline struct bucket *htab_table_bucket(struct htab_table *tbl,
+					       u32 hash)
+{
+	return &tbl->buckets[hash & (tbl->n_buckets - 1)];
+}
+
+static inline u32 htab_table_nulls(const struct htab_table *tbl, u32 hash)
+{
+	return tbl->nulls | (hash & (tbl->n_buckets - 1));
+}
+
+static struct htab_table *htab_table_alloc(struct bpf_htab *htab,
+					   u32 n_buckets, u32 nulls,
+					   gfp_t flags)
+{
+	struct htab_table *tbl;
+
+	tbl = bpf_map_kvcalloc(&htab->map, 1,
+			       struct_size(tbl, buckets, n_buckets),
+			       flags | __GFP_NOWARN);
+	if (!tbl)
+		return NULL;
+
+	tbl->n_buckets = n_buckets;
+	tbl->nulls = nulls;
+	htab_init_buckets(htab, tbl->buckets, n_buckets, nulls);
+	return tbl;
+}
+
+/* Lock the bucket of @hash for an update or delete and return it in *@pb.
+ * For a resizable map that is being resized, this is the bucket in the
+ * table or the future table that the elements of @hash are in.  *@pob is
+ * the bucket that was locked first, for htab_unlock_hash().
+ */
+static int htab_lock_hash(struct bpf_htab *htab, u32 hash, struct bucket **pb,
+			  struct bucket **pob, unsigned long *pflags)
+{
+	struct htab_table *tbl = NULL;
+	struct bucket *b;
+	int ret;
+
+	if (htab_is_resizable(htab)) {
+		tbl = htab_table_dereference(htab, htab->tbl);
+		b = htab_table_bucket(tbl, hash);
+	} else {
+		b = &htab->buckets[hash & (htab->n_buckets - 1)];
+	}
+
+	ret = htab_lock_bucket(htab, b, hash, pflags);
+	if (ret)
+		return ret;
+
+	*pob = b;
+	if (tbl && (hash & (tbl->n_buckets - 1)) < READ_ONCE(tbl->rehash)) {
+		tbl = htab_table_dereference(htab, tbl->future);
+		b = htab_table_bucket(tbl, hash);
+		raw_spin_lock_nested(&b->raw_lock, SINGLE_DEPTH_NESTING);
+	}
+	*pb = b;
+	return 0;
+}
+
+static void htab_unlock_hash(const struct bpf_htab *htab, struct bucket *b,
+			     struct bucket *ob, u32 hash, unsigned long flags)
+{
+	if (b != ob)
+		raw_spin_unlock(&b->raw_lock);
+	htab_unlock_bucket(htab, ob, hash, flags);
+}
+
+/* Walks over all elements visit the buckets by position: for a resizable
+ * map, those of the table and then those of the future table.  Elements
+ * moved by a concurrent resize may be visited twice or not at all.
+ */
+static struct bucket *htab_walk_bucket(const struct bpf_htab *htab, u32 i)
+{
+	struct htab_table *tbl;
+
+	if (!htab_is_resizable(htab))
+		return i < htab->n_buckets ? &htab->buckets[i] : NULL;
+
+	tbl = htab_table_dereference(htab, htab->tbl);
+	if (i < tbl->n_buckets)
+		return &tbl->buckets[i];
+
+	i -= tbl->n_buckets;
+	tbl = htab_table_dereference(htab, tbl->future);
+	if (tbl && i < tbl->n_buckets)
+		return &tbl->buckets[i];
+	return NULL;
+}
+
+static u32 htab_walk_size(const struct bpf_htab *htab)
+{
+	struct htab_table *tbl, *future;
+	u32 size;
+
+	if (!htab_is_resizable(htab))
+		return htab->n_buckets;
+
+	rcu_read_lock();
+	tbl = rcu_dereference(htab->tbl);
+	future = rcu_dereference(tbl->future);
+	size = tbl->n_buckets + (future ? future->n_buckets : 0);
+	rcu_read_unlock();
+	return size;
+}
+
+/* Position of the bucket of @hash, whose chain ended with @end */
+static u32 htab_walk_pos(const struct bpf_htab *htab, u32 hash,
+			 const struct hlist_nulls_node *end)
+{
+	struct htab_table *tbl;
+	u32 nulls;
+
+	if (!htab_is_resizable(htab))
+		return hash & (htab->n_buckets - 1);
+
+	/* The nulls value tells which table the element was in */
+	nulls = get_nulls_value(end);
+	tbl = htab_table_dereference(htab, htab->tbl);
+	if ((nulls & HTAB_TABLE_NULLS_BIT) == tbl->nulls)
+		return nulls & ~HTAB_TABLE_NULLS_BIT;
+	return tbl->n_buckets + (nulls & ~HTAB_TABLE_NULLS_BIT);
+}
+
 static bool htab_lru_map_delete_node(void *arg, struct bpf_lru_node *node);
 
 static bool htab_is_lru(const struct bpf_htab *htab)
@@ -351,6 +520,7 @@ static int prealloc_init(struct bpf_htab *htab)
 	if (htab_is_lru(htab))
 		err = bpf_lru_init(&htab->lru,
 				   htab->map.map_flags & BPF_F_NO_COMMON_LRU,
+				   htab->map.map_flags & BPF_F_SHARDED_LRU,
 				   offsetof(struct htab_elem, hash) -
 				   offsetof(struct htab_elem, lru_node),
 				   htab_lru_map_delete_node,
@@ -410,6 +580,149 @@ static int alloc_extra_elems(struct bpf_htab *htab)
 	return 0;
 }
 
+/* Number of buckets to resize @tbl to, or 0.  Grow above 75% and shrink
+ * below 30% load, like rhashtable.
+ */
+static u32 htab_resize_target(struct bpf_htab *htab,
+			      const struct htab_table *tbl)
+{
+	u32 n_buckets = tbl->n_buckets;
+	s64 count;
+
+	if (htab->use_percpu_counter)
+		count = percpu_counter_read_positive(&htab->pcount);
+	else
+		count = atomic_read(&htab->count);
+
+	if (n_buckets < htab->n_buckets && count > n_buckets / 4 * 3)
+		return n_buckets * 2;
+	if (n_buckets > HTAB_MIN_BUCKETS && count < n_buckets / 10 * 3)
+		return n_buckets / 2;
+	return 0;
+}
+
+/* Move the last element of @ob to its bucket in @future.  The element is
+ * linked into the future bucket before it is unlinked from @ob, so a
+ * lockless lookup either finds it in @ob, or reaches the end of @ob and
+ * then finds it in @future.  One that is at the element when it moves
+ * continues into the future bucket, sees the nulls value of @future and
+ * restarts.
+ */
+static bool htab_table_move_tail(struct bucket *ob, struct htab_table *future)
+{
+	struct hlist_nulls_node *n, *end, *first, **pprev;
+	struct htab_elem *l = NULL;
+	struct bucket *fb;
+
+	for (n = ob->head.first; !is_a_nulls(n); n = n->next)
+		l = container_of(n, struct htab_elem, hash_node);
+	if (!l)
+		return false;
+	end = n;
+
+	fb = htab_table_bucket(future, l->hash);
+	raw_spin_lock_nested(&fb->raw_lock, SINGLE_DEPTH_NESTING);
+
+	pprev = l->hash_node.pprev;
+	first = fb->head.first;
+	WRITE_ONCE(l->hash_node.next, first);
+	if (!is_a_nulls(first))
+		WRITE_ONCE(first->pprev, &l->hash_node.next);
+	WRITE_ONCE(l->hash_node.pprev, &fb->head.first);
+	rcu_assign_pointer(hlist_nulls_first_rcu(&fb->head), &l->hash_node);
+
+	/* Pairs with the smp_rmb() in htab_lookup_nulls() */
+	smp_store_release(pprev, end);
+
+	raw_spin_unlock(&fb->raw_lock);
+	return true;
+}
+
+/* Move all elements of @tbl into a new table of @n_buckets buckets, one
+ * bucket at a time and with the bucket locks of both tables held, then
+ * replace @tbl with it.
+ */
+static int htab_resize(struct bpf_htab *htab, struct htab_table *tbl,
+		       u32 n_buckets)
+{
+	struct htab_table *future;
+	unsigned long flags;
+	u32 i;
+
+	future = htab_table_alloc(htab, n_buckets,
+				  tbl->nulls ^ HTAB_TABLE_NULLS_BIT, GFP_KERNEL);
+	if (!future)
+		return -ENOMEM;
+
+	rcu_assign_pointer(tbl->future, future);
+
+	for (i = 0; i < tbl->n_buckets; i++) {
+		struct bucket *ob = &tbl->buckets[i];
+
+		/* Bucket locks are held with preemption disabled, so none
+		 * is held on this CPU and this cannot keep failing.
+		 */
+		while (htab_lock_bucket(htab, ob, i, &flags))
+			cpu_relax();
+
+		while (htab_table_move_tail(ob, future))
+			;
+		WRITE_ONCE(tbl->rehash, i + 1);
+
+		htab_unlock_bucket(htab, ob, i, flags);
+		cond_resched();
+	}
+
+	rcu_assign_pointer(htab->tbl, future);
+
+	/* Lookups and writers, also from sleepable programs, may still use
+	 * the old table.  A new resize only starts after they are done.
+	 */
+	synchronize_rcu_mult(call_rcu, call_rcu_tasks_trace);
+	kvfree(tbl);
+	return 0;
+}
+
+static void htab_resize_work(struct work_struct *work)
+{
+	struct bpf_htab *htab = container_of(work, struct bpf_htab,
+					     resize_work);
+	struct htab_table *tbl;
+	u32 n_buckets;
+
+	for (;;) {
+		/* Only this work changes htab->tbl */
+		tbl = rcu_dereference_protected(htab->tbl, true);
+		n_buckets = htab_resize_target(htab, tbl);
+		if (!n_buckets || htab_resize(htab, tbl, n_buckets))
+			break;
+	}
+
+	WRITE_ONCE(htab->resize_queued, false);
+}
+
+static void htab_resize_irq_work(struct irq_work *work)
+{
+	struct bpf_htab *htab = container_of(work, struct bpf_htab,
+					     resize_irq_work);
+
+	queue_work(system_unbound_wq, &htab->resize_work);
+}
+
+/* Called after the number of elements of a resizable map changed.  This
+ * can be in NMI context, so the resize is kicked off by an irq_work.
+ */
+static void htab_maybe_resize(struct bpf_htab *htab)
+{
+	if (!htab_resize_target(htab, htab_table_dereference(htab, htab->tbl)))
+		return;
+
+	if (READ_ONCE(htab->resize_queued) || xchg(&htab->resize_queued, true))
+		return;
+
+	irq_work_queue(&htab->resize_irq_work);
+}
+
 /* Called from syscall */
 static int htab_map_alloc_check(union bpf_attr *attr)
 {
@@ -425,6 +738,7 @@ static int htab_map_alloc_check(union bpf_attr *attr)
 	bool percpu_lru = (attr->map_flags & BPF_F_NO_COMMON_LRU);
 	bool prealloc = !(attr->map_flags & BPF_F_NO_PREALLOC);
 	bool zero_seed = (attr->map_flags & BPF_F_ZERO_SEED);
+	bool resizable = (attr->map_flags & BPF_F_RESIZABLE);
 	int numa_node = bpf_map_attr_numa_node(attr);
 
 	BUILD_BUG_ON(offsetof(struct htab_elem, fnode.next) !=
@@ -441,9 +755,19 @@ static int htab_map_alloc_check(union bpf_attr *attr)
 	if (!lru && percpu_lru)
 		return -EINVAL;
 
+	if ((attr->map_flags & BPF_F_SHARDED_LRU) && (!lru || percpu_lru))
+		return -EINVAL;
+
 	if (lru && !prealloc)
 		return -ENOTSUPP;
 
+	/* Preallocated maps have max_entries elements anyway, and fd maps
+	 * walk their buckets on free.
+	 */
+	if (resizable && (prealloc || (attr->map_type != BPF_MAP_TYPE_HASH &&
+				       attr->map_type != BPF_MAP_TYPE_PERCPU_HASH)))
+		return -EINVAL;
+
 	if (numa_node != NUMA_NO_NODE && (percpu || percpu_lru))
 		return -EINVAL;
 
@@ -454,6 +778,9 @@ static int htab_map_alloc_check(union bpf_attr *attr)
 	    attr->value_size == 0)
 		return -EINVAL;
 
+	if (resizable && attr->max_entries > HTAB_RESIZABLE_MAX_ENTRIES)
+		return -E2BIG;
+
 	if ((u64)attr->key_size + attr->value_size >= KMALLOC_MAX_SIZE -
 	   sizeof(struct htab_elem))
 		/* if key_size + value_size is bigger, the user space won't be
@@ -482,6 +809,7 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 	 */
 	bool percpu_lru = (attr->map_flags & BPF_F_NO_COMMON_LRU);
 	bool prealloc = !(attr->map_flags & BPF_F_NO_PREALLOC);
+	struct htab_table *tbl;
 	struct bpf_htab *htab;
 	int err, i;
 
@@ -530,11 +858,22 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 		goto free_htab;
 
 	err = -ENOMEM;
-	htab->buckets = bpf_map_area_alloc(htab->n_buckets *
-					   sizeof(struct bucket),
-					   htab->map.numa_node);
-	if (!htab->buckets)
-		goto free_elem_count;
+	if (htab_is_resizable(htab)) {
+		tbl = htab_table_alloc(htab, min_t(u32, htab->n_buckets,
+						   HTAB_MIN_BUCKETS),
+				       0, GFP_USER);
+		if (!tbl)
+			goto free_elem_count;
+		RCU_INIT_POINTER(htab->tbl, tbl);
+		init_irq_work(&htab->resize_irq_work, htab_resize_irq_work);
+		INIT_WORK(&htab->resize_work, htab_resize_work);
+	} else {
+		htab->buckets = bpf_map_area_alloc(htab->n_buckets *
+						   sizeof(struct bucket),
+						   htab->map.numa_node);
+		if (!htab->buckets)
+			goto free_elem_count;
+	}
 
 	for (i = 0; i < HASHTAB_MAP_LOCK_COUNT; i++) {
 		htab->map_locked[i] = bpf_map_alloc_percpu(&htab->map,
@@ -550,7 +889,8 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 	else
 		htab->hashrnd = get_random_u32();
 
-	htab_init_buckets(htab);
+	if (!htab_is_resizable(htab))
+		htab_init_buckets(htab, htab->buckets, htab->n_buckets, 0);
 
 /* compute_batch_value() computes batch value as num_online_cpus() * 2
  * and __percpu_counter_compare() needs
@@ -610,6 +950,7 @@ static struct bpf_map *htab_map_alloc(union bpf_attr *attr)
 	for (i = 0; i < HASHTAB_MAP_LOCK_COUNT; i++)
 		free_percpu(htab->map_locked[i]);
 	bpf_map_area_free(htab->buckets);
+	kvfree(rcu_dereference_protected(htab->tbl, true));
 	bpf_mem_alloc_destroy(&htab->pcpu_ma);
 	bpf_mem_alloc_destroy(&htab->ma);
 free_elem_count:
@@ -657,7 +998,7 @@ static struct htab_elem *lookup_elem_raw(struct hlist_nulls_head *head, u32 hash
  */
 static struct htab_elem *lookup_nulls_elem_raw(struct hlist_nulls_head *head,
 					       u32 hash, void *key,
-					       u32 key_size, u32 n_buckets)
+					       u32 key_size, u32 nulls)
 {
 	struct hlist_nulls_node *n;
 	struct htab_elem *l;
@@ -667,12 +1008,44 @@ static struct htab_elem *lookup_nulls_elem_raw(struct hlist_nulls_head *head,
 		if (l->hash == hash && !memcmp(&l->key, key, key_size))
 			return l;
 
-	if (unlikely(get_nulls_value(n) != (hash & (n_buckets - 1))))
+	if (unlikely(get_nulls_value(n) != nulls))
 		goto again;
 
 	return NULL;
 }
 
+/* Lockless lookup in the bucket of @hash, and for a resizable map that is
+ * being resized, in the future table as well.
+ */
+static struct htab_elem *htab_lookup_nulls(struct bpf_htab *htab, u32 hash,
+					   void *key, u32 key_size)
+{
+	struct htab_table *tbl;
+	struct htab_elem *l;
+
+	if (!htab_is_resizable(htab))
+		return lookup_nulls_elem_raw(select_bucket(htab, hash), hash,
+					     key, key_size,
+					     hash & (htab->n_buckets - 1));
+
+	tbl = htab_table_dereference(htab, htab->tbl);
+	do {
+		l = lookup_nulls_elem_raw(&htab_table_bucket(tbl, hash)->head,
+					  hash, key, key_size,
+					  htab_table_nulls(tbl, hash));
+		if (l)
+			return l;
+
+		/* Pairs with htab_table_move_tail(): an element that was
+		 * unlinked above is already in the future table.
+		 */
+		smp_rmb();
+		tbl = htab_table_dereference(htab, tbl->future);
+	} while (tbl);
+
+	return NULL;
+}
+
 /* Called from syscall or from eBPF program directly, so
  * arguments have to match bpf_map_lookup_elem() exactly.
  * The return value is adjusted by BPF instructions
@@ -681,8 +1054,6 @@ static struct htab_elem *lookup_nulls_elem_raw(struct hlist_nulls_head *head,
 static void *__htab_map_lookup_elem(struct bpf_map *map, void *key)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
-	struct hlist_nulls_head *head;
-	struct htab_elem *l;
 	u32 hash, key_size;
 
 	WARN_ON_ONCE(!rcu_read_lock_held() && !rcu_read_lock_trace_held() &&
@@ -692,11 +1063,7 @@ static void *__htab_map_lookup_elem(struct bpf_map *map, void *key)
 
 	hash = htab_map_hash(key, key_size, htab->hashrnd);
 
-	head = select_bucket(htab, hash);
-
-	l = lookup_nulls_elem_raw(head, hash, key, key_size, htab->n_buckets);
-
-	return l;
+	return htab_lookup_nulls(htab, hash, key, key_size);
 }
 
 static void *htab_map_lookup_elem(struct bpf_map *map, void *key)
@@ -840,8 +1207,10 @@ static int htab_map_get_next_key(struct bpf_map *map, void *key, void *next_key)
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct hlist_nulls_head *head;
 	struct htab_elem *l, *next_l;
+	struct hlist_nulls_node *n;
 	u32 hash, key_size;
-	int i = 0;
+	struct bucket *b;
+	u32 i = 0;
 
 	WARN_ON_ONCE(!rcu_read_lock_held());
 
@@ -852,17 +1221,15 @@ static int htab_map_get_next_key(struct bpf_map *map, void *key, void *next_key)
 
 	hash = htab_map_hash(key, key_size, htab->hashrnd);
 
-	head = select_bucket(htab, hash);
-
 	/* lookup the key */
-	l = lookup_nulls_elem_raw(head, hash, key, key_size, htab->n_buckets);
+	l = htab_lookup_nulls(htab, hash, key, key_size);
 
 	if (!l)
 		goto find_first_elem;
 
 	/* key was found, get next key in the same bucket */
-	next_l = hlist_nulls_entry_safe(rcu_dereference_raw(hlist_nulls_next_rcu(&l->hash_node)),
-				  struct htab_elem, hash_node);
+	n = rcu_dereference_raw(hlist_nulls_next_rcu(&l->hash_node));
+	next_l = hlist_nulls_entry_safe(n, struct htab_elem, hash_node);
 
 	if (next_l) {
 		/* if next elem in this hash list is non-zero, just return it */
@@ -871,13 +1238,13 @@ static int htab_map_get_next_key(struct bpf_map *map, void *key, void *next_key)
 	}
 
 	/* no more elements in this hash list, go to the next bucket */
-	i = hash & (htab->n_buckets - 1);
+	i = htab_walk_pos(htab, hash, n);
 	i++;
 
 find_first_elem:
 	/* iterate over buckets */
-	for (; i < htab->n_buckets; i++) {
-		head = select_bucket(htab, i);
+	for (; (b = htab_walk_bucket(htab, i)); i++) {
+		head = &b->head;
 
 		/* pick first element in the bucket */
 		next_l = hlist_nulls_entry_safe(rcu_dereference_raw(hlist_nulls_first_rcu(head)),
@@ -931,6 +1298,9 @@ static void inc_elem_count(struct bpf_htab *htab)
 		percpu_counter_add_batch(&htab->pcount, 1, PERCPU_COUNTER_BATCH);
 	else
 		atomic_inc(&htab->count);
+
+	if (htab_is_resizable(htab))
+		htab_maybe_resize(htab);
 }
 
 static void dec_elem_count(struct bpf_htab *htab)
@@ -941,6 +1311,9 @@ static void dec_elem_count(struct bpf_htab *htab)
 		percpu_counter_add_batch(&htab->pcount, -1, PERCPU_COUNTER_BATCH);
 	else
 		atomic_dec(&htab->count);
+
+	if (htab_is_resizable(htab))
+		htab_maybe_resize(htab);
 }
 
 
@@ -1106,9 +1479,9 @@ static long htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct htab_elem *l_new = NULL, *l_old;
 	struct hlist_nulls_head *head;
+	struct bucket *b, *ob;
 	unsigned long flags;
 	void *old_map_ptr;
-	struct bucket *b;
 	u32 key_size, hash;
 	int ret;
 
@@ -1123,15 +1496,11 @@ static long htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 
 	hash = htab_map_hash(key, key_size, htab->hashrnd);
 
-	b = __select_bucket(htab, hash);
-	head = &b->head;
-
 	if (unlikely(map_flags & BPF_F_LOCK)) {
 		if (unlikely(!btf_record_has_field(map->record, BPF_SPIN_LOCK)))
 			return -EINVAL;
 		/* find an element without taking the bucket lock */
-		l_old = lookup_nulls_elem_raw(head, hash, key, key_size,
-					      htab->n_buckets);
+		l_old = htab_lookup_nulls(htab, hash, key, key_size);
 		ret = check_flags(htab, l_old, map_flags);
 		if (ret)
 			return ret;
@@ -1148,10 +1517,11 @@ static long htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 		 */
 	}
 
-	ret = htab_lock_bucket(htab, b, hash, &flags);
+	ret = htab_lock_hash(htab, hash, &b, &ob, &flags);
 	if (ret)
 		return ret;
 
+	head = &b->head;
 	l_old = lookup_elem_raw(head, hash, key, key_size);
 
 	ret = check_flags(htab, l_old, map_flags);
@@ -1199,7 +1569,7 @@ static long htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 			check_and_free_fields(htab, l_old);
 		}
 	}
-	htab_unlock_bucket(htab, b, hash, flags);
+	htab_unlock_hash(htab, b, ob, hash, flags);
 	if (l_old) {
 		if (old_map_ptr)
 			map->ops->map_fd_put_ptr(map, old_map_ptr, true);
@@ -1208,7 +1578,7 @@ static long htab_map_update_elem(struct bpf_map *map, void *key, void *value,
 	}
 	return 0;
 err:
-	htab_unlock_bucket(htab, b, hash, flags);
+	htab_unlock_hash(htab, b, ob, hash, flags);
 	return ret;
 }
 
@@ -1294,8 +1664,8 @@ static long __htab_percpu_map_update_elem(struct bpf_map *map, void *key,
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
 	struct htab_elem *l_new = NULL, *l_old;
 	struct hlist_nulls_head *head;
+	struct bucket *b, *ob;
 	unsigned long flags;
-	struct bucket *b;
 	u32 key_size, hash;
 	int ret;
 
@@ -1310,13 +1680,11 @@ static long __htab_percpu_map_update_elem(struct bpf_map *map, void *key,
 
 	hash = htab_map_hash(key, key_size, htab->hashrnd);
 
-	b = __select_bucket(htab, hash);
-	head = &b->head;
-
-	ret = htab_lock_bucket(htab, b, hash, &flags);
+	ret = htab_lock_hash(htab, hash, &b, &ob, &flags);
 	if (ret)
 		return ret;
 
+	head = &b->head;
 	l_old = lookup_elem_raw(head, hash, key, key_size);
 
 	ret = check_flags(htab, l_old, map_flags);
@@ -1338,7 +1706,7 @@ static long __htab_percpu_map_update_elem(struct bpf_map *map, void *key,
 	}
 	ret = 0;
 err:
-	htab_unlock_bucket(htab, b, hash, flags);
+	htab_unlock_hash(htab, b, ob, hash, flags);
 	return ret;
 }
 
@@ -1429,8 +1797,7 @@ static long htab_lru_percpu_map_update_elem(struct bpf_map *map, void *key,
 static long htab_map_delete_elem(struct bpf_map *map, void *key)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
-	struct hlist_nulls_head *head;
-	struct bucket *b;
+	struct bucket *b, *ob;
 	struct htab_elem *l;
 	unsigned long flags;
 	u32 hash, key_size;
@@ -1442,20 +1809,18 @@ static long htab_map_delete_elem(struct bpf_map *map, void *key)
 	key_size = map->key_size;
 
 	hash = htab_map_hash(key, key_size, htab->hashrnd);
-	b = __select_bucket(htab, hash);
-	head = &b->head;
 
-	ret = htab_lock_bucket(htab, b, hash, &flags);
+	ret = htab_lock_hash(htab, hash, &b, &ob, &flags);
 	if (ret)
 		return ret;
 
-	l = lookup_elem_raw(head, hash, key, key_size);
+	l = lookup_elem_raw(&b->head, hash, key, key_size);
 	if (l)
 		hlist_nulls_del_rcu(&l->hash_node);
 	else
 		ret = -ENOENT;
 
-	htab_unlock_bucket(htab, b, hash, flags);
+	htab_unlock_hash(htab, b, ob, hash, flags);
 
 	if (l)
 		free_htab_elem(htab, l);
@@ -1500,14 +1865,15 @@ static long htab_lru_map_delete_elem(struct bpf_map *map, void *key)
 
 static void delete_all_elements(struct bpf_htab *htab)
 {
+	struct bucket *b;
 	int i;
 
 	/* It's called from a worker thread, so disable migration here,
 	 * since bpf_mem_cache_free() relies on that.
 	 */
 	migrate_disable();
-	for (i = 0; i < htab->n_buckets; i++) {
-		struct hlist_nulls_head *head = select_bucket(htab, i);
+	for (i = 0; (b = htab_walk_bucket(htab, i)); i++) {
+		struct hlist_nulls_head *head = &b->head;
 		struct hlist_nulls_node *n;
 		struct htab_elem *l;
 
@@ -1522,11 +1888,12 @@ static void delete_all_elements(struct bpf_htab *htab)
 
 static void htab_free_malloced_timers_and_wq(struct bpf_htab *htab)
 {
+	struct bucket *b;
 	int i;
 
 	rcu_read_lock();
-	for (i = 0; i < htab->n_buckets; i++) {
-		struct hlist_nulls_head *head = select_bucket(htab, i);
+	for (i = 0; (b = htab_walk_bucket(htab, i)); i++) {
+		struct hlist_nulls_head *head = &b->head;
 		struct hlist_nulls_node *n;
 		struct htab_elem *l;
 
@@ -1572,6 +1939,11 @@ static void htab_map_free(struct bpf_map *map)
 	 * underneath and is responsible for waiting for callbacks to finish
 	 * during bpf_mem_alloc_destroy().
 	 */
+	if (htab_is_resizable(htab)) {
+		irq_work_sync(&htab->resize_irq_work);
+		cancel_work_sync(&htab->resize_work);
+	}
+
 	if (!htab_is_prealloc(htab)) {
 		delete_all_elements(htab);
 	} else {
@@ -1582,6 +1954,7 @@ static void htab_map_free(struct bpf_map *map)
 	bpf_map_free_elem_count(map);
 	free_percpu(htab->extra_elems);
 	bpf_map_area_free(htab->buckets);
+	kvfree(rcu_dereference_protected(htab->tbl, true));
 	bpf_mem_alloc_destroy(&htab->pcpu_ma);
 	bpf_mem_alloc_destroy(&htab->ma);
 	if (htab->use_percpu_counter)
@@ -1618,24 +1991,21 @@ static int __htab_map_lookup_and_delete_elem(struct bpf_map *map, void *key,
 					     bool is_percpu, u64 flags)
 {
 	struct bpf_htab *htab = container_of(map, struct bpf_htab, map);
-	struct hlist_nulls_head *head;
+	struct bucket *b, *ob;
 	unsigned long bflags;
 	struct htab_elem *l;
 	u32 hash, key_size;
-	struct bucket *b;
 	int ret;
 
 	key_size = map->key_size;
 
 	hash = htab_map_hash(key, key_size, htab->hashrnd);
-	b = __select_bucket(htab, hash);
-	head = &b->head;
 
-	ret = htab_lock_bucket(htab, b, hash, &bflags);
+	ret = htab_lock_hash(htab, hash, &b, &ob, &bflags);
 	if (ret)
 		return ret;
 
-	l = lookup_elem_raw(head, hash, key, key_size);
+	l = lookup_elem_raw(&b->head, hash, key, key_size);
 	if (!l) {
 		ret = -ENOENT;
 	} else {
@@ -1669,7 +2039,7 @@ static int __htab_map_lookup_and_delete_elem(struct bpf_map *map, void *key,
 			free_htab_elem(htab, l);
 	}
 
-	htab_unlock_bucket(htab, b, hash, bflags);
+	htab_unlock_hash(htab, b, ob, hash, bflags);
 
 	if (is_lru_map && l)
 		htab_lru_push_free(htab, l);
@@ -1751,7 +2121,7 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	if (ubatch && copy_from_user(&batch, ubatch, sizeof(batch)))
 		return -EFAULT;
 
-	if (batch >= htab->n_buckets)
+	if (batch >= htab_walk_size(htab))
 		return -ENOENT;
 
 	key_size = htab->map.key_size;
@@ -1783,7 +2153,14 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 again_nocopy:
 	dst_key = keys;
 	dst_val = values;
-	b = &htab->buckets[batch];
+	b = htab_walk_bucket(htab, batch);
+	if (!b) {
+		/* a resizable map shrank since the last call */
+		rcu_read_unlock();
+		bpf_enable_instrumentation();
+		ret = -ENOENT;
+		goto after_loop;
+	}
 	head = &b->head;
 	/* do not grab the lock unless need it (bucket_cnt > 0). */
 	if (locked) {
@@ -1900,7 +2277,7 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	/* If we are not copying data, we can go to next bucket and avoid
 	 * unlocking the rcu.
 	 */
-	if (!bucket_cnt && (batch + 1 < htab->n_buckets)) {
+	if (!bucket_cnt && (batch + 1 < htab_walk_size(htab))) {
 		batch++;
 		goto again_nocopy;
 	}
@@ -1917,7 +2294,7 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 
 	total += bucket_cnt;
 	batch++;
-	if (batch >= htab->n_buckets) {
+	if (batch >= htab_walk_size(htab)) {
 		ret = -ENOENT;
 		goto after_loop;
 	}
@@ -2029,7 +2406,7 @@ bpf_hash_map_seq_find_next(struct bpf_iter_seq_hash_map_info *info,
 	struct bucket *b;
 	u32 i, count;
 
-	if (bucket_id >= htab->n_buckets)
+	if (bucket_id >= htab_walk_size(htab))
 		return NULL;
 
 	/* try to find next elem in the same bucket */
@@ -2043,14 +2420,18 @@ bpf_hash_map_seq_find_next(struct bpf_iter_seq_hash_map_info *info,
 			return elem;
 
 		/* not found, unlock and go to the next bucket */
-		b = &htab->buckets[bucket_id++];
+		bucket_id++;
 		rcu_read_unlock();
 		skip_elems = 0;
 	}
 
-	for (i = bucket_id; i < htab->n_buckets; i++) {
-		b = &htab->buckets[i];
+	for (i = bucket_id; ; i++) {
 		rcu_read_lock();
+		b = htab_walk_bucket(htab, i);
+		if (!b) {
+			rcu_read_unlock();
+			break;
+		}
 
 		count = 0;
 		head = &b->head;
@@ -2219,9 +2600,13 @@ static long bpf_for_each_hash_elem(struct bpf_map *map, bpf_callback_t callback_
 	 */
 	if (is_percpu)
 		migrate_disable();
-	for (i = 0; i < htab->n_buckets; i++) {
-		b = &htab->buckets[i];
+	for (i = 0; ; i++) {
 		rcu_read_lock();
+		b = htab_walk_bucket(htab, i);
+		if (!b) {
+			rcu_read_unlock();
+			break;
+		}
 		head = &b->head;
 		hlist_nulls_for_each_entry_rcu(elem, n, head, hash_node) {
 			key = elem->key;
@@ -2259,7 +2644,7 @@ static u64 htab_map_mem_usage(const struct bpf_map *map)
 	u64 num_entries;
 	u64 usage = sizeof(struct bpf_htab);
 
-	usage += sizeof(struct bucket) * htab->n_buckets;
+	usage += sizeof(struct bucket) * htab_walk_size(htab);
 	usage += sizeof(int) * num_possible_cpus() * HASHTAB_MAP_LOCK_COUNT;
 	if (prealloc) {
 		num_entries = map->max_entries;
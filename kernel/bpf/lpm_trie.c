@@ -6,6 +6,7 @@
  * Copyright (c) 2016 David Herrmann
  */
 
+#include <linux/bitops.h>
 #include <linux/bpf.h>
 #include <linux/btf.h>
 #include <linux/err.h>
@@ -29,6 +30,9 @@ struct lpm_trie_node {
 	u8				data[];
 };
 
+struct lpm_mb_node;
+struct lpm_mb_scratch;
+
 struct lpm_trie {
 	struct bpf_map			map;
 	struct lpm_trie_node __rcu	*root;
@@ -36,6 +40,13 @@ struct lpm_trie {
 	size_t				max_prefixlen;
 	size_t				data_size;
 	spinlock_t			lock;
+
+	/* Multibit index, with BPF_F_LPM_MULTIBIT */
+	struct lpm_mb_node __rcu	*mb_root;
+	struct lpm_trie_node __rcu	*mb_default;
+	struct lpm_mb_scratch		*mb_scratch;
+	size_t				mb_size;
+	bool				mb_enabled;
 };
 
 /* This trie implements a longest prefix match algorithm that can be used to
@@ -232,19 +243,16 @@ static size_t longest_prefix_match(const struct lpm_trie *trie,
 	return __longest_prefix_match(trie, node, key);
 }
 
-/* Called from syscall or from eBPF program */
-static void *trie_lookup_elem(struct bpf_map *map, void *_key)
+/* Find the longest match of @key, which must not be longer than the trie */
+static struct lpm_trie_node *trie_lookup_node(const struct lpm_trie *trie,
+					      const struct bpf_lpm_trie_key_u8 *key)
 {
-	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
 	struct lpm_trie_node *node, *found = NULL;
-	struct bpf_lpm_trie_key_u8 *key = _key;
-
-	if (key->prefixlen > trie->max_prefixlen)
-		return NULL;
 
 	/* Start walking the trie from the root node ... */
 
-	for (node = rcu_dereference_check(trie->root, rcu_read_lock_bh_held());
+	for (node = rcu_dereference_check(trie->root, rcu_read_lock_bh_held() ||
+					  lockdep_is_held(&trie->lock));
 	     node;) {
 		unsigned int next_bit;
 		size_t matchlen;
@@ -278,9 +286,370 @@ static void *trie_lookup_elem(struct bpf_map *map, void *_key)
 		 */
 		next_bit = extract_bit(key->data, node->prefixlen);
 		node = rcu_dereference_check(node->child[next_bit],
-					     rcu_read_lock_bh_held());
+					     rcu_read_lock_bh_held() ||
+					     lockdep_is_held(&trie->lock));
 	}
 
+	return found;
+}
+
+/* The multibit index
+ *
+ * With BPF_F_LPM_MULTIBIT, the trie above stays the authoritative copy
+ * used for updates, deletes and iteration, and full-length lookups go
+ * through a second, multibit trie that indexes the same leaf nodes.
+ *
+ * It has one level per byte of the key.  A prefix of length l > 0 is
+ * stored at level (l - 1) / 8, expanded to the 2^(8 - r) slots of that
+ * level that it covers, r = l - 8 * level.  Each slot holds the longest
+ * prefix of its level covering it, if any, and a child for the next byte.
+ * A prefix of length 0 is kept aside in mb_default.  A lookup takes one
+ * node per byte and remembers the last leaf it saw, so an IPv4 lookup
+ * touches at most four nodes, and an IPv6 /48 lookup six.
+ *
+ * Nodes are compressed poptrie style: a 256 bit map of the slots that have
+ * a child, and a 256 bit map of the slots where the leaf differs from the
+ * previous slot.  Children and runs of leaves are stored densely and
+ * indexed by popcount, so even large prefix sets cost little memory.
+ *
+ * Nodes are never changed in place, except for a child pointer that is
+ * replaced by a new version of the child.  Updates build new versions of
+ * the nodes on the path of the changed prefix under trie->lock, publish
+ * them with one pointer store and free the old ones after a grace period,
+ * so lookups only need RCU.  If a new node cannot be allocated, the index
+ * is disabled and lookups go back to the trie.
+ *
+ * An update recomputes at most 128 slots of one level, by walking the at
+ * most 511 trie nodes of that level below the path, and rebuilds at most
+ * one node per level.  It runs with interrupts off, so the index is only
+ * available for keys of up to LPM_MB_DATA_SIZE_MAX bytes, IPv6 addresses.
+ */
+#define LPM_MB_DATA_SIZE_MAX	16
+
+struct lpm_mb_node {
+	u64			child_map[4];
+	u64			leaf_map[4];
+	u16			nr_children;
+	u16			nr_leaves;
+	u32			count;		/* prefixes at and below */
+	struct rcu_head		rcu;
+	void __rcu		*slots[];	/* children, then leaves */
+};
+
+struct lpm_mb_scratch {
+	struct lpm_mb_node	*children[256];
+	struct lpm_trie_node	*leaves[256];
+	struct lpm_mb_node	*path[LPM_MB_DATA_SIZE_MAX];
+	struct lpm_mb_node	*fresh[LPM_MB_DATA_SIZE_MAX];
+	struct bpf_lpm_trie_key_u8 key;		/* data_size bytes follow */
+};
+
+static __always_inline unsigned int mb_rank(const u64 *map, unsigned int s)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < s / 64; i++)
+		n += hweight64(map[i]);
+	return n + hweight64(map[s / 64] & (BIT_ULL(s % 64) - 1));
+}
+
+static __always_inline bool mb_test(const u64 *map, unsigned int s)
+{
+	return map[s / 64] & BIT_ULL(s % 64);
+}
+
+static __always_inline struct lpm_mb_node *
+mb_child(const struct lpm_mb_node *node, unsigned int s, bool locked)
+{
+	if (!mb_test(node->child_map, s))
+		return NULL;
+	return rcu_dereference_check(node->slots[mb_rank(node->child_map, s)],
+				     rcu_read_lock_bh_held() || locked);
+}
+
+static __always_inline struct lpm_trie_node *
+mb_leaf(const struct lpm_mb_node *node, unsigned int s)
+{
+	/* Slot 0 always starts a run */
+	unsigned int i = mb_rank(node->leaf_map, s) +
+			 mb_test(node->leaf_map, s) - 1;
+
+	return rcu_dereference_check(node->slots[node->nr_children + i],
+				     rcu_read_lock_bh_held());
+}
+
+static struct lpm_trie_node *
+trie_mb_lookup_node(const struct lpm_trie *trie,
+		    const struct bpf_lpm_trie_key_u8 *key)
+{
+	const struct lpm_mb_node *node;
+	struct lpm_trie_node *found, *leaf;
+	unsigned int level;
+
+	found = rcu_dereference_check(trie->mb_default, rcu_read_lock_bh_held());
+	node = rcu_dereference_check(trie->mb_root, rcu_read_lock_bh_held());
+	for (level = 0; node; level++) {
+		leaf = mb_leaf(node, key->data[level]);
+		if (leaf)
+			found = leaf;
+		node = mb_child(node, key->data[level], false);
+	}
+	return found;
+}
+
+/* Unpack @node, or an empty node, into the scratch slot arrays */
+static void mb_expand(const struct lpm_mb_node *node,
+		      struct lpm_mb_scratch *sc)
+{
+	unsigned int s, c = 0, l = 0;
+
+	if (!node) {
+		memset(sc->children, 0, sizeof(sc->children));
+		memset(sc->leaves, 0, sizeof(sc->leaves));
+		return;
+	}
+
+	for (s = 0; s < 256; s++) {
+		if (mb_test(node->leaf_map, s))
+			l++;
+		sc->leaves[s] = rcu_dereference_raw(node->slots[node->nr_children + l - 1]);
+		sc->children[s] = mb_test(node->child_map, s) ?
+				  rcu_dereference_raw(node->slots[c++]) : NULL;
+	}
+}
+
+/* Pack the scratch slot arrays into a new node */
+static struct lpm_mb_node *mb_compress(struct lpm_trie *trie,
+				       const struct lpm_mb_scratch *sc,
+				       u32 count)
+{
+	unsigned int s, nr_children = 0, nr_leaves = 0, c = 0, l = 0;
+	struct lpm_mb_node *node;
+	size_t size;
+
+	for (s = 0; s < 256; s++) {
+		nr_children += !!sc->children[s];
+		nr_leaves += !s || sc->leaves[s] != sc->leaves[s - 1];
+	}
+
+	size = struct_size(node, slots, nr_children + nr_leaves);
+	node = bpf_map_kmalloc_node(&trie->map, size,
+				    GFP_NOWAIT | __GFP_NOWARN | __GFP_ZERO,
+				    trie->map.numa_node);
+	if (!node)
+		return NULL;
+
+	node->nr_children = nr_children;
+	node->nr_leaves = nr_leaves;
+	node->count = count;
+	for (s = 0; s < 256; s++) {
+		if (sc->children[s]) {
+			node->child_map[s / 64] |= BIT_ULL(s % 64);
+			RCU_INIT_POINTER(node->slots[c++], sc->children[s]);
+		}
+		if (!s || sc->leaves[s] != sc->leaves[s - 1]) {
+			node->leaf_map[s / 64] |= BIT_ULL(s % 64);
+			RCU_INIT_POINTER(node->slots[nr_children + l++],
+					 sc->leaves[s]);
+		}
+	}
+	trie->mb_size += size;
+	return node;
+}
+
+/* The topmost trie node that extends the first @key->prefixlen bits of @key */
+static struct lpm_trie_node *mb_level_root(struct lpm_trie *trie,
+					   const struct bpf_lpm_trie_key_u8 *key)
+{
+	struct lpm_trie_node *node;
+	unsigned int next_bit;
+	size_t matchlen;
+
+	node = rcu_dereference_protected(trie->root,
+					 lockdep_is_held(&trie->lock));
+	while (node) {
+		matchlen = longest_prefix_match(trie, node, key);
+		if (node->prefixlen >= key->prefixlen)
+			return matchlen == key->prefixlen ? node : NULL;
+		if (matchlen < node->prefixlen)
+			return NULL;
+		next_bit = extract_bit(key->data, node->prefixlen);
+		node = rcu_dereference_protected(node->child[next_bit],
+						 lockdep_is_held(&trie->lock));
+	}
+	return NULL;
+}
+
+/* Set the slots [@first, @first + @nr) of @level to the longest prefix of
+ * that level at or below @node that covers them.  Children have longer
+ * prefixes and so override their parent.  At most nine nodes of a level
+ * are on one path, which bounds the recursion.
+ */
+static void mb_fill_leaves(struct lpm_trie *trie, struct lpm_mb_scratch *sc,
+			   struct lpm_trie_node *node, unsigned int level,
+			   unsigned int first, unsigned int nr)
+{
+	unsigned int len, start, end, s;
+	int i;
+
+	if (!node || node->prefixlen > 8 * (level + 1))
+		return;
+
+	len = node->prefixlen - 8 * level;
+	if (len) {
+		start = node->data[level] & (0xff00U >> len);
+		end = start + (1U << (8 - len));
+		/* The subtree of @node covers the same slots */
+		if (end <= first || start >= first + nr)
+			return;
+		if (!(node->flags & LPM_TREE_NODE_FLAG_IM))
+			for (s = max(start, first); s < min(end, first + nr); s++)
+				sc->leaves[s] = node;
+	}
+
+	for (i = 0; i < 2; i++)
+		mb_fill_leaves(trie, sc,
+			       rcu_dereference_protected(node->child[i],
+							 lockdep_is_held(&trie->lock)),
+			       level, first, nr);
+}
+
+static size_t mb_node_size(const struct lpm_mb_node *node)
+{
+	return struct_size(node, slots, node->nr_children + node->nr_leaves);
+}
+
+/**
+ * trie_mb_update() - bring the multibit index in line with the trie
+ * @trie:	The trie
+ * @key:	The prefix that was added, replaced or deleted in the trie
+ * @delta:	The change of the number of prefixes: 1, 0 or -1
+ *
+ * Recomputes the slots covered by @key at its level from the trie, and
+ * installs new versions of the nodes on its path.  Nodes that have been
+ * replaced are freed after a grace period.
+ */
+static int trie_mb_update(struct lpm_trie *trie,
+			  const struct bpf_lpm_trie_key_u8 *key, int delta)
+{
+	struct lpm_mb_scratch *sc = trie->mb_scratch;
+	struct lpm_mb_node *node, *old, *new;
+	unsigned int level, target, top, first, nr, s, i;
+	u32 count;
+
+	lockdep_assert_held(&trie->lock);
+
+	if (!key->prefixlen) {
+		sc->key.prefixlen = 0;
+		rcu_assign_pointer(trie->mb_default,
+				   trie_lookup_node(trie, &sc->key));
+		return 0;
+	}
+
+	target = (key->prefixlen - 1) / 8;
+	nr = 1U << (8 - (key->prefixlen - 8 * target));
+	first = key->data[target] & ~(nr - 1);
+
+	node = rcu_dereference_protected(trie->mb_root,
+					 lockdep_is_held(&trie->lock));
+	for (level = 0; level <= target; level++) {
+		sc->path[level] = node;
+		sc->fresh[level] = NULL;
+		if (node)
+			node = mb_child(node, key->data[level], true);
+	}
+
+	/* New version of the node at the level of @key */
+	old = sc->path[target];
+	mb_expand(old, sc);
+	memcpy(sc->key.data, key->data, trie->data_size);
+	sc->key.prefixlen = 8 * target;
+	for (s = first; s < first + nr; s++)
+		sc->leaves[s] = NULL;
+	mb_fill_leaves(trie, sc, mb_level_root(trie, &sc->key), target,
+		       first, nr);
+	top = target;
+	count = (old ? old->count : 0) + delta;
+	new = NULL;
+	if (count) {
+		new = mb_compress(trie, sc, count);
+		if (!new)
+			goto nomem;
+	}
+	sc->fresh[target] = new;
+
+	/* Rebuild the ancestors that gain or lose a child, up to the first
+	 * one where an existing child is only replaced by its new version.
+	 */
+	for (level = target; level-- > 0;) {
+		struct lpm_mb_node *parent = sc->path[level];
+
+		s = key->data[level];
+		if (old && new) {
+			i = mb_rank(parent->child_map, s);
+			rcu_assign_pointer(parent->slots[i], new);
+			for (i = 0; i <= level; i++)
+				sc->path[i]->count += delta;
+			goto free_old;
+		}
+
+		mb_expand(parent, sc);
+		sc->children[s] = new;
+		count = (parent ? parent->count : 0) + delta;
+		top = level;
+		old = parent;
+		new = NULL;
+		if (count) {
+			new = mb_compress(trie, sc, count);
+			if (!new)
+				goto nomem;
+		}
+		sc->fresh[level] = new;
+	}
+	rcu_assign_pointer(trie->mb_root, new);
+
+free_old:
+	for (level = top; level <= target; level++) {
+		old = sc->path[level];
+		if (old) {
+			trie->mb_size -= mb_node_size(old);
+			kfree_rcu(old, rcu);
+		}
+	}
+	return 0;
+
+nomem:
+	for (level = top; level <= target; level++) {
+		if (sc->fresh[level]) {
+			trie->mb_size -= mb_node_size(sc->fresh[level]);
+			kfree(sc->fresh[level]);
+		}
+	}
+	return -ENOMEM;
+}
+
+/* Keep the index in sync after a change of @key, or give up on it */
+static void trie_mb_sync(struct lpm_trie *trie,
+			 const struct bpf_lpm_trie_key_u8 *key, int delta)
+{
+	if (trie->mb_enabled && trie_mb_update(trie, key, delta))
+		WRITE_ONCE(trie->mb_enabled, false);
+}
+
+/* Called from syscall or from eBPF program */
+static void *trie_lookup_elem(struct bpf_map *map, void *_key)
+{
+	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
+	struct bpf_lpm_trie_key_u8 *key = _key;
+	struct lpm_trie_node *found;
+
+	if (key->prefixlen > trie->max_prefixlen)
+		return NULL;
+
+	if (key->prefixlen == trie->max_prefixlen && READ_ONCE(trie->mb_enabled))
+		found = trie_mb_lookup_node(trie, key);
+	else
+		found = trie_lookup_node(trie, key);
 	if (!found)
 		return NULL;
 
@@ -332,6 +701,7 @@ static long trie_update_elem(struct bpf_map *map,
 	unsigned long irq_flags;
 	unsigned int next_bit;
 	size_t matchlen = 0;
+	int delta = 1;
 	int ret = 0;
 
 	if (unlikely(flags > BPF_EXIST))
@@ -395,6 +765,7 @@ static long trie_update_elem(struct bpf_map *map,
 				ret = -EEXIST;
 				goto out;
 			}
+			delta = 0;
 		} else {
 			ret = trie_check_add_elem(trie, flags);
 			if (ret)
@@ -450,6 +821,8 @@ static long trie_update_elem(struct bpf_map *map,
 out:
 	if (ret)
 		kfree(new_node);
+	else
+		trie_mb_sync(trie, key, delta);
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
 	kfree_rcu(free_node, rcu);
 
@@ -548,6 +921,8 @@ static long trie_delete_elem(struct bpf_map *map, void *_key)
 	free_node = node;
 
 out:
+	if (!ret)
+		trie_mb_sync(trie, key, -1);
 	spin_unlock_irqrestore(&trie->lock, irq_flags);
 	kfree_rcu(free_parent, rcu);
 	kfree_rcu(free_node, rcu);
@@ -567,7 +942,7 @@ static long trie_delete_elem(struct bpf_map *map, void *_key)
 #define LPM_KEY_SIZE_MIN	LPM_KEY_SIZE(LPM_DATA_SIZE_MIN)
 
 #define LPM_CREATE_FLAG_MASK	(BPF_F_NO_PREALLOC | BPF_F_NUMA_NODE |	\
-				 BPF_F_ACCESS_MASK)
+				 BPF_F_ACCESS_MASK | BPF_F_LPM_MULTIBIT)
 
 static struct bpf_map *trie_alloc(union bpf_attr *attr)
 {
@@ -581,7 +956,9 @@ static struct bpf_map *trie_alloc(union bpf_attr *attr)
 	    attr->key_size < LPM_KEY_SIZE_MIN ||
 	    attr->key_size > LPM_KEY_SIZE_MAX ||
 	    attr->value_size < LPM_VAL_SIZE_MIN ||
-	    attr->value_size > LPM_VAL_SIZE_MAX)
+	    attr->value_size > LPM_VAL_SIZE_MAX ||
+	    (attr->map_flags & BPF_F_LPM_MULTIBIT &&
+	     attr->key_size > LPM_KEY_SIZE(LPM_MB_DATA_SIZE_MAX)))
 		return ERR_PTR(-EINVAL);
 
 	trie = bpf_map_area_alloc(sizeof(*trie), NUMA_NO_NODE);
@@ -596,9 +973,57 @@ static struct bpf_map *trie_alloc(union bpf_attr *attr)
 
 	spin_lock_init(&trie->lock);
 
+	if (attr->map_flags & BPF_F_LPM_MULTIBIT) {
+		struct lpm_mb_scratch *sc;
+
+		sc = bpf_map_area_alloc(sizeof(*sc) + trie->data_size,
+					NUMA_NO_NODE);
+		if (!sc) {
+			bpf_map_area_free(trie);
+			return ERR_PTR(-ENOMEM);
+		}
+		trie->mb_scratch = sc;
+		trie->mb_enabled = true;
+	}
+
 	return &trie->map;
 }
 
+static void trie_mb_free(struct lpm_trie *trie)
+{
+	struct lpm_mb_node __rcu **slot;
+	struct lpm_mb_node *node;
+	unsigned int i;
+
+	/* Same as for the trie: free a node without children, remove it
+	 * from its parent and start over.
+	 */
+	for (;;) {
+		slot = &trie->mb_root;
+
+		for (;;) {
+			node = rcu_dereference_protected(*slot, 1);
+			if (!node)
+				goto out;
+
+			for (i = 0; i < node->nr_children; i++)
+				if (rcu_access_pointer(node->slots[i]))
+					break;
+			if (i < node->nr_children) {
+				slot = (struct lpm_mb_node __rcu **)&node->slots[i];
+				continue;
+			}
+
+			kfree(node);
+			RCU_INIT_POINTER(*slot, NULL);
+			break;
+		}
+	}
+
+out:
+	bpf_map_area_free(trie->mb_scratch);
+}
+
 static void trie_free(struct bpf_map *map)
 {
 	struct lpm_trie *trie = container_of(map, struct lpm_trie, map);
@@ -635,6 +1060,7 @@ static void trie_free(struct bpf_map *map)
 	}
 
 out:
+	trie_mb_free(trie);
 	bpf_map_area_free(trie);
 }
 
@@ -753,7 +1179,8 @@ static u64 trie_mem_usage(const struct bpf_map *map)
 
 	elem_size = sizeof(struct lpm_trie_node) + trie->data_size +
 			    trie->map.value_size;
-	return elem_size * READ_ONCE(trie->n_entries);
+	return elem_size * READ_ONCE(trie->n_entries) +
+	       READ_ONCE(trie->mb_size);
 }
 
 BTF_ID_LIST_SINGLE(trie_map_btf_ids, struct, lpm_trie)
@@ -9,10 +9,12 @@
 #include <linux/wait.h>
 #include <linux/poll.h>
 #include <linux/kmemleak.h>
+#include <linux/mutex.h>
+#include <linux/sched/signal.h>
 #include <uapi/linux/btf.h>
 #include <linux/btf_ids.h>
 
-#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE)
+#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE | BPF_F_RINGBUF_PERCPU)
 
 /* non-mmap()'able part of bpf_ringbuf (everything up to consumer page) */
 #define RINGBUF_PGOFF \
@@ -23,13 +25,24 @@
 
 #define RINGBUF_MAX_RECORD_SZ (UINT_MAX/4)
 
+/* BPF_F_RINGBUF_PERCPU records end with the time they were reserved at */
+#define RINGBUF_TSTAMP_SZ sizeof(u64)
+
 struct bpf_ringbuf {
 	wait_queue_head_t waitq;
+	/* BPF_F_RINGBUF_PERCPU: the map's waitq, woken instead of waitq */
+	wait_queue_head_t *map_waitq;
 	struct irq_work work;
 	u64 mask;
 	struct page **pages;
 	int nr_pages;
 	raw_spinlock_t spinlock ____cacheline_aligned_in_smp;
+	/* BPF_F_RINGBUF_PERCPU rings only have producers on their own CPU,
+	 * so they are serialized with interrupts disabled rather than with
+	 * the spinlock. This is set while a reservation is in progress, to
+	 * fail one that nests in it from NMI.
+	 */
+	bool reserving;
 	/* For user-space producer ring buffers, an atomic_t busy bit is used
 	 * to synchronize access to the ring buffers in the kernel, rather than
 	 * the spinlock that is used for kernel-producer ring buffers. This is
@@ -78,6 +91,12 @@ struct bpf_ringbuf {
 struct bpf_ringbuf_map {
 	struct bpf_map map;
 	struct bpf_ringbuf *rb;
+	/* BPF_F_RINGBUF_PERCPU: the ring of each possible CPU, instead of rb,
+	 * and what waits for any of them.
+	 */
+	struct bpf_ringbuf **rbs;
+	wait_queue_head_t waitq;
+	struct mutex batch_mutex;
 };
 
 /* 8-byte ring buffer record header structure */
@@ -151,7 +170,7 @@ static void bpf_ringbuf_notify(struct irq_work *work)
 {
 	struct bpf_ringbuf *rb = container_of(work, struct bpf_ringbuf, work);
 
-	wake_up_all(&rb->waitq);
+	wake_up_all(rb->map_waitq ?: &rb->waitq);
 }
 
 /* Maximum size of ring buffer area is limited by 32-bit page offset within
@@ -186,24 +205,96 @@ static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 	return rb;
 }
 
+static void bpf_ringbuf_free(struct bpf_ringbuf *rb)
+{
+	/* copy pages pointer and nr_pages to local variable, as we are going
+	 * to unmap rb itself with vunmap() below
+	 */
+	struct page **pages = rb->pages;
+	int i, nr_pages = rb->nr_pages;
+
+	vunmap(rb);
+	for (i = 0; i < nr_pages; i++)
+		__free_page(pages[i]);
+	bpf_map_area_free(pages);
+}
+
+static void bpf_ringbuf_free_percpu(struct bpf_ringbuf_map *rb_map)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (rb_map->rbs[cpu])
+			bpf_ringbuf_free(rb_map->rbs[cpu]);
+	bpf_map_area_free(rb_map->rbs);
+}
+
+/* Allocate the ring of each possible CPU on that CPU's node */
+static int bpf_ringbuf_alloc_percpu(struct bpf_ringbuf_map *rb_map)
+{
+	struct bpf_ringbuf *rb;
+	int cpu;
+
+	rb_map->rbs = bpf_map_area_alloc(nr_cpu_ids * sizeof(*rb_map->rbs),
+					 NUMA_NO_NODE);
+	if (!rb_map->rbs)
+		return -ENOMEM;
+	memset(rb_map->rbs, 0, nr_cpu_ids * sizeof(*rb_map->rbs));
+
+	init_waitqueue_head(&rb_map->waitq);
+	mutex_init(&rb_map->batch_mutex);
+
+	for_each_possible_cpu(cpu) {
+		rb = bpf_ringbuf_alloc(rb_map->map.max_entries, cpu_to_node(cpu));
+		if (!rb) {
+			bpf_ringbuf_free_percpu(rb_map);
+			return -ENOMEM;
+		}
+		rb->map_waitq = &rb_map->waitq;
+		rb_map->rbs[cpu] = rb;
+	}
+	return 0;
+}
+
 static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 {
+	bool percpu = attr->map_flags & BPF_F_RINGBUF_PERCPU;
 	struct bpf_ringbuf_map *rb_map;
+	int err;
 
 	if (attr->map_flags & ~RINGBUF_CREATE_FLAG_MASK)
 		return ERR_PTR(-EINVAL);
 
-	if (attr->key_size || attr->value_size ||
+	if (percpu && (attr->map_type != BPF_MAP_TYPE_RINGBUF ||
+		       (attr->map_flags & BPF_F_NUMA_NODE)))
+		return ERR_PTR(-EINVAL);
+
+	/* value_size is the batch slot size, only for per-CPU rings */
+	if (attr->key_size || (attr->value_size && !percpu) ||
 	    !is_power_of_2(attr->max_entries) ||
 	    !PAGE_ALIGNED(attr->max_entries))
 		return ERR_PTR(-EINVAL);
 
+	if (attr->value_size &&
+	    (attr->value_size < BPF_RINGBUF_HDR_SZ + RINGBUF_TSTAMP_SZ ||
+	     attr->value_size > KMALLOC_MAX_SIZE))
+		return ERR_PTR(-EINVAL);
+
 	rb_map = bpf_map_area_alloc(sizeof(*rb_map), NUMA_NO_NODE);
 	if (!rb_map)
 		return ERR_PTR(-ENOMEM);
 
 	bpf_map_init_from_attr(&rb_map->map, attr);
 
+	if (percpu) {
+		err = bpf_ringbuf_alloc_percpu(rb_map);
+		if (err) {
+			bpf_map_area_free(rb_map);
+			return ERR_PTR(err);
+		}
+		return &rb_map->map;
+	}
+
 	rb_map->rb = bpf_ringbuf_alloc(attr->max_entries, rb_map->map.numa_node);
 	if (!rb_map->rb) {
 		bpf_map_area_free(rb_map);
@@ -213,26 +304,15 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 	return &rb_map->map;
 }
 
-static void bpf_ringbuf_free(struct bpf_ringbuf *rb)
-{
-	/* copy pages pointer and nr_pages to local variable, as we are going
-	 * to unmap rb itself with vunmap() below
-	 */
-	struct page **pages = rb->pages;
-	int i, nr_pages = rb->nr_pages;
-
-	vunmap(rb);
-	for (i = 0; i < nr_pages; i++)
-		__free_page(pages[i]);
-	bpf_map_area_free(pages);
-}
-
 static void ringbuf_map_free(struct bpf_map *map)
 {
 	struct bpf_ringbuf_map *rb_map;
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	bpf_ringbuf_free(rb_map->rb);
+	if (rb_map->rbs)
+		bpf_ringbuf_free_percpu(rb_map);
+	else
+		bpf_ringbuf_free(rb_map->rb);
 	bpf_map_area_free(rb_map);
 }
 
@@ -261,19 +341,33 @@ static int ringbuf_map_get_next_key(struct bpf_map *map, void *key,
 static int ringbuf_map_mmap_kern(struct bpf_map *map, struct vm_area_struct *vma)
 {
 	struct bpf_ringbuf_map *rb_map;
+	unsigned long pgoff = vma->vm_pgoff;
+	struct bpf_ringbuf *rb;
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
+	rb = rb_map->rb;
+
+	if (rb_map->rbs) {
+		/* the consumer, producer and data pages of each CPU in turn */
+		unsigned long stride = RINGBUF_POS_PAGES +
+				       2 * (map->max_entries >> PAGE_SHIFT);
+		unsigned long cpu = pgoff / stride;
+
+		if (cpu >= nr_cpu_ids || !rb_map->rbs[cpu])
+			return -EINVAL;
+		rb = rb_map->rbs[cpu];
+		pgoff %= stride;
+	}
 
 	if (vma->vm_flags & VM_WRITE) {
 		/* allow writable mapping for the consumer_pos only */
-		if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE)
+		if (pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE)
 			return -EPERM;
 	} else {
 		vm_flags_clear(vma, VM_MAYWRITE);
 	}
 	/* remap_vmalloc_range() checks size and offset constraints */
-	return remap_vmalloc_range(vma, rb_map->rb,
-				   vma->vm_pgoff + RINGBUF_PGOFF);
+	return remap_vmalloc_range(vma, rb, pgoff + RINGBUF_PGOFF);
 }
 
 static int ringbuf_map_mmap_user(struct bpf_map *map, struct vm_area_struct *vma)
@@ -316,6 +410,16 @@ static __poll_t ringbuf_map_poll_kern(struct bpf_map *map, struct file *filp,
 	struct bpf_ringbuf_map *rb_map;
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
+	if (rb_map->rbs) {
+		int cpu;
+
+		poll_wait(filp, &rb_map->waitq, pts);
+		for_each_possible_cpu(cpu)
+			if (ringbuf_avail_data_sz(rb_map->rbs[cpu]))
+				return EPOLLIN | EPOLLRDNORM;
+		return 0;
+	}
+
 	poll_wait(filp, &rb_map->rb->waitq, pts);
 
 	if (ringbuf_avail_data_sz(rb_map->rb))
@@ -338,19 +442,163 @@ static __poll_t ringbuf_map_poll_user(struct bpf_map *map, struct file *filp,
 
 static u64 ringbuf_map_mem_usage(const struct bpf_map *map)
 {
-	struct bpf_ringbuf *rb;
+	struct bpf_ringbuf_map *rb_map;
 	int nr_data_pages;
 	int nr_meta_pages;
 	u64 usage = sizeof(struct bpf_ringbuf_map);
+	u64 nr_rings = 1;
 
-	rb = container_of(map, struct bpf_ringbuf_map, map)->rb;
-	usage += (u64)rb->nr_pages << PAGE_SHIFT;
+	rb_map = container_of(map, struct bpf_ringbuf_map, map);
+	if (rb_map->rbs) {
+		nr_rings = num_possible_cpus();
+		usage += nr_cpu_ids * sizeof(*rb_map->rbs);
+	}
 	nr_meta_pages = RINGBUF_NR_META_PAGES;
 	nr_data_pages = map->max_entries >> PAGE_SHIFT;
-	usage += (nr_meta_pages + 2 * nr_data_pages) * sizeof(struct page *);
+	usage += nr_rings * ((u64)(nr_meta_pages + nr_data_pages) << PAGE_SHIFT);
+	usage += nr_rings * (nr_meta_pages + 2 * nr_data_pages) * sizeof(struct page *);
 	return usage;
 }
 
+/* Find the oldest record in the ring of a CPU, skipping discarded ones. The
+ * record may still be busy, its timestamp is set before it is published.
+ */
+static struct bpf_ringbuf_hdr *
+bpf_ringbuf_percpu_head(struct bpf_ringbuf *rb, unsigned long *cons_pos,
+			u32 *len, u64 *tstamp)
+{
+	unsigned long prod_pos;
+	struct bpf_ringbuf_hdr *hdr;
+	u32 hdr_len, total_len;
+
+	*cons_pos = smp_load_acquire(&rb->consumer_pos);
+	for (;;) {
+		prod_pos = smp_load_acquire(&rb->producer_pos);
+		if (*cons_pos >= prod_pos)
+			return NULL;
+
+		hdr = (void *)rb->data + (*cons_pos & rb->mask);
+		hdr_len = smp_load_acquire(&hdr->len);
+		*len = hdr_len & ~(BPF_RINGBUF_BUSY_BIT | BPF_RINGBUF_DISCARD_BIT);
+		total_len = round_up(*len + BPF_RINGBUF_HDR_SZ, 8);
+
+		/* consumer_pos is writable by user space, don't trust it */
+		if (*len < RINGBUF_TSTAMP_SZ ||
+		    total_len > prod_pos - *cons_pos ||
+		    total_len > ringbuf_total_data_sz(rb))
+			return ERR_PTR(-EINVAL);
+
+		if ((hdr_len & BPF_RINGBUF_DISCARD_BIT) &&
+		    !(hdr_len & BPF_RINGBUF_BUSY_BIT)) {
+			*cons_pos += total_len;
+			smp_store_release(&rb->consumer_pos, *cons_pos);
+			continue;
+		}
+
+		*tstamp = *(u64 *)((void *)hdr + total_len - RINGBUF_TSTAMP_SZ);
+		return hdr;
+	}
+}
+
+/* Consume up to batch.count records of the per-CPU rings, oldest first, into
+ * value_size slots of batch.values. Each slot is a header, with the record
+ * length and the CPU in place of the page offset, and the record itself.
+ * This stops at the first busy record, or at one that does not fit a slot.
+ *
+ * Timestamps of records on different CPUs are only approximately ordered,
+ * so this is a best effort merge.
+ */
+static int ringbuf_map_lookup_and_delete_batch(struct bpf_map *map,
+					       const union bpf_attr *attr,
+					       union bpf_attr __user *uattr)
+{
+	void __user *values = u64_to_user_ptr(attr->batch.values);
+	u32 value_size = map->value_size, max_count, count = 0;
+	unsigned long cons_pos, best_cons_pos = 0;
+	struct bpf_ringbuf_hdr *hdr, *best_hdr;
+	struct bpf_ringbuf_map *rb_map;
+	struct bpf_ringbuf *best_rb;
+	u32 len, best_len = 0;
+	u64 tstamp, best_tstamp;
+	int cpu, best_cpu = 0;
+	int ret = 0;
+
+	rb_map = container_of(map, struct bpf_ringbuf_map, map);
+	if (!rb_map->rbs || !value_size)
+		return -ENOTSUPP;
+
+	if (attr->batch.elem_flags || attr->batch.flags)
+		return -EINVAL;
+
+	max_count = attr->batch.count;
+	if (!max_count)
+		return 0;
+
+	if (put_user(0, &uattr->batch.count))
+		return -EFAULT;
+
+	mutex_lock(&rb_map->batch_mutex);
+	while (count < max_count) {
+		struct bpf_ringbuf_hdr slot_hdr;
+
+		best_hdr = NULL;
+		best_rb = NULL;
+		best_tstamp = 0;
+		for_each_possible_cpu(cpu) {
+			hdr = bpf_ringbuf_percpu_head(rb_map->rbs[cpu], &cons_pos,
+						      &len, &tstamp);
+			if (IS_ERR(hdr)) {
+				ret = PTR_ERR(hdr);
+				goto out;
+			}
+			if (hdr && (!best_hdr || tstamp < best_tstamp)) {
+				best_hdr = hdr;
+				best_rb = rb_map->rbs[cpu];
+				best_cons_pos = cons_pos;
+				best_len = len;
+				best_tstamp = tstamp;
+				best_cpu = cpu;
+			}
+		}
+
+		/* pairs with the xchg() in bpf_ringbuf_commit() */
+		if (!best_hdr ||
+		    (smp_load_acquire(&best_hdr->len) & BPF_RINGBUF_BUSY_BIT))
+			break;
+
+		if (best_len > value_size - BPF_RINGBUF_HDR_SZ) {
+			if (!count)
+				ret = -ENOSPC;
+			break;
+		}
+
+		slot_hdr.len = best_len;
+		slot_hdr.pg_off = best_cpu;
+		if (copy_to_user(values, &slot_hdr, BPF_RINGBUF_HDR_SZ) ||
+		    copy_to_user(values + BPF_RINGBUF_HDR_SZ, best_hdr + 1,
+				 best_len)) {
+			ret = -EFAULT;
+			break;
+		}
+
+		/* pairs with the producer's smp_load_acquire() */
+		smp_store_release(&best_rb->consumer_pos, best_cons_pos +
+				  round_up(best_len + BPF_RINGBUF_HDR_SZ, 8));
+		values += value_size;
+		count++;
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+out:
+	mutex_unlock(&rb_map->batch_mutex);
+
+	if (put_user(count, &uattr->batch.count))
+		ret = -EFAULT;
+	return ret;
+}
+
 BTF_ID_LIST_SINGLE(ringbuf_map_btf_ids, struct, bpf_ringbuf_map)
 const struct bpf_map_ops ringbuf_map_ops = {
 	.map_meta_equal = bpf_map_meta_equal,
@@ -362,6 +610,7 @@ const struct bpf_map_ops ringbuf_map_ops = {
 	.map_update_elem = ringbuf_map_update_elem,
 	.map_delete_elem = ringbuf_map_delete_elem,
 	.map_get_next_key = ringbuf_map_get_next_key,
+	.map_lookup_and_delete_batch = ringbuf_map_lookup_and_delete_batch,
 	.map_mem_usage = ringbuf_map_mem_usage,
 	.map_btf_id = &ringbuf_map_btf_ids[0],
 };
@@ -405,27 +654,17 @@ bpf_ringbuf_restore_from_rec(struct bpf_ringbuf_hdr *hdr)
 	return (void*)((addr & PAGE_MASK) - off);
 }
 
-static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
+/* Reserve a record of @size bytes, @len with header and padding, by moving
+ * the producer position. Called with producers of @rb serialized. With
+ * @tstamp, the last 8 bytes of the record are set to the current time.
+ */
+static void *bpf_ringbuf_reserve_locked(struct bpf_ringbuf *rb,
+					unsigned long cons_pos, u32 size,
+					u32 len, bool tstamp)
 {
-	unsigned long cons_pos, prod_pos, new_prod_pos, pend_pos, flags;
+	unsigned long prod_pos, new_prod_pos, pend_pos;
 	struct bpf_ringbuf_hdr *hdr;
-	u32 len, pg_off, tmp_size, hdr_len;
-
-	if (unlikely(size > RINGBUF_MAX_RECORD_SZ))
-		return NULL;
-
-	len = round_up(size + BPF_RINGBUF_HDR_SZ, 8);
-	if (len > ringbuf_total_data_sz(rb))
-		return NULL;
-
-	cons_pos = smp_load_acquire(&rb->consumer_pos);
-
-	if (in_nmi()) {
-		if (!raw_spin_trylock_irqsave(&rb->spinlock, flags))
-			return NULL;
-	} else {
-		raw_spin_lock_irqsave(&rb->spinlock, flags);
-	}
+	u32 pg_off, tmp_size, hdr_len;
 
 	pend_pos = rb->pending_pos;
 	prod_pos = rb->producer_pos;
@@ -449,22 +688,94 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 	 *   record does not span more than (ringbuf_size - 1)
 	 */
 	if (new_prod_pos - cons_pos > rb->mask ||
-	    new_prod_pos - pend_pos > rb->mask) {
-		raw_spin_unlock_irqrestore(&rb->spinlock, flags);
+	    new_prod_pos - pend_pos > rb->mask)
 		return NULL;
-	}
 
 	hdr = (void *)rb->data + (prod_pos & rb->mask);
 	pg_off = bpf_ringbuf_rec_pg_off(rb, hdr);
 	hdr->len = size | BPF_RINGBUF_BUSY_BIT;
 	hdr->pg_off = pg_off;
+	/* per-CPU ring consumers order records by this, even while busy */
+	if (tstamp)
+		*(u64 *)((void *)hdr + len - RINGBUF_TSTAMP_SZ) =
+			ktime_get_mono_fast_ns();
 
 	/* pairs with consumer's smp_load_acquire() */
 	smp_store_release(&rb->producer_pos, new_prod_pos);
 
+	return (void *)hdr + BPF_RINGBUF_HDR_SZ;
+}
+
+static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
+{
+	unsigned long cons_pos, flags;
+	void *sample;
+	u32 len;
+
+	if (unlikely(size > RINGBUF_MAX_RECORD_SZ))
+		return NULL;
+
+	len = round_up(size + BPF_RINGBUF_HDR_SZ, 8);
+	if (len > ringbuf_total_data_sz(rb))
+		return NULL;
+
+	cons_pos = smp_load_acquire(&rb->consumer_pos);
+
+	if (in_nmi()) {
+		if (!raw_spin_trylock_irqsave(&rb->spinlock, flags))
+			return NULL;
+	} else {
+		raw_spin_lock_irqsave(&rb->spinlock, flags);
+	}
+
+	sample = bpf_ringbuf_reserve_locked(rb, cons_pos, size, len, false);
+
 	raw_spin_unlock_irqrestore(&rb->spinlock, flags);
 
-	return (void *)hdr + BPF_RINGBUF_HDR_SZ;
+	return sample;
+}
+
+/* Reserve in the ring of the current CPU. The record is the sample padded
+ * to 8 bytes, then its timestamp, so consumers find the timestamp at the end
+ * of the record length from the header.
+ */
+static void *__bpf_ringbuf_reserve_percpu(struct bpf_ringbuf_map *rb_map,
+					  u64 size)
+{
+	unsigned long cons_pos, flags;
+	struct bpf_ringbuf *rb;
+	void *sample = NULL;
+	u32 len;
+
+	if (unlikely(size > RINGBUF_MAX_RECORD_SZ))
+		return NULL;
+
+	size = round_up(size, 8) + RINGBUF_TSTAMP_SZ;
+	len = size + BPF_RINGBUF_HDR_SZ;
+
+	local_irq_save(flags);
+	rb = rb_map->rbs[smp_processor_id()];
+	if (len > ringbuf_total_data_sz(rb) || READ_ONCE(rb->reserving))
+		goto out;
+
+	WRITE_ONCE(rb->reserving, true);
+	barrier();
+
+	cons_pos = smp_load_acquire(&rb->consumer_pos);
+	sample = bpf_ringbuf_reserve_locked(rb, cons_pos, size, len, true);
+
+	barrier();
+	WRITE_ONCE(rb->reserving, false);
+out:
+	local_irq_restore(flags);
+	return sample;
+}
+
+static void *bpf_ringbuf_map_reserve(struct bpf_ringbuf_map *rb_map, u64 size)
+{
+	if (rb_map->rbs)
+		return __bpf_ringbuf_reserve_percpu(rb_map, size);
+	return __bpf_ringbuf_reserve(rb_map->rb, size);
 }
 
 BPF_CALL_3(bpf_ringbuf_reserve, struct bpf_map *, map, u64, size, u64, flags)
@@ -475,7 +786,7 @@ BPF_CALL_3(bpf_ringbuf_reserve, struct bpf_map *, map, u64, size, u64, flags)
 		return 0;
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	return (unsigned long)__bpf_ringbuf_reserve(rb_map->rb, size);
+	return (unsigned long)bpf_ringbuf_map_reserve(rb_map, size);
 }
 
 const struct bpf_func_proto bpf_ringbuf_reserve_proto = {
@@ -550,7 +861,7 @@ BPF_CALL_4(bpf_ringbuf_output, struct bpf_map *, map, void *, data, u64, size,
 		return -EINVAL;
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
-	rec = __bpf_ringbuf_reserve(rb_map->rb, size);
+	rec = bpf_ringbuf_map_reserve(rb_map, size);
 	if (!rec)
 		return -EAGAIN;
 
@@ -570,9 +881,12 @@ const struct bpf_func_proto bpf_ringbuf_output_proto = {
 
 BPF_CALL_2(bpf_ringbuf_query, struct bpf_map *, map, u64, flags)
 {
+	struct bpf_ringbuf_map *rb_map;
 	struct bpf_ringbuf *rb;
 
-	rb = container_of(map, struct bpf_ringbuf_map, map)->rb;
+	rb_map = container_of(map, struct bpf_ringbuf_map, map);
+	/* per-CPU rings report on the ring of the current CPU */
+	rb = rb_map->rbs ? rb_map->rbs[raw_smp_processor_id()] : rb_map->rb;
 
 	switch (flags) {
 	case BPF_RB_AVAIL_DATA:
@@ -615,7 +929,7 @@ BPF_CALL_4(bpf_ringbuf_reserve_dynptr, struct bpf_map *, map, u32, size, u64, fl
 
 	rb_map = container_of(map, struct bpf_ringbuf_map, map);
 
-	sample = __bpf_ringbuf_reserve(rb_map->rb, size);
+	sample = bpf_ringbuf_map_reserve(rb_map, size);
 	if (!sample) {
 		bpf_dynptr_set_null(ptr);
 		return -EINVAL;
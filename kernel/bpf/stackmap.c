@@ -9,6 +9,8 @@
 #include <linux/perf_event.h>
 #include <linux/btf_ids.h>
 #include <linux/buildid.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
 #include "percpu_freelist.h"
 #include "mmap_unlock_work.h"
 
@@ -16,6 +18,32 @@
 	(BPF_F_NUMA_NODE | BPF_F_RDONLY | BPF_F_WRONLY |	\
 	 BPF_F_STACK_BUILD_ID)
 
+/* Buckets tried for a stack trace, from the one its hash selects */
+#define STACK_MAP_PROBES 4
+
+/* Build IDs of recently seen files on each CPU, so samples hitting the same
+ * binaries do not parse their ELF notes every time.  A build ID belongs to
+ * the file rather than to a VMA or mm, so entries are keyed by inode and
+ * checked against what identifies the inode's current contents.
+ */
+#define BUILD_ID_CACHE_BITS 5
+
+struct build_id_cache_entry {
+	const struct inode *inode;
+	unsigned long ino;
+	u32 generation;
+	u32 mtime_nsec;
+	time64_t mtime_sec;
+	unsigned char build_id[BUILD_ID_SIZE_MAX];
+};
+
+struct build_id_cache {
+	int busy;
+	struct build_id_cache_entry entries[1 << BUILD_ID_CACHE_BITS];
+};
+
+static DEFINE_PER_CPU(struct build_id_cache, build_id_cache);
+
 struct stack_map_bucket {
 	struct pcpu_freelist_node fnode;
 	u32 hash;
@@ -124,10 +152,62 @@ static struct bpf_map *stack_map_alloc(union bpf_attr *attr)
 	return ERR_PTR(err);
 }
 
+static bool build_id_cache_match(const struct build_id_cache_entry *ent,
+				 const struct inode *inode)
+{
+	return ent->inode == inode && ent->ino == inode->i_ino &&
+	       ent->generation == inode->i_generation &&
+	       ent->mtime_sec == inode_get_mtime_sec(inode) &&
+	       ent->mtime_nsec == inode_get_mtime_nsec(inode);
+}
+
+/* Look up or fill the build ID cache of this CPU.  Programs may nest from
+ * NMI, or be preempted with migration disabled, so an entry is only touched
+ * by the outermost user on the CPU.
+ */
+static bool build_id_cache_access(struct vm_area_struct *vma,
+				  unsigned char *build_id, bool fill)
+{
+	const struct inode *inode = file_inode(vma->vm_file);
+	struct build_id_cache_entry *ent;
+	struct build_id_cache *cache;
+	bool hit = false;
+
+	preempt_disable();
+	cache = this_cpu_ptr(&build_id_cache);
+	if (++cache->busy != 1)
+		goto out;
+
+	ent = &cache->entries[hash_ptr(inode, BUILD_ID_CACHE_BITS)];
+	if (fill) {
+		ent->inode = inode;
+		ent->ino = inode->i_ino;
+		ent->generation = inode->i_generation;
+		ent->mtime_sec = inode_get_mtime_sec(inode);
+		ent->mtime_nsec = inode_get_mtime_nsec(inode);
+		memcpy(ent->build_id, build_id, BUILD_ID_SIZE_MAX);
+	} else if (build_id_cache_match(ent, inode)) {
+		memcpy(build_id, ent->build_id, BUILD_ID_SIZE_MAX);
+		hit = true;
+	}
+out:
+	cache->busy--;
+	preempt_enable();
+	return hit;
+}
+
 static int fetch_build_id(struct vm_area_struct *vma, unsigned char *build_id, bool may_fault)
 {
-	return may_fault ? build_id_parse(vma, build_id, NULL)
-			 : build_id_parse_nofault(vma, build_id, NULL);
+	int err;
+
+	if (vma->vm_file && build_id_cache_access(vma, build_id, false))
+		return 0;
+
+	err = may_fault ? build_id_parse(vma, build_id, NULL)
+			: build_id_parse_nofault(vma, build_id, NULL);
+	if (!err)
+		build_id_cache_access(vma, build_id, true);
+	return err;
 }
 
 /*
@@ -224,16 +304,43 @@ get_callchain_entry_for_task(struct task_struct *task, u32 max_depth)
 #endif
 }
 
+/* Find a stack trace in the buckets probed for its hash, and the first of
+ * them that is empty.  With a NULL @data any bucket with the hash matches.
+ */
+static int stack_map_find(struct bpf_stack_map *smap, u32 hash,
+			  const void *data, u32 nr, u32 len, int *free_id)
+{
+	u32 i, id, probes = min_t(u32, STACK_MAP_PROBES, smap->n_buckets);
+	struct stack_map_bucket *bucket;
+
+	*free_id = -1;
+	for (i = 0; i < probes; i++) {
+		id = (hash + i) & (smap->n_buckets - 1);
+		bucket = READ_ONCE(smap->buckets[id]);
+		if (!bucket) {
+			if (*free_id < 0)
+				*free_id = id;
+			continue;
+		}
+		if (bucket->hash == hash &&
+		    (!data || (bucket->nr == nr &&
+			       memcmp(bucket->data, data, len) == 0)))
+			return id;
+	}
+	return -ENOENT;
+}
+
 static long __bpf_get_stackid(struct bpf_map *map,
 			      struct perf_callchain_entry *trace, u64 flags)
 {
 	struct bpf_stack_map *smap = container_of(map, struct bpf_stack_map, map);
-	struct stack_map_bucket *bucket, *new_bucket, *old_bucket;
+	struct stack_map_bucket *new_bucket = NULL, *old_bucket;
 	u32 skip = flags & BPF_F_SKIP_FIELD_MASK;
-	u32 hash, id, trace_nr, trace_len, i;
+	u32 hash, trace_nr, trace_len, i;
 	bool user = flags & BPF_F_USER_STACK;
+	int id, free_id;
+	void *data;
 	u64 *ips;
-	bool hash_matches;
 
 	if (trace->nr <= skip)
 		/* skipping more than usable stack trace */
@@ -243,13 +350,13 @@ static long __bpf_get_stackid(struct bpf_map *map,
 	trace_len = trace_nr * sizeof(u64);
 	ips = trace->ip + skip;
 	hash = jhash2((u32 *)ips, trace_len / sizeof(u32), 0);
-	id = hash & (smap->n_buckets - 1);
-	bucket = READ_ONCE(smap->buckets[id]);
 
-	hash_matches = bucket && bucket->hash == hash;
 	/* fast cmp */
-	if (hash_matches && flags & BPF_F_FAST_STACK_CMP)
-		return id;
+	if (flags & BPF_F_FAST_STACK_CMP) {
+		id = stack_map_find(smap, hash, NULL, 0, 0, &free_id);
+		if (id >= 0)
+			return id;
+	}
 
 	if (stack_map_use_build_id(map)) {
 		struct bpf_stack_build_id *id_offs;
@@ -265,22 +372,21 @@ static long __bpf_get_stackid(struct bpf_map *map,
 			id_offs[i].ip = ips[i];
 		stack_map_get_build_id_offset(id_offs, trace_nr, user, false /* !may_fault */);
 		trace_len = trace_nr * sizeof(struct bpf_stack_build_id);
-		if (hash_matches && bucket->nr == trace_nr &&
-		    memcmp(bucket->data, new_bucket->data, trace_len) == 0) {
-			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
-			return id;
-		}
-		if (bucket && !(flags & BPF_F_REUSE_STACKID)) {
-			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
-			return -EEXIST;
-		}
+		data = new_bucket->data;
 	} else {
-		if (hash_matches && bucket->nr == trace_nr &&
-		    memcmp(bucket->data, ips, trace_len) == 0)
-			return id;
-		if (bucket && !(flags & BPF_F_REUSE_STACKID))
-			return -EEXIST;
+		data = ips;
+	}
+
+	id = stack_map_find(smap, hash, data, trace_nr, trace_len, &free_id);
+	if (id < 0 && free_id < 0 && !(flags & BPF_F_REUSE_STACKID))
+		id = -EEXIST;
+	if (id != -ENOENT) {
+		if (new_bucket)
+			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
+		return id;
+	}
 
+	if (!new_bucket) {
 		new_bucket = (struct stack_map_bucket *)
 			pcpu_freelist_pop(&smap->freelist);
 		if (unlikely(!new_bucket))
@@ -291,6 +397,18 @@ static long __bpf_get_stackid(struct bpf_map *map,
 	new_bucket->hash = hash;
 	new_bucket->nr = trace_nr;
 
+	if (free_id >= 0) {
+		if (cmpxchg(&smap->buckets[free_id], NULL, new_bucket) == NULL)
+			return free_id;
+		/* lost the empty bucket to a concurrent trace */
+		if (!(flags & BPF_F_REUSE_STACKID)) {
+			pcpu_freelist_push(&smap->freelist, &new_bucket->fnode);
+			return -EEXIST;
+		}
+	}
+
+	/* BPF_F_REUSE_STACKID: replace the trace in the first probed bucket */
+	id = hash & (smap->n_buckets - 1);
 	old_bucket = xchg(&smap->buckets[id], new_bucket);
 	if (old_bucket)
 		pcpu_freelist_push(&smap->freelist, &old_bucket->fnode);
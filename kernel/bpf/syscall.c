@@ -889,6 +889,8 @@ static void bpf_map_show_fdinfo(struct seq_file *m, struct file *filp)
 		seq_printf(m, "owner_prog_type:\t%u\n", type);
 		seq_printf(m, "owner_jited:\t%u\n", jited);
 	}
+	if (map->ops->map_show_fdinfo)
+		map->ops->map_show_fdinfo(map, m);
 }
 #endif
 
@@ -3484,6 +3486,218 @@ static int bpf_tracing_prog_attach(struct bpf_prog *prog,
 	return err;
 }
 
+#define MAX_TRACING_MULTI_CNT (1U << 16)
+
+struct bpf_tracing_multi_link {
+	struct bpf_link link;
+	enum bpf_attach_type attach_type;
+	u32 cnt;
+	struct bpf_trampoline **trs;
+	/* one per trampoline, only prog, cookie and tramp_hlist are used */
+	struct bpf_tramp_link *nodes;
+};
+
+struct bpf_tracing_multi_target {
+	u32 btf_id;
+	u64 cookie;
+};
+
+static void bpf_tracing_multi_link_release(struct bpf_link *link)
+{
+	struct bpf_tracing_multi_link *mlink =
+		container_of(link, struct bpf_tracing_multi_link, link);
+	u32 i;
+
+	bpf_trampoline_multi_unlink_prog(mlink->nodes, mlink->trs, mlink->cnt);
+	for (i = 0; i < mlink->cnt; i++)
+		bpf_trampoline_put(mlink->trs[i]);
+}
+
+static void bpf_tracing_multi_link_dealloc(struct bpf_link *link)
+{
+	struct bpf_tracing_multi_link *mlink =
+		container_of(link, struct bpf_tracing_multi_link, link);
+
+	kvfree(mlink->nodes);
+	kvfree(mlink->trs);
+	kfree(mlink);
+}
+
+static void bpf_tracing_multi_link_show_fdinfo(const struct bpf_link *link,
+					       struct seq_file *seq)
+{
+	struct bpf_tracing_multi_link *mlink =
+		container_of(link, struct bpf_tracing_multi_link, link);
+	u32 target_btf_id, target_obj_id;
+
+	bpf_trampoline_unpack_key(mlink->trs[0]->key,
+				  &target_obj_id, &target_btf_id);
+	seq_printf(seq,
+		   "attach_type:\t%d\n"
+		   "target_obj_id:\t%u\n"
+		   "target_cnt:\t%u\n",
+		   mlink->attach_type,
+		   target_obj_id,
+		   mlink->cnt);
+}
+
+static const struct bpf_link_ops bpf_tracing_multi_link_lops = {
+	.release = bpf_tracing_multi_link_release,
+	.dealloc = bpf_tracing_multi_link_dealloc,
+	.show_fdinfo = bpf_tracing_multi_link_show_fdinfo,
+};
+
+static int bpf_tracing_multi_target_cmp(const void *a, const void *b)
+{
+	const struct bpf_tracing_multi_target *ta = a, *tb = b;
+
+	if (ta->btf_id == tb->btf_id)
+		return 0;
+	return ta->btf_id < tb->btf_id ? -1 : 1;
+}
+
+static struct bpf_tracing_multi_target *
+bpf_tracing_multi_copy_targets(const union bpf_attr *attr, u32 cnt)
+{
+	void __user *ucookies = u64_to_user_ptr(attr->link_create.tracing.cookies);
+	void __user *uids = u64_to_user_ptr(attr->link_create.tracing.btf_ids);
+	struct bpf_tracing_multi_target *targets;
+	int err = -EFAULT;
+	u32 i;
+
+	targets = kvcalloc(cnt, sizeof(*targets), GFP_KERNEL);
+	if (!targets)
+		return ERR_PTR(-ENOMEM);
+
+	for (i = 0; i < cnt; i++) {
+		if (get_user(targets[i].btf_id, (u32 __user *)uids + i))
+			goto err_free;
+		if (ucookies &&
+		    get_user(targets[i].cookie, (u64 __user *)ucookies + i))
+			goto err_free;
+	}
+
+	/* each function once, bpf_trampoline_multi_lock() takes each tr->mutex once */
+	sort(targets, cnt, sizeof(*targets), bpf_tracing_multi_target_cmp, NULL);
+	for (i = 1; i < cnt; i++) {
+		if (targets[i].btf_id == targets[i - 1].btf_id) {
+			err = -EINVAL;
+			goto err_free;
+		}
+	}
+	return targets;
+
+err_free:
+	kvfree(targets);
+	return ERR_PTR(err);
+}
+
+/*
+ * Attach a fentry/fexit/fmod_ret prog to many kernel functions with one link.
+ * The functions have to share the prototype of the one the prog was verified
+ * against, BTF dedup gives identical prototypes the same type, so comparing
+ * the FUNC_PROTO is enough. All trampolines are then set up and patched in
+ * one go by bpf_trampoline_multi_link_prog().
+ */
+static int bpf_tracing_multi_link_attach(struct bpf_prog *prog,
+					 const union bpf_attr *attr)
+{
+	u32 cnt = attr->link_create.tracing.cnt;
+	struct bpf_tracing_multi_target *targets;
+	struct bpf_tracing_multi_link *mlink;
+	struct bpf_link_primer link_primer;
+	struct btf *btf = prog->aux->attach_btf;
+	u32 i, nr_trs = 0;
+	int err;
+
+	if (prog->type != BPF_PROG_TYPE_TRACING ||
+	    (prog->expected_attach_type != BPF_TRACE_FENTRY &&
+	     prog->expected_attach_type != BPF_TRACE_FEXIT &&
+	     prog->expected_attach_type != BPF_MODIFY_RETURN))
+		return -EINVAL;
+	if (attr->link_create.flags || attr->link_create.target_fd ||
+	    attr->link_create.tracing.target_btf_id ||
+	    attr->link_create.tracing.cookie)
+		return -EINVAL;
+	if (cnt > MAX_TRACING_MULTI_CNT)
+		return -E2BIG;
+	/* kernel functions only, and no module references to hold */
+	if (!btf || btf_is_module(btf))
+		return -EOPNOTSUPP;
+
+	targets = bpf_tracing_multi_copy_targets(attr, cnt);
+	if (IS_ERR(targets))
+		return PTR_ERR(targets);
+
+	err = -ENOMEM;
+	mlink = kzalloc(sizeof(*mlink), GFP_USER);
+	if (!mlink)
+		goto out_free_targets;
+	mlink->trs = kvcalloc(cnt, sizeof(*mlink->trs), GFP_USER);
+	mlink->nodes = kvcalloc(cnt, sizeof(*mlink->nodes), GFP_USER);
+	if (!mlink->trs || !mlink->nodes)
+		goto out_free_link;
+
+	for (nr_trs = 0; nr_trs < cnt; nr_trs++) {
+		struct bpf_attach_target_info tgt_info = {};
+		u32 btf_id = targets[nr_trs].btf_id;
+		struct bpf_trampoline *tr;
+
+		err = bpf_check_attach_target(NULL, prog, NULL, btf_id, &tgt_info);
+		if (err)
+			goto out_put_trs;
+		if (tgt_info.tgt_type != prog->aux->attach_func_proto ||
+		    bpf_tracing_btf_id_denied(btf_id)) {
+			err = -EINVAL;
+			goto out_put_trs;
+		}
+
+		tr = bpf_trampoline_get(bpf_trampoline_compute_key(NULL, btf, btf_id),
+					&tgt_info);
+		if (!tr) {
+			err = -ENOMEM;
+			goto out_put_trs;
+		}
+		mlink->trs[nr_trs] = tr;
+
+		INIT_HLIST_NODE(&mlink->nodes[nr_trs].tramp_hlist);
+		mlink->nodes[nr_trs].link.prog = prog;
+		mlink->nodes[nr_trs].cookie = targets[nr_trs].cookie;
+	}
+
+	bpf_link_init(&mlink->link, BPF_LINK_TYPE_TRACING_MULTI,
+		      &bpf_tracing_multi_link_lops, prog);
+	mlink->attach_type = prog->expected_attach_type;
+	mlink->cnt = cnt;
+
+	err = bpf_link_prime(&mlink->link, &link_primer);
+	if (err)
+		goto out_put_trs;
+
+	err = bpf_trampoline_multi_link_prog(mlink->nodes, mlink->trs, cnt);
+	if (err) {
+		for (i = 0; i < cnt; i++)
+			bpf_trampoline_put(mlink->trs[i]);
+		/* frees mlink through ->dealloc */
+		bpf_link_cleanup(&link_primer);
+		goto out_free_targets;
+	}
+
+	kvfree(targets);
+	return bpf_link_settle(&link_primer);
+
+out_put_trs:
+	for (i = 0; i < nr_trs; i++)
+		bpf_trampoline_put(mlink->trs[i]);
+out_free_link:
+	kvfree(mlink->nodes);
+	kvfree(mlink->trs);
+	kfree(mlink);
+out_free_targets:
+	kvfree(targets);
+	return err;
+}
+
 static void bpf_raw_tp_link_release(struct bpf_link *link)
 {
 	struct bpf_raw_tp_link *raw_tp =
@@ -5232,6 +5446,8 @@ static int link_create(union bpf_attr *attr, bpfptr_t uattr)
 			ret = bpf_iter_link_attach(attr, uattr, prog);
 		else if (prog->expected_attach_type == BPF_LSM_CGROUP)
 			ret = cgroup_bpf_link_attach(attr, prog);
+		else if (attr->link_create.tracing.cnt)
+			ret = bpf_tracing_multi_link_attach(prog, attr);
 		else
 			ret = bpf_tracing_prog_attach(prog,
 						      attr->link_create.target_fd,
@@ -13,6 +13,7 @@
 #include <linux/bpf_verifier.h>
 #include <linux/bpf_lsm.h>
 #include <linux/delay.h>
+#include <linux/sort.h>
 
 /* dummy _ops. The verifier will operate on target program's ops. */
 const struct bpf_verifier_ops bpf_extension_verifier_ops = {
@@ -29,6 +30,9 @@ static struct hlist_head trampoline_table[TRAMPOLINE_TABLE_SIZE];
 /* serializes access to trampoline_table */
 static DEFINE_MUTEX(trampoline_mutex);
 
+/* serializes holders of many tr->mutex, see bpf_trampoline_multi_lock() */
+static DEFINE_MUTEX(trampoline_multi_mutex);
+
 #ifdef CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS
 static int bpf_trampoline_update(struct bpf_trampoline *tr, bool lock_direct_mutex);
 
@@ -395,25 +399,10 @@ static struct bpf_tramp_image *bpf_tramp_image_alloc(u64 key, int size)
 	return ERR_PTR(err);
 }
 
-static int bpf_trampoline_update(struct bpf_trampoline *tr, bool lock_direct_mutex)
+static void bpf_trampoline_set_flags(struct bpf_trampoline *tr,
+				     struct bpf_tramp_links *tlinks,
+				     bool ip_arg)
 {
-	struct bpf_tramp_image *im;
-	struct bpf_tramp_links *tlinks;
-	u32 orig_flags = tr->flags;
-	bool ip_arg = false;
-	int err, total, size;
-
-	tlinks = bpf_trampoline_get_progs(tr, &total, &ip_arg);
-	if (IS_ERR(tlinks))
-		return PTR_ERR(tlinks);
-
-	if (total == 0) {
-		err = unregister_fentry(tr, tr->cur_image->image);
-		bpf_tramp_image_put(tr->cur_image);
-		tr->cur_image = NULL;
-		goto out;
-	}
-
 	/* clear all bits except SHARE_IPMODIFY and TAIL_CALL_CTX */
 	tr->flags &= (BPF_TRAMP_F_SHARE_IPMODIFY | BPF_TRAMP_F_TAIL_CALL_CTX);
 
@@ -429,31 +418,26 @@ static int bpf_trampoline_update(struct bpf_trampoline *tr, bool lock_direct_mut
 
 	if (ip_arg)
 		tr->flags |= BPF_TRAMP_F_IP_ARG;
+}
 
-#ifdef CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS
-again:
-	if ((tr->flags & BPF_TRAMP_F_SHARE_IPMODIFY) &&
-	    (tr->flags & BPF_TRAMP_F_CALL_ORIG))
-		tr->flags |= BPF_TRAMP_F_ORIG_STACK;
-#endif
+/* Generate a new image for the current tr->flags, not yet attached */
+static struct bpf_tramp_image *
+bpf_trampoline_prepare(struct bpf_trampoline *tr, struct bpf_tramp_links *tlinks)
+{
+	struct bpf_tramp_image *im;
+	int err, size;
 
 	size = arch_bpf_trampoline_size(&tr->func.model, tr->flags,
 					tlinks, tr->func.addr);
-	if (size < 0) {
-		err = size;
-		goto out;
-	}
+	if (size < 0)
+		return ERR_PTR(size);
 
-	if (size > PAGE_SIZE) {
-		err = -E2BIG;
-		goto out;
-	}
+	if (size > PAGE_SIZE)
+		return ERR_PTR(-E2BIG);
 
 	im = bpf_tramp_image_alloc(tr->key, size);
-	if (IS_ERR(im)) {
-		err = PTR_ERR(im);
-		goto out;
-	}
+	if (IS_ERR(im))
+		return im;
 
 	err = arch_prepare_bpf_trampoline(im, im->image, im->image + size,
 					  &tr->func.model, tr->flags, tlinks,
@@ -465,6 +449,47 @@ static int bpf_trampoline_update(struct bpf_trampoline *tr, bool lock_direct_mut
 	if (err)
 		goto out_free;
 
+	return im;
+
+out_free:
+	bpf_tramp_image_free(im);
+	return ERR_PTR(err);
+}
+
+static int bpf_trampoline_update(struct bpf_trampoline *tr, bool lock_direct_mutex)
+{
+	struct bpf_tramp_image *im;
+	struct bpf_tramp_links *tlinks;
+	u32 orig_flags = tr->flags;
+	bool ip_arg = false;
+	int err, total;
+
+	tlinks = bpf_trampoline_get_progs(tr, &total, &ip_arg);
+	if (IS_ERR(tlinks))
+		return PTR_ERR(tlinks);
+
+	if (total == 0) {
+		err = unregister_fentry(tr, tr->cur_image->image);
+		bpf_tramp_image_put(tr->cur_image);
+		tr->cur_image = NULL;
+		goto out;
+	}
+
+	bpf_trampoline_set_flags(tr, tlinks, ip_arg);
+
+#ifdef CONFIG_DYNAMIC_FTRACE_WITH_DIRECT_CALLS
+again:
+	if ((tr->flags & BPF_TRAMP_F_SHARE_IPMODIFY) &&
+	    (tr->flags & BPF_TRAMP_F_CALL_ORIG))
+		tr->flags |= BPF_TRAMP_F_ORIG_STACK;
+#endif
+
+	im = bpf_trampoline_prepare(tr, tlinks);
+	if (IS_ERR(im)) {
+		err = PTR_ERR(im);
+		goto out;
+	}
+
 	WARN_ON(tr->cur_image && total == 0);
 	if (tr->cur_image)
 		/* progs already running at this address */
@@ -546,14 +571,45 @@ static int bpf_freplace_check_tgt_prog(struct bpf_prog *tgt_prog)
 	return 0;
 }
 
+static int bpf_trampoline_nr_progs(const struct bpf_trampoline *tr)
+{
+	int cnt = 0, i;
+
+	for (i = 0; i < BPF_TRAMP_MAX; i++)
+		cnt += tr->progs_cnt[i];
+	return cnt;
+}
+
+static int bpf_trampoline_add_link(struct bpf_tramp_link *link,
+				   struct bpf_trampoline *tr,
+				   enum bpf_tramp_prog_type kind, int cnt)
+{
+	struct bpf_tramp_link *link_exiting;
+
+	if (cnt >= BPF_MAX_TRAMP_LINKS)
+		return -E2BIG;
+	if (!hlist_unhashed(&link->tramp_hlist))
+		/* prog already linked */
+		return -EBUSY;
+	hlist_for_each_entry(link_exiting, &tr->progs_hlist[kind], tramp_hlist) {
+		if (link_exiting->link.prog != link->link.prog)
+			continue;
+		/* prog already linked */
+		return -EBUSY;
+	}
+
+	hlist_add_head(&link->tramp_hlist, &tr->progs_hlist[kind]);
+	tr->progs_cnt[kind]++;
+	return 0;
+}
+
 static int __bpf_trampoline_link_prog(struct bpf_tramp_link *link,
 				      struct bpf_trampoline *tr,
 				      struct bpf_prog *tgt_prog)
 {
 	enum bpf_tramp_prog_type kind;
-	struct bpf_tramp_link *link_exiting;
 	int err = 0;
-	int cnt = 0, i;
+	int cnt;
 
 	kind = bpf_attach_type_to_tramp(link->link.prog);
 	if (tr->extension_prog)
@@ -562,8 +618,7 @@ static int __bpf_trampoline_link_prog(struct bpf_tramp_link *link,
 		 */
 		return -EBUSY;
 
-	for (i = 0; i < BPF_TRAMP_MAX; i++)
-		cnt += tr->progs_cnt[i];
+	cnt = bpf_trampoline_nr_progs(tr);
 
 	if (kind == BPF_TRAMP_REPLACE) {
 		/* Cannot attach extension if fentry/fexit are in use. */
@@ -576,20 +631,10 @@ static int __bpf_trampoline_link_prog(struct bpf_tramp_link *link,
 		return bpf_arch_text_poke(tr->func.addr, BPF_MOD_JUMP, NULL,
 					  link->link.prog->bpf_func);
 	}
-	if (cnt >= BPF_MAX_TRAMP_LINKS)
-		return -E2BIG;
-	if (!hlist_unhashed(&link->tramp_hlist))
-		/* prog already linked */
-		return -EBUSY;
-	hlist_for_each_entry(link_exiting, &tr->progs_hlist[kind], tramp_hlist) {
-		if (link_exiting->link.prog != link->link.prog)
-			continue;
-		/* prog already linked */
-		return -EBUSY;
-	}
+	err = bpf_trampoline_add_link(link, tr, kind, cnt);
+	if (err)
+		return err;
 
-	hlist_add_head(&link->tramp_hlist, &tr->progs_hlist[kind]);
-	tr->progs_cnt[kind]++;
 	err = bpf_trampoline_update(tr, true /* lock_direct_mutex */);
 	if (err) {
 		hlist_del_init(&link->tramp_hlist);
@@ -645,6 +690,203 @@ int bpf_trampoline_unlink_prog(struct bpf_tramp_link *link,
 	return err;
 }
 
+static int bpf_text_poke_desc_cmp(const void *a, const void *b)
+{
+	const struct bpf_text_poke_desc *pa = a, *pb = b;
+
+	if (pa->ip == pb->ip)
+		return 0;
+	return pa->ip < pb->ip ? -1 : 1;
+}
+
+/*
+ * Regenerate the images of @cnt locked trampolines and switch their call
+ * sites over. Sites patched with bpf_arch_text_poke() are all switched by one
+ * bpf_arch_text_poke_batch(). ftrace managed ones still go through ftrace one
+ * trampoline at a time, as a ftrace_ops has a single direct call address.
+ *
+ * Returns the first error. Trampolines that failed keep their old image.
+ */
+static int bpf_trampoline_multi_update(struct bpf_trampoline **trs, u32 cnt)
+{
+	struct bpf_text_poke_desc *pokes;
+	struct bpf_tramp_links *tlinks;
+	struct bpf_tramp_image **ims;
+	struct bpf_trampoline *tr;
+	struct bpf_tramp_image *im;
+	u32 *orig_flags, i, nr = 0;
+	int err = 0, ret, total;
+	bool ip_arg;
+
+	pokes = kvcalloc(cnt, sizeof(*pokes), GFP_KERNEL);
+	ims = kvcalloc(cnt, sizeof(*ims), GFP_KERNEL);
+	orig_flags = kvcalloc(cnt, sizeof(*orig_flags), GFP_KERNEL);
+	if (!pokes || !ims || !orig_flags) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		tr = trs[i];
+		if (!tr->cur_image && !bpf_trampoline_nr_progs(tr))
+			/* never got attached, nothing to undo */
+			continue;
+
+		if (tr->func.ftrace_managed ||
+		    (!tr->cur_image &&
+		     ftrace_location((unsigned long)tr->func.addr))) {
+			ret = bpf_trampoline_update(tr, true /* lock_direct_mutex */);
+			err = err ?: ret;
+			continue;
+		}
+
+		ip_arg = false;
+		tlinks = bpf_trampoline_get_progs(tr, &total, &ip_arg);
+		if (IS_ERR(tlinks)) {
+			err = err ?: PTR_ERR(tlinks);
+			continue;
+		}
+
+		orig_flags[i] = tr->flags;
+		im = NULL;
+		if (total) {
+			bpf_trampoline_set_flags(tr, tlinks, ip_arg);
+			im = bpf_trampoline_prepare(tr, tlinks);
+		}
+		kfree(tlinks);
+		if (IS_ERR(im)) {
+			err = err ?: PTR_ERR(im);
+			tr->flags = orig_flags[i];
+			continue;
+		}
+
+		ims[i] = im;
+		pokes[nr].ip = tr->func.addr;
+		pokes[nr].t = BPF_MOD_CALL;
+		pokes[nr].old_addr = tr->cur_image ? tr->cur_image->image : NULL;
+		pokes[nr].new_addr = im ? im->image : NULL;
+		pokes[nr].idx = i;
+		nr++;
+	}
+
+	sort(pokes, nr, sizeof(*pokes), bpf_text_poke_desc_cmp, NULL);
+	bpf_arch_text_poke_batch(pokes, nr);
+
+	for (i = 0; i < nr; i++) {
+		tr = trs[pokes[i].idx];
+		im = ims[pokes[i].idx];
+		/* 1 means the site already had the new insn */
+		if (pokes[i].ret < 0)
+			err = err ?: pokes[i].ret;
+
+		if (!im) {
+			/* as in bpf_trampoline_update(), with no progs left */
+			bpf_tramp_image_put(tr->cur_image);
+			tr->cur_image = NULL;
+		} else if (pokes[i].ret < 0) {
+			tr->flags = orig_flags[pokes[i].idx];
+			bpf_tramp_image_free(im);
+		} else {
+			if (tr->cur_image)
+				bpf_tramp_image_put(tr->cur_image);
+			tr->cur_image = im;
+		}
+	}
+out:
+	kvfree(orig_flags);
+	kvfree(ims);
+	kvfree(pokes);
+	return err;
+}
+
+/*
+ * All tr->mutex are of one lock class, take them under trampoline_multi_mutex
+ * so lockdep does not count them one by one. @trs must not have duplicates.
+ */
+static void bpf_trampoline_multi_lock(struct bpf_trampoline **trs, u32 cnt)
+{
+	u32 i;
+
+	mutex_lock(&trampoline_multi_mutex);
+	for (i = 0; i < cnt; i++)
+		mutex_lock_nest_lock(&trs[i]->mutex, &trampoline_multi_mutex);
+}
+
+static void bpf_trampoline_multi_unlock(struct bpf_trampoline **trs, u32 cnt)
+{
+	u32 i;
+
+	for (i = cnt; i > 0; i--)
+		mutex_unlock(&trs[i - 1]->mutex);
+	mutex_unlock(&trampoline_multi_mutex);
+}
+
+/**
+ * bpf_trampoline_multi_link_prog() - attach one prog to many trampolines
+ * @links: one bpf_tramp_link per trampoline, all for the same prog
+ * @trs: distinct trampolines, set up with bpf_trampoline_get()
+ * @cnt: number of entries in @links and @trs
+ *
+ * All of @trs are updated together, so that their call sites are patched in
+ * one batch. Either all of @links get attached or none.
+ */
+int bpf_trampoline_multi_link_prog(struct bpf_tramp_link *links,
+				   struct bpf_trampoline **trs, u32 cnt)
+{
+	enum bpf_tramp_prog_type kind;
+	struct bpf_trampoline *tr;
+	u32 i, linked;
+	int err = 0;
+
+	kind = bpf_attach_type_to_tramp(links[0].link.prog);
+	if (kind == BPF_TRAMP_REPLACE)
+		return -EINVAL;
+
+	bpf_trampoline_multi_lock(trs, cnt);
+	for (linked = 0; linked < cnt; linked++) {
+		tr = trs[linked];
+		if (tr->extension_prog) {
+			err = -EBUSY;
+			break;
+		}
+		err = bpf_trampoline_add_link(&links[linked], tr, kind,
+					      bpf_trampoline_nr_progs(tr));
+		if (err)
+			break;
+	}
+
+	if (!err)
+		err = bpf_trampoline_multi_update(trs, cnt);
+	if (err) {
+		for (i = 0; i < linked; i++) {
+			hlist_del_init(&links[i].tramp_hlist);
+			trs[i]->progs_cnt[kind]--;
+		}
+		if (linked == cnt)
+			WARN_ON_ONCE(bpf_trampoline_multi_update(trs, cnt));
+	}
+	bpf_trampoline_multi_unlock(trs, cnt);
+	return err;
+}
+
+/* Undo bpf_trampoline_multi_link_prog(), should never fail. */
+void bpf_trampoline_multi_unlink_prog(struct bpf_tramp_link *links,
+				      struct bpf_trampoline **trs, u32 cnt)
+{
+	enum bpf_tramp_prog_type kind;
+	u32 i;
+
+	kind = bpf_attach_type_to_tramp(links[0].link.prog);
+
+	bpf_trampoline_multi_lock(trs, cnt);
+	for (i = 0; i < cnt; i++) {
+		hlist_del_init(&links[i].tramp_hlist);
+		trs[i]->progs_cnt[kind]--;
+	}
+	WARN_ON_ONCE(bpf_trampoline_multi_update(trs, cnt));
+	bpf_trampoline_multi_unlock(trs, cnt);
+}
+
 #if defined(CONFIG_CGROUP_BPF) && defined(CONFIG_BPF_LSM)
 static void bpf_shim_tramp_link_release(struct bpf_link *link)
 {
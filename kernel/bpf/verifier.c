@@ -17,6 +17,7 @@
 #include <linux/vmalloc.h>
 #include <linux/stringify.h>
 #include <linux/bsearch.h>
+#include <linux/jhash.h>
 #include <linux/sort.h>
 #include <linux/perf_event.h>
 #include <linux/ctype.h>
@@ -17903,6 +17904,26 @@ static bool iter_active_depths_differ(struct bpf_verifier_state *old, struct bpf
 	return false;
 }
 
+/* Digest of the parts of a state that states_equal() requires to be the
+ * same in both states, to skip checkpoints that cannot match before
+ * comparing their registers and stack.
+ */
+static u32 state_signature(const struct bpf_verifier_state *st)
+{
+	u32 sig;
+	int i;
+
+	sig = jhash_3words(st->curframe, st->active_preempt_lock,
+			   st->active_rcu_lock | st->in_sleepable << 1 |
+			   !!st->active_lock.id << 2, 0);
+	sig = jhash_2words(lower_32_bits((unsigned long)st->active_lock.ptr),
+			   upper_32_bits((unsigned long)st->active_lock.ptr), sig);
+	for (i = 0; i <= st->curframe; i++)
+		sig = jhash_2words(st->frame[i]->callsite,
+				   st->frame[i]->acquired_refs, sig);
+	return sig;
+}
+
 static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 {
 	struct bpf_verifier_state_list *new_sl;
@@ -17910,6 +17931,7 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	struct bpf_verifier_state *cur = env->cur_state, *new, *loop_entry;
 	int i, j, n, err, states_cnt = 0;
 	bool force_new_state, add_new_state, force_exact;
+	u32 sig = state_signature(cur);
 
 	force_new_state = env->test_state_freq || is_force_checkpoint(env, insn_idx) ||
 			  /* Avoid accumulating infinitely long jmp history */
@@ -18061,6 +18083,9 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 				add_new_state = false;
 			goto miss;
 		}
+		/* states_equal() would fail, count it as a miss all the same */
+		if (sl->sig != sig)
+			goto miss;
 		/* If sl->state is a part of a loop and this loop's entry is a part of
 		 * current verification path then states have to be compared exactly.
 		 * 'force_exact' is needed to catch the following case:
@@ -18212,6 +18237,7 @@ static int is_state_visited(struct bpf_verifier_env *env, int insn_idx)
 	cur->first_insn_idx = insn_idx;
 	cur->dfs_depth = new->dfs_depth + 1;
 	clear_jmp_history(cur);
+	new_sl->sig = sig;
 	new_sl->next = *explored_state(env, insn_idx);
 	*explored_state(env, insn_idx) = new_sl;
 	/* connect new state to parentage chain. Current frame needs all
@@ -18360,7 +18386,13 @@ static int do_check(struct bpf_verifier_env *env)
 		state->last_insn_idx = env->prev_insn_idx;
 
 		if (is_prune_point(env, env->insn_idx)) {
+			u64 prune_start = 0;
+
+			if (env->log.level & BPF_LOG_STATS)
+				prune_start = ktime_get_ns();
 			err = is_state_visited(env, env->insn_idx);
+			if (prune_start)
+				env->prune_time += ktime_get_ns() - prune_start;
 			if (err < 0)
 				return err;
 			if (err == 1) {
@@ -21754,6 +21786,11 @@ static void print_verification_stats(struct bpf_verifier_env *env)
 	if (env->log.level & BPF_LOG_STATS) {
 		verbose(env, "verification time %lld usec\n",
 			div_u64(env->verification_time, 1000));
+		verbose(env, "phase time usec: prep %lld check %lld (pruning %lld) fixup %lld\n",
+			div_u64(env->prep_time, 1000),
+			div_u64(env->check_time, 1000),
+			div_u64(env->prune_time, 1000),
+			div_u64(env->fixup_time, 1000));
 		verbose(env, "stack depth ");
 		for (i = 0; i < env->subprog_cnt; i++) {
 			u32 depth = env->subprog_info[i].stack_depth;
@@ -22221,6 +22258,12 @@ BTF_ID(func, __rcu_read_unlock)
 #endif
 BTF_SET_END(btf_id_deny)
 
+/* Refused to tracing progs on top of bpf_check_attach_target() */
+bool bpf_tracing_btf_id_denied(u32 btf_id)
+{
+	return btf_id_set_contains(&btf_id_deny, btf_id);
+}
+
 static bool can_be_sleepable(struct bpf_prog *prog)
 {
 	if (prog->type == BPF_PROG_TYPE_TRACING) {
@@ -22307,7 +22350,7 @@ static int check_attach_btf_id(struct bpf_verifier_env *env)
 		if (ret < 0)
 			return ret;
 	} else if (prog->type == BPF_PROG_TYPE_TRACING &&
-		   btf_id_set_contains(&btf_id_deny, btf_id)) {
+		   bpf_tracing_btf_id_denied(btf_id)) {
 		return -EINVAL;
 	}
 
@@ -22336,7 +22379,7 @@ struct btf *bpf_get_btf_vmlinux(void)
 
 int bpf_check(struct bpf_prog **prog, union bpf_attr *attr, bpfptr_t uattr, __u32 uattr_size)
 {
-	u64 start_time = ktime_get_ns();
+	u64 start_time = ktime_get_ns(), check_start = 0, fixup_start = 0;
 	struct bpf_verifier_env *env;
 	int i, len, ret = -EINVAL, err;
 	u32 log_true_size;
@@ -22452,6 +22495,7 @@ int bpf_check(struct bpf_prog **prog, union bpf_attr *attr, bpfptr_t uattr, __u3
 	if (ret < 0)
 		goto skip_full_check;
 
+	check_start = ktime_get_ns();
 	ret = do_check_main(env);
 	ret = ret ?: do_check_subprogs(env);
 
@@ -22460,6 +22504,13 @@ int bpf_check(struct bpf_prog **prog, union bpf_attr *attr, bpfptr_t uattr, __u3
 
 skip_full_check:
 	kvfree(env->explored_states);
+	fixup_start = ktime_get_ns();
+	if (check_start) {
+		env->prep_time = check_start - start_time;
+		env->check_time = fixup_start - check_start;
+	} else {
+		env->prep_time = fixup_start - start_time;
+	}
 
 	/* might decrease stack depth, keep it before passes that
 	 * allocate additional slots.
@@ -22506,6 +22557,7 @@ int bpf_check(struct bpf_prog **prog, union bpf_attr *attr, bpfptr_t uattr, __u3
 		ret = fixup_call_args(env);
 
 	env->verification_time = ktime_get_ns() - start_time;
+	env->fixup_time = start_time + env->verification_time - fixup_start;
 	print_verification_stats(env);
 	env->prog->aux->verified_insns = env->insn_processed;
 
@@ -268,6 +268,7 @@ static inline int is_spread_slab(const struct cpuset *cs)
 		if (is_cpuset_online(((des_cs) = css_cs((pos_css)))))
 
 void rebuild_sched_domains_locked(void);
+void cpuset_flush_sd_rebuild(void);
 void cpuset_callback_lock_irq(void);
 void cpuset_callback_unlock_irq(void);
 void cpuset_update_tasks_cpumask(struct cpuset *cs, struct cpumask *new_cpus);
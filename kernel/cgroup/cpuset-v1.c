@@ -155,7 +155,7 @@ static int update_relax_domain_level(struct cpuset *cs, s64 val)
 		cs->relax_domain_level = val;
 		if (!cpumask_empty(cs->cpus_allowed) &&
 		    is_sched_load_balance(cs))
-			rebuild_sched_domains_locked();
+			cpuset_force_rebuild();
 	}
 
 	return 0;
@@ -181,6 +181,7 @@ static int cpuset_write_s64(struct cgroup_subsys_state *css, struct cftype *cft,
 		retval = -EINVAL;
 		break;
 	}
+	cpuset_flush_sd_rebuild();
 out_unlock:
 	cpuset_unlock();
 	cpus_read_unlock();
@@ -448,6 +449,7 @@ static int cpuset_write_u64(struct cgroup_subsys_state *css, struct cftype *cft,
 		retval = -EINVAL;
 		break;
 	}
+	cpuset_flush_sd_rebuild();
 out_unlock:
 	cpuset_unlock();
 	cpus_read_unlock();
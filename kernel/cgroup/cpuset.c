@@ -85,8 +85,11 @@ static struct list_head remote_children;
 
 /*
  * A flag to force sched domain rebuild at the end of an operation while
- * inhibiting it in the intermediate stages when set. Currently it is only
- * set in hotplug code.
+ * inhibiting it in the intermediate stages when set. The steps of an
+ * update set it with cpuset_force_rebuild() and the operation rebuilds
+ * the sched domains once before releasing cpuset_mutex, see
+ * cpuset_flush_sd_rebuild(). Hotplug does the same from
+ * cpuset_handle_hotplug().
  */
 static bool force_sd_rebuild;
 
@@ -1052,6 +1055,24 @@ static void rebuild_sched_domains_cpuslocked(void)
 	mutex_unlock(&cpuset_mutex);
 }
 
+/*
+ * Rebuild the sched domains if any step of the operation which is about to
+ * release cpuset_mutex asked for it.  A cpumask or partition change can
+ * update many cpusets, and each of the updates would otherwise regenerate
+ * the domains of the whole hierarchy.
+ *
+ * Call with cpuset_mutex held.  Takes cpus_read_lock().
+ */
+void cpuset_flush_sd_rebuild(void)
+{
+	lockdep_assert_held(&cpuset_mutex);
+
+	if (force_sd_rebuild) {
+		force_sd_rebuild = false;
+		rebuild_sched_domains_locked();
+	}
+}
+
 void rebuild_sched_domains(void)
 {
 	cpus_read_lock();
@@ -1145,8 +1166,8 @@ static int update_partition_exclusive(struct cpuset *cs, int new_prs)
 /*
  * Update partition load balance flag and/or rebuild sched domain
  *
- * Changing load balance flag will automatically call
- * rebuild_sched_domains_locked().
+ * Changing load balance flag will automatically request a sched domain
+ * rebuild with cpuset_force_rebuild().
  * This function is for cgroup v2 only.
  */
 static void update_partition_sd_lb(struct cpuset *cs, int old_prs)
@@ -1172,8 +1193,8 @@ static void update_partition_sd_lb(struct cpuset *cs, int old_prs)
 			clear_bit(CS_SCHED_LOAD_BALANCE, &cs->flags);
 	}
 
-	if (rebuild_domains && !force_sd_rebuild)
-		rebuild_sched_domains_locked();
+	if (rebuild_domains)
+		cpuset_force_rebuild();
 }
 
 /*
@@ -1520,8 +1541,8 @@ static void remote_partition_check(struct cpuset *cs, struct cpumask *newmask,
 			remote_partition_disable(child, tmp);
 			disable_cnt++;
 		}
-	if (disable_cnt && !force_sd_rebuild)
-		rebuild_sched_domains_locked();
+	if (disable_cnt)
+		cpuset_force_rebuild();
 }
 
 /*
@@ -2120,9 +2141,8 @@ static void update_cpumasks_hier(struct cpuset *cs, struct tmpmasks *tmp,
 	}
 	rcu_read_unlock();
 
-	if (need_rebuild_sched_domains && !(flags & HIER_NO_SD_REBUILD) &&
-	    !force_sd_rebuild)
-		rebuild_sched_domains_locked();
+	if (need_rebuild_sched_domains && !(flags & HIER_NO_SD_REBUILD))
+		cpuset_force_rebuild();
 }
 
 /**
@@ -2745,9 +2765,8 @@ int cpuset_update_flag(cpuset_flagbits_t bit, struct cpuset *cs,
 	cs->flags = trialcs->flags;
 	spin_unlock_irq(&callback_lock);
 
-	if (!cpumask_empty(trialcs->cpus_allowed) && balance_flag_changed &&
-	    !force_sd_rebuild)
-		rebuild_sched_domains_locked();
+	if (!cpumask_empty(trialcs->cpus_allowed) && balance_flag_changed)
+		cpuset_force_rebuild();
 
 	if (spread_flag_changed)
 		cpuset1_update_tasks_flags(cs);
@@ -3137,6 +3156,7 @@ ssize_t cpuset_write_resmask(struct kernfs_open_file *of,
 	}
 
 	free_cpuset(trialcs);
+	cpuset_flush_sd_rebuild();
 out_unlock:
 	mutex_unlock(&cpuset_mutex);
 	cpus_read_unlock();
@@ -3249,6 +3269,7 @@ static ssize_t sched_partition_write(struct kernfs_open_file *of, char *buf,
 		goto out_unlock;
 
 	retval = update_prstate(cs, val);
+	cpuset_flush_sd_rebuild();
 out_unlock:
 	mutex_unlock(&cpuset_mutex);
 	cpus_read_unlock();
@@ -3446,7 +3467,7 @@ static int cpuset_css_online(struct cgroup_subsys_state *css)
 /*
  * If the cpuset being removed has its flag 'sched_load_balance'
  * enabled, then simulate turning sched_load_balance off, which
- * will call rebuild_sched_domains_locked(). That is not needed
+ * will rebuild the sched domains. That is not needed
  * in the default hierarchy where only changes in partition
  * will cause repartitioning.
  *
@@ -3468,6 +3489,7 @@ static void cpuset_css_offline(struct cgroup_subsys_state *css)
 	    is_sched_load_balance(cs))
 		cpuset_update_flag(CS_SCHED_LOAD_BALANCE, cs, 0);
 
+	cpuset_flush_sd_rebuild();
 	cpuset_dec();
 	clear_bit(CS_ONLINE, &cs->flags);
 
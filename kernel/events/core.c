@@ -55,6 +55,7 @@
 #include <linux/pgtable.h>
 #include <linux/buildid.h>
 #include <linux/task_work.h>
+#include <linux/siphash.h>
 
 #include "internal.h"
 
@@ -6751,6 +6752,9 @@ static int perf_mmap(struct file *file, struct vm_area_struct *vma)
 	if (vma->vm_flags & VM_WRITE)
 		flags |= RING_BUFFER_WRITABLE;
 
+	if (event->attr.callchain_dedup)
+		flags |= RING_BUFFER_STACK_IDS;
+
 	if (!rb) {
 		rb = rb_alloc(nr_pages,
 			      event->attr.watermark ? event->attr.wakeup_watermark : 0,
@@ -7468,6 +7472,82 @@ static void perf_output_read(struct perf_output_handle *handle,
 		perf_output_read_one(handle, event, enabled, running);
 }
 
+static siphash_key_t perf_stack_id_key __read_mostly;
+
+/*
+ * With attr::callchain_dedup, a callchain which was already written to the
+ * buffer the sample goes to is replaced by its id, see
+ * PERF_CONTEXT_STACK_ID.  The id is a hash of the callchain, so whichever
+ * record defined it, a reference always means the same callchain.
+ *
+ * The buffer only has a table of ids if it was mmapped by an event with
+ * attr::callchain_dedup, events redirected to it with
+ * PERF_EVENT_IOC_SET_OUTPUT share that table.
+ */
+static void perf_callchain_dedup(struct perf_sample_data *data,
+				 struct perf_event *event)
+{
+	struct perf_callchain_entry *entry = data->callchain;
+	struct perf_buffer *rb;
+	u64 id;
+
+	data->stack_id = 0;
+
+	/* a reference takes 2 entries */
+	if (entry->nr <= 2)
+		return;
+
+	if (event->parent)
+		event = event->parent;
+
+	rb = rcu_dereference(event->rb);
+	if (!rb || !rb->stack_ids)
+		return;
+
+	id = siphash(entry->ip, entry->nr * sizeof(u64), &perf_stack_id_key);
+	data->stack_id = id ?: 1;
+	data->stack_rb = rb;
+	data->stack_id_seen = rb_stack_id_seen(rb, data->stack_id);
+
+	if (data->stack_id_seen)
+		data->dyn_size -= (entry->nr - 2) * sizeof(u64);
+	else
+		data->dyn_size += 2 * sizeof(u64);
+}
+
+static void perf_output_stack_id(struct perf_output_handle *handle,
+				 struct perf_sample_data *data)
+{
+	struct perf_callchain_entry *entry = data->callchain;
+	u64 hdr[3] = { 2, PERF_CONTEXT_STACK_ID, data->stack_id };
+
+	if (data->stack_id_seen) {
+		/*
+		 * PERF_EVENT_IOC_SET_OUTPUT may have switched buffers since
+		 * the sample was sized.  A reference is only valid in a
+		 * buffer which carried the definition, otherwise write the
+		 * id of a lost callchain.
+		 */
+		if (handle->rb != data->stack_rb &&
+		    !(handle->rb->stack_ids &&
+		      rb_stack_id_seen(handle->rb, data->stack_id)))
+			hdr[2] = 0;
+		__output_copy(handle, hdr, sizeof(hdr));
+		return;
+	}
+
+	hdr[0] += entry->nr;
+	__output_copy(handle, hdr, sizeof(hdr));
+	__output_copy(handle, entry->ip, entry->nr * sizeof(u64));
+
+	/*
+	 * Only now that the definition has its place in the buffer may
+	 * later samples refer to it.
+	 */
+	if (handle->rb->stack_ids)
+		rb_stack_id_add(handle->rb, data->stack_id);
+}
+
 void perf_output_sample(struct perf_output_handle *handle,
 			struct perf_event_header *header,
 			struct perf_sample_data *data,
@@ -7510,9 +7590,13 @@ void perf_output_sample(struct perf_output_handle *handle,
 	if (sample_type & PERF_SAMPLE_CALLCHAIN) {
 		int size = 1;
 
-		size += data->callchain->nr;
-		size *= sizeof(u64);
-		__output_copy(handle, data->callchain, size);
+		if (data->stack_id) {
+			perf_output_stack_id(handle, data);
+		} else {
+			size += data->callchain->nr;
+			size *= sizeof(u64);
+			__output_copy(handle, data->callchain, size);
+		}
 	}
 
 	if (sample_type & PERF_SAMPLE_RAW) {
@@ -7846,6 +7930,11 @@ void perf_prepare_sample(struct perf_sample_data *data,
 	if (filtered_sample_type & PERF_SAMPLE_CALLCHAIN)
 		perf_sample_save_callchain(data, event, regs);
 
+	/* the size of a deduplicated callchain is only adjusted once */
+	if ((sample_type & PERF_SAMPLE_CALLCHAIN) &&
+	    event->attr.callchain_dedup && !data->stack_id)
+		perf_callchain_dedup(data, event);
+
 	if (filtered_sample_type & PERF_SAMPLE_RAW) {
 		data->raw = NULL;
 		data->dyn_size += sizeof(u64);
@@ -12141,6 +12230,13 @@ perf_event_alloc(struct perf_event_attr *attr, int cpu,
 		/* Requires a task: avoid signalling random tasks. */
 		return ERR_PTR(-EINVAL);
 	}
+	if (attr->callchain_dedup && cpu == -1) {
+		/*
+		 * The ids of a buffer are only consistent with the order of
+		 * its records when all writers run on the same cpu.
+		 */
+		return ERR_PTR(-EINVAL);
+	}
 
 	node = (cpu >= 0) ? cpu_to_node(cpu) : -1;
 	event = kmem_cache_alloc_node(perf_event_cache, GFP_KERNEL | __GFP_ZERO,
@@ -12474,6 +12570,10 @@ static int perf_copy_attr(struct perf_event_attr __user *uattr,
 	if (attr->sigtrap && !attr->remove_on_exec)
 		return -EINVAL;
 
+	if (attr->callchain_dedup &&
+	    !(attr->sample_type & PERF_SAMPLE_CALLCHAIN))
+		return -EINVAL;
+
 out:
 	return ret;
 
@@ -14098,6 +14198,8 @@ void __init perf_event_init(void)
 
 	perf_event_cache = KMEM_CACHE(perf_event, SLAB_PANIC);
 
+	get_random_bytes(&perf_stack_id_key, sizeof(perf_stack_id_key));
+
 	/*
 	 * Build time assertion that we keep the data_head at the intended
 	 * location.  IOW, validation we got the __reserved[] size right.
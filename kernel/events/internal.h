@@ -9,6 +9,10 @@
 /* Buffer handling */
 
 #define RING_BUFFER_WRITABLE		0x01
+#define RING_BUFFER_STACK_IDS		0x02
+
+/* Size of the table of callchain ids written to a buffer, power of 2 */
+#define PERF_STACK_IDS			512
 
 struct perf_buffer {
 	refcount_t			refcount;
@@ -55,6 +59,9 @@ struct perf_buffer {
 	void				**aux_pages;
 	void				*aux_priv;
 
+	/* callchain ids written to this buffer, see perf_callchain_dedup() */
+	u64				*stack_ids;
+
 	struct perf_event_mmap_page	*user_page;
 	void				*data_pages[];
 };
@@ -91,6 +98,16 @@ static inline bool rb_has_aux(struct perf_buffer *rb)
 	return !!rb->aux_nr_pages;
 }
 
+static inline bool rb_stack_id_seen(struct perf_buffer *rb, u64 id)
+{
+	return READ_ONCE(rb->stack_ids[id & (PERF_STACK_IDS - 1)]) == id;
+}
+
+static inline void rb_stack_id_add(struct perf_buffer *rb, u64 id)
+{
+	WRITE_ONCE(rb->stack_ids[id & (PERF_STACK_IDS - 1)], id);
+}
+
 void perf_event_aux_event(struct perf_event *event, unsigned long head,
 			  unsigned long size, u64 flags);
 
@@ -310,6 +310,20 @@ void perf_output_end(struct perf_output_handle *handle)
 	rcu_read_unlock();
 }
 
+/*
+ * Overwritable buffers lose old records, which may define the callchain ids
+ * that newer records refer to, so they don't get a table.
+ */
+static int rb_alloc_stack_ids(struct perf_buffer *rb, int node, int flags)
+{
+	if (!(flags & RING_BUFFER_STACK_IDS) || !(flags & RING_BUFFER_WRITABLE))
+		return 0;
+
+	rb->stack_ids = kcalloc_node(PERF_STACK_IDS, sizeof(u64), GFP_KERNEL,
+				     node);
+	return rb->stack_ids ? 0 : -ENOMEM;
+}
+
 static void
 ring_buffer_init(struct perf_buffer *rb, long watermark, int flags)
 {
@@ -840,6 +854,9 @@ struct perf_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	if (!rb)
 		goto fail;
 
+	if (rb_alloc_stack_ids(rb, node, flags))
+		goto fail_user_page;
+
 	rb->user_page = perf_mmap_alloc_page(cpu);
 	if (!rb->user_page)
 		goto fail_user_page;
@@ -863,6 +880,7 @@ struct perf_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	perf_mmap_free_page(rb->user_page);
 
 fail_user_page:
+	kfree(rb->stack_ids);
 	kfree(rb);
 
 fail:
@@ -876,6 +894,7 @@ void rb_free(struct perf_buffer *rb)
 	perf_mmap_free_page(rb->user_page);
 	for (i = 0; i < rb->nr_pages; i++)
 		perf_mmap_free_page(rb->data_pages[i]);
+	kfree(rb->stack_ids);
 	kfree(rb);
 }
 
@@ -912,6 +931,7 @@ static void rb_free_work(struct work_struct *work)
 		perf_mmap_unmark_page(base + (i * PAGE_SIZE));
 
 	vfree(base);
+	kfree(rb->stack_ids);
 	kfree(rb);
 }
 
@@ -937,6 +957,9 @@ struct perf_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 
 	INIT_WORK(&rb->work, rb_free_work);
 
+	if (rb_alloc_stack_ids(rb, node, flags))
+		goto fail_all_buf;
+
 	all_buf = vmalloc_user((nr_pages + 1) * PAGE_SIZE);
 	if (!all_buf)
 		goto fail_all_buf;
@@ -953,6 +976,7 @@ struct perf_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	return rb;
 
 fail_all_buf:
+	kfree(rb->stack_ids);
 	kfree(rb);
 
 fail:
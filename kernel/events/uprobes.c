@@ -26,6 +26,7 @@
 #include <linux/task_work.h>
 #include <linux/shmem_fs.h>
 #include <linux/khugepaged.h>
+#include <linux/hash.h>
 
 #include <linux/uprobes.h>
 
@@ -112,6 +113,30 @@ struct xol_area {
 	unsigned long 			vaddr;		/* Page(s) of instruction slots */
 };
 
+/*
+ * Per-mm cache of bp_vaddr -> uprobe lookups, filled on breakpoint hits.
+ *
+ * An entry is only used while the vma at bp_vaddr still maps the same
+ * inode and offset, and as long as uprobes_tree hasn't changed since the
+ * entry was filled.  The uprobe can't be freed before a change of the
+ * tree, so the entry is as good as a find_uprobe_rcu() call.
+ */
+#define UPROBE_CACHE_SIZE		64
+
+struct uprobe_cache_entry {
+	unsigned long			vaddr;
+	struct inode			*inode;
+	loff_t				offset;
+	struct uprobe			*uprobe;
+	unsigned int			tree_seq;
+};
+
+struct uprobe_cache {
+	spinlock_t			lock;		/* serialize updates */
+	seqcount_spinlock_t		seq;
+	struct uprobe_cache_entry	entries[UPROBE_CACHE_SIZE];
+};
+
 static void uprobe_warn(struct task_struct *t, const char *msg)
 {
 	pr_warn("uprobe: %s:%d failed to %s\n", current->comm, current->pid, msg);
@@ -1599,6 +1624,8 @@ void uprobe_clear_state(struct mm_struct *mm)
 	delayed_uprobe_remove(NULL, mm);
 	mutex_unlock(&delayed_uprobe_lock);
 
+	kfree(mm->uprobes_state.cache);
+
 	if (!area)
 		return;
 
@@ -2095,6 +2122,116 @@ static int is_trap_at_addr(struct mm_struct *mm, unsigned long vaddr)
 	return is_trap_insn(&opcode);
 }
 
+static struct uprobe_cache_entry *
+uprobe_cache_entry(struct uprobe_cache *cache, unsigned long vaddr)
+{
+	return &cache->entries[hash_long(vaddr, ilog2(UPROBE_CACHE_SIZE))];
+}
+
+static struct uprobe *uprobe_cache_lookup(struct mm_struct *mm,
+					  unsigned long vaddr,
+					  struct inode *inode, loff_t offset)
+{
+	/* Pairs with cmpxchg_release() in uprobe_cache_add() */
+	struct uprobe_cache *cache = smp_load_acquire(&mm->uprobes_state.cache);
+	struct uprobe_cache_entry *e, entry;
+	unsigned int seq;
+
+	if (!cache)
+		return NULL;
+
+	e = uprobe_cache_entry(cache, vaddr);
+	do {
+		seq = read_seqcount_begin(&cache->seq);
+		entry = *e;
+	} while (read_seqcount_retry(&cache->seq, seq));
+
+	if (entry.vaddr != vaddr || entry.inode != inode ||
+	    entry.offset != offset || !entry.uprobe)
+		return NULL;
+
+	/* read_seqcount_retry() orders the entry before the tree check */
+	if (raw_read_seqcount(&uprobes_seqcount) != entry.tree_seq)
+		return NULL;
+
+	return entry.uprobe;
+}
+
+static void uprobe_cache_add(struct mm_struct *mm, unsigned long vaddr,
+			     struct inode *inode, loff_t offset,
+			     struct uprobe *uprobe, unsigned int tree_seq)
+{
+	struct uprobe_cache *cache = smp_load_acquire(&mm->uprobes_state.cache);
+	struct uprobe_cache_entry *e;
+
+	if (!cache) {
+		struct uprobe_cache *old;
+
+		cache = kzalloc(sizeof(*cache), GFP_NOWAIT | __GFP_NOWARN);
+		if (!cache)
+			return;
+		spin_lock_init(&cache->lock);
+		seqcount_spinlock_init(&cache->seq, &cache->lock);
+
+		old = cmpxchg_release(&mm->uprobes_state.cache, NULL, cache);
+		if (old) {
+			kfree(cache);
+			cache = old;
+		}
+	}
+
+	e = uprobe_cache_entry(cache, vaddr);
+	spin_lock(&cache->lock);
+	write_seqcount_begin(&cache->seq);
+	e->vaddr = vaddr;
+	e->inode = inode;
+	e->offset = offset;
+	e->uprobe = uprobe;
+	e->tree_seq = tree_seq;
+	write_seqcount_end(&cache->seq);
+	spin_unlock(&cache->lock);
+}
+
+/*
+ * Look up the uprobe at @bp_vaddr under the per-vma lock rather than
+ * mmap_lock, and through the per-mm cache when possible.  Returns NULL if
+ * this isn't possible, if there is no uprobe, or if the vma can't be locked,
+ * in which case find_active_uprobe_rcu() takes the slow path.
+ */
+static struct uprobe *find_active_uprobe_speculative(unsigned long bp_vaddr)
+{
+	struct mm_struct *mm = current->mm;
+	struct uprobe *uprobe = NULL;
+	struct vm_area_struct *vma;
+	unsigned int tree_seq;
+	struct inode *inode;
+	loff_t offset;
+
+	vma = lock_vma_under_rcu(mm, bp_vaddr);
+	if (!vma)
+		return NULL;
+
+	if (!valid_vma(vma, false))
+		goto out;
+
+	inode = file_inode(vma->vm_file);
+	offset = vaddr_to_offset(vma, bp_vaddr);
+
+	uprobe = uprobe_cache_lookup(mm, bp_vaddr, inode, offset);
+	if (uprobe)
+		goto out;
+
+	tree_seq = raw_read_seqcount(&uprobes_seqcount);
+	smp_rmb();
+	uprobe = find_uprobe_rcu(inode, offset);
+	/* Only cache the result if the tree is the one it was taken from */
+	if (uprobe && !(tree_seq & 1))
+		uprobe_cache_add(mm, bp_vaddr, inode, offset, uprobe, tree_seq);
+out:
+	vma_end_read(vma);
+	return uprobe;
+}
+
 /* assumes being inside RCU protected region */
 static struct uprobe *find_active_uprobe_rcu(unsigned long bp_vaddr, int *is_swbp)
 {
@@ -2102,6 +2239,10 @@ static struct uprobe *find_active_uprobe_rcu(unsigned long bp_vaddr, int *is_swb
 	struct uprobe *uprobe = NULL;
 	struct vm_area_struct *vma;
 
+	uprobe = find_active_uprobe_speculative(bp_vaddr);
+	if (uprobe)
+		return uprobe;
+
 	mmap_read_lock(mm);
 	vma = vma_lookup(mm, bp_vaddr);
 	if (vma) {
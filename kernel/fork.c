@@ -719,10 +719,11 @@ static __latent_entropy int dup_mmap(struct mm_struct *mm,
 			hugetlb_dup_vma_private(tmp);
 
 		/*
-		 * Link the vma into the MT. After using __mt_dup(), memory
-		 * allocation is not necessary here, so it cannot fail.
+		 * Link the vma into the MT. After using __mt_dup(), the slot
+		 * of mpnt only needs to be pointed at tmp, so nothing is walked
+		 * or allocated and it cannot fail.
 		 */
-		vma_iter_bulk_store(&vmi, tmp);
+		vma_iter_replace(&vmi, tmp);
 
 		mm->map_count++;
 
@@ -926,6 +927,7 @@ void __mmdrop(struct mm_struct *mm)
 	mm_pasid_drop(mm);
 	mm_destroy_cid(mm);
 	percpu_counter_destroy_many(mm->rss_stat, NR_MM_COUNTERS);
+	futex_mm_free(mm);
 
 	free_mm(mm);
 }
@@ -1250,6 +1252,7 @@ static void mm_init_uprobes_state(struct mm_struct *mm)
 {
 #ifdef CONFIG_UPROBES
 	mm->uprobes_state.xol_area = NULL;
+	mm->uprobes_state.cache = NULL;
 #endif
 }
 
@@ -1285,6 +1288,7 @@ static struct mm_struct *mm_init(struct mm_struct *mm, struct task_struct *p,
 #endif
 	mm_init_uprobes_state(mm);
 	hugetlb_count_init(mm);
+	futex_mm_init(mm);
 
 	if (current->mm) {
 		mm->flags = mmf_init_flags(current->mm->flags);
@@ -39,6 +39,7 @@
 #include <linux/memblock.h>
 #include <linux/fault-inject.h>
 #include <linux/slab.h>
+#include <linux/prctl.h>
 
 #include "futex.h"
 #include "../locking/rtmutex_common.h"
@@ -55,6 +56,16 @@ static struct {
 #define futex_queues   (__futex_data.queues)
 #define futex_hashsize (__futex_data.hashsize)
 
+/*
+ * Optional per-process table for private futexes, see futex_hash_prctl().
+ * It is installed once while the process is single threaded and lives as
+ * long as the mm, so lookups need neither a reference nor a lock.
+ */
+struct futex_private_hash {
+	unsigned long			hashmask;
+	struct futex_hash_bucket	queues[];
+};
+
 
 /*
  * Fault injections for futexes.
@@ -107,21 +118,124 @@ late_initcall(fail_futex_debugfs);
 
 #endif /* CONFIG_FAIL_FUTEX */
 
+static struct futex_private_hash *futex_private_hash(union futex_key *key)
+{
+	if (key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))
+		return NULL;
+
+	/* Pairs with the cmpxchg_release() in futex_hash_allocate() */
+	return smp_load_acquire(&key->private.mm->futex_phash);
+}
+
 /**
- * futex_hash - Return the hash bucket in the global hash
+ * futex_hash - Return the hash bucket in the global or private hash
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket in the global hash, or in the private hash of
+ * the process for private futexes if it has one.
  */
 struct futex_hash_bucket *futex_hash(union futex_key *key)
 {
 	u32 hash = jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
 			  key->both.offset);
+	struct futex_private_hash *fph = futex_private_hash(key);
+
+	if (fph)
+		return &fph->queues[hash & fph->hashmask];
 
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+static void futex_hash_bucket_init(struct futex_hash_bucket *hb)
+{
+	atomic_set(&hb->waiters, 0);
+	plist_head_init(&hb->chain);
+	spin_lock_init(&hb->lock);
+}
+
+void futex_mm_init(struct mm_struct *mm)
+{
+	mm->futex_phash = NULL;
+}
+
+void futex_mm_free(struct mm_struct *mm)
+{
+	kvfree(mm->futex_phash);
+}
+
+static int futex_hash_allocate(unsigned long nr_threads)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph;
+	unsigned long slots, i;
+
+	if (!mm)
+		return -EINVAL;
+
+	/*
+	 * Waiters already queued in the global hash would never be found
+	 * again once their wakers switch tables, so only allow this while
+	 * nothing but the caller can use private futexes of the mm.
+	 */
+	if (atomic_read(&mm->mm_users) != 1 || mm->futex_phash)
+		return -EBUSY;
+
+	if (!nr_threads)
+		nr_threads = num_online_cpus();
+	nr_threads = min(nr_threads, futex_hashsize);
+	slots = clamp(roundup_pow_of_two(4 * nr_threads), 16UL, futex_hashsize);
+
+	/* Allocate on the node the process starts out on. */
+	fph = kvzalloc_node(struct_size(fph, queues, slots), GFP_KERNEL_ACCOUNT,
+			    numa_node_id());
+	if (!fph)
+		return -ENOMEM;
+
+	fph->hashmask = slots - 1;
+	for (i = 0; i < slots; i++)
+		futex_hash_bucket_init(&fph->queues[i]);
+
+	if (cmpxchg_release(&mm->futex_phash, NULL, fph)) {
+		kvfree(fph);
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+/**
+ * futex_hash_prctl - PR_FUTEX_HASH handler
+ * @arg2:	PR_FUTEX_HASH_SET_PRIVATE or PR_FUTEX_HASH_GET_SLOTS
+ * @arg3:	Expected number of threads for PR_FUTEX_HASH_SET_PRIVATE,
+ *		0 to size for the number of online CPUs
+ *
+ * PR_FUTEX_HASH_SET_PRIVATE moves the private futexes of the calling
+ * process into a hash of its own, so that they neither collide with the
+ * futexes of other processes nor contend on their hash bucket locks.
+ * The calling process must be single threaded.  Shared futexes keep using
+ * the global hash, and children get the global hash again.
+ *
+ * Return: 0 or the number of private hash slots on success, else a negative
+ * error code.
+ */
+int futex_hash_prctl(unsigned long arg2, unsigned long arg3)
+{
+	struct futex_private_hash *fph;
+
+	switch (arg2) {
+	case PR_FUTEX_HASH_SET_PRIVATE:
+		return futex_hash_allocate(arg3);
+	case PR_FUTEX_HASH_GET_SLOTS:
+		if (arg3 || !current->mm)
+			return -EINVAL;
+		fph = READ_ONCE(current->mm->futex_phash);
+		return fph ? fph->hashmask + 1 : 0;
+	}
+
+	return -EINVAL;
+}
+
 
 /**
  * futex_setup_timer - set up the sleeping hrtimer.
@@ -1163,11 +1277,8 @@ static int __init futex_init(void)
 					       futex_hashsize, futex_hashsize);
 	futex_hashsize = 1UL << futex_shift;
 
-	for (i = 0; i < futex_hashsize; i++) {
-		atomic_set(&futex_queues[i].waiters, 0);
-		plist_head_init(&futex_queues[i].chain);
-		spin_lock_init(&futex_queues[i].lock);
-	}
+	for (i = 0; i < futex_hashsize; i++)
+		futex_hash_bucket_init(&futex_queues[i]);
 
 	return 0;
 }
@@ -354,6 +354,47 @@ SYSCALL_DEFINE4(futex_wake,
 	return futex_wake(uaddr, FLAGS_STRICT | flags, nr, mask);
 }
 
+/*
+ * sys_futex_wakev - Wake a number of waiters on each of a list of futexes
+ * @waiters:	List of futexes to wake, with the bitmask in @val
+ * @nr_futexes:	Length of @waiters
+ * @flags:	unused
+ * @nr_wake:	Number of waiters to wake on each futex
+ *
+ * Equivalent to calling sys_futex_wake() on each futex of the list, but
+ * takes each hash bucket lock once and wakes up all tasks after the last
+ * one is dropped.  Returns the total number of woken waiters.
+ */
+
+SYSCALL_DEFINE4(futex_wakev,
+		struct futex_waitv __user *, waiters,
+		unsigned int, nr_futexes,
+		unsigned int, flags,
+		int, nr_wake)
+{
+	struct futex_vector *futexv;
+	int ret;
+
+	/* This syscall supports no flags for now */
+	if (flags)
+		return -EINVAL;
+
+	if (!nr_futexes || nr_futexes > FUTEX_WAITV_MAX || !waiters)
+		return -EINVAL;
+
+	futexv = kcalloc(nr_futexes, sizeof(*futexv), GFP_KERNEL);
+	if (!futexv)
+		return -ENOMEM;
+
+	ret = futex_parse_waitv(futexv, waiters, nr_futexes, futex_wake_mark,
+				NULL);
+	if (!ret)
+		ret = futex_wake_multiple(futexv, nr_futexes, nr_wake);
+
+	kfree(futexv);
+	return ret;
+}
+
 /*
  * sys_futex_wait - Wait on a futex
  * @uaddr:	Address of the futex to wait on
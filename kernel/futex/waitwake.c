@@ -4,6 +4,7 @@
 #include <linux/sched/task.h>
 #include <linux/sched/signal.h>
 #include <linux/freezer.h>
+#include <linux/sort.h>
 
 #include "futex.h"
 
@@ -200,6 +201,101 @@ int futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 	return ret;
 }
 
+static int futex_vector_cmp(const void *a, const void *b)
+{
+	const struct futex_vector *va = a, *vb = b;
+
+	if (va->q.lock_ptr == vb->q.lock_ptr)
+		return 0;
+	return va->q.lock_ptr < vb->q.lock_ptr ? -1 : 1;
+}
+
+/**
+ * futex_wake_multiple - Wake waiters on a list of futexes
+ * @vs:		A list of futexes to wake, with the bitsets in w.val
+ * @count:	The number of futexes in the list
+ * @nr_wake:	The number of waiters to wake on each futex
+ *
+ * Sort the list by hash bucket, so that every bucket lock is taken once no
+ * matter how many of the futexes hash to it, and issue all wakeups at the
+ * end.  The order of @vs is not preserved.
+ *
+ * Return: the total number of woken waiters, or a negative error code.
+ */
+int futex_wake_multiple(struct futex_vector *vs, unsigned int count,
+			int nr_wake)
+{
+	struct futex_hash_bucket *hb;
+	struct futex_q *this, *next;
+	DEFINE_WAKE_Q(wake_q);
+	unsigned int i, j, k;
+	int ret, woken = 0;
+
+	for (i = 0; i < count; i++) {
+		u32 __user *uaddr = u64_to_user_ptr(vs[i].w.uaddr);
+
+		if (!vs[i].w.val)
+			return -EINVAL;
+
+		ret = get_futex_key(uaddr, vs[i].w.flags, &vs[i].q.key,
+				    FUTEX_READ);
+		if (unlikely(ret != 0))
+			return ret;
+
+		/* Not queued, lock_ptr only records the bucket for sorting */
+		hb = futex_hash(&vs[i].q.key);
+		vs[i].q.lock_ptr = &hb->lock;
+	}
+
+	if (nr_wake <= 0)
+		return 0;
+
+	sort(vs, count, sizeof(*vs), futex_vector_cmp, NULL);
+
+	for (i = 0; i < count; i = j) {
+		hb = container_of(vs[i].q.lock_ptr, struct futex_hash_bucket,
+				  lock);
+		for (j = i + 1; j < count; j++)
+			if (vs[j].q.lock_ptr != vs[i].q.lock_ptr)
+				break;
+
+		/* Make sure we really have tasks to wakeup */
+		if (!futex_hb_waiters_pending(hb))
+			continue;
+
+		spin_lock(&hb->lock);
+
+		for (k = i; k < j; k++) {
+			int nr = 0;
+
+			plist_for_each_entry_safe(this, next, &hb->chain, list) {
+				if (!futex_match(&this->key, &vs[k].q.key))
+					continue;
+
+				if (this->pi_state || this->rt_waiter) {
+					spin_unlock(&hb->lock);
+					woken = -EINVAL;
+					goto out;
+				}
+
+				/* Check if one of the bits is set in both bitsets */
+				if (!(this->bitset & vs[k].w.val))
+					continue;
+
+				this->wake(&wake_q, this);
+				if (++nr >= nr_wake)
+					break;
+			}
+			woken += nr;
+		}
+
+		spin_unlock(&hb->lock);
+	}
+out:
+	wake_up_q(&wake_q);
+	return woken;
+}
+
 static int futex_atomic_op_inuser(unsigned int encoded_op, u32 __user *uaddr)
 {
 	unsigned int op =	  (encoded_op & 0x70000000) >> 28;
@@ -0,0 +1,409 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * In-kernel interrupt load balancing.
+ *
+ * Periodically samples the interrupt rate of each balanceable interrupt
+ * and the hardirq plus softirq time of each CPU, and moves one interrupt
+ * per interval from the busiest CPU to the least loaded CPU of the
+ * affinity mask the interrupt had before the balancer touched it.
+ *
+ * Managed, per CPU and IRQ_NO_BALANCING interrupts are left alone, as is
+ * anything whose affinity has been changed by someone else since it was
+ * last moved: its new affinity becomes the set it is balanced within.
+ */
+
+#define pr_fmt(fmt) "irq_balance: " fmt
+
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "internals.h"
+
+/**
+ * struct irq_balance - Balancer state of one interrupt
+ * @allowed:	CPUs the interrupt may be moved to
+ * @target:	CPU the interrupt was last moved to, or -1
+ * @cpu:	CPU the interrupt was handled on in the last interval, or -1
+ * @count:	desc->tot_count at the last sample
+ * @rate:	Interrupts in the last interval
+ * @moved:	jiffies of the last move
+ */
+struct irq_balance {
+	cpumask_var_t	allowed;
+	int		target;
+	int		cpu;
+	unsigned int	count;
+	unsigned int	rate;
+	unsigned long	moved;
+};
+
+/**
+ * struct irq_balance_decision - A move, for the debugfs log
+ * @time:	jiffies of the move
+ * @irq:	The moved interrupt
+ * @rate:	Its rate in the last interval
+ * @from:	Source CPU
+ * @to:		Target CPU
+ * @from_load:	Interrupt time of @from in the last interval, in ns
+ * @to_load:	Interrupt time of @to in the last interval, in ns
+ */
+struct irq_balance_decision {
+	unsigned long	time;
+	unsigned int	irq;
+	unsigned int	rate;
+	int		from;
+	int		to;
+	u64		from_load;
+	u64		to_load;
+};
+
+#define IRQ_BALANCE_LOG_SIZE	32
+
+static bool irq_balance_enabled;
+static unsigned int irq_balance_interval_ms = 1000;
+/* Minimum load difference, in percent of the interval, to move anything */
+static unsigned int irq_balance_threshold = 10;
+/* Intervals an interrupt stays put after it has been moved */
+static unsigned int irq_balance_cooldown = 10;
+
+/* Serializes the balancer, debugfs and irq_balance_free_desc() */
+static DEFINE_MUTEX(irq_balance_mutex);
+static struct irq_balance_decision irq_balance_log[IRQ_BALANCE_LOG_SIZE];
+static unsigned int irq_balance_log_next;
+
+static DEFINE_PER_CPU(u64, irq_balance_time);
+static DEFINE_PER_CPU(u64, irq_balance_load);
+
+static void irq_balance_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irq_balance_work, irq_balance_workfn);
+
+static unsigned long irq_balance_delay(void)
+{
+	return msecs_to_jiffies(max(READ_ONCE(irq_balance_interval_ms), 10U));
+}
+
+/* Precise with IRQ time accounting, tick sampled if it's disabled at boot */
+static inline u64 irq_balance_cpu_time(int cpu)
+{
+	u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+	return cpustat[CPUTIME_IRQ] + cpustat[CPUTIME_SOFTIRQ];
+}
+
+static void irq_balance_sample_cpus(void)
+{
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		u64 now = irq_balance_cpu_time(cpu);
+
+		per_cpu(irq_balance_load, cpu) = now - per_cpu(irq_balance_time, cpu);
+		per_cpu(irq_balance_time, cpu) = now;
+	}
+}
+
+static bool irq_balance_candidate(struct irq_desc *desc)
+{
+	return desc->action && irq_can_set_affinity_usr(irq_desc_get_irq(desc)) &&
+	       !irq_settings_is_per_cpu(desc) &&
+	       !irq_settings_is_per_cpu_devid(desc) &&
+	       !irq_is_nmi(desc);
+}
+
+/* Update the rate and the CPU of one interrupt, allocating its state */
+static struct irq_balance *irq_balance_sample(struct irq_desc *desc)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+	struct irq_balance *ib = desc->balance;
+	const struct cpumask *aff, *eff;
+	unsigned int count;
+	bool fresh = false;
+
+	if (!ib) {
+		/* Racy, but saves the allocation for most interrupts */
+		if (!irq_balance_candidate(desc))
+			return NULL;
+		ib = kzalloc(sizeof(*ib), GFP_KERNEL);
+		if (!ib)
+			return NULL;
+		if (!zalloc_cpumask_var(&ib->allowed, GFP_KERNEL)) {
+			kfree(ib);
+			return NULL;
+		}
+		ib->target = -1;
+		desc->balance = ib;
+		fresh = true;
+	}
+
+	raw_spin_lock_irq(&desc->lock);
+	if (!irq_balance_candidate(desc)) {
+		raw_spin_unlock_irq(&desc->lock);
+		ib->cpu = -1;
+		ib->rate = 0;
+		return NULL;
+	}
+
+	aff = irq_data_get_affinity_mask(data);
+	eff = irq_data_get_effective_affinity_mask(data);
+
+	/* Someone else changed the affinity, balance within the new one. */
+	if (ib->target < 0 || !cpumask_equal(aff, cpumask_of(ib->target))) {
+		cpumask_copy(ib->allowed, aff);
+		ib->target = -1;
+	}
+	ib->cpu = cpumask_weight(eff) == 1 ? cpumask_first(eff) : -1;
+
+	count = data_race(desc->tot_count);
+	ib->rate = fresh ? 0 : count - ib->count;
+	ib->count = count;
+	raw_spin_unlock_irq(&desc->lock);
+
+	return ib;
+}
+
+/* Least loaded online CPU @ib may move to, other than @from */
+static int irq_balance_target(struct irq_balance *ib, int from)
+{
+	u64 load, best_load = U64_MAX;
+	int cpu, best = -1;
+
+	for_each_cpu_and(cpu, ib->allowed, cpu_online_mask) {
+		if (cpu == from)
+			continue;
+		load = per_cpu(irq_balance_load, cpu);
+		if (load < best_load) {
+			best_load = load;
+			best = cpu;
+		}
+	}
+	return best;
+}
+
+static void irq_balance_log_move(unsigned int irq, struct irq_balance *ib,
+				 int from, int to)
+{
+	struct irq_balance_decision *d;
+
+	d = &irq_balance_log[irq_balance_log_next++ % IRQ_BALANCE_LOG_SIZE];
+	*d = (struct irq_balance_decision) {
+		.time		= jiffies,
+		.irq		= irq,
+		.rate		= ib->rate,
+		.from		= from,
+		.to		= to,
+		.from_load	= per_cpu(irq_balance_load, from),
+		.to_load	= per_cpu(irq_balance_load, to),
+	};
+}
+
+static void irq_balance_run(void)
+{
+	u64 interval_ns = (u64)irq_balance_interval_ms * NSEC_PER_MSEC;
+	u64 max_load = 0, min_load = U64_MAX, best_share = 0;
+	unsigned long cooldown;
+	unsigned int total = 0, irq, best_irq = 0;
+	struct irq_balance *ib, *best = NULL;
+	struct irq_desc *desc;
+	int cpu, busiest = -1, best_to = -1;
+
+	irq_balance_sample_cpus();
+	for_each_online_cpu(cpu) {
+		u64 load = per_cpu(irq_balance_load, cpu);
+
+		if (load > max_load) {
+			max_load = load;
+			busiest = cpu;
+		}
+		min_load = min(min_load, load);
+	}
+
+	/* Sample all interrupts, so that rates are current once needed. */
+	for_each_irq_desc(irq, desc) {
+		ib = irq_balance_sample(desc);
+		if (ib && ib->cpu == busiest)
+			total += ib->rate;
+	}
+
+	if (busiest < 0 || !total ||
+	    max_load - min_load <= div_u64(interval_ns * irq_balance_threshold, 100))
+		return;
+
+	/*
+	 * Pick the interrupt of the busiest CPU with the largest estimated
+	 * share of its load, which can be moved without making its target
+	 * busier than the source would be afterwards.
+	 */
+	cooldown = msecs_to_jiffies(irq_balance_interval_ms * irq_balance_cooldown);
+	for_each_irq_desc(irq, desc) {
+		u64 share, to_load;
+		int to;
+
+		ib = desc->balance;
+		if (!ib || ib->cpu != busiest || !ib->rate)
+			continue;
+		if (ib->moved && time_before(jiffies, ib->moved + cooldown))
+			continue;
+
+		to = irq_balance_target(ib, busiest);
+		if (to < 0)
+			continue;
+
+		share = div_u64(max_load * ib->rate, total);
+		to_load = per_cpu(irq_balance_load, to);
+		if (to_load + 2 * share > max_load || share <= best_share)
+			continue;
+
+		best = ib;
+		best_irq = irq;
+		best_to = to;
+		best_share = share;
+	}
+
+	if (!best || irq_set_affinity(best_irq, cpumask_of(best_to)))
+		return;
+
+	best->target = best_to;
+	best->moved = jiffies;
+	irq_balance_log_move(best_irq, best, busiest, best_to);
+}
+
+static void irq_balance_workfn(struct work_struct *work)
+{
+	irq_lock_sparse();
+	mutex_lock(&irq_balance_mutex);
+	if (irq_balance_enabled) {
+		irq_balance_run();
+		queue_delayed_work(system_unbound_wq, &irq_balance_work,
+				   irq_balance_delay());
+	}
+	mutex_unlock(&irq_balance_mutex);
+	irq_unlock_sparse();
+}
+
+/* Give moved interrupts their original affinity back */
+static void irq_balance_restore(void)
+{
+	struct irq_desc *desc;
+	unsigned int irq;
+
+	for_each_irq_desc(irq, desc) {
+		struct irq_balance *ib = desc->balance;
+
+		if (!ib || ib->target < 0)
+			continue;
+		if (cpumask_equal(irq_data_get_affinity_mask(&desc->irq_data),
+				  cpumask_of(ib->target)))
+			irq_set_affinity(irq, ib->allowed);
+		ib->target = -1;
+	}
+}
+
+static void irq_balance_set_enabled(bool enable)
+{
+	irq_lock_sparse();
+	mutex_lock(&irq_balance_mutex);
+	if (enable && !irq_balance_enabled) {
+		irq_balance_sample_cpus();
+		queue_delayed_work(system_unbound_wq, &irq_balance_work,
+				   irq_balance_delay());
+	} else if (!enable && irq_balance_enabled) {
+		irq_balance_restore();
+	}
+	irq_balance_enabled = enable;
+	mutex_unlock(&irq_balance_mutex);
+	irq_unlock_sparse();
+}
+
+/*
+ * Called with sparse_irq_lock held when @desc is freed, or reset without
+ * CONFIG_SPARSE_IRQ.
+ */
+void irq_balance_free_desc(struct irq_desc *desc)
+{
+	struct irq_balance *ib;
+
+	mutex_lock(&irq_balance_mutex);
+	ib = desc->balance;
+	desc->balance = NULL;
+	mutex_unlock(&irq_balance_mutex);
+
+	if (ib) {
+		free_cpumask_var(ib->allowed);
+		kfree(ib);
+	}
+}
+
+static bool irq_balance_boot __initdata;
+
+static int __init irq_balance_setup(char *str)
+{
+	irq_balance_boot = true;
+	return 1;
+}
+__setup("irq_balance", irq_balance_setup);
+
+#ifdef CONFIG_DEBUG_FS
+static int irq_balance_enable_get(void *data, u64 *val)
+{
+	*val = READ_ONCE(irq_balance_enabled);
+	return 0;
+}
+
+static int irq_balance_enable_set(void *data, u64 val)
+{
+	irq_balance_set_enabled(!!val);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(irq_balance_enable_fops, irq_balance_enable_get,
+			 irq_balance_enable_set, "%llu\n");
+
+static int irq_balance_decisions_show(struct seq_file *m, void *v)
+{
+	unsigned int i, n;
+
+	mutex_lock(&irq_balance_mutex);
+	n = min_t(unsigned int, irq_balance_log_next, IRQ_BALANCE_LOG_SIZE);
+	for (i = irq_balance_log_next - n; i != irq_balance_log_next; i++) {
+		struct irq_balance_decision *d;
+
+		d = &irq_balance_log[i % IRQ_BALANCE_LOG_SIZE];
+		seq_printf(m, "%lu irq %u rate %u cpu %d -> %d load %llu -> %llu\n",
+			   d->time, d->irq, d->rate, d->from, d->to,
+			   d->from_load, d->to_load);
+	}
+	mutex_unlock(&irq_balance_mutex);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(irq_balance_decisions);
+
+static void __init irq_balance_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("irq_balance", NULL);
+
+	debugfs_create_file("enable", 0644, dir, NULL, &irq_balance_enable_fops);
+	debugfs_create_u32("interval_ms", 0644, dir, &irq_balance_interval_ms);
+	debugfs_create_u32("threshold", 0644, dir, &irq_balance_threshold);
+	debugfs_create_u32("cooldown", 0644, dir, &irq_balance_cooldown);
+	debugfs_create_file("decisions", 0444, dir, NULL,
+			    &irq_balance_decisions_fops);
+}
+#else
+static inline void irq_balance_debugfs_init(void) { }
+#endif
+
+static int __init irq_balance_init(void)
+{
+	irq_balance_debugfs_init();
+	if (irq_balance_boot)
+		irq_balance_set_enabled(true);
+	return 0;
+}
+late_initcall(irq_balance_init);
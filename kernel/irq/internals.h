@@ -498,6 +498,12 @@ static inline struct irq_data *irqd_get_parent_data(struct irq_data *irqd)
 #endif
 }
 
+#ifdef CONFIG_IRQ_BALANCE
+void irq_balance_free_desc(struct irq_desc *desc);
+#else
+static inline void irq_balance_free_desc(struct irq_desc *desc) { }
+#endif
+
 #ifdef CONFIG_GENERIC_IRQ_DEBUGFS
 #include <linux/debugfs.h>
 
@@ -483,6 +483,7 @@ static void free_desc(unsigned int irq)
 	struct irq_desc *desc = irq_to_desc(irq);
 
 	irq_remove_debugfs_entry(desc);
+	irq_balance_free_desc(desc);
 	unregister_irq_proc(irq, desc);
 
 	/*
@@ -636,6 +637,7 @@ static void free_desc(unsigned int irq)
 	struct irq_desc *desc = irq_to_desc(irq);
 	unsigned long flags;
 
+	irq_balance_free_desc(desc);
 	raw_spin_lock_irqsave(&desc->lock, flags);
 	desc_set_defaults(irq, desc, irq_desc_get_node(desc), NULL, NULL);
 	raw_spin_unlock_irqrestore(&desc->lock, flags);
@@ -102,6 +102,13 @@ struct find_symbol_arg {
 	enum mod_license license;
 };
 
+/* An exported symbol of a module, hashed by name for find_symbol() */
+struct module_export {
+	struct hlist_node node;
+	const struct kernel_symbol *sym;
+	struct module *owner;
+};
+
 int mod_verify_sig(const void *mod, struct load_info *info);
 int try_to_force_load(struct module *mod, const char *reason);
 bool find_symbol(struct find_symbol_arg *fsa);
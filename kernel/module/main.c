@@ -53,6 +53,8 @@
 #include <linux/jump_label.h>
 #include <linux/pfn.h>
 #include <linux/bsearch.h>
+#include <linux/hashtable.h>
+#include <linux/stringhash.h>
 #include <linux/dynamic_debug.h>
 #include <linux/audit.h>
 #include <linux/cfi.h>
@@ -297,6 +299,92 @@ static bool find_exported_symbol_in_section(const struct symsearch *syms,
 	return true;
 }
 
+/*
+ * Exported symbols of formed modules.  Exports are unique, which
+ * verify_exported_symbols() ensures, so one name lookup replaces a
+ * search of the export tables of every loaded module.  The kernel's own
+ * tables are sorted and are searched directly.
+ */
+#define MODULE_EXPORT_HASH_BITS	12
+static DEFINE_HASHTABLE(module_export_hash, MODULE_EXPORT_HASH_BITS);
+
+static u32 module_export_hashfn(const char *name)
+{
+	return full_name_hash(NULL, name, strlen(name));
+}
+
+static struct module_export *module_exports_alloc(struct module *mod)
+{
+	unsigned int n = mod->num_syms + mod->num_gpl_syms;
+
+	if (!n)
+		return NULL;
+	return kcalloc(n, sizeof(struct module_export), GFP_KERNEL);
+}
+
+/* Publish the exports of @mod, which becomes visible to find_symbol(). */
+static void module_exports_add(struct module *mod, struct module_export *exports)
+{
+	unsigned int i, n = mod->num_syms + mod->num_gpl_syms;
+
+	lockdep_assert_held(&module_mutex);
+
+	for (i = 0; i < n; i++) {
+		struct module_export *e = &exports[i];
+
+		e->sym = i < mod->num_syms ? &mod->syms[i] :
+					     &mod->gpl_syms[i - mod->num_syms];
+		e->owner = mod;
+		hash_add_rcu(module_export_hash, &e->node,
+			     module_export_hashfn(kernel_symbol_name(e->sym)));
+	}
+	mod->exports = exports;
+}
+
+/* Unpublish the exports of @mod, to be freed after an RCU grace period. */
+static void module_exports_remove(struct module *mod)
+{
+	unsigned int i, n = mod->num_syms + mod->num_gpl_syms;
+
+	lockdep_assert_held(&module_mutex);
+
+	if (!mod->exports)
+		return;
+	for (i = 0; i < n; i++)
+		hash_del_rcu(&mod->exports[i].node);
+}
+
+static bool find_module_export(struct find_symbol_arg *fsa)
+{
+	struct module_export *e;
+
+	hash_for_each_possible_rcu(module_export_hash, e, node,
+				   module_export_hashfn(fsa->name),
+				   lockdep_is_held(&module_mutex)) {
+		struct module *mod = e->owner;
+		unsigned int idx;
+
+		if (strcmp(kernel_symbol_name(e->sym), fsa->name))
+			continue;
+
+		if (e->sym >= mod->syms && e->sym < mod->syms + mod->num_syms) {
+			idx = e->sym - mod->syms;
+			fsa->crc = symversion(mod->crcs, idx);
+			fsa->license = NOT_GPL_ONLY;
+		} else {
+			if (!fsa->gplok)
+				return false;
+			idx = e->sym - mod->gpl_syms;
+			fsa->crc = symversion(mod->gpl_crcs, idx);
+			fsa->license = GPL_ONLY;
+		}
+		fsa->owner = mod;
+		fsa->sym = e->sym;
+		return true;
+	}
+	return false;
+}
+
 /*
  * Find an exported symbol and return it, along with, (optional) crc and
  * (optional) module which owns it.  Needs preempt disabled or module_mutex.
@@ -310,7 +398,6 @@ bool find_symbol(struct find_symbol_arg *fsa)
 		  __start___kcrctab_gpl,
 		  GPL_ONLY },
 	};
-	struct module *mod;
 	unsigned int i;
 
 	module_assert_mutex_or_preempt();
@@ -319,23 +406,8 @@ bool find_symbol(struct find_symbol_arg *fsa)
 		if (find_exported_symbol_in_section(&arr[i], NULL, fsa))
 			return true;
 
-	list_for_each_entry_rcu(mod, &modules, list,
-				lockdep_is_held(&module_mutex)) {
-		struct symsearch arr[] = {
-			{ mod->syms, mod->syms + mod->num_syms, mod->crcs,
-			  NOT_GPL_ONLY },
-			{ mod->gpl_syms, mod->gpl_syms + mod->num_gpl_syms,
-			  mod->gpl_crcs,
-			  GPL_ONLY },
-		};
-
-		if (mod->state == MODULE_STATE_UNFORMED)
-			continue;
-
-		for (i = 0; i < ARRAY_SIZE(arr); i++)
-			if (find_exported_symbol_in_section(&arr[i], mod, fsa))
-				return true;
-	}
+	if (find_module_export(fsa))
+		return true;
 
 	pr_debug("Failed to find symbol %s\n", fsa->name);
 	return false;
@@ -1294,6 +1366,7 @@ static void free_module(struct module *mod)
 	/* Unlink carefully: kallsyms could be walking list. */
 	list_del_rcu(&mod->list);
 	mod_tree_remove(mod);
+	module_exports_remove(mod);
 	/* Remove this module from bug list, this uses list_del_rcu */
 	module_bug_cleanup(mod);
 	/* Wait for RCU-sched synchronizing before releasing mod->list and buglist. */
@@ -1302,6 +1375,7 @@ static void free_module(struct module *mod)
 		pr_err("%s: adding tainted module to the unloaded tainted modules list failed.\n",
 		       mod->name);
 	mutex_unlock(&module_mutex);
+	kfree(mod->exports);
 
 	/* This may be empty, but that's OK */
 	module_arch_freeing_init(mod);
@@ -2738,8 +2812,13 @@ static int add_unformed_module(struct module *mod)
 
 static int complete_formation(struct module *mod, struct load_info *info)
 {
+	struct module_export *exports;
 	int err;
 
+	exports = module_exports_alloc(mod);
+	if (!exports && mod->num_syms + mod->num_gpl_syms)
+		return -ENOMEM;
+
 	mutex_lock(&module_mutex);
 
 	/* Find duplicate symbols (must be called under lock). */
@@ -2765,6 +2844,8 @@ static int complete_formation(struct module *mod, struct load_info *info)
 	 * Mark state as coming so strong_try_module_get() ignores us,
 	 * but kallsyms etc. can see us.
 	 */
+	if (exports)
+		module_exports_add(mod, exports);
 	mod->state = MODULE_STATE_COMING;
 	mutex_unlock(&module_mutex);
 
@@ -2774,6 +2855,7 @@ static int complete_formation(struct module *mod, struct load_info *info)
 	module_bug_cleanup(mod);
 out:
 	mutex_unlock(&module_mutex);
+	kfree(exports);
 	return err;
 }
 
@@ -3038,10 +3120,12 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	/* Unlink carefully: kallsyms could be walking list. */
 	list_del_rcu(&mod->list);
 	mod_tree_remove(mod);
+	module_exports_remove(mod);
 	wake_up_all(&module_wq);
 	/* Wait for RCU-sched synchronizing before releasing mod->list. */
 	synchronize_rcu();
 	mutex_unlock(&module_mutex);
+	kfree(mod->exports);
  free_module:
 	mod_stat_bump_invalid(info, flags);
 	/* Free lock-classes; relies on the preceding sync_rcu() */
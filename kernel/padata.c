@@ -21,6 +21,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/sysfs.h>
+#include <linux/topology.h>
 #include <linux/rcupdate.h>
 
 #define	PADATA_WORK_ONSTACK	1	/* Work's memory is on stack */
@@ -45,7 +46,7 @@ struct padata_mt_job_state {
 };
 
 static void padata_free_pd(struct parallel_data *pd);
-static void __init padata_mt_helper(struct work_struct *work);
+static void padata_mt_helper(struct work_struct *work);
 
 static int padata_index_to_cpu(struct parallel_data *pd, int cpu_index)
 {
@@ -83,16 +84,8 @@ static struct padata_work *padata_work_alloc(void)
 	return pw;
 }
 
-/*
- * This function is marked __ref because this function may be optimized in such
- * a way that it directly refers to work_fn's address, which causes modpost to
- * complain when work_fn is marked __init. This scenario was observed with clang
- * LTO, where padata_work_init() was optimized to refer directly to
- * padata_mt_helper() because the calls to padata_work_init() with other work_fn
- * values were eliminated or inlined.
- */
-static void __ref padata_work_init(struct padata_work *pw, work_func_t work_fn,
-				   void *data, int flags)
+static void padata_work_init(struct padata_work *pw, work_func_t work_fn,
+			     void *data, int flags)
 {
 	if (flags & PADATA_WORK_ONSTACK)
 		INIT_WORK_ONSTACK(&pw->pw_work, work_fn);
@@ -101,8 +94,8 @@ static void __ref padata_work_init(struct padata_work *pw, work_func_t work_fn,
 	pw->pw_data = data;
 }
 
-static int __init padata_work_alloc_mt(int nworks, void *data,
-				       struct list_head *head)
+static int padata_work_alloc_mt(int nworks, void *data,
+				struct list_head *head)
 {
 	int i;
 
@@ -127,7 +120,7 @@ static void padata_work_free(struct padata_work *pw)
 	list_add(&pw->pw_list, &padata_free_works);
 }
 
-static void __init padata_works_free(struct list_head *works)
+static void padata_works_free(struct list_head *works)
 {
 	struct padata_work *cur, *next;
 
@@ -224,7 +217,11 @@ int padata_do_parallel(struct padata_shell *ps,
 
 	if (pw) {
 		padata_work_init(pw, padata_parallel_worker, padata, 0);
-		queue_work(pinst->parallel_wq, &pw->pw_work);
+		if (ps->node != NUMA_NO_NODE)
+			queue_work_node(ps->node, pinst->parallel_wq,
+					&pw->pw_work);
+		else
+			queue_work(pinst->parallel_wq, &pw->pw_work);
 	}
 
 	return 0;
@@ -439,7 +436,7 @@ static int padata_setup_cpumasks(struct padata_instance *pinst)
 	return err;
 }
 
-static void __init padata_mt_helper(struct work_struct *w)
+static void padata_mt_helper(struct work_struct *w)
 {
 	struct padata_work *pw = container_of(w, struct padata_work, pw_work);
 	struct padata_mt_job_state *ps = pw->pw_data;
@@ -477,9 +474,11 @@ static void __init padata_mt_helper(struct work_struct *w)
  * padata_do_multithreaded - run a multithreaded job
  * @job: Description of the job.
  *
- * See the definition of struct padata_mt_job for more details.
+ * See the definition of struct padata_mt_job for more details.  Helpers
+ * come from a small pool shared with padata_do_parallel(), so fewer
+ * threads than requested may run the job.  May sleep.
  */
-void __init padata_do_multithreaded(struct padata_mt_job *job)
+void padata_do_multithreaded(struct padata_mt_job *job)
 {
 	/* In case threads finish at different times. */
 	static const unsigned long load_balance_factor = 4;
@@ -487,7 +486,7 @@ void __init padata_do_multithreaded(struct padata_mt_job *job)
 	struct padata_mt_job_state ps;
 	LIST_HEAD(works);
 	int nworks, nid;
-	static atomic_t last_used_nid __initdata;
+	static atomic_t last_used_nid;
 
 	if (job->size == 0)
 		return;
@@ -550,6 +549,7 @@ void __init padata_do_multithreaded(struct padata_mt_job *job)
 	destroy_work_on_stack(&my_work.pw_work);
 	padata_works_free(&works);
 }
+EXPORT_SYMBOL_GPL(padata_do_multithreaded);
 
 static void __padata_list_init(struct padata_list *pd_list)
 {
@@ -611,6 +611,20 @@ static struct parallel_data *padata_alloc_pd(struct padata_shell *ps)
 	cpumask_and(pd->cpumask.pcpu, pinst->cpumask.pcpu, cpu_online_mask);
 	cpumask_and(pd->cpumask.cbcpu, pinst->cpumask.cbcpu, cpu_online_mask);
 
+	/*
+	 * A per-node shell only hashes objects to, and serializes them on,
+	 * CPUs of its node, so its reorder lists and lock stay node local.
+	 * Use the whole instance while the node has no usable CPUs left.
+	 */
+	if (ps->node != NUMA_NO_NODE &&
+	    cpumask_intersects(pd->cpumask.pcpu, cpumask_of_node(ps->node)) &&
+	    cpumask_intersects(pd->cpumask.cbcpu, cpumask_of_node(ps->node))) {
+		cpumask_and(pd->cpumask.pcpu, pd->cpumask.pcpu,
+			    cpumask_of_node(ps->node));
+		cpumask_and(pd->cpumask.cbcpu, pd->cpumask.cbcpu,
+			    cpumask_of_node(ps->node));
+	}
+
 	padata_init_reorder_list(pd);
 	padata_init_squeues(pd);
 	pd->seq_nr = -1;
@@ -1078,13 +1092,20 @@ void padata_free(struct padata_instance *pinst)
 EXPORT_SYMBOL(padata_free);
 
 /**
- * padata_alloc_shell - Allocate and initialize padata shell.
+ * padata_alloc_shell_node - Allocate and initialize a per-node padata shell.
  *
  * @pinst: Parent padata_instance object.
+ * @node: NUMA node to parallelize and serialize on, or NUMA_NO_NODE.
+ *
+ * Objects submitted to a shell are only ordered against other objects of
+ * the same shell, so users that need ordering per flow can pin each flow
+ * to one of a set of per-node shells and keep the reordering of different
+ * nodes apart.
  *
  * Return: new shell on success, NULL on error
  */
-struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
+struct padata_shell *padata_alloc_shell_node(struct padata_instance *pinst,
+					     int node)
 {
 	struct parallel_data *pd;
 	struct padata_shell *ps;
@@ -1094,6 +1115,7 @@ struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
 		goto out;
 
 	ps->pinst = pinst;
+	ps->node = node;
 
 	cpus_read_lock();
 	pd = padata_alloc_pd(ps);
@@ -1114,6 +1136,19 @@ struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
 out:
 	return NULL;
 }
+EXPORT_SYMBOL(padata_alloc_shell_node);
+
+/**
+ * padata_alloc_shell - Allocate and initialize padata shell.
+ *
+ * @pinst: Parent padata_instance object.
+ *
+ * Return: new shell on success, NULL on error
+ */
+struct padata_shell *padata_alloc_shell(struct padata_instance *pinst)
+{
+	return padata_alloc_shell_node(pinst, NUMA_NO_NODE);
+}
 EXPORT_SYMBOL(padata_alloc_shell);
 
 /**
@@ -27,11 +27,16 @@ int devkmsg_sysctl_set_loglvl(const struct ctl_table *table, int write,
  * legacy printer thread. The only exception is on panic, after the
  * nbcon consoles have had their chance to print the panic messages
  * first.
+ *
+ * Without PREEMPT_RT this can be requested with "printk.legacy_kthread"
+ * on the command line, to keep printk() callers from ever flushing
+ * legacy consoles themselves.
  */
 #ifdef CONFIG_PREEMPT_RT
 # define force_legacy_kthread()	(true)
 #else
-# define force_legacy_kthread()	(false)
+extern bool printk_force_legacy_kthread;
+# define force_legacy_kthread()	(printk_force_legacy_kthread)
 #endif
 
 #ifdef CONFIG_PRINTK
@@ -1287,6 +1287,25 @@ module_param(ignore_loglevel, bool, S_IRUGO | S_IWUSR);
 MODULE_PARM_DESC(ignore_loglevel,
 		 "ignore loglevel setting (prints all kernel messages to the console)");
 
+#ifndef CONFIG_PREEMPT_RT
+bool printk_force_legacy_kthread __ro_after_init;
+
+/*
+ * Must be an early_param so that it is set before the first console is
+ * registered: switching while legacy consoles print directly is not safe.
+ */
+static int __init legacy_kthread_setup(char *str)
+{
+	if (!str)
+		printk_force_legacy_kthread = true;
+	else if (kstrtobool(str, &printk_force_legacy_kthread))
+		return -EINVAL;
+
+	return 0;
+}
+early_param("printk.legacy_kthread", legacy_kthread_setup);
+#endif
+
 static bool suppress_message_printing(int level)
 {
 	return (level >= console_loglevel && !ignore_loglevel);
@@ -3067,9 +3086,17 @@ static bool console_emit_next_record(struct console *con, bool *handover, int co
 		 * (either legacy kthread or get_init_console_seq()). There
 		 * is no need for concern about printk reentrance, handovers,
 		 * or lockdep complaints.
+		 *
+		 * Without PREEMPT_RT, legacy drivers may rely on write() being
+		 * called with interrupts disabled, as it is from printk().
 		 */
-
-		con->write(con, outbuf, pmsg.outbuf_len);
+		if (!IS_ENABLED(CONFIG_PREEMPT_RT)) {
+			printk_safe_enter_irqsave(flags);
+			con->write(con, outbuf, pmsg.outbuf_len);
+			printk_safe_exit_irqrestore(flags);
+		} else {
+			con->write(con, outbuf, pmsg.outbuf_len);
+		}
 		con->seq = pmsg.seq + 1;
 	} else {
 		/*
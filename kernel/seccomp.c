@@ -17,6 +17,7 @@
 
 #include <linux/refcount.h>
 #include <linux/audit.h>
+#include <linux/bsearch.h>
 #include <linux/compat.h>
 #include <linux/coredump.h>
 #include <linux/kmemleak.h>
@@ -26,6 +27,7 @@
 #include <linux/sched/task_stack.h>
 #include <linux/seccomp.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/syscalls.h>
 #include <linux/sysctl.h>
 
@@ -156,6 +158,25 @@ struct notification {
 };
 
 #ifdef SECCOMP_ARCH_NATIVE
+/* Maximum number of cached syscall argument values per filter. */
+#define SECCOMP_CACHE_ARG_MAX		64
+/* Set in struct seccomp_arg_allow @key for the compat architecture. */
+#define SECCOMP_CACHE_KEY_COMPAT	BIT(31)
+
+/**
+ * struct seccomp_arg_allow - syscall argument value always allowed
+ *
+ * @key: The syscall number, ORed with SECCOMP_CACHE_KEY_COMPAT for
+ *	 the compat architecture.
+ * @arg: The index of the only argument the filters test for @key.
+ * @val: The value of that argument.
+ */
+struct seccomp_arg_allow {
+	u32 key;
+	u32 arg;
+	u64 val;
+};
+
 /**
  * struct action_cache - per-filter cache of seccomp actions per
  * arch/syscall pair
@@ -166,12 +187,18 @@ struct notification {
  * @allow_compat: A bitmap where each bit represents whether the
  *		  filter will always allow the syscall, for the
  *		  compat architecture.
+ * @nr_arg_allow: Number of valid entries in @arg_allow.
+ * @arg_allow: Syscalls that the filter allows depending on the value
+ *	       of a single argument, with the values known to be
+ *	       allowed, sorted by key and value.
  */
 struct action_cache {
 	DECLARE_BITMAP(allow_native, SECCOMP_ARCH_NATIVE_NR);
 #ifdef SECCOMP_ARCH_COMPAT
 	DECLARE_BITMAP(allow_compat, SECCOMP_ARCH_COMPAT_NR);
 #endif
+	unsigned int nr_arg_allow;
+	struct seccomp_arg_allow arg_allow[SECCOMP_CACHE_ARG_MAX];
 };
 #else
 struct action_cache { };
@@ -359,6 +386,44 @@ static inline bool seccomp_cache_check_allow_bitmap(const void *bitmap,
 	return test_bit(syscall_nr, bitmap);
 }
 
+struct seccomp_arg_lookup {
+	u32 key;
+	const struct seccomp_data *sd;
+};
+
+static int seccomp_cache_arg_cmp(const void *key, const void *elt)
+{
+	const struct seccomp_arg_lookup *lookup = key;
+	const struct seccomp_arg_allow *entry = elt;
+	u64 val;
+
+	if (lookup->key != entry->key)
+		return lookup->key < entry->key ? -1 : 1;
+
+	val = lookup->sd->args[entry->arg];
+	if (val != entry->val)
+		return val < entry->val ? -1 : 1;
+	return 0;
+}
+
+static inline bool seccomp_cache_check_allow_arg(const struct action_cache *cache,
+						 const struct seccomp_data *sd,
+						 size_t bitmap_size, u32 key_flags)
+{
+	struct seccomp_arg_lookup lookup = {
+		.key = (u32)sd->nr | key_flags,
+		.sd = sd,
+	};
+
+	if (!cache->nr_arg_allow)
+		return false;
+	if (unlikely(sd->nr < 0 || sd->nr >= bitmap_size))
+		return false;
+
+	return bsearch(&lookup, cache->arg_allow, cache->nr_arg_allow,
+		       sizeof(cache->arg_allow[0]), seccomp_cache_arg_cmp);
+}
+
 /**
  * seccomp_cache_check_allow - lookup seccomp cache
  * @sfilter: The seccomp filter
@@ -376,16 +441,23 @@ static inline bool seccomp_cache_check_allow(const struct seccomp_filter *sfilte
 	/* A native-only architecture doesn't need to check sd->arch. */
 	return seccomp_cache_check_allow_bitmap(cache->allow_native,
 						SECCOMP_ARCH_NATIVE_NR,
-						syscall_nr);
+						syscall_nr) ||
+	       seccomp_cache_check_allow_arg(cache, sd,
+					     SECCOMP_ARCH_NATIVE_NR, 0);
 #else
 	if (likely(sd->arch == SECCOMP_ARCH_NATIVE))
 		return seccomp_cache_check_allow_bitmap(cache->allow_native,
 							SECCOMP_ARCH_NATIVE_NR,
-							syscall_nr);
+							syscall_nr) ||
+		       seccomp_cache_check_allow_arg(cache, sd,
+						     SECCOMP_ARCH_NATIVE_NR, 0);
 	if (likely(sd->arch == SECCOMP_ARCH_COMPAT))
 		return seccomp_cache_check_allow_bitmap(cache->allow_compat,
 							SECCOMP_ARCH_COMPAT_NR,
-							syscall_nr);
+							syscall_nr) ||
+		       seccomp_cache_check_allow_arg(cache, sd,
+						     SECCOMP_ARCH_COMPAT_NR,
+						     SECCOMP_CACHE_KEY_COMPAT);
 #endif /* SECCOMP_ARCH_COMPAT */
 
 	WARN_ON_ONCE(true);
@@ -738,9 +810,13 @@ seccomp_prepare_user_filter(const char __user *user_filter)
  * @fprog: The BPF programs
  * @sd: The seccomp data to check against, only syscall number and arch
  *      number are considered constant.
+ * @arg: Index of an argument in @sd also considered constant, or -1.
+ * @arg_needed: If not NULL, set to the index of the first other argument
+ *		the filter loads, if any.
  */
 static bool seccomp_is_const_allow(struct sock_fprog_kern *fprog,
-				   struct seccomp_data *sd)
+				   struct seccomp_data *sd, int arg,
+				   int *arg_needed)
 {
 	unsigned int reg_value = 0;
 	unsigned int pc;
@@ -764,6 +840,18 @@ static bool seccomp_is_const_allow(struct sock_fprog_kern *fprog,
 				reg_value = sd->arch;
 				break;
 			default:
+				if (k >= offsetof(struct seccomp_data, args)) {
+					int i = (k - offsetof(struct seccomp_data, args)) /
+						sizeof(sd->args[0]);
+
+					/* Either half, seccomp_check_filter() checked k */
+					if (i == arg) {
+						reg_value = *(u32 *)((void *)sd + k);
+						break;
+					}
+					if (arg_needed)
+						*arg_needed = i;
+				}
 				/* can't optimize (non-constant value load) */
 				return false;
 			}
@@ -837,7 +925,7 @@ static void seccomp_cache_prepare_bitmap(struct seccomp_filter *sfilter,
 		sd.arch = arch;
 
 		/* No bitmap change: continue to always allow. */
-		if (seccomp_is_const_allow(fprog, &sd))
+		if (seccomp_is_const_allow(fprog, &sd, -1, NULL))
 			continue;
 
 		/*
@@ -848,6 +936,165 @@ static void seccomp_cache_prepare_bitmap(struct seccomp_filter *sfilter,
 	}
 }
 
+/* Maximum number of argument values to try per syscall. */
+#define SECCOMP_CACHE_ARG_VALS		32
+
+/*
+ * Collect the constants the filter compares against, which are the
+ * argument values most likely to have their own result.  Arguments are
+ * 64-bit, so also try the sign extension a 32-bit value may have.
+ */
+static unsigned int seccomp_cache_arg_values(struct sock_fprog_kern *fprog,
+					     u64 *vals)
+{
+	unsigned int pc, i, nr_vals = 0;
+
+	for (pc = 0; pc < fprog->len; pc++) {
+		const struct sock_filter *insn = &fprog->filter[pc];
+		u64 cand[2] = { insn->k, (u64)(s64)(s32)insn->k };
+		int j;
+
+		if (insn->code != (BPF_JMP | BPF_JEQ | BPF_K))
+			continue;
+
+		for (j = 0; j < (cand[0] == cand[1] ? 1 : 2); j++) {
+			for (i = 0; i < nr_vals; i++)
+				if (vals[i] == cand[j])
+					break;
+			if (i < nr_vals)
+				continue;
+			if (nr_vals == SECCOMP_CACHE_ARG_VALS)
+				return nr_vals;
+			vals[nr_vals++] = cand[j];
+		}
+	}
+	return nr_vals;
+}
+
+static bool seccomp_cache_add_arg(struct action_cache *cache,
+				  unsigned int first, u32 key, u32 arg, u64 val)
+{
+	unsigned int i;
+
+	for (i = first; i < cache->nr_arg_allow; i++)
+		if (cache->arg_allow[i].val == val)
+			return true;
+	if (cache->nr_arg_allow == SECCOMP_CACHE_ARG_MAX)
+		return false;
+
+	cache->arg_allow[cache->nr_arg_allow++] = (struct seccomp_arg_allow) {
+		.key = key,
+		.arg = arg,
+		.val = val,
+	};
+	return true;
+}
+
+static bool seccomp_cache_prev_allows(const struct seccomp_arg_allow *prev,
+				      unsigned int nr_prev, u64 val)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_prev; i++)
+		if (prev[i].val == val)
+			return true;
+	return false;
+}
+
+/*
+ * For syscalls that are not always allowed, find argument values which
+ * are.  This covers filters that only compare one argument of a syscall
+ * against constants, such as socket() families or ioctl() commands.
+ * The table is built for the whole filter chain: a value is only cached
+ * if the previous filters always allow the syscall or have cached the
+ * same value for the same argument.
+ */
+static void seccomp_cache_prepare_args(struct seccomp_filter *sfilter,
+				       const void *bitmap,
+				       const void *bitmap_prev,
+				       size_t bitmap_size, int arch,
+				       u32 key_flags)
+{
+	struct sock_fprog_kern *fprog = sfilter->prog->orig_prog;
+	struct action_cache *cache = &sfilter->cache;
+	const struct action_cache *cache_prev =
+		sfilter->prev ? &sfilter->prev->cache : NULL;
+	const struct seccomp_arg_allow *prev = NULL;
+	unsigned int nr_vals, nr_prev, p = 0, i;
+	u64 vals[SECCOMP_CACHE_ARG_VALS];
+	struct seccomp_data sd;
+	int nr;
+
+	nr_vals = seccomp_cache_arg_values(fprog, vals);
+
+	for (nr = 0; nr < bitmap_size; nr++) {
+		u32 key = (u32)nr | key_flags;
+		unsigned int first = cache->nr_arg_allow;
+		int arg = -1, prev_arg = -1;
+		bool prev_all, allow;
+
+		/* Already cached, no need to look at arguments. */
+		if (test_bit(nr, bitmap))
+			continue;
+
+		/* The entries of the previous filter for this syscall. */
+		nr_prev = 0;
+		if (cache_prev) {
+			while (p < cache_prev->nr_arg_allow &&
+			       cache_prev->arg_allow[p].key < key)
+				p++;
+			prev = &cache_prev->arg_allow[p];
+			while (p + nr_prev < cache_prev->nr_arg_allow &&
+			       prev[nr_prev].key == key)
+				nr_prev++;
+			if (nr_prev)
+				prev_arg = prev[0].arg;
+		}
+		prev_all = !bitmap_prev || test_bit(nr, bitmap_prev);
+		if (!prev_all && !nr_prev)
+			continue;
+
+		memset(&sd, 0, sizeof(sd));
+		sd.nr = nr;
+		sd.arch = arch;
+
+		allow = seccomp_is_const_allow(fprog, &sd, -1, &arg);
+		if (allow) {
+			/* Only the previous filters look at an argument. */
+			for (i = 0; i < nr_prev; i++)
+				if (!seccomp_cache_add_arg(cache, first, key,
+							   prev_arg, prev[i].val))
+					return;
+			continue;
+		}
+		if (arg < 0 || (!prev_all && arg != prev_arg))
+			continue;
+
+		for (i = 0; i < nr_vals + nr_prev; i++) {
+			u64 val = i < nr_vals ? vals[i] : prev[i - nr_vals].val;
+
+			sd.args[arg] = val;
+			if (!seccomp_is_const_allow(fprog, &sd, arg, NULL))
+				continue;
+			if (!prev_all && !seccomp_cache_prev_allows(prev, nr_prev, val))
+				continue;
+			if (!seccomp_cache_add_arg(cache, first, key, arg, val))
+				return;
+		}
+	}
+}
+
+static int seccomp_cache_arg_sort_cmp(const void *a, const void *b)
+{
+	const struct seccomp_arg_allow *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	if (x->val != y->val)
+		return x->val < y->val ? -1 : 1;
+	return 0;
+}
+
 /**
  * seccomp_cache_prepare - emulate the filter to find cacheable syscalls
  * @sfilter: The seccomp filter
@@ -864,13 +1111,25 @@ static void seccomp_cache_prepare(struct seccomp_filter *sfilter)
 				     cache_prev ? cache_prev->allow_native : NULL,
 				     SECCOMP_ARCH_NATIVE_NR,
 				     SECCOMP_ARCH_NATIVE);
+	seccomp_cache_prepare_args(sfilter, cache->allow_native,
+				   cache_prev ? cache_prev->allow_native : NULL,
+				   SECCOMP_ARCH_NATIVE_NR,
+				   SECCOMP_ARCH_NATIVE, 0);
 
 #ifdef SECCOMP_ARCH_COMPAT
 	seccomp_cache_prepare_bitmap(sfilter, cache->allow_compat,
 				     cache_prev ? cache_prev->allow_compat : NULL,
 				     SECCOMP_ARCH_COMPAT_NR,
 				     SECCOMP_ARCH_COMPAT);
+	seccomp_cache_prepare_args(sfilter, cache->allow_compat,
+				   cache_prev ? cache_prev->allow_compat : NULL,
+				   SECCOMP_ARCH_COMPAT_NR,
+				   SECCOMP_ARCH_COMPAT, SECCOMP_CACHE_KEY_COMPAT);
 #endif /* SECCOMP_ARCH_COMPAT */
+
+	/* Native entries are added first, but values per syscall unsorted. */
+	sort(cache->arg_allow, cache->nr_arg_allow, sizeof(cache->arg_allow[0]),
+	     seccomp_cache_arg_sort_cmp, NULL);
 }
 #endif /* SECCOMP_ARCH_NATIVE */
 
@@ -14,6 +14,7 @@
 #include <linux/prctl.h>
 #include <linux/highuid.h>
 #include <linux/fs.h>
+#include <linux/futex.h>
 #include <linux/kmod.h>
 #include <linux/ksm.h>
 #include <linux/perf_event.h>
@@ -2784,6 +2785,24 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 	case PR_RISCV_SET_ICACHE_FLUSH_CTX:
 		error = RISCV_SET_ICACHE_FLUSH_CTX(arg2, arg3);
 		break;
+	case PR_FUTEX_HASH:
+		if (arg4 || arg5)
+			return -EINVAL;
+		error = futex_hash_prctl(arg2, arg3);
+		break;
+	case PR_GET_PARALLEL_FORK:
+		if (arg2 || arg3 || arg4 || arg5)
+			return -EINVAL;
+		error = !!test_bit(MMF_PARALLEL_FORK, &me->mm->flags);
+		break;
+	case PR_SET_PARALLEL_FORK:
+		if (arg3 || arg4 || arg5)
+			return -EINVAL;
+		if (arg2)
+			set_bit(MMF_PARALLEL_FORK, &me->mm->flags);
+		else
+			clear_bit(MMF_PARALLEL_FORK, &me->mm->flags);
+		break;
 	default:
 		error = -EINVAL;
 		break;
@@ -86,6 +86,7 @@ COND_SYSCALL(futex_waitv);
 COND_SYSCALL(futex_wake);
 COND_SYSCALL(futex_wait);
 COND_SYSCALL(futex_requeue);
+COND_SYSCALL(futex_wakev);
 COND_SYSCALL(kexec_load);
 COND_SYSCALL_COMPAT(kexec_load);
 COND_SYSCALL(init_module);
@@ -55,6 +55,10 @@
 #include <linux/kvm_para.h>
 #include <linux/delay.h>
 #include <linux/irq_work.h>
+#include <linux/debugfs.h>
+#include <linux/jump_label.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_internal.h"
 
@@ -247,6 +251,21 @@ enum pool_workqueue_stats {
 	PWQ_NR_STATS,
 };
 
+/*
+ * Per-pool_workqueue histograms of the queue-to-start latency and execution
+ * time of work items.  Bucket 0 counts durations under 1us and bucket i
+ * those in [2^(i-1), 2^i) us, with the last bucket catching everything
+ * longer.  See CONFIG_WQ_LATENCY_HIST.
+ */
+enum pool_workqueue_hists {
+	PWQ_HIST_LATENCY,	/* queueing to start of execution */
+	PWQ_HIST_EXEC,		/* start to end of execution */
+
+	PWQ_NR_HISTS,
+};
+
+#define PWQ_HIST_BUCKETS	24
+
 /*
  * The per-pool workqueue.  While queued, bits below WORK_PWQ_SHIFT
  * of work_struct->data are used for flags and the remaining high bits
@@ -286,6 +305,9 @@ struct pool_workqueue {
 	struct list_head	mayday_node;	/* MD: node on wq->maydays */
 
 	u64			stats[PWQ_NR_STATS];
+#ifdef CONFIG_WQ_LATENCY_HIST
+	u64			hist[PWQ_NR_HISTS][PWQ_HIST_BUCKETS];
+#endif
 
 	/*
 	 * Release of unbound pwq is punted to a kthread_worker. See put_pwq()
@@ -476,6 +498,14 @@ static bool wq_debug_force_rr_cpu = false;
 #endif
 module_param_named(debug_force_rr_cpu, wq_debug_force_rr_cpu, bool, 0644);
 
+/*
+ * Queue unbound work items to the pod of a sibling CPU on the same node if
+ * the local pod is saturated and the sibling one idle.  See
+ * wq_steal_unbound_pwq().
+ */
+static bool wq_unbound_steal = false;
+module_param_named(unbound_steal, wq_unbound_steal, bool, 0644);
+
 /* to raise softirq for the BH worker pools on other CPUs */
 static DEFINE_PER_CPU_SHARED_ALIGNED(struct irq_work [NR_STD_WORKER_POOLS], bh_pool_irq_works);
 
@@ -1376,6 +1406,59 @@ static void wq_cpu_intensive_report(work_func_t func)
 static void wq_cpu_intensive_report(work_func_t func) {}
 #endif	/* CONFIG_WQ_CPU_INTENSIVE_REPORT */
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+
+static DEFINE_STATIC_KEY_FALSE(wq_hist_enabled);
+
+static void wq_hist_stamp(struct work_struct *work)
+{
+	if (static_branch_unlikely(&wq_hist_enabled))
+		work->queued_at = local_clock();
+	else
+		work->queued_at = 0;
+}
+
+static void wq_hist_add(struct pool_workqueue *pwq, int hist, u64 start,
+			u64 end)
+{
+	u64 us = end > start ? div_u64(end - start, NSEC_PER_USEC) : 0;
+	int bucket = min_t(int, fls64(us), PWQ_HIST_BUCKETS - 1);
+
+	pwq->hist[hist][bucket]++;
+}
+
+/*
+ * Account the queueing latency of @work, which is about to start executing,
+ * and return the start timestamp to pass to wq_hist_end(), or 0 if @work was
+ * queued while collection was off.
+ */
+static u64 wq_hist_start(struct pool_workqueue *pwq, struct work_struct *work)
+{
+	u64 now;
+
+	if (!work->queued_at)
+		return 0;
+
+	now = local_clock();
+	wq_hist_add(pwq, PWQ_HIST_LATENCY, work->queued_at, now);
+	return now;
+}
+
+static void wq_hist_end(struct pool_workqueue *pwq, u64 start)
+{
+	if (start)
+		wq_hist_add(pwq, PWQ_HIST_EXEC, start, local_clock());
+}
+
+#else	/* CONFIG_WQ_LATENCY_HIST */
+static void wq_hist_stamp(struct work_struct *work) {}
+static u64 wq_hist_start(struct pool_workqueue *pwq, struct work_struct *work)
+{
+	return 0;
+}
+static void wq_hist_end(struct pool_workqueue *pwq, u64 start) {}
+#endif	/* CONFIG_WQ_LATENCY_HIST */
+
 /**
  * wq_worker_running - a worker is running again
  * @task: task waking up
@@ -2186,6 +2269,7 @@ static void insert_work(struct pool_workqueue *pwq, struct work_struct *work,
 	set_work_pwq(work, pwq, extra_flags);
 	list_add_tail(&work->entry, head);
 	get_pwq(pwq);
+	wq_hist_stamp(work);
 }
 
 /*
@@ -2232,6 +2316,54 @@ static int wq_select_unbound_cpu(int cpu)
 	return new_cpu;
 }
 
+/*
+ * Racy checks without pool->lock, only used as load balancing hints. A pool
+ * is saturated if all of its workers are busy and work items are waiting,
+ * and idle if it has idle workers and nothing waiting.
+ */
+static bool pool_saturated(struct worker_pool *pool)
+{
+	return !data_race(pool->nr_idle) && !list_empty(&pool->worklist);
+}
+
+static bool pool_idle(struct worker_pool *pool)
+{
+	return data_race(pool->nr_idle) && list_empty(&pool->worklist);
+}
+
+/*
+ * If the pod pwq @pwq selected for @cpu is saturated, look for the pwq of
+ * another pod on the same NUMA node that is idle, starting with the CPUs
+ * following @cpu.  Work items thus stay in the local pod, e.g. the local
+ * LLC with the default affinity scope, as long as it keeps up, and only
+ * spill over to neighbouring pods, never to other nodes.
+ */
+static struct pool_workqueue *wq_steal_unbound_pwq(struct workqueue_struct *wq,
+						   struct pool_workqueue *pwq,
+						   int cpu)
+{
+	struct pool_workqueue *dfl_pwq = rcu_access_pointer(wq->dfl_pwq);
+	struct pool_workqueue *prev = pwq, *sib_pwq;
+	int sib;
+
+	if (pwq == dfl_pwq || !pool_saturated(pwq->pool))
+		return pwq;
+
+	for_each_cpu_wrap(sib, cpumask_of_node(cpu_to_node(cpu)), cpu) {
+		sib_pwq = rcu_dereference(*per_cpu_ptr(wq->cpu_pwq, sib));
+
+		/* CPUs of the same pod are usually adjacent */
+		if (sib_pwq == prev || sib_pwq == pwq || sib_pwq == dfl_pwq)
+			continue;
+		prev = sib_pwq;
+
+		if (pool_idle(sib_pwq->pool))
+			return sib_pwq;
+	}
+
+	return pwq;
+}
+
 static void __queue_work(int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
@@ -2267,6 +2399,9 @@ static void __queue_work(int cpu, struct workqueue_struct *wq,
 	}
 
 	pwq = rcu_dereference(*per_cpu_ptr(wq->cpu_pwq, cpu));
+	if (wq_unbound_steal && req_cpu == WORK_CPU_UNBOUND &&
+	    (wq->flags & WQ_UNBOUND) && !(wq->flags & __WQ_ORDERED))
+		pwq = wq_steal_unbound_pwq(wq, pwq, cpu);
 	pool = pwq->pool;
 
 	/*
@@ -3134,6 +3269,7 @@ __acquires(&pool->lock)
 	unsigned long work_data;
 	int lockdep_start_depth, rcu_start_depth;
 	bool bh_draining = pool->flags & POOL_BH_DRAINING;
+	u64 hist_start;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -3195,6 +3331,7 @@ __acquires(&pool->lock)
 	set_work_pool_and_clear_pending(work, pool->id, pool_offq_flags(pool));
 
 	pwq->stats[PWQ_STAT_STARTED]++;
+	hist_start = wq_hist_start(pwq, work);
 	raw_spin_unlock_irq(&pool->lock);
 
 	rcu_start_depth = rcu_preempt_depth();
@@ -3233,6 +3370,7 @@ __acquires(&pool->lock)
 	 */
 	trace_workqueue_execute_end(work, worker->current_func);
 	pwq->stats[PWQ_STAT_COMPLETED]++;
+	wq_hist_end(pwq, hist_start);
 	lock_map_release(&lockdep_map);
 	if (!bh_draining)
 		lock_map_release(pwq->wq->lockdep_map);
@@ -7427,6 +7565,76 @@ static void workqueue_sysfs_unregister(struct workqueue_struct *wq)
 static void workqueue_sysfs_unregister(struct workqueue_struct *wq)	{ }
 #endif	/* CONFIG_SYSFS */
 
+#ifdef CONFIG_WQ_LATENCY_HIST
+static const char * const wq_hist_names[PWQ_NR_HISTS] = {
+	[PWQ_HIST_LATENCY]	= "latency",
+	[PWQ_HIST_EXEC]		= "exec",
+};
+
+/*
+ * One line per workqueue and histogram which has any samples, with the
+ * workqueue name, the histogram name and PWQ_HIST_BUCKETS counts summed
+ * over all pwqs of the workqueue.
+ */
+static int wq_hist_show(struct seq_file *m, void *v)
+{
+	u64 hist[PWQ_NR_HISTS][PWQ_HIST_BUCKETS];
+	struct workqueue_struct *wq;
+	struct pool_workqueue *pwq;
+	int h, b;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(wq, &workqueues, list) {
+		memset(hist, 0, sizeof(hist));
+		for_each_pwq(pwq, wq)
+			for (h = 0; h < PWQ_NR_HISTS; h++)
+				for (b = 0; b < PWQ_HIST_BUCKETS; b++)
+					hist[h][b] += READ_ONCE(pwq->hist[h][b]);
+
+		for (h = 0; h < PWQ_NR_HISTS; h++) {
+			if (!memchr_inv(hist[h], 0, sizeof(hist[h])))
+				continue;
+			seq_printf(m, "%s %s", wq->name, wq_hist_names[h]);
+			for (b = 0; b < PWQ_HIST_BUCKETS; b++)
+				seq_printf(m, " %llu", hist[h][b]);
+			seq_putc(m, '\n');
+		}
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wq_hist);
+
+static int wq_hist_enable_get(void *data, u64 *val)
+{
+	*val = static_key_enabled(&wq_hist_enabled);
+	return 0;
+}
+
+static int wq_hist_enable_set(void *data, u64 val)
+{
+	if (val)
+		static_branch_enable(&wq_hist_enabled);
+	else
+		static_branch_disable(&wq_hist_enabled);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(wq_hist_enable_fops, wq_hist_enable_get,
+			 wq_hist_enable_set, "%llu\n");
+
+static int __init wq_hist_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("workqueue", NULL);
+
+	debugfs_create_file("hist", 0400, dir, NULL, &wq_hist_fops);
+	debugfs_create_file_unsafe("hist_enable", 0600, dir, NULL,
+				   &wq_hist_enable_fops);
+	return 0;
+}
+late_initcall(wq_hist_init);
+#endif	/* CONFIG_WQ_LATENCY_HIST */
+
 /*
  * Workqueue watchdog.
  *
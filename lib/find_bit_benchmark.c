@@ -14,185 +14,235 @@
  * - randomly filled bitmap with approximately equal number of set and
  *   cleared bits;
  * - sparse bitmap with few set bits at random positions.
+ *
+ * Each function is run as a KUnit benchmark and reported in ns per call.
  */
 
+#include <kunit/benchmark.h>
+#include <kunit/test.h>
+#include <linux/bitmap.h>
 #include <linux/bitops.h>
 #include <linux/kernel.h>
-#include <linux/list.h>
 #include <linux/module.h>
-#include <linux/printk.h>
 #include <linux/random.h>
 
 #define BITMAP_LEN	(4096UL * 8 * 10)
 #define SPARSE		500
 
-static DECLARE_BITMAP(bitmap, BITMAP_LEN) __initdata;
-static DECLARE_BITMAP(bitmap2, BITMAP_LEN) __initdata;
+struct find_bit_ctx {
+	unsigned long *bitmap;
+	unsigned long *bitmap2;
+	unsigned long *cp;
+	/*
+	 * find_first_bit() and find_first_and_bit() are Schlemiel the
+	 * Painter's algorithms, and find_nth_bit() is linear in n.  In the
+	 * random bitmap they only traverse part of it to keep the cost per
+	 * call comparable with the other functions.
+	 */
+	unsigned long first_len;
+	unsigned long first_and_len;
+	unsigned long nth_len;
+};
 
-/*
- * This is Schlemiel the Painter's algorithm. It should be called after
- * all other tests for the same bitmap because it sets all bits of bitmap to 1.
- */
-static int __init test_find_first_bit(void *bitmap, unsigned long len)
+static void bench_find_next_bit(struct kunit *test, struct kunit_bench *bench,
+				void *priv)
 {
-	unsigned long i, cnt;
-	ktime_t time;
-
-	time = ktime_get();
-	for (cnt = i = 0; i < len; cnt++) {
-		i = find_first_bit(bitmap, len);
-		__clear_bit(i, bitmap);
+	struct find_bit_ctx *ctx = priv;
+	unsigned long i = 0;
+	u64 n;
+
+	for (n = 0; n < bench->iters; n++) {
+		i = find_next_bit(ctx->bitmap, BITMAP_LEN, i) + 1;
+		if (i >= BITMAP_LEN)
+			i = 0;
 	}
-	time = ktime_get() - time;
-	pr_err("find_first_bit:     %18llu ns, %6ld iterations\n", time, cnt);
-
-	return 0;
 }
 
-static int __init test_find_first_and_bit(void *bitmap, const void *bitmap2, unsigned long len)
+static void bench_find_next_zero_bit(struct kunit *test,
+				     struct kunit_bench *bench, void *priv)
 {
-	static DECLARE_BITMAP(cp, BITMAP_LEN) __initdata;
-	unsigned long i, cnt;
-	ktime_t time;
-
-	bitmap_copy(cp, bitmap, BITMAP_LEN);
-
-	time = ktime_get();
-	for (cnt = i = 0; i < len; cnt++) {
-		i = find_first_and_bit(cp, bitmap2, len);
-		__clear_bit(i, cp);
+	struct find_bit_ctx *ctx = priv;
+	unsigned long i = 0;
+	u64 n;
+
+	for (n = 0; n < bench->iters; n++) {
+		i = find_next_zero_bit(ctx->bitmap, BITMAP_LEN, i) + 1;
+		if (i >= BITMAP_LEN)
+			i = 0;
 	}
-	time = ktime_get() - time;
-	pr_err("find_first_and_bit: %18llu ns, %6ld iterations\n", time, cnt);
-
-	return 0;
 }
 
-static int __init test_find_next_bit(const void *bitmap, unsigned long len)
+static void bench_find_last_bit(struct kunit *test, struct kunit_bench *bench,
+				void *priv)
 {
-	unsigned long i, cnt;
-	ktime_t time;
+	struct find_bit_ctx *ctx = priv;
+	unsigned long l, len = BITMAP_LEN;
+	u64 n;
 
-	time = ktime_get();
-	for (cnt = i = 0; i < BITMAP_LEN; cnt++)
-		i = find_next_bit(bitmap, BITMAP_LEN, i) + 1;
-	time = ktime_get() - time;
-	pr_err("find_next_bit:      %18llu ns, %6ld iterations\n", time, cnt);
-
-	return 0;
+	for (n = 0; n < bench->iters; n++) {
+		l = find_last_bit(ctx->bitmap, len);
+		len = (l >= len || !l) ? BITMAP_LEN : l;
+	}
 }
 
-static int __init test_find_next_zero_bit(const void *bitmap, unsigned long len)
+static void bench_find_nth_bit(struct kunit *test, struct kunit_bench *bench,
+			       void *priv)
 {
-	unsigned long i, cnt;
-	ktime_t time;
-
-	time = ktime_get();
-	for (cnt = i = 0; i < BITMAP_LEN; cnt++)
-		i = find_next_zero_bit(bitmap, len, i) + 1;
-	time = ktime_get() - time;
-	pr_err("find_next_zero_bit: %18llu ns, %6ld iterations\n", time, cnt);
-
-	return 0;
+	struct find_bit_ctx *ctx = priv;
+	unsigned long w = bitmap_weight(ctx->bitmap, ctx->nth_len);
+	unsigned long i = 0, l;
+	u64 n;
+
+	if (!w)
+		return;
+	for (n = 0; n < bench->iters; n++) {
+		l = find_nth_bit(ctx->bitmap, ctx->nth_len, i);
+		WARN_ON(l >= ctx->nth_len);
+		if (++i >= w)
+			i = 0;
+	}
 }
 
-static int __init test_find_last_bit(const void *bitmap, unsigned long len)
+/* Start over from a fresh copy of the bitmap, outside of the timing. */
+static void find_bit_refill(struct kunit_bench *bench, struct find_bit_ctx *ctx)
 {
-	unsigned long l, cnt = 0;
-	ktime_t time;
-
-	time = ktime_get();
-	do {
-		cnt++;
-		l = find_last_bit(bitmap, len);
-		if (l >= len)
-			break;
-		len = l;
-	} while (len);
-	time = ktime_get() - time;
-	pr_err("find_last_bit:      %18llu ns, %6ld iterations\n", time, cnt);
-
-	return 0;
+	kunit_bench_stop_timer(bench);
+	bitmap_copy(ctx->cp, ctx->bitmap, BITMAP_LEN);
+	kunit_bench_start_timer(bench);
 }
 
-static int __init test_find_nth_bit(const unsigned long *bitmap, unsigned long len)
+static void bench_find_first_bit(struct kunit *test, struct kunit_bench *bench,
+				 void *priv)
 {
-	unsigned long l, n, w = bitmap_weight(bitmap, len);
-	ktime_t time;
-
-	time = ktime_get();
-	for (n = 0; n < w; n++) {
-		l = find_nth_bit(bitmap, len, n);
-		WARN_ON(l >= len);
+	struct find_bit_ctx *ctx = priv;
+	unsigned long i;
+	u64 n;
+
+	find_bit_refill(bench, ctx);
+	for (n = 0; n < bench->iters; n++) {
+		i = find_first_bit(ctx->cp, ctx->first_len);
+		if (i >= ctx->first_len)
+			find_bit_refill(bench, ctx);
+		else
+			__clear_bit(i, ctx->cp);
 	}
-	time = ktime_get() - time;
-	pr_err("find_nth_bit:       %18llu ns, %6ld iterations\n", time, w);
-
-	return 0;
 }
 
-static int __init test_find_next_and_bit(const void *bitmap,
-		const void *bitmap2, unsigned long len)
+static void bench_find_first_and_bit(struct kunit *test,
+				     struct kunit_bench *bench, void *priv)
 {
-	unsigned long i, cnt;
-	ktime_t time;
+	struct find_bit_ctx *ctx = priv;
+	unsigned long i;
+	u64 n;
+
+	find_bit_refill(bench, ctx);
+	for (n = 0; n < bench->iters; n++) {
+		i = find_first_and_bit(ctx->cp, ctx->bitmap2, ctx->first_and_len);
+		if (i >= ctx->first_and_len)
+			find_bit_refill(bench, ctx);
+		else
+			__clear_bit(i, ctx->cp);
+	}
+}
 
-	time = ktime_get();
-	for (cnt = i = 0; i < BITMAP_LEN; cnt++)
-		i = find_next_and_bit(bitmap, bitmap2, BITMAP_LEN, i + 1);
-	time = ktime_get() - time;
-	pr_err("find_next_and_bit:  %18llu ns, %6ld iterations\n", time, cnt);
+static void bench_find_next_and_bit(struct kunit *test,
+				    struct kunit_bench *bench, void *priv)
+{
+	struct find_bit_ctx *ctx = priv;
+	unsigned long i = 0;
+	u64 n;
+
+	for (n = 0; n < bench->iters; n++) {
+		i = find_next_and_bit(ctx->bitmap, ctx->bitmap2, BITMAP_LEN, i + 1);
+		if (i >= BITMAP_LEN)
+			i = 0;
+	}
+}
 
+static const struct {
+	const char *name;
+	kunit_bench_fn_t fn;
+} find_bit_benches[] = {
+	{ "find_next_bit",	bench_find_next_bit },
+	{ "find_next_zero_bit",	bench_find_next_zero_bit },
+	{ "find_last_bit",	bench_find_last_bit },
+	{ "find_nth_bit",	bench_find_nth_bit },
+	{ "find_first_bit",	bench_find_first_bit },
+	{ "find_first_and_bit",	bench_find_first_and_bit },
+	{ "find_next_and_bit",	bench_find_next_and_bit },
+};
+
+static int find_bit_test_init(struct kunit *test)
+{
+	struct find_bit_ctx *ctx;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->bitmap = kunit_kcalloc(test, BITS_TO_LONGS(BITMAP_LEN),
+				    sizeof(long), GFP_KERNEL);
+	ctx->bitmap2 = kunit_kcalloc(test, BITS_TO_LONGS(BITMAP_LEN),
+				     sizeof(long), GFP_KERNEL);
+	ctx->cp = kunit_kcalloc(test, BITS_TO_LONGS(BITMAP_LEN),
+				sizeof(long), GFP_KERNEL);
+	if (!ctx->bitmap || !ctx->bitmap2 || !ctx->cp)
+		return -ENOMEM;
+
+	test->priv = ctx;
 	return 0;
 }
 
-static int __init find_bit_test(void)
+static void find_bit_run_benches(struct kunit *test, struct find_bit_ctx *ctx)
 {
-	unsigned long nbits = BITMAP_LEN / SPARSE;
-
-	pr_err("\nStart testing find_bit() with random-filled bitmap\n");
+	int i;
 
-	get_random_bytes(bitmap, sizeof(bitmap));
-	get_random_bytes(bitmap2, sizeof(bitmap2));
+	for (i = 0; i < ARRAY_SIZE(find_bit_benches); i++)
+		kunit_run_bench(test, find_bit_benches[i].name,
+				find_bit_benches[i].fn, ctx, NULL);
+}
 
-	test_find_next_bit(bitmap, BITMAP_LEN);
-	test_find_next_zero_bit(bitmap, BITMAP_LEN);
-	test_find_last_bit(bitmap, BITMAP_LEN);
-	test_find_nth_bit(bitmap, BITMAP_LEN / 10);
+static void find_bit_random_test(struct kunit *test)
+{
+	struct find_bit_ctx *ctx = test->priv;
 
-	/*
-	 * test_find_first_bit() may take some time, so
-	 * traverse only part of bitmap to avoid soft lockup.
-	 */
-	test_find_first_bit(bitmap, BITMAP_LEN / 10);
-	test_find_first_and_bit(bitmap, bitmap2, BITMAP_LEN / 2);
-	test_find_next_and_bit(bitmap, bitmap2, BITMAP_LEN);
+	get_random_bytes(ctx->bitmap, BITMAP_LEN / 8);
+	get_random_bytes(ctx->bitmap2, BITMAP_LEN / 8);
+	ctx->first_len = BITMAP_LEN / 10;
+	ctx->first_and_len = BITMAP_LEN / 2;
+	ctx->nth_len = BITMAP_LEN / 10;
 
-	pr_err("\nStart testing find_bit() with sparse bitmap\n");
+	find_bit_run_benches(test, ctx);
+}
 
-	bitmap_zero(bitmap, BITMAP_LEN);
-	bitmap_zero(bitmap2, BITMAP_LEN);
+static void find_bit_sparse_test(struct kunit *test)
+{
+	struct find_bit_ctx *ctx = test->priv;
+	unsigned long nbits = BITMAP_LEN / SPARSE;
 
 	while (nbits--) {
-		__set_bit(get_random_u32_below(BITMAP_LEN), bitmap);
-		__set_bit(get_random_u32_below(BITMAP_LEN), bitmap2);
+		__set_bit(get_random_u32_below(BITMAP_LEN), ctx->bitmap);
+		__set_bit(get_random_u32_below(BITMAP_LEN), ctx->bitmap2);
 	}
+	ctx->first_len = BITMAP_LEN;
+	ctx->first_and_len = BITMAP_LEN;
+	ctx->nth_len = BITMAP_LEN;
 
-	test_find_next_bit(bitmap, BITMAP_LEN);
-	test_find_next_zero_bit(bitmap, BITMAP_LEN);
-	test_find_last_bit(bitmap, BITMAP_LEN);
-	test_find_nth_bit(bitmap, BITMAP_LEN);
-	test_find_first_bit(bitmap, BITMAP_LEN);
-	test_find_first_and_bit(bitmap, bitmap2, BITMAP_LEN);
-	test_find_next_and_bit(bitmap, bitmap2, BITMAP_LEN);
-
-	/*
-	 * Everything is OK. Return error just to let user run benchmark
-	 * again without annoying rmmod.
-	 */
-	return -EINVAL;
+	find_bit_run_benches(test, ctx);
 }
-module_init(find_bit_test);
+
+static struct kunit_case find_bit_test_cases[] = {
+	KUNIT_BENCH_CASE(find_bit_random_test),
+	KUNIT_BENCH_CASE(find_bit_sparse_test),
+	{}
+};
+
+static struct kunit_suite find_bit_test_suite = {
+	.name = "find_bit",
+	.init = find_bit_test_init,
+	.test_cases = find_bit_test_cases,
+};
+
+kunit_test_suite(find_bit_test_suite);
 
 MODULE_DESCRIPTION("Test for find_*_bit functions");
 MODULE_LICENSE("GPL");
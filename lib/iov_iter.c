@@ -1902,3 +1902,222 @@ ssize_t iov_iter_extract_pages(struct iov_iter *i,
 	return -EFAULT;
 }
 EXPORT_SYMBOL_GPL(iov_iter_extract_pages);
+
+/* Append a range to the list, merging it into the last one if contiguous */
+static void iov_iter_folio_append(struct iov_iter_folio *folios,
+				  unsigned int *nr, struct folio *folio,
+				  size_t offset, size_t len)
+{
+	if (*nr) {
+		struct iov_iter_folio *last = &folios[*nr - 1];
+
+		if (last->folio == folio &&
+		    last->offset + last->length == offset) {
+			last->length += len;
+			return;
+		}
+	}
+	folios[*nr].folio = folio;
+	folios[*nr].offset = offset;
+	folios[*nr].length = len;
+	(*nr)++;
+}
+
+/*
+ * Extract folio ranges from an ITER_BVEC iterator, across segments.  This
+ * does not get references on the folios, nor does it get a pin on them.
+ */
+static ssize_t iov_iter_extract_bvec_folios(struct iov_iter *i,
+					    struct iov_iter_folio *folios,
+					    unsigned int maxfolios,
+					    size_t maxsize,
+					    unsigned int *nr_folios)
+{
+	const struct bio_vec *bvec = i->bvec;
+	unsigned long nr_segs = i->nr_segs;
+	size_t skip = i->iov_offset, extracted = 0;
+	unsigned int nr = 0;
+
+	while (nr_segs && extracted < maxsize) {
+		size_t off = bvec->bv_offset + skip, foff, part;
+		struct page *page;
+		struct folio *folio;
+
+		if (skip == bvec->bv_len) {
+			bvec++;
+			nr_segs--;
+			skip = 0;
+			continue;
+		}
+
+		page = bvec->bv_page + off / PAGE_SIZE;
+		folio = page_folio(page);
+		foff = folio_page_idx(folio, page) * PAGE_SIZE + off % PAGE_SIZE;
+		part = umin(bvec->bv_len - skip,
+			    umin(folio_size(folio) - foff, maxsize - extracted));
+
+		if (nr == maxfolios &&
+		    (folios[nr - 1].folio != folio ||
+		     folios[nr - 1].offset + folios[nr - 1].length != foff))
+			break;
+		iov_iter_folio_append(folios, &nr, folio, foff, part);
+		extracted += part;
+		skip += part;
+	}
+
+	*nr_folios = nr;
+	iov_iter_advance(i, extracted);
+	return extracted;
+}
+
+/*
+ * Extract folio ranges from an ITER_FOLIOQ iterator.  This does not get
+ * references on the folios, nor does it get a pin on them.
+ */
+static ssize_t iov_iter_extract_folioq_folios(struct iov_iter *i,
+					      struct iov_iter_folio *folios,
+					      unsigned int maxfolios,
+					      size_t maxsize,
+					      unsigned int *nr_folios)
+{
+	const struct folio_queue *folioq = i->folioq;
+	unsigned int nr = 0;
+	size_t extracted = 0, slot = i->folioq_slot;
+
+	if (slot >= folioq_nr_slots(folioq)) {
+		folioq = folioq->next;
+		slot = 0;
+		if (WARN_ON(i->iov_offset != 0))
+			return -EIO;
+	}
+
+	for (;;) {
+		struct folio *folio = folioq_folio(folioq, slot);
+		size_t offset = i->iov_offset, fsize = folioq_folio_size(folioq, slot);
+
+		if (offset < fsize) {
+			size_t part = umin(maxsize - extracted, fsize - offset);
+
+			i->count -= part;
+			i->iov_offset += part;
+			extracted += part;
+
+			folios[nr].folio = folio;
+			folios[nr].offset = offset;
+			folios[nr].length = part;
+			nr++;
+		}
+
+		if (nr >= maxfolios || extracted >= maxsize)
+			break;
+
+		if (i->iov_offset >= fsize) {
+			i->iov_offset = 0;
+			slot++;
+			if (slot == folioq_nr_slots(folioq) && folioq->next) {
+				folioq = folioq->next;
+				slot = 0;
+			}
+		}
+	}
+
+	i->folioq = folioq;
+	i->folioq_slot = slot;
+	*nr_folios = nr;
+	return extracted;
+}
+
+/*
+ * Extract the pages of any other iterator with iov_iter_extract_pages() and
+ * merge them into folio ranges.  The page list is built at the end of the
+ * caller's array: range n is always written after page n has been read, and
+ * a range is at least two pointers in size, so it never overwrites a page
+ * still to be read.
+ */
+static ssize_t iov_iter_extract_folios_by_page(struct iov_iter *i,
+					       struct iov_iter_folio *folios,
+					       unsigned int maxfolios,
+					       size_t maxsize,
+					       iov_iter_extraction_t extraction_flags,
+					       unsigned int *nr_folios)
+{
+	const unsigned int ptrs = sizeof(*folios) / sizeof(struct page *);
+	struct page **pages = (struct page **)folios + (ptrs - 1) * maxfolios;
+	unsigned int k, nr = 0;
+	size_t offset, left;
+	ssize_t size;
+
+	BUILD_BUG_ON(sizeof(*folios) % sizeof(struct page *) ||
+		     sizeof(*folios) < 2 * sizeof(struct page *));
+
+	size = iov_iter_extract_pages(i, &pages, maxsize, maxfolios,
+				      extraction_flags, &offset);
+	if (size <= 0)
+		return size;
+
+	for (k = 0, left = size; left; k++) {
+		struct page *page = pages[k];
+		struct folio *folio = page_folio(page);
+		size_t part = umin(PAGE_SIZE - offset, left);
+
+		iov_iter_folio_append(folios, &nr, folio,
+				      folio_page_idx(folio, page) * PAGE_SIZE +
+				      offset, part);
+		left -= part;
+		offset = 0;
+	}
+
+	*nr_folios = nr;
+	return size;
+}
+
+/**
+ * iov_iter_extract_folios - Extract a list of folio ranges from an iterator
+ * @i: The iterator to extract from
+ * @folios: Where to return the list of ranges
+ * @maxfolios: The maximum size of the list of ranges
+ * @maxsize: The maximum amount of iterator to extract
+ * @extraction_flags: Flags to qualify request
+ * @nr_folios: Where to return the number of ranges
+ *
+ * Like iov_iter_extract_pages(), but returns (folio, offset, length) ranges
+ * instead of a page list, so that large folios do not have to be split into
+ * pages and merged back by the caller.  Physically contiguous parts of the
+ * same folio are merged into one range.  ITER_BVEC and ITER_FOLIOQ iterators
+ * are walked directly, without building a page list; bvec segments are
+ * crossed as long as ranges are left.
+ *
+ * Pins and refs are taken as for iov_iter_extract_pages(): if
+ * iov_iter_extract_will_pin() is true, each page of each range holds a pin,
+ * see iov_iter_folio_nr_pages().  The ranges have to fit in the folio and
+ * their length in an unsigned int.
+ *
+ * Return: the number of bytes extracted, 0 if there is nothing to extract,
+ * -EFAULT or -ENOMEM.
+ */
+ssize_t iov_iter_extract_folios(struct iov_iter *i,
+				struct iov_iter_folio *folios,
+				unsigned int maxfolios, size_t maxsize,
+				iov_iter_extraction_t extraction_flags,
+				unsigned int *nr_folios)
+{
+	*nr_folios = 0;
+	maxsize = min_t(size_t, min_t(size_t, maxsize, i->count), MAX_RW_COUNT);
+	if (!maxsize || !maxfolios)
+		return 0;
+
+	if (likely(user_backed_iter(i)) || iov_iter_is_kvec(i) ||
+	    iov_iter_is_xarray(i))
+		return iov_iter_extract_folios_by_page(i, folios, maxfolios,
+						       maxsize,
+						       extraction_flags,
+						       nr_folios);
+	if (iov_iter_is_bvec(i))
+		return iov_iter_extract_bvec_folios(i, folios, maxfolios,
+						    maxsize, nr_folios);
+	if (iov_iter_is_folioq(i))
+		return iov_iter_extract_folioq_folios(i, folios, maxfolios,
+						      maxsize, nr_folios);
+	return -EFAULT;
+}
+EXPORT_SYMBOL_GPL(iov_iter_extract_folios);
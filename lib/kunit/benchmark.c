@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit benchmark API.
+ *
+ * A benchmark is calibrated until one run of it takes a fraction of
+ * kunit.bench_time_ms, then run repeatedly with that number of iterations
+ * until the time is used up.  The mean and standard deviation of the per
+ * operation cost of the runs are reported as a KTAP diagnostic, and the
+ * test fails if the mean exceeds a baseline given in kunit.bench_baseline.
+ */
+
+#include <kunit/benchmark.h>
+#include <kunit/test.h>
+#include <linux/kernel.h>
+#include <linux/math.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+
+/* Runs per benchmark: reported numbers need some, and each costs time. */
+#define KUNIT_BENCH_MIN_RUNS	5
+#define KUNIT_BENCH_MAX_RUNS	32
+#define KUNIT_BENCH_MAX_ITERS	(1ULL << 32)
+
+static unsigned int kunit_bench_time_ms = 100;
+module_param_named(bench_time_ms, kunit_bench_time_ms, uint, 0644);
+MODULE_PARM_DESC(bench_time_ms, "Time to spend on each benchmark, in milliseconds");
+
+static char *kunit_bench_baseline;
+module_param_named(bench_baseline, kunit_bench_baseline, charp, 0644);
+MODULE_PARM_DESC(bench_baseline,
+		 "Comma separated list of <test>.<benchmark>=<ns/op> a benchmark must not exceed");
+
+static unsigned int kunit_bench_tolerance = 10;
+module_param_named(bench_tolerance, kunit_bench_tolerance, uint, 0644);
+MODULE_PARM_DESC(bench_tolerance,
+		 "Percentage by which a benchmark may exceed its baseline");
+
+static u64 kunit_bench_once(struct kunit *test, kunit_bench_fn_t fn,
+			    void *ctx, u64 iters)
+{
+	struct kunit_bench bench = { .iters = iters };
+
+	kunit_bench_start_timer(&bench);
+	fn(test, &bench, ctx);
+	kunit_bench_stop_timer(&bench);
+
+	cond_resched();
+	return bench.elapsed_ns;
+}
+
+/* Find the iterations for one run to take about @target_ns. */
+static u64 kunit_bench_calibrate(struct kunit *test, kunit_bench_fn_t fn,
+				 void *ctx, u64 target_ns)
+{
+	u64 iters = 1, ns;
+
+	for (;;) {
+		ns = kunit_bench_once(test, fn, ctx, iters);
+		if (ns >= target_ns || iters >= KUNIT_BENCH_MAX_ITERS)
+			return iters;
+		/* Overshoot a little, but grow at least 2x and at most 100x. */
+		if (ns)
+			iters = clamp(div64_u64(iters * target_ns * 6, ns * 5),
+				      iters * 2, iters * 100);
+		else
+			iters *= 100;
+		iters = min(iters, KUNIT_BENCH_MAX_ITERS);
+	}
+}
+
+static bool __kunit_bench_find_baseline(struct kunit *test, const char *name,
+					u64 *baseline_ns)
+{
+	size_t tlen = strlen(test->name), nlen = strlen(name);
+	const char *p = kunit_bench_baseline;
+	char buf[24];
+
+	while (p && *p) {
+		const char *end = strchrnul(p, ',');
+		const char *val = p + tlen + nlen + 2;
+
+		if ((size_t)(end - p) > tlen + nlen + 2 &&
+		    !strncmp(p, test->name, tlen) && p[tlen] == '.' &&
+		    !strncmp(p + tlen + 1, name, nlen) && val[-1] == '=') {
+			if ((size_t)(end - val) >= sizeof(buf))
+				return false;
+			memcpy(buf, val, end - val);
+			buf[end - val] = '\0';
+			return !kstrtou64(buf, 10, baseline_ns);
+		}
+		p = *end ? end + 1 : end;
+	}
+	return false;
+}
+
+/*
+ * Look up "<test>.<name>=<ns>" in kunit.bench_baseline.  The parameter can
+ * be rewritten through sysfs, which frees the old string.
+ */
+static bool kunit_bench_find_baseline(struct kunit *test, const char *name,
+				      u64 *baseline_ns)
+{
+	bool found;
+
+	kernel_param_lock(THIS_MODULE);
+	found = __kunit_bench_find_baseline(test, name, baseline_ns);
+	kernel_param_unlock(THIS_MODULE);
+
+	return found;
+}
+
+int kunit_run_bench(struct kunit *test, const char *name, kunit_bench_fn_t fn,
+		    void *ctx, struct kunit_bench_result *result)
+{
+	u64 samples[KUNIT_BENCH_MAX_RUNS];
+	u64 budget_ns = (u64)kunit_bench_time_ms * NSEC_PER_MSEC;
+	u64 deadline, iters, sum = 0, var = 0, baseline_ns;
+	struct kunit_bench_result res = { .min_ps = U64_MAX };
+	u32 mean_frac, stddev_frac, min_frac;
+	u64 mean_ns, stddev_ns, min_ns;
+	unsigned int i;
+
+	iters = kunit_bench_calibrate(test, fn, ctx,
+				      div_u64(budget_ns, 2 * KUNIT_BENCH_MIN_RUNS));
+
+	deadline = ktime_get_ns() + budget_ns;
+	do {
+		u64 ps = div64_u64(kunit_bench_once(test, fn, ctx, iters) * 1000,
+				   iters);
+
+		samples[res.runs++] = ps;
+		sum += ps;
+		res.min_ps = min(res.min_ps, ps);
+	} while (res.runs < KUNIT_BENCH_MAX_RUNS &&
+		 (res.runs < KUNIT_BENCH_MIN_RUNS || ktime_get_ns() < deadline));
+
+	res.iters = iters;
+	res.mean_ps = div_u64(sum, res.runs);
+	for (i = 0; i < res.runs; i++) {
+		u64 d = abs_diff(samples[i], res.mean_ps);
+
+		var += div_u64(d * d, res.runs);
+	}
+	res.stddev_ps = int_sqrt64(var);
+
+	mean_ns = div_u64_rem(res.mean_ps, 1000, &mean_frac);
+	stddev_ns = div_u64_rem(res.stddev_ps, 1000, &stddev_frac);
+	min_ns = div_u64_rem(res.min_ps, 1000, &min_frac);
+	kunit_info(test, "%s: %llu.%03u ns/op +- %llu.%03u, min %llu.%03u (%u runs of %llu ops)\n",
+		   name, mean_ns, mean_frac, stddev_ns, stddev_frac,
+		   min_ns, min_frac, res.runs, res.iters);
+
+	if (result)
+		*result = res;
+
+	if (kunit_bench_find_baseline(test, name, &baseline_ns) &&
+	    res.mean_ps * 100 > baseline_ns * 1000 * (100 + kunit_bench_tolerance)) {
+		KUNIT_FAIL(test, "%s: %llu.%03u ns/op is more than %u%% over the baseline of %llu ns/op",
+			   name, mean_ns, mean_frac, kunit_bench_tolerance,
+			   baseline_ns);
+		return -ERANGE;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(kunit_run_bench);
@@ -7,6 +7,7 @@
  */
 
 #include <kunit/test.h>
+#include <kunit/benchmark.h>
 #include <kunit/static_stub.h>
 
 /*
@@ -277,6 +278,37 @@ static void example_slow_test(struct kunit *test)
 	KUNIT_EXPECT_EQ(test, 1 + 1, 2);
 }
 
+/*
+ * A benchmark function performs bench->iters operations. KUnit calls it
+ * repeatedly with an iteration count it calibrated and reports the cost of
+ * one operation.
+ */
+static void example_memset_bench(struct kunit *test, struct kunit_bench *bench,
+				 void *ctx)
+{
+	u8 *buf = ctx;
+	u64 i;
+
+	for (i = 0; i < bench->iters; i++) {
+		memset(buf, i, 64);
+		/* Keep the compiler from dropping the stores. */
+		OPTIMIZER_HIDE_VAR(buf);
+	}
+}
+
+/*
+ * This test runs a benchmark. Its result is printed as a diagnostic line,
+ * and can fail the test when kunit.bench_baseline has an entry
+ * "example_bench_test.memset64=<ns/op>" that it exceeds.
+ */
+static void example_bench_test(struct kunit *test)
+{
+	u8 *buf = kunit_kzalloc(test, 64, GFP_KERNEL);
+
+	KUNIT_ASSERT_NOT_NULL(test, buf);
+	kunit_run_bench(test, "memset64", example_memset_bench, buf, NULL);
+}
+
 /*
  * Here we make a list of all the test cases we want to add to the test suite
  * below.
@@ -297,6 +329,7 @@ static struct kunit_case example_test_cases[] = {
 	KUNIT_CASE(example_priv_test),
 	KUNIT_CASE_PARAM(example_params_test, example_gen_params),
 	KUNIT_CASE_SLOW(example_slow_test),
+	KUNIT_BENCH_CASE(example_bench_test),
 	{}
 };
 
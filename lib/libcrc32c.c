@@ -54,6 +54,15 @@ u32 crc32c(u32 crc, const void *address, unsigned int length)
 
 EXPORT_SYMBOL(crc32c);
 
+/* Name of the crypto driver backing crc32c(), e.g. "crc32c-intel" */
+const char *crc32c_impl(void)
+{
+	if (IS_ERR_OR_NULL(tfm))
+		return NULL;
+	return crypto_shash_driver_name(tfm);
+}
+EXPORT_SYMBOL(crc32c_impl);
+
 static int __init libcrc32c_mod_init(void)
 {
 	tfm = crypto_alloc_shash("crc32c", 0, 0);
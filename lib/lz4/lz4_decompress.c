@@ -280,7 +280,7 @@ static FORCE_INLINE int LZ4_decompress_generic(
 				break;
 		} else {
 			/* may overwrite up to WILDCOPYLENGTH beyond cpy */
-			LZ4_wildCopy(op, ip, cpy);
+			LZ4_wildCopy16(op, ip, cpy);
 			ip += length;
 			op = cpy;
 		}
@@ -402,6 +402,13 @@ static FORCE_INLINE int LZ4_decompress_generic(
 			continue;
 		}
 
+		/* Runs of one byte, e.g. zeroes in a page: no overlap dance */
+		if (unlikely(offset == 1) && cpy <= oend - LASTLITERALS) {
+			memset(op, *match, length);
+			op = cpy;
+			continue;
+		}
+
 		if (unlikely(offset < 8)) {
 			op[0] = match[0];
 			op[1] = match[1];
@@ -438,7 +445,7 @@ static FORCE_INLINE int LZ4_decompress_generic(
 		} else {
 			LZ4_copy8(op, match);
 			if (length > 16)
-				LZ4_wildCopy(op + 8, match + 8, cpy);
+				LZ4_wildCopy16(op + 8, match + 8, cpy);
 		}
 		op = cpy; /* wildcopy correction */
 	}
@@ -183,6 +183,31 @@ static FORCE_INLINE void LZ4_wildCopy(void *dstPtr,
 	} while (d < e);
 }
 
+/*
+ * LZ4_wildCopy() unrolled to 16 bytes per iteration. The 8 byte halves are
+ * copied in order, so overlapping copies work exactly as with
+ * LZ4_wildCopy(). Still overwrites up to 7 bytes beyond dstEnd.
+ */
+static FORCE_INLINE void LZ4_wildCopy16(void *dstPtr,
+	const void *srcPtr, void *dstEnd)
+{
+	BYTE *d = (BYTE *)dstPtr;
+	const BYTE *s = (const BYTE *)srcPtr;
+	BYTE *const e = (BYTE *)dstEnd;
+
+	while (e - d >= 16) {
+		LZ4_copy8(d, s);
+		LZ4_copy8(d + 8, s + 8);
+		d += 16;
+		s += 16;
+	}
+	if (d < e) {
+		LZ4_copy8(d, s);
+		if (e - d > 8)
+			LZ4_copy8(d + 8, s + 8);
+	}
+}
+
 static FORCE_INLINE unsigned int LZ4_NbCommonBytes(register size_t val)
 {
 #if LZ4_LITTLE_ENDIAN
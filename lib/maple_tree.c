@@ -5535,6 +5535,39 @@ void mas_store_prealloc(struct ma_state *mas, void *entry)
 }
 EXPORT_SYMBOL_GPL(mas_store_prealloc);
 
+/**
+ * mas_replace_entry() - Replace the entry the maple state points to.
+ * @mas: The maple state, just after mas_find() or mas_walk() found an entry
+ * @entry: The new entry, not %NULL
+ *
+ * Overwrites the slot of the entry last found, so the range stays
+ * mas->index to mas->last and nothing needs to be walked, split or
+ * allocated.  This is the store for a loop over a freshly duplicated tree
+ * that points every entry at its own copy.
+ *
+ * Must hold the write lock.
+ */
+void mas_replace_entry(struct ma_state *mas, void *entry)
+{
+	void __rcu **slots;
+
+	trace_ma_write(__func__, mas, 0, entry);
+	if (MAS_WARN_ON(mas, !entry || xa_is_internal(entry)))
+		return;
+
+	if (mas_is_ptr(mas)) {
+		rcu_assign_pointer(mas->tree->ma_root, entry);
+		return;
+	}
+
+	if (MAS_WARN_ON(mas, !mas_is_active(mas)))
+		return;
+
+	slots = ma_slots(mas_mn(mas), mte_node_type(mas->node));
+	rcu_assign_pointer(slots[mas->offset], entry);
+}
+EXPORT_SYMBOL_GPL(mas_replace_entry);
+
 /**
  * mas_preallocate() - Preallocate enough nodes for a store operation
  * @mas: The maple state
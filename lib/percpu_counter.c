@@ -9,9 +9,12 @@
 #include <linux/cpu.h>
 #include <linux/module.h>
 #include <linux/debugobjects.h>
+#include <linux/nodemask.h>
+#include <linux/slab.h>
 
 #ifdef CONFIG_HOTPLUG_CPU
 static LIST_HEAD(percpu_counters);
+static LIST_HEAD(percpu_node_counters);
 static DEFINE_SPINLOCK(percpu_counters_lock);
 #endif
 
@@ -266,6 +269,7 @@ static int compute_batch_value(unsigned int cpu)
 static int percpu_counter_cpu_dead(unsigned int cpu)
 {
 #ifdef CONFIG_HOTPLUG_CPU
+	struct percpu_node_counter *pnc;
 	struct percpu_counter *fbc;
 
 	compute_batch_value(cpu);
@@ -280,6 +284,12 @@ static int percpu_counter_cpu_dead(unsigned int cpu)
 		*pcount = 0;
 		raw_spin_unlock(&fbc->lock);
 	}
+	list_for_each_entry(pnc, &percpu_node_counters, list) {
+		s32 *pcount = per_cpu_ptr(pnc->counters, cpu);
+
+		atomic64_add(*pcount, &pnc->count);
+		*pcount = 0;
+	}
 	spin_unlock_irq(&percpu_counters_lock);
 #endif
 	return 0;
@@ -391,6 +401,167 @@ bool __percpu_counter_limited_add(struct percpu_counter *fbc,
 	return good;
 }
 
+/**
+ * percpu_node_counter_init - initialize a per-node batched counter
+ * @pnc: the counter
+ * @amount: initial value
+ * @batch: per-cpu batch, or 0 for percpu_counter_batch
+ * @gfp: allocation flags
+ *
+ * Each node folds its count into the global count once it reaches the
+ * per-cpu batch times the number of CPUs per node.
+ */
+int percpu_node_counter_init(struct percpu_node_counter *pnc, s64 amount,
+			     s32 batch, gfp_t gfp)
+{
+	unsigned long flags __maybe_unused;
+	unsigned int cpus_per_node;
+
+	if (!batch)
+		batch = percpu_counter_batch;
+	cpus_per_node = DIV_ROUND_UP(nr_cpu_ids, nr_node_ids);
+
+	pnc->nodes = kcalloc(nr_node_ids, sizeof(*pnc->nodes), gfp);
+	if (!pnc->nodes)
+		return -ENOMEM;
+	pnc->counters = alloc_percpu_gfp(s32, gfp);
+	if (!pnc->counters) {
+		kfree(pnc->nodes);
+		pnc->nodes = NULL;
+		return -ENOMEM;
+	}
+
+	atomic64_set(&pnc->count, amount);
+	pnc->batch = batch;
+	pnc->node_batch = min_t(s64, (s64)batch * cpus_per_node, S32_MAX);
+
+#ifdef CONFIG_HOTPLUG_CPU
+	INIT_LIST_HEAD(&pnc->list);
+	spin_lock_irqsave(&percpu_counters_lock, flags);
+	list_add(&pnc->list, &percpu_node_counters);
+	spin_unlock_irqrestore(&percpu_counters_lock, flags);
+#endif
+	return 0;
+}
+EXPORT_SYMBOL(percpu_node_counter_init);
+
+void percpu_node_counter_destroy(struct percpu_node_counter *pnc)
+{
+	unsigned long flags __maybe_unused;
+
+	if (!pnc->counters)
+		return;
+
+#ifdef CONFIG_HOTPLUG_CPU
+	spin_lock_irqsave(&percpu_counters_lock, flags);
+	list_del(&pnc->list);
+	spin_unlock_irqrestore(&percpu_counters_lock, flags);
+#endif
+
+	free_percpu(pnc->counters);
+	pnc->counters = NULL;
+	kfree(pnc->nodes);
+	pnc->nodes = NULL;
+}
+EXPORT_SYMBOL(percpu_node_counter_destroy);
+
+/*
+ * Add the count of this CPU to its node, and the node to the global count
+ * when it goes over the node batch.  The global count is added to before
+ * the node is subtracted from, so that a concurrent read can see the
+ * amount twice but never miss it.
+ */
+static void percpu_node_counter_fold(struct percpu_node_counter *pnc,
+				     s64 amount)
+{
+	atomic64_t *node = &pnc->nodes[numa_node_id()].count;
+	s64 count;
+
+	count = atomic64_add_return(amount, node);
+	if (likely(abs(count) < pnc->node_batch))
+		return;
+
+	atomic64_add(count, &pnc->count);
+	atomic64_sub(count, node);
+}
+
+void percpu_node_counter_add(struct percpu_node_counter *pnc, s64 amount)
+{
+	unsigned long flags;
+	s64 count;
+
+	local_irq_save(flags);
+	count = __this_cpu_read(*pnc->counters) + amount;
+	if (likely(abs(count) < pnc->batch)) {
+		__this_cpu_write(*pnc->counters, count);
+	} else {
+		__this_cpu_write(*pnc->counters, 0);
+		percpu_node_counter_fold(pnc, count);
+	}
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL(percpu_node_counter_add);
+
+/*
+ * Global and per-node counts, without the per-cpu counts that have not
+ * reached the batch yet.
+ */
+s64 percpu_node_counter_read_nodes(struct percpu_node_counter *pnc)
+{
+	s64 ret = atomic64_read(&pnc->count);
+	int node;
+
+	for_each_node(node)
+		ret += atomic64_read(&pnc->nodes[node].count);
+	return ret;
+}
+EXPORT_SYMBOL(percpu_node_counter_read_nodes);
+
+/*
+ * As __percpu_counter_sum(), dying CPUs are included because their count
+ * may not be folded back yet.
+ */
+s64 percpu_node_counter_sum(struct percpu_node_counter *pnc)
+{
+	s64 ret = percpu_node_counter_read_nodes(pnc);
+	int cpu;
+
+	for_each_cpu_or(cpu, cpu_online_mask, cpu_dying_mask)
+		ret += *per_cpu_ptr(pnc->counters, cpu);
+	return ret;
+}
+EXPORT_SYMBOL(percpu_node_counter_sum);
+
+/*
+ * Compare counter against given value, reading the global count, then the
+ * nodes and then the CPUs, until the uncertainty left cannot change the
+ * result.
+ * Return 1 if greater, 0 if equal and -1 if less
+ */
+int percpu_node_counter_compare(struct percpu_node_counter *pnc, s64 rhs)
+{
+	s64 cpu_error = (s64)pnc->batch * num_online_cpus();
+	s64 node_error = (s64)pnc->node_batch * num_online_nodes();
+	s64 count;
+
+	count = percpu_node_counter_read(pnc);
+	if (abs(count - rhs) > cpu_error + node_error)
+		return count > rhs ? 1 : -1;
+
+	count = percpu_node_counter_read_nodes(pnc);
+	if (abs(count - rhs) > cpu_error)
+		return count > rhs ? 1 : -1;
+
+	count = percpu_node_counter_sum(pnc);
+	if (count > rhs)
+		return 1;
+	else if (count < rhs)
+		return -1;
+	else
+		return 0;
+}
+EXPORT_SYMBOL(percpu_node_counter_compare);
+
 static int __init percpu_counter_startup(void)
 {
 	int ret;
@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
+#include <linux/ktime.h>
 #include <linux/module.h>
+#include <linux/percpu_counter.h>
 
 /* validate @native and @pcp counter values match @expected */
 #define CHECK(native, pcp, expected)                                    \
@@ -17,6 +19,68 @@
 static DEFINE_PER_CPU(long, long_counter);
 static DEFINE_PER_CPU(unsigned long, ulong_counter);
 
+#define COUNTER_BENCH_LOOPS	100000
+
+/* Cost per call of updates and accurate reads, percpu vs per-node counter */
+static void __init percpu_counter_bench(void)
+{
+	u64 start, fbc_add, fbc_sum, pnc_add, pnc_nodes, pnc_sum;
+	struct percpu_node_counter pnc;
+	struct percpu_counter fbc;
+	s64 sink = 0;
+	int i;
+
+	if (percpu_counter_init(&fbc, 0, GFP_KERNEL))
+		return;
+	if (percpu_node_counter_init(&pnc, 0, 0, GFP_KERNEL)) {
+		percpu_counter_destroy(&fbc);
+		return;
+	}
+
+	start = ktime_get_ns();
+	for (i = 0; i < COUNTER_BENCH_LOOPS; i++)
+		percpu_counter_add(&fbc, 1);
+	fbc_add = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < COUNTER_BENCH_LOOPS; i++)
+		sink += percpu_counter_sum(&fbc);
+	fbc_sum = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < COUNTER_BENCH_LOOPS; i++)
+		percpu_node_counter_add(&pnc, 1);
+	pnc_add = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < COUNTER_BENCH_LOOPS; i++)
+		sink += percpu_node_counter_read_nodes(&pnc);
+	pnc_nodes = ktime_get_ns() - start;
+
+	start = ktime_get_ns();
+	for (i = 0; i < COUNTER_BENCH_LOOPS; i++)
+		sink += percpu_node_counter_sum(&pnc);
+	pnc_sum = ktime_get_ns() - start;
+
+	WARN(percpu_counter_sum(&fbc) != COUNTER_BENCH_LOOPS,
+	     "percpu_counter sum %lld", percpu_counter_sum(&fbc));
+	WARN(percpu_node_counter_sum(&pnc) != COUNTER_BENCH_LOOPS,
+	     "percpu_node_counter sum %lld", percpu_node_counter_sum(&pnc));
+	WARN(percpu_node_counter_compare(&pnc, COUNTER_BENCH_LOOPS),
+	     "percpu_node_counter compare");
+
+	pr_info("percpu_counter ns/op: add %llu sum %llu\n",
+		div_u64(fbc_add, COUNTER_BENCH_LOOPS),
+		div_u64(fbc_sum, COUNTER_BENCH_LOOPS));
+	pr_info("percpu_node_counter ns/op: add %llu read_nodes %llu sum %llu (%lld)\n",
+		div_u64(pnc_add, COUNTER_BENCH_LOOPS),
+		div_u64(pnc_nodes, COUNTER_BENCH_LOOPS),
+		div_u64(pnc_sum, COUNTER_BENCH_LOOPS), sink);
+
+	percpu_node_counter_destroy(&pnc);
+	percpu_counter_destroy(&fbc);
+}
+
 static int __init percpu_test_init(void)
 {
 	/*
@@ -123,6 +187,8 @@ static int __init percpu_test_init(void)
 
 	preempt_enable();
 
+	percpu_counter_bench();
+
 	pr_info("percpu test done\n");
 	return -EAGAIN;  /* Fail will directly unload the module */
 }
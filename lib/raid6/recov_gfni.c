@@ -0,0 +1,193 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * RAID-6 data recovery using AVX-512 and GFNI instructions
+ *
+ * Based on recov_avx512.c.  Each multiplication by a constant is a single
+ * VGF2P8AFFINEQB on a bit matrix built from raid6_gfmul[], instead of two
+ * nibble lookups with VPSHUFB.
+ */
+
+#if defined(CONFIG_AS_AVX512) && defined(CONFIG_AS_GFNI)
+
+#include <linux/raid/pq.h>
+#include "x86.h"
+
+static int raid6_has_gfni(void)
+{
+	return boot_cpu_has(X86_FEATURE_AVX2) &&
+		boot_cpu_has(X86_FEATURE_AVX) &&
+		boot_cpu_has(X86_FEATURE_AVX512F) &&
+		boot_cpu_has(X86_FEATURE_AVX512BW) &&
+		boot_cpu_has(X86_FEATURE_AVX512VL) &&
+		boot_cpu_has(X86_FEATURE_AVX512DQ) &&
+		boot_cpu_has(X86_FEATURE_GFNI);
+}
+
+/*
+ * VGF2P8AFFINEQB matrix for multiplication by @c: output bit i is in
+ * byte 7 - i, and has input bit j set if c * x^j has bit i set.
+ */
+static u64 raid6_gfni_matrix(u8 c)
+{
+	u64 m = 0;
+	int i, j;
+
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < 8; j++)
+			if (raid6_gfmul[c][1 << j] & (1 << i))
+				m |= 1ULL << ((7 - i) * 8 + j);
+	return m;
+}
+
+static void raid6_2data_recov_gfni(int disks, size_t bytes, int faila,
+				   int failb, void **ptrs)
+{
+	u8 *p, *q, *dp, *dq;
+	u64 pbmat;		/* P multiplier matrix for B data */
+	u64 qmat;		/* Q multiplier matrix (for both) */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/*
+	 * Compute syndrome with zero for the missing data pages
+	 * Use the dead data pages as temporary storage for
+	 * delta p and delta q
+	 */
+
+	dp = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-2] = dp;
+	dq = (u8 *)ptrs[failb];
+	ptrs[failb] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dp;
+	ptrs[failb]   = dq;
+	ptrs[disks-2] = p;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data matrices */
+	pbmat = raid6_gfni_matrix(raid6_gfexi[failb-faila]);
+	qmat  = raid6_gfni_matrix(raid6_gfinv[raid6_gfexp[faila] ^
+				  raid6_gfexp[failb]]);
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0, %%zmm6\n\t"
+		     "vpbroadcastq %1, %%zmm7"
+		     :
+		     : "m" (qmat), "m" (pbmat));
+
+	while (bytes) {
+		asm volatile("vmovdqa64 %0, %%zmm1\n\t"
+			     "vmovdqa64 %1, %%zmm0\n\t"
+			     "vpxorq %2, %%zmm1, %%zmm1\n\t"
+			     "vpxorq %3, %%zmm0, %%zmm0"
+			     :
+			     : "m" (q[0]), "m" (p[0]), "m" (dq[0]),
+			       "m" (dp[0]));
+
+		/*
+		 * 1 = dq ^ q
+		 * 0 = dp ^ p
+		 */
+
+		asm volatile("vgf2p8affineqb $0, %%zmm6, %%zmm1, %%zmm5\n\t"
+			     "vgf2p8affineqb $0, %%zmm7, %%zmm0, %%zmm1\n\t"
+			     "vpxorq %%zmm5, %%zmm1, %%zmm1\n\t"
+			     "vpxorq %%zmm1, %%zmm0, %%zmm0"
+			     :
+			     : );
+
+		/*
+		 * 1 = pbmul[px] ^ qmul[qx] = db
+		 * 0 = px ^ db = da
+		 */
+
+		asm volatile("vmovdqa64 %%zmm1, %0\n\t"
+			     "vmovdqa64 %%zmm0, %1"
+			     :
+			     : "m" (dq[0]), "m" (dp[0]));
+
+		bytes -= 64;
+		p += 64;
+		q += 64;
+		dp += 64;
+		dq += 64;
+	}
+
+	kernel_fpu_end();
+}
+
+static void raid6_datap_recov_gfni(int disks, size_t bytes, int faila,
+				   void **ptrs)
+{
+	u8 *p, *q, *dq;
+	u64 qmat;		/* Q multiplier matrix */
+
+	p = (u8 *)ptrs[disks-2];
+	q = (u8 *)ptrs[disks-1];
+
+	/*
+	 * Compute syndrome with zero for the missing data page
+	 * Use the dead data page as temporary storage for delta q
+	 */
+
+	dq = (u8 *)ptrs[faila];
+	ptrs[faila] = (void *)raid6_empty_zero_page;
+	ptrs[disks-1] = dq;
+
+	raid6_call.gen_syndrome(disks, bytes, ptrs);
+
+	/* Restore pointer table */
+	ptrs[faila]   = dq;
+	ptrs[disks-1] = q;
+
+	/* Now, pick the proper data matrix */
+	qmat = raid6_gfni_matrix(raid6_gfinv[raid6_gfexp[faila]]);
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0, %%zmm6" : : "m" (qmat));
+
+	while (bytes) {
+		asm volatile("vmovdqa64 %0, %%zmm3\n\t"
+			     "vpxorq %1, %%zmm3, %%zmm3\n\t"
+			     "vgf2p8affineqb $0, %%zmm6, %%zmm3, %%zmm1\n\t"
+			     "vmovdqa64 %2, %%zmm2\n\t"
+			     "vpxorq %%zmm1, %%zmm2, %%zmm2"
+			     :
+			     : "m" (dq[0]), "m" (q[0]), "m" (p[0]));
+
+		/*
+		 * 1 = qmul[q ^ dq]
+		 * 2 = p ^ qmul[q ^ dq]
+		 */
+
+		asm volatile("vmovdqa64 %%zmm1, %0\n\t"
+			     "vmovdqa64 %%zmm2, %1"
+			     :
+			     : "m" (dq[0]), "m" (p[0]));
+
+		bytes -= 64;
+		p += 64;
+		q += 64;
+		dq += 64;
+	}
+
+	kernel_fpu_end();
+}
+
+const struct raid6_recov_calls raid6_recov_gfni = {
+	.data2 = raid6_2data_recov_gfni,
+	.datap = raid6_datap_recov_gfni,
+	.valid = raid6_has_gfni,
+	.name = "gfni",
+	.priority = 4,
+};
+
+#endif /* CONFIG_AS_AVX512 && CONFIG_AS_GFNI */
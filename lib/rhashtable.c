@@ -27,6 +27,7 @@
 #include <linux/export.h>
 
 #define HASH_DEFAULT_SIZE	64UL
+#define RHT_MAX_SHARDS		1024U
 #define HASH_MIN_SIZE		4U
 
 union nested_table {
@@ -1181,6 +1182,83 @@ void rhashtable_destroy(struct rhashtable *ht)
 }
 EXPORT_SYMBOL_GPL(rhashtable_destroy);
 
+/**
+ * rhashtable_sharded_init - initialize a new sharded hash table
+ * @sht:	sharded hash table to be initialized
+ * @params:	configuration parameters, for each shard
+ * @nr_shards:	number of shards, a power of two
+ *
+ * Large tables rehash one shard at a time rather than all of their
+ * objects at once.  The size hints in @params apply to the whole table.
+ *
+ * See documentation for rhashtable_init.
+ */
+int rhashtable_sharded_init_noprof(struct rhashtable_sharded *sht,
+				   const struct rhashtable_params *params,
+				   unsigned int nr_shards)
+{
+	struct rhashtable_params p = *params;
+	unsigned int i;
+	int err;
+
+	if (!is_power_of_2(nr_shards) || nr_shards > RHT_MAX_SHARDS)
+		return -EINVAL;
+
+	sht->shards = kvmalloc_array(nr_shards, sizeof(*sht->shards),
+				     GFP_KERNEL);
+	if (!sht->shards)
+		return -ENOMEM;
+	sht->shard_shift = ilog2(nr_shards);
+	sht->hash_rnd = get_random_u32();
+
+	p.nelem_hint = DIV_ROUND_UP(p.nelem_hint, nr_shards);
+	if (p.max_size)
+		p.max_size = max_t(unsigned int, p.max_size / nr_shards,
+				   HASH_MIN_SIZE);
+
+	for (i = 0; i < nr_shards; i++) {
+		err = rhashtable_init_noprof(&sht->shards[i], &p);
+		if (err)
+			goto err_destroy;
+	}
+	return 0;
+
+err_destroy:
+	while (i--)
+		rhashtable_destroy(&sht->shards[i]);
+	kvfree(sht->shards);
+	sht->shards = NULL;
+	return err;
+}
+EXPORT_SYMBOL_GPL(rhashtable_sharded_init_noprof);
+
+/**
+ * rhashtable_sharded_free_and_destroy - free elements and destroy a table
+ * @sht:	the sharded hash table to destroy
+ * @free_fn:	callback to release resources of element
+ * @arg:	pointer passed to free_fn
+ *
+ * rhashtable_free_and_destroy() of each shard.
+ */
+void rhashtable_sharded_free_and_destroy(struct rhashtable_sharded *sht,
+					 void (*free_fn)(void *ptr, void *arg),
+					 void *arg)
+{
+	unsigned int i;
+
+	for (i = 0; i < 1U << sht->shard_shift; i++)
+		rhashtable_free_and_destroy(&sht->shards[i], free_fn, arg);
+	kvfree(sht->shards);
+	sht->shards = NULL;
+}
+EXPORT_SYMBOL_GPL(rhashtable_sharded_free_and_destroy);
+
+void rhashtable_sharded_destroy(struct rhashtable_sharded *sht)
+{
+	return rhashtable_sharded_free_and_destroy(sht, NULL, NULL);
+}
+EXPORT_SYMBOL_GPL(rhashtable_sharded_destroy);
+
 struct rhash_lock_head __rcu **__rht_bucket_nested(
 	const struct bucket_table *tbl, unsigned int hash)
 {
@@ -26,6 +26,52 @@ static int init_alloc_hint(struct sbitmap *sb, gfp_t flags)
 	return 0;
 }
 
+/*
+ * The words of the group of @node, for NUMA bitmaps; all of them otherwise.
+ */
+static unsigned int sbitmap_node_words(const struct sbitmap *sb, int node,
+				       unsigned int *first)
+{
+	unsigned int nr_groups = min_t(unsigned int, nr_node_ids, sb->map_nr);
+	unsigned int group;
+
+	*first = 0;
+	if (!sb->numa || nr_groups <= 1)
+		return sb->map_nr;
+
+	group = node % nr_groups;
+	*first = group * sb->map_nr / nr_groups;
+	return (group + 1) * sb->map_nr / nr_groups - *first;
+}
+
+/*
+ * The words to search first from this CPU, moving @index into them if it
+ * points outside.
+ */
+static unsigned int sbitmap_local_words(const struct sbitmap *sb,
+					unsigned int *index,
+					unsigned int *first)
+{
+	unsigned int nr_words = sbitmap_node_words(sb, numa_node_id(), first);
+
+	if (*index < *first || *index >= *first + nr_words)
+		*index = *first;
+	return nr_words;
+}
+
+static unsigned int sbitmap_node_hint(const struct sbitmap *sb, int node,
+				      unsigned int depth)
+{
+	unsigned int first, nr_words, hint;
+
+	nr_words = sbitmap_node_words(sb, node, &first);
+	if (!nr_words)
+		return 0;
+
+	hint = (first << sb->shift) + get_random_u32_below(nr_words << sb->shift);
+	return hint < depth ? hint : min(first << sb->shift, depth - 1);
+}
+
 static inline unsigned update_alloc_hint_before_get(struct sbitmap *sb,
 						    unsigned int depth)
 {
@@ -33,7 +79,12 @@ static inline unsigned update_alloc_hint_before_get(struct sbitmap *sb,
 
 	hint = this_cpu_read(*sb->alloc_hint);
 	if (unlikely(hint >= depth)) {
-		hint = depth ? get_random_u32_below(depth) : 0;
+		if (!depth)
+			hint = 0;
+		else if (sb->numa)
+			hint = sbitmap_node_hint(sb, numa_node_id(), depth);
+		else
+			hint = get_random_u32_below(depth);
 		this_cpu_write(*sb->alloc_hint, hint);
 	}
 
@@ -116,6 +167,7 @@ int sbitmap_init_node(struct sbitmap *sb, unsigned int depth, int shift,
 	sb->depth = depth;
 	sb->map_nr = DIV_ROUND_UP(sb->depth, bits_per_word);
 	sb->round_robin = round_robin;
+	sb->numa = false;
 
 	if (depth == 0) {
 		sb->map = NULL;
@@ -142,6 +194,21 @@ int sbitmap_init_node(struct sbitmap *sb, unsigned int depth, int shift,
 }
 EXPORT_SYMBOL_GPL(sbitmap_init_node);
 
+void sbitmap_set_numa(struct sbitmap *sb)
+{
+	int cpu;
+
+	if (nr_node_ids < 2 || sb->map_nr < nr_node_ids ||
+	    sb->round_robin || !sb->alloc_hint)
+		return;
+
+	sb->numa = true;
+	for_each_possible_cpu(cpu)
+		*per_cpu_ptr(sb->alloc_hint, cpu) =
+			sbitmap_node_hint(sb, cpu_to_node(cpu), sb->depth);
+}
+EXPORT_SYMBOL_GPL(sbitmap_set_numa);
+
 void sbitmap_resize(struct sbitmap *sb, unsigned int depth)
 {
 	unsigned int bits_per_word = 1U << sb->shift;
@@ -208,16 +275,26 @@ static int sbitmap_find_bit_in_word(struct sbitmap_word *map,
 	return nr;
 }
 
-static int sbitmap_find_bit(struct sbitmap *sb,
-			    unsigned int depth,
-			    unsigned int index,
-			    unsigned int alloc_hint,
-			    bool wrap)
-{
-	unsigned int i;
+/*
+ * Search the @nr_words words from @first on, wrapping around the end of
+ * the map, starting at @index.
+ */
+static int sbitmap_find_bit_range(struct sbitmap *sb,
+				  unsigned int depth,
+				  unsigned int first,
+				  unsigned int nr_words,
+				  unsigned int index,
+				  unsigned int alloc_hint,
+				  bool wrap)
+{
+	unsigned int i, off = index - first;
 	int nr = -1;
 
-	for (i = 0; i < sb->map_nr; i++) {
+	for (i = 0; i < nr_words; i++) {
+		index = first + off;
+		if (index >= sb->map_nr)
+			index -= sb->map_nr;
+
 		nr = sbitmap_find_bit_in_word(&sb->map[index],
 					      min_t(unsigned int,
 						    __map_depth(sb, index),
@@ -231,13 +308,37 @@ static int sbitmap_find_bit(struct sbitmap *sb,
 
 		/* Jump to next index. */
 		alloc_hint = 0;
-		if (++index >= sb->map_nr)
-			index = 0;
+		if (++off >= nr_words)
+			off = 0;
 	}
 
 	return nr;
 }
 
+static int sbitmap_find_bit(struct sbitmap *sb,
+			    unsigned int depth,
+			    unsigned int index,
+			    unsigned int alloc_hint,
+			    bool wrap)
+{
+	unsigned int first, nr_words, hint_index = index;
+	int nr;
+
+	nr_words = sbitmap_local_words(sb, &index, &first);
+	if (index != hint_index)
+		alloc_hint = 0;
+
+	nr = sbitmap_find_bit_range(sb, depth, first, nr_words, index,
+				    alloc_hint, wrap);
+	if (nr != -1 || nr_words == sb->map_nr)
+		return nr;
+
+	/* The node's words are full, take a bit from the other nodes */
+	first += nr_words;
+	return sbitmap_find_bit_range(sb, depth, first, sb->map_nr - nr_words,
+				      first, 0, wrap);
+}
+
 static int __sbitmap_get(struct sbitmap *sb, unsigned int alloc_hint)
 {
 	unsigned int index;
@@ -496,28 +597,28 @@ int __sbitmap_queue_get(struct sbitmap_queue *sbq)
 }
 EXPORT_SYMBOL_GPL(__sbitmap_queue_get);
 
-unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
-					unsigned int *offset)
+/* Like sbitmap_find_bit_range(), for __sbitmap_queue_get_batch() */
+static unsigned long sbitmap_get_batch_range(struct sbitmap *sb, int nr_tags,
+					     unsigned int first,
+					     unsigned int nr_words,
+					     unsigned int index,
+					     unsigned int *offset)
 {
-	struct sbitmap *sb = &sbq->sb;
-	unsigned int hint, depth;
-	unsigned long index, nr;
-	int i;
-
-	if (unlikely(sb->round_robin))
-		return 0;
+	unsigned int i, off = index - first;
+	unsigned long nr;
 
-	depth = READ_ONCE(sb->depth);
-	hint = update_alloc_hint_before_get(sb, depth);
-
-	index = SB_NR_TO_INDEX(sb, hint);
-
-	for (i = 0; i < sb->map_nr; i++) {
-		struct sbitmap_word *map = &sb->map[index];
+	for (i = 0; i < nr_words; i++) {
+		struct sbitmap_word *map;
 		unsigned long get_mask;
-		unsigned int map_depth = __map_depth(sb, index);
+		unsigned int map_depth;
 		unsigned long val;
 
+		index = first + off;
+		if (index >= sb->map_nr)
+			index -= sb->map_nr;
+		map = &sb->map[index];
+		map_depth = __map_depth(sb, index);
+
 		sbitmap_deferred_clear(map, 0, 0, 0);
 		val = READ_ONCE(map->word);
 		if (val == (1UL << (map_depth - 1)) - 1)
@@ -534,20 +635,49 @@ unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
 			get_mask = (get_mask & ~val) >> nr;
 			if (get_mask) {
 				*offset = nr + (index << sb->shift);
-				update_alloc_hint_after_get(sb, depth, hint,
-							*offset + nr_tags - 1);
 				return get_mask;
 			}
 		}
 next:
 		/* Jump to next index. */
-		if (++index >= sb->map_nr)
-			index = 0;
+		if (++off >= nr_words)
+			off = 0;
 	}
 
 	return 0;
 }
 
+unsigned long __sbitmap_queue_get_batch(struct sbitmap_queue *sbq, int nr_tags,
+					unsigned int *offset)
+{
+	struct sbitmap *sb = &sbq->sb;
+	unsigned int hint, depth, index, first, nr_words;
+	unsigned long mask;
+
+	if (unlikely(sb->round_robin))
+		return 0;
+
+	depth = READ_ONCE(sb->depth);
+	hint = update_alloc_hint_before_get(sb, depth);
+
+	index = SB_NR_TO_INDEX(sb, hint);
+	nr_words = sbitmap_local_words(sb, &index, &first);
+
+	mask = sbitmap_get_batch_range(sb, nr_tags, first, nr_words, index,
+				       offset);
+	if (!mask && nr_words != sb->map_nr) {
+		first += nr_words;
+		mask = sbitmap_get_batch_range(sb, nr_tags, first,
+					       sb->map_nr - nr_words, first,
+					       offset);
+	}
+
+	if (mask)
+		update_alloc_hint_after_get(sb, depth, hint,
+					    *offset + nr_tags - 1);
+	return mask;
+}
+
 int sbitmap_queue_get_shallow(struct sbitmap_queue *sbq,
 			      unsigned int shallow_depth)
 {
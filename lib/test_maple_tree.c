@@ -46,6 +46,7 @@ atomic_t maple_tree_tests_passed;
 /* #define BENCH_LOAD */
 /* #define BENCH_MT_FOR_EACH */
 /* #define BENCH_FORK */
+/* #define BENCH_FORK_SCALE */
 /* #define BENCH_MAS_FOR_EACH */
 /* #define BENCH_MAS_PREV */
 
@@ -1888,6 +1889,21 @@ static noinline void __init check_forking(void)
 	mas_for_each(&newmas, val, ULONG_MAX)
 		mas_store(&newmas, val);
 
+	/* Point every entry at a new value in place, as dup_mmap() does */
+	mas_set(&newmas, 0);
+	mas_for_each(&newmas, val, ULONG_MAX)
+		mas_replace_entry(&newmas, xa_mk_value(xa_to_value(val) + 1));
+
+	i = 0;
+	mas_set(&newmas, 0);
+	mas_for_each(&newmas, val, ULONG_MAX) {
+		MT_BUG_ON(&newmt, newmas.index != i * 10);
+		MT_BUG_ON(&newmt, newmas.last != i * 10 + 5);
+		MT_BUG_ON(&newmt, val != xa_mk_value(i + 1));
+		i++;
+	}
+	MT_BUG_ON(&newmt, i != nr_entries + 1);
+
 	mas_destroy(&newmas);
 	mas_destroy(&mas);
 	mt_validate(&newmt);
@@ -2045,6 +2061,59 @@ static noinline void __init bench_forking(void)
 }
 #endif
 
+#if defined(BENCH_FORK_SCALE)
+/*
+ * bench_forking_scale - dup_mmap() of a process with 100k vmas: duplicate
+ * the tree and point every entry at its copy.
+ */
+static noinline void __init bench_forking_scale(void)
+{
+	struct maple_tree mt, newmt;
+	int i, nr_entries = 100000, nr_fork = 1000, ret;
+	void *val;
+	MA_STATE(mas, &mt, 0, 0);
+	MA_STATE(newmas, &newmt, 0, 0);
+	struct rw_semaphore mt_lock, newmt_lock;
+
+	init_rwsem(&mt_lock);
+	init_rwsem(&newmt_lock);
+
+	mt_init_flags(&mt, MT_FLAGS_ALLOC_RANGE | MT_FLAGS_LOCK_EXTERN);
+	mt_set_external_lock(&mt, &mt_lock);
+
+	down_write(&mt_lock);
+	for (i = 0; i <= nr_entries; i++) {
+		mas_set_range(&mas, i * 10, i * 10 + 5);
+		mas_store_gfp(&mas, xa_mk_value(i), GFP_KERNEL);
+	}
+
+	for (i = 0; i < nr_fork; i++) {
+		mt_init_flags(&newmt,
+			      MT_FLAGS_ALLOC_RANGE | MT_FLAGS_LOCK_EXTERN);
+		mt_set_external_lock(&newmt, &newmt_lock);
+
+		down_write_nested(&newmt_lock, SINGLE_DEPTH_NESTING);
+		ret = __mt_dup(&mt, &newmt, GFP_KERNEL);
+		if (ret) {
+			pr_err("OOM!");
+			BUG_ON(1);
+		}
+
+		mas_set(&newmas, 0);
+		mas_for_each(&newmas, val, ULONG_MAX)
+			mas_replace_entry(&newmas, val);
+
+		mas_destroy(&newmas);
+		__mt_destroy(&newmt);
+		up_write(&newmt_lock);
+		cond_resched();
+	}
+	mas_destroy(&mas);
+	__mt_destroy(&mt);
+	up_write(&mt_lock);
+}
+#endif
+
 static noinline void __init next_prev_test(struct maple_tree *mt)
 {
 	int i, nr_entries;
@@ -3688,6 +3757,11 @@ static int __init maple_tree_seed(void)
 	bench_forking();
 	goto skip;
 #endif
+#if defined(BENCH_FORK_SCALE)
+#define BENCH
+	bench_forking_scale();
+	goto skip;
+#endif
 #if defined(BENCH_MT_FOR_EACH)
 #define BENCH
 	mt_init_flags(&tree, MT_FLAGS_ALLOC_RANGE);
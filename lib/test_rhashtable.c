@@ -55,6 +55,10 @@ static bool enomem_retry = false;
 module_param(enomem_retry, bool, 0);
 MODULE_PARM_DESC(enomem_retry, "Retry insert even if -ENOMEM was returned (default: off)");
 
+static int shards = 16;
+module_param(shards, int, 0);
+MODULE_PARM_DESC(shards, "Number of shards of the sharded table test (default: 16)");
+
 struct test_obj_val {
 	int	id;
 	int	tid;
@@ -679,6 +683,95 @@ static int threadfunc(void *data)
 	return err;
 }
 
+/* Lookup latency while the table grows from its initial size */
+struct growth_stats {
+	/* lookups by log2 of their latency in ns */
+	unsigned int hist[64];
+	unsigned int nr;
+	u64 max;
+};
+
+static void __init growth_lookup(struct growth_stats *gs, struct rhashtable *ht,
+				 struct rhashtable_sharded *sht,
+				 struct test_obj *array, unsigned int inserted)
+{
+	struct test_obj_val key = {
+		.id = array[get_random_u32_below(inserted)].value.id,
+	};
+	u64 start, delta;
+	void *obj;
+
+	start = ktime_get_ns();
+	if (sht)
+		obj = rhashtable_sharded_lookup_fast(sht, &key, test_rht_params);
+	else
+		obj = rhashtable_lookup_fast(ht, &key, test_rht_params);
+	delta = ktime_get_ns() - start;
+
+	if (WARN_ON_ONCE(!obj))
+		return;
+	gs->hist[delta ? ilog2(delta) : 0]++;
+	gs->nr++;
+	gs->max = max(gs->max, delta);
+}
+
+static int __init test_rhashtable_growth(struct test_obj *array,
+					 unsigned int entries, bool sharded)
+{
+	struct rhashtable_params params = test_rht_params;
+	struct rhashtable_sharded sht;
+	struct growth_stats gs = {};
+	unsigned int i, seen = 0;
+	int err = 0, order;
+
+	params.nelem_hint = 0;
+	params.max_size = roundup_pow_of_two(entries);
+	if (sharded)
+		err = rhashtable_sharded_init(&sht, &params, shards);
+	else
+		err = rhashtable_init(&ht, &params);
+	if (err)
+		return err;
+
+	for (i = 0; i < entries; i++) {
+		struct test_obj *obj = &array[i];
+
+		obj->value.id = i * 2;
+		do {
+			cond_resched();
+			if (sharded)
+				err = rhashtable_sharded_insert_fast(&sht,
+						&obj->node, test_rht_params);
+			else
+				err = rhashtable_insert_fast(&ht, &obj->node,
+						test_rht_params);
+		} while (err == -EBUSY);
+		if (err)
+			break;
+		if (i % 16 == 15)
+			growth_lookup(&gs, &ht, sharded ? &sht : NULL, array,
+				      i + 1);
+	}
+
+	if (sharded)
+		rhashtable_sharded_destroy(&sht);
+	else
+		rhashtable_destroy(&ht);
+	if (err)
+		return err;
+
+	/* Upper bound of the bucket holding the 99th percentile */
+	for (order = 0; order < ARRAY_SIZE(gs.hist); order++) {
+		seen += gs.hist[order];
+		if (seen >= gs.nr - gs.nr / 100)
+			break;
+	}
+	pr_info("  %s table growth to %u entries: %u lookups, p99 < %llu ns, max %llu ns\n",
+		sharded ? "sharded" : "plain", entries, gs.nr,
+		2ULL << order, gs.max);
+	return 0;
+}
+
 static int __init test_rht_init(void)
 {
 	unsigned int entries;
@@ -731,6 +824,14 @@ static int __init test_rht_init(void)
 	pr_info("test if its possible to exceed max_size %d: %s\n",
 			test_rht_params.max_size, test_rhashtable_max(objs, entries) == 0 ?
 			"no, ok" : "YES, failed");
+
+	pr_info("Testing lookup latency during growth, %d shards\n", shards);
+	for (i = 0; i < 2; i++) {
+		memset(objs, 0, entries * sizeof(struct test_obj));
+		err = test_rhashtable_growth(objs, entries, i);
+		if (err)
+			pr_warn("Test failed: growth test returns %d\n", err);
+	}
 	vfree(objs);
 
 	do_div(total_time, runs);
@@ -5,6 +5,9 @@
 #include <linux/sort.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/cpumask.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
 
 /* a simple boot-time regression test */
 
@@ -45,8 +48,127 @@ static void test_sort(struct kunit *test)
 		KUNIT_ASSERT_LE(test, a[i], a[i + 1]);
 }
 
+/* Inputs that are known to trip up naive quicksorts */
+static void fill_pattern(int *a, int n, int pattern)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		switch (pattern) {
+		case 0:		/* random */
+			a[i] = get_random_u32() >> 1;	/* cmpint() must not overflow */
+			break;
+		case 1:		/* sorted */
+			a[i] = i;
+			break;
+		case 2:		/* reversed */
+			a[i] = n - i;
+			break;
+		case 3:		/* all equal */
+			a[i] = 42;
+			break;
+		case 4:		/* organ pipe */
+			a[i] = i < n / 2 ? i : n - i;
+			break;
+		default:	/* few distinct keys */
+			a[i] = i % 7;
+			break;
+		}
+	}
+}
+
+#define TEST_PATTERNS 6
+
+KUNIT_DEFINE_ACTION_WRAPPER(kvfree_action, kvfree, const void *);
+
+/* The large arrays do not fit kunit_kmalloc_array() */
+static int *alloc_ints(struct kunit *test, size_t n)
+{
+	int *a = kvmalloc_array(n, sizeof(*a), GFP_KERNEL);
+
+	if (a && kunit_add_action_or_reset(test, kvfree_action, a))
+		return NULL;
+	return a;
+}
+
+static void test_introsort(struct kunit *test)
+{
+	static const int lens[] = { 0, 1, 2, 3, 16, 17, 129, TEST_LEN, 100003 };
+	int *a, i, j, p;
+
+	a = kunit_kmalloc_array(test, 100003, sizeof(*a), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, a);
+
+	for (p = 0; p < TEST_PATTERNS; p++) {
+		for (i = 0; i < ARRAY_SIZE(lens); i++) {
+			fill_pattern(a, lens[i], p);
+			introsort(a, lens[i], sizeof(*a), cmpint, NULL);
+			for (j = 0; j < lens[i] - 1; j++)
+				KUNIT_ASSERT_LE_MSG(test, a[j], a[j + 1],
+					"pattern %d, length %d", p, lens[i]);
+		}
+	}
+}
+
+#define TEST_PARALLEL_LEN (1 << 20)
+
+static void test_sort_parallel(struct kunit *test)
+{
+	int *a, i, p;
+
+	a = alloc_ints(test, TEST_PARALLEL_LEN);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, a);
+
+	for (p = 0; p < TEST_PATTERNS; p++) {
+		fill_pattern(a, TEST_PARALLEL_LEN, p);
+		sort_parallel(a, TEST_PARALLEL_LEN, sizeof(*a), cmpint,
+			      num_online_cpus());
+		for (i = 0; i < TEST_PARALLEL_LEN - 1; i++)
+			KUNIT_ASSERT_LE_MSG(test, a[i], a[i + 1],
+					    "pattern %d", p);
+	}
+}
+
+#define BENCH_LEN (1 << 22)
+
+/* Throughput of the sort variants on random ints, for comparison only */
+static void bench_sort(struct kunit *test)
+{
+	static const char * const names[] = {
+		"sort", "introsort", "sort_parallel"
+	};
+	int *a, *orig, variant;
+	u64 start, ns;
+
+	orig = alloc_ints(test, BENCH_LEN);
+	a = alloc_ints(test, BENCH_LEN);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, orig);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, a);
+	fill_pattern(orig, BENCH_LEN, 0);
+
+	for (variant = 0; variant < ARRAY_SIZE(names); variant++) {
+		memcpy(a, orig, BENCH_LEN * sizeof(*a));
+		start = ktime_get_ns();
+		if (variant == 0)
+			sort(a, BENCH_LEN, sizeof(*a), cmpint, NULL);
+		else if (variant == 1)
+			introsort(a, BENCH_LEN, sizeof(*a), cmpint, NULL);
+		else
+			sort_parallel(a, BENCH_LEN, sizeof(*a), cmpint,
+				      num_online_cpus());
+		ns = ktime_get_ns() - start;
+		kunit_info(test, "%s: %d ints in %llu us, %llu Mints/s\n",
+			   names[variant],
+			   BENCH_LEN, ns / NSEC_PER_USEC,
+			   ns ? BENCH_LEN * NSEC_PER_SEC / 1000000 / ns : 0);
+	}
+}
+
 static struct kunit_case sort_test_cases[] = {
 	KUNIT_CASE(test_sort),
+	KUNIT_CASE(test_introsort),
+	KUNIT_CASE(test_sort_parallel),
+	KUNIT_CASE_SLOW(bench_sort),
 	{}
 };
 
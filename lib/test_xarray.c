@@ -1783,6 +1783,152 @@ static noinline void check_store_range(struct xarray *xa)
 	}
 }
 
+#define XA_BATCH_MAX	(3 * XA_CHUNK_SIZE)
+
+static DEFINE_XARRAY(batch_ref);
+
+/*
+ * xa_store_batch() must leave the array as storing each entry in turn with
+ * xa_store() does, which is what @ref gets.  Every other entry is NULL if
+ * @holes is set.
+ */
+static noinline void __check_store_batch(struct xarray *xa, struct xarray *ref,
+		unsigned long first, unsigned int nr, bool holes)
+{
+	void *entries[XA_BATCH_MAX];
+	unsigned long lo = first > XA_CHUNK_SIZE ? first - XA_CHUNK_SIZE : 0;
+	unsigned long i;
+
+	for (i = 0; i < nr; i++) {
+		entries[i] = (holes && (i & 1)) ? NULL :
+				xa_mk_value((first + i) * 3 + 1);
+		XA_BUG_ON(ref, xa_is_err(xa_store(ref, first + i, entries[i],
+						GFP_KERNEL)));
+	}
+	XA_BUG_ON(xa, xa_store_batch(xa, first, entries, nr, GFP_KERNEL) != 0);
+
+	for (i = lo; i < first + nr + XA_CHUNK_SIZE; i++) {
+		XA_BUG_ON(xa, xa_load(xa, i) != xa_load(ref, i));
+		XA_BUG_ON(xa, xa_get_order(xa, i) != xa_get_order(ref, i));
+	}
+}
+
+static noinline void check_store_batch_1(struct xarray *xa,
+		unsigned long first, unsigned int nr)
+{
+	struct xarray *ref = &batch_ref;
+	unsigned long i;
+
+	/* Into an empty array */
+	__check_store_batch(xa, ref, first, nr, false);
+	xa_destroy(xa);
+	xa_destroy(ref);
+
+	/* Over existing entries, and erasing some of them */
+	for (i = first - min(first, 2UL); i < first + nr + 2; i++) {
+		xa_store_index(xa, i, GFP_KERNEL);
+		xa_store_index(ref, i, GFP_KERNEL);
+	}
+	__check_store_batch(xa, ref, first, nr, false);
+	__check_store_batch(xa, ref, first, nr, true);
+	xa_destroy(xa);
+	xa_destroy(ref);
+
+#ifdef CONFIG_XARRAY_MULTI
+	/* Over multi-index entries overlapping both ends of the run */
+	for (i = 1; i < 5; i++) {
+		unsigned long index = round_down(first, 1UL << i);
+
+		xa_store_order(xa, index, i, xa_mk_index(index), GFP_KERNEL);
+		xa_store_order(ref, index, i, xa_mk_index(index), GFP_KERNEL);
+		if (index + (1UL << i) <= first + nr) {
+			index = round_up(first + nr - 1, 1UL << i);
+			xa_store_order(xa, index, i, xa_mk_index(index),
+					GFP_KERNEL);
+			xa_store_order(ref, index, i, xa_mk_index(index),
+					GFP_KERNEL);
+		}
+		__check_store_batch(xa, ref, first, nr, i & 1);
+		xa_destroy(xa);
+		xa_destroy(ref);
+	}
+#endif
+
+	XA_BUG_ON(xa, !xa_empty(xa));
+	XA_BUG_ON(ref, !xa_empty(ref));
+}
+
+static noinline void check_store_batch(struct xarray *xa)
+{
+	void *entries[2] = { xa_mk_value(0), xa_mk_value(1) };
+	unsigned int nr;
+
+	for (nr = 1; nr <= XA_BATCH_MAX; nr += 7) {
+		check_store_batch_1(xa, 0, nr);
+		check_store_batch_1(xa, 1, nr);
+		check_store_batch_1(xa, XA_CHUNK_SIZE - 3, nr);
+		check_store_batch_1(xa, 4095, nr);
+		check_store_batch_1(xa, (1 << 24) + 5, nr);
+	}
+
+	XA_BUG_ON(xa, xa_store_batch(xa, 7, entries, 0, GFP_KERNEL) != 0);
+	XA_BUG_ON(xa, !xa_empty(xa));
+#ifndef __KERNEL__
+	/* The kernel does not fail GFP_NOWAIT allocations */
+	XA_BUG_ON(xa, xa_store_batch(xa, 0, entries, 2, GFP_NOWAIT) != -ENOMEM);
+	XA_BUG_ON(xa, xa_load(xa, 1) != NULL);
+	xa_destroy(xa);
+#endif
+	XA_BUG_ON(xa, !xa_empty(xa));
+}
+
+static noinline void check_erase_range(struct xarray *xa)
+{
+	unsigned long i;
+
+	XA_BUG_ON(xa, xa_erase_range(xa, 0, ULONG_MAX) != 0);
+
+	for (i = 0; i < 3 * XA_CHUNK_SIZE; i++)
+		xa_store_index(xa, i, GFP_KERNEL);
+	XA_BUG_ON(xa, xa_erase_range(xa, 5, 2 * XA_CHUNK_SIZE) !=
+			2 * XA_CHUNK_SIZE - 4);
+	for (i = 0; i < 3 * XA_CHUNK_SIZE; i++)
+		XA_BUG_ON(xa, xa_load(xa, i) !=
+			  ((i < 5 || i > 2 * XA_CHUNK_SIZE) ? xa_mk_index(i) : NULL));
+	XA_BUG_ON(xa, xa_erase_range(xa, 5, 2 * XA_CHUNK_SIZE) != 0);
+	XA_BUG_ON(xa, xa_erase_range(xa, 0, 0) != 1);
+	XA_BUG_ON(xa, xa_erase_range(xa, 0, ULONG_MAX) !=
+			XA_CHUNK_SIZE + 3);
+	XA_BUG_ON(xa, !xa_empty(xa));
+
+	/* More than XA_CHECK_SCHED entries, sparse and at the top */
+	for (i = 0; i < 3 * XA_CHECK_SCHED; i += 2)
+		xa_store_index(xa, i, GFP_KERNEL);
+	xa_store_index(xa, ULONG_MAX, GFP_KERNEL);
+	XA_BUG_ON(xa, xa_erase_range(xa, 1, ULONG_MAX) !=
+			3 * XA_CHECK_SCHED / 2);
+	XA_BUG_ON(xa, xa_load(xa, 0) != xa_mk_index(0));
+	xa_erase_index(xa, 0);
+	XA_BUG_ON(xa, !xa_empty(xa));
+
+#ifdef CONFIG_XARRAY_MULTI
+	/* A multi-index entry partly in the range is erased entirely */
+	xa_store_order(xa, 16, 3, xa_mk_index(16), GFP_KERNEL);
+	xa_store_index(xa, 24, GFP_KERNEL);
+	xa_store_index(xa, 31, GFP_KERNEL);
+	XA_BUG_ON(xa, xa_erase_range(xa, 20, 30) != 2);
+	for (i = 16; i < 24; i++)
+		XA_BUG_ON(xa, xa_load(xa, i) != NULL);
+	XA_BUG_ON(xa, xa_load(xa, 24) != NULL);
+	xa_erase_index(xa, 31);
+
+	xa_store_order(xa, 64, 6, xa_mk_index(64), GFP_KERNEL);
+	XA_BUG_ON(xa, xa_erase_range(xa, 0, 64) != 1);
+	XA_BUG_ON(xa, xa_load(xa, 127) != NULL);
+	XA_BUG_ON(xa, !xa_empty(xa));
+#endif
+}
+
 #ifdef CONFIG_XARRAY_MULTI
 static void check_split_1(struct xarray *xa, unsigned long index,
 				unsigned int order, unsigned int new_order)
@@ -2154,6 +2300,8 @@ static int xarray_checks(void)
 	check_move(&array);
 	check_create_range(&array);
 	check_store_range(&array);
+	check_store_batch(&array);
+	check_erase_range(&array);
 	check_store_iter(&array);
 	check_align(&xa0);
 	check_split(&array);
@@ -1600,6 +1600,100 @@ void *xa_store(struct xarray *xa, unsigned long index, void *entry, gfp_t gfp)
 }
 EXPORT_SYMBOL(xa_store);
 
+/**
+ * xa_store_batch() - Store entries at consecutive indices in the XArray.
+ * @xa: XArray.
+ * @first: Index of the first entry.
+ * @entries: Entries to store at @first, @first + 1, ...
+ * @nr: Number of entries.
+ * @gfp: Memory allocation flags.
+ *
+ * Works like xa_store() of each entry in turn, except that the tree is
+ * walked once for the whole run and the xa_lock is only dropped to
+ * allocate memory.  The previous entries are not returned.
+ *
+ * Context: Any context.  Takes and releases the xa_lock.
+ * May sleep if the @gfp flags permit.
+ * Return: 0 on success, -EINVAL if an entry cannot be stored in an XArray,
+ * or -ENOMEM if memory allocation failed, in which case only some of the
+ * entries may have been stored.
+ */
+int xa_store_batch(struct xarray *xa, unsigned long first, void **entries,
+		unsigned int nr, gfp_t gfp)
+{
+	XA_STATE(xas, xa, first);
+	unsigned int i;
+
+	for (i = 0; i < nr; i++)
+		if (WARN_ON_ONCE(xa_is_advanced(entries[i])))
+			return -EINVAL;
+
+	i = 0;
+	do {
+		xas_lock(&xas);
+		for (; i < nr; i++) {
+			void *entry = entries[i];
+
+			if (xa_track_free(xa) && !entry)
+				entry = XA_ZERO_ENTRY;
+			xas_store(&xas, entry);
+			if (xas_error(&xas))
+				break;
+			if (xa_track_free(xa))
+				xas_clear_mark(&xas, XA_FREE_MARK);
+			/*
+			 * Storing NULL may have freed the node, and the next
+			 * index may be in the middle of a multi-index entry.
+			 * Walk the tree again in both cases.
+			 */
+			if (i + 1 < nr &&
+			    (!entry || xa_is_sibling(xas_next(&xas))))
+				xas_set(&xas, first + i + 1);
+		}
+		xas_unlock(&xas);
+	} while (xas_nomem(&xas, gfp));
+
+	return xas_error(&xas);
+}
+EXPORT_SYMBOL(xa_store_batch);
+
+/**
+ * xa_erase_range() - Erase all entries in a range of indices.
+ * @xa: XArray.
+ * @first: First index to erase.
+ * @last: Last index to erase, inclusive.
+ *
+ * Works like xa_erase() of every present entry between @first and @last,
+ * in one walk of the tree.  A multi-index entry overlapping the range is
+ * erased entirely, as it would be by xa_erase().
+ *
+ * Context: Process context.  Takes and releases the xa_lock, and drops it
+ * every %XA_CHECK_SCHED entries to reschedule.
+ * Return: The number of entries erased.
+ */
+unsigned long xa_erase_range(struct xarray *xa, unsigned long first,
+		unsigned long last)
+{
+	XA_STATE(xas, xa, first);
+	unsigned long nr = 0;
+	void *entry;
+
+	xas_lock(&xas);
+	xas_for_each(&xas, entry, last) {
+		xas_store(&xas, NULL);
+		if (++nr % XA_CHECK_SCHED)
+			continue;
+		xas_pause(&xas);
+		xas_unlock(&xas);
+		cond_resched();
+		xas_lock(&xas);
+	}
+	xas_unlock(&xas);
+
+	return nr;
+}
+EXPORT_SYMBOL(xa_erase_range);
+
 /**
  * __xa_cmpxchg() - Store this entry in the XArray.
  * @xa: XArray.
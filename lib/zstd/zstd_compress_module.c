@@ -11,7 +11,9 @@
 
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/workqueue.h>
 #include <linux/zstd.h>
 
 #include "common/zstd_deps.h"
@@ -141,6 +143,109 @@ size_t zstd_compress_cctx(zstd_cctx *cctx, void *dst, size_t dst_capacity,
 }
 EXPORT_SYMBOL(zstd_compress_cctx);
 
+struct zstd_mt_job {
+	struct work_struct work;
+	const zstd_parameters *parameters;
+	const void *src;
+	size_t src_size;
+	void *dst;
+	size_t dst_capacity;
+	size_t ret;
+};
+
+static void zstd_mt_job_size(size_t src_size, unsigned int nr_workers,
+	size_t *job_size, unsigned int *nr_jobs)
+{
+	size_t size = DIV_ROUND_UP(src_size, max(nr_workers, 1U));
+
+	size = max_t(size_t, size, ZSTD_MT_MIN_JOB_SIZE);
+	*job_size = size;
+	*nr_jobs = src_size ? DIV_ROUND_UP(src_size, size) : 1;
+}
+
+static void zstd_mt_compress_job(struct work_struct *work)
+{
+	struct zstd_mt_job *job = container_of(work, struct zstd_mt_job, work);
+	size_t const ws_size =
+		zstd_cctx_workspace_bound(&job->parameters->cParams);
+	zstd_cctx *cctx;
+	void *ws;
+
+	ws = kvmalloc(ws_size, GFP_KERNEL);
+	cctx = zstd_init_cctx(ws, ws_size);
+	if (!cctx) {
+		job->ret = ERROR(memory_allocation);
+		goto out;
+	}
+	job->ret = zstd_compress_cctx(cctx, job->dst, job->dst_capacity,
+				      job->src, job->src_size, job->parameters);
+out:
+	kvfree(ws);
+}
+
+size_t zstd_compress_mt_bound(size_t src_size, unsigned int nr_workers)
+{
+	unsigned int nr_jobs;
+	size_t job_size;
+
+	zstd_mt_job_size(src_size, nr_workers, &job_size, &nr_jobs);
+	return ZSTD_compressBound(job_size) * nr_jobs;
+}
+EXPORT_SYMBOL(zstd_compress_mt_bound);
+
+size_t zstd_compress_mt(void *dst, size_t dst_capacity, const void *src,
+	size_t src_size, const zstd_parameters *parameters,
+	unsigned int nr_workers)
+{
+	struct zstd_mt_job *jobs;
+	unsigned int nr_jobs, i;
+	size_t job_size, ret = 0;
+
+	zstd_mt_job_size(src_size, nr_workers, &job_size, &nr_jobs);
+
+	jobs = kcalloc(nr_jobs, sizeof(*jobs), GFP_KERNEL);
+	if (!jobs)
+		return ERROR(memory_allocation);
+
+	for (i = 0; i < nr_jobs; i++) {
+		struct zstd_mt_job *job = &jobs[i];
+
+		INIT_WORK(&job->work, zstd_mt_compress_job);
+		job->parameters = parameters;
+		job->src = src + i * job_size;
+		job->src_size = min(job_size, src_size - i * job_size);
+		job->dst_capacity = ZSTD_compressBound(job->src_size);
+		job->dst = kvmalloc(job->dst_capacity, GFP_KERNEL);
+		job->ret = ERROR(memory_allocation);
+		/* The first job runs here, the others on the workqueue */
+		if (job->dst && i)
+			queue_work(system_unbound_wq, &job->work);
+	}
+
+	if (jobs[0].dst)
+		zstd_mt_compress_job(&jobs[0].work);
+
+	for (i = 0; i < nr_jobs; i++) {
+		struct zstd_mt_job *job = &jobs[i];
+
+		if (job->dst && i)
+			flush_work(&job->work);
+		if (!ZSTD_isError(ret) && ZSTD_isError(job->ret))
+			ret = job->ret;
+		if (!ZSTD_isError(ret) && job->ret > dst_capacity - ret)
+			ret = ERROR(dstSize_tooSmall);
+		if (!ZSTD_isError(ret)) {
+			memcpy(dst + ret, job->dst, job->ret);
+			ret += job->ret;
+		}
+		kvfree(job->dst);
+	}
+
+	kfree(jobs);
+	return ret;
+}
+EXPORT_SYMBOL(zstd_compress_mt);
+
 size_t zstd_compress_using_cdict(zstd_cctx *cctx, void *dst,
 	size_t dst_capacity, const void *src, size_t src_size,
 	const ZSTD_CDict *cdict)
@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit test for zstd_compress_mt(): the concatenated frames must
+ * decompress back to the input for any split into jobs.
+ */
+
+#include <kunit/test.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/zstd.h>
+
+#define ZSTD_MT_TEST_SIZE	(4 * ZSTD_MT_MIN_JOB_SIZE + 1234)
+/* Jobs of the minimum size have the largest bound */
+#define ZSTD_MT_TEST_JOBS	(ZSTD_MT_TEST_SIZE / ZSTD_MT_MIN_JOB_SIZE + 1)
+
+struct zstd_mt_test_ctx {
+	u8 *src;
+	u8 *dst;
+	size_t dst_size;
+	u8 *out;
+	void *dws;
+	zstd_dctx *dctx;
+};
+
+static int zstd_mt_test_init(struct kunit *test)
+{
+	struct zstd_mt_test_ctx *ctx;
+	size_t dws_size = zstd_dctx_workspace_bound();
+	size_t i;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->src = vmalloc(ZSTD_MT_TEST_SIZE);
+	ctx->dst_size = zstd_compress_mt_bound(ZSTD_MT_TEST_SIZE,
+					       ZSTD_MT_TEST_JOBS);
+	ctx->dst = vmalloc(ctx->dst_size);
+	ctx->out = vmalloc(ZSTD_MT_TEST_SIZE);
+	ctx->dws = kvmalloc(dws_size, GFP_KERNEL);
+	test->priv = ctx;
+	if (!ctx->src || !ctx->dst || !ctx->out || !ctx->dws)
+		return -ENOMEM;
+	ctx->dctx = zstd_init_dctx(ctx->dws, dws_size);
+	if (!ctx->dctx)
+		return -ENOMEM;
+
+	/* Compressible, but not so much that the jobs are trivial */
+	get_random_bytes(ctx->src, ZSTD_MT_TEST_SIZE);
+	for (i = 0; i < ZSTD_MT_TEST_SIZE; i++)
+		if (ctx->src[i] & 0x80)
+			ctx->src[i] = i % 7;
+	return 0;
+}
+
+static void zstd_mt_test_exit(struct kunit *test)
+{
+	struct zstd_mt_test_ctx *ctx = test->priv;
+
+	if (!ctx)
+		return;
+	vfree(ctx->src);
+	vfree(ctx->dst);
+	vfree(ctx->out);
+	kvfree(ctx->dws);
+}
+
+static void zstd_mt_check(struct kunit *test, size_t src_size,
+			  unsigned int nr_workers)
+{
+	struct zstd_mt_test_ctx *ctx = test->priv;
+	zstd_parameters params = zstd_get_params(3, src_size);
+	size_t bound = zstd_compress_mt_bound(src_size, nr_workers);
+	size_t csize, dsize;
+
+	KUNIT_ASSERT_LE(test, bound, ctx->dst_size);
+
+	csize = zstd_compress_mt(ctx->dst, bound, ctx->src, src_size, &params,
+				 nr_workers);
+	KUNIT_ASSERT_FALSE_MSG(test, zstd_is_error(csize),
+			       "size %zu workers %u: error %d", src_size,
+			       nr_workers, zstd_get_error_code(csize));
+
+	dsize = zstd_decompress_dctx(ctx->dctx, ctx->out, ZSTD_MT_TEST_SIZE,
+				     ctx->dst, csize);
+	KUNIT_ASSERT_FALSE(test, zstd_is_error(dsize));
+	KUNIT_EXPECT_EQ(test, dsize, src_size);
+	KUNIT_EXPECT_MEMEQ(test, ctx->out, ctx->src, src_size);
+
+	/* A destination buffer one byte short must be refused */
+	if (csize) {
+		csize = zstd_compress_mt(ctx->dst, csize - 1, ctx->src,
+					 src_size, &params, nr_workers);
+		KUNIT_EXPECT_TRUE(test, zstd_is_error(csize));
+	}
+}
+
+static void zstd_mt_roundtrip_test(struct kunit *test)
+{
+	static const size_t sizes[] = {
+		0, 1, 4096, ZSTD_MT_MIN_JOB_SIZE, ZSTD_MT_MIN_JOB_SIZE + 1,
+		3 * ZSTD_MT_MIN_JOB_SIZE - 1, ZSTD_MT_TEST_SIZE,
+	};
+	static const unsigned int workers[] = {
+		0, 1, 2, 3, ZSTD_MT_TEST_JOBS, 64,
+	};
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++)
+		for (j = 0; j < ARRAY_SIZE(workers); j++)
+			zstd_mt_check(test, sizes[i], workers[j]);
+}
+
+static struct kunit_case zstd_mt_test_cases[] = {
+	KUNIT_CASE(zstd_mt_roundtrip_test),
+	{}
+};
+
+static struct kunit_suite zstd_mt_test_suite = {
+	.name = "zstd_mt",
+	.init = zstd_mt_test_init,
+	.exit = zstd_mt_test_exit,
+	.test_cases = zstd_mt_test_cases,
+};
+
+kunit_test_suite(zstd_mt_test_suite);
+
+MODULE_DESCRIPTION("KUnit test for zstd_compress_mt()");
+MODULE_LICENSE("GPL");
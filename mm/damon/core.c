@@ -14,6 +14,7 @@
 #include <linux/psi.h>
 #include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/workqueue.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/damon.h>
@@ -636,6 +637,8 @@ int damon_set_attrs(struct damon_ctx *ctx, struct damon_attrs *attrs)
 		return -EINVAL;
 	if (attrs->sample_interval > attrs->aggr_interval)
 		return -EINVAL;
+	if (attrs->nr_sample_workers > DAMON_MAX_SAMPLE_WORKERS)
+		return -EINVAL;
 
 	ctx->next_aggregation_sis = ctx->passed_sample_intervals +
 		attrs->aggr_interval / sample_interval;
@@ -1971,6 +1974,96 @@ static void kdamond_init_intervals_sis(struct damon_ctx *ctx)
 /*
  * The monitoring daemon that runs as a kernel thread
  */
+/*
+ * Parallel access sampling
+ *
+ * Each worker checks one shard of the regions, and keeps its own max
+ * nr_accesses.  As a region belongs to only one shard, the regions are
+ * updated without locking, and the per-worker results are merged once all
+ * shards are done.
+ */
+struct damon_sample_work {
+	struct work_struct work;
+	struct damon_ctx *ctx;
+	unsigned int shard;
+	unsigned int nr_shards;
+	bool prepare;
+	unsigned int max_nr_accesses;
+};
+
+static void damon_sample_work_fn(struct work_struct *work)
+{
+	struct damon_sample_work *sw =
+		container_of(work, struct damon_sample_work, work);
+	struct damon_ctx *ctx = sw->ctx;
+
+	if (sw->prepare)
+		ctx->ops.prepare_access_checks_shard(ctx, sw->shard,
+				sw->nr_shards);
+	else
+		sw->max_nr_accesses = ctx->ops.check_accesses_shard(ctx,
+				sw->shard, sw->nr_shards);
+}
+
+static unsigned int kdamond_nr_sample_shards(struct damon_ctx *ctx)
+{
+	if (!ctx->sample_works || !ctx->ops.prepare_access_checks_shard ||
+			!ctx->ops.check_accesses_shard)
+		return 1;
+	return clamp_t(unsigned long, ctx->attrs.nr_sample_workers, 1,
+			DAMON_MAX_SAMPLE_WORKERS);
+}
+
+/* Run all shards, the first one on the kdamond itself */
+static unsigned int kdamond_run_sample_shards(struct damon_ctx *ctx,
+		unsigned int nr_shards, bool prepare)
+{
+	unsigned int i, max_nr_accesses = 0;
+
+	for (i = 0; i < nr_shards; i++) {
+		struct damon_sample_work *sw = &ctx->sample_works[i];
+
+		sw->ctx = ctx;
+		sw->shard = i;
+		sw->nr_shards = nr_shards;
+		sw->prepare = prepare;
+		sw->max_nr_accesses = 0;
+		INIT_WORK(&sw->work, damon_sample_work_fn);
+		if (i)
+			queue_work(system_unbound_wq, &sw->work);
+	}
+	damon_sample_work_fn(&ctx->sample_works[0].work);
+
+	for (i = 0; i < nr_shards; i++) {
+		if (i)
+			flush_work(&ctx->sample_works[i].work);
+		max_nr_accesses = max(max_nr_accesses,
+				ctx->sample_works[i].max_nr_accesses);
+	}
+	return max_nr_accesses;
+}
+
+static void kdamond_prepare_access_checks(struct damon_ctx *ctx)
+{
+	unsigned int nr_shards = kdamond_nr_sample_shards(ctx);
+
+	if (nr_shards > 1)
+		kdamond_run_sample_shards(ctx, nr_shards, true);
+	else if (ctx->ops.prepare_access_checks)
+		ctx->ops.prepare_access_checks(ctx);
+}
+
+static unsigned int kdamond_check_accesses(struct damon_ctx *ctx)
+{
+	unsigned int nr_shards = kdamond_nr_sample_shards(ctx);
+
+	if (nr_shards > 1)
+		return kdamond_run_sample_shards(ctx, nr_shards, false);
+	if (ctx->ops.check_accesses)
+		return ctx->ops.check_accesses(ctx);
+	return 0;
+}
+
 static int kdamond_fn(void *data)
 {
 	struct damon_ctx *ctx = data;
@@ -1992,6 +2085,9 @@ static int kdamond_fn(void *data)
 			sizeof(*ctx->regions_score_histogram), GFP_KERNEL);
 	if (!ctx->regions_score_histogram)
 		goto done;
+	/* Only an optimization, sample on the kdamond alone if this fails */
+	ctx->sample_works = kcalloc(DAMON_MAX_SAMPLE_WORKERS,
+			sizeof(*ctx->sample_works), GFP_KERNEL);
 
 	sz_limit = damon_region_sz_limit(ctx);
 
@@ -2010,8 +2106,7 @@ static int kdamond_fn(void *data)
 		if (kdamond_wait_activation(ctx))
 			break;
 
-		if (ctx->ops.prepare_access_checks)
-			ctx->ops.prepare_access_checks(ctx);
+		kdamond_prepare_access_checks(ctx);
 		if (ctx->callback.after_sampling &&
 				ctx->callback.after_sampling(ctx))
 			break;
@@ -2019,8 +2114,7 @@ static int kdamond_fn(void *data)
 		kdamond_usleep(sample_interval);
 		ctx->passed_sample_intervals++;
 
-		if (ctx->ops.check_accesses)
-			max_nr_accesses = ctx->ops.check_accesses(ctx);
+		max_nr_accesses = kdamond_check_accesses(ctx);
 
 		if (ctx->passed_sample_intervals >= next_aggregation_sis) {
 			kdamond_merge_regions(ctx,
@@ -2070,6 +2164,8 @@ static int kdamond_fn(void *data)
 	if (ctx->ops.cleanup)
 		ctx->ops.cleanup(ctx);
 	kfree(ctx->regions_score_histogram);
+	kfree(ctx->sample_works);
+	ctx->sample_works = NULL;
 
 	pr_debug("kdamond (%d) finishes\n", current->pid);
 	mutex_lock(&ctx->kdamond_lock);
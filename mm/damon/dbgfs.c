@@ -77,7 +77,7 @@ static ssize_t dbgfs_attrs_write(struct file *file,
 		const char __user *buf, size_t count, loff_t *ppos)
 {
 	struct damon_ctx *ctx = file->private_data;
-	struct damon_attrs attrs;
+	struct damon_attrs attrs = {};
 	char *kbuf;
 	ssize_t ret;
 
@@ -76,17 +76,43 @@ static void __damon_pa_prepare_access_check(struct damon_region *r)
 	damon_pa_mkold(r->sampling_addr);
 }
 
-static void damon_pa_prepare_access_checks(struct damon_ctx *ctx)
+/*
+ * There is usually a single target, so shards are contiguous ranges of each
+ * target's regions.  Contiguous, so that adjacent regions sharing a folio
+ * still hit the last check cache.
+ */
+static bool damon_pa_in_shard(struct damon_target *t, unsigned int idx,
+		unsigned int shard, unsigned int nr_shards)
+{
+	unsigned int per_shard;
+
+	if (nr_shards == 1)
+		return true;
+	per_shard = DIV_ROUND_UP(damon_nr_regions(t), nr_shards);
+	return idx / per_shard == shard;
+}
+
+static void damon_pa_prepare_access_checks_shard(struct damon_ctx *ctx,
+		unsigned int shard, unsigned int nr_shards)
 {
 	struct damon_target *t;
 	struct damon_region *r;
+	unsigned int i;
 
 	damon_for_each_target(t, ctx) {
-		damon_for_each_region(r, t)
-			__damon_pa_prepare_access_check(r);
+		i = 0;
+		damon_for_each_region(r, t) {
+			if (damon_pa_in_shard(t, i++, shard, nr_shards))
+				__damon_pa_prepare_access_check(r);
+		}
 	}
 }
 
+static void damon_pa_prepare_access_checks(struct damon_ctx *ctx)
+{
+	damon_pa_prepare_access_checks_shard(ctx, 0, 1);
+}
+
 static bool damon_folio_young_one(struct folio *folio,
 		struct vm_area_struct *vma, unsigned long addr, void *arg)
 {
@@ -162,35 +188,47 @@ static bool damon_pa_young(unsigned long paddr, unsigned long *folio_sz)
 	return accessed;
 }
 
+/* The result of the last access check, for reuse by the next region */
+struct damon_pa_last_check {
+	unsigned long addr;
+	unsigned long folio_sz;
+	bool accessed;
+};
+
 static void __damon_pa_check_access(struct damon_region *r,
-		struct damon_attrs *attrs)
+		struct damon_attrs *attrs, struct damon_pa_last_check *last)
 {
-	static unsigned long last_addr;
-	static unsigned long last_folio_sz = PAGE_SIZE;
-	static bool last_accessed;
-
 	/* If the region is in the last checked page, reuse the result */
-	if (ALIGN_DOWN(last_addr, last_folio_sz) ==
-				ALIGN_DOWN(r->sampling_addr, last_folio_sz)) {
-		damon_update_region_access_rate(r, last_accessed, attrs);
+	if (last->addr != -1UL && ALIGN_DOWN(last->addr, last->folio_sz) ==
+				ALIGN_DOWN(r->sampling_addr, last->folio_sz)) {
+		damon_update_region_access_rate(r, last->accessed, attrs);
 		return;
 	}
 
-	last_accessed = damon_pa_young(r->sampling_addr, &last_folio_sz);
-	damon_update_region_access_rate(r, last_accessed, attrs);
+	last->accessed = damon_pa_young(r->sampling_addr, &last->folio_sz);
+	damon_update_region_access_rate(r, last->accessed, attrs);
 
-	last_addr = r->sampling_addr;
+	last->addr = r->sampling_addr;
 }
 
-static unsigned int damon_pa_check_accesses(struct damon_ctx *ctx)
+static unsigned int damon_pa_check_accesses_shard(struct damon_ctx *ctx,
+		unsigned int shard, unsigned int nr_shards)
 {
+	struct damon_pa_last_check last = {
+		.addr = -1UL,
+		.folio_sz = PAGE_SIZE,
+	};
 	struct damon_target *t;
 	struct damon_region *r;
 	unsigned int max_nr_accesses = 0;
+	unsigned int i;
 
 	damon_for_each_target(t, ctx) {
+		i = 0;
 		damon_for_each_region(r, t) {
-			__damon_pa_check_access(r, &ctx->attrs);
+			if (!damon_pa_in_shard(t, i++, shard, nr_shards))
+				continue;
+			__damon_pa_check_access(r, &ctx->attrs, &last);
 			max_nr_accesses = max(r->nr_accesses, max_nr_accesses);
 		}
 	}
@@ -198,6 +236,11 @@ static unsigned int damon_pa_check_accesses(struct damon_ctx *ctx)
 	return max_nr_accesses;
 }
 
+static unsigned int damon_pa_check_accesses(struct damon_ctx *ctx)
+{
+	return damon_pa_check_accesses_shard(ctx, 0, 1);
+}
+
 static bool __damos_pa_filter_out(struct damos_filter *filter,
 		struct folio *folio)
 {
@@ -528,6 +571,8 @@ static int __init damon_pa_initcall(void)
 		.update = NULL,
 		.prepare_access_checks = damon_pa_prepare_access_checks,
 		.check_accesses = damon_pa_check_accesses,
+		.prepare_access_checks_shard = damon_pa_prepare_access_checks_shard,
+		.check_accesses_shard = damon_pa_check_accesses_shard,
 		.reset_aggregated = NULL,
 		.target_valid = NULL,
 		.cleanup = NULL,
@@ -414,13 +414,18 @@ static void __damon_va_prepare_access_check(struct mm_struct *mm,
 	damon_va_mkold(mm, r->sampling_addr);
 }
 
-static void damon_va_prepare_access_checks(struct damon_ctx *ctx)
+/* Shards are made of whole targets, for the mm lookups and the young cache */
+static void damon_va_prepare_access_checks_shard(struct damon_ctx *ctx,
+		unsigned int shard, unsigned int nr_shards)
 {
 	struct damon_target *t;
 	struct mm_struct *mm;
 	struct damon_region *r;
+	unsigned int i = 0;
 
 	damon_for_each_target(t, ctx) {
+		if (i++ % nr_shards != shard)
+			continue;
 		mm = damon_get_mm(t);
 		if (!mm)
 			continue;
@@ -430,6 +435,11 @@ static void damon_va_prepare_access_checks(struct damon_ctx *ctx)
 	}
 }
 
+static void damon_va_prepare_access_checks(struct damon_ctx *ctx)
+{
+	damon_va_prepare_access_checks_shard(ctx, 0, 1);
+}
+
 struct damon_young_walk_private {
 	/* size of the folio for the access checked virtual memory address */
 	unsigned long *folio_sz;
@@ -553,6 +563,13 @@ static bool damon_va_young(struct mm_struct *mm, unsigned long addr,
 	return arg.young;
 }
 
+/* The result of the last access check, for reuse by the next region */
+struct damon_va_last_check {
+	unsigned long addr;
+	unsigned long folio_sz;
+	bool accessed;
+};
+
 /*
  * Check whether the region was accessed after the last preparation
  *
@@ -561,44 +578,46 @@ static bool damon_va_young(struct mm_struct *mm, unsigned long addr,
  */
 static void __damon_va_check_access(struct mm_struct *mm,
 				struct damon_region *r, bool same_target,
-				struct damon_attrs *attrs)
+				struct damon_attrs *attrs,
+				struct damon_va_last_check *last)
 {
-	static unsigned long last_addr;
-	static unsigned long last_folio_sz = PAGE_SIZE;
-	static bool last_accessed;
-
 	if (!mm) {
 		damon_update_region_access_rate(r, false, attrs);
 		return;
 	}
 
 	/* If the region is in the last checked page, reuse the result */
-	if (same_target && (ALIGN_DOWN(last_addr, last_folio_sz) ==
-				ALIGN_DOWN(r->sampling_addr, last_folio_sz))) {
-		damon_update_region_access_rate(r, last_accessed, attrs);
+	if (same_target && (ALIGN_DOWN(last->addr, last->folio_sz) ==
+				ALIGN_DOWN(r->sampling_addr, last->folio_sz))) {
+		damon_update_region_access_rate(r, last->accessed, attrs);
 		return;
 	}
 
-	last_accessed = damon_va_young(mm, r->sampling_addr, &last_folio_sz);
-	damon_update_region_access_rate(r, last_accessed, attrs);
+	last->accessed = damon_va_young(mm, r->sampling_addr, &last->folio_sz);
+	damon_update_region_access_rate(r, last->accessed, attrs);
 
-	last_addr = r->sampling_addr;
+	last->addr = r->sampling_addr;
 }
 
-static unsigned int damon_va_check_accesses(struct damon_ctx *ctx)
+static unsigned int damon_va_check_accesses_shard(struct damon_ctx *ctx,
+		unsigned int shard, unsigned int nr_shards)
 {
+	struct damon_va_last_check last = { .folio_sz = PAGE_SIZE };
 	struct damon_target *t;
 	struct mm_struct *mm;
 	struct damon_region *r;
 	unsigned int max_nr_accesses = 0;
+	unsigned int i = 0;
 	bool same_target;
 
 	damon_for_each_target(t, ctx) {
+		if (i++ % nr_shards != shard)
+			continue;
 		mm = damon_get_mm(t);
 		same_target = false;
 		damon_for_each_region(r, t) {
 			__damon_va_check_access(mm, r, same_target,
-					&ctx->attrs);
+					&ctx->attrs, &last);
 			max_nr_accesses = max(r->nr_accesses, max_nr_accesses);
 			same_target = true;
 		}
@@ -609,6 +628,11 @@ static unsigned int damon_va_check_accesses(struct damon_ctx *ctx)
 	return max_nr_accesses;
 }
 
+static unsigned int damon_va_check_accesses(struct damon_ctx *ctx)
+{
+	return damon_va_check_accesses_shard(ctx, 0, 1);
+}
+
 /*
  * Functions for the target validity check and cleanup
  */
@@ -709,6 +733,8 @@ static int __init damon_va_initcall(void)
 		.update = damon_va_update,
 		.prepare_access_checks = damon_va_prepare_access_checks,
 		.check_accesses = damon_va_check_accesses,
+		.prepare_access_checks_shard = damon_va_prepare_access_checks_shard,
+		.check_accesses_shard = damon_va_check_accesses_shard,
 		.reset_aggregated = NULL,
 		.target_valid = damon_va_target_valid,
 		.cleanup = NULL,
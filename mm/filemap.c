@@ -991,6 +991,107 @@ int filemap_add_folio(struct address_space *mapping, struct folio *folio,
 }
 EXPORT_SYMBOL_GPL(filemap_add_folio);
 
+/**
+ * filemap_add_folios - Add a run of new folios to the page cache.
+ * @mapping: The address_space to add to.
+ * @fbatch: The folios, not yet locked, charged or in any page cache.
+ * @index: The index of the first folio.
+ * @gfp: Memory allocation flags.
+ *
+ * The folios are inserted back to back from @index, with a single memcg
+ * charge for the batch and the i_pages lock taken once rather than once
+ * per folio.  Insertion stops at the first index that is already populated,
+ * or whose shadow entry would have to be split.  The folios that were not
+ * added are left as they were passed in, for the caller to free or to add
+ * one by one with filemap_add_folio().
+ *
+ * Return: The number of folios added, from the start of @fbatch.
+ */
+unsigned int filemap_add_folios(struct address_space *mapping,
+		struct folio_batch *fbatch, pgoff_t index, gfp_t gfp)
+{
+	XA_STATE(xas, &mapping->i_pages, index);
+	void *shadows[PAGEVEC_SIZE] = { NULL, };
+	unsigned int count = folio_batch_count(fbatch);
+	unsigned int i, added;
+
+	if (!count || mem_cgroup_charge_folios(fbatch, NULL, gfp))
+		return 0;
+
+	mapping_set_update(&xas, mapping);
+	for (i = 0; i < count; i++) {
+		struct folio *folio = fbatch->folios[i];
+
+		VM_BUG_ON_FOLIO(folio_test_swapbacked(folio), folio);
+		VM_BUG_ON_FOLIO(folio_test_hugetlb(folio), folio);
+		VM_BUG_ON_FOLIO(folio_order(folio) <
+				mapping_min_folio_order(mapping), folio);
+		VM_BUG_ON_FOLIO(index & (folio_nr_pages(folio) - 1), folio);
+
+		__folio_set_locked(folio);
+		folio_ref_add(folio, folio_nr_pages(folio));
+		folio->mapping = mapping;
+		folio->index = index;
+		index += folio_nr_pages(folio);
+	}
+
+	added = 0;
+	do {
+		xas_lock_irq(&xas);
+		for (; added < count; added++) {
+			struct folio *folio = fbatch->folios[added];
+			void *entry, *old = NULL;
+			bool conflict = false;
+
+			xas_set_order(&xas, folio->index, folio_order(folio));
+			xas_for_each_conflict(&xas, entry) {
+				if (!xa_is_value(entry) ||
+				    xas_get_order(&xas) > folio_order(folio)) {
+					conflict = true;
+					break;
+				}
+				old = entry;
+			}
+			if (conflict)
+				break;
+
+			xas_store(&xas, folio);
+			if (xas_error(&xas))
+				break;
+
+			shadows[added] = old;
+			mapping->nrpages += folio_nr_pages(folio);
+			__lruvec_stat_mod_folio(folio, NR_FILE_PAGES,
+						folio_nr_pages(folio));
+			if (folio_test_pmd_mappable(folio))
+				__lruvec_stat_mod_folio(folio, NR_FILE_THPS,
+							folio_nr_pages(folio));
+		}
+		xas_unlock_irq(&xas);
+	} while (added < count && xas_nomem(&xas, gfp & GFP_RECLAIM_MASK));
+
+	for (i = 0; i < count; i++) {
+		struct folio *folio = fbatch->folios[i];
+
+		if (i >= added) {
+			folio->mapping = NULL;
+			folio_put_refs(folio, folio_nr_pages(folio));
+			mem_cgroup_uncharge(folio);
+			__folio_clear_locked(folio);
+			continue;
+		}
+
+		trace_mm_filemap_add_to_page_cache(folio);
+		/* See filemap_add_folio() */
+		WARN_ON_ONCE(folio_test_active(folio));
+		if (!(gfp & __GFP_WRITE) && shadows[i])
+			workingset_refault(folio, shadows[i]);
+		folio_add_lru(folio);
+	}
+
+	return added;
+}
+
 #ifdef CONFIG_NUMA
 struct folio *filemap_alloc_folio_noprof(gfp_t gfp, unsigned int order)
 {
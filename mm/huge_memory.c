@@ -608,6 +608,7 @@ DEFINE_MTHP_STAT_ATTR(shmem_alloc, MTHP_STAT_SHMEM_ALLOC);
 DEFINE_MTHP_STAT_ATTR(shmem_fallback, MTHP_STAT_SHMEM_FALLBACK);
 DEFINE_MTHP_STAT_ATTR(shmem_fallback_charge, MTHP_STAT_SHMEM_FALLBACK_CHARGE);
 #endif
+DEFINE_MTHP_STAT_ATTR(file_ra_alloc, MTHP_STAT_FILE_RA_ALLOC);
 DEFINE_MTHP_STAT_ATTR(split, MTHP_STAT_SPLIT);
 DEFINE_MTHP_STAT_ATTR(split_failed, MTHP_STAT_SPLIT_FAILED);
 DEFINE_MTHP_STAT_ATTR(split_deferred, MTHP_STAT_SPLIT_DEFERRED);
@@ -639,6 +640,7 @@ static struct attribute *file_stats_attrs[] = {
 	&shmem_fallback_attr.attr,
 	&shmem_fallback_charge_attr.attr,
 #endif
+	&file_ra_alloc_attr.attr,
 	NULL,
 };
 
@@ -15,6 +15,7 @@
 #include <linux/bootmem_info.h>
 #include <linux/mmdebug.h>
 #include <linux/pagewalk.h>
+#include <linux/padata.h>
 #include <asm/pgalloc.h>
 #include <asm/tlbflush.h>
 #include "hugetlb_vmemmap.h"
@@ -497,6 +498,103 @@ int hugetlb_vmemmap_restore_folio(const struct hstate *h, struct folio *folio)
 	return __hugetlb_vmemmap_restore_folio(h, folio, VMEMMAP_SYNCHRONIZE_RCU);
 }
 
+/*
+ * Restoring vmemmap of large batches is split across threads, in chunks of
+ * at least this many vmemmap pages.
+ */
+#define VMEMMAP_RESTORE_MT_CHUNK_PAGES	4096
+
+struct vmemmap_restore_mt {
+	const struct hstate	*h;
+	struct folio		**folios;
+	/* first error, which stops all threads like it stops the serial loop */
+	atomic_t		err;
+};
+
+static void vmemmap_restore_folios_mt_fn(unsigned long start,
+					 unsigned long end, void *arg)
+{
+	struct vmemmap_restore_mt *mt = arg;
+	int ret;
+
+	for (; start < end; start++) {
+		if (atomic_read(&mt->err))
+			return;
+
+		ret = __hugetlb_vmemmap_restore_folio(mt->h, mt->folios[start],
+						      VMEMMAP_REMAP_NO_TLB_FLUSH);
+		if (ret) {
+			atomic_cmpxchg(&mt->err, 0, ret);
+			return;
+		}
+		cond_resched();
+	}
+}
+
+/*
+ * Restore vmemmap of the @nr optimized folios on @folio_list with
+ * padata_do_multithreaded(), setting @ret as hugetlb_vmemmap_restore_folios()
+ * returns.  Returns false without doing anything if the batch is too small
+ * to be worth it, or can't be set up.
+ */
+static bool hugetlb_vmemmap_restore_folios_mt(const struct hstate *h,
+					      struct list_head *folio_list,
+					      struct list_head *non_hvo_folios,
+					      unsigned long nr, long *ret)
+{
+	unsigned long chunk = max(VMEMMAP_RESTORE_MT_CHUNK_PAGES /
+				  (hugetlb_vmemmap_size(h) >> PAGE_SHIFT), 1UL);
+	struct vmemmap_restore_mt mt = {
+		.h	= h,
+		.err	= ATOMIC_INIT(0),
+	};
+	struct padata_mt_job job = {
+		.thread_fn	= vmemmap_restore_folios_mt_fn,
+		.fn_arg		= &mt,
+		.start		= 0,
+		.size		= nr,
+		.align		= 1,
+		.min_chunk	= chunk,
+		/* Same as hugetlb_pages_alloc_boot() */
+		.max_threads	= num_node_state(N_MEMORY) * 2,
+		.numa_aware	= true,
+	};
+	struct folio *folio, *t_folio;
+	long restored = 0;
+	unsigned long i = 0;
+
+	if (nr <= chunk)
+		return false;
+
+	mt.folios = kvmalloc_array(nr, sizeof(*mt.folios),
+				   GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+	if (!mt.folios)
+		return false;
+
+	list_for_each_entry(folio, folio_list, lru)
+		if (folio_test_hugetlb_vmemmap_optimized(folio))
+			mt.folios[i++] = folio;
+
+	/* The threads don't synchronize_rcu(), once is enough for all */
+	synchronize_rcu();
+	padata_do_multithreaded(&job);
+
+	for (i = 0; i < nr; i++)
+		if (!folio_test_hugetlb_vmemmap_optimized(mt.folios[i]))
+			restored++;
+	kvfree(mt.folios);
+
+	/* Failed or skipped folios stay behind on folio_list */
+	list_for_each_entry_safe(folio, t_folio, folio_list, lru)
+		if (!folio_test_hugetlb_vmemmap_optimized(folio))
+			list_move(&folio->lru, non_hvo_folios);
+
+	if (restored)
+		flush_tlb_all();
+	*ret = atomic_read(&mt.err) ?: restored;
+	return true;
+}
+
 /**
  * hugetlb_vmemmap_restore_folios - restore vmemmap for every folio on the list.
  * @h:			hstate.
@@ -508,7 +606,9 @@ int hugetlb_vmemmap_restore_folio(const struct hstate *h, struct folio *folio)
  *		Folios that have vmemmap are moved to the non_hvo_folios
  *		list.  Processing of entries stops when the first error is
  *		encountered. The folio that experienced the error and all
- *		non-processed folios will remain on folio_list.
+ *		non-processed folios will remain on folio_list.  Large lists
+ *		are processed by multiple threads, so the folios restored
+ *		before the error are not necessarily the first ones.
  */
 long hugetlb_vmemmap_restore_folios(const struct hstate *h,
 					struct list_head *folio_list,
@@ -518,6 +618,15 @@ long hugetlb_vmemmap_restore_folios(const struct hstate *h,
 	long restored = 0;
 	long ret = 0;
 	unsigned long flags = VMEMMAP_REMAP_NO_TLB_FLUSH | VMEMMAP_SYNCHRONIZE_RCU;
+	unsigned long nr = 0;
+
+	list_for_each_entry(folio, folio_list, lru)
+		if (folio_test_hugetlb_vmemmap_optimized(folio))
+			nr++;
+
+	if (hugetlb_vmemmap_restore_folios_mt(h, folio_list, non_hvo_folios,
+					      nr, &ret))
+		return ret;
 
 	list_for_each_entry_safe(folio, t_folio, folio_list, lru) {
 		if (folio_test_hugetlb_vmemmap_optimized(folio)) {
@@ -1221,6 +1221,14 @@ struct migration_target_control {
 	enum migrate_reason reason;
 };
 
+/*
+ * mm/migrate_copy.c
+ */
+bool migrate_copy_enabled(void);
+bool migrate_copy_folios(struct list_head *src_folios,
+			 struct list_head *dst_folios, unsigned long *copied,
+			 unsigned int nr, unsigned int nr_pages);
+
 /*
  * mm/filemap.c
  */
@@ -1409,6 +1417,22 @@ void __meminit __init_single_page(struct page *page, unsigned long pfn,
 unsigned long shrink_slab(gfp_t gfp_mask, int nid, struct mem_cgroup *memcg,
 			  int priority);
 
+struct shrink_slab_batch {
+	gfp_t gfp_mask;
+	int nid;
+	int priority;
+	unsigned int nr_workers;
+	atomic_t pending;
+	atomic_long_t freed;
+	atomic_long_t reclaimed;
+};
+
+void shrink_slab_batch_init(struct shrink_slab_batch *batch, gfp_t gfp_mask,
+			    int nid, int priority);
+void shrink_slab_batch_add(struct shrink_slab_batch *batch,
+			   struct mem_cgroup *memcg);
+unsigned long shrink_slab_batch_finish(struct shrink_slab_batch *batch);
+
 #ifdef CONFIG_64BIT
 static inline int can_do_mseal(unsigned long flags)
 {
@@ -1445,6 +1469,8 @@ extern struct dentry *shrinker_debugfs_detach(struct shrinker *shrinker,
 					      int *debugfs_id);
 extern void shrinker_debugfs_remove(struct dentry *debugfs_entry,
 				    int debugfs_id);
+extern void shrinker_debugfs_record_latency(struct shrinker *shrinker,
+					    u64 start);
 #else /* CONFIG_SHRINKER_DEBUG */
 static inline int shrinker_debugfs_add(struct shrinker *shrinker)
 {
@@ -1468,6 +1494,10 @@ static inline void shrinker_debugfs_remove(struct dentry *debugfs_entry,
 					   int debugfs_id)
 {
 }
+static inline void shrinker_debugfs_record_latency(struct shrinker *shrinker,
+						   u64 start)
+{
+}
 #endif /* CONFIG_SHRINKER_DEBUG */
 
 /* Only track the nodes of mappings with shadow entries */
@@ -65,12 +65,16 @@ enum scan_result {
 #define CREATE_TRACE_POINTS
 #include <trace/events/huge_memory.h>
 
-static struct task_struct *khugepaged_thread __read_mostly;
+#define KHUGEPAGED_MAX_WORKERS	16
+
+/* Protected by khugepaged_mutex */
+static struct task_struct *khugepaged_threads[KHUGEPAGED_MAX_WORKERS];
+static unsigned int khugepaged_nr_workers = 1;
 static DEFINE_MUTEX(khugepaged_mutex);
 
 /* default scan 8*512 pte (or vmas) every 30 second */
 static unsigned int khugepaged_pages_to_scan __read_mostly;
-static unsigned int khugepaged_pages_collapsed;
+static atomic_t khugepaged_pages_collapsed;
 static unsigned int khugepaged_full_scans;
 static unsigned int khugepaged_scan_sleep_millisecs __read_mostly = 10000;
 /* during fragmentation poll the hugepage allocator once every minute */
@@ -107,23 +111,33 @@ struct collapse_control {
 /**
  * struct khugepaged_mm_slot - khugepaged information per mm that is being scanned
  * @slot: hash lookup from mm to mm_slot
+ * @address: the next address inside that to be scanned
+ * @scanning: a khugepaged worker is scanning this mm
+ * @skipped: number of times a hotter mm was picked instead of this one
+ * @anon_rss: anon RSS of the mm when its last full scan completed
  */
 struct khugepaged_mm_slot {
 	struct mm_slot slot;
+	unsigned long address;
+	bool scanning;
+	unsigned int skipped;
+	unsigned long anon_rss;
 };
 
 /**
- * struct khugepaged_scan - cursor for scanning
+ * struct khugepaged_scan - the queue of mms to scan
  * @mm_head: the head of the mm list to scan
- * @mm_slot: the current mm_slot we are scanning
- * @address: the next address inside that to be scanned
+ * @nr_slots: number of mms on @mm_head
+ * @nr_pass_left: number of mm scans left to complete the current full scan
  *
- * There is only the one khugepaged_scan instance of this cursor structure.
+ * The khugepaged workers pick the mm to scan next among the first few idle
+ * ones on @mm_head, preferring the mm that faulted in the most anon memory
+ * since it was last scanned. An mm is moved to the tail once scanned fully.
  */
 struct khugepaged_scan {
 	struct list_head mm_head;
-	struct khugepaged_mm_slot *mm_slot;
-	unsigned long address;
+	unsigned int nr_slots;
+	unsigned int nr_pass_left;
 };
 
 static struct khugepaged_scan khugepaged_scan = {
@@ -213,7 +227,7 @@ static ssize_t pages_collapsed_show(struct kobject *kobj,
 				    struct kobj_attribute *attr,
 				    char *buf)
 {
-	return sysfs_emit(buf, "%u\n", khugepaged_pages_collapsed);
+	return sysfs_emit(buf, "%u\n", atomic_read(&khugepaged_pages_collapsed));
 }
 static struct kobj_attribute pages_collapsed_attr =
 	__ATTR_RO(pages_collapsed);
@@ -227,6 +241,36 @@ static ssize_t full_scans_show(struct kobject *kobj,
 static struct kobj_attribute full_scans_attr =
 	__ATTR_RO(full_scans);
 
+static ssize_t nr_workers_show(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(khugepaged_nr_workers));
+}
+static ssize_t nr_workers_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned int nr;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr);
+	if (err || !nr || nr > KHUGEPAGED_MAX_WORKERS)
+		return -EINVAL;
+
+	mutex_lock(&khugepaged_mutex);
+	WRITE_ONCE(khugepaged_nr_workers, nr);
+	mutex_unlock(&khugepaged_mutex);
+
+	err = start_stop_khugepaged();
+	if (err)
+		return err;
+
+	return count;
+}
+static struct kobj_attribute nr_workers_attr =
+	__ATTR_RW(nr_workers);
+
 static ssize_t defrag_show(struct kobject *kobj,
 			   struct kobj_attribute *attr, char *buf)
 {
@@ -335,6 +379,7 @@ static struct attribute *khugepaged_attr[] = {
 	&pages_to_scan_attr.attr,
 	&pages_collapsed_attr.attr,
 	&full_scans_attr.attr,
+	&nr_workers_attr.attr,
 	&scan_sleep_millisecs_attr.attr,
 	&alloc_sleep_millisecs_attr.attr,
 	NULL,
@@ -433,6 +478,15 @@ static bool hugepage_pmd_enabled(void)
 	return false;
 }
 
+static void khugepaged_scan_del_slot(void)
+{
+	lockdep_assert_held(&khugepaged_mm_lock);
+
+	khugepaged_scan.nr_slots--;
+	khugepaged_scan.nr_pass_left = min(khugepaged_scan.nr_pass_left,
+					   khugepaged_scan.nr_slots);
+}
+
 void __khugepaged_enter(struct mm_struct *mm)
 {
 	struct khugepaged_mm_slot *mm_slot;
@@ -458,6 +512,7 @@ void __khugepaged_enter(struct mm_struct *mm)
 	 */
 	wakeup = list_empty(&khugepaged_scan.mm_head);
 	list_add_tail(&slot->mm_node, &khugepaged_scan.mm_head);
+	khugepaged_scan.nr_slots++;
 	spin_unlock(&khugepaged_mm_lock);
 
 	mmgrab(mm);
@@ -485,9 +540,10 @@ void __khugepaged_exit(struct mm_struct *mm)
 	spin_lock(&khugepaged_mm_lock);
 	slot = mm_slot_lookup(mm_slots_hash, mm);
 	mm_slot = mm_slot_entry(slot, struct khugepaged_mm_slot, slot);
-	if (mm_slot && khugepaged_scan.mm_slot != mm_slot) {
+	if (mm_slot && !mm_slot->scanning) {
 		hash_del(&slot->hash);
 		list_del(&slot->mm_node);
+		khugepaged_scan_del_slot();
 		free = 1;
 	}
 	spin_unlock(&khugepaged_mm_lock);
@@ -1441,6 +1497,7 @@ static void collect_mm_slot(struct khugepaged_mm_slot *mm_slot)
 		/* free mm_slot */
 		hash_del(&slot->hash);
 		list_del(&slot->mm_node);
+		khugepaged_scan_del_slot();
 
 		/*
 		 * Not strictly needed because the mm exited already.
@@ -2330,14 +2387,72 @@ static int hpage_collapse_scan_file(struct mm_struct *mm, unsigned long addr,
 }
 #endif
 
-static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
+/* Anon memory faulted in since the last full scan of the mm */
+static unsigned long khugepaged_mm_hotness(struct khugepaged_mm_slot *mm_slot)
+{
+	unsigned long rss = get_mm_counter(mm_slot->slot.mm, MM_ANONPAGES);
+
+	return rss > mm_slot->anon_rss ? rss - mm_slot->anon_rss : 0;
+}
+
+/*
+ * Number of idle mms at the front of the queue to choose the hottest from.
+ * The mm at the very front is picked anyway once it has been passed over
+ * that many times, so that a cold mm is delayed but never starved.
+ */
+#define KHUGEPAGED_PICK_WINDOW	16
+
+static struct khugepaged_mm_slot *khugepaged_pick_mm_slot(void)
+{
+	struct khugepaged_mm_slot *mm_slot, *first = NULL, *best = NULL;
+	unsigned long hotness, best_hotness = 0;
+	unsigned int window = KHUGEPAGED_PICK_WINDOW;
+	struct mm_slot *slot;
+
+	lockdep_assert_held(&khugepaged_mm_lock);
+
+	list_for_each_entry(slot, &khugepaged_scan.mm_head, mm_node) {
+		mm_slot = mm_slot_entry(slot, struct khugepaged_mm_slot, slot);
+		if (mm_slot->scanning)
+			continue;
+
+		if (!first) {
+			first = mm_slot;
+			if (first->skipped >= KHUGEPAGED_PICK_WINDOW) {
+				best = first;
+				break;
+			}
+		}
+
+		hotness = khugepaged_mm_hotness(mm_slot);
+		if (!best || hotness > best_hotness) {
+			best = mm_slot;
+			best_hotness = hotness;
+		}
+
+		if (!--window)
+			break;
+	}
+
+	if (!best)
+		return NULL;
+
+	if (best != first)
+		first->skipped++;
+	best->skipped = 0;
+	best->scanning = true;
+
+	return best;
+}
+
+static unsigned int khugepaged_scan_mm_slot(struct khugepaged_mm_slot *mm_slot,
+					    unsigned int pages, int *result,
 					    struct collapse_control *cc)
 	__releases(&khugepaged_mm_lock)
 	__acquires(&khugepaged_mm_lock)
 {
+	struct mm_slot *slot = &mm_slot->slot;
 	struct vma_iterator vmi;
-	struct khugepaged_mm_slot *mm_slot;
-	struct mm_slot *slot;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
 	int progress = 0;
@@ -2346,16 +2461,6 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 	lockdep_assert_held(&khugepaged_mm_lock);
 	*result = SCAN_FAIL;
 
-	if (khugepaged_scan.mm_slot) {
-		mm_slot = khugepaged_scan.mm_slot;
-		slot = &mm_slot->slot;
-	} else {
-		slot = list_entry(khugepaged_scan.mm_head.next,
-				     struct mm_slot, mm_node);
-		mm_slot = mm_slot_entry(slot, struct khugepaged_mm_slot, slot);
-		khugepaged_scan.address = 0;
-		khugepaged_scan.mm_slot = mm_slot;
-	}
 	spin_unlock(&khugepaged_mm_lock);
 
 	mm = slot->mm;
@@ -2371,7 +2476,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 	if (unlikely(hpage_collapse_test_exit_or_disable(mm)))
 		goto breakouterloop;
 
-	vma_iter_init(&vmi, mm, khugepaged_scan.address);
+	vma_iter_init(&vmi, mm, mm_slot->address);
 	for_each_vma(vmi, vma) {
 		unsigned long hstart, hend;
 
@@ -2388,52 +2493,52 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 		}
 		hstart = round_up(vma->vm_start, HPAGE_PMD_SIZE);
 		hend = round_down(vma->vm_end, HPAGE_PMD_SIZE);
-		if (khugepaged_scan.address > hend)
+		if (mm_slot->address > hend)
 			goto skip;
-		if (khugepaged_scan.address < hstart)
-			khugepaged_scan.address = hstart;
-		VM_BUG_ON(khugepaged_scan.address & ~HPAGE_PMD_MASK);
+		if (mm_slot->address < hstart)
+			mm_slot->address = hstart;
+		VM_BUG_ON(mm_slot->address & ~HPAGE_PMD_MASK);
 
-		while (khugepaged_scan.address < hend) {
+		while (mm_slot->address < hend) {
 			bool mmap_locked = true;
 
 			cond_resched();
 			if (unlikely(hpage_collapse_test_exit_or_disable(mm)))
 				goto breakouterloop;
 
-			VM_BUG_ON(khugepaged_scan.address < hstart ||
-				  khugepaged_scan.address + HPAGE_PMD_SIZE >
+			VM_BUG_ON(mm_slot->address < hstart ||
+				  mm_slot->address + HPAGE_PMD_SIZE >
 				  hend);
 			if (IS_ENABLED(CONFIG_SHMEM) && vma->vm_file) {
 				struct file *file = get_file(vma->vm_file);
 				pgoff_t pgoff = linear_page_index(vma,
-						khugepaged_scan.address);
+						mm_slot->address);
 
 				mmap_read_unlock(mm);
 				mmap_locked = false;
 				*result = hpage_collapse_scan_file(mm,
-					khugepaged_scan.address, file, pgoff, cc);
+					mm_slot->address, file, pgoff, cc);
 				fput(file);
 				if (*result == SCAN_PTE_MAPPED_HUGEPAGE) {
 					mmap_read_lock(mm);
 					if (hpage_collapse_test_exit_or_disable(mm))
 						goto breakouterloop;
 					*result = collapse_pte_mapped_thp(mm,
-						khugepaged_scan.address, false);
+						mm_slot->address, false);
 					if (*result == SCAN_PMD_MAPPED)
 						*result = SCAN_SUCCEED;
 					mmap_read_unlock(mm);
 				}
 			} else {
 				*result = hpage_collapse_scan_pmd(mm, vma,
-					khugepaged_scan.address, &mmap_locked, cc);
+					mm_slot->address, &mmap_locked, cc);
 			}
 
 			if (*result == SCAN_SUCCEED)
-				++khugepaged_pages_collapsed;
+				atomic_inc(&khugepaged_pages_collapsed);
 
 			/* move to next address */
-			khugepaged_scan.address += HPAGE_PMD_SIZE;
+			mm_slot->address += HPAGE_PMD_SIZE;
 			progress += HPAGE_PMD_NR;
 			if (!mmap_locked)
 				/*
@@ -2453,25 +2558,21 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 breakouterloop_mmap_lock:
 
 	spin_lock(&khugepaged_mm_lock);
-	VM_BUG_ON(khugepaged_scan.mm_slot != mm_slot);
+	VM_BUG_ON(!mm_slot->scanning);
+	mm_slot->scanning = false;
 	/*
 	 * Release the current mm_slot if this mm is about to die, or
-	 * if we scanned all vmas of this mm.
+	 * requeue it if we scanned all vmas of this mm. As long as it was
+	 * marked scanning, khugepaged_exit left the exiting mm to us.
 	 */
 	if (hpage_collapse_test_exit(mm) || !vma) {
-		/*
-		 * Make sure that if mm_users is reaching zero while
-		 * khugepaged runs here, khugepaged_exit will find
-		 * mm_slot not pointing to the exiting mm.
-		 */
-		if (slot->mm_node.next != &khugepaged_scan.mm_head) {
-			slot = list_entry(slot->mm_node.next,
-					  struct mm_slot, mm_node);
-			khugepaged_scan.mm_slot =
-				mm_slot_entry(slot, struct khugepaged_mm_slot, slot);
-			khugepaged_scan.address = 0;
-		} else {
-			khugepaged_scan.mm_slot = NULL;
+		mm_slot->address = 0;
+		mm_slot->anon_rss = get_mm_counter(mm, MM_ANONPAGES);
+		list_move_tail(&slot->mm_node, &khugepaged_scan.mm_head);
+
+		if (!khugepaged_scan.nr_pass_left ||
+		    !--khugepaged_scan.nr_pass_left) {
+			khugepaged_scan.nr_pass_left = khugepaged_scan.nr_slots;
 			khugepaged_full_scans++;
 		}
 
@@ -2494,7 +2595,8 @@ static int khugepaged_wait_event(void)
 
 static void khugepaged_do_scan(struct collapse_control *cc)
 {
-	unsigned int progress = 0, pass_through_head = 0;
+	struct khugepaged_mm_slot *mm_slot;
+	unsigned int progress = 0, nr_picks = 0;
 	unsigned int pages = READ_ONCE(khugepaged_pages_to_scan);
 	bool wait = true;
 	int result = SCAN_SUCCEED;
@@ -2508,11 +2610,14 @@ static void khugepaged_do_scan(struct collapse_control *cc)
 			break;
 
 		spin_lock(&khugepaged_mm_lock);
-		if (!khugepaged_scan.mm_slot)
-			pass_through_head++;
+		/* Don't go around the whole queue more than once per run */
+		mm_slot = NULL;
 		if (khugepaged_has_work() &&
-		    pass_through_head < 2)
-			progress += khugepaged_scan_mm_slot(pages - progress,
+		    nr_picks++ <= khugepaged_scan.nr_slots)
+			mm_slot = khugepaged_pick_mm_slot();
+		if (mm_slot)
+			progress += khugepaged_scan_mm_slot(mm_slot,
+							    pages - progress,
 							    &result, cc);
 		else
 			progress = pages;
@@ -2560,27 +2665,43 @@ static void khugepaged_wait_work(void)
 		wait_event_freezable(khugepaged_wait, khugepaged_wait_event());
 }
 
-static int khugepaged(void *none)
+static int khugepaged(void *data)
 {
-	struct khugepaged_mm_slot *mm_slot;
+	struct collapse_control *cc = data;
 
 	set_freezable();
 	set_user_nice(current, MAX_NICE);
 
 	while (!kthread_should_stop()) {
-		khugepaged_do_scan(&khugepaged_collapse_control);
+		khugepaged_do_scan(cc);
 		khugepaged_wait_work();
 	}
 
-	spin_lock(&khugepaged_mm_lock);
-	mm_slot = khugepaged_scan.mm_slot;
-	khugepaged_scan.mm_slot = NULL;
-	if (mm_slot)
-		collect_mm_slot(mm_slot);
-	spin_unlock(&khugepaged_mm_lock);
+	if (cc != &khugepaged_collapse_control)
+		kfree(cc);
 	return 0;
 }
 
+static struct task_struct *khugepaged_start_worker(unsigned int id)
+{
+	struct collapse_control *cc = &khugepaged_collapse_control;
+	struct task_struct *thread;
+
+	if (!id)
+		return kthread_run(khugepaged, cc, "khugepaged");
+
+	cc = kzalloc(sizeof(*cc), GFP_KERNEL);
+	if (!cc)
+		return ERR_PTR(-ENOMEM);
+	cc->is_khugepaged = true;
+
+	thread = kthread_run(khugepaged, cc, "khugepaged/%u", id);
+	if (IS_ERR(thread))
+		kfree(cc);
+
+	return thread;
+}
+
 static void set_recommended_min_free_kbytes(void)
 {
 	struct zone *zone;
@@ -2634,26 +2755,42 @@ static void set_recommended_min_free_kbytes(void)
 
 int start_stop_khugepaged(void)
 {
+	unsigned int i, nr_workers = 0;
+	struct task_struct *thread;
 	int err = 0;
 
 	mutex_lock(&khugepaged_mutex);
-	if (hugepage_pmd_enabled()) {
-		if (!khugepaged_thread)
-			khugepaged_thread = kthread_run(khugepaged, NULL,
-							"khugepaged");
-		if (IS_ERR(khugepaged_thread)) {
+	if (hugepage_pmd_enabled())
+		nr_workers = khugepaged_nr_workers;
+
+	for (i = nr_workers; i < KHUGEPAGED_MAX_WORKERS; i++) {
+		if (khugepaged_threads[i]) {
+			kthread_stop(khugepaged_threads[i]);
+			khugepaged_threads[i] = NULL;
+		}
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		if (khugepaged_threads[i])
+			continue;
+
+		thread = khugepaged_start_worker(i);
+		if (IS_ERR(thread)) {
+			/* The others only add scanning bandwidth */
+			if (i) {
+				pr_warn("khugepaged: failed to start worker %u\n", i);
+				break;
+			}
 			pr_err("khugepaged: kthread_run(khugepaged) failed\n");
-			err = PTR_ERR(khugepaged_thread);
-			khugepaged_thread = NULL;
+			err = PTR_ERR(thread);
 			goto fail;
 		}
-
-		if (!list_empty(&khugepaged_scan.mm_head))
-			wake_up_interruptible(&khugepaged_wait);
-	} else if (khugepaged_thread) {
-		kthread_stop(khugepaged_thread);
-		khugepaged_thread = NULL;
+		khugepaged_threads[i] = thread;
 	}
+
+	if (nr_workers && !list_empty(&khugepaged_scan.mm_head))
+		wake_up_interruptible(&khugepaged_wait);
+
 	set_recommended_min_free_kbytes();
 fail:
 	mutex_unlock(&khugepaged_mutex);
@@ -2663,7 +2800,7 @@ int start_stop_khugepaged(void)
 void khugepaged_min_free_kbytes_update(void)
 {
 	mutex_lock(&khugepaged_mutex);
-	if (hugepage_pmd_enabled() && khugepaged_thread)
+	if (hugepage_pmd_enabled() && khugepaged_threads[0])
 		set_recommended_min_free_kbytes();
 	mutex_unlock(&khugepaged_mutex);
 }
@@ -27,6 +27,7 @@
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
 #include <linux/xxhash.h>
+#include <linux/crc32c.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
@@ -41,6 +42,7 @@
 #include <linux/oom.h>
 #include <linux/numa.h>
 #include <linux/pagewalk.h>
+#include <linux/workqueue.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -288,6 +290,9 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 /* Checksum of an empty (zeroed) page */
 static unsigned int zero_checksum __read_mostly;
 
+/* Use crc32c rather than xxhash for page checksums, set once at boot */
+static DEFINE_STATIC_KEY_FALSE(ksm_checksum_crc32c);
+
 /* Whether to merge empty (zeroed) pages with actual zero pages */
 static bool ksm_use_zero_pages __read_mostly;
 
@@ -301,6 +306,13 @@ atomic_long_t ksm_zero_pages = ATOMIC_LONG_INIT(0);
 /* The number of pages that have been skipped due to "smart scanning" */
 static unsigned long ksm_pages_skipped;
 
+/* Checksum the pages of a scan batch on workers local to their node */
+static bool ksm_scan_workers;
+static struct workqueue_struct *ksm_scan_wq;
+
+/* CPU time used by the scan workers in ns, charged to ksmd by the advisor */
+static atomic64_t ksm_scan_workers_runtime = ATOMIC64_INIT(0);
+
 /* Don't scan more than max pages per batch. */
 static unsigned long ksm_advisor_max_pages_to_scan = 30000;
 
@@ -321,7 +333,8 @@ static unsigned long ksm_advisor_target_scan_time = 200;
  * @start_scan: start time of the current scan
  * @scan_time: scan time of previous scan
  * @change: change in percent to pages_to_scan parameter
- * @cpu_time: cpu time consumed by the ksmd thread in the previous scan
+ * @cpu_time: cpu time consumed by the ksmd thread and the scan workers in
+ *            the previous scan
  */
 struct advisor_ctx {
 	ktime_t start_scan;
@@ -418,8 +431,9 @@ static void scan_time_advisor(void)
 			    MSEC_PER_SEC);
 	scan_time = scan_time ? scan_time : 1;
 
-	/* Calculate CPU consumption of ksmd background thread */
-	cpu_time = task_sched_runtime(current);
+	/* Calculate CPU consumption of ksmd background thread and its workers */
+	cpu_time = task_sched_runtime(current) +
+		   atomic64_read(&ksm_scan_workers_runtime);
 	cpu_time_diff = cpu_time - advisor_ctx.cpu_time;
 	cpu_time_diff_ms = cpu_time_diff / 1000 / 1000;
 
@@ -1238,11 +1252,48 @@ static u32 calc_checksum(struct page *page)
 {
 	u32 checksum;
 	void *addr = kmap_local_page(page);
-	checksum = xxhash(addr, PAGE_SIZE, 0);
+	if (IS_REACHABLE(CONFIG_LIBCRC32C) &&
+	    static_branch_likely(&ksm_checksum_crc32c))
+		checksum = crc32c(0, addr, PAGE_SIZE);
+	else
+		checksum = xxhash(addr, PAGE_SIZE, 0);
 	kunmap_local(addr);
 	return checksum;
 }
 
+#define KSM_CMP_SAMPLES	8
+
+/*
+ * Order pages for the stable and unstable trees.  Similar pages often
+ * share a long common prefix (zeroed headers, identical code), which
+ * memcmp_pages() has to walk before it finds a difference.  Compare a
+ * word out of each eighth of the pages first: that decides most of the
+ * comparisons in the trees, and only pages that agree on all samples, most
+ * likely identical ones, get the full memcmp_pages().  The tree order this
+ * gives is a different, but as consistent, total order as memcmp's.
+ */
+static int ksm_cmp_pages(struct page *page1, struct page *page2)
+{
+	const unsigned long stride = PAGE_SIZE / KSM_CMP_SAMPLES;
+	const unsigned long *addr1, *addr2;
+	int i, ret = 0;
+
+	addr1 = kmap_local_page(page1);
+	addr2 = kmap_local_page(page2);
+	for (i = 0; i < KSM_CMP_SAMPLES; i++) {
+		unsigned long off = (i * stride + stride / 2) / sizeof(long);
+
+		if (addr1[off] != addr2[off]) {
+			ret = addr1[off] < addr2[off] ? -1 : 1;
+			break;
+		}
+	}
+	kunmap_local(addr2);
+	kunmap_local(addr1);
+
+	return ret ? ret : memcmp_pages(page1, page2);
+}
+
 static int write_protect_page(struct vm_area_struct *vma, struct folio *folio,
 			      pte_t *orig_pte)
 {
@@ -1833,7 +1884,7 @@ static struct page *stable_tree_search(struct page *page)
 			goto again;
 		}
 
-		ret = memcmp_pages(page, &tree_folio->page);
+		ret = ksm_cmp_pages(page, &tree_folio->page);
 		folio_put(tree_folio);
 
 		parent = *new;
@@ -2040,7 +2091,7 @@ static struct ksm_stable_node *stable_tree_insert(struct folio *kfolio)
 			goto again;
 		}
 
-		ret = memcmp_pages(&kfolio->page, &tree_folio->page);
+		ret = ksm_cmp_pages(&kfolio->page, &tree_folio->page);
 		folio_put(tree_folio);
 
 		parent = *new;
@@ -2130,7 +2181,7 @@ struct ksm_rmap_item *unstable_tree_search_insert(struct ksm_rmap_item *rmap_ite
 			return NULL;
 		}
 
-		ret = memcmp_pages(page, tree_page);
+		ret = ksm_cmp_pages(page, tree_page);
 
 		parent = *new;
 		if (ret < 0) {
@@ -2212,7 +2263,8 @@ static void stable_tree_append(struct ksm_rmap_item *rmap_item,
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
  */
-static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_item)
+static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_item,
+			       const unsigned int *precalc_checksum)
 {
 	struct ksm_rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
@@ -2249,7 +2301,8 @@ static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_ite
 		 * don't want to insert it in the unstable tree, and we don't want
 		 * to waste our time searching for something identical to it there.
 		 */
-		checksum = calc_checksum(page);
+		checksum = precalc_checksum ? *precalc_checksum :
+					      calc_checksum(page);
 		if (rmap_item->oldchecksum != checksum) {
 			rmap_item->oldchecksum = checksum;
 			return;
@@ -2447,7 +2500,8 @@ static bool should_skip_rmap_item(struct page *page,
 	return true;
 }
 
-static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
+static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page,
+						     bool stay_in_mm)
 {
 	struct mm_struct *mm;
 	struct ksm_mm_slot *mm_slot;
@@ -2523,7 +2577,7 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 
 	mmap_read_lock(mm);
 	if (ksm_test_exit(mm))
-		goto no_vmas;
+		goto mm_done;
 
 	for_each_vma(vmi, vma) {
 		if (!(vma->vm_flags & VM_MERGEABLE))
@@ -2579,8 +2633,17 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 		}
 	}
 
+mm_done:
+	/*
+	 * The caller still holds rmap_items of this mm, which moving on
+	 * to the next mm may free: let it finish with them first.
+	 */
+	if (stay_in_mm) {
+		mmap_read_unlock(mm);
+		return NULL;
+	}
+
 	if (ksm_test_exit(mm)) {
-no_vmas:
 		ksm_scan.address = 0;
 		ksm_scan.rmap_list = &mm_slot->rmap_list;
 	}
@@ -2637,6 +2700,129 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 	return NULL;
 }
 
+#define KSM_SCAN_BATCH	64
+
+struct ksm_scan_item {
+	struct ksm_rmap_item *rmap_item;
+	struct page *page;
+	unsigned int checksum;
+	bool checksum_valid;
+	int nid;
+};
+
+struct ksm_checksum_work {
+	struct work_struct work;
+	int nid;
+	int nr;
+};
+
+/* Only used by ksmd, under ksm_thread_mutex */
+static struct ksm_scan_item ksm_scan_items[KSM_SCAN_BATCH];
+static struct ksm_checksum_work *ksm_checksum_works;
+
+static void ksm_checksum_items(int nr, int nid)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		struct ksm_scan_item *item = &ksm_scan_items[i];
+
+		/* Only pages outside the stable tree need a checksum */
+		if (item->nid != nid || PageKsm(item->page))
+			continue;
+		item->checksum = calc_checksum(item->page);
+		item->checksum_valid = true;
+	}
+}
+
+static void ksm_checksum_work_fn(struct work_struct *work)
+{
+	struct ksm_checksum_work *cw =
+		container_of(work, struct ksm_checksum_work, work);
+	u64 start = local_clock();
+
+	ksm_checksum_items(cw->nr, cw->nid);
+	atomic64_add(local_clock() - start, &ksm_scan_workers_runtime);
+}
+
+/*
+ * Checksum the batch on one worker per node that has pages in it, while
+ * ksmd takes care of the pages of its own node.
+ */
+static void ksm_checksum_batch(int nr)
+{
+	nodemask_t nodes = NODE_MASK_NONE;
+	int nid, this_nid = numa_node_id();
+	int i;
+
+	for (i = 0; i < nr; i++)
+		node_set(ksm_scan_items[i].nid, nodes);
+
+	for_each_node_mask(nid, nodes) {
+		if (nid == this_nid)
+			continue;
+		ksm_checksum_works[nid].nr = nr;
+		queue_work_node(nid, ksm_scan_wq, &ksm_checksum_works[nid].work);
+	}
+
+	if (node_isset(this_nid, nodes))
+		ksm_checksum_items(nr, this_nid);
+
+	for_each_node_mask(nid, nodes) {
+		if (nid != this_nid)
+			flush_work(&ksm_checksum_works[nid].work);
+	}
+}
+
+/*
+ * Like ksm_do_scan(), but collect up to KSM_SCAN_BATCH pages of the same
+ * mm before merging them, so their checksums can be calculated in parallel
+ * on the nodes the pages live on.  The trees are still only updated by
+ * ksmd, in scan order.
+ */
+static void ksm_do_scan_batched(unsigned int scan_npages)
+{
+	struct ksm_scan_item *item;
+	int i, nr;
+
+	while (scan_npages && likely(!freezing(current))) {
+		nr = 0;
+		while (nr < KSM_SCAN_BATCH && scan_npages) {
+			cond_resched();
+			item = &ksm_scan_items[nr];
+			item->rmap_item = scan_get_next_rmap_item(&item->page,
+								  nr > 0);
+			if (!item->rmap_item)
+				break;
+			item->nid = page_to_nid(item->page);
+			item->checksum_valid = false;
+			scan_npages--;
+			nr++;
+			/*
+			 * Holding a reference on several pages of a large
+			 * folio would stop try_to_merge_one_page() from
+			 * splitting it.
+			 */
+			if (folio_test_large(page_folio(item->page)))
+				break;
+		}
+		if (!nr)
+			return;
+
+		ksm_checksum_batch(nr);
+
+		for (i = 0; i < nr; i++) {
+			item = &ksm_scan_items[i];
+			cmp_and_merge_page(item->page, item->rmap_item,
+					   item->checksum_valid ?
+					   &item->checksum : NULL);
+			put_page(item->page);
+			ksm_pages_scanned++;
+			cond_resched();
+		}
+	}
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages:  number of pages we want to scan before we return.
@@ -2646,12 +2832,17 @@ static void ksm_do_scan(unsigned int scan_npages)
 	struct ksm_rmap_item *rmap_item;
 	struct page *page;
 
+	if (READ_ONCE(ksm_scan_workers) && ksm_checksum_works) {
+		ksm_do_scan_batched(scan_npages);
+		return;
+	}
+
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
+		rmap_item = scan_get_next_rmap_item(&page, false);
 		if (!rmap_item)
 			return;
-		cmp_and_merge_page(page, rmap_item);
+		cmp_and_merge_page(page, rmap_item, NULL);
 		put_page(page);
 		ksm_pages_scanned++;
 	}
@@ -3638,6 +3829,41 @@ static ssize_t smart_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(smart_scan);
 
+static ssize_t scan_workers_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_scan_workers);
+}
+
+static ssize_t scan_workers_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	bool value;
+
+	err = kstrtobool(buf, &value);
+	if (err)
+		return -EINVAL;
+
+	if (value && !ksm_checksum_works)
+		return -ENOMEM;
+
+	WRITE_ONCE(ksm_scan_workers, value);
+	return count;
+}
+KSM_ATTR(scan_workers);
+
+static ssize_t checksum_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	if (IS_REACHABLE(CONFIG_LIBCRC32C) &&
+	    static_branch_likely(&ksm_checksum_crc32c))
+		return sysfs_emit(buf, "%s\n", crc32c_impl());
+	return sysfs_emit(buf, "xxhash\n");
+}
+KSM_ATTR_RO(checksum);
+
 static ssize_t advisor_mode_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
@@ -3784,6 +4010,8 @@ static struct attribute *ksm_attrs[] = {
 	&use_zero_pages_attr.attr,
 	&general_profit_attr.attr,
 	&smart_scan_attr.attr,
+	&scan_workers_attr.attr,
+	&checksum_attr.attr,
 	&advisor_mode_attr.attr,
 	&advisor_max_cpu_attr.attr,
 	&advisor_min_pages_to_scan_attr.attr,
@@ -3798,6 +4026,32 @@ static const struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+static void __init ksm_scan_workers_init(void)
+{
+	struct ksm_checksum_work *works;
+	int nid;
+
+	ksm_scan_wq = alloc_workqueue("ksm_scan", WQ_UNBOUND | WQ_SYSFS, 0);
+	if (!ksm_scan_wq)
+		goto fail;
+
+	works = kcalloc(nr_node_ids, sizeof(*works), GFP_KERNEL);
+	if (!works) {
+		destroy_workqueue(ksm_scan_wq);
+		ksm_scan_wq = NULL;
+		goto fail;
+	}
+
+	for (nid = 0; nid < nr_node_ids; nid++) {
+		works[nid].nid = nid;
+		INIT_WORK(&works[nid].work, ksm_checksum_work_fn);
+	}
+	ksm_checksum_works = works;
+	return;
+fail:
+	pr_warn("ksm: failed to set up scan workers\n");
+}
+
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
@@ -3812,6 +4066,8 @@ static int __init ksm_init(void)
 	if (err)
 		goto out;
 
+	ksm_scan_workers_init();
+
 	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		pr_err("ksm: creating kthread failed\n");
@@ -3843,3 +4099,27 @@ static int __init ksm_init(void)
 	return err;
 }
 subsys_initcall(ksm_init);
+
+/*
+ * crc32c() is only usable once lib/libcrc32c.c has picked its crypto
+ * driver, so switch page checksums over when everything is registered,
+ * and only if that driver is better than the generic table lookup.
+ */
+static int __init ksm_checksum_init(void)
+{
+	const char *impl;
+
+	if (!IS_REACHABLE(CONFIG_LIBCRC32C))
+		return 0;
+
+	impl = crc32c_impl();
+	if (!impl || !strcmp(impl, "crc32c-generic"))
+		return 0;
+
+	mutex_lock(&ksm_thread_mutex);
+	static_branch_enable(&ksm_checksum_crc32c);
+	zero_checksum = calc_checksum(ZERO_PAGE(0));
+	mutex_unlock(&ksm_thread_mutex);
+	return 0;
+}
+late_initcall(ksm_checksum_init);
@@ -1337,6 +1337,69 @@ int madvise_set_anon_name(struct mm_struct *mm, unsigned long start,
 				 madvise_vma_anon_name);
 }
 #endif /* CONFIG_ANON_VMA_NAME */
+
+#ifdef CONFIG_PER_VMA_LOCK
+/*
+ * MADV_DONTNEED only zaps page table entries, which page faults already do
+ * under the per-VMA lock alone. If the range lies within a single VMA, lock
+ * just that VMA and leave mmap_lock to the faults on the others.
+ *
+ * Returns -EAGAIN if the caller has to fall back to mmap_lock.
+ */
+static int madvise_dontneed_vma_locked(struct mm_struct *mm,
+				       unsigned long start,
+				       unsigned long end, int behavior)
+{
+	struct vm_area_struct *vma, *prev;
+	int error;
+
+	switch (behavior) {
+	case MADV_DONTNEED:
+	case MADV_DONTNEED_LOCKED:
+		break;
+	default:
+		return -EAGAIN;
+	}
+
+	/* untagged_addr_remote() needs mmap_lock */
+	if (mm != current->mm)
+		return -EAGAIN;
+
+	end = untagged_addr(start) + (end - start);
+	start = untagged_addr(start);
+
+	vma = lock_vma_under_rcu(mm, start);
+	if (!vma)
+		goto fallback;
+
+	/*
+	 * userfaultfd_remove() drops mmap_lock, and hugetlb PMD unsharing
+	 * relies on it: leave those to the slow path.
+	 */
+	if (end > vma->vm_end || userfaultfd_armed(vma) ||
+	    is_vm_hugetlb_page(vma)) {
+		vma_end_read(vma);
+		goto fallback;
+	}
+
+	error = madvise_dontneed_free(vma, &prev, start, end, behavior);
+	vma_end_read(vma);
+	count_vm_vma_lock_event(VMA_LOCK_MADVISE);
+	return error;
+
+fallback:
+	count_vm_vma_lock_event(VMA_LOCK_MADVISE_FALLBACK);
+	return -EAGAIN;
+}
+#else
+static inline int madvise_dontneed_vma_locked(struct mm_struct *mm,
+					      unsigned long start,
+					      unsigned long end, int behavior)
+{
+	return -EAGAIN;
+}
+#endif /* CONFIG_PER_VMA_LOCK */
+
 /*
  * The madvise(2) system call.
  *
@@ -1440,6 +1503,10 @@ int do_madvise(struct mm_struct *mm, unsigned long start, size_t len_in, int beh
 		return madvise_inject_error(behavior, start, start + len_in);
 #endif
 
+	error = madvise_dontneed_vma_locked(mm, start, end, behavior);
+	if (error != -EAGAIN)
+		return error;
+
 	write = madvise_need_mmap_write(behavior);
 	if (write) {
 		if (mmap_write_lock_killable(mm))
@@ -45,6 +45,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/rbtree.h>
+#include <linux/moduleparam.h>
 #include <linux/slab.h>
 #include <linux/swapops.h>
 #include <linux/spinlock.h>
@@ -474,6 +475,9 @@ static inline int memcg_events_index(enum vm_event_item idx)
 	return mem_cgroup_events_index[idx];
 }
 
+/* Refault distance buckets: 0, then [2^(i-1), 2^i) for bucket i */
+#define MEMCG_REFAULT_HIST_BUCKETS	24
+
 struct memcg_vmstats_percpu {
 	/* Stats updates since the last flush */
 	unsigned int			stats_updates;
@@ -491,6 +495,12 @@ struct memcg_vmstats_percpu {
 	/* Delta calculation for lockless upward propagation */
 	long			state_prev[MEMCG_VMSTAT_SIZE];
 	unsigned long		events_prev[NR_MEMCG_EVENTS];
+
+	/*
+	 * Refaulted pages by refault distance, in pages for the active/
+	 * inactive LRU and in generations for MGLRU.  Not hierarchical.
+	 */
+	unsigned long		refault_hist[2][MEMCG_REFAULT_HIST_BUCKETS];
 } ____cacheline_aligned;
 
 struct memcg_vmstats {
@@ -508,6 +518,9 @@ struct memcg_vmstats {
 
 	/* Stats updates since the last flush */
 	atomic64_t		stats_updates;
+
+	/* Where the next incremental flush resumes, 0 if none is ongoing */
+	unsigned int		flush_cursor;
 };
 
 /*
@@ -531,6 +544,16 @@ static u64 flush_last_time;
 
 #define FLUSH_TIME (2UL*HZ)
 
+/*
+ * If non-zero, mem_cgroup_flush_stats() flushes incrementally: each call
+ * flushes about that many cgroups' per-cpu updates, and the next one resumes
+ * where it stopped until the pass over all CPUs is complete.  This bounds the
+ * latency of readers on big hierarchies, at the cost of slightly stale stats.
+ * The periodic flusher still does full flushes, which bounds the staleness.
+ */
+static unsigned int memcg_stats_flush_budget __read_mostly;
+module_param_named(stats_flush_budget, memcg_stats_flush_budget, uint, 0644);
+
 /*
  * Accessors to ensure that preemption is disabled on PREEMPT_RT because it can
  * not rely on this as part of an acquired spinlock_t lock. These functions are
@@ -569,7 +592,7 @@ static inline void memcg_rstat_updated(struct mem_cgroup *memcg, int val)
 	if (!val)
 		return;
 
-	cgroup_rstat_updated(memcg->css.cgroup, cpu);
+	css_rstat_updated(&memcg->css, cpu);
 	statc = this_cpu_ptr(memcg->vmstats_percpu);
 	for (; statc; statc = statc->parent) {
 		stats_updates = READ_ONCE(statc->stats_updates) + abs(val);
@@ -593,7 +616,7 @@ static void do_flush_stats(struct mem_cgroup *memcg)
 	if (mem_cgroup_is_root(memcg))
 		WRITE_ONCE(flush_last_time, jiffies_64);
 
-	cgroup_rstat_flush(memcg->css.cgroup);
+	css_rstat_flush(&memcg->css);
 }
 
 /*
@@ -607,14 +630,29 @@ static void do_flush_stats(struct mem_cgroup *memcg)
  */
 void mem_cgroup_flush_stats(struct mem_cgroup *memcg)
 {
+	unsigned int budget;
+
 	if (mem_cgroup_disabled())
 		return;
 
 	if (!memcg)
 		memcg = root_mem_cgroup;
 
-	if (memcg_vmstats_needs_flush(memcg->vmstats))
-		do_flush_stats(memcg);
+	budget = READ_ONCE(memcg_stats_flush_budget);
+	if (!budget) {
+		if (memcg_vmstats_needs_flush(memcg->vmstats))
+			do_flush_stats(memcg);
+		return;
+	}
+
+	/*
+	 * The first CPU flushed resets stats_updates, keep going until the
+	 * pass that it started is complete.
+	 */
+	if (memcg_vmstats_needs_flush(memcg->vmstats) ||
+	    READ_ONCE(memcg->vmstats->flush_cursor))
+		css_rstat_flush_bounded(&memcg->css,
+					&memcg->vmstats->flush_cursor, budget);
 }
 
 void mem_cgroup_flush_stats_ratelimited(struct mem_cgroup *memcg)
@@ -4346,6 +4384,61 @@ static ssize_t memory_reclaim(struct kernfs_open_file *of, char *buf,
 	return nbytes;
 }
 
+/**
+ * mem_cgroup_count_refault - account a refault in the refault histogram
+ * @memcg: memcg whose LRU the refault distance was measured on
+ * @distance: refault distance, in pages or in MGLRU generations
+ * @lru_gen: whether @distance is in generations
+ * @nr: number of pages refaulted
+ */
+void mem_cgroup_count_refault(struct mem_cgroup *memcg, unsigned long distance,
+			      bool lru_gen, long nr)
+{
+	int bucket;
+
+	if (mem_cgroup_disabled() || !memcg)
+		return;
+
+	bucket = min_t(int, fls_long(distance), MEMCG_REFAULT_HIST_BUCKETS - 1);
+	this_cpu_add(memcg->vmstats_percpu->refault_hist[lru_gen][bucket], nr);
+}
+
+/*
+ * Each line is "<unit> <distance> <pages>", the pages that refaulted with
+ * a distance from <distance> up to the next line's.  The last bucket of
+ * each unit has no upper bound.
+ */
+static int memory_refault_histogram_show(struct seq_file *m, void *v)
+{
+	static const char * const units[] = { "pages", "generations" };
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	int unit, i, cpu;
+
+	for (unit = 0; unit < ARRAY_SIZE(units); unit++) {
+		for (i = 0; i < MEMCG_REFAULT_HIST_BUCKETS; i++) {
+			unsigned long pages = 0;
+
+			for_each_possible_cpu(cpu)
+				pages += per_cpu_ptr(memcg->vmstats_percpu,
+						     cpu)->refault_hist[unit][i];
+
+			seq_printf(m, "%s %lu %lu\n", units[unit],
+				   i ? 1UL << (i - 1) : 0, pages);
+		}
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_LRU_GEN
+static int memory_lru_gen_show(struct seq_file *m, void *v)
+{
+	lru_gen_memcg_show(m, mem_cgroup_from_seq(m));
+
+	return 0;
+}
+#endif
+
 static struct cftype memory_files[] = {
 	{
 		.name = "current",
@@ -4405,6 +4498,16 @@ static struct cftype memory_files[] = {
 		.name = "numa_stat",
 		.seq_show = memory_numa_stat_show,
 	},
+#endif
+	{
+		.name = "refault_histogram",
+		.seq_show = memory_refault_histogram_show,
+	},
+#ifdef CONFIG_LRU_GEN
+	{
+		.name = "lru_gen",
+		.seq_show = memory_lru_gen_show,
+	},
 #endif
 	{
 		.name = "oom.group",
@@ -4490,6 +4593,27 @@ int __mem_cgroup_charge(struct folio *folio, struct mm_struct *mm, gfp_t gfp)
 	return ret;
 }
 
+int __mem_cgroup_charge_folios(struct folio_batch *folios,
+			       struct mm_struct *mm, gfp_t gfp)
+{
+	struct mem_cgroup *memcg;
+	unsigned int i, nr_pages = 0;
+	int ret;
+
+	for (i = 0; i < folio_batch_count(folios); i++)
+		nr_pages += folio_nr_pages(folios->folios[i]);
+
+	memcg = get_mem_cgroup_from_mm(mm);
+	ret = try_charge(memcg, gfp, nr_pages);
+	if (!ret) {
+		for (i = 0; i < folio_batch_count(folios); i++)
+			mem_cgroup_commit_charge(folios->folios[i], memcg);
+	}
+	css_put(&memcg->css);
+
+	return ret;
+}
+
 /**
  * mem_cgroup_hugetlb_try_charge - try to charge the memcg for a hugetlb folio
  * @memcg: memcg to charge.
@@ -5413,6 +5537,24 @@ static ssize_t zswap_writeback_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+static int zswap_compressor_show(struct seq_file *m, void *v)
+{
+	return zswap_memcg_compressor_show(m, mem_cgroup_from_seq(m));
+}
+
+static ssize_t zswap_compressor_write(struct kernfs_open_file *of,
+				      char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	int err;
+
+	err = zswap_memcg_set_compressor(memcg, strstrip(buf));
+	if (err)
+		return err;
+
+	return nbytes;
+}
+
 static struct cftype zswap_files[] = {
 	{
 		.name = "zswap.current",
@@ -5430,6 +5572,12 @@ static struct cftype zswap_files[] = {
 		.seq_show = zswap_writeback_show,
 		.write = zswap_writeback_write,
 	},
+	{
+		.name = "zswap.compressor",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = zswap_compressor_show,
+		.write = zswap_compressor_write,
+	},
 	{ }	/* terminate */
 };
 #endif /* CONFIG_ZSWAP */
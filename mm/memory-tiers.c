@@ -28,6 +28,12 @@ struct memory_tier {
 
 struct demotion_nodes {
 	nodemask_t preferred;
+	/* All the nodes of the next lower tier */
+	nodemask_t tier;
+	/* Demotion traffic into this node, see demotion_bw_rate() */
+	atomic_long_t nr_demoted;
+	unsigned long bw_stamp;
+	unsigned long bw_rate;
 };
 
 struct node_memory_type_map {
@@ -43,6 +49,8 @@ static LIST_HEAD(memory_tiers);
  */
 static LIST_HEAD(default_memory_types);
 static struct node_memory_type_map node_memory_types[MAX_NUMNODES];
+/* Write bandwidth reported by HMAT/CXL in MB/s, 0 if unknown */
+static unsigned int node_write_bandwidth[MAX_NUMNODES];
 struct memory_dev_type *default_dram_type;
 nodemask_t default_dram_nodes __initdata = NODE_MASK_NONE;
 
@@ -129,6 +137,13 @@ static int top_tier_adistance;
  *
  */
 static struct demotion_nodes *node_demotion __read_mostly;
+
+/*
+ * Percentage of a target node's write bandwidth that demotion may use
+ * before other nodes of the same tier are preferred. 0 disables the
+ * bandwidth-aware target selection.
+ */
+static unsigned int demotion_bandwidth_budget __read_mostly;
 #endif /* CONFIG_MIGRATION */
 
 static BLOCKING_NOTIFIER_HEAD(mt_adistance_algorithms);
@@ -317,6 +332,97 @@ void node_get_allowed_targets(pg_data_t *pgdat, nodemask_t *targets)
 	rcu_read_unlock();
 }
 
+#define DEMOTION_BW_PERIOD	(HZ / 10)
+
+/**
+ * node_demotion_account() - Account pages demoted to a node
+ * @nid: the demotion target
+ * @nr_pages: number of pages demoted
+ */
+void node_demotion_account(int nid, unsigned int nr_pages)
+{
+	if (!node_demotion || !nr_pages)
+		return;
+
+	atomic_long_add(nr_pages, &node_demotion[nid].nr_demoted);
+}
+
+/*
+ * Demotion bandwidth into @nid in MB/s: a decaying average, refreshed
+ * by whoever looks at it first once a period has passed.
+ */
+static unsigned long demotion_bw_rate(int nid)
+{
+	struct demotion_nodes *nd = &node_demotion[nid];
+	unsigned long stamp = READ_ONCE(nd->bw_stamp);
+	unsigned long elapsed = jiffies - stamp;
+	unsigned long bytes, rate;
+
+	if (elapsed < DEMOTION_BW_PERIOD ||
+	    cmpxchg(&nd->bw_stamp, stamp, stamp + elapsed) != stamp)
+		return READ_ONCE(nd->bw_rate);
+
+	bytes = atomic_long_xchg(&nd->nr_demoted, 0) << PAGE_SHIFT;
+	/* Bytes per millisecond is KB/s */
+	rate = bytes / jiffies_to_msecs(elapsed) / 1000;
+	if (elapsed < 4 * DEMOTION_BW_PERIOD)
+		rate = (READ_ONCE(nd->bw_rate) * 3 + rate) / 4;
+	WRITE_ONCE(nd->bw_rate, rate);
+
+	return rate;
+}
+
+/* Bandwidth @node has left in its demotion budget, in MB/s */
+static unsigned long demotion_bw_headroom(int node, unsigned long max_bw,
+					  unsigned int budget, bool refresh)
+{
+	/* Assume nodes that didn't report bandwidth are the fastest */
+	unsigned long bw = (node_write_bandwidth[node] ? : max_bw) * budget / 100;
+	unsigned long rate;
+
+	rate = refresh ? demotion_bw_rate(node) :
+			 READ_ONCE(node_demotion[node].bw_rate);
+
+	return bw > rate ? bw - rate : 0;
+}
+
+/*
+ * Spread demotions over the nodes of the next tier, in proportion to the
+ * headroom each one has left in its bandwidth budget. A random pick rather
+ * than the least loaded node keeps concurrent reclaimers from all piling
+ * onto the same node until the next rate update. Nodes that are over
+ * budget are only picked when all of them are.
+ */
+static int demotion_bw_select(struct demotion_nodes *nd, unsigned int budget)
+{
+	unsigned long total = 0, max_bw = 0, headroom, pick;
+	int node, target = NUMA_NO_NODE;
+
+	for_each_node_mask(node, nd->tier)
+		max_bw = max_t(unsigned long, max_bw, node_write_bandwidth[node]);
+
+	/* Nothing to budget with */
+	if (!max_bw)
+		return node_random(&nd->preferred);
+
+	for_each_node_mask(node, nd->tier)
+		total += demotion_bw_headroom(node, max_bw, budget, true);
+
+	if (!total)
+		return node_random(&nd->tier);
+
+	pick = get_random_u32_below(min_t(unsigned long, total, U32_MAX));
+	for_each_node_mask(node, nd->tier) {
+		target = node;
+		headroom = demotion_bw_headroom(node, max_bw, budget, false);
+		if (pick < headroom)
+			break;
+		pick -= headroom;
+	}
+
+	return target;
+}
+
 /**
  * next_demotion_node() - Get the next node in the demotion path
  * @node: The starting node to lookup the next node
@@ -329,6 +435,7 @@ void node_get_allowed_targets(pg_data_t *pgdat, nodemask_t *targets)
 int next_demotion_node(int node)
 {
 	struct demotion_nodes *nd;
+	unsigned int budget;
 	int target;
 
 	if (!node_demotion)
@@ -344,19 +451,24 @@ int next_demotion_node(int node)
 	 * node_demotion[] reads need to be consistent.
 	 */
 	rcu_read_lock();
-	/*
-	 * If there are multiple target nodes, just select one
-	 * target node randomly.
-	 *
-	 * In addition, we can also use round-robin to select
-	 * target node, but we should introduce another variable
-	 * for node_demotion[] to record last selected target node,
-	 * that may cause cache ping-pong due to the changing of
-	 * last target node. Or introducing per-cpu data to avoid
-	 * caching issue, which seems more complicated. So selecting
-	 * target node randomly seems better until now.
-	 */
-	target = node_random(&nd->preferred);
+	budget = READ_ONCE(demotion_bandwidth_budget);
+	if (budget && nodes_weight(nd->tier) > 1) {
+		target = demotion_bw_select(nd, budget);
+	} else {
+		/*
+		 * If there are multiple target nodes, just select one
+		 * target node randomly.
+		 *
+		 * In addition, we can also use round-robin to select
+		 * target node, but we should introduce another variable
+		 * for node_demotion[] to record last selected target node,
+		 * that may cause cache ping-pong due to the changing of
+		 * last target node. Or introducing per-cpu data to avoid
+		 * caching issue, which seems more complicated. So selecting
+		 * target node randomly seems better until now.
+		 */
+		target = node_random(&nd->preferred);
+	}
 	rcu_read_unlock();
 
 	return target;
@@ -369,6 +481,7 @@ static void disable_all_demotion_targets(void)
 
 	for_each_node_state(node, N_MEMORY) {
 		node_demotion[node].preferred = NODE_MASK_NONE;
+		node_demotion[node].tier = NODE_MASK_NONE;
 		/*
 		 * We are holding memory_tier_lock, it is safe
 		 * to access pgda->memtier.
@@ -444,6 +557,7 @@ static void establish_demotion_targets(void)
 		 * nodelist to skip list so that we find the best node from the
 		 * memtier nodelist.
 		 */
+		nodes_and(nd->tier, node_states[N_MEMORY], tier_nodes);
 		nodes_andnot(tier_nodes, node_states[N_MEMORY], tier_nodes);
 
 		/*
@@ -782,6 +896,22 @@ int mt_set_default_dram_perf(int nid, struct access_coordinate *perf,
 	return 0;
 }
 
+/**
+ * mt_set_node_perf() - Record the performance of a memory node
+ * @nid: the node
+ * @perf: its performance as seen from the CPUs
+ *
+ * Used to budget the bandwidth of demotion targets.
+ */
+void mt_set_node_perf(int nid, struct access_coordinate *perf)
+{
+	if (nid < 0 || nid >= MAX_NUMNODES)
+		return;
+
+	WRITE_ONCE(node_write_bandwidth[nid], perf->write_bandwidth);
+}
+EXPORT_SYMBOL_GPL(mt_set_node_perf);
+
 int mt_perf_to_adistance(struct access_coordinate *perf, int *adist)
 {
 	guard(mutex)(&default_dram_perf_lock);
@@ -960,8 +1090,37 @@ static ssize_t demotion_enabled_store(struct kobject *kobj,
 static struct kobj_attribute numa_demotion_enabled_attr =
 	__ATTR_RW(demotion_enabled);
 
+static ssize_t demotion_bandwidth_budget_show(struct kobject *kobj,
+					      struct kobj_attribute *attr,
+					      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", READ_ONCE(demotion_bandwidth_budget));
+}
+
+static ssize_t demotion_bandwidth_budget_store(struct kobject *kobj,
+					       struct kobj_attribute *attr,
+					       const char *buf, size_t count)
+{
+	unsigned int budget;
+	ssize_t ret;
+
+	ret = kstrtouint(buf, 10, &budget);
+	if (ret)
+		return ret;
+
+	if (budget > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(demotion_bandwidth_budget, budget);
+	return count;
+}
+
+static struct kobj_attribute numa_demotion_bandwidth_budget_attr =
+	__ATTR_RW(demotion_bandwidth_budget);
+
 static struct attribute *numa_attrs[] = {
 	&numa_demotion_enabled_attr.attr,
+	&numa_demotion_bandwidth_budget_attr.attr,
 	NULL,
 };
 
@@ -78,6 +78,7 @@
 #include <linux/ptrace.h>
 #include <linux/vmalloc.h>
 #include <linux/sched/sysctl.h>
+#include <linux/padata.h>
 
 #include <trace/events/kmem.h>
 
@@ -1320,6 +1321,86 @@ copy_p4d_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	return 0;
 }
 
+static int
+copy_pgd_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
+	       unsigned long addr, unsigned long end)
+{
+	pgd_t *src_pgd, *dst_pgd;
+	unsigned long next;
+
+	dst_pgd = pgd_offset(dst_vma->vm_mm, addr);
+	src_pgd = pgd_offset(src_vma->vm_mm, addr);
+	do {
+		next = pgd_addr_end(addr, end);
+		if (pgd_none_or_clear_bad(src_pgd))
+			continue;
+		if (unlikely(copy_p4d_range(dst_vma, src_vma, dst_pgd, src_pgd,
+					    addr, next)))
+			return -ENOMEM;
+	} while (dst_pgd++, src_pgd++, addr = next, addr != end);
+	return 0;
+}
+
+/*
+ * Anonymous mappings of at least this size of an mm with MMF_PARALLEL_FORK
+ * get their page tables copied by padata helpers.  Chunks are PUD aligned,
+ * so that helpers never share a page table below the PUD level, nor a PUD
+ * sized huge page.
+ */
+#define COPY_PAGE_RANGE_MT_MIN		(4 * PUD_SIZE)
+
+struct copy_page_range_job {
+	struct vm_area_struct *dst_vma;
+	struct vm_area_struct *src_vma;
+	int ret;
+};
+
+static void copy_page_range_chunk(unsigned long start, unsigned long end,
+				  void *arg)
+{
+	struct copy_page_range_job *cj = arg;
+	struct mem_cgroup *memcg, *old_memcg;
+
+	if (READ_ONCE(cj->ret))
+		return;
+
+	/*
+	 * Helpers run in kworkers, charge the child's page tables to its
+	 * memcg as the forking task would.
+	 */
+	memcg = get_mem_cgroup_from_mm(cj->dst_vma->vm_mm);
+	old_memcg = set_active_memcg(memcg);
+	if (copy_pgd_range(cj->dst_vma, cj->src_vma, start, end))
+		WRITE_ONCE(cj->ret, -ENOMEM);
+	set_active_memcg(old_memcg);
+	mem_cgroup_put(memcg);
+}
+
+static int
+copy_page_range_mt(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma)
+{
+	struct copy_page_range_job cj = {
+		.dst_vma	= dst_vma,
+		.src_vma	= src_vma,
+	};
+	struct padata_mt_job job = {
+		.thread_fn	= copy_page_range_chunk,
+		.fn_arg		= &cj,
+		.start		= src_vma->vm_start,
+		.size		= src_vma->vm_end - src_vma->vm_start,
+		.align		= PUD_SIZE,
+		.min_chunk	= PUD_SIZE,
+		.max_threads	= num_online_cpus(),
+	};
+
+	/*
+	 * The helpers work on behalf of the forking task, which holds
+	 * mmap_lock of both mms and the vma write lock for all of them.
+	 */
+	padata_do_multithreaded(&job);
+	return cj.ret;
+}
+
 /*
  * Return true if the vma needs to copy the pgtable during this fork().  Return
  * false when we can speed up fork() by allowing lazy page faults later until
@@ -1355,8 +1436,6 @@ vma_needs_copy(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma)
 int
 copy_page_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma)
 {
-	pgd_t *src_pgd, *dst_pgd;
-	unsigned long next;
 	unsigned long addr = src_vma->vm_start;
 	unsigned long end = src_vma->vm_end;
 	struct mm_struct *dst_mm = dst_vma->vm_mm;
@@ -1404,20 +1483,15 @@ copy_page_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma)
 		raw_write_seqcount_begin(&src_mm->write_protect_seq);
 	}
 
-	ret = 0;
-	dst_pgd = pgd_offset(dst_mm, addr);
-	src_pgd = pgd_offset(src_mm, addr);
-	do {
-		next = pgd_addr_end(addr, end);
-		if (pgd_none_or_clear_bad(src_pgd))
-			continue;
-		if (unlikely(copy_p4d_range(dst_vma, src_vma, dst_pgd, src_pgd,
-					    addr, next))) {
+	if (is_cow && vma_is_anonymous(src_vma) &&
+	    test_bit(MMF_PARALLEL_FORK, &src_mm->flags) &&
+	    end - addr >= COPY_PAGE_RANGE_MT_MIN) {
+		ret = copy_page_range_mt(dst_vma, src_vma);
+	} else {
+		ret = copy_pgd_range(dst_vma, src_vma, addr, end);
+		if (ret)
 			untrack_pfn_clear(dst_vma);
-			ret = -ENOMEM;
-			break;
-		}
-	} while (dst_pgd++, src_pgd++, addr = next, addr != end);
+	}
 
 	if (is_cow) {
 		raw_write_seqcount_end(&src_mm->write_protect_seq);
@@ -4103,7 +4177,12 @@ static inline unsigned long thp_swap_suitable_orders(pgoff_t swp_offset,
 	return orders;
 }
 
-static struct folio *alloc_swap_folio(struct vm_fault *vmf)
+/*
+ * Allocate a large folio for the naturally aligned range of swap entries
+ * around the fault, if it looks like a single swapped out large folio.
+ * Returns NULL if no large folio fits or could be allocated.
+ */
+static struct folio *alloc_large_swap_folio(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
 	unsigned long orders;
@@ -4120,7 +4199,7 @@ static struct folio *alloc_swap_folio(struct vm_fault *vmf)
 	 * maintain the uffd semantics.
 	 */
 	if (unlikely(userfaultfd_armed(vma)))
-		goto fallback;
+		return NULL;
 
 	/*
 	 * A large swapped out folio could be partially or fully in zswap. We
@@ -4128,7 +4207,7 @@ static struct folio *alloc_swap_folio(struct vm_fault *vmf)
 	 * folio.
 	 */
 	if (!zswap_never_enabled())
-		goto fallback;
+		return NULL;
 
 	entry = pte_to_swp_entry(vmf->orig_pte);
 	/*
@@ -4142,12 +4221,12 @@ static struct folio *alloc_swap_folio(struct vm_fault *vmf)
 					  vmf->address, orders);
 
 	if (!orders)
-		goto fallback;
+		return NULL;
 
 	pte = pte_offset_map_lock(vmf->vma->vm_mm, vmf->pmd,
 				  vmf->address & PMD_MASK, &ptl);
 	if (unlikely(!pte))
-		goto fallback;
+		return NULL;
 
 	/*
 	 * For do_swap_page, find the highest order where the aligned range is
@@ -4162,6 +4241,8 @@ static struct folio *alloc_swap_folio(struct vm_fault *vmf)
 	}
 
 	pte_unmap_unlock(pte, ptl);
+	if (!orders)
+		return NULL;
 
 	/* Try allocating the highest of the remaining orders. */
 	gfp = vma_thp_gfp_mask(vma);
@@ -4177,14 +4258,53 @@ static struct folio *alloc_swap_folio(struct vm_fault *vmf)
 		order = next_order(&orders, order);
 	}
 
-fallback:
+	count_vm_event(THP_SWPIN_FALLBACK);
+	return NULL;
+}
+
+static struct folio *alloc_swap_folio(struct vm_fault *vmf)
+{
+	struct folio *folio = alloc_large_swap_folio(vmf);
+
+	if (folio) {
+		count_vm_event(THP_SWPIN);
+		return folio;
+	}
 	return __alloc_swap_folio(vmf);
 }
+
+/*
+ * Swap in a contiguously swapped out large folio through the swap cache,
+ * as one folio and one read, for devices that go through readahead.
+ */
+static struct folio *swapin_large_folio(struct vm_fault *vmf,
+					swp_entry_t entry)
+{
+	struct folio *folio = alloc_large_swap_folio(vmf);
+
+	if (!folio)
+		return NULL;
+
+	if (!swap_cache_read_large_folio(folio, entry)) {
+		count_vm_event(THP_SWPIN_FALLBACK);
+		folio_put(folio);
+		return NULL;
+	}
+
+	count_vm_event(THP_SWPIN);
+	return folio;
+}
 #else /* !CONFIG_TRANSPARENT_HUGEPAGE */
 static struct folio *alloc_swap_folio(struct vm_fault *vmf)
 {
 	return __alloc_swap_folio(vmf);
 }
+
+static struct folio *swapin_large_folio(struct vm_fault *vmf,
+					swp_entry_t entry)
+{
+	return NULL;
+}
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
 static DECLARE_WAIT_QUEUE_HEAD(swapcache_wq);
@@ -4321,8 +4441,10 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 				folio->private = NULL;
 			}
 		} else {
-			folio = swapin_readahead(entry, GFP_HIGHUSER_MOVABLE,
-						vmf);
+			folio = swapin_large_folio(vmf, entry);
+			if (!folio)
+				folio = swapin_readahead(entry,
+						GFP_HIGHUSER_MOVABLE, vmf);
 			swapcache = folio;
 		}
 
@@ -756,7 +756,7 @@ EXPORT_SYMBOL(folio_migrate_flags);
 
 static int __migrate_folio(struct address_space *mapping, struct folio *dst,
 			   struct folio *src, void *src_private,
-			   enum migrate_mode mode)
+			   enum migrate_mode mode, bool copied)
 {
 	int rc, expected_count = folio_expected_refs(mapping, src);
 
@@ -764,9 +764,12 @@ static int __migrate_folio(struct address_space *mapping, struct folio *dst,
 	if (folio_ref_count(src) != expected_count)
 		return -EAGAIN;
 
-	rc = folio_mc_copy(dst, src);
-	if (unlikely(rc))
-		return rc;
+	/* The data may already have been copied by migrate_folios_precopy() */
+	if (!copied) {
+		rc = folio_mc_copy(dst, src);
+		if (unlikely(rc))
+			return rc;
+	}
 
 	rc = __folio_migrate_mapping(mapping, dst, src, expected_count);
 	if (rc != MIGRATEPAGE_SUCCESS)
@@ -795,7 +798,7 @@ int migrate_folio(struct address_space *mapping, struct folio *dst,
 		  struct folio *src, enum migrate_mode mode)
 {
 	BUG_ON(folio_test_writeback(src));	/* Writeback must be complete */
-	return __migrate_folio(mapping, dst, src, NULL, mode);
+	return __migrate_folio(mapping, dst, src, NULL, mode, false);
 }
 EXPORT_SYMBOL(migrate_folio);
 
@@ -949,7 +952,8 @@ EXPORT_SYMBOL_GPL(buffer_migrate_folio_norefs);
 int filemap_migrate_folio(struct address_space *mapping,
 		struct folio *dst, struct folio *src, enum migrate_mode mode)
 {
-	return __migrate_folio(mapping, dst, src, folio_get_private(src), mode);
+	return __migrate_folio(mapping, dst, src, folio_get_private(src), mode,
+			       false);
 }
 EXPORT_SYMBOL_GPL(filemap_migrate_folio);
 
@@ -1033,7 +1037,7 @@ static int fallback_migrate_folio(struct address_space *mapping,
  *  MIGRATEPAGE_SUCCESS - success
  */
 static int move_to_new_folio(struct folio *dst, struct folio *src,
-				enum migrate_mode mode)
+				enum migrate_mode mode, bool copied)
 {
 	int rc = -EAGAIN;
 	bool is_lru = !__folio_test_movable(src);
@@ -1044,7 +1048,11 @@ static int move_to_new_folio(struct folio *dst, struct folio *src,
 	if (likely(is_lru)) {
 		struct address_space *mapping = folio_mapping(src);
 
-		if (!mapping)
+		if (copied)
+			/* Only migrate_folio() users are precopied */
+			rc = __migrate_folio(mapping, dst, src, NULL, mode,
+					     true);
+		else if (!mapping)
 			rc = migrate_folio(mapping, dst, src, mode);
 		else if (mapping_inaccessible(mapping))
 			rc = -EOPNOTSUPP;
@@ -1352,7 +1360,7 @@ static int migrate_folio_unmap(new_folio_t get_new_folio,
 static int migrate_folio_move(free_folio_t put_new_folio, unsigned long private,
 			      struct folio *src, struct folio *dst,
 			      enum migrate_mode mode, enum migrate_reason reason,
-			      struct list_head *ret)
+			      bool copied, struct list_head *ret)
 {
 	int rc;
 	int old_page_state = 0;
@@ -1364,7 +1372,7 @@ static int migrate_folio_move(free_folio_t put_new_folio, unsigned long private,
 	prev = dst->lru.prev;
 	list_del(&dst->lru);
 
-	rc = move_to_new_folio(dst, src, mode);
+	rc = move_to_new_folio(dst, src, mode, copied);
 	if (rc)
 		goto out;
 
@@ -1519,7 +1527,7 @@ static int unmap_and_move_huge_page(new_folio_t get_new_folio,
 	}
 
 	if (!folio_mapped(src))
-		rc = move_to_new_folio(dst, src, mode);
+		rc = move_to_new_folio(dst, src, mode, false);
 
 	if (page_was_mapped)
 		remove_migration_ptes(src,
@@ -1583,10 +1591,62 @@ static inline int try_split_folio(struct folio *folio, struct list_head *split_f
 #define NR_MAX_BATCHED_MIGRATION	512
 #endif
 #define NR_MAX_MIGRATE_PAGES_RETRY	10
+/* Smaller batches are cheaper to copy inline than to precopy */
+#define NR_MIN_PRECOPY_PAGES		32
 #define NR_MAX_MIGRATE_ASYNC_RETRY	3
 #define NR_MAX_MIGRATE_SYNC_RETRY					\
 	(NR_MAX_MIGRATE_PAGES_RETRY - NR_MAX_MIGRATE_ASYNC_RETRY)
 
+/*
+ * Folios whose data migrate_folios_precopy() may copy ahead of the move:
+ * those that move_to_new_folio() hands to migrate_folio().
+ */
+static bool migrate_folio_can_precopy(struct folio *src)
+{
+	struct address_space *mapping;
+
+	if (__folio_test_movable(src))
+		return false;
+
+	mapping = folio_mapping(src);
+	return !mapping || (!mapping_inaccessible(mapping) &&
+			    mapping->a_ops->migrate_folio == migrate_folio);
+}
+
+/*
+ * Copy the data of the unmapped folios of a batch in one go, so that it
+ * can be spread over several CPUs or offloaded to a DMA engine. On return
+ * @copied has a bit set for each folio, in @src_folios order, that only
+ * needs its metadata moved.
+ */
+static bool migrate_folios_precopy(struct list_head *src_folios,
+				   struct list_head *dst_folios,
+				   unsigned long *copied)
+{
+	unsigned int nr = 0, nr_pages = 0;
+	struct folio *src;
+
+	if (!migrate_copy_enabled())
+		return false;
+
+	bitmap_zero(copied, NR_MAX_BATCHED_MIGRATION);
+	list_for_each_entry(src, src_folios, lru) {
+		if (nr == NR_MAX_BATCHED_MIGRATION)
+			break;
+		if (migrate_folio_can_precopy(src)) {
+			__set_bit(nr, copied);
+			nr_pages += folio_nr_pages(src);
+		}
+		nr++;
+	}
+
+	if (nr_pages < NR_MIN_PRECOPY_PAGES)
+		return false;
+
+	return migrate_copy_folios(src_folios, dst_folios, copied, nr,
+				   nr_pages);
+}
+
 struct migrate_pages_stats {
 	int nr_succeeded;	/* Normal and large folios migrated successfully, in
 				   units of base pages */
@@ -1721,6 +1781,9 @@ static int migrate_pages_batch(struct list_head *from,
 	LIST_HEAD(unmap_folios);
 	LIST_HEAD(dst_folios);
 	bool nosplit = (reason == MR_NUMA_MISPLACED);
+	DECLARE_BITMAP(copied, NR_MAX_BATCHED_MIGRATION);
+	bool precopied;
+	int idx;
 
 	VM_WARN_ON_ONCE(mode != MIGRATE_ASYNC &&
 			!list_empty(from) && !list_is_singular(from));
@@ -1881,11 +1944,14 @@ static int migrate_pages_batch(struct list_head *from,
 	/* Flush TLBs for all unmapped folios */
 	try_to_unmap_flush();
 
+	precopied = migrate_folios_precopy(&unmap_folios, &dst_folios, copied);
+
 	retry = 1;
 	for (pass = 0; pass < nr_pass && retry; pass++) {
 		retry = 0;
 		thp_retry = 0;
 		nr_retry_pages = 0;
+		idx = 0;
 
 		dst = list_first_entry(&dst_folios, struct folio, lru);
 		dst2 = list_next_entry(dst, lru);
@@ -1895,9 +1961,14 @@ static int migrate_pages_batch(struct list_head *from,
 
 			cond_resched();
 
+			/* Later passes no longer line up with copied[] */
 			rc = migrate_folio_move(put_new_folio, private,
-						folio, dst, mode,
-						reason, ret_folios);
+						folio, dst, mode, reason,
+						precopied && !pass &&
+						idx < NR_MAX_BATCHED_MIGRATION &&
+						test_bit(idx, copied),
+						ret_folios);
+			idx++;
 			/*
 			 * The rules are:
 			 *	Success: folio will be freed
@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Batch copy of folio data for migrate_pages_batch().
+ *
+ * migrate_pages_batch() unmaps a whole batch of folios before it moves any
+ * of them. Once unmapped and locked the source folios cannot change, so the
+ * data of the batch can be copied up front: split across a set of kworkers,
+ * or handed to a DMA memcpy channel. The per-folio move then only has to
+ * transfer the metadata. Anything that fails to copy here is simply copied
+ * inline by the move, as before.
+ *
+ * vm.migrate_copy_workers	number of kworkers to split a batch across,
+ *				0 (the default) copies on the migrating task
+ * vm.migrate_copy_dma		offload the copy to a DMA_MEMCPY channel,
+ *				falling back to the CPU on any error
+ *
+ * The CPUs used by the kworkers can be restricted through
+ * /sys/devices/virtual/workqueue/migrate_copy/cpumask.
+ */
+
+#include <linux/bitmap.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/rwsem.h>
+#include <linux/slab.h>
+#include <linux/sysctl.h>
+#include <linux/workqueue.h>
+
+#include "internal.h"
+
+#define MIGRATE_COPY_MAX_WORKERS	16
+
+static unsigned int sysctl_migrate_copy_workers __read_mostly;
+static unsigned int sysctl_migrate_copy_dma __read_mostly;
+
+static struct workqueue_struct *migrate_copy_wq;
+
+/* Protects migrate_copy_chan against a concurrent sysctl update */
+static DECLARE_RWSEM(migrate_copy_dma_sem);
+static struct dma_chan *migrate_copy_chan;
+
+struct migrate_copy_work {
+	struct work_struct work;
+	struct folio *src;
+	struct folio *dst;
+	unsigned int start;
+	unsigned int nr;
+	unsigned long *copied;
+};
+
+bool migrate_copy_enabled(void)
+{
+	return READ_ONCE(sysctl_migrate_copy_workers) ||
+	       READ_ONCE(sysctl_migrate_copy_dma);
+}
+
+/* Copy @nr folio pairs starting at @src/@dst, clear the bit of any failure */
+static void migrate_copy_chunk(struct folio *src, struct folio *dst,
+			       unsigned int start, unsigned int nr,
+			       unsigned long *copied)
+{
+	unsigned int i;
+
+	for (i = start; i < start + nr; i++) {
+		if (test_bit(i, copied) && folio_mc_copy(dst, src))
+			clear_bit(i, copied);
+		cond_resched();
+		src = list_next_entry(src, lru);
+		dst = list_next_entry(dst, lru);
+	}
+}
+
+static void migrate_copy_work_fn(struct work_struct *work)
+{
+	struct migrate_copy_work *mcw =
+		container_of(work, struct migrate_copy_work, work);
+
+	migrate_copy_chunk(mcw->src, mcw->dst, mcw->start, mcw->nr,
+			   mcw->copied);
+}
+
+static bool migrate_copy_cpu(struct list_head *src_folios,
+			     struct list_head *dst_folios,
+			     unsigned long *copied, unsigned int nr,
+			     unsigned int nr_pages)
+{
+	struct folio *src, *dst, *chunk_src, *chunk_dst;
+	struct migrate_copy_work *works;
+	unsigned int nr_works, per_work, i, w = 0, start = 0, pages = 0;
+
+	/* The migrating task copies the last chunk itself */
+	nr_works = min3(READ_ONCE(sysctl_migrate_copy_workers), nr - 1,
+			(unsigned int)MIGRATE_COPY_MAX_WORKERS);
+	if (!nr_works || !migrate_copy_wq)
+		return false;
+
+	works = kmalloc_array(nr_works, sizeof(*works),
+			      GFP_NOWAIT | __GFP_NOWARN);
+	if (!works)
+		return false;
+
+	/* Split the batch into chunks of roughly the same number of pages */
+	per_work = DIV_ROUND_UP(nr_pages, nr_works + 1);
+	chunk_src = src = list_first_entry(src_folios, struct folio, lru);
+	chunk_dst = dst = list_first_entry(dst_folios, struct folio, lru);
+	for (i = 0; i < nr && w < nr_works; i++) {
+		pages += folio_nr_pages(src);
+		src = list_next_entry(src, lru);
+		dst = list_next_entry(dst, lru);
+
+		if (pages < per_work)
+			continue;
+
+		works[w] = (struct migrate_copy_work) {
+			.src = chunk_src,
+			.dst = chunk_dst,
+			.start = start,
+			.nr = i + 1 - start,
+			.copied = copied,
+		};
+		INIT_WORK(&works[w].work, migrate_copy_work_fn);
+		queue_work(migrate_copy_wq, &works[w].work);
+		w++;
+
+		chunk_src = src;
+		chunk_dst = dst;
+		start = i + 1;
+		pages = 0;
+	}
+
+	if (start < nr)
+		migrate_copy_chunk(chunk_src, chunk_dst, start, nr - start,
+				   copied);
+
+	for (i = 0; i < w; i++)
+		flush_work(&works[i].work);
+	kfree(works);
+
+	return true;
+}
+
+static bool migrate_copy_dma(struct list_head *src_folios,
+			     struct list_head *dst_folios,
+			     unsigned long *copied, unsigned int nr)
+{
+	struct dma_async_tx_descriptor *tx;
+	dma_cookie_t cookie = -EINVAL;
+	struct folio *src, *dst;
+	dma_addr_t *addrs;
+	struct device *dev;
+	unsigned int i, mapped = 0;
+	bool ret = false;
+
+	if (!down_read_trylock(&migrate_copy_dma_sem))
+		return false;
+	if (!migrate_copy_chan)
+		goto out_unlock;
+
+	addrs = kmalloc_array(nr * 2, sizeof(*addrs), GFP_NOWAIT | __GFP_NOWARN);
+	if (!addrs)
+		goto out_unlock;
+
+	dev = dmaengine_get_dma_device(migrate_copy_chan);
+	src = list_first_entry(src_folios, struct folio, lru);
+	dst = list_first_entry(dst_folios, struct folio, lru);
+	for (i = 0; i < nr; i++, mapped++) {
+		size_t len = folio_size(src);
+
+		addrs[2 * i] = dma_map_page(dev, folio_page(src, 0), 0, len,
+					    DMA_TO_DEVICE);
+		if (dma_mapping_error(dev, addrs[2 * i]))
+			goto out_unmap;
+
+		addrs[2 * i + 1] = dma_map_page(dev, folio_page(dst, 0), 0, len,
+						DMA_FROM_DEVICE);
+		if (dma_mapping_error(dev, addrs[2 * i + 1])) {
+			dma_unmap_page(dev, addrs[2 * i], len, DMA_TO_DEVICE);
+			goto out_unmap;
+		}
+
+		/* Folios that can't be precopied are still mapped, but skipped */
+		if (test_bit(i, copied)) {
+			tx = dmaengine_prep_dma_memcpy(migrate_copy_chan,
+						       addrs[2 * i + 1],
+						       addrs[2 * i], len,
+						       DMA_CTRL_ACK);
+			if (!tx) {
+				mapped++;
+				goto out_unmap;
+			}
+			cookie = dmaengine_submit(tx);
+			if (dma_submit_error(cookie)) {
+				mapped++;
+				goto out_unmap;
+			}
+		}
+
+		src = list_next_entry(src, lru);
+		dst = list_next_entry(dst, lru);
+	}
+
+	if (dma_submit_error(cookie))
+		goto out_unmap;
+
+	/* A channel completes its descriptors in order, wait for the last */
+	dma_async_issue_pending(migrate_copy_chan);
+	ret = dma_sync_wait(migrate_copy_chan, cookie) == DMA_COMPLETE;
+
+out_unmap:
+	if (!ret)
+		dmaengine_terminate_sync(migrate_copy_chan);
+
+	src = list_first_entry(src_folios, struct folio, lru);
+	for (i = 0; i < mapped; i++) {
+		size_t len = folio_size(src);
+
+		dma_unmap_page(dev, addrs[2 * i], len, DMA_TO_DEVICE);
+		dma_unmap_page(dev, addrs[2 * i + 1], len, DMA_FROM_DEVICE);
+		src = list_next_entry(src, lru);
+	}
+	kfree(addrs);
+out_unlock:
+	up_read(&migrate_copy_dma_sem);
+	return ret;
+}
+
+/**
+ * migrate_copy_folios() - copy the data of a batch of unmapped folios
+ * @src_folios: the locked, unmapped source folios
+ * @dst_folios: the locked destination folios, in the same order
+ * @copied: on entry, the folios to copy; on return, the folios copied
+ * @nr: number of entries on @src_folios
+ * @nr_pages: number of pages to copy
+ *
+ * Returns false if nothing was copied, in which case @copied is cleared.
+ */
+bool migrate_copy_folios(struct list_head *src_folios,
+			 struct list_head *dst_folios, unsigned long *copied,
+			 unsigned int nr, unsigned int nr_pages)
+{
+	if (READ_ONCE(sysctl_migrate_copy_dma) &&
+	    migrate_copy_dma(src_folios, dst_folios, copied, nr))
+		return true;
+
+	if (migrate_copy_cpu(src_folios, dst_folios, copied, nr, nr_pages))
+		return true;
+
+	bitmap_zero(copied, nr);
+	return false;
+}
+
+static int migrate_copy_dma_sysctl_handler(const struct ctl_table *table,
+		int write, void *buffer, size_t *length, loff_t *ppos)
+{
+	struct dma_chan *chan = NULL;
+	dma_cap_mask_t mask;
+	int ret;
+
+	down_write(&migrate_copy_dma_sem);
+	ret = proc_douintvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		goto out;
+
+	if (sysctl_migrate_copy_dma && !migrate_copy_chan) {
+		dma_cap_zero(mask);
+		dma_cap_set(DMA_MEMCPY, mask);
+		chan = dma_request_chan_by_mask(&mask);
+		if (IS_ERR(chan)) {
+			sysctl_migrate_copy_dma = 0;
+			ret = PTR_ERR(chan);
+			goto out;
+		}
+		migrate_copy_chan = chan;
+	} else if (!sysctl_migrate_copy_dma && migrate_copy_chan) {
+		dma_release_channel(migrate_copy_chan);
+		migrate_copy_chan = NULL;
+	}
+out:
+	up_write(&migrate_copy_dma_sem);
+	return ret;
+}
+
+static unsigned int migrate_copy_max_workers = MIGRATE_COPY_MAX_WORKERS;
+
+static struct ctl_table migrate_copy_sysctl_table[] = {
+	{
+		.procname	= "migrate_copy_workers",
+		.data		= &sysctl_migrate_copy_workers,
+		.maxlen		= sizeof(sysctl_migrate_copy_workers),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= &migrate_copy_max_workers,
+	},
+	{
+		.procname	= "migrate_copy_dma",
+		.data		= &sysctl_migrate_copy_dma,
+		.maxlen		= sizeof(sysctl_migrate_copy_dma),
+		.mode		= 0644,
+		.proc_handler	= migrate_copy_dma_sysctl_handler,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+};
+
+static int __init migrate_copy_init(void)
+{
+	migrate_copy_wq = alloc_workqueue("migrate_copy",
+			WQ_UNBOUND | WQ_MEM_RECLAIM | WQ_SYSFS, 0);
+	if (!migrate_copy_wq)
+		pr_warn("migrate_copy: failed to create workqueue\n");
+
+	register_sysctl_init("vm", migrate_copy_sysctl_table);
+	return 0;
+}
+subsys_initcall(migrate_copy_init);
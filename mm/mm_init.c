@@ -30,6 +30,7 @@
 #include <linux/crash_dump.h>
 #include <linux/execmem.h>
 #include <linux/vmstat.h>
+#include <linux/sizes.h>
 #include "internal.h"
 #include "slab.h"
 #include "shuffle.h"
@@ -2269,6 +2270,52 @@ void set_zone_contiguous(struct zone *zone)
 	zone->contiguous = true;
 }
 
+static bool zone_hole_found __initdata;
+
+static void __init
+zone_contiguous_chunk(unsigned long start_pfn, unsigned long end_pfn, void *arg)
+{
+	struct zone *zone = arg;
+	unsigned long pfn, block_end_pfn;
+
+	for (pfn = start_pfn; pfn < end_pfn; pfn = block_end_pfn) {
+		block_end_pfn = min(pageblock_end_pfn(pfn), end_pfn);
+
+		if (READ_ONCE(zone_hole_found))
+			return;
+		if (!__pageblock_pfn_to_page(pfn, block_end_pfn, zone)) {
+			WRITE_ONCE(zone_hole_found, true);
+			return;
+		}
+		cond_resched();
+	}
+}
+
+/*
+ * set_zone_contiguous() checks every pageblock of the zone, which takes a
+ * while on zones of terabytes.  At boot spread it over the CPUs of the
+ * zone's node.
+ */
+static void __init set_zone_contiguous_boot(struct zone *zone)
+{
+	const struct cpumask *cpumask = cpumask_of_node(zone_to_nid(zone));
+	struct padata_mt_job job = {
+		.thread_fn   = zone_contiguous_chunk,
+		.fn_arg      = zone,
+		.start       = zone->zone_start_pfn,
+		.size        = zone->spanned_pages,
+		.align       = pageblock_nr_pages,
+		.min_chunk   = SZ_1G >> PAGE_SHIFT,
+		.max_threads = max(cpumask_weight(cpumask), 1U),
+		.numa_aware  = false,
+	};
+
+	zone_hole_found = false;
+	padata_do_multithreaded(&job);
+	if (!zone_hole_found)
+		zone->contiguous = true;
+}
+
 static void __init mem_init_print_info(void);
 void __init page_alloc_init_late(void)
 {
@@ -2307,7 +2354,7 @@ void __init page_alloc_init_late(void)
 		shuffle_free_memory(NODE_DATA(nid));
 
 	for_each_populated_zone(zone)
-		set_zone_contiguous(zone);
+		set_zone_contiguous_boot(zone);
 
 	/* Initialize page ext after all struct pages are initialized. */
 	if (deferred_struct_pages)
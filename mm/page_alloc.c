@@ -45,6 +45,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/migrate.h>
 #include <linux/sched/mm.h>
+#include <linux/sched/clock.h>
 #include <linux/page_owner.h>
 #include <linux/page_table_check.h>
 #include <linux/memcontrol.h>
@@ -506,17 +507,42 @@ static void bad_page(struct page *page, const char *reason)
 	add_taint(TAINT_BAD_PAGE, LOCKDEP_NOW_UNRELIABLE);
 }
 
+#define PCP_MTHP_MAX_ORDER	(PAGE_ALLOC_COSTLY_ORDER + NR_PCP_MTHP_ORDERS)
+/* First pcp list index of the PMD sized THP lists */
+#define PCP_PMD_PINDEX		(NR_LOWORDER_PCP_LISTS + 2 * NR_PCP_MTHP_ORDERS)
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Highest mTHP order above PAGE_ALLOC_COSTLY_ORDER that is kept on the pcp
+ * lists, PAGE_ALLOC_COSTLY_ORDER if none is.
+ */
+static int percpu_pagelist_mthp_max_order = PAGE_ALLOC_COSTLY_ORDER;
+#endif
+
+static inline bool pcp_mthp_order(unsigned int order)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	return order > PAGE_ALLOC_COSTLY_ORDER && order < HPAGE_PMD_ORDER &&
+	       order <= READ_ONCE(percpu_pagelist_mthp_max_order);
+#else
+	return false;
+#endif
+}
+
 static inline unsigned int order_to_pindex(int migratetype, int order)
 {
 	bool __maybe_unused movable;
 
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	if (order > PAGE_ALLOC_COSTLY_ORDER) {
-		VM_BUG_ON(order != HPAGE_PMD_ORDER);
-
 		movable = migratetype == MIGRATE_MOVABLE;
 
-		return NR_LOWORDER_PCP_LISTS + movable;
+		if (order == HPAGE_PMD_ORDER)
+			return PCP_PMD_PINDEX + movable;
+
+		VM_BUG_ON(order > PCP_MTHP_MAX_ORDER);
+		return NR_LOWORDER_PCP_LISTS +
+		       2 * (order - PAGE_ALLOC_COSTLY_ORDER - 1) + movable;
 	}
 #else
 	VM_BUG_ON(order > PAGE_ALLOC_COSTLY_ORDER);
@@ -530,8 +556,11 @@ static inline int pindex_to_order(unsigned int pindex)
 	int order = pindex / MIGRATE_PCPTYPES;
 
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
-	if (pindex >= NR_LOWORDER_PCP_LISTS)
+	if (pindex >= PCP_PMD_PINDEX)
 		order = HPAGE_PMD_ORDER;
+	else if (pindex >= NR_LOWORDER_PCP_LISTS)
+		order = PAGE_ALLOC_COSTLY_ORDER + 1 +
+			(pindex - NR_LOWORDER_PCP_LISTS) / 2;
 #else
 	VM_BUG_ON(order > PAGE_ALLOC_COSTLY_ORDER);
 #endif
@@ -547,7 +576,34 @@ static inline bool pcp_allowed_order(unsigned int order)
 	if (order == HPAGE_PMD_ORDER)
 		return true;
 #endif
-	return false;
+	return pcp_mthp_order(order);
+}
+
+static inline enum vm_event_item zone_lock_ns_item(unsigned int order)
+{
+	static_assert(ZONE_LOCK_NS_ORDER0 + PCP_MTHP_MAX_ORDER ==
+		      ZONE_LOCK_NS_ORDER3 + NR_PCP_MTHP_ORDERS);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (order == HPAGE_PMD_ORDER)
+		return ZONE_LOCK_NS_PMD;
+#endif
+	return ZONE_LOCK_NS_ORDER0 + order;
+}
+
+/*
+ * Account how long the pcp refill and drain paths hold zone->lock, to see
+ * which orders would benefit from (more) pcp caching.
+ */
+static inline u64 zone_lock_hold_start(void)
+{
+	return IS_ENABLED(CONFIG_VM_EVENT_COUNTERS) ? local_clock() : 0;
+}
+
+static inline void zone_lock_hold_end(unsigned int order, u64 start)
+{
+	if (IS_ENABLED(CONFIG_VM_EVENT_COUNTERS))
+		count_vm_events(zone_lock_ns_item(order),
+				local_clock() - start);
 }
 
 /*
@@ -1176,9 +1232,11 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 					struct per_cpu_pages *pcp,
 					int pindex)
 {
+	unsigned int lock_order = pindex_to_order(pindex);
 	unsigned long flags;
 	unsigned int order;
 	struct page *page;
+	u64 start;
 
 	/*
 	 * Ensure proper count is passed which otherwise would stuck in the
@@ -1190,6 +1248,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	pindex = pindex - 1;
 
 	spin_lock_irqsave(&zone->lock, flags);
+	start = zone_lock_hold_start();
 
 	while (count > 0) {
 		struct list_head *list;
@@ -1222,6 +1281,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		} while (count > 0 && !list_empty(list));
 	}
 
+	zone_lock_hold_end(lock_order, start);
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
@@ -2304,9 +2364,11 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			int migratetype, unsigned int alloc_flags)
 {
 	unsigned long flags;
+	u64 start;
 	int i;
 
 	spin_lock_irqsave(&zone->lock, flags);
+	start = zone_lock_hold_start();
 	for (i = 0; i < count; ++i) {
 		struct page *page = __rmqueue(zone, order, migratetype,
 								alloc_flags);
@@ -2325,6 +2387,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 		 */
 		list_add_tail(&page->pcp_list, list);
 	}
+	zone_lock_hold_end(order, start);
 	spin_unlock_irqrestore(&zone->lock, flags);
 
 	return i;
@@ -2544,8 +2607,15 @@ static int nr_pcp_free(struct per_cpu_pages *pcp, int batch, int high, bool free
 	return batch;
 }
 
+/*
+ * mTHP folios are large compared to pcp->high, make sure that at least a
+ * couple of them fit so that nr_pcp_alloc()'s refills are not drained again
+ * on the next free.
+ */
+#define PCP_MTHP_MIN_FOLIOS	2
+
 static int nr_pcp_high(struct per_cpu_pages *pcp, struct zone *zone,
-		       int batch, bool free_high)
+		       int batch, bool free_high, unsigned int order)
 {
 	int high, high_min, high_max;
 
@@ -2574,7 +2644,7 @@ static int nr_pcp_high(struct per_cpu_pages *pcp, struct zone *zone,
 	}
 
 	if (high_min == high_max)
-		return high;
+		goto out;
 
 	if (test_bit(ZONE_BELOW_HIGH, &zone->flags)) {
 		int free_count = max_t(int, pcp->free_count, batch);
@@ -2589,6 +2659,9 @@ static int nr_pcp_high(struct per_cpu_pages *pcp, struct zone *zone,
 			pcp->high = clamp(need_high, high_min, high_max);
 	}
 
+out:
+	if (pcp_mthp_order(order))
+		high = max(high, PCP_MTHP_MIN_FOLIOS << order);
 	return high;
 }
 
@@ -2629,7 +2702,7 @@ static void free_unref_page_commit(struct zone *zone, struct per_cpu_pages *pcp,
 	}
 	if (pcp->free_count < (batch << CONFIG_PCP_BATCH_SCALE_MAX))
 		pcp->free_count += (1 << order);
-	high = nr_pcp_high(pcp, zone, batch, free_high);
+	high = nr_pcp_high(pcp, zone, batch, free_high, order);
 	if (pcp->count >= high) {
 		free_pcppages_bulk(zone, nr_pcp_free(pcp, batch, high, free_high),
 				   pcp, pindex);
@@ -6308,6 +6381,36 @@ static int percpu_pagelist_high_fraction_sysctl_handler(const struct ctl_table *
 	return ret;
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+static int pcp_mthp_order_min = PAGE_ALLOC_COSTLY_ORDER;
+static int pcp_mthp_order_max = PCP_MTHP_MAX_ORDER;
+
+/*
+ * percpu_pagelist_mthp_max_order - the highest order above
+ * PAGE_ALLOC_COSTLY_ORDER (other than the PMD order) that is cached on the
+ * per cpu pagelists. Pages of orders that are no longer cached are drained.
+ */
+static int percpu_pagelist_mthp_max_order_sysctl_handler(const struct ctl_table *table,
+		int write, void *buffer, size_t *length, loff_t *ppos)
+{
+	int old_order;
+	int ret;
+
+	mutex_lock(&pcp_batch_high_lock);
+	old_order = percpu_pagelist_mthp_max_order;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || ret < 0)
+		goto out;
+
+	if (percpu_pagelist_mthp_max_order < old_order)
+		drain_all_pages(NULL);
+out:
+	mutex_unlock(&pcp_batch_high_lock);
+	return ret;
+}
+#endif
+
 static struct ctl_table page_alloc_sysctl_table[] = {
 	{
 		.procname	= "min_free_kbytes",
@@ -6342,6 +6445,17 @@ static struct ctl_table page_alloc_sysctl_table[] = {
 		.proc_handler	= percpu_pagelist_high_fraction_sysctl_handler,
 		.extra1		= SYSCTL_ZERO,
 	},
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	{
+		.procname	= "percpu_pagelist_mthp_max_order",
+		.data		= &percpu_pagelist_mthp_max_order,
+		.maxlen		= sizeof(percpu_pagelist_mthp_max_order),
+		.mode		= 0644,
+		.proc_handler	= percpu_pagelist_mthp_max_order_sysctl_handler,
+		.extra1		= &pcp_mthp_order_min,
+		.extra2		= &pcp_mthp_order_max,
+	},
+#endif
 	{
 		.procname	= "lowmem_reserve_ratio",
 		.data		= &sysctl_lowmem_reserve_ratio,
@@ -1725,6 +1725,212 @@ static void pcpu_alloc_tag_free_hook(struct pcpu_chunk *chunk, int off, size_t s
 }
 #endif
 
+/*
+ * Per-CPU caches of small areas.
+ *
+ * Small power-of-two sized allocations are served from per-CPU arrays of
+ * areas which pcpu_balance_workfn() allocates ahead of time from populated
+ * pages.  This keeps the common small allocations of percpu counters and
+ * refs off pcpu_lock and pcpu_alloc_mutex.  Only the exact size of an area
+ * is served from its class because free_percpu() frees and uncharges the
+ * size recorded in the chunk.  Cached areas count as allocated for the
+ * chunk and in the stats.
+ *
+ * A cached area takes its size on every unit, so all the caches together
+ * would pin memory quadratic in the number of CPUs.  The depth of the
+ * arrays is chosen at boot so that the cache of one CPU holds at most
+ * PCPU_CACHE_CPU_BYTES over all units, which disables the caches on very
+ * large machines.  A class is only refilled on the CPUs that allocated
+ * from it since the last balance, and drained on the others.
+ */
+#define PCPU_CACHE_MAX_SHIFT	6	/* 64 bytes */
+#define PCPU_CACHE_NR_CLASSES	(PCPU_CACHE_MAX_SHIFT - PCPU_MIN_ALLOC_SHIFT + 1)
+#define PCPU_CACHE_SIZE		16
+#define PCPU_CACHE_CPU_BYTES	SZ_64K
+
+struct pcpu_area_cache {
+	spinlock_t lock;
+	/* classes allocated from since the last refill */
+	unsigned long used;
+	unsigned int nr[PCPU_CACHE_NR_CLASSES];
+	void *addrs[PCPU_CACHE_NR_CLASSES][PCPU_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct pcpu_area_cache, pcpu_area_caches) = {
+	.lock = __SPIN_LOCK_UNLOCKED(pcpu_area_caches.lock),
+};
+
+/* Areas per class and CPU, 0 until percpu_enable_async() */
+static unsigned int pcpu_cache_depth __ro_after_init;
+
+static void __init pcpu_cache_init_depth(void)
+{
+	/* The bytes of one area of each class */
+	size_t bytes = (2UL << PCPU_CACHE_MAX_SHIFT) - PCPU_MIN_ALLOC_SIZE;
+
+	pcpu_cache_depth = min_t(size_t, PCPU_CACHE_SIZE,
+				 PCPU_CACHE_CPU_BYTES / (bytes * pcpu_nr_units));
+}
+
+static int pcpu_cache_class(size_t size, size_t align)
+{
+	if (size > (1 << PCPU_CACHE_MAX_SHIFT) || !is_power_of_2(size) ||
+	    align > size)
+		return -1;
+	return ilog2(size) - PCPU_MIN_ALLOC_SHIFT;
+}
+
+/* Returns the address of a cached area of @size, or NULL */
+static void *pcpu_cache_alloc(size_t size, size_t align)
+{
+	struct pcpu_area_cache *pac;
+	int class = pcpu_cache_class(size, align);
+	unsigned long flags;
+	void *addr = NULL;
+	unsigned int nr;
+
+	if (class < 0 || !pcpu_cache_depth)
+		return NULL;
+
+	/* Being migrated away only means using another CPU's cache */
+	pac = raw_cpu_ptr(&pcpu_area_caches);
+	spin_lock_irqsave(&pac->lock, flags);
+	pac->used |= BIT(class);
+	nr = pac->nr[class];
+	if (nr) {
+		addr = pac->addrs[class][--nr];
+		pac->nr[class] = nr;
+	}
+	spin_unlock_irqrestore(&pac->lock, flags);
+
+	if (nr <= pcpu_cache_depth / 2)
+		pcpu_schedule_balance_work();
+
+	return addr;
+}
+
+/*
+ * Allocate from populated pages of the normal chunks, as an atomic
+ * allocation would.
+ */
+static int pcpu_cache_alloc_area(struct pcpu_chunk **chunkp, int bits)
+{
+	struct pcpu_chunk *chunk, *next;
+	int slot, off;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	for (slot = pcpu_size_to_slot(bits << PCPU_MIN_ALLOC_SHIFT);
+	     slot <= pcpu_free_slot; slot++) {
+		list_for_each_entry_safe(chunk, next, &pcpu_chunk_lists[slot],
+					 list) {
+			off = pcpu_find_block_fit(chunk, bits, bits, true);
+			if (off < 0)
+				continue;
+
+			off = pcpu_alloc_area(chunk, bits, bits, off);
+			if (off >= 0) {
+				pcpu_reintegrate_chunk(chunk);
+				*chunkp = chunk;
+				return off;
+			}
+		}
+	}
+
+	return -ENOSPC;
+}
+
+/*
+ * Drain or refill one class of one CPU's cache.  The areas are freed and
+ * allocated under pcpu_lock only, the cache's own lock is just held to
+ * take them out or hand them over.  Returns false once populated pages
+ * run out.
+ */
+static bool pcpu_refill_area_cache(struct pcpu_area_cache *pac, int class)
+{
+	int bits = 1 << class;
+	void *addrs[PCPU_CACHE_SIZE];
+	struct pcpu_chunk *chunk;
+	unsigned int i, nr = 0;
+	int off = 0;
+	bool used;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	spin_lock(&pac->lock);
+	used = pac->used & BIT(class);
+	pac->used &= ~BIT(class);
+	if (!used) {
+		nr = pac->nr[class];
+		memcpy(addrs, pac->addrs[class], nr * sizeof(addrs[0]));
+		pac->nr[class] = 0;
+	}
+	i = pac->nr[class];
+	spin_unlock(&pac->lock);
+
+	if (!used) {
+		for (i = 0; i < nr; i++) {
+			chunk = pcpu_chunk_addr_search(addrs[i]);
+			pcpu_free_area(chunk, addrs[i] - chunk->base_addr);
+		}
+		return true;
+	}
+
+	/* Only pcpu_balance_workfn() adds to the cache, it can only shrink. */
+	for (; i < pcpu_cache_depth; i++, nr++) {
+		off = pcpu_cache_alloc_area(&chunk, bits);
+		if (off < 0)
+			break;
+		pcpu_stats_area_alloc(chunk, bits << PCPU_MIN_ALLOC_SHIFT);
+		addrs[nr] = chunk->base_addr + off;
+	}
+
+	spin_lock(&pac->lock);
+	memcpy(&pac->addrs[class][pac->nr[class]], addrs, nr * sizeof(addrs[0]));
+	pac->nr[class] += nr;
+	spin_unlock(&pac->lock);
+
+	return off >= 0;
+}
+
+/**
+ * pcpu_refill_area_caches - refill the per-CPU caches of small areas
+ *
+ * Refills the classes the CPUs allocated from and drains the others.
+ * Stops filling at the first area that can't be allocated from populated
+ * pages.  Called before pcpu_balance_populated(), which replenishes the
+ * empty populated pages used here.
+ *
+ * CONTEXT:
+ * pcpu_lock (can be released and reacquired between CPUs).
+ */
+static void pcpu_refill_area_caches(void)
+{
+	unsigned int cpu;
+	int class;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	if (!pcpu_cache_depth)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct pcpu_area_cache *pac = per_cpu_ptr(&pcpu_area_caches, cpu);
+
+		if (!READ_ONCE(pac->used) && !memchr_inv(pac->nr, 0, sizeof(pac->nr)))
+			continue;
+
+		for (class = 0; class < PCPU_CACHE_NR_CLASSES; class++)
+			if (!pcpu_refill_area_cache(pac, class))
+				return;
+
+		/* Don't keep interrupts off over all CPUs */
+		spin_unlock_irq(&pcpu_lock);
+		cond_resched();
+		spin_lock_irq(&pcpu_lock);
+	}
+}
+
 /**
  * pcpu_alloc - the percpu allocator
  * @size: size of area to allocate in bytes
@@ -1784,6 +1990,16 @@ void __percpu *pcpu_alloc_noprof(size_t size, size_t align, bool reserved,
 	if (unlikely(!pcpu_memcg_pre_alloc_hook(size, gfp, &objcg)))
 		return NULL;
 
+	if (!reserved) {
+		void *addr = pcpu_cache_alloc(size, align);
+
+		if (addr) {
+			chunk = pcpu_chunk_addr_search(addr);
+			off = addr - chunk->base_addr;
+			goto area_ready;
+		}
+	}
+
 	if (!is_atomic) {
 		/*
 		 * pcpu_balance_workfn() allocates memory under this mutex,
@@ -1894,6 +2110,7 @@ void __percpu *pcpu_alloc_noprof(size_t size, size_t align, bool reserved,
 	if (pcpu_nr_empty_pop_pages < PCPU_EMPTY_POP_PAGES_LOW)
 		pcpu_schedule_balance_work();
 
+area_ready:
 	/* clear the areas and return address relative to base address */
 	for_each_possible_cpu(cpu)
 		memset((void *)pcpu_chunk_addr(chunk, cpu, 0) + off, 0, size);
@@ -2209,6 +2426,7 @@ static void pcpu_balance_workfn(struct work_struct *work)
 
 	pcpu_balance_free(false);
 	pcpu_reclaim_populated();
+	pcpu_refill_area_caches();
 	pcpu_balance_populated();
 	pcpu_balance_free(true);
 
@@ -3400,6 +3618,7 @@ unsigned long pcpu_nr_pages(void)
  */
 static int __init percpu_enable_async(void)
 {
+	pcpu_cache_init_depth();
 	pcpu_async_enabled = true;
 	return 0;
 }
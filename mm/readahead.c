@@ -125,12 +125,46 @@
 #include <linux/syscalls.h>
 #include <linux/file.h>
 #include <linux/mm_inline.h>
+#include <linux/pagevec.h>
 #include <linux/blk-cgroup.h>
 #include <linux/fadvise.h>
 #include <linux/sched/mm.h>
+#include <linux/sysctl.h>
 
 #include "internal.h"
 
+/*
+ * vm.readahead_folio_ramp: remember in the address_space the folio order
+ * that sequential readahead reached, so that a later stream on the file,
+ * even through another open, starts from there. Once a stream is confirmed
+ * sequential by hitting the readahead marker, jump to that order and keep
+ * doubling it rather than growing it by two each round.
+ */
+static unsigned int sysctl_readahead_folio_ramp __read_mostly;
+
+static inline unsigned int mapping_ra_order(struct address_space *mapping)
+{
+	return (READ_ONCE(mapping->flags) & AS_RA_ORDER_MASK) >> AS_RA_ORDER;
+}
+
+static void mapping_set_ra_order(struct address_space *mapping,
+				 unsigned int order)
+{
+	unsigned long old = READ_ONCE(mapping->flags), new;
+
+	do {
+		new = (old & ~AS_RA_ORDER_MASK) | (order << AS_RA_ORDER);
+		if (new == old)
+			return;
+	} while (!try_cmpxchg(&mapping->flags, &old, new));
+}
+
+static inline bool ra_folio_ramp(struct address_space *mapping)
+{
+	return READ_ONCE(sysctl_readahead_folio_ramp) &&
+	       mapping_large_folio_support(mapping);
+}
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -188,6 +222,59 @@ static void read_pages(struct readahead_control *rac)
 	BUG_ON(readahead_count(rac));
 }
 
+/*
+ * Allocate folios for the run of absent indices starting at @index, at most
+ * @nr_pages long, and add them to the page cache as one batch.  Returns the
+ * number of pages added to @ractl, 0 if the caller should fall back to
+ * adding a single folio.
+ */
+static unsigned long ra_add_folios(struct readahead_control *ractl,
+		pgoff_t index, unsigned long nr_pages, pgoff_t mark, gfp_t gfp)
+{
+	struct address_space *mapping = ractl->mapping;
+	unsigned int min_order = mapping_min_folio_order(mapping);
+	unsigned int min_nrpages = mapping_min_folio_nrpages(mapping);
+	struct folio_batch fbatch;
+	unsigned int i, added;
+	unsigned long n;
+
+	folio_batch_init(&fbatch);
+	for (n = 0; n < nr_pages && folio_batch_space(&fbatch); n += min_nrpages) {
+		struct folio *folio;
+
+		if (n) {
+			folio = xa_load(&mapping->i_pages, index + n);
+			if (folio && !xa_is_value(folio))
+				break;
+		}
+
+		folio = filemap_alloc_folio(gfp, min_order);
+		if (!folio)
+			break;
+		folio_batch_add(&fbatch, folio);
+	}
+
+	/* Not worth it for a single folio */
+	added = 0;
+	if (folio_batch_count(&fbatch) > 1)
+		added = filemap_add_folios(mapping, &fbatch, index, gfp);
+
+	for (i = 0; i < folio_batch_count(&fbatch); i++) {
+		struct folio *folio = fbatch.folios[i];
+
+		if (i >= added) {
+			folio_put(folio);
+			continue;
+		}
+		if (folio->index == mark)
+			folio_set_readahead(folio);
+		ractl->_workingset |= folio_test_workingset(folio);
+		ractl->_nr_pages += min_nrpages;
+	}
+
+	return (unsigned long)added * min_nrpages;
+}
+
 /**
  * page_cache_ra_unbounded - Start unchecked readahead.
  * @ractl: Readahead control.
@@ -243,6 +330,7 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 	 */
 	while (i < nr_to_read) {
 		struct folio *folio = xa_load(&mapping->i_pages, index + i);
+		unsigned long nr;
 		int ret;
 
 		if (folio && !xa_is_value(folio)) {
@@ -260,6 +348,18 @@ void page_cache_ra_unbounded(struct readahead_control *ractl,
 			continue;
 		}
 
+		/*
+		 * Add the run of missing folios under a single i_pages lock
+		 * and memcg charge.  Whatever stopped the batch is handled
+		 * by the single folio path below.
+		 */
+		nr = ra_add_folios(ractl, index + i, nr_to_read - i,
+				   ra_folio_index, gfp_mask);
+		if (nr) {
+			i += nr;
+			continue;
+		}
+
 		folio = filemap_alloc_folio(gfp_mask,
 					    mapping_min_folio_order(mapping));
 		if (!folio)
@@ -446,6 +546,7 @@ static inline int ra_alloc_folio(struct readahead_control *ractl, pgoff_t index,
 
 	ractl->_nr_pages += 1UL << order;
 	ractl->_workingset |= folio_test_workingset(folio);
+	count_mthp_stat(order, MTHP_STAT_FILE_RA_ALLOC);
 	return 0;
 }
 
@@ -508,6 +609,9 @@ void page_cache_ra_order(struct readahead_control *ractl,
 	filemap_invalidate_unlock_shared(mapping);
 	memalloc_nofs_restore(nofs);
 
+	if (ra_folio_ramp(mapping) && new_order > mapping_ra_order(mapping))
+		mapping_set_ra_order(mapping, new_order);
+
 	/*
 	 * If there were already pages in the page cache, then we may have
 	 * left some gaps.  Let the regular readahead code take care of this
@@ -542,6 +646,7 @@ void page_cache_sync_ra(struct readahead_control *ractl,
 	struct file_ra_state *ra = ractl->ra;
 	unsigned long max_pages, contig_count;
 	pgoff_t prev_index, miss;
+	unsigned int order;
 
 	/*
 	 * Even if readahead is disabled, issue this request as readahead
@@ -590,6 +695,10 @@ void page_cache_sync_ra(struct readahead_control *ractl,
 	 * readahead state.
 	 */
 	if (contig_count <= req_count) {
+		order = mapping_ra_order(ractl->mapping);
+		if (order && ra_folio_ramp(ractl->mapping))
+			mapping_set_ra_order(ractl->mapping,
+					     order > 2 ? order - 2 : 0);
 		do_page_cache_ra(ractl, req_count, 0);
 		return;
 	}
@@ -604,10 +713,33 @@ void page_cache_sync_ra(struct readahead_control *ractl,
 	ra->async_size = 1;
 readit:
 	ractl->_index = ra->start;
-	page_cache_ra_order(ractl, ra, 0);
+	order = ra_folio_ramp(ractl->mapping) ?
+		mapping_ra_order(ractl->mapping) : 0;
+	page_cache_ra_order(ractl, ra, order);
 }
 EXPORT_SYMBOL_GPL(page_cache_sync_ra);
 
+/*
+ * The stream is sequential: skip to the order remembered for the mapping,
+ * or double the current one, and make room in the window for a folio of
+ * the order page_cache_ra_order() will then try.
+ */
+static unsigned int ra_ramp_order(struct address_space *mapping,
+				  struct file_ra_state *ra, unsigned int order)
+{
+	unsigned int max_order = mapping_max_folio_order(mapping);
+	unsigned long nr;
+
+	order = min(max(order * 2, mapping_ra_order(mapping)), max_order);
+	nr = 1UL << min(order + 2, max_order);
+	if (ra->size < nr) {
+		ra->size = nr;
+		ra->async_size = nr;
+	}
+
+	return order;
+}
+
 void page_cache_async_ra(struct readahead_control *ractl,
 		struct folio *folio, unsigned long req_count)
 {
@@ -647,6 +779,8 @@ void page_cache_async_ra(struct readahead_control *ractl,
 		 */
 		ra->size = max(ra->size, get_next_ra_size(ra, max_pages));
 		ra->async_size = ra->size;
+		if (ra_folio_ramp(ractl->mapping))
+			order = ra_ramp_order(ractl->mapping, ra, order);
 		goto readit;
 	}
 
@@ -807,3 +941,22 @@ void readahead_expand(struct readahead_control *ractl,
 	}
 }
 EXPORT_SYMBOL(readahead_expand);
+
+static struct ctl_table readahead_sysctl_table[] = {
+	{
+		.procname	= "readahead_folio_ramp",
+		.data		= &sysctl_readahead_folio_ramp,
+		.maxlen		= sizeof(sysctl_readahead_folio_ramp),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+};
+
+static int __init readahead_sysctl_init(void)
+{
+	register_sysctl_init("vm", readahead_sysctl_table);
+	return 0;
+}
+subsys_initcall(readahead_sysctl_init);
@@ -76,6 +76,7 @@ static struct vfsmount *shm_mnt __ro_after_init;
 #include <linux/syscalls.h>
 #include <linux/fcntl.h>
 #include <uapi/linux/memfd.h>
+#include <uapi/linux/tmpfs.h>
 #include <linux/rmap.h>
 #include <linux/uuid.h>
 #include <linux/quotaops.h>
@@ -1664,6 +1665,7 @@ unsigned long shmem_allowable_huge_orders(struct inode *inode,
 	unsigned long mask = READ_ONCE(huge_shmem_orders_always);
 	unsigned long within_size_orders = READ_ONCE(huge_shmem_orders_within_size);
 	unsigned long vm_flags = vma ? vma->vm_flags : 0;
+	unsigned long folio_orders;
 	pgoff_t aligned_index;
 	bool global_huge;
 	loff_t i_size;
@@ -1672,6 +1674,21 @@ unsigned long shmem_allowable_huge_orders(struct inode *inode,
 	if (thp_disabled_by_hw() || (vma && vma_thp_disabled(vma, vm_flags)))
 		return 0;
 
+	/*
+	 * The orders chosen for the file override the sysfs policy, and the
+	 * huge= option of the mount unless that is huge=never.  The internal
+	 * mount's huge is a copy of shmem_enabled, not a choice of the user.
+	 */
+	folio_orders = READ_ONCE(SHMEM_I(inode)->folio_orders);
+	if (folio_orders && !shmem_huge_force && S_ISREG(inode->i_mode)) {
+		if (shmem_huge == SHMEM_HUGE_DENY)
+			return 0;
+		if (inode->i_sb != shm_mnt->mnt_sb &&
+		    SHMEM_SB(inode->i_sb)->huge == SHMEM_HUGE_NEVER)
+			return 0;
+		return THP_ORDERS_ALL_FILE_DEFAULT & folio_orders;
+	}
+
 	global_huge = shmem_huge_global_enabled(inode, index, write_end,
 					shmem_huge_force, vma, vm_flags);
 	if (!vma || !vma_is_anon_shmem(vma)) {
@@ -3888,6 +3905,32 @@ static const char *shmem_get_link(struct dentry *dentry, struct inode *inode,
 	return folio_address(folio);
 }
 
+static long shmem_file_ioctl(struct file *file, unsigned int cmd,
+			     unsigned long arg)
+{
+	struct inode *inode = file_inode(file);
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	u64 __user *argp = (u64 __user *)arg;
+	u64 orders, valid = BIT(0);
+
+	switch (cmd) {
+	case TMPFS_IOC_GET_FOLIO_ORDERS:
+		return put_user((u64)READ_ONCE(info->folio_orders), argp);
+	case TMPFS_IOC_SET_FOLIO_ORDERS:
+		if (!inode_owner_or_capable(file_mnt_idmap(file), inode))
+			return -EPERM;
+		if (get_user(orders, argp))
+			return -EFAULT;
+		if (IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE))
+			valid |= THP_ORDERS_ALL_FILE_DEFAULT;
+		if (orders & ~valid)
+			return -EINVAL;
+		WRITE_ONCE(info->folio_orders, orders);
+		return 0;
+	}
+	return -ENOTTY;
+}
+
 #ifdef CONFIG_TMPFS_XATTR
 
 static int shmem_fileattr_get(struct dentry *dentry, struct fileattr *fa)
@@ -4825,6 +4868,8 @@ static const struct file_operations shmem_file_operations = {
 	.open		= shmem_file_open,
 	.get_unmapped_area = shmem_get_unmapped_area,
 #ifdef CONFIG_TMPFS
+	.unlocked_ioctl	= shmem_file_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
 	.llseek		= shmem_file_llseek,
 	.read_iter	= shmem_file_read_iter,
 	.write_iter	= shmem_file_write_iter,
@@ -3,6 +3,12 @@
 #include <linux/rwsem.h>
 #include <linux/shrinker.h>
 #include <linux/rculist.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/mm.h>
+#include <linux/swap.h>
+#include <linux/sysctl.h>
+#include <linux/wait_bit.h>
+#include <linux/workqueue.h>
 #include <trace/events/vmscan.h>
 
 #include "internal.h"
@@ -380,6 +386,7 @@ static unsigned long do_shrink_slab(struct shrink_control *shrinkctl,
 	long batch_size = shrinker->batch ? shrinker->batch
 					  : SHRINK_BATCH;
 	long scanned = 0, next_deferred;
+	u64 start = IS_ENABLED(CONFIG_SHRINKER_DEBUG) ? local_clock() : 0;
 
 	freeable = shrinker->count_objects(shrinker, shrinkctl);
 	if (freeable == 0 || freeable == SHRINK_EMPTY)
@@ -461,6 +468,7 @@ static unsigned long do_shrink_slab(struct shrink_control *shrinkctl,
 	 */
 	new_nr = add_nr_deferred(next_deferred, shrinker, shrinkctl);
 
+	shrinker_debugfs_record_latency(shrinker, start);
 	trace_mm_shrink_slab_end(shrinker, shrinkctl->nid, freed, nr, new_nr, total_scan);
 	return freed;
 }
@@ -675,6 +683,175 @@ unsigned long shrink_slab(gfp_t gfp_mask, int nid, struct mem_cgroup *memcg,
 	return freed;
 }
 
+/*
+ * Parallel slab shrinking.
+ *
+ * The slab caches of different memcgs are tracked on separate list_lru
+ * lists, so shrinking one memcg's objects does not contend with shrinking
+ * another's. When vm.shrink_slab_workers is set, a reclaimer walking the
+ * memcg tree hands the per-memcg shrink_slab() calls to a pool of kworkers
+ * instead of running them inline, and collects the result once the walk is
+ * done. At most vm.shrink_slab_workers memcgs are in flight per reclaimer.
+ *
+ * The kworkers run with PF_MEMALLOC set so that a shrinker allocation can't
+ * recurse into reclaim, and credit the slab pages they free back to the
+ * reclaimer through the batch.
+ */
+#define SHRINK_SLAB_MAX_WORKERS	64
+
+static unsigned int sysctl_shrink_slab_workers __read_mostly;
+static struct workqueue_struct *shrink_slab_wq;
+
+struct shrink_slab_work {
+	struct work_struct work;
+	struct shrink_slab_batch *batch;
+	struct mem_cgroup *memcg;
+};
+
+static void shrink_slab_work_fn(struct work_struct *work)
+{
+	struct shrink_slab_work *ssw =
+		container_of(work, struct shrink_slab_work, work);
+	struct shrink_slab_batch *batch = ssw->batch;
+	struct reclaim_state reclaim_state = {};
+	unsigned int noreclaim_flag;
+	unsigned long freed;
+
+	noreclaim_flag = memalloc_noreclaim_save();
+	current->reclaim_state = &reclaim_state;
+
+	freed = shrink_slab(batch->gfp_mask, batch->nid, ssw->memcg,
+			    batch->priority);
+
+	current->reclaim_state = NULL;
+	memalloc_noreclaim_restore(noreclaim_flag);
+
+	atomic_long_add(freed, &batch->freed);
+	atomic_long_add(reclaim_state.reclaimed, &batch->reclaimed);
+	mem_cgroup_put(ssw->memcg);
+	kfree(ssw);
+
+	/*
+	 * The batch lives on the reclaimer's stack and may be gone as soon as
+	 * pending drops, wake_up_var() only hashes the address.
+	 */
+	atomic_dec(&batch->pending);
+	smp_mb__after_atomic();
+	wake_up_var(&batch->pending);
+}
+
+/**
+ * shrink_slab_batch_init() - prepare a batch of per-memcg slab shrinking
+ * @batch: the batch, usually on the caller's stack
+ * @gfp_mask: allocation context of the reclaimer
+ * @nid: node to shrink
+ * @priority: reclaim priority
+ *
+ * Must be paired with shrink_slab_batch_finish().
+ */
+void shrink_slab_batch_init(struct shrink_slab_batch *batch, gfp_t gfp_mask,
+			    int nid, int priority)
+{
+	batch->gfp_mask = gfp_mask;
+	batch->nid = nid;
+	batch->priority = priority;
+	batch->nr_workers = shrink_slab_wq ?
+			    READ_ONCE(sysctl_shrink_slab_workers) : 0;
+	atomic_set(&batch->pending, 0);
+	atomic_long_set(&batch->freed, 0);
+	atomic_long_set(&batch->reclaimed, 0);
+}
+
+/**
+ * shrink_slab_batch_add() - shrink the slab caches of a memcg
+ * @batch: the batch set up by shrink_slab_batch_init()
+ * @memcg: the memcg to shrink
+ *
+ * Queues @memcg for shrinking by the kworkers, or shrinks it right away if
+ * parallel shrinking is disabled or not worthwhile for @memcg. Waits for a
+ * previously queued memcg to be done if the batch has too many in flight.
+ */
+void shrink_slab_batch_add(struct shrink_slab_batch *batch,
+			   struct mem_cgroup *memcg)
+{
+	struct shrink_slab_work *ssw;
+
+	/* The root memcg runs the global shrinkers, keep those inline */
+	if (!batch->nr_workers || mem_cgroup_disabled() ||
+	    mem_cgroup_is_root(memcg))
+		goto inline_shrink;
+
+	ssw = kmalloc(sizeof(*ssw), GFP_NOWAIT | __GFP_NOWARN);
+	if (!ssw)
+		goto inline_shrink;
+
+	if (!mem_cgroup_tryget(memcg)) {
+		kfree(ssw);
+		goto inline_shrink;
+	}
+
+	wait_var_event(&batch->pending,
+		       atomic_read(&batch->pending) < batch->nr_workers);
+
+	INIT_WORK(&ssw->work, shrink_slab_work_fn);
+	ssw->batch = batch;
+	ssw->memcg = memcg;
+	atomic_inc(&batch->pending);
+	queue_work(shrink_slab_wq, &ssw->work);
+	return;
+
+inline_shrink:
+	atomic_long_add(shrink_slab(batch->gfp_mask, batch->nid, memcg,
+				    batch->priority), &batch->freed);
+}
+
+/**
+ * shrink_slab_batch_finish() - wait for a batch of slab shrinking
+ * @batch: the batch set up by shrink_slab_batch_init()
+ *
+ * Credits the slab pages freed by the kworkers to the calling reclaimer.
+ *
+ * Returns the number of reclaimed slab objects.
+ */
+unsigned long shrink_slab_batch_finish(struct shrink_slab_batch *batch)
+{
+	unsigned long reclaimed;
+
+	wait_var_event(&batch->pending, !atomic_read(&batch->pending));
+
+	reclaimed = atomic_long_read(&batch->reclaimed);
+	if (reclaimed)
+		mm_account_reclaimed_pages(reclaimed);
+
+	return atomic_long_read(&batch->freed);
+}
+
+static unsigned int shrink_slab_max_workers = SHRINK_SLAB_MAX_WORKERS;
+
+static struct ctl_table shrink_slab_sysctl_table[] = {
+	{
+		.procname	= "shrink_slab_workers",
+		.data		= &sysctl_shrink_slab_workers,
+		.maxlen		= sizeof(sysctl_shrink_slab_workers),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= &shrink_slab_max_workers,
+	},
+};
+
+static int __init shrink_slab_init(void)
+{
+	shrink_slab_wq = alloc_workqueue("shrink_slab",
+			WQ_UNBOUND | WQ_MEM_RECLAIM | WQ_SYSFS, 0);
+	if (!shrink_slab_wq)
+		pr_warn("shrink_slab: failed to create workqueue\n");
+
+	register_sysctl_init("vm", shrink_slab_sysctl_table);
+	return 0;
+}
+subsys_initcall(shrink_slab_init);
+
 struct shrinker *shrinker_alloc(unsigned int flags, const char *fmt, ...)
 {
 	struct shrinker *shrinker;
@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0
 #include <linux/idr.h>
+#include <linux/sched/clock.h>
 #include <linux/slab.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
@@ -159,6 +160,35 @@ static const struct file_operations shrinker_debugfs_scan_fops = {
 	.write	 = shrinker_debugfs_scan_write,
 };
 
+/*
+ * Bucket 0 counts the calls that took less than 1us, bucket i the ones that
+ * took [2^(i-1), 2^i) us, and the last bucket everything slower.
+ */
+void shrinker_debugfs_record_latency(struct shrinker *shrinker, u64 start)
+{
+	u64 us = div_u64(local_clock() - start, NSEC_PER_USEC);
+	unsigned int bucket = us ? ilog2(us) + 1 : 0;
+
+	bucket = min(bucket, SHRINKER_NR_LATENCY - 1);
+	atomic_long_inc(&shrinker->latency[bucket]);
+}
+
+static int shrinker_debugfs_latency_show(struct seq_file *m, void *v)
+{
+	struct shrinker *shrinker = m->private;
+	int i;
+
+	seq_printf(m, "<1us %ld\n", atomic_long_read(&shrinker->latency[0]));
+	for (i = 1; i < SHRINKER_NR_LATENCY - 1; i++)
+		seq_printf(m, "<%luus %ld\n", 1UL << i,
+			   atomic_long_read(&shrinker->latency[i]));
+	seq_printf(m, ">=%luus %ld\n", 1UL << (SHRINKER_NR_LATENCY - 2),
+		   atomic_long_read(&shrinker->latency[i]));
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(shrinker_debugfs_latency);
+
 int shrinker_debugfs_add(struct shrinker *shrinker)
 {
 	struct dentry *entry;
@@ -190,6 +220,8 @@ int shrinker_debugfs_add(struct shrinker *shrinker)
 			    &shrinker_debugfs_count_fops);
 	debugfs_create_file("scan", 0220, entry, shrinker,
 			    &shrinker_debugfs_scan_fops);
+	debugfs_create_file("latency", 0440, entry, shrinker,
+			    &shrinker_debugfs_latency_fops);
 	return 0;
 }
 
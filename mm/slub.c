@@ -373,6 +373,14 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_PCS,		/* Allocation from percpu sheaf */
+	FREE_PCS,		/* Free to percpu sheaf */
+	SHEAF_SWAP,		/* Swap of main and spare percpu sheaf */
+	SHEAF_FLUSH,		/* Objects flushed from a sheaf to slabs */
+	BARN_GET,		/* Full sheaf taken from the node barn */
+	BARN_PUT,		/* Full sheaf put into the node barn */
+	FREE_REMOTE_BATCH,	/* Free added to the remote free batch */
+	FREE_REMOTE_FLUSH,	/* Remote free batch flushed to its slab */
 	NR_SLUB_STAT_ITEMS
 };
 
@@ -393,6 +401,10 @@ struct kmem_cache_cpu {
 #ifdef CONFIG_SLUB_CPU_PARTIAL
 	struct slab *partial;	/* Partially allocated slabs */
 #endif
+	struct slab *rfree_slab;	/* Slab of the batched remote frees */
+	void *rfree_head;	/* Batched remote frees, linked */
+	void *rfree_tail;
+	unsigned int rfree_cnt;
 	local_lock_t lock;	/* Protects the fields above */
 #ifdef CONFIG_SLUB_STATS
 	unsigned int stat[NR_SLUB_STAT_ITEMS];
@@ -419,6 +431,36 @@ void stat_add(const struct kmem_cache *s, enum stat_item si, int v)
 #endif
 }
 
+#ifndef CONFIG_SLUB_TINY
+/*
+ * An array of free objects, cached per cpu in front of the cpu slab for caches
+ * with a sheaf_capacity. See alloc_from_pcs() and free_to_pcs().
+ */
+struct slab_sheaf {
+	struct list_head barn_list;
+	unsigned int size;
+	void *objects[];
+};
+
+struct slub_percpu_sheaves {
+	local_lock_t lock;		/* Protects the fields below */
+	struct slab_sheaf *main;	/* Never NULL */
+	struct slab_sheaf *spare;	/* Empty or full, may be NULL */
+};
+
+/*
+ * Per-node store of full and empty sheaves, for exchanging objects between
+ * cpus a whole sheaf at a time.
+ */
+struct node_barn {
+	spinlock_t lock;
+	struct list_head sheaves_full;
+	struct list_head sheaves_empty;
+	unsigned int nr_full;
+	unsigned int nr_empty;
+};
+#endif /* CONFIG_SLUB_TINY */
+
 /*
  * The slab lists for all objects.
  */
@@ -431,6 +473,9 @@ struct kmem_cache_node {
 	atomic_long_t total_objects;
 	struct list_head full;
 #endif
+#ifndef CONFIG_SLUB_TINY
+	struct node_barn *barn;
+#endif
 };
 
 static inline struct kmem_cache_node *get_node(struct kmem_cache *s, int node)
@@ -3252,6 +3297,501 @@ static inline void put_partials_cpu(struct kmem_cache *s,
 
 #endif	/* CONFIG_SLUB_CPU_PARTIAL */
 
+/*
+ * Per-cpu sheaves
+ *
+ * Caches created with a kmem_cache_args.sheaf_capacity keep a main and a
+ * spare sheaf of free objects per cpu, in front of the cpu slab. Allocations
+ * without a node preference and frees of objects from the local node are
+ * served from the main sheaf under a local lock, without any cmpxchg on the
+ * cpu slab freelist. When the main sheaf runs empty (or full) it is swapped
+ * with the spare one, or exchanged with the barn of the local node for a full
+ * (or empty) one, so that objects freed on one cpu are handed over to another
+ * a whole sheaf at a time. Only when neither works does the operation fall
+ * back to the cpu slab.
+ */
+#define BARN_MAX_FULL		10
+#define SHEAF_FLUSH_BATCH	32
+
+static void __kmem_cache_free_bulk(struct kmem_cache *s, size_t size, void **p);
+
+static struct slab_sheaf *alloc_empty_sheaf(struct kmem_cache *s, gfp_t gfp)
+{
+	struct slab_sheaf *sheaf;
+
+	return kzalloc(struct_size(sheaf, objects, s->sheaf_capacity), gfp);
+}
+
+static inline struct node_barn *get_barn(struct kmem_cache *s)
+{
+	struct kmem_cache_node *n = get_node(s, numa_mem_id());
+
+	return n ? n->barn : NULL;
+}
+
+/*
+ * Replace the empty main sheaf with the spare one if that has objects, or
+ * with a full sheaf from the barn. Returns false if neither is available.
+ */
+static bool pcs_refill_main(struct kmem_cache *s,
+			    struct slub_percpu_sheaves *pcs)
+{
+	struct slab_sheaf *full = NULL;
+	struct node_barn *barn;
+
+	lockdep_assert_held(this_cpu_ptr(&s->cpu_sheaves->lock));
+
+	if (pcs->spare && pcs->spare->size) {
+		swap(pcs->main, pcs->spare);
+		stat(s, SHEAF_SWAP);
+		return true;
+	}
+
+	barn = get_barn(s);
+	if (!barn || !data_race(barn->nr_full))
+		return false;
+
+	spin_lock(&barn->lock);
+	if (barn->nr_full) {
+		full = list_first_entry(&barn->sheaves_full, struct slab_sheaf,
+					barn_list);
+		list_del(&full->barn_list);
+		barn->nr_full--;
+
+		if (pcs->spare) {
+			list_add(&pcs->main->barn_list, &barn->sheaves_empty);
+			barn->nr_empty++;
+		} else {
+			pcs->spare = pcs->main;
+		}
+		pcs->main = full;
+	}
+	spin_unlock(&barn->lock);
+
+	if (!full)
+		return false;
+
+	stat(s, BARN_GET);
+	return true;
+}
+
+static void *__alloc_from_pcs(struct kmem_cache *s)
+{
+	struct slub_percpu_sheaves *pcs;
+	unsigned long flags;
+	void *object;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+
+	if (unlikely(!pcs->main->size) && !pcs_refill_main(s, pcs)) {
+		local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+		return NULL;
+	}
+
+	object = pcs->main->objects[--pcs->main->size];
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	stat(s, ALLOC_PCS);
+	return object;
+}
+
+static __always_inline void *alloc_from_pcs(struct kmem_cache *s, int node)
+{
+	if (!s->cpu_sheaves || node != NUMA_NO_NODE)
+		return NULL;
+
+	return __alloc_from_pcs(s);
+}
+
+static unsigned int alloc_from_pcs_bulk(struct kmem_cache *s, size_t size,
+					void **p)
+{
+	struct slub_percpu_sheaves *pcs;
+	unsigned int allocated = 0;
+	unsigned long flags;
+
+	if (!s->cpu_sheaves)
+		return 0;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+
+	while (allocated < size) {
+		struct slab_sheaf *main;
+		unsigned int batch;
+
+		if (!pcs->main->size && !pcs_refill_main(s, pcs))
+			break;
+
+		main = pcs->main;
+		batch = min_t(size_t, size - allocated, main->size);
+		main->size -= batch;
+		memcpy(p + allocated, main->objects + main->size,
+		       batch * sizeof(void *));
+		allocated += batch;
+	}
+
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	stat_add(s, ALLOC_PCS, allocated);
+	return allocated;
+}
+
+static bool __free_to_pcs(struct kmem_cache *s, void *object)
+{
+	struct slub_percpu_sheaves *pcs;
+	struct slab_sheaf *empty = NULL;
+	struct node_barn *barn;
+	unsigned long flags;
+	bool ret = true;
+
+restart:
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+
+	if (likely(pcs->main->size < s->sheaf_capacity))
+		goto do_free;
+
+	if (pcs->spare && !pcs->spare->size) {
+		swap(pcs->main, pcs->spare);
+		stat(s, SHEAF_SWAP);
+		goto do_free;
+	}
+
+	barn = get_barn(s);
+	if (!barn) {
+		ret = false;
+		goto out;
+	}
+
+	spin_lock(&barn->lock);
+	/* Without a spare, the full main sheaf becomes the spare instead */
+	if (pcs->spare && barn->nr_full >= BARN_MAX_FULL) {
+		spin_unlock(&barn->lock);
+		ret = false;
+		goto out;
+	}
+
+	if (!empty && barn->nr_empty) {
+		empty = list_first_entry(&barn->sheaves_empty,
+					 struct slab_sheaf, barn_list);
+		list_del(&empty->barn_list);
+		barn->nr_empty--;
+	}
+
+	if (!empty) {
+		spin_unlock(&barn->lock);
+		local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+		empty = alloc_empty_sheaf(s, GFP_NOWAIT | __GFP_NOWARN);
+		if (!empty)
+			return false;
+		goto restart;
+	}
+
+	if (pcs->spare) {
+		list_add(&pcs->main->barn_list, &barn->sheaves_full);
+		barn->nr_full++;
+		stat(s, BARN_PUT);
+	} else {
+		pcs->spare = pcs->main;
+	}
+	spin_unlock(&barn->lock);
+
+	pcs->main = empty;
+	empty = NULL;
+
+do_free:
+	pcs->main->objects[pcs->main->size++] = object;
+	stat(s, FREE_PCS);
+out:
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	/* We raced and no longer needed the sheaf we allocated */
+	kfree(empty);
+	return ret;
+}
+
+/*
+ * Objects of remote nodes are not cached, as they could be handed out to
+ * local allocations, nor are those of pfmemalloc slabs, as they could be
+ * handed out to allocations without access to memory reserves.
+ */
+static __always_inline bool free_to_pcs(struct kmem_cache *s,
+					struct slab *slab, void *object)
+{
+	if (!s->cpu_sheaves)
+		return false;
+
+	if (unlikely(slab_nid(slab) != numa_mem_id() ||
+		     slab_test_pfmemalloc(slab)))
+		return false;
+
+	return __free_to_pcs(s, object);
+}
+
+/* Return all objects of a sheaf not reachable by other cpus to their slabs */
+static void sheaf_flush_unused(struct kmem_cache *s, struct slab_sheaf *sheaf)
+{
+	if (!sheaf->size)
+		return;
+
+	stat_add(s, SHEAF_FLUSH, sheaf->size);
+	__kmem_cache_free_bulk(s, sheaf->size, &sheaf->objects[0]);
+	sheaf->size = 0;
+}
+
+/* Flush the sheaves of the local cpu, called with migration disabled */
+static void pcs_flush_all(struct kmem_cache *s)
+{
+	void *objects[SHEAF_FLUSH_BATCH];
+	struct slub_percpu_sheaves *pcs;
+	struct slab_sheaf *spare;
+	unsigned long flags;
+	unsigned int batch;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+
+	spare = pcs->spare;
+	pcs->spare = NULL;
+
+	/* The main sheaf stays in place, so flush it in batches */
+	while (pcs->main->size) {
+		batch = min(pcs->main->size, SHEAF_FLUSH_BATCH);
+		pcs->main->size -= batch;
+		memcpy(objects, pcs->main->objects + pcs->main->size,
+		       batch * sizeof(void *));
+		local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+		stat_add(s, SHEAF_FLUSH, batch);
+		__kmem_cache_free_bulk(s, batch, objects);
+
+		local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+		pcs = this_cpu_ptr(s->cpu_sheaves);
+	}
+
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (spare) {
+		sheaf_flush_unused(s, spare);
+		kfree(spare);
+	}
+}
+
+static void pcs_flush_cpu_dead(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+	sheaf_flush_unused(s, pcs->main);
+	if (pcs->spare) {
+		sheaf_flush_unused(s, pcs->spare);
+		kfree(pcs->spare);
+		pcs->spare = NULL;
+	}
+}
+
+static bool pcs_has_objects(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+	struct slab_sheaf *spare = data_race(pcs->spare);
+
+	return data_race(pcs->main->size) || (spare && data_race(spare->size));
+}
+
+/* Flush the full sheaves of the barn and free all its sheaves */
+static void barn_shrink(struct kmem_cache *s, struct node_barn *barn)
+{
+	struct slab_sheaf *sheaf, *tmp;
+	unsigned long flags;
+	LIST_HEAD(empty);
+	LIST_HEAD(full);
+
+	spin_lock_irqsave(&barn->lock, flags);
+	list_splice_init(&barn->sheaves_full, &full);
+	list_splice_init(&barn->sheaves_empty, &empty);
+	barn->nr_full = 0;
+	barn->nr_empty = 0;
+	spin_unlock_irqrestore(&barn->lock, flags);
+
+	list_for_each_entry_safe(sheaf, tmp, &full, barn_list) {
+		sheaf_flush_unused(s, sheaf);
+		kfree(sheaf);
+	}
+	list_for_each_entry_safe(sheaf, tmp, &empty, barn_list)
+		kfree(sheaf);
+}
+
+static void flush_all_barns(struct kmem_cache *s)
+{
+	struct kmem_cache_node *n;
+	int node;
+
+	for_each_kmem_cache_node(s, node, n) {
+		if (n->barn)
+			barn_shrink(s, n->barn);
+	}
+}
+
+static int init_percpu_sheaves(struct kmem_cache *s)
+{
+	struct kmem_cache_node *n;
+	int cpu, node;
+
+	s->cpu_sheaves = alloc_percpu(struct slub_percpu_sheaves);
+	if (!s->cpu_sheaves)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_sheaves *pcs;
+
+		pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+		local_lock_init(&pcs->lock);
+		pcs->main = alloc_empty_sheaf(s, GFP_KERNEL);
+		if (!pcs->main)
+			return 0;
+	}
+
+	for_each_kmem_cache_node(s, node, n) {
+		struct node_barn *barn;
+
+		barn = kmalloc_node(sizeof(*barn), GFP_KERNEL, node);
+		if (!barn)
+			return 0;
+
+		spin_lock_init(&barn->lock);
+		INIT_LIST_HEAD(&barn->sheaves_full);
+		INIT_LIST_HEAD(&barn->sheaves_empty);
+		barn->nr_full = 0;
+		barn->nr_empty = 0;
+		n->barn = barn;
+	}
+
+	return 1;
+}
+
+static void free_percpu_sheaves(struct kmem_cache *s)
+{
+	struct kmem_cache_node *n;
+	int cpu, node;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_sheaves *pcs;
+
+		pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+		kfree(pcs->main);
+		kfree(pcs->spare);
+	}
+	free_percpu(s->cpu_sheaves);
+	s->cpu_sheaves = NULL;
+
+	for_each_kmem_cache_node(s, node, n) {
+		if (n->barn)
+			barn_shrink(s, n->barn);
+		kfree(n->barn);
+		n->barn = NULL;
+	}
+}
+
+/*
+ * Remote free batching
+ *
+ * Frees to a slab other than the cpu slab go through __slab_free(), which
+ * updates the slab freelist with a cmpxchg and thus bounces its cache line
+ * with the cpu allocating from that slab. When objects are allocated on one
+ * cpu and freed on another, consecutive frees tend to hit the same slab, so
+ * link them into a per-cpu batch instead and splice the batch onto the slab
+ * freelist with a single __slab_free() when it is full, when a free to a
+ * different slab comes in, or when the cpu slabs are flushed.
+ */
+#define SLUB_REMOTE_FREE_BATCH	16
+
+static void __slab_free(struct kmem_cache *s, struct slab *slab,
+			void *head, void *tail, int cnt,
+			unsigned long addr);
+
+/*
+ * Called with the cpu slab lock held, or with the cpu quiesced. The objects
+ * of the returned slab must be passed to remote_free_flush().
+ */
+static struct slab *remote_free_detach(struct kmem_cache_cpu *c,
+				       void **head, void **tail, int *cnt)
+{
+	struct slab *slab = c->rfree_slab;
+
+	*head = c->rfree_head;
+	*tail = c->rfree_tail;
+	*cnt = c->rfree_cnt;
+
+	c->rfree_slab = NULL;
+	c->rfree_head = NULL;
+	c->rfree_tail = NULL;
+	c->rfree_cnt = 0;
+
+	return slab;
+}
+
+static void remote_free_flush(struct kmem_cache *s, struct slab *slab,
+			      void *head, void *tail, int cnt)
+{
+	if (!slab)
+		return;
+
+	stat(s, FREE_REMOTE_FLUSH);
+	__slab_free(s, slab, head, tail, cnt, _RET_IP_);
+}
+
+/*
+ * Add the objects from @head to @tail to the remote free batch. Returns false
+ * if they have to be freed to their slab right away instead.
+ */
+static bool remote_free_add(struct kmem_cache *s, struct slab *slab,
+			    void *head, void *tail, int cnt)
+{
+	void *fhead = NULL, *ftail = NULL;
+	struct slab *flush = NULL;
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	int fcnt = 0;
+
+	/* Debugging checks the objects as they reach the slab */
+	if (kmem_cache_debug(s) || cnt >= SLUB_REMOTE_FREE_BATCH)
+		return false;
+
+	local_lock_irqsave(&s->cpu_slab->lock, flags);
+	c = this_cpu_ptr(s->cpu_slab);
+
+	if (unlikely(slab == c->slab)) {
+		local_unlock_irqrestore(&s->cpu_slab->lock, flags);
+		return false;
+	}
+
+	if (c->rfree_slab != slab ||
+	    c->rfree_cnt + cnt > SLUB_REMOTE_FREE_BATCH)
+		flush = remote_free_detach(c, &fhead, &ftail, &fcnt);
+
+	/* __slab_free() links the tail to the slab freelist */
+	set_freepointer(s, tail, c->rfree_head);
+	c->rfree_head = head;
+	if (!c->rfree_tail)
+		c->rfree_tail = tail;
+	c->rfree_slab = slab;
+	c->rfree_cnt += cnt;
+	stat_add(s, FREE_REMOTE_BATCH, cnt);
+
+	if (!flush && c->rfree_cnt == SLUB_REMOTE_FREE_BATCH)
+		flush = remote_free_detach(c, &fhead, &ftail, &fcnt);
+
+	local_unlock_irqrestore(&s->cpu_slab->lock, flags);
+
+	remote_free_flush(s, flush, fhead, ftail, fcnt);
+	return true;
+}
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	unsigned long flags;
@@ -3275,11 +3815,30 @@ static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 	}
 }
 
+static void flush_remote_frees(struct kmem_cache *s)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	struct slab *slab;
+	void *head, *tail;
+	int cnt;
+
+	local_lock_irqsave(&s->cpu_slab->lock, flags);
+	c = this_cpu_ptr(s->cpu_slab);
+	slab = remote_free_detach(c, &head, &tail, &cnt);
+	local_unlock_irqrestore(&s->cpu_slab->lock, flags);
+
+	remote_free_flush(s, slab, head, tail, cnt);
+}
+
 static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 	void *freelist = c->freelist;
 	struct slab *slab = c->slab;
+	struct slab *rfree_slab;
+	void *head, *tail;
+	int cnt;
 
 	c->slab = NULL;
 	c->freelist = NULL;
@@ -3290,6 +3849,9 @@ static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu)
 		stat(s, CPUSLAB_FLUSH);
 	}
 
+	rfree_slab = remote_free_detach(c, &head, &tail, &cnt);
+	remote_free_flush(s, rfree_slab, head, tail, cnt);
+
 	put_partials_cpu(s, c);
 }
 
@@ -3313,11 +3875,18 @@ static void flush_cpu_slab(struct work_struct *w)
 	sfw = container_of(w, struct slub_flush_work, work);
 
 	s = sfw->s;
+
+	if (s->cpu_sheaves)
+		pcs_flush_all(s);
+
 	c = this_cpu_ptr(s->cpu_slab);
 
 	if (c->slab)
 		flush_slab(s, c);
 
+	if (c->rfree_slab)
+		flush_remote_frees(s);
+
 	put_partials(s);
 }
 
@@ -3325,7 +3894,10 @@ static bool has_cpu_slab(int cpu, struct kmem_cache *s)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
-	return c->slab || slub_percpu_partial(c);
+	if (s->cpu_sheaves && pcs_has_objects(s, cpu))
+		return true;
+
+	return c->slab || c->rfree_slab || slub_percpu_partial(c);
 }
 
 static DEFINE_MUTEX(flush_lock);
@@ -3339,6 +3911,10 @@ static void flush_all_cpus_locked(struct kmem_cache *s)
 	lockdep_assert_cpus_held();
 	mutex_lock(&flush_lock);
 
+	/* Before the cpus, as the flushed objects may be batched locally */
+	if (s->cpu_sheaves)
+		flush_all_barns(s);
+
 	for_each_online_cpu(cpu) {
 		sfw = &per_cpu(slub_flush, cpu);
 		if (!has_cpu_slab(cpu, s)) {
@@ -3377,13 +3953,32 @@ static int slub_cpu_dead(unsigned int cpu)
 	struct kmem_cache *s;
 
 	mutex_lock(&slab_mutex);
-	list_for_each_entry(s, &slab_caches, list)
+	list_for_each_entry(s, &slab_caches, list) {
+		if (s->cpu_sheaves)
+			pcs_flush_cpu_dead(s, cpu);
 		__flush_cpu_slab(s, cpu);
+	}
 	mutex_unlock(&slab_mutex);
 	return 0;
 }
 
 #else /* CONFIG_SLUB_TINY */
+static inline void *alloc_from_pcs(struct kmem_cache *s, int node)
+{
+	return NULL;
+}
+static inline unsigned int alloc_from_pcs_bulk(struct kmem_cache *s,
+					       size_t size, void **p)
+{
+	return 0;
+}
+static inline bool free_to_pcs(struct kmem_cache *s, struct slab *slab,
+			       void *object)
+{
+	return false;
+}
+static inline int init_percpu_sheaves(struct kmem_cache *s) { return 1; }
+static inline void free_percpu_sheaves(struct kmem_cache *s) { }
 static inline void flush_all_cpus_locked(struct kmem_cache *s) { }
 static inline void flush_all(struct kmem_cache *s) { }
 static inline void __flush_cpu_slab(struct kmem_cache *s, int cpu) { }
@@ -4141,7 +4736,9 @@ static __fastpath_inline void *slab_alloc_node(struct kmem_cache *s, struct list
 	if (unlikely(object))
 		goto out;
 
-	object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
+	object = alloc_from_pcs(s, node);
+	if (!object)
+		object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
 
 	maybe_wipe_obj_freeptr(s, object);
 	init = slab_want_init_on_alloc(gfpflags, s);
@@ -4550,7 +5147,8 @@ static __always_inline void do_slab_free(struct kmem_cache *s,
 	barrier();
 
 	if (unlikely(slab != c->slab)) {
-		__slab_free(s, slab, head, tail, cnt, addr);
+		if (!remote_free_add(s, slab, head, tail, cnt))
+			__slab_free(s, slab, head, tail, cnt, addr);
 		return;
 	}
 
@@ -4598,8 +5196,11 @@ void slab_free(struct kmem_cache *s, struct slab *slab, void *object,
 	memcg_slab_free_hook(s, slab, &object, 1);
 	alloc_tagging_slab_free_hook(s, slab, &object, 1);
 
-	if (likely(slab_free_hook(s, object, slab_want_init_on_free(s), false)))
+	if (likely(slab_free_hook(s, object, slab_want_init_on_free(s), false))) {
+		if (free_to_pcs(s, slab, object))
+			return;
 		do_slab_free(s, slab, object, object, 1, addr);
+	}
 }
 
 #ifdef CONFIG_MEMCG
@@ -4986,9 +5587,16 @@ int kmem_cache_alloc_bulk_noprof(struct kmem_cache *s, gfp_t flags, size_t size,
 	if (unlikely(!s))
 		return 0;
 
-	i = __kmem_cache_alloc_bulk(s, flags, size, p);
-	if (unlikely(i == 0))
-		return 0;
+	i = alloc_from_pcs_bulk(s, size, p);
+	if (i < size) {
+		if (unlikely(!__kmem_cache_alloc_bulk(s, flags, size - i,
+						      p + i))) {
+			/* Not seen by the post alloc hooks yet */
+			__kmem_cache_free_bulk(s, i, p);
+			return 0;
+		}
+		i = size;
+	}
 
 	/*
 	 * memcg and kmem_cache debug support and memory initialization.
@@ -5146,6 +5754,9 @@ init_kmem_cache_node(struct kmem_cache_node *n)
 	atomic_long_set(&n->total_objects, 0);
 	INIT_LIST_HEAD(&n->full);
 #endif
+#ifndef CONFIG_SLUB_TINY
+	n->barn = NULL;
+#endif
 }
 
 #ifndef CONFIG_SLUB_TINY
@@ -5236,6 +5847,7 @@ void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
 #ifndef CONFIG_SLUB_TINY
+	free_percpu_sheaves(s);
 	free_percpu(s->cpu_slab);
 #endif
 	free_kmem_cache_nodes(s);
@@ -6064,6 +6676,14 @@ int do_kmem_cache_create(struct kmem_cache *s, const char *name,
 	if (!alloc_kmem_cache_cpus(s))
 		goto out;
 
+	/* Debugging needs every free to go through the slab checks */
+	if (!IS_ENABLED(CONFIG_SLUB_TINY) && args->sheaf_capacity &&
+	    !kmem_cache_debug(s) && slab_state >= UP) {
+		s->sheaf_capacity = args->sheaf_capacity;
+		if (!init_percpu_sheaves(s))
+			goto out;
+	}
+
 	/* Mutex is not taken during early boot */
 	if (slab_state <= UP) {
 		err = 0;
@@ -6507,6 +7127,12 @@ static ssize_t objs_per_slab_show(struct kmem_cache *s, char *buf)
 }
 SLAB_ATTR_RO(objs_per_slab);
 
+static ssize_t sheaf_capacity_show(struct kmem_cache *s, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", s->sheaf_capacity);
+}
+SLAB_ATTR_RO(sheaf_capacity);
+
 static ssize_t order_show(struct kmem_cache *s, char *buf)
 {
 	return sysfs_emit(buf, "%u\n", oo_order(s->oo));
@@ -6886,6 +7512,14 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_PCS, alloc_cpu_sheaf);
+STAT_ATTR(FREE_PCS, free_cpu_sheaf);
+STAT_ATTR(SHEAF_SWAP, sheaf_swap);
+STAT_ATTR(SHEAF_FLUSH, sheaf_flush);
+STAT_ATTR(BARN_GET, barn_get);
+STAT_ATTR(BARN_PUT, barn_put);
+STAT_ATTR(FREE_REMOTE_BATCH, free_remote_batch);
+STAT_ATTR(FREE_REMOTE_FLUSH, free_remote_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 #ifdef CONFIG_KFENCE
@@ -6915,6 +7549,7 @@ static struct attribute *slab_attrs[] = {
 	&slab_size_attr.attr,
 	&object_size_attr.attr,
 	&objs_per_slab_attr.attr,
+	&sheaf_capacity_attr.attr,
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
@@ -6973,6 +7608,14 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_cpu_sheaf_attr.attr,
+	&free_cpu_sheaf_attr.attr,
+	&sheaf_swap_attr.attr,
+	&sheaf_flush_attr.attr,
+	&barn_get_attr.attr,
+	&barn_put_attr.attr,
+	&free_remote_batch_attr.attr,
+	&free_remote_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
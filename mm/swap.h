@@ -75,6 +75,7 @@ struct folio *swap_cluster_readahead(swp_entry_t entry, gfp_t flag,
 		struct mempolicy *mpol, pgoff_t ilx);
 struct folio *swapin_readahead(swp_entry_t entry, gfp_t flag,
 		struct vm_fault *vmf);
+bool swap_cache_read_large_folio(struct folio *folio, swp_entry_t entry);
 
 static inline unsigned int folio_swap_flags(struct folio *folio)
 {
@@ -141,6 +142,12 @@ static inline struct folio *swapin_readahead(swp_entry_t swp, gfp_t gfp_mask,
 	return NULL;
 }
 
+static inline bool swap_cache_read_large_folio(struct folio *folio,
+					       swp_entry_t entry)
+{
+	return false;
+}
+
 static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 {
 	return 0;
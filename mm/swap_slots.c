@@ -25,6 +25,11 @@
  * The swap slots cache is protected by a mutex instead of
  * a spin lock as when we search for slots with scan_swap_map,
  * we can possibly sleep.
+ *
+ * With CONFIG_THP_SWAP, each cpu also caches a few ranges of every
+ * large order, so that swapping out mTHP does not have to take the
+ * swap_info lock for each folio.  Those are only allocated and
+ * drained, never returned to the cache on free.
  */
 
 #include <linux/swap_slots.h>
@@ -165,6 +170,73 @@ static int alloc_swap_slot_cache(unsigned int cpu)
 	return 0;
 }
 
+#ifdef CONFIG_THP_SWAP
+/* Cache at most a cluster's worth of entries per order */
+static int large_slots_cache_size(int order)
+{
+	return min(SWAP_LARGE_SLOTS_CACHE_SIZE, HPAGE_PMD_NR >> order);
+}
+
+/* called with swap slot cache's alloc lock held */
+static void drain_large_slots_cache(struct swap_slots_cache *cache)
+{
+	int order;
+
+	for (order = 1; order < SWAP_NR_ORDERS; order++) {
+		while (cache->large_nr[order]) {
+			cache->large_nr[order]--;
+			put_swap_entries(cache->large_slots[order][cache->large_nr[order]],
+					 order);
+		}
+	}
+}
+
+static swp_entry_t alloc_large_swap_slot(int order)
+{
+	struct swap_slots_cache *cache;
+	swp_entry_t entry;
+
+	entry.val = 0;
+
+	/* Not worth caching if only one range fits in a cluster */
+	if (large_slots_cache_size(order) < 2)
+		goto direct;
+
+	cache = raw_cpu_ptr(&swp_slots);
+	if (likely(check_cache_active() && cache->slots)) {
+		mutex_lock(&cache->alloc_lock);
+		if (cache->slots) {
+			if (!cache->large_nr[order] && use_swap_slot_cache)
+				cache->large_nr[order] = get_swap_pages(
+						large_slots_cache_size(order),
+						cache->large_slots[order], order);
+			if (cache->large_nr[order]) {
+				cache->large_nr[order]--;
+				entry = cache->large_slots[order][cache->large_nr[order]];
+			}
+		}
+		mutex_unlock(&cache->alloc_lock);
+		if (entry.val)
+			return entry;
+	}
+
+direct:
+	get_swap_pages(1, &entry, order);
+	return entry;
+}
+#else
+static inline void drain_large_slots_cache(struct swap_slots_cache *cache)
+{
+}
+
+static swp_entry_t alloc_large_swap_slot(int order)
+{
+	swp_entry_t entry = { 0 };
+
+	return entry;
+}
+#endif
+
 static void drain_slots_cache_cpu(unsigned int cpu, unsigned int type,
 				  bool free_slots)
 {
@@ -177,6 +249,7 @@ static void drain_slots_cache_cpu(unsigned int cpu, unsigned int type,
 		swapcache_free_entries(cache->slots + cache->cur, cache->nr);
 		cache->cur = 0;
 		cache->nr = 0;
+		drain_large_slots_cache(cache);
 		if (free_slots && cache->slots) {
 			kvfree(cache->slots);
 			cache->slots = NULL;
@@ -273,9 +346,6 @@ void free_swap_slot(swp_entry_t entry)
 {
 	struct swap_slots_cache *cache;
 
-	/* Large folio swap slot is not covered. */
-	zswap_invalidate(entry);
-
 	cache = raw_cpu_ptr(&swp_slots);
 	if (likely(use_swap_slot_cache && cache->slots_ret)) {
 		spin_lock_irq(&cache->free_lock);
@@ -310,8 +380,7 @@ swp_entry_t folio_alloc_swap(struct folio *folio)
 	entry.val = 0;
 
 	if (folio_test_large(folio)) {
-		if (IS_ENABLED(CONFIG_THP_SWAP))
-			get_swap_pages(1, &entry, folio_order(folio));
+		entry = alloc_large_swap_slot(folio_order(folio));
 		goto out;
 	}
 
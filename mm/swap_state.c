@@ -545,6 +545,53 @@ struct folio *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return result;
 }
 
+/**
+ * swap_cache_read_large_folio - swap in a large folio through the swap cache
+ * @folio: a newly allocated and charged large folio
+ * @entry: any swap entry in the naturally aligned range backing @folio
+ *
+ * Used by the fault path when the swap device is not SWP_SYNCHRONOUS_IO,
+ * after it checked that the range holds the contiguous swap entries of a
+ * single swapped out large folio.  The whole range is added to the swap
+ * cache and read back with one I/O, instead of faulting it back in order-0
+ * pages through readahead.
+ *
+ * Returns false, with @folio untouched, if any entry of the range was
+ * freed or raced into the swap cache, so the caller can fall back to
+ * swapin_readahead().
+ */
+bool swap_cache_read_large_folio(struct folio *folio, swp_entry_t entry)
+{
+	struct swap_info_struct *si = swp_swap_info(entry);
+	int nr = folio_nr_pages(folio);
+	void *shadow = NULL;
+
+	entry.val = ALIGN_DOWN(entry.val, nr);
+	if (swapcache_prepare(entry, nr))
+		return false;
+
+	__folio_set_locked(folio);
+	__folio_set_swapbacked(folio);
+
+	/* May fail (-ENOMEM) if XArray node allocation failed. */
+	if (add_to_swap_cache(folio, entry, GFP_KERNEL & GFP_RECLAIM_MASK,
+			      &shadow)) {
+		__folio_clear_swapbacked(folio);
+		__folio_clear_locked(folio);
+		swapcache_clear(si, entry, nr);
+		return false;
+	}
+
+	mem_cgroup_swapin_uncharge_swap(entry, nr);
+
+	if (shadow)
+		workingset_refault(folio, shadow);
+
+	folio_add_lru(folio);
+	swap_read_folio(folio, NULL);
+	return true;
+}
+
 /*
  * Locate a page of swap in physical memory, reserving swap cache space
  * and reading the disk if it is not already cached.
@@ -697,90 +697,69 @@ static __always_inline ssize_t mfill_atomic_pte(pmd_t *dst_pmd,
 	return err;
 }
 
-static __always_inline ssize_t mfill_atomic(struct userfaultfd_ctx *ctx,
-					    unsigned long dst_start,
-					    unsigned long src_start,
-					    unsigned long len,
-					    uffd_flags_t flags)
+/*
+ * Checks on the dst_vma of a fill, made under the vma lock and
+ * map_changing_lock.  Hugetlb vmas are left to mfill_atomic_hugetlb().
+ */
+static int mfill_atomic_check_vma(struct userfaultfd_ctx *ctx,
+				  struct vm_area_struct *dst_vma,
+				  uffd_flags_t flags)
 {
-	struct mm_struct *dst_mm = ctx->mm;
-	struct vm_area_struct *dst_vma;
-	ssize_t err;
-	pmd_t *dst_pmd;
-	unsigned long src_addr, dst_addr;
-	long copied;
-	struct folio *folio;
-
-	/*
-	 * Sanitize the command parameters:
-	 */
-	BUG_ON(dst_start & ~PAGE_MASK);
-	BUG_ON(len & ~PAGE_MASK);
-
-	/* Does the address range wrap, or is the span zero-sized? */
-	BUG_ON(src_start + len <= src_start);
-	BUG_ON(dst_start + len <= dst_start);
-
-	src_addr = src_start;
-	dst_addr = dst_start;
-	copied = 0;
-	folio = NULL;
-retry:
-	/*
-	 * Make sure the vma is not shared, that the dst range is
-	 * both valid and fully within a single existing vma.
-	 */
-	dst_vma = uffd_mfill_lock(dst_mm, dst_start, len);
-	if (IS_ERR(dst_vma)) {
-		err = PTR_ERR(dst_vma);
-		goto out;
-	}
-
 	/*
 	 * If memory mappings are changing because of non-cooperative
 	 * operation (e.g. mremap) running in parallel, bail out and
 	 * request the user to retry later
 	 */
-	down_read(&ctx->map_changing_lock);
-	err = -EAGAIN;
 	if (atomic_read(&ctx->mmap_changing))
-		goto out_unlock;
+		return -EAGAIN;
 
-	err = -EINVAL;
 	/*
 	 * shmem_zero_setup is invoked in mmap for MAP_ANONYMOUS|MAP_SHARED but
 	 * it will overwrite vm_ops, so vma_is_anonymous must return false.
 	 */
 	if (WARN_ON_ONCE(vma_is_anonymous(dst_vma) &&
 	    dst_vma->vm_flags & VM_SHARED))
-		goto out_unlock;
+		return -EINVAL;
 
 	/*
 	 * validate 'mode' now that we know the dst_vma: don't allow
 	 * a wrprotect copy if the userfaultfd didn't register as WP.
 	 */
 	if ((flags & MFILL_ATOMIC_WP) && !(dst_vma->vm_flags & VM_UFFD_WP))
-		goto out_unlock;
+		return -EINVAL;
 
-	/*
-	 * If this is a HUGETLB vma, pass off to appropriate routine
-	 */
 	if (is_vm_hugetlb_page(dst_vma))
-		return  mfill_atomic_hugetlb(ctx, dst_vma, dst_start,
-					     src_start, len, flags);
+		return 0;
 
 	if (!vma_is_anonymous(dst_vma) && !vma_is_shmem(dst_vma))
-		goto out_unlock;
+		return -EINVAL;
 	if (!vma_is_shmem(dst_vma) &&
 	    uffd_flags_mode_is(flags, MFILL_ATOMIC_CONTINUE))
-		goto out_unlock;
+		return -EINVAL;
 
-	while (src_addr < src_start + len) {
-		pmd_t dst_pmdval;
+	return 0;
+}
 
-		BUG_ON(dst_addr >= dst_start + len);
+/*
+ * Fill the ptes of [*dst_addr, dst_end) in the locked @dst_vma, advancing
+ * *dst_addr and *src_addr past what was filled.  Returns -ENOENT with
+ * *foliop set when the source page has to be copied with the locks dropped.
+ */
+static __always_inline ssize_t mfill_atomic_ptes(struct vm_area_struct *dst_vma,
+						 unsigned long *dst_addr,
+						 unsigned long *src_addr,
+						 unsigned long dst_end,
+						 uffd_flags_t flags,
+						 struct folio **foliop)
+{
+	struct mm_struct *dst_mm = dst_vma->vm_mm;
+	ssize_t err = 0;
+	pmd_t *dst_pmd;
+
+	while (*dst_addr < dst_end) {
+		pmd_t dst_pmdval;
 
-		dst_pmd = mm_alloc_pmd(dst_mm, dst_addr);
+		dst_pmd = mm_alloc_pmd(dst_mm, *dst_addr);
 		if (unlikely(!dst_pmd)) {
 			err = -ENOMEM;
 			break;
@@ -812,35 +791,19 @@ static __always_inline ssize_t mfill_atomic(struct userfaultfd_ctx *ctx,
 		 * tables under us; pte_offset_map_lock() will deal with that.
 		 */
 
-		err = mfill_atomic_pte(dst_pmd, dst_vma, dst_addr,
-				       src_addr, flags, &folio);
+		err = mfill_atomic_pte(dst_pmd, dst_vma, *dst_addr,
+				       *src_addr, flags, foliop);
 		cond_resched();
 
 		if (unlikely(err == -ENOENT)) {
-			void *kaddr;
-
-			up_read(&ctx->map_changing_lock);
-			uffd_mfill_unlock(dst_vma);
-			BUG_ON(!folio);
-
-			kaddr = kmap_local_folio(folio, 0);
-			err = copy_from_user(kaddr,
-					     (const void __user *) src_addr,
-					     PAGE_SIZE);
-			kunmap_local(kaddr);
-			if (unlikely(err)) {
-				err = -EFAULT;
-				goto out;
-			}
-			flush_dcache_folio(folio);
-			goto retry;
+			BUG_ON(!*foliop);
+			break;
 		} else
-			BUG_ON(folio);
+			BUG_ON(*foliop);
 
 		if (!err) {
-			dst_addr += PAGE_SIZE;
-			src_addr += PAGE_SIZE;
-			copied += PAGE_SIZE;
+			*dst_addr += PAGE_SIZE;
+			*src_addr += PAGE_SIZE;
 
 			if (fatal_signal_pending(current))
 				err = -EINTR;
@@ -849,12 +812,92 @@ static __always_inline ssize_t mfill_atomic(struct userfaultfd_ctx *ctx,
 			break;
 	}
 
+	return err;
+}
+
+/* Copy the source page of a fill with no locks held, see mfill_atomic_pte() */
+static int mfill_atomic_copy_folio(struct folio *folio, unsigned long src_addr)
+{
+	void *kaddr;
+	int err;
+
+	kaddr = kmap_local_folio(folio, 0);
+	err = copy_from_user(kaddr, (const void __user *) src_addr, PAGE_SIZE);
+	kunmap_local(kaddr);
+	if (unlikely(err))
+		return -EFAULT;
+	flush_dcache_folio(folio);
+	return 0;
+}
+
+static __always_inline ssize_t mfill_atomic(struct userfaultfd_ctx *ctx,
+					    unsigned long dst_start,
+					    unsigned long src_start,
+					    unsigned long len,
+					    uffd_flags_t flags)
+{
+	struct mm_struct *dst_mm = ctx->mm;
+	struct vm_area_struct *dst_vma;
+	ssize_t err;
+	unsigned long src_addr, dst_addr;
+	long copied;
+	struct folio *folio;
+
+	/*
+	 * Sanitize the command parameters:
+	 */
+	BUG_ON(dst_start & ~PAGE_MASK);
+	BUG_ON(len & ~PAGE_MASK);
+
+	/* Does the address range wrap, or is the span zero-sized? */
+	BUG_ON(src_start + len <= src_start);
+	BUG_ON(dst_start + len <= dst_start);
+
+	src_addr = src_start;
+	dst_addr = dst_start;
+	folio = NULL;
+retry:
+	/*
+	 * Make sure the vma is not shared, that the dst range is
+	 * both valid and fully within a single existing vma.
+	 */
+	dst_vma = uffd_mfill_lock(dst_mm, dst_start, len);
+	if (IS_ERR(dst_vma)) {
+		err = PTR_ERR(dst_vma);
+		goto out;
+	}
+
+	down_read(&ctx->map_changing_lock);
+	err = mfill_atomic_check_vma(ctx, dst_vma, flags);
+	if (err)
+		goto out_unlock;
+
+	/*
+	 * If this is a HUGETLB vma, pass off to appropriate routine
+	 */
+	if (is_vm_hugetlb_page(dst_vma))
+		return  mfill_atomic_hugetlb(ctx, dst_vma, dst_start,
+					     src_start, len, flags);
+
+	err = mfill_atomic_ptes(dst_vma, &dst_addr, &src_addr,
+				dst_start + len, flags, &folio);
+	if (unlikely(err == -ENOENT)) {
+		up_read(&ctx->map_changing_lock);
+		uffd_mfill_unlock(dst_vma);
+
+		err = mfill_atomic_copy_folio(folio, src_addr);
+		if (unlikely(err))
+			goto out;
+		goto retry;
+	}
+
 out_unlock:
 	up_read(&ctx->map_changing_lock);
 	uffd_mfill_unlock(dst_vma);
 out:
 	if (folio)
 		folio_put(folio);
+	copied = dst_addr - dst_start;
 	BUG_ON(copied < 0);
 	BUG_ON(err > 0);
 	BUG_ON(!copied && !err);
@@ -900,6 +943,108 @@ ssize_t mfill_atomic_poison(struct userfaultfd_ctx *ctx, unsigned long start,
 			    uffd_flags_set_mode(flags, MFILL_ATOMIC_POISON));
 }
 
+/**
+ * mfill_atomic_vec - fill a vector of ranges
+ * @ctx: userfaultfd context of the destination mm
+ * @ranges: the ranges to fill, each page aligned, not wrapping, and within
+ *          a single vma
+ * @nr: number of entries in @ranges
+ * @flags: MFILL_ATOMIC_COPY or MFILL_ATOMIC_CONTINUE, plus behavior flags
+ *
+ * Like calling mfill_atomic_copy() or mfill_atomic_continue() on each
+ * range in turn, except that consecutive ranges in the same vma are filled
+ * under a single hold of the vma lock (or mmap_lock) and map_changing_lock.
+ * The ->ret of each range processed is set to the number of bytes filled,
+ * or to an error if none were.
+ *
+ * Return: the number of ranges filled completely.  Filling stops at the
+ * first range that is not.
+ */
+unsigned long mfill_atomic_vec(struct userfaultfd_ctx *ctx,
+			       struct mfill_atomic_range *ranges,
+			       unsigned long nr, uffd_flags_t flags)
+{
+	struct mm_struct *dst_mm = ctx->mm;
+	struct vm_area_struct *dst_vma = NULL;
+	struct folio *folio = NULL;
+	unsigned long i, dst_addr, src_addr, dst_end;
+	ssize_t err = 0;
+
+	VM_WARN_ON_ONCE(!uffd_flags_mode_is(flags, MFILL_ATOMIC_COPY) &&
+			!uffd_flags_mode_is(flags, MFILL_ATOMIC_CONTINUE));
+
+	/* See mfill_atomic_continue() */
+	if (uffd_flags_mode_is(flags, MFILL_ATOMIC_CONTINUE))
+		smp_wmb();
+
+	for (i = 0; i < nr; i++) {
+		struct mfill_atomic_range *range = &ranges[i];
+
+		dst_addr = range->dst;
+		src_addr = range->src;
+		dst_end = range->dst + range->len;
+retry:
+		if (dst_vma && (dst_addr < dst_vma->vm_start ||
+				dst_end > dst_vma->vm_end)) {
+			up_read(&ctx->map_changing_lock);
+			uffd_mfill_unlock(dst_vma);
+			dst_vma = NULL;
+		}
+
+		if (!dst_vma) {
+			dst_vma = uffd_mfill_lock(dst_mm, dst_addr,
+						  dst_end - dst_addr);
+			if (IS_ERR(dst_vma)) {
+				err = PTR_ERR(dst_vma);
+				dst_vma = NULL;
+				goto done;
+			}
+
+			down_read(&ctx->map_changing_lock);
+			err = mfill_atomic_check_vma(ctx, dst_vma, flags);
+			if (err)
+				goto done;
+
+			/* It drops the locks itself */
+			if (is_vm_hugetlb_page(dst_vma)) {
+				err = mfill_atomic_hugetlb(ctx, dst_vma,
+						dst_addr, src_addr,
+						dst_end - dst_addr, flags);
+				dst_vma = NULL;
+				if (err > 0) {
+					dst_addr += err;
+					err = 0;
+				}
+				goto done;
+			}
+		}
+
+		err = mfill_atomic_ptes(dst_vma, &dst_addr, &src_addr,
+					dst_end, flags, &folio);
+		if (unlikely(err == -ENOENT)) {
+			up_read(&ctx->map_changing_lock);
+			uffd_mfill_unlock(dst_vma);
+			dst_vma = NULL;
+
+			err = mfill_atomic_copy_folio(folio, src_addr);
+			if (likely(!err))
+				goto retry;
+		}
+done:
+		range->ret = dst_addr != range->dst ? dst_addr - range->dst : err;
+		if (err || dst_addr != dst_end)
+			break;
+	}
+
+	if (dst_vma) {
+		up_read(&ctx->map_changing_lock);
+		uffd_mfill_unlock(dst_vma);
+	}
+	if (folio)
+		folio_put(folio);
+	return i;
+}
+
 long uffd_wp_range(struct vm_area_struct *dst_vma,
 		   unsigned long start, unsigned long len, bool enable_wp)
 {
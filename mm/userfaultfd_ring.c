@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Shared ring of userfaultfd messages.
+ *
+ * Instead of a wakeup and a read() per fault, a uffd handler can map a
+ * ring that the kernel posts struct uffd_msg entries to, and consume them
+ * in batches.  The mapping has the same shape as the BPF ring buffer:
+ *
+ *   page 0	consumer position, the only part mapped writable
+ *   page 1	producer position
+ *   page 2..	nr_entries struct uffd_msg, read-only
+ *
+ * Positions are free running u32 counters of messages, so the layout is the
+ * same for 32-bit and 64-bit handlers, and the entry of a position is at
+ * (pos & (nr_entries - 1)).  The handler reads the producer position with
+ * acquire semantics and stores the consumer position with release
+ * semantics once done with the messages before it.  A message that doesn't
+ * fit in the ring stays on the regular read() path.
+ *
+ * With UFFD_RING_MODE_BUSY_POLL the handler spins on the producer
+ * position, and posting a message skips waking up the uffd waiters.
+ */
+
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/userfaultfd_k.h>
+#include <linux/vmalloc.h>
+
+/* Consumer and producer position pages */
+#define UFFD_RING_META_PAGES	2
+
+struct uffd_ring {
+	/* serializes producers */
+	spinlock_t lock;
+	unsigned long mask;
+	unsigned int mode;
+	int nr_pages;
+	struct page **pages;
+	/* vmap of all pages, the layout userspace maps */
+	void *base;
+	u32 *consumer_pos;
+	u32 *producer_pos;
+	struct uffd_msg *msgs;
+};
+
+/**
+ * uffd_ring_alloc - allocate a message ring
+ * @nr_entries: number of messages, a power of two filling whole pages
+ * @mode: UFFD_RING_MODE_* flags
+ *
+ * Return: the ring, or an ERR_PTR().
+ */
+struct uffd_ring *uffd_ring_alloc(unsigned long nr_entries, unsigned int mode)
+{
+	struct uffd_ring *ring;
+	int i, nr_data_pages;
+
+	if (!is_power_of_2(nr_entries) ||
+	    nr_entries * sizeof(struct uffd_msg) < PAGE_SIZE ||
+	    nr_entries > UFFD_RING_MAX_ENTRIES)
+		return ERR_PTR(-EINVAL);
+	if (mode & ~UFFD_RING_MODE_BUSY_POLL)
+		return ERR_PTR(-EINVAL);
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL_ACCOUNT);
+	if (!ring)
+		return ERR_PTR(-ENOMEM);
+
+	nr_data_pages = nr_entries * sizeof(struct uffd_msg) >> PAGE_SHIFT;
+	ring->nr_pages = UFFD_RING_META_PAGES + nr_data_pages;
+	ring->pages = kvcalloc(ring->nr_pages, sizeof(*ring->pages),
+			       GFP_KERNEL_ACCOUNT);
+	if (!ring->pages)
+		goto err_free;
+
+	for (i = 0; i < ring->nr_pages; i++) {
+		ring->pages[i] = alloc_page(GFP_KERNEL_ACCOUNT | __GFP_ZERO);
+		if (!ring->pages[i])
+			goto err_free_pages;
+	}
+
+	ring->base = vmap(ring->pages, ring->nr_pages, VM_MAP | VM_USERMAP,
+			  PAGE_KERNEL);
+	if (!ring->base)
+		goto err_free_pages;
+
+	spin_lock_init(&ring->lock);
+	ring->mask = nr_entries - 1;
+	ring->mode = mode;
+	ring->consumer_pos = ring->base;
+	ring->producer_pos = ring->base + PAGE_SIZE;
+	ring->msgs = ring->base + UFFD_RING_META_PAGES * PAGE_SIZE;
+	return ring;
+
+err_free_pages:
+	while (i--)
+		__free_page(ring->pages[i]);
+	kvfree(ring->pages);
+err_free:
+	kfree(ring);
+	return ERR_PTR(-ENOMEM);
+}
+
+void uffd_ring_free(struct uffd_ring *ring)
+{
+	int i;
+
+	if (!ring)
+		return;
+
+	vunmap(ring->base);
+	for (i = 0; i < ring->nr_pages; i++)
+		__free_page(ring->pages[i]);
+	kvfree(ring->pages);
+	kfree(ring);
+}
+
+/**
+ * uffd_ring_mmap - map a message ring into userspace
+ * @ring: the ring
+ * @vma: the vma to map it into, from the uffd's ->mmap()
+ *
+ * Only the consumer position page may be mapped writable, and only on
+ * its own.
+ */
+int uffd_ring_mmap(struct uffd_ring *ring, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE) {
+		if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != PAGE_SIZE)
+			return -EPERM;
+	} else {
+		vm_flags_clear(vma, VM_MAYWRITE);
+	}
+
+	/* remap_vmalloc_range() checks size and offset constraints */
+	return remap_vmalloc_range(vma, ring->base, vma->vm_pgoff);
+}
+
+/**
+ * uffd_ring_post - post a message to the ring
+ * @ring: the ring
+ * @msg: the message
+ *
+ * Return: false if the ring is full, in which case the message has to be
+ * delivered through read().
+ */
+bool uffd_ring_post(struct uffd_ring *ring, const struct uffd_msg *msg)
+{
+	unsigned long flags;
+	u32 prod, cons;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	prod = *ring->producer_pos;
+	/* Pairs with userspace's store-release of the consumer position */
+	cons = smp_load_acquire(ring->consumer_pos);
+	if (prod - cons > ring->mask) {
+		spin_unlock_irqrestore(&ring->lock, flags);
+		return false;
+	}
+
+	ring->msgs[prod & ring->mask] = *msg;
+	/* Publish the message before the position that covers it */
+	smp_store_release(ring->producer_pos, prod + 1);
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	return true;
+}
+
+/* Whether posting to @ring needs to wake up the uffd waiters */
+bool uffd_ring_needs_wakeup(struct uffd_ring *ring)
+{
+	return !(ring->mode & UFFD_RING_MODE_BUSY_POLL);
+}
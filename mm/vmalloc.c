@@ -40,6 +40,7 @@
 #include <linux/pgtable.h>
 #include <linux/hugetlb.h>
 #include <linux/sched/mm.h>
+#include <linux/sysctl.h>
 #include <asm/tlbflush.h>
 #include <asm/shmparam.h>
 #include <linux/page_owner.h>
@@ -2091,10 +2092,17 @@ EXPORT_SYMBOL_GPL(unregister_vmap_purge_notifier);
  * code, and it will be simple to change the scale factor if we find that it
  * becomes a problem on bigger systems.
  */
+static unsigned long sysctl_vmap_lazy_max_pages __read_mostly;
+
 static unsigned long lazy_max_pages(void)
 {
+	unsigned long max = READ_ONCE(sysctl_vmap_lazy_max_pages);
 	unsigned int log;
 
+	/* Hosts with a lot of vmap churn may want to batch more */
+	if (max)
+		return max;
+
 	log = fls(num_online_cpus());
 
 	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
@@ -2102,6 +2110,17 @@ static unsigned long lazy_max_pages(void)
 
 static atomic_long_t vmap_lazy_nr = ATOMIC_LONG_INIT(0);
 
+/* TLB flush batching statistics, shown in /proc/vmallocstat */
+struct vmap_flush_stats {
+	unsigned long lazy_frees;
+	unsigned long lazy_purges;
+	unsigned long cache_frees;
+	unsigned long cache_hits;
+	unsigned long cache_evictions;
+};
+
+static DEFINE_PER_CPU(struct vmap_flush_stats, vmap_flush_stats);
+
 /*
  * Serialize vmap purging.  There is no actual critical section protected
  * by this lock, but we want to avoid concurrent calls for performance
@@ -2282,6 +2301,7 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end,
 	nr_purge_nodes = cpumask_weight(&purge_nodes);
 	if (nr_purge_nodes > 0) {
 		flush_tlb_kernel_range(start, end);
+		this_cpu_inc(vmap_flush_stats.lazy_purges);
 
 		/* One extra worker is per a lazy_max_pages() full set minus one. */
 		nr_purge_helpers = atomic_long_read(&vmap_lazy_nr) / lazy_max_pages();
@@ -2357,6 +2377,7 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 
 	nr_lazy = atomic_long_add_return(va_size(va) >> PAGE_SHIFT,
 					 &vmap_lazy_nr);
+	this_cpu_inc(vmap_flush_stats.lazy_frees);
 
 	/*
 	 * If it was request by a certain node we would like to
@@ -3322,6 +3343,194 @@ void vfree_atomic(const void *addr)
 		schedule_work(&p->wq);
 }
 
+/* Free a vm_struct removed from the vmap area tree */
+static void vfree_pages(struct vm_struct *vm)
+{
+	int i;
+
+	if (unlikely(vm->flags & VM_FLUSH_RESET_PERMS))
+		vm_reset_perms(vm);
+	for (i = 0; i < vm->nr_pages; i++) {
+		struct page *page = vm->pages[i];
+
+		BUG_ON(!page);
+		if (!(vm->flags & VM_MAP_PUT_PAGES))
+			mod_memcg_page_state(page, MEMCG_VMALLOC, -1);
+		/*
+		 * High-order allocs for huge vmallocs are split, so
+		 * can be freed as an array of order-0 allocations
+		 */
+		__free_page(page);
+		cond_resched();
+	}
+	if (!(vm->flags & VM_MAP_PUT_PAGES))
+		atomic_long_sub(vm->nr_pages, &nr_vmalloc_pages);
+	kvfree(vm->pages);
+	kfree(vm);
+}
+
+/* Free an area evicted from the per-CPU cache */
+static void vfree_area(struct vm_struct *vm)
+{
+	if (WARN_ON_ONCE(remove_vm_area(vm->addr) != vm))
+		return;
+
+	vfree_pages(vm);
+}
+
+/*
+ * Per-CPU cache of freed vmalloc() areas.
+ *
+ * Freeing a vmalloc() area unmaps it, and the lazily purged range costs a
+ * global TLB flush before its virtual addresses can be handed out again.
+ * High-churn users, like kvmalloc() of large buffers, keep allocating and
+ * freeing areas of the same size. To serve those, vfree() parks a plain
+ * PAGE_KERNEL area, still mapped and with its pages, in a small per-CPU
+ * cache. A later allocation of the same size takes it as is. The mapping
+ * never changes, so no TLB flush is needed at all.
+ *
+ * vm.vmalloc_pcp_cache_pages bounds the pages held per CPU, 0 (the
+ * default) disables the cache. The oldest areas are evicted when it is
+ * full, and the whole cache is dropped under memory pressure.
+ */
+#define VMALLOC_PCP_CACHE_SLOTS	8
+
+struct vmalloc_pcp_cache {
+	spinlock_t lock;
+	unsigned int nr;
+	unsigned long nr_pages;
+	/* Oldest first */
+	struct vm_struct *vms[VMALLOC_PCP_CACHE_SLOTS];
+};
+
+static DEFINE_PER_CPU(struct vmalloc_pcp_cache, vmalloc_pcp_cache);
+static unsigned long sysctl_vmalloc_pcp_cache_pages __read_mostly;
+
+static inline bool vmalloc_cache_enabled(void)
+{
+	return !IS_ENABLED(CONFIG_KASAN_VMALLOC) &&
+	       READ_ONCE(sysctl_vmalloc_pcp_cache_pages);
+}
+
+static struct vm_struct *
+vmalloc_cache_del(struct vmalloc_pcp_cache *pcp, unsigned int i)
+{
+	struct vm_struct *vm = pcp->vms[i];
+
+	vm->flags &= ~VM_CACHED;
+	pcp->nr--;
+	pcp->nr_pages -= vm->nr_pages;
+	memmove(&pcp->vms[i], &pcp->vms[i + 1],
+		(pcp->nr - i) * sizeof(pcp->vms[0]));
+
+	return vm;
+}
+
+static bool vmalloc_cache_put(struct vm_struct *vm)
+{
+	unsigned long limit = READ_ONCE(sysctl_vmalloc_pcp_cache_pages);
+	struct vm_struct *evict[VMALLOC_PCP_CACHE_SLOTS];
+	struct vmalloc_pcp_cache *pcp;
+	unsigned int i, nr_evict = 0;
+
+	/* Only plain vmalloc() areas of order-0, uncharged pages */
+	if ((vm->flags & ~VM_ALLOW_HUGE_VMAP) != VM_ALLOC ||
+	    !vm->nr_pages || vm->nr_pages > limit ||
+	    vm_area_page_order(vm) || PageMemcgKmem(vm->pages[0]) ||
+	    want_init_on_free())
+		return false;
+
+	debug_check_no_locks_freed(vm->addr, get_vm_area_size(vm));
+	debug_check_no_obj_freed(vm->addr, get_vm_area_size(vm));
+
+	pcp = raw_cpu_ptr(&vmalloc_pcp_cache);
+	spin_lock(&pcp->lock);
+	while (pcp->nr && (pcp->nr == VMALLOC_PCP_CACHE_SLOTS ||
+			   pcp->nr_pages + vm->nr_pages > limit))
+		evict[nr_evict++] = vmalloc_cache_del(pcp, 0);
+
+	vm->flags |= VM_CACHED;
+	pcp->vms[pcp->nr++] = vm;
+	pcp->nr_pages += vm->nr_pages;
+	spin_unlock(&pcp->lock);
+
+	this_cpu_inc(vmap_flush_stats.cache_frees);
+	this_cpu_add(vmap_flush_stats.cache_evictions, nr_evict);
+
+	for (i = 0; i < nr_evict; i++)
+		vfree_area(evict[i]);
+
+	return true;
+}
+
+static struct vm_struct *
+vmalloc_cache_get(unsigned long size, unsigned long align,
+		  unsigned long start, unsigned long end, gfp_t gfp_mask,
+		  pgprot_t prot, unsigned long vm_flags, int node)
+{
+	struct vmalloc_pcp_cache *pcp;
+	struct vm_struct *vm = NULL;
+	int i;
+
+	if (!vmalloc_cache_enabled() || start != VMALLOC_START ||
+	    end != VMALLOC_END || node != NUMA_NO_NODE ||
+	    pgprot_val(prot) != pgprot_val(PAGE_KERNEL) ||
+	    (gfp_mask & __GFP_ACCOUNT) || (vm_flags & ~VM_ALLOW_HUGE_VMAP))
+		return NULL;
+
+	size = PAGE_ALIGN(size);
+	pcp = raw_cpu_ptr(&vmalloc_pcp_cache);
+	spin_lock(&pcp->lock);
+	for (i = pcp->nr - 1; i >= 0; i--) {
+		if (get_vm_area_size(pcp->vms[i]) == size &&
+		    IS_ALIGNED((unsigned long)pcp->vms[i]->addr, align)) {
+			vm = vmalloc_cache_del(pcp, i);
+			break;
+		}
+	}
+	spin_unlock(&pcp->lock);
+
+	if (vm)
+		this_cpu_inc(vmap_flush_stats.cache_hits);
+
+	return vm;
+}
+
+static unsigned long vmalloc_cache_count(void)
+{
+	unsigned long count = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		count += READ_ONCE(per_cpu(vmalloc_pcp_cache, cpu).nr);
+
+	return count;
+}
+
+static void vmalloc_cache_drain(void)
+{
+	struct vm_struct *vms[VMALLOC_PCP_CACHE_SLOTS];
+	struct vmalloc_pcp_cache *pcp;
+	unsigned int i, nr;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		pcp = &per_cpu(vmalloc_pcp_cache, cpu);
+		if (!READ_ONCE(pcp->nr))
+			continue;
+
+		spin_lock(&pcp->lock);
+		nr = pcp->nr;
+		memcpy(vms, pcp->vms, nr * sizeof(vms[0]));
+		pcp->nr = 0;
+		pcp->nr_pages = 0;
+		spin_unlock(&pcp->lock);
+
+		for (i = 0; i < nr; i++)
+			vfree_area(vms[i]);
+	}
+}
+
 /**
  * vfree - Release memory allocated by vmalloc()
  * @addr:  Memory base address
@@ -3342,7 +3551,6 @@ void vfree_atomic(const void *addr)
 void vfree(const void *addr)
 {
 	struct vm_struct *vm;
-	int i;
 
 	if (unlikely(in_interrupt())) {
 		vfree_atomic(addr);
@@ -3356,6 +3564,21 @@ void vfree(const void *addr)
 	if (!addr)
 		return;
 
+	if (vmalloc_cache_enabled()) {
+		vm = find_vm_area(addr);
+		/*
+		 * A cached area is still in the busy tree. Freeing it again
+		 * must not cache it twice, or unmap it under the cache.
+		 */
+		if (unlikely(vm && (READ_ONCE(vm->flags) & VM_CACHED))) {
+			WARN(1, KERN_ERR "Trying to vfree() already freed vm area (%p)\n",
+			     addr);
+			return;
+		}
+		if (vm && vmalloc_cache_put(vm))
+			return;
+	}
+
 	vm = remove_vm_area(addr);
 	if (unlikely(!vm)) {
 		WARN(1, KERN_ERR "Trying to vfree() nonexistent vm area (%p)\n",
@@ -3363,25 +3586,7 @@ void vfree(const void *addr)
 		return;
 	}
 
-	if (unlikely(vm->flags & VM_FLUSH_RESET_PERMS))
-		vm_reset_perms(vm);
-	for (i = 0; i < vm->nr_pages; i++) {
-		struct page *page = vm->pages[i];
-
-		BUG_ON(!page);
-		if (!(vm->flags & VM_MAP_PUT_PAGES))
-			mod_memcg_page_state(page, MEMCG_VMALLOC, -1);
-		/*
-		 * High-order allocs for huge vmallocs are split, so
-		 * can be freed as an array of order-0 allocations
-		 */
-		__free_page(page);
-		cond_resched();
-	}
-	if (!(vm->flags & VM_MAP_PUT_PAGES))
-		atomic_long_sub(vm->nr_pages, &nr_vmalloc_pages);
-	kvfree(vm->pages);
-	kfree(vm);
+	vfree_pages(vm);
 }
 EXPORT_SYMBOL(vfree);
 
@@ -3802,6 +4007,19 @@ void *__vmalloc_node_range_noprof(unsigned long size, unsigned long align,
 		size = ALIGN(real_size, 1UL << shift);
 	}
 
+	if (shift == PAGE_SHIFT) {
+		area = vmalloc_cache_get(real_size, align, start, end, gfp_mask,
+					 prot, vm_flags, node);
+		if (area) {
+			area->flags = VM_ALLOC | vm_flags;
+			area->caller = caller;
+			if (want_init_on_alloc(gfp_mask))
+				memset(area->addr, 0, get_vm_area_size(area));
+			kmemleak_vmalloc(area, PAGE_ALIGN(size), gfp_mask);
+			return area->addr;
+		}
+	}
+
 again:
 	area = __get_vm_area_node(real_size, align, shift, VM_ALLOC |
 				  VM_UNINITIALIZED | vm_flags, start, end, node,
@@ -5014,6 +5232,9 @@ static int vmalloc_info_show(struct seq_file *m, void *p)
 			if (v->flags & VM_DMA_COHERENT)
 				seq_puts(m, " dma-coherent");
 
+			if (v->flags & VM_CACHED)
+				seq_puts(m, " cached");
+
 			if (is_vmalloc_addr(v->pages))
 				seq_puts(m, " vpages");
 
@@ -5030,6 +5251,41 @@ static int vmalloc_info_show(struct seq_file *m, void *p)
 	return 0;
 }
 
+/*
+ * Without batching every freed area would cost a TLB flush. Lazily freed
+ * areas share one flush per purge, and cached areas need none unless they
+ * are evicted, which frees them lazily.
+ */
+static int vmalloc_stat_show(struct seq_file *m, void *p)
+{
+	struct vmap_flush_stats sum = {};
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct vmap_flush_stats *stats = &per_cpu(vmap_flush_stats, cpu);
+
+		sum.lazy_frees += READ_ONCE(stats->lazy_frees);
+		sum.lazy_purges += READ_ONCE(stats->lazy_purges);
+		sum.cache_frees += READ_ONCE(stats->cache_frees);
+		sum.cache_hits += READ_ONCE(stats->cache_hits);
+		sum.cache_evictions += READ_ONCE(stats->cache_evictions);
+	}
+
+	seq_printf(m, "lazy_frees %lu\n", sum.lazy_frees);
+	seq_printf(m, "lazy_purges %lu\n", sum.lazy_purges);
+	seq_printf(m, "lazy_pages %ld\n", atomic_long_read(&vmap_lazy_nr));
+	seq_printf(m, "lazy_max_pages %lu\n", lazy_max_pages());
+	seq_printf(m, "cache_frees %lu\n", sum.cache_frees);
+	seq_printf(m, "cache_hits %lu\n", sum.cache_hits);
+	seq_printf(m, "cache_evictions %lu\n", sum.cache_evictions);
+	seq_printf(m, "cache_areas %lu\n", vmalloc_cache_count());
+	seq_printf(m, "tlb_flushes_avoided %lu\n",
+		   sum.cache_frees - sum.cache_evictions +
+		   sum.lazy_frees - sum.lazy_purges);
+
+	return 0;
+}
+
 static int __init proc_vmalloc_init(void)
 {
 	void *priv_data = NULL;
@@ -5039,6 +5295,7 @@ static int __init proc_vmalloc_init(void)
 
 	proc_create_single_data("vmallocinfo",
 		0400, NULL, vmalloc_info_show, priv_data);
+	proc_create_single("vmallocstat", 0400, NULL, vmalloc_stat_show);
 
 	return 0;
 }
@@ -5156,6 +5413,8 @@ vmap_node_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
 			count += READ_ONCE(vn->pool[j].len);
 	}
 
+	count += vmalloc_cache_count();
+
 	return count ? count : SHRINK_EMPTY;
 }
 
@@ -5164,12 +5423,50 @@ vmap_node_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 {
 	int i;
 
+	vmalloc_cache_drain();
+
 	for (i = 0; i < nr_vmap_nodes; i++)
 		decay_va_pool_node(&vmap_nodes[i], true);
 
 	return SHRINK_STOP;
 }
 
+static int vmalloc_pcp_cache_sysctl_handler(const struct ctl_table *table,
+		int write, void *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_doulongvec_minmax(table, write, buffer, length, ppos);
+	if (!ret && write)
+		vmalloc_cache_drain();
+
+	return ret;
+}
+
+static struct ctl_table vmalloc_sysctl_table[] = {
+	{
+		.procname	= "vmap_lazy_max_pages",
+		.data		= &sysctl_vmap_lazy_max_pages,
+		.maxlen		= sizeof(sysctl_vmap_lazy_max_pages),
+		.mode		= 0644,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
+	{
+		.procname	= "vmalloc_pcp_cache_pages",
+		.data		= &sysctl_vmalloc_pcp_cache_pages,
+		.maxlen		= sizeof(sysctl_vmalloc_pcp_cache_pages),
+		.mode		= 0644,
+		.proc_handler	= vmalloc_pcp_cache_sysctl_handler,
+	},
+};
+
+static int __init vmalloc_sysctl_init(void)
+{
+	register_sysctl_init("vm", vmalloc_sysctl_table);
+	return 0;
+}
+subsys_initcall(vmalloc_sysctl_init);
+
 void __init vmalloc_init(void)
 {
 	struct shrinker *vmap_node_shrinker;
@@ -5194,6 +5491,7 @@ void __init vmalloc_init(void)
 		init_llist_head(&p->list);
 		INIT_WORK(&p->wq, delayed_vfree_work);
 		xa_init(&vbq->vmap_blocks);
+		spin_lock_init(&per_cpu(vmalloc_pcp_cache, i).lock);
 	}
 
 	/*
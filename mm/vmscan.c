@@ -169,6 +169,13 @@ struct scan_control {
 	/* Number of pages freed so far during a call to shrink_zones() */
 	unsigned long nr_reclaimed;
 
+	/*
+	 * Parallel kswapd: when nr_memcg_shards > 1, only the memcgs whose
+	 * id falls into memcg_shard are reclaimed by this context.
+	 */
+	unsigned int memcg_shard;
+	unsigned int nr_memcg_shards;
+
 	struct {
 		unsigned int dirty;
 		unsigned int unqueued_dirty;
@@ -1023,6 +1030,7 @@ static unsigned int demote_folio_list(struct list_head *demote_folios,
 	migrate_pages(demote_folios, alloc_migrate_folio, NULL,
 		      (unsigned long)&mtc, MIGRATE_ASYNC, MR_DEMOTION,
 		      &nr_succeeded);
+	node_demotion_account(target_nid, nr_succeeded);
 
 	return nr_succeeded;
 }
@@ -4287,6 +4295,48 @@ void lru_gen_soft_reclaim(struct mem_cgroup *memcg, int nid)
 		lru_gen_rotate_memcg(lruvec, MEMCG_LRU_HEAD);
 }
 
+/*
+ * memory.lru_gen: for each node, a line per generation from the oldest to
+ * the youngest with its sequence number, age in milliseconds and number of
+ * anon and file pages.
+ */
+void lru_gen_memcg_show(struct seq_file *m, struct mem_cgroup *memcg)
+{
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY) {
+		struct lruvec *lruvec = get_lruvec(memcg, nid);
+		struct lru_gen_folio *lrugen = &lruvec->lrugen;
+		unsigned long seq;
+		DEFINE_MAX_SEQ(lruvec);
+		DEFINE_MIN_SEQ(lruvec);
+
+		seq_printf(m, "node %d\n", nid);
+
+		seq = min(min_seq[LRU_GEN_ANON], min_seq[LRU_GEN_FILE]);
+		for (; seq <= max_seq; seq++) {
+			int type, zone;
+			int gen = lru_gen_from_seq(seq);
+			unsigned long birth = READ_ONCE(lrugen->timestamps[gen]);
+
+			seq_printf(m, "%lu %u", seq, jiffies_to_msecs(jiffies - birth));
+
+			for (type = 0; type < ANON_AND_FILE; type++) {
+				unsigned long size = 0;
+
+				if (seq >= min_seq[type]) {
+					for (zone = 0; zone < MAX_NR_ZONES; zone++)
+						size += max(READ_ONCE(lrugen->nr_pages[gen][type][zone]), 0L);
+				}
+
+				seq_printf(m, " %lu", size);
+			}
+
+			seq_putc(m, '\n');
+		}
+	}
+}
+
 #endif /* CONFIG_MEMCG */
 
 /******************************************************************************
@@ -5118,6 +5168,82 @@ static void lru_gen_change_state(bool enabled)
 	cgroup_unlock();
 }
 
+/******************************************************************************
+ *                          proactive aging
+ ******************************************************************************/
+
+/*
+ * With aging_interval_ms set, every lruvec gets a new generation once its
+ * youngest one is older than the interval, whether or not reclaim needs it,
+ * so that the age of each generation tells how long its pages have been
+ * idle.  Aging stops at MAX_NR_GENS until reclaim evicts the oldest.
+ */
+static unsigned long lru_gen_aging_interval __read_mostly;
+
+static void lru_gen_aging_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(lru_gen_aging_work, lru_gen_aging_workfn);
+
+static void lru_gen_age_lruvec(struct lruvec *lruvec, struct scan_control *sc,
+			       unsigned long interval)
+{
+	bool can_swap = get_swappiness(lruvec, sc);
+	DEFINE_MAX_SEQ(lruvec);
+	DEFINE_MIN_SEQ(lruvec);
+	int gen = lru_gen_from_seq(max_seq);
+
+	if (time_is_after_jiffies(READ_ONCE(lruvec->lrugen.timestamps[gen]) + interval))
+		return;
+
+	if (min_seq[!can_swap] + MAX_NR_GENS - 1 <= max_seq)
+		return;
+
+	try_to_inc_max_seq(lruvec, max_seq, can_swap, false);
+}
+
+static void lru_gen_aging_workfn(struct work_struct *work)
+{
+	unsigned long interval = READ_ONCE(lru_gen_aging_interval);
+	struct mem_cgroup *memcg;
+	unsigned int flags;
+	struct blk_plug plug;
+	struct scan_control sc = {
+		.may_writepage = true,
+		.may_unmap = true,
+		.may_swap = true,
+		.reclaim_idx = MAX_NR_ZONES - 1,
+		.gfp_mask = GFP_KERNEL,
+	};
+
+	if (!interval)
+		return;
+
+	if (!lru_gen_enabled())
+		goto requeue;
+
+	set_task_reclaim_state(current, &sc.reclaim_state);
+	flags = memalloc_noreclaim_save();
+	blk_start_plug(&plug);
+	/* try_to_inc_max_seq() falls back to not walking page tables */
+	set_mm_walk(NULL, true);
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		int nid;
+
+		for_each_node_state(nid, N_MEMORY)
+			lru_gen_age_lruvec(get_lruvec(memcg, nid), &sc, interval);
+
+		cond_resched();
+	} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+
+	clear_mm_walk();
+	blk_finish_plug(&plug);
+	memalloc_noreclaim_restore(flags);
+	set_task_reclaim_state(current, NULL);
+requeue:
+	queue_delayed_work(system_unbound_wq, &lru_gen_aging_work, interval);
+}
+
 /******************************************************************************
  *                          sysfs interface
  ******************************************************************************/
@@ -5143,6 +5269,31 @@ static ssize_t min_ttl_ms_store(struct kobject *kobj, struct kobj_attribute *att
 
 static struct kobj_attribute lru_gen_min_ttl_attr = __ATTR_RW(min_ttl_ms);
 
+static ssize_t aging_interval_ms_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n",
+			  jiffies_to_msecs(READ_ONCE(lru_gen_aging_interval)));
+}
+
+static ssize_t aging_interval_ms_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t len)
+{
+	unsigned int msecs;
+
+	if (kstrtouint(buf, 0, &msecs))
+		return -EINVAL;
+
+	WRITE_ONCE(lru_gen_aging_interval, msecs_to_jiffies(msecs));
+	if (msecs)
+		mod_delayed_work(system_unbound_wq, &lru_gen_aging_work, 0);
+
+	return len;
+}
+
+static struct kobj_attribute lru_gen_aging_interval_attr = __ATTR_RW(aging_interval_ms);
+
 static ssize_t enabled_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
 {
 	unsigned int caps = 0;
@@ -5191,6 +5342,7 @@ static struct kobj_attribute lru_gen_enabled_attr = __ATTR_RW(enabled);
 
 static struct attribute *lru_gen_attrs[] = {
 	&lru_gen_min_ttl_attr.attr,
+	&lru_gen_aging_interval_attr.attr,
 	&lru_gen_enabled_attr.attr,
 	NULL
 };
@@ -5868,6 +6020,7 @@ static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 		.pgdat = pgdat,
 	};
 	struct mem_cgroup_reclaim_cookie *partial = &reclaim;
+	struct shrink_slab_batch slab_batch;
 	struct mem_cgroup *memcg;
 
 	/*
@@ -5882,6 +6035,9 @@ static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 	if (current_is_kswapd() || sc->memcg_full_walk)
 		partial = NULL;
 
+	shrink_slab_batch_init(&slab_batch, sc->gfp_mask, pgdat->node_id,
+			       sc->priority);
+
 	memcg = mem_cgroup_iter(target_memcg, NULL, partial);
 	do {
 		struct lruvec *lruvec = mem_cgroup_lruvec(memcg, pgdat);
@@ -5898,6 +6054,11 @@ static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 
 		mem_cgroup_calculate_protection(target_memcg, memcg);
 
+		/* The other kswapd workers take care of this memcg */
+		if (sc->nr_memcg_shards > 1 &&
+		    mem_cgroup_id(memcg) % sc->nr_memcg_shards != sc->memcg_shard)
+			continue;
+
 		if (mem_cgroup_below_min(target_memcg, memcg)) {
 			/*
 			 * Hard protection.
@@ -5923,8 +6084,7 @@ static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 
 		shrink_lruvec(lruvec, sc);
 
-		shrink_slab(sc->gfp_mask, pgdat->node_id, memcg,
-			    sc->priority);
+		shrink_slab_batch_add(&slab_batch, memcg);
 
 		/* Record the group's reclaim efficiency */
 		if (!sc->proactive)
@@ -5938,6 +6098,8 @@ static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 			break;
 		}
 	} while ((memcg = mem_cgroup_iter(target_memcg, memcg, partial)));
+
+	shrink_slab_batch_finish(&slab_batch);
 }
 
 static void shrink_node(pg_data_t *pgdat, struct scan_control *sc)
@@ -6754,12 +6916,338 @@ static bool prepare_kswapd_sleep(pg_data_t *pgdat, int order,
  * reclaim or if the lack of progress was due to pages under writeback.
  * This is used to determine if the scanning priority needs to be raised.
  */
+/*
+ * Parallel kswapd
+ *
+ * A single kswapd thread per node can fall behind when a large node is
+ * under heavy allocation pressure, pushing allocators into direct reclaim.
+ * vm.kswapd_workers allows up to KSWAPD_MAX_WORKERS helper threads per
+ * node. For every shrink_node() pass kswapd decides how many of them to
+ * use based on how far the node is below its high watermarks, and splits
+ * the memcg tree between itself and the helpers by memcg id. The helpers
+ * never run on their own; kswapd waits for them before it looks at the
+ * watermarks again, so the balancing logic in balance_pgdat() is unchanged.
+ *
+ * The memcg tree is the unit of work, so the helpers are not used when
+ * memcg is disabled or with MGLRU, which walks the memcgs itself.
+ */
+#define KSWAPD_MAX_WORKERS	4
+
+static unsigned int sysctl_kswapd_workers __read_mostly;
+static DEFINE_MUTEX(kswapd_workers_mutex);
+
+struct kswapd_workers {
+	pg_data_t *pgdat;
+	/* Held by kswapd for a whole round, and to (re)configure the workers */
+	struct mutex lock;
+	struct task_struct *tasks[KSWAPD_MAX_WORKERS];
+	unsigned int nr_tasks;
+
+	/*
+	 * Round parameters, published by the seq increment.  Every worker
+	 * acknowledges every round in done_seq, also when it has no shard in
+	 * it, so the parameters do not change while a worker reads them.
+	 */
+	wait_queue_head_t wait;
+	unsigned int seq;
+	unsigned int nr_active;
+	unsigned int nr_shards;
+	unsigned long nr_to_reclaim;
+	s8 order;
+	s8 priority;
+	s8 reclaim_idx;
+	unsigned int may_writepage:1;
+	unsigned int may_swap:1;
+
+	/* Round results */
+	wait_queue_head_t done_wait;
+	unsigned int done_seq[KSWAPD_MAX_WORKERS];
+	atomic_long_t nr_scanned;
+	atomic_long_t nr_reclaimed;
+};
+
+struct kswapd_worker_arg {
+	struct kswapd_workers *kw;
+	unsigned int idx;
+	unsigned int seq;
+};
+
+static void kswapd_worker_shrink(struct kswapd_workers *kw, unsigned int idx)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.order = kw->order,
+		.priority = kw->priority,
+		.reclaim_idx = kw->reclaim_idx,
+		.may_writepage = kw->may_writepage,
+		.may_unmap = 1,
+		.may_swap = kw->may_swap,
+		.nr_to_reclaim = kw->nr_to_reclaim,
+		.memcg_shard = idx + 1,
+		.nr_memcg_shards = kw->nr_shards,
+	};
+	unsigned long pflags;
+
+	set_task_reclaim_state(current, &sc.reclaim_state);
+	psi_memstall_enter(&pflags);
+	__fs_reclaim_acquire(_THIS_IP_);
+
+	shrink_node(kw->pgdat, &sc);
+
+	__fs_reclaim_release(_THIS_IP_);
+	psi_memstall_leave(&pflags);
+	set_task_reclaim_state(current, NULL);
+
+	count_vm_events(PGSCAN_KSWAPD_WORKER1 + idx, sc.nr_scanned);
+	count_vm_events(PGSTEAL_KSWAPD_WORKER1 + idx, sc.nr_reclaimed);
+	atomic_long_add(sc.nr_scanned, &kw->nr_scanned);
+	atomic_long_add(sc.nr_reclaimed, &kw->nr_reclaimed);
+}
+
+static int kswapd_worker(void *p)
+{
+	struct kswapd_worker_arg arg = *(struct kswapd_worker_arg *)p;
+	struct kswapd_workers *kw = arg.kw;
+	const struct cpumask *cpumask = cpumask_of_node(kw->pgdat->node_id);
+	unsigned int seq = arg.seq;
+
+	kfree(p);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	/*
+	 * The workers are not freezable: they only reclaim on behalf of
+	 * kswapd, which is, and which waits for them to finish each round.
+	 */
+	current->flags |= PF_MEMALLOC | PF_KSWAPD;
+
+	for ( ; ; ) {
+		wait_event_idle(kw->wait, READ_ONCE(kw->seq) != seq ||
+				kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		/*
+		 * kswapd waits for this worker before the next round, so this
+		 * is the round it is waiting for.  Pairs with the
+		 * smp_store_release() in kswapd_workers_start().
+		 */
+		seq = smp_load_acquire(&kw->seq);
+		if (arg.idx < kw->nr_active)
+			kswapd_worker_shrink(kw, arg.idx);
+
+		/* Pairs with smp_load_acquire() in kswapd_workers_done() */
+		smp_store_release(&kw->done_seq[arg.idx], seq);
+		wake_up(&kw->done_wait);
+	}
+
+	current->flags &= ~(PF_MEMALLOC | PF_KSWAPD);
+
+	return 0;
+}
+
+/* Start or stop workers on @pgdat to match vm.kswapd_workers */
+static void kswapd_workers_update(pg_data_t *pgdat, unsigned int nr)
+{
+	struct kswapd_workers *kw = pgdat->kswapd_workers;
+	struct kswapd_worker_arg *arg;
+	struct task_struct *tsk;
+
+	if (!kw) {
+		if (!nr)
+			return;
+
+		kw = kzalloc_node(sizeof(*kw), GFP_KERNEL, pgdat->node_id);
+		if (!kw)
+			return;
+
+		kw->pgdat = pgdat;
+		mutex_init(&kw->lock);
+		init_waitqueue_head(&kw->wait);
+		init_waitqueue_head(&kw->done_wait);
+		/* Pairs with smp_load_acquire() in kswapd_workers_start() */
+		smp_store_release(&pgdat->kswapd_workers, kw);
+	}
+
+	mutex_lock(&kw->lock);
+	while (kw->nr_tasks > nr) {
+		kw->nr_tasks--;
+		kthread_stop(kw->tasks[kw->nr_tasks]);
+		kw->tasks[kw->nr_tasks] = NULL;
+	}
+	while (kw->nr_tasks < nr) {
+		arg = kmalloc(sizeof(*arg), GFP_KERNEL);
+		if (!arg)
+			break;
+
+		/* No round is running, the new worker starts out idle. */
+		arg->kw = kw;
+		arg->idx = kw->nr_tasks;
+		arg->seq = kw->seq;
+		kw->done_seq[arg->idx] = kw->seq;
+		tsk = kthread_run(kswapd_worker, arg, "kswapd%d:%u",
+				  pgdat->node_id, kw->nr_tasks + 1);
+		if (IS_ERR(tsk)) {
+			kfree(arg);
+			pr_warn("Failed to start kswapd worker on node %d, ret=%ld\n",
+				pgdat->node_id, PTR_ERR(tsk));
+			break;
+		}
+		kw->tasks[kw->nr_tasks++] = tsk;
+	}
+	mutex_unlock(&kw->lock);
+}
+
+static void kswapd_workers_free(pg_data_t *pgdat)
+{
+	struct kswapd_workers *kw = pgdat->kswapd_workers;
+
+	if (!kw)
+		return;
+
+	kswapd_workers_update(pgdat, 0);
+	pgdat->kswapd_workers = NULL;
+	kfree(kw);
+}
+
+/*
+ * How many workers to use for this pass: scale with how far the eligible
+ * zones are below their high watermarks.
+ */
+static unsigned int kswapd_workers_wanted(pg_data_t *pgdat,
+					  struct scan_control *sc,
+					  struct kswapd_workers *kw)
+{
+	unsigned long free = 0, high = 0;
+	struct zone *zone;
+	int z;
+
+	for (z = 0; z <= sc->reclaim_idx; z++) {
+		zone = pgdat->node_zones + z;
+		if (!managed_zone(zone))
+			continue;
+
+		free += zone_page_state(zone, NR_FREE_PAGES);
+		high += high_wmark_pages(zone);
+	}
+
+	if (free >= high)
+		return 0;
+
+	return DIV_ROUND_UP((high - free) * kw->nr_tasks, high);
+}
+
+/*
+ * Hand shards 1..n of the memcg tree to the workers. Returns the number
+ * of workers started, with kw->lock held if it is non-zero.
+ */
+static unsigned int kswapd_workers_start(pg_data_t *pgdat,
+					 struct scan_control *sc)
+{
+	struct kswapd_workers *kw = smp_load_acquire(&pgdat->kswapd_workers);
+	unsigned int nr;
+
+	if (!kw || !READ_ONCE(kw->nr_tasks) || mem_cgroup_disabled() ||
+	    lru_gen_enabled())
+		return 0;
+
+	/* Don't wait behind a reconfiguration, just reclaim alone */
+	if (!mutex_trylock(&kw->lock))
+		return 0;
+
+	nr = kswapd_workers_wanted(pgdat, sc, kw);
+	if (!nr) {
+		mutex_unlock(&kw->lock);
+		return 0;
+	}
+
+	kw->nr_active = nr;
+	kw->nr_shards = nr + 1;
+	kw->nr_to_reclaim = DIV_ROUND_UP(sc->nr_to_reclaim, nr + 1);
+	kw->order = sc->order;
+	kw->priority = sc->priority;
+	kw->reclaim_idx = sc->reclaim_idx;
+	kw->may_writepage = sc->may_writepage;
+	kw->may_swap = sc->may_swap;
+	smp_store_release(&kw->seq, kw->seq + 1);
+	wake_up_all(&kw->wait);
+
+	sc->memcg_shard = 0;
+	sc->nr_memcg_shards = nr + 1;
+
+	return nr;
+}
+
+/* Have all workers acknowledged the current round? */
+static bool kswapd_workers_done(struct kswapd_workers *kw)
+{
+	unsigned int i;
+
+	for (i = 0; i < kw->nr_tasks; i++)
+		if (smp_load_acquire(&kw->done_seq[i]) != kw->seq)
+			return false;
+	return true;
+}
+
+static void kswapd_workers_finish(pg_data_t *pgdat, struct scan_control *sc)
+{
+	struct kswapd_workers *kw = pgdat->kswapd_workers;
+
+	wait_event(kw->done_wait, kswapd_workers_done(kw));
+
+	sc->nr_scanned += atomic_long_xchg(&kw->nr_scanned, 0);
+	sc->nr_reclaimed += atomic_long_xchg(&kw->nr_reclaimed, 0);
+	sc->memcg_shard = 0;
+	sc->nr_memcg_shards = 0;
+
+	mutex_unlock(&kw->lock);
+}
+
+static int kswapd_workers_sysctl_handler(const struct ctl_table *table,
+		int write, void *buffer, size_t *length, loff_t *ppos)
+{
+	int ret, nid;
+
+	mutex_lock(&kswapd_workers_mutex);
+	ret = proc_douintvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		goto out;
+
+	get_online_mems();
+	for_each_node_state(nid, N_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		pgdat_kswapd_lock(pgdat);
+		if (pgdat->kswapd)
+			kswapd_workers_update(pgdat, sysctl_kswapd_workers);
+		pgdat_kswapd_unlock(pgdat);
+	}
+	put_online_mems();
+out:
+	mutex_unlock(&kswapd_workers_mutex);
+	return ret;
+}
+
+static struct ctl_table kswapd_workers_sysctl_table[] = {
+	{
+		.procname	= "kswapd_workers",
+		.data		= &sysctl_kswapd_workers,
+		.maxlen		= sizeof(sysctl_kswapd_workers),
+		.mode		= 0644,
+		.proc_handler	= kswapd_workers_sysctl_handler,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_FOUR,
+	},
+};
+
 static bool kswapd_shrink_node(pg_data_t *pgdat,
 			       struct scan_control *sc)
 {
 	struct zone *zone;
 	int z;
 	unsigned long nr_reclaimed = sc->nr_reclaimed;
+	unsigned int nr_workers;
 
 	/* Reclaim a number of pages proportional to the number of zones */
 	sc->nr_to_reclaim = 0;
@@ -6775,7 +7263,10 @@ static bool kswapd_shrink_node(pg_data_t *pgdat,
 	 * Historically care was taken to put equal pressure on all zones but
 	 * now pressure is applied based on node LRU order.
 	 */
+	nr_workers = kswapd_workers_start(pgdat, sc);
 	shrink_node(pgdat, sc);
+	if (nr_workers)
+		kswapd_workers_finish(pgdat, sc);
 
 	/*
 	 * Fragmentation may mean that the system cannot be rebalanced for
@@ -7354,6 +7845,9 @@ void __meminit kswapd_run(int nid)
 				   nid, PTR_ERR(pgdat->kswapd));
 			BUG_ON(system_state < SYSTEM_RUNNING);
 			pgdat->kswapd = NULL;
+		} else {
+			kswapd_workers_update(pgdat,
+					      READ_ONCE(sysctl_kswapd_workers));
 		}
 	}
 	pgdat_kswapd_unlock(pgdat);
@@ -7374,6 +7868,7 @@ void __meminit kswapd_stop(int nid)
 		kthread_stop(kswapd);
 		pgdat->kswapd = NULL;
 	}
+	kswapd_workers_free(pgdat);
 	pgdat_kswapd_unlock(pgdat);
 }
 
@@ -7384,6 +7879,7 @@ static int __init kswapd_init(void)
 	swap_setup();
 	for_each_node_state(nid, N_MEMORY)
  		kswapd_run(nid);
+	register_sysctl_init("vm", kswapd_workers_sysctl_table);
 	return 0;
 }
 
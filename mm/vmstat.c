@@ -1312,6 +1312,14 @@ const char * const vmstat_text[] = {
 	"pgscan_file",
 	"pgsteal_anon",
 	"pgsteal_file",
+	"pgscan_kswapd_worker1",
+	"pgscan_kswapd_worker2",
+	"pgscan_kswapd_worker3",
+	"pgscan_kswapd_worker4",
+	"pgsteal_kswapd_worker1",
+	"pgsteal_kswapd_worker2",
+	"pgsteal_kswapd_worker3",
+	"pgsteal_kswapd_worker4",
 
 #ifdef CONFIG_NUMA
 	"zone_reclaim_success",
@@ -1329,6 +1337,18 @@ const char * const vmstat_text[] = {
 	"drop_pagecache",
 	"drop_slab",
 	"oom_kill",
+	"zone_lock_ns_order0",
+	"zone_lock_ns_order1",
+	"zone_lock_ns_order2",
+	"zone_lock_ns_order3",
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	"zone_lock_ns_order4",
+	"zone_lock_ns_order5",
+	"zone_lock_ns_order6",
+	"zone_lock_ns_order7",
+	"zone_lock_ns_order8",
+	"zone_lock_ns_pmd",
+#endif
 
 #ifdef CONFIG_NUMA_BALANCING
 	"numa_pte_updates",
@@ -1397,6 +1417,8 @@ const char * const vmstat_text[] = {
 	"thp_zero_page_alloc_failed",
 	"thp_swpout",
 	"thp_swpout_fallback",
+	"thp_swpin",
+	"thp_swpin_fallback",
 #endif
 #ifdef CONFIG_MEMORY_BALLOON
 	"balloon_inflate",
@@ -1438,6 +1460,8 @@ const char * const vmstat_text[] = {
 	"vma_lock_abort",
 	"vma_lock_retry",
 	"vma_lock_miss",
+	"vma_lock_madvise",
+	"vma_lock_madvise_fallback",
 #endif
 #ifdef CONFIG_DEBUG_STACK_USAGE
 	"kstack_1k",
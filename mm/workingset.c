@@ -16,6 +16,7 @@
 #include <linux/dax.h>
 #include <linux/fs.h>
 #include <linux/mm.h>
+#include <linux/sysctl.h>
 #include "internal.h"
 
 /*
@@ -196,6 +197,14 @@
  */
 static unsigned int bucket_order __read_mostly;
 
+/*
+ * vm.workingset_refault_histogram: account refaults by refault distance
+ * in memory.refault_histogram of the memcg whose LRU ordered the eviction.
+ */
+static DEFINE_STATIC_KEY_FALSE(refault_histogram_key);
+static unsigned int sysctl_refault_histogram;
+static DEFINE_MUTEX(refault_histogram_mutex);
+
 static void *pack_shadow(int memcgid, pg_data_t *pgdat, unsigned long eviction,
 			 bool workingset)
 {
@@ -296,6 +305,16 @@ static void lru_gen_refault(struct folio *folio, void *shadow)
 
 	mod_lruvec_state(lruvec, WORKINGSET_REFAULT_BASE + type, delta);
 
+	if (static_branch_unlikely(&refault_histogram_key)) {
+		unsigned long mask = EVICTION_MASK >> LRU_REFS_WIDTH;
+		unsigned long min_seq = READ_ONCE(lruvec->lrugen.min_seq[type]);
+
+		/* generations the oldest one moved on since the eviction */
+		mem_cgroup_count_refault(lruvec_memcg(lruvec),
+				(min_seq - (token >> LRU_REFS_WIDTH)) & mask,
+				true, delta);
+	}
+
 	if (!recent)
 		goto unlock;
 
@@ -404,20 +423,12 @@ void *workingset_eviction(struct folio *folio, struct mem_cgroup *target_memcg)
 				folio_test_workingset(folio));
 }
 
-/**
- * workingset_test_recent - tests if the shadow entry is for a folio that was
- * recently evicted. Also fills in @workingset with the value unpacked from
- * shadow.
- * @shadow: the shadow entry to be tested.
- * @file: whether the corresponding folio is from the file lru.
- * @workingset: where the workingset value unpacked from shadow should
- * be stored.
- * @flush: whether to flush cgroup rstat.
- *
- * Return: true if the shadow is for a recently evicted folio; false otherwise.
+/*
+ * workingset_test_recent(), and with @nr_refault account the refault of
+ * @nr_refault pages in the refault histogram.
  */
-bool workingset_test_recent(void *shadow, bool file, bool *workingset,
-				bool flush)
+static bool __workingset_test_recent(void *shadow, bool file, bool *workingset,
+				     bool flush, long nr_refault)
 {
 	struct mem_cgroup *eviction_memcg;
 	struct lruvec *eviction_lruvec;
@@ -522,10 +533,32 @@ bool workingset_test_recent(void *shadow, bool file, bool *workingset,
 		}
 	}
 
+	if (nr_refault && static_branch_unlikely(&refault_histogram_key))
+		mem_cgroup_count_refault(eviction_memcg, refault_distance,
+					 false, nr_refault);
+
 	mem_cgroup_put(eviction_memcg);
 	return refault_distance <= workingset_size;
 }
 
+/**
+ * workingset_test_recent - tests if the shadow entry is for a folio that was
+ * recently evicted. Also fills in @workingset with the value unpacked from
+ * shadow.
+ * @shadow: the shadow entry to be tested.
+ * @file: whether the corresponding folio is from the file lru.
+ * @workingset: where the workingset value unpacked from shadow should
+ * be stored.
+ * @flush: whether to flush cgroup rstat.
+ *
+ * Return: true if the shadow is for a recently evicted folio; false otherwise.
+ */
+bool workingset_test_recent(void *shadow, bool file, bool *workingset,
+				bool flush)
+{
+	return __workingset_test_recent(shadow, file, workingset, flush, 0);
+}
+
 /**
  * workingset_refault - Evaluate the refault of a previously evicted folio.
  * @folio: The freshly allocated replacement folio.
@@ -566,7 +599,7 @@ void workingset_refault(struct folio *folio, void *shadow)
 
 	mod_lruvec_state(lruvec, WORKINGSET_REFAULT_BASE + file, nr);
 
-	if (!workingset_test_recent(shadow, file, &workingset, true))
+	if (!__workingset_test_recent(shadow, file, &workingset, true, nr))
 		return;
 
 	folio_set_active(folio);
@@ -795,6 +828,36 @@ static unsigned long scan_shadow_nodes(struct shrinker *shrinker,
  */
 static struct lock_class_key shadow_nodes_key;
 
+static int refault_histogram_sysctl_handler(const struct ctl_table *table,
+		int write, void *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	mutex_lock(&refault_histogram_mutex);
+	ret = proc_douintvec_minmax(table, write, buffer, length, ppos);
+	if (!ret && write) {
+		if (sysctl_refault_histogram)
+			static_branch_enable(&refault_histogram_key);
+		else
+			static_branch_disable(&refault_histogram_key);
+	}
+	mutex_unlock(&refault_histogram_mutex);
+
+	return ret;
+}
+
+static struct ctl_table workingset_sysctl_table[] = {
+	{
+		.procname	= "workingset_refault_histogram",
+		.data		= &sysctl_refault_histogram,
+		.maxlen		= sizeof(sysctl_refault_histogram),
+		.mode		= 0644,
+		.proc_handler	= refault_histogram_sysctl_handler,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
+};
+
 static int __init workingset_init(void)
 {
 	struct shrinker *workingset_shadow_shrinker;
@@ -834,6 +897,7 @@ static int __init workingset_init(void)
 	workingset_shadow_shrinker->seeks = 0;
 
 	shrinker_register(workingset_shadow_shrinker);
+	register_sysctl_init("vm", workingset_sysctl_table);
 	return 0;
 err_list_lru:
 	shrinker_free(workingset_shadow_shrinker);
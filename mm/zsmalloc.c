@@ -61,6 +61,7 @@
 #include <linux/zsmalloc.h>
 #include <linux/zpool.h>
 #include <linux/migrate.h>
+#include <linux/mutex.h>
 #include <linux/wait.h>
 #include <linux/pagemap.h>
 #include <linux/fs.h>
@@ -182,6 +183,29 @@ static struct dentry *zs_stat_root;
 
 static size_t huge_class_size;
 
+/* All pools, for the cpu hotplug callbacks */
+static LIST_HEAD(zs_pools);
+static DEFINE_MUTEX(zs_pools_lock);
+
+/*
+ * Per-cpu caches of allocated objects, one for each size class that isn't
+ * huge.  zs_free() parks the handle in the cache of the freeing cpu and
+ * zs_malloc() hands a parked handle out again, so only refilling and
+ * draining a cache take the class lock.  The cached objects stay allocated
+ * and keep their handles, so migration and compaction move them like any
+ * other object.  The caches are drained by compaction, the shrinker and
+ * when a cpu goes offline.
+ */
+#define ZS_PCP_MAX_OBJS		16
+/* Bound the memory a cache can hold on to */
+#define ZS_PCP_MAX_BYTES	(2 * PAGE_SIZE)
+
+struct zs_pcp {
+	spinlock_t lock;
+	unsigned int nr;
+	unsigned long handles[ZS_PCP_MAX_OBJS];
+};
+
 struct size_class {
 	spinlock_t lock;
 	struct list_head fullness_list[NR_FULLNESS_GROUPS];
@@ -196,6 +220,10 @@ struct size_class {
 
 	unsigned int index;
 	struct zs_size_stat stats;
+
+	/* Number of handles a zs_pcp may hold, 0 if there are no caches */
+	unsigned int pcp_max;
+	struct zs_pcp __percpu *pcp;
 };
 
 /*
@@ -241,6 +269,9 @@ struct zs_pool {
 	/* protect page/zspage migration */
 	rwlock_t migrate_lock;
 	atomic_t compaction_in_progress;
+
+	/* On zs_pools, to drain the per-cpu caches of a dead cpu */
+	struct list_head list;
 };
 
 struct zspage {
@@ -532,6 +563,25 @@ static inline unsigned long class_stat_read(struct size_class *class, int type)
 	return class->stats.objs[type];
 }
 
+/*
+ * ZS_OBJS_INUSE counts the objects parked in the per-cpu caches too, they
+ * are allocated in their zspages.  To the users of the pool they are free,
+ * and they are given back by draining the caches.
+ */
+static unsigned long class_objs_inuse(struct size_class *class)
+{
+	unsigned long inuse = class_stat_read(class, ZS_OBJS_INUSE);
+	unsigned long cached = 0;
+	int cpu;
+
+	if (class->pcp) {
+		for_each_possible_cpu(cpu)
+			cached += READ_ONCE(per_cpu_ptr(class->pcp, cpu)->nr);
+	}
+
+	return inuse - min(cached, inuse);
+}
+
 #ifdef CONFIG_ZSMALLOC_STAT
 
 static void __init zs_stat_init(void)
@@ -549,7 +599,8 @@ static void __exit zs_stat_exit(void)
 	debugfs_remove_recursive(zs_stat_root);
 }
 
-static unsigned long zs_can_compact(struct size_class *class);
+static unsigned long zs_can_compact(struct size_class *class,
+				    unsigned long obj_used);
 
 static int zs_stats_size_show(struct seq_file *s, void *v)
 {
@@ -584,8 +635,8 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 		}
 
 		obj_allocated = class_stat_read(class, ZS_OBJS_ALLOCATED);
-		obj_used = class_stat_read(class, ZS_OBJS_INUSE);
-		freeable = zs_can_compact(class);
+		obj_used = class_objs_inuse(class);
+		freeable = zs_can_compact(class, obj_used);
 		spin_unlock(&class->lock);
 
 		objs_per_zspage = class->objs_per_zspage;
@@ -1109,12 +1160,29 @@ static int zs_cpu_prepare(unsigned int cpu)
 	return __zs_cpu_up(area);
 }
 
+static void zs_pcp_drain_cpu(struct zs_pool *pool, struct size_class *class,
+			     int cpu);
+
 static int zs_cpu_dead(unsigned int cpu)
 {
 	struct mapping_area *area;
+	struct size_class *class;
+	struct zs_pool *pool;
+	int i;
 
 	area = &per_cpu(zs_map_area, cpu);
 	__zs_cpu_down(area);
+
+	/* Nothing allocates from the caches of @cpu anymore */
+	mutex_lock(&zs_pools_lock);
+	list_for_each_entry(pool, &zs_pools, list) {
+		for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+			class = pool->size_class[i];
+			if (class->index == i && class->pcp)
+				zs_pcp_drain_cpu(pool, class, cpu);
+		}
+	}
+	mutex_unlock(&zs_pools_lock);
 	return 0;
 }
 
@@ -1337,6 +1405,67 @@ static unsigned long obj_malloc(struct zs_pool *pool,
 	return obj;
 }
 
+static unsigned long zs_pcp_pop(struct size_class *class)
+{
+	struct zs_pcp *pcp;
+	unsigned long handle = 0;
+
+	pcp = raw_cpu_ptr(class->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->nr)
+		handle = pcp->handles[--pcp->nr];
+	spin_unlock(&pcp->lock);
+
+	return handle;
+}
+
+/*
+ * Called with class->lock held, allocates up to half a cache worth of
+ * objects from the zspages the class already has.
+ */
+static unsigned int zs_pcp_refill(struct zs_pool *pool, struct size_class *class,
+				  unsigned long *handles)
+{
+	struct zspage *zspage;
+	unsigned int nr = 0;
+
+	while (nr < class->pcp_max / 2) {
+		zspage = find_get_zspage(class);
+		if (!zspage)
+			break;
+
+		handles[nr] = cache_alloc_handle(pool, GFP_NOWAIT | __GFP_NOWARN);
+		if (!handles[nr])
+			break;
+
+		obj_malloc(pool, zspage, handles[nr]);
+		fix_fullness_group(class, zspage);
+		class_stat_add(class, ZS_OBJS_INUSE, 1);
+		nr++;
+	}
+
+	return nr;
+}
+
+static void zs_free_batch(struct zs_pool *pool, struct size_class *class,
+			  unsigned long *handles, unsigned int nr);
+
+static void zs_pcp_fill(struct zs_pool *pool, struct size_class *class,
+			unsigned long *handles, unsigned int nr)
+{
+	struct zs_pcp *pcp;
+	unsigned int i;
+
+	pcp = raw_cpu_ptr(class->pcp);
+	spin_lock(&pcp->lock);
+	for (i = 0; i < nr && pcp->nr < class->pcp_max; i++)
+		pcp->handles[pcp->nr++] = handles[i];
+	spin_unlock(&pcp->lock);
+
+	/* Frees on this cpu may have filled it up in the meantime */
+	if (i < nr)
+		zs_free_batch(pool, class, handles + i, nr - i);
+}
 
 /**
  * zs_malloc - Allocate block of given size from pool.
@@ -1350,8 +1479,10 @@ static unsigned long obj_malloc(struct zs_pool *pool,
  */
 unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 {
+	unsigned long handles[ZS_PCP_MAX_OBJS / 2];
 	unsigned long handle;
 	struct size_class *class;
+	unsigned int nr;
 	int newfg;
 	struct zspage *zspage;
 
@@ -1361,14 +1492,20 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 	if (unlikely(size > ZS_MAX_ALLOC_SIZE))
 		return (unsigned long)ERR_PTR(-ENOSPC);
 
-	handle = cache_alloc_handle(pool, gfp);
-	if (!handle)
-		return (unsigned long)ERR_PTR(-ENOMEM);
-
 	/* extra space in chunk to keep the handle */
 	size += ZS_HANDLE_SIZE;
 	class = pool->size_class[get_size_class_index(size)];
 
+	if (class->pcp) {
+		handle = zs_pcp_pop(class);
+		if (handle)
+			return handle;
+	}
+
+	handle = cache_alloc_handle(pool, gfp);
+	if (!handle)
+		return (unsigned long)ERR_PTR(-ENOMEM);
+
 	/* class->lock effectively protects the zpage migration */
 	spin_lock(&class->lock);
 	zspage = find_get_zspage(class);
@@ -1378,7 +1515,15 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 		fix_fullness_group(class, zspage);
 		class_stat_add(class, ZS_OBJS_INUSE, 1);
 
-		goto out;
+		if (!class->pcp)
+			goto out;
+
+		nr = zs_pcp_refill(pool, class, handles);
+		spin_unlock(&class->lock);
+
+		if (nr)
+			zs_pcp_fill(pool, class, handles, nr);
+		return handle;
 	}
 
 	spin_unlock(&class->lock);
@@ -1433,13 +1578,113 @@ static void obj_free(int class_size, unsigned long obj)
 	mod_zspage_inuse(zspage, -1);
 }
 
+/* Called with class->lock held */
+static void __zs_free(struct zs_pool *pool, struct size_class *class,
+		      unsigned long handle)
+{
+	struct zspage *zspage;
+	struct page *f_page;
+	unsigned long obj;
+	int fullness;
+
+	obj = handle_to_obj(handle);
+	obj_to_page(obj, &f_page);
+	zspage = get_zspage(f_page);
+
+	class_stat_sub(class, ZS_OBJS_INUSE, 1);
+	obj_free(class->size, obj);
+
+	fullness = fix_fullness_group(class, zspage);
+	if (fullness == ZS_INUSE_RATIO_0)
+		free_zspage(pool, class, zspage);
+}
+
+/*
+ * The handles are known to belong to @class, and class->lock keeps their
+ * objects from being migrated, so pool->migrate_lock isn't needed.
+ */
+static void zs_free_batch(struct zs_pool *pool, struct size_class *class,
+			  unsigned long *handles, unsigned int nr)
+{
+	unsigned int i;
+
+	spin_lock(&class->lock);
+	for (i = 0; i < nr; i++)
+		__zs_free(pool, class, handles[i]);
+	spin_unlock(&class->lock);
+
+	for (i = 0; i < nr; i++)
+		cache_free_handle(pool, handles[i]);
+}
+
+/*
+ * Returns false if the cache of this cpu is full, after taking half of it
+ * out into @handles.
+ */
+static bool zs_pcp_push(struct size_class *class, unsigned long handle,
+			unsigned long *handles, unsigned int *nr)
+{
+	struct zs_pcp *pcp;
+	bool ret = true;
+
+	pcp = raw_cpu_ptr(class->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->nr < class->pcp_max) {
+		pcp->handles[pcp->nr++] = handle;
+	} else {
+		*nr = class->pcp_max / 2;
+		pcp->nr -= *nr;
+		memcpy(handles, pcp->handles + pcp->nr, *nr * sizeof(*handles));
+		ret = false;
+	}
+	spin_unlock(&pcp->lock);
+
+	return ret;
+}
+
+/* Give back the objects held by the cache of @class on @cpu */
+static void zs_pcp_drain_cpu(struct zs_pool *pool, struct size_class *class,
+			     int cpu)
+{
+	unsigned long handles[ZS_PCP_MAX_OBJS];
+	struct zs_pcp *pcp;
+	unsigned int nr;
+
+	pcp = per_cpu_ptr(class->pcp, cpu);
+	spin_lock(&pcp->lock);
+	nr = pcp->nr;
+	memcpy(handles, pcp->handles, nr * sizeof(*handles));
+	pcp->nr = 0;
+	spin_unlock(&pcp->lock);
+
+	if (nr)
+		zs_free_batch(pool, class, handles, nr);
+}
+
+/* Give back the objects held by all caches of @pool */
+static void zs_pcp_drain(struct zs_pool *pool)
+{
+	struct size_class *class;
+	int i, cpu;
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		class = pool->size_class[i];
+		if (!class || class->index != i || !class->pcp)
+			continue;
+
+		for_each_possible_cpu(cpu)
+			zs_pcp_drain_cpu(pool, class, cpu);
+	}
+}
+
 void zs_free(struct zs_pool *pool, unsigned long handle)
 {
+	unsigned long handles[ZS_PCP_MAX_OBJS / 2 + 1];
 	struct zspage *zspage;
 	struct page *f_page;
 	unsigned long obj;
 	struct size_class *class;
-	int fullness;
+	unsigned int nr;
 
 	if (IS_ERR_OR_NULL((void *)handle))
 		return;
@@ -1453,15 +1698,22 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	obj_to_page(obj, &f_page);
 	zspage = get_zspage(f_page);
 	class = zspage_class(pool, zspage);
+
+	if (class->pcp) {
+		/* The class of an object doesn't change under migration */
+		read_unlock(&pool->migrate_lock);
+		if (zs_pcp_push(class, handle, handles, &nr))
+			return;
+
+		handles[nr++] = handle;
+		zs_free_batch(pool, class, handles, nr);
+		return;
+	}
+
 	spin_lock(&class->lock);
 	read_unlock(&pool->migrate_lock);
 
-	class_stat_sub(class, ZS_OBJS_INUSE, 1);
-	obj_free(class->size, obj);
-
-	fullness = fix_fullness_group(class, zspage);
-	if (fullness == ZS_INUSE_RATIO_0)
-		free_zspage(pool, class, zspage);
+	__zs_free(pool, class, handle);
 
 	spin_unlock(&class->lock);
 	cache_free_handle(pool, handle);
@@ -1922,11 +2174,11 @@ static inline void zs_flush_migration(struct zs_pool *pool) { }
  * Based on the number of unused allocated objects calculate
  * and return the number of pages that we can free.
  */
-static unsigned long zs_can_compact(struct size_class *class)
+static unsigned long zs_can_compact(struct size_class *class,
+				    unsigned long obj_used)
 {
 	unsigned long obj_wasted;
 	unsigned long obj_allocated = class_stat_read(class, ZS_OBJS_ALLOCATED);
-	unsigned long obj_used = class_stat_read(class, ZS_OBJS_INUSE);
 
 	if (obj_allocated <= obj_used)
 		return 0;
@@ -1950,7 +2202,7 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 	 */
 	write_lock(&pool->migrate_lock);
 	spin_lock(&class->lock);
-	while (zs_can_compact(class)) {
+	while (zs_can_compact(class, class_stat_read(class, ZS_OBJS_INUSE))) {
 		int fg;
 
 		if (!dst_zspage) {
@@ -2014,6 +2266,7 @@ unsigned long zs_compact(struct zs_pool *pool)
 	if (atomic_xchg(&pool->compaction_in_progress, 1))
 		return 0;
 
+	zs_pcp_drain(pool);
 	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--) {
 		class = pool->size_class[i];
 		if (class->index != i)
@@ -2036,15 +2289,25 @@ EXPORT_SYMBOL_GPL(zs_pool_stats);
 static unsigned long zs_shrinker_scan(struct shrinker *shrinker,
 		struct shrink_control *sc)
 {
-	unsigned long pages_freed;
+	unsigned long pages_freed, pages_before, pages_after;
 	struct zs_pool *pool = shrinker->private_data;
 
+	/*
+	 * Give back the objects parked in the per-cpu caches, even if a
+	 * compaction is already running and zs_compact() returns at once.
+	 * Freeing them can empty zspages.
+	 */
+	pages_before = zs_get_total_pages(pool);
+	zs_pcp_drain(pool);
+	pages_after = zs_get_total_pages(pool);
+	pages_freed = pages_before > pages_after ? pages_before - pages_after : 0;
+
 	/*
 	 * Compact classes and calculate compaction delta.
 	 * Can run concurrently with a manually triggered
 	 * (by user) compaction.
 	 */
-	pages_freed = zs_compact(pool);
+	pages_freed += zs_compact(pool);
 
 	return pages_freed ? pages_freed : SHRINK_STOP;
 }
@@ -2062,7 +2325,8 @@ static unsigned long zs_shrinker_count(struct shrinker *shrinker,
 		if (class->index != i)
 			continue;
 
-		pages_to_free += zs_can_compact(class);
+		/* zs_shrinker_scan() drains the caches first */
+		pages_to_free += zs_can_compact(class, class_objs_inuse(class));
 	}
 
 	return pages_to_free;
@@ -2133,6 +2397,7 @@ struct zs_pool *zs_create_pool(const char *name)
 	init_deferred_free(pool);
 	rwlock_init(&pool->migrate_lock);
 	atomic_set(&pool->compaction_in_progress, 0);
+	INIT_LIST_HEAD(&pool->list);
 
 	pool->name = kstrdup(name, GFP_KERNEL);
 	if (!pool->name)
@@ -2206,6 +2471,19 @@ struct zs_pool *zs_create_pool(const char *name)
 		spin_lock_init(&class->lock);
 		pool->size_class[i] = class;
 
+		if (objs_per_zspage > 1)
+			class->pcp_max = min_t(unsigned int, ZS_PCP_MAX_OBJS,
+					       ZS_PCP_MAX_BYTES / size);
+		if (class->pcp_max >= 2) {
+			int cpu;
+
+			class->pcp = alloc_percpu(struct zs_pcp);
+			if (!class->pcp)
+				goto err;
+			for_each_possible_cpu(cpu)
+				spin_lock_init(&per_cpu_ptr(class->pcp, cpu)->lock);
+		}
+
 		fullness = ZS_INUSE_RATIO_0;
 		while (fullness < NR_FULLNESS_GROUPS) {
 			INIT_LIST_HEAD(&class->fullness_list[fullness]);
@@ -2215,6 +2493,10 @@ struct zs_pool *zs_create_pool(const char *name)
 		prev_class = class;
 	}
 
+	mutex_lock(&zs_pools_lock);
+	list_add(&pool->list, &zs_pools);
+	mutex_unlock(&zs_pools_lock);
+
 	/* debug only, don't abort if it fails */
 	zs_pool_stat_create(pool, name);
 
@@ -2239,6 +2521,14 @@ void zs_destroy_pool(struct zs_pool *pool)
 	int i;
 
 	zs_unregister_shrinker(pool);
+
+	mutex_lock(&zs_pools_lock);
+	list_del(&pool->list);
+	mutex_unlock(&zs_pools_lock);
+
+	/* Draining may kick the deferred free of zspages */
+	zs_pcp_drain(pool);
+
 	zs_flush_migration(pool);
 	zs_pool_stat_destroy(pool);
 
@@ -2252,6 +2542,8 @@ void zs_destroy_pool(struct zs_pool *pool)
 		if (class->index != i)
 			continue;
 
+		free_percpu(class->pcp);
+
 		for (fg = ZS_INUSE_RATIO_0; fg < NR_FULLNESS_GROUPS; fg++) {
 			if (list_empty(&class->fullness_list[fg]))
 				continue;
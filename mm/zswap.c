@@ -35,6 +35,7 @@
 #include <linux/pagemap.h>
 #include <linux/workqueue.h>
 #include <linux/list_lru.h>
+#include <linux/seq_file.h>
 
 #include "swap.h"
 #include "internal.h"
@@ -141,11 +142,26 @@ bool zswap_never_enabled(void)
 * data structures
 **********************************/
 
+/*
+ * Maximum number of subpages of a large folio that are handed to the
+ * compressor at once. Asynchronous (hardware) compressors get one request
+ * per subpage and can work on all of them in parallel.
+ */
+#define ZSWAP_MAX_BATCH_SIZE 8U
+
+/*
+ * reqs[0], waits[0] and buffers[0] are always available and used for
+ * single page (de)compression. The remaining slots are only allocated if
+ * the compressor is asynchronous, nr_reqs tells how many are usable.
+ */
 struct crypto_acomp_ctx {
 	struct crypto_acomp *acomp;
-	struct acomp_req *req;
-	struct crypto_wait wait;
-	u8 *buffer;
+	struct acomp_req *reqs[ZSWAP_MAX_BATCH_SIZE];
+	struct crypto_wait waits[ZSWAP_MAX_BATCH_SIZE];
+	u8 *buffers[ZSWAP_MAX_BATCH_SIZE];
+	struct scatterlist inputs[ZSWAP_MAX_BATCH_SIZE];
+	struct scatterlist outputs[ZSWAP_MAX_BATCH_SIZE];
+	unsigned int nr_reqs;
 	struct mutex mutex;
 	bool is_sleepable;
 };
@@ -469,6 +485,155 @@ static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 	return NULL;
 }
 
+#ifdef CONFIG_MEMCG
+/* serializes memory.zswap.compressor updates */
+static DEFINE_MUTEX(zswap_memcg_pool_lock);
+
+/*
+ * Returns the pool the compressed data of @objcg is stored in: the one
+ * configured closest to its memcg through memory.zswap.compressor, or the
+ * current global pool if none is.
+ */
+static struct zswap_pool *zswap_pool_current_get_objcg(struct obj_cgroup *objcg)
+{
+	struct zswap_pool *pool = NULL;
+	struct mem_cgroup *memcg;
+
+	if (!objcg)
+		return zswap_pool_current_get();
+
+	rcu_read_lock();
+	for (memcg = obj_cgroup_memcg(objcg); memcg;
+	     memcg = parent_mem_cgroup(memcg)) {
+		pool = rcu_dereference(memcg->zswap_pool);
+		if (pool)
+			break;
+	}
+	/* lost a race with a concurrent update, use the global pool */
+	if (pool && !zswap_pool_get(pool))
+		pool = NULL;
+	rcu_read_unlock();
+
+	return pool ?: zswap_pool_current_get();
+}
+
+static void zswap_memcg_replace_pool(struct mem_cgroup *memcg,
+				     struct zswap_pool *pool)
+{
+	struct zswap_pool *old;
+
+	old = rcu_replace_pointer(memcg->zswap_pool, pool,
+				  lockdep_is_held(&zswap_memcg_pool_lock));
+	if (old)
+		zswap_pool_put(old);
+}
+
+int zswap_memcg_compressor_show(struct seq_file *m, struct mem_cgroup *memcg)
+{
+	struct zswap_pool *pool;
+
+	rcu_read_lock();
+	pool = rcu_dereference(memcg->zswap_pool);
+	if (pool)
+		seq_printf(m, "%s %s\n", pool->tfm_name,
+			   zpool_get_type(pool->zpool));
+	else
+		seq_puts(m, "default\n");
+	rcu_read_unlock();
+
+	return 0;
+}
+
+/*
+ * @buf is either "default", to inherit the parent's setting, or a
+ * compressor name optionally followed by a zpool type. The zpool type
+ * defaults to the global one.
+ */
+int zswap_memcg_set_compressor(struct mem_cgroup *memcg, char *buf)
+{
+	char *compressor = strsep(&buf, " \t");
+	char *type = buf ? skip_spaces(buf) : NULL;
+	struct zswap_pool *pool = NULL;
+	bool new_pool = false;
+	int ret = 0;
+
+	if (!*compressor)
+		return -EINVAL;
+
+	mutex_lock(&zswap_init_lock);
+	if (zswap_init_state != ZSWAP_INIT_SUCCEED)
+		ret = -ENODEV;
+	mutex_unlock(&zswap_init_lock);
+	if (ret)
+		return ret;
+
+	mutex_lock(&zswap_memcg_pool_lock);
+
+	if (!strcmp(compressor, "default")) {
+		if (type && *type) {
+			ret = -EINVAL;
+			goto unlock;
+		}
+		goto replace;
+	}
+
+	if (!type || !*type)
+		type = zswap_zpool_type;
+
+	if (!crypto_has_acomp(compressor, 0, 0)) {
+		pr_err("compressor %s not available\n", compressor);
+		ret = -ENOENT;
+		goto unlock;
+	}
+	if (!zpool_has_pool(type)) {
+		pr_err("zpool %s not available\n", type);
+		ret = -ENOENT;
+		goto unlock;
+	}
+
+	spin_lock_bh(&zswap_pools_lock);
+	pool = zswap_pool_find_get(type, compressor);
+	spin_unlock_bh(&zswap_pools_lock);
+
+	if (!pool) {
+		pool = zswap_pool_create(type, compressor);
+		if (!pool) {
+			ret = -EINVAL;
+			goto unlock;
+		}
+		new_pool = true;
+
+		/* the memcg's reference, the initial one is dropped below */
+		WARN_ON(!zswap_pool_get(pool));
+
+		spin_lock_bh(&zswap_pools_lock);
+		list_add_tail_rcu(&pool->list, &zswap_pools);
+		spin_unlock_bh(&zswap_pools_lock);
+	}
+
+replace:
+	zswap_memcg_replace_pool(memcg, pool);
+
+	/*
+	 * Like any pool that is not the current one, a pool only used by
+	 * memcgs is decommissioned, and gets released when the last memcg
+	 * and entry referencing it are gone. The pool parameter callbacks
+	 * rely on this when they pick it up with zswap_pool_find_get().
+	 */
+	if (new_pool)
+		percpu_ref_kill(&pool->ref);
+unlock:
+	mutex_unlock(&zswap_memcg_pool_lock);
+
+	return ret;
+}
+#else
+static struct zswap_pool *zswap_pool_current_get_objcg(struct obj_cgroup *objcg)
+{
+	return zswap_pool_current_get();
+}
+#endif /* CONFIG_MEMCG */
+
 static unsigned long zswap_max_pages(void)
 {
 	return totalram_pages() * zswap_max_pool_percent / 100;
@@ -756,6 +921,9 @@ void zswap_folio_swapin(struct folio *folio)
  *
  * shrink_worker() must handle the case where this function releases
  * the reference of memcg being shrunk.
+ *
+ * The memcg also drops its reference on the pool selected through
+ * memory.zswap.compressor, if any.
  */
 void zswap_memcg_offline_cleanup(struct mem_cgroup *memcg)
 {
@@ -767,6 +935,13 @@ void zswap_memcg_offline_cleanup(struct mem_cgroup *memcg)
 		} while (zswap_next_shrink && !mem_cgroup_online(zswap_next_shrink));
 	}
 	spin_unlock(&zswap_shrink_lock);
+
+#ifdef CONFIG_MEMCG
+	/* new stores of this memcg's objcg go to the parent's pool now */
+	mutex_lock(&zswap_memcg_pool_lock);
+	zswap_memcg_replace_pool(memcg, NULL);
+	mutex_unlock(&zswap_memcg_pool_lock);
+#endif
 }
 
 /*********************************
@@ -813,49 +988,67 @@ static int zswap_cpu_comp_prepare(unsigned int cpu, struct hlist_node *node)
 	struct zswap_pool *pool = hlist_entry(node, struct zswap_pool, node);
 	struct crypto_acomp_ctx *acomp_ctx = per_cpu_ptr(pool->acomp_ctx, cpu);
 	struct crypto_acomp *acomp;
+	unsigned int i, nr_reqs;
 	struct acomp_req *req;
 	int ret;
 
 	mutex_init(&acomp_ctx->mutex);
 
-	acomp_ctx->buffer = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL, cpu_to_node(cpu));
-	if (!acomp_ctx->buffer)
-		return -ENOMEM;
-
 	acomp = crypto_alloc_acomp_node(pool->tfm_name, 0, 0, cpu_to_node(cpu));
 	if (IS_ERR(acomp)) {
 		pr_err("could not alloc crypto acomp %s : %ld\n",
 				pool->tfm_name, PTR_ERR(acomp));
-		ret = PTR_ERR(acomp);
-		goto acomp_fail;
+		return PTR_ERR(acomp);
 	}
 	acomp_ctx->acomp = acomp;
 	acomp_ctx->is_sleepable = acomp_is_async(acomp);
 
-	req = acomp_request_alloc(acomp_ctx->acomp);
-	if (!req) {
-		pr_err("could not alloc crypto acomp_request %s\n",
-		       pool->tfm_name);
-		ret = -ENOMEM;
-		goto req_fail;
-	}
-	acomp_ctx->req = req;
-
-	crypto_init_wait(&acomp_ctx->wait);
 	/*
-	 * if the backend of acomp is async zip, crypto_req_done() will wakeup
-	 * crypto_wait_req(); if the backend of acomp is scomp, the callback
-	 * won't be called, crypto_wait_req() will return without blocking.
+	 * A synchronous compressor completes each request before returning,
+	 * so there is nothing to gain from more than one request per CPU.
 	 */
-	acomp_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-				   crypto_req_done, &acomp_ctx->wait);
+	nr_reqs = acomp_ctx->is_sleepable ? ZSWAP_MAX_BATCH_SIZE : 1;
+
+	for (i = 0; i < nr_reqs; i++) {
+		acomp_ctx->buffers[i] = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL,
+						     cpu_to_node(cpu));
+		if (!acomp_ctx->buffers[i]) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+
+		req = acomp_request_alloc(acomp_ctx->acomp);
+		if (!req) {
+			pr_err("could not alloc crypto acomp_request %s\n",
+			       pool->tfm_name);
+			kfree(acomp_ctx->buffers[i]);
+			ret = -ENOMEM;
+			goto fail;
+		}
+		acomp_ctx->reqs[i] = req;
+
+		crypto_init_wait(&acomp_ctx->waits[i]);
+		/*
+		 * if the backend of acomp is async zip, crypto_req_done() will wakeup
+		 * crypto_wait_req(); if the backend of acomp is scomp, the callback
+		 * won't be called, crypto_wait_req() will return without blocking.
+		 */
+		acomp_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   crypto_req_done, &acomp_ctx->waits[i]);
+	}
+	acomp_ctx->nr_reqs = nr_reqs;
 
 	return 0;
 
-req_fail:
+fail:
+	while (i--) {
+		acomp_request_free(acomp_ctx->reqs[i]);
+		acomp_ctx->reqs[i] = NULL;
+		kfree(acomp_ctx->buffers[i]);
+		acomp_ctx->buffers[i] = NULL;
+	}
 	crypto_free_acomp(acomp_ctx->acomp);
-acomp_fail:
-	kfree(acomp_ctx->buffer);
+	acomp_ctx->acomp = NULL;
 	return ret;
 }
 
@@ -863,79 +1056,105 @@ static int zswap_cpu_comp_dead(unsigned int cpu, struct hlist_node *node)
 {
 	struct zswap_pool *pool = hlist_entry(node, struct zswap_pool, node);
 	struct crypto_acomp_ctx *acomp_ctx = per_cpu_ptr(pool->acomp_ctx, cpu);
+	unsigned int i;
 
 	if (!IS_ERR_OR_NULL(acomp_ctx)) {
-		if (!IS_ERR_OR_NULL(acomp_ctx->req))
-			acomp_request_free(acomp_ctx->req);
+		for (i = 0; i < acomp_ctx->nr_reqs; i++) {
+			if (!IS_ERR_OR_NULL(acomp_ctx->reqs[i]))
+				acomp_request_free(acomp_ctx->reqs[i]);
+			kfree(acomp_ctx->buffers[i]);
+		}
 		if (!IS_ERR_OR_NULL(acomp_ctx->acomp))
 			crypto_free_acomp(acomp_ctx->acomp);
-		kfree(acomp_ctx->buffer);
 	}
 
 	return 0;
 }
 
-static bool zswap_compress(struct folio *folio, struct zswap_entry *entry)
+/*
+ * Compress @nr consecutive subpages of @folio, starting at @index, into
+ * the zpool of @entries[0]->pool. @nr must not exceed the number of
+ * requests of the current CPU's acomp context.
+ *
+ * All requests are submitted before waiting for any of them, so an
+ * asynchronous compressor works on the whole batch in parallel. The
+ * zpool allocations then happen back to back once the batch is done.
+ *
+ * On failure, no zpool memory is left allocated for any of @entries.
+ */
+static bool zswap_compress(struct folio *folio, long index, unsigned int nr,
+			   struct zswap_entry **entries)
 {
+	struct zswap_pool *pool = entries[0]->pool;
+	struct zpool *zpool = pool->zpool;
 	struct crypto_acomp_ctx *acomp_ctx;
-	struct scatterlist input, output;
+	int errors[ZSWAP_MAX_BATCH_SIZE];
 	int comp_ret = 0, alloc_ret = 0;
-	unsigned int dlen = PAGE_SIZE;
 	unsigned long handle;
-	struct zpool *zpool;
+	unsigned int i, dlen;
 	char *buf;
 	gfp_t gfp;
-	u8 *dst;
 
-	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
+	acomp_ctx = raw_cpu_ptr(pool->acomp_ctx);
 
 	mutex_lock(&acomp_ctx->mutex);
 
-	dst = acomp_ctx->buffer;
-	sg_init_table(&input, 1);
-	sg_set_folio(&input, folio, PAGE_SIZE, 0);
+	if (WARN_ON_ONCE(nr > acomp_ctx->nr_reqs)) {
+		mutex_unlock(&acomp_ctx->mutex);
+		return false;
+	}
 
-	/*
-	 * We need PAGE_SIZE * 2 here since there maybe over-compression case,
-	 * and hardware-accelerators may won't check the dst buffer size, so
-	 * giving the dst buffer with enough length to avoid buffer overflow.
-	 */
-	sg_init_one(&output, dst, PAGE_SIZE * 2);
-	acomp_request_set_params(acomp_ctx->req, &input, &output, PAGE_SIZE, dlen);
+	for (i = 0; i < nr; i++) {
+		sg_init_table(&acomp_ctx->inputs[i], 1);
+		sg_set_page(&acomp_ctx->inputs[i], folio_page(folio, index + i),
+			    PAGE_SIZE, 0);
 
-	/*
-	 * it maybe looks a little bit silly that we send an asynchronous request,
-	 * then wait for its completion synchronously. This makes the process look
-	 * synchronous in fact.
-	 * Theoretically, acomp supports users send multiple acomp requests in one
-	 * acomp instance, then get those requests done simultaneously. but in this
-	 * case, zswap actually does store and load page by page, there is no
-	 * existing method to send the second page before the first page is done
-	 * in one thread doing zwap.
-	 * but in different threads running on different cpu, we have different
-	 * acomp instance, so multiple threads can do (de)compression in parallel.
-	 */
-	comp_ret = crypto_wait_req(crypto_acomp_compress(acomp_ctx->req), &acomp_ctx->wait);
-	dlen = acomp_ctx->req->dlen;
-	if (comp_ret)
-		goto unlock;
+		/*
+		 * We need PAGE_SIZE * 2 here since there maybe over-compression
+		 * case, and hardware-accelerators may won't check the dst buffer
+		 * size, so giving the dst buffer with enough length to avoid
+		 * buffer overflow.
+		 */
+		sg_init_one(&acomp_ctx->outputs[i], acomp_ctx->buffers[i],
+			    PAGE_SIZE * 2);
+		acomp_request_set_params(acomp_ctx->reqs[i], &acomp_ctx->inputs[i],
+					 &acomp_ctx->outputs[i], PAGE_SIZE,
+					 PAGE_SIZE);
+
+		/*
+		 * For an asynchronous compressor this only queues the request,
+		 * which lets the hardware work on all subpages of the batch at
+		 * the same time. A synchronous one (scomp) has already finished
+		 * when this returns.
+		 */
+		errors[i] = crypto_acomp_compress(acomp_ctx->reqs[i]);
+	}
+
+	for (i = 0; i < nr; i++)
+		errors[i] = crypto_wait_req(errors[i], &acomp_ctx->waits[i]);
 
-	zpool = entry->pool->zpool;
 	gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
 	if (zpool_malloc_support_movable(zpool))
 		gfp |= __GFP_HIGHMEM | __GFP_MOVABLE;
-	alloc_ret = zpool_malloc(zpool, dlen, gfp, &handle);
-	if (alloc_ret)
-		goto unlock;
 
-	buf = zpool_map_handle(zpool, handle, ZPOOL_MM_WO);
-	memcpy(buf, dst, dlen);
-	zpool_unmap_handle(zpool, handle);
+	for (i = 0; i < nr; i++) {
+		comp_ret = errors[i];
+		if (comp_ret)
+			break;
 
-	entry->handle = handle;
-	entry->length = dlen;
+		dlen = acomp_ctx->reqs[i]->dlen;
+		alloc_ret = zpool_malloc(zpool, dlen, gfp, &handle);
+		if (alloc_ret)
+			break;
+
+		buf = zpool_map_handle(zpool, handle, ZPOOL_MM_WO);
+		memcpy(buf, acomp_ctx->buffers[i], dlen);
+		zpool_unmap_handle(zpool, handle);
+
+		entries[i]->handle = handle;
+		entries[i]->length = dlen;
+	}
 
-unlock:
 	if (comp_ret == -ENOSPC || alloc_ret == -ENOSPC)
 		zswap_reject_compress_poor++;
 	else if (comp_ret)
@@ -943,6 +1162,12 @@ static bool zswap_compress(struct folio *folio, struct zswap_entry *entry)
 	else if (alloc_ret)
 		zswap_reject_alloc_fail++;
 
+	/* A partially stored batch is useless, release what we've got. */
+	if (i < nr) {
+		while (i--)
+			zpool_free(zpool, entries[i]->handle);
+	}
+
 	mutex_unlock(&acomp_ctx->mutex);
 	return comp_ret == 0 && alloc_ret == 0;
 }
@@ -969,20 +1194,21 @@ static void zswap_decompress(struct zswap_entry *entry, struct folio *folio)
 	 */
 	if ((acomp_ctx->is_sleepable && !zpool_can_sleep_mapped(zpool)) ||
 	    !virt_addr_valid(src)) {
-		memcpy(acomp_ctx->buffer, src, entry->length);
-		src = acomp_ctx->buffer;
+		memcpy(acomp_ctx->buffers[0], src, entry->length);
+		src = acomp_ctx->buffers[0];
 		zpool_unmap_handle(zpool, entry->handle);
 	}
 
 	sg_init_one(&input, src, entry->length);
 	sg_init_table(&output, 1);
 	sg_set_folio(&output, folio, PAGE_SIZE, 0);
-	acomp_request_set_params(acomp_ctx->req, &input, &output, entry->length, PAGE_SIZE);
-	BUG_ON(crypto_wait_req(crypto_acomp_decompress(acomp_ctx->req), &acomp_ctx->wait));
-	BUG_ON(acomp_ctx->req->dlen != PAGE_SIZE);
+	acomp_request_set_params(acomp_ctx->reqs[0], &input, &output, entry->length, PAGE_SIZE);
+	BUG_ON(crypto_wait_req(crypto_acomp_decompress(acomp_ctx->reqs[0]),
+			       &acomp_ctx->waits[0]));
+	BUG_ON(acomp_ctx->reqs[0]->dlen != PAGE_SIZE);
 	mutex_unlock(&acomp_ctx->mutex);
 
-	if (src != acomp_ctx->buffer)
+	if (src != acomp_ctx->buffers[0])
 		zpool_unmap_handle(zpool, entry->handle);
 }
 
@@ -1403,22 +1629,122 @@ static void shrink_worker(struct work_struct *w)
 /*********************************
 * main API
 **********************************/
+/*
+ * Store @nr subpages of @folio, starting at @index, as one batch: the
+ * entries are compressed together, inserted into the trees and only then
+ * published on the LRU. The caller holds a reference on @pool, each stored
+ * entry takes its own.
+ *
+ * On failure, entries of this batch that already made it into the tree
+ * are left for the caller to invalidate.
+ */
+static bool zswap_store_batch(struct folio *folio, long index, unsigned int nr,
+			      struct obj_cgroup *objcg, struct zswap_pool *pool)
+{
+	struct zswap_entry *entries[ZSWAP_MAX_BATCH_SIZE];
+	swp_entry_t swp = folio->swap;
+	unsigned int i, nr_alloced, stored;
+	struct zswap_entry *old;
+
+	for (nr_alloced = 0; nr_alloced < nr; nr_alloced++) {
+		entries[nr_alloced] = zswap_entry_cache_alloc(GFP_KERNEL,
+							      folio_nid(folio));
+		if (!entries[nr_alloced]) {
+			zswap_reject_kmemcache_fail++;
+			goto free_entries;
+		}
+		entries[nr_alloced]->pool = pool;
+		/*
+		 * Entries of a failed batch which are already in the tree are
+		 * freed before they are on the LRU, list_lru_del() must see
+		 * an empty list for them.
+		 */
+		INIT_LIST_HEAD(&entries[nr_alloced]->lru);
+	}
+
+	if (!zswap_compress(folio, index, nr, entries))
+		goto free_entries;
+
+	for (stored = 0; stored < nr; stored++) {
+		struct zswap_entry *entry = entries[stored];
+		swp_entry_t page_swp = swp_entry(swp_type(swp),
+						 swp_offset(swp) + index + stored);
+
+		old = xa_store(swap_zswap_tree(page_swp), swp_offset(page_swp),
+			       entry, GFP_KERNEL);
+		if (xa_is_err(old)) {
+			int err = xa_err(old);
+
+			WARN_ONCE(err != -ENOMEM, "unexpected xarray error: %d\n", err);
+			zswap_reject_alloc_fail++;
+			goto free_handles;
+		}
+
+		/*
+		 * We may have had an existing entry that became stale when
+		 * the folio was redirtied and now the new version is being
+		 * swapped out. Get rid of the old.
+		 */
+		if (old)
+			zswap_entry_free(old);
+
+		/*
+		 * We finish initializing the entry while it's already in xarray.
+		 * This is safe because:
+		 *
+		 * 1. Concurrent stores and invalidations are excluded by folio lock.
+		 *
+		 * 2. Writeback is excluded by the entry not being on the LRU yet.
+		 *    The publishing order matters to prevent writeback from seeing
+		 *    an incoherent entry.
+		 */
+		percpu_ref_get(&pool->ref);
+		entry->swpentry = page_swp;
+		entry->objcg = objcg;
+		entry->referenced = true;
+		if (objcg) {
+			obj_cgroup_get(objcg);
+			obj_cgroup_charge_zswap(objcg, entry->length);
+		}
+		atomic_inc(&zswap_stored_pages);
+	}
+
+	/* The whole batch is coherent now, publish it to writeback. */
+	for (i = 0; i < nr; i++) {
+		if (entries[i]->length)
+			zswap_lru_add(&zswap_list_lru, entries[i]);
+	}
+
+	return true;
+
+free_handles:
+	for (i = stored; i < nr; i++) {
+		zpool_free(pool->zpool, entries[i]->handle);
+		zswap_entry_cache_free(entries[i]);
+	}
+	return false;
+
+free_entries:
+	for (i = 0; i < nr_alloced; i++)
+		zswap_entry_cache_free(entries[i]);
+	return false;
+}
+
 bool zswap_store(struct folio *folio)
 {
+	long nr_pages = folio_nr_pages(folio);
 	swp_entry_t swp = folio->swap;
-	pgoff_t offset = swp_offset(swp);
-	struct xarray *tree = swap_zswap_tree(swp);
-	struct zswap_entry *entry, *old;
+	struct crypto_acomp_ctx *acomp_ctx;
 	struct obj_cgroup *objcg = NULL;
 	struct mem_cgroup *memcg = NULL;
+	struct zswap_pool *pool;
+	unsigned int batch;
+	bool ret = false;
+	long index;
 
 	VM_WARN_ON_ONCE(!folio_test_locked(folio));
 	VM_WARN_ON_ONCE(!folio_test_swapcache(folio));
 
-	/* Large folios aren't supported */
-	if (folio_test_large(folio))
-		return false;
-
 	if (!zswap_enabled)
 		goto check_old;
 
@@ -1428,25 +1754,17 @@ bool zswap_store(struct folio *folio)
 		memcg = get_mem_cgroup_from_objcg(objcg);
 		if (shrink_memcg(memcg)) {
 			mem_cgroup_put(memcg);
-			goto reject;
+			goto put_objcg;
 		}
 		mem_cgroup_put(memcg);
 	}
 
 	if (zswap_check_limits())
-		goto reject;
-
-	/* allocate entry */
-	entry = zswap_entry_cache_alloc(GFP_KERNEL, folio_nid(folio));
-	if (!entry) {
-		zswap_reject_kmemcache_fail++;
-		goto reject;
-	}
+		goto put_objcg;
 
-	/* if entry is successfully added, it keeps the reference */
-	entry->pool = zswap_pool_current_get();
-	if (!entry->pool)
-		goto freepage;
+	pool = zswap_pool_current_get_objcg(objcg);
+	if (!pool)
+		goto put_objcg;
 
 	if (objcg) {
 		memcg = get_mem_cgroup_from_objcg(objcg);
@@ -1457,76 +1775,48 @@ bool zswap_store(struct folio *folio)
 		mem_cgroup_put(memcg);
 	}
 
-	if (!zswap_compress(folio, entry))
-		goto put_pool;
-
-	entry->swpentry = swp;
-	entry->objcg = objcg;
-	entry->referenced = true;
-
-	old = xa_store(tree, offset, entry, GFP_KERNEL);
-	if (xa_is_err(old)) {
-		int err = xa_err(old);
-
-		WARN_ONCE(err != -ENOMEM, "unexpected xarray error: %d\n", err);
-		zswap_reject_alloc_fail++;
-		goto store_failed;
-	}
-
 	/*
-	 * We may have had an existing entry that became stale when
-	 * the folio was redirtied and now the new version is being
-	 * swapped out. Get rid of the old.
+	 * The batch size is a property of the compressor, which is the same
+	 * on all CPUs, so it does not matter if we migrate after reading it.
 	 */
-	if (old)
-		zswap_entry_free(old);
+	acomp_ctx = raw_cpu_ptr(pool->acomp_ctx);
+	batch = READ_ONCE(acomp_ctx->nr_reqs);
 
-	if (objcg) {
-		obj_cgroup_charge_zswap(objcg, entry->length);
-		count_objcg_events(objcg, ZSWPOUT, 1);
-	}
+	for (index = 0; index < nr_pages; index += batch) {
+		unsigned int nr = min_t(long, nr_pages - index, batch);
 
-	/*
-	 * We finish initializing the entry while it's already in xarray.
-	 * This is safe because:
-	 *
-	 * 1. Concurrent stores and invalidations are excluded by folio lock.
-	 *
-	 * 2. Writeback is excluded by the entry not being on the LRU yet.
-	 *    The publishing order matters to prevent writeback from seeing
-	 *    an incoherent entry.
-	 */
-	if (entry->length) {
-		INIT_LIST_HEAD(&entry->lru);
-		zswap_lru_add(&zswap_list_lru, entry);
+		if (!zswap_store_batch(folio, index, nr, objcg, pool))
+			goto put_pool;
 	}
 
-	/* update stats */
-	atomic_inc(&zswap_stored_pages);
-	count_vm_event(ZSWPOUT);
+	if (objcg)
+		count_objcg_events(objcg, ZSWPOUT, nr_pages);
 
-	return true;
+	count_vm_events(ZSWPOUT, nr_pages);
+
+	ret = true;
 
-store_failed:
-	zpool_free(entry->pool->zpool, entry->handle);
 put_pool:
-	zswap_pool_put(entry->pool);
-freepage:
-	zswap_entry_cache_free(entry);
-reject:
+	zswap_pool_put(pool);
+put_objcg:
 	obj_cgroup_put(objcg);
-	if (zswap_pool_reached_full)
+	if (!ret && zswap_pool_reached_full)
 		queue_work(shrink_wq, &zswap_shrink_work);
 check_old:
 	/*
 	 * If the zswap store fails or zswap is disabled, we must invalidate the
-	 * possibly stale entry which was previously stored at this offset.
-	 * Otherwise, writeback could overwrite the new data in the swapfile.
+	 * possibly stale entries which were previously stored at the offsets
+	 * of the folio, as well as the ones of this folio that were stored
+	 * before the failure. Otherwise, writeback could overwrite the new
+	 * data in the swapfile.
 	 */
-	entry = xa_erase(tree, offset);
-	if (entry)
-		zswap_entry_free(entry);
-	return false;
+	if (!ret) {
+		for (index = 0; index < nr_pages; index++)
+			zswap_invalidate(swp_entry(swp_type(swp),
+						   swp_offset(swp) + index));
+	}
+
+	return ret;
 }
 
 bool zswap_load(struct folio *folio)
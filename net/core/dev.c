@@ -78,6 +78,7 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/sched/isolation.h>
+#include <linux/sched/clock.h>
 #include <linux/sched/mm.h>
 #include <linux/smpboot.h>
 #include <linux/mutex.h>
@@ -161,6 +162,7 @@
 #include <linux/phy_link_topology.h>
 
 #include "dev.h"
+#include "page_pool_priv.h"
 #include "devmem.h"
 #include "net-sysfs.h"
 
@@ -3686,10 +3688,42 @@ int skb_csum_hwoffload_help(struct sk_buff *skb,
 }
 EXPORT_SYMBOL(skb_csum_hwoffload_help);
 
+/* Device memory frags can only go out of a device that handles net_iovs,
+ * and only of the device their dma-buf is mapped for.
+ */
+static struct sk_buff *validate_xmit_unreadable_skb(struct sk_buff *skb,
+						    struct net_device *dev)
+{
+	struct skb_shared_info *shinfo = skb_shinfo(skb);
+	struct net_iov *niov;
+
+	if (likely(skb_frags_readable(skb)))
+		return skb;
+
+	if (!dev->netmem_tx)
+		goto out_free;
+
+	if (shinfo->nr_frags) {
+		niov = skb_frag_net_iov(&shinfo->frags[0]);
+		if (niov && !net_devmem_iov_bound_to(niov, dev))
+			goto out_free;
+	}
+
+	return skb;
+
+out_free:
+	kfree_skb(skb);
+	return NULL;
+}
+
 static struct sk_buff *validate_xmit_skb(struct sk_buff *skb, struct net_device *dev, bool *again)
 {
 	netdev_features_t features;
 
+	skb = validate_xmit_unreadable_skb(skb, dev);
+	if (unlikely(!skb))
+		goto out_null;
+
 	features = netif_skb_features(skb);
 	skb = validate_xmit_vlan(skb, features);
 	if (unlikely(!skb))
@@ -4530,6 +4564,98 @@ int __dev_direct_xmit(struct sk_buff *skb, u16 queue_id)
 }
 EXPORT_SYMBOL(__dev_direct_xmit);
 
+/**
+ * __dev_direct_xmit_list - transmit a list of skbs on one tx queue
+ * @skb: the skbs, linked through ->next, all for the same device
+ * @queue_id: the tx queue
+ * @ret: status of the last transmit, NET_XMIT_DROP if any skb was dropped
+ *
+ * Like __dev_direct_xmit(), but takes the tx lock once for the whole list
+ * and lets the driver defer the doorbell with xmit_more. Skbs that don't
+ * pass validation are dropped.
+ *
+ * Return: the skbs the driver didn't take, or NULL.
+ */
+struct sk_buff *__dev_direct_xmit_list(struct sk_buff *skb, u16 queue_id,
+				       int *ret)
+{
+	struct net_device *dev = skb->dev;
+	struct sk_buff *head = NULL, **tail = &head;
+	struct sk_buff *next, *nskb;
+	struct netdev_queue *txq;
+	bool dropped = false;
+	bool again = false;
+	int rc;
+
+	if (unlikely(!netif_running(dev) ||
+		     !netif_carrier_ok(dev))) {
+		for (nskb = skb; nskb; nskb = nskb->next)
+			dev_core_stats_tx_dropped_inc(dev);
+		kfree_skb_list(skb);
+		*ret = NET_XMIT_DROP;
+		return NULL;
+	}
+
+	for (; skb; skb = next) {
+		next = skb->next;
+		skb_mark_not_on_list(skb);
+
+		nskb = validate_xmit_skb(skb, dev, &again);
+		if (nskb != skb) {
+			dev_core_stats_tx_dropped_inc(dev);
+			kfree_skb_list(nskb);
+			dropped = true;
+			continue;
+		}
+		*tail = skb;
+		tail = &skb->next;
+	}
+
+	rc = dropped ? NET_XMIT_DROP : NETDEV_TX_OK;
+	if (!head)
+		goto out;
+
+	skb_set_queue_mapping(head, queue_id);
+	txq = skb_get_tx_queue(dev, head);
+
+	local_bh_disable();
+
+	dev_xmit_recursion_inc();
+	HARD_TX_LOCK(dev, txq, smp_processor_id());
+	rc = NETDEV_TX_BUSY;
+	if (!netif_xmit_frozen_or_drv_stopped(txq)) {
+		for (skb = head; skb; skb = next) {
+			next = skb->next;
+			skb_mark_not_on_list(skb);
+			skb_set_queue_mapping(skb, queue_id);
+
+			rc = netdev_start_xmit(skb, dev, txq, !!next);
+			if (unlikely(!dev_xmit_complete(rc))) {
+				skb->next = next;
+				break;
+			}
+
+			if (next && netif_xmit_stopped(txq)) {
+				rc = NETDEV_TX_BUSY;
+				skb = next;
+				break;
+			}
+		}
+		head = skb;
+	}
+	HARD_TX_UNLOCK(dev, txq);
+	dev_xmit_recursion_dec();
+
+	local_bh_enable();
+
+	if (!head && dropped)
+		rc = NET_XMIT_DROP;
+out:
+	*ret = rc;
+	return head;
+}
+EXPORT_SYMBOL(__dev_direct_xmit_list);
+
 /*************************************************************************
  *			Receiver routines
  *************************************************************************/
@@ -4937,6 +5063,109 @@ static int enqueue_to_backlog(struct sk_buff *skb, int cpu,
 	return NET_RX_DROP;
 }
 
+#ifdef CONFIG_RPS
+/*
+ * Queue a list of skbs to the backlog of one CPU under a single lock hold,
+ * as enqueue_to_backlog() would queue each of them.  None of them belongs
+ * to an RFS flow, so there is no tail to save.
+ */
+static void enqueue_list_to_backlog(struct list_head *head, int cpu)
+{
+	struct softnet_data *sd = &per_cpu(softnet_data, cpu);
+	unsigned int queued = 0, qlen;
+	struct sk_buff *skb, *next;
+	unsigned long flags;
+	int max_backlog;
+	LIST_HEAD(drop);
+
+	max_backlog = READ_ONCE(net_hotdata.max_backlog);
+	backlog_lock_irq_save(sd, &flags);
+	list_for_each_entry_safe(skb, next, head, list) {
+		skb_list_del_init(skb);
+
+		qlen = skb_queue_len(&sd->input_pkt_queue);
+		if (qlen > max_backlog || skb_flow_limit(skb, qlen)) {
+			list_add_tail(&skb->list, &drop);
+			continue;
+		}
+
+		if (!qlen && !__test_and_set_bit(NAPI_STATE_SCHED,
+						 &sd->backlog.state))
+			napi_schedule_rps(sd);
+		__skb_queue_tail(&sd->input_pkt_queue, skb);
+		rps_input_queue_tail_incr(sd);
+		queued++;
+	}
+	backlog_unlock_irq_restore(sd, &flags);
+
+	this_cpu_inc(softnet_data.rps_batches);
+	this_cpu_add(softnet_data.rps_batched, queued);
+
+	list_for_each_entry_safe(skb, next, &drop, list) {
+		skb_list_del_init(skb);
+		atomic_inc(&sd->dropped);
+		dev_core_stats_rx_dropped_inc(skb->dev);
+		kfree_skb_reason(skb, SKB_DROP_REASON_CPU_BACKLOG);
+	}
+}
+
+/* Target CPUs netif_receive_skb_list_internal() batches skbs for at once */
+#define RPS_LIST_GROUPS		8
+
+struct rps_list_group {
+	int			cpu;
+	struct list_head	list;
+};
+
+/*
+ * Steer the skbs of @head with RPS, the ones that go to the same CPU are
+ * queued together.  An skb for which there is no group left is queued on
+ * its own, and so is an skb of an RFS flow: get_rps_cpu() decides whether
+ * the flow may move to another CPU from the tail its last skb was queued
+ * at, which has to be up to date for the next skb of the flow.
+ */
+static void netif_receive_skb_list_rps(struct list_head *head)
+{
+	struct rps_list_group groups[RPS_LIST_GROUPS];
+	struct sk_buff *skb, *next;
+	int i, nr_groups = 0;
+
+	list_for_each_entry_safe(skb, next, head, list) {
+		struct rps_dev_flow voidflow, *rflow = &voidflow;
+		int cpu = get_rps_cpu(skb->dev, skb, &rflow);
+
+		if (cpu < 0)
+			continue;
+
+		/* Will be handled, remove from list */
+		skb_list_del_init(skb);
+
+		if (rflow != &voidflow || !netif_running(skb->dev)) {
+			enqueue_to_backlog(skb, cpu, &rflow->last_qtail);
+			continue;
+		}
+
+		for (i = 0; i < nr_groups; i++)
+			if (groups[i].cpu == cpu)
+				break;
+		if (i == nr_groups) {
+			if (nr_groups == RPS_LIST_GROUPS) {
+				enqueue_to_backlog(skb, cpu, &rflow->last_qtail);
+				continue;
+			}
+			groups[i].cpu = cpu;
+			INIT_LIST_HEAD(&groups[i].list);
+			nr_groups++;
+		}
+
+		list_add_tail(&skb->list, &groups[i].list);
+	}
+
+	for (i = 0; i < nr_groups; i++)
+		enqueue_list_to_backlog(&groups[i].list, groups[i].cpu);
+}
+#endif /* CONFIG_RPS */
+
 static struct netdev_rx_queue *netif_get_rxqueue(struct sk_buff *skb)
 {
 	struct net_device *dev = skb->dev;
@@ -5919,18 +6148,8 @@ void netif_receive_skb_list_internal(struct list_head *head)
 
 	rcu_read_lock();
 #ifdef CONFIG_RPS
-	if (static_branch_unlikely(&rps_needed)) {
-		list_for_each_entry_safe(skb, next, head, list) {
-			struct rps_dev_flow voidflow, *rflow = &voidflow;
-			int cpu = get_rps_cpu(skb->dev, skb, &rflow);
-
-			if (cpu >= 0) {
-				/* Will be handled, remove from list */
-				skb_list_del_init(skb);
-				enqueue_to_backlog(skb, cpu, &rflow->last_qtail);
-			}
-		}
-	}
+	if (static_branch_unlikely(&rps_needed))
+		netif_receive_skb_list_rps(head);
 #endif
 	__netif_receive_skb_list(head);
 	rcu_read_unlock();
@@ -6620,13 +6839,53 @@ int dev_set_threaded(struct net_device *dev, bool threaded)
 	 * softirq mode will happen in the next round of napi_schedule().
 	 * This should not cause hiccups/stalls to the live traffic.
 	 */
-	list_for_each_entry(napi, &dev->napi_list, dev_list)
+	list_for_each_entry(napi, &dev->napi_list, dev_list) {
+		if (!threaded)
+			clear_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state);
 		assign_bit(NAPI_STATE_THREADED, &napi->state, threaded);
+	}
 
 	return err;
 }
 EXPORT_SYMBOL(dev_set_threaded);
 
+/**
+ * napi_set_threaded - set the threaded mode of a single NAPI instance
+ * @napi: NAPI context
+ * @threaded: NETDEV_NAPI_THREADED_* mode
+ *
+ * In NETDEV_NAPI_THREADED_BUSY_POLL mode the NAPI kthread keeps polling
+ * with the device IRQ left disabled for as long as the queue has traffic,
+ * and only completes the NAPI, re-arming the IRQ, once it has been idle
+ * for napi->busy_poll_idle_usecs.
+ *
+ * As for dev_set_threaded(), the change takes effect the next time the
+ * NAPI is scheduled. The mode is reset by napi_disable().
+ *
+ * Context: rtnl_lock() held.
+ */
+int napi_set_threaded(struct napi_struct *napi,
+		      enum netdev_napi_threaded threaded)
+{
+	int err;
+
+	if (threaded != NETDEV_NAPI_THREADED_DISABLED && !napi->thread) {
+		err = napi_kthread_create(napi);
+		if (err)
+			return err;
+	}
+
+	/* Make sure kthread is created before THREADED bit is set. */
+	smp_mb__before_atomic();
+
+	assign_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state,
+		   threaded == NETDEV_NAPI_THREADED_BUSY_POLL);
+	assign_bit(NAPI_STATE_THREADED, &napi->state,
+		   threaded != NETDEV_NAPI_THREADED_DISABLED);
+
+	return 0;
+}
+
 /**
  * netif_queue_set_napi - Associate queue with the napi
  * @dev: device to which NAPI and queue belong
@@ -6688,6 +6947,7 @@ void netif_napi_add_weight(struct net_device *dev, struct napi_struct *napi,
 	napi->poll_owner = -1;
 #endif
 	napi->list_owner = -1;
+	napi->busy_poll_idle_usecs = NAPI_BUSY_POLL_IDLE_USECS;
 	set_bit(NAPI_STATE_SCHED, &napi->state);
 	set_bit(NAPI_STATE_NPSVC, &napi->state);
 	list_add_rcu(&napi->dev_list, &dev->napi_list);
@@ -6718,7 +6978,8 @@ void napi_disable(struct napi_struct *n)
 		}
 
 		new = val | NAPIF_STATE_SCHED | NAPIF_STATE_NPSVC;
-		new &= ~(NAPIF_STATE_THREADED | NAPIF_STATE_PREFER_BUSY_POLL);
+		new &= ~(NAPIF_STATE_THREADED | NAPIF_STATE_THREADED_BUSY_POLL |
+			 NAPIF_STATE_PREFER_BUSY_POLL);
 	} while (!try_cmpxchg(&n->state, &val, new));
 
 	hrtimer_cancel(&n->timer);
@@ -6898,15 +7159,48 @@ static int napi_thread_wait(struct napi_struct *napi)
 	return -1;
 }
 
+/* Whether a busy-polling NAPI thread should let the IRQ back on */
+static bool napi_threaded_busy_poll_stop(struct napi_struct *napi,
+					 u64 idle_since)
+{
+	u64 idle_ns;
+
+	if (!test_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state) ||
+	    napi_disable_pending(napi) || kthread_should_stop())
+		return true;
+
+	if (!idle_since)
+		return false;
+
+	idle_ns = (u64)READ_ONCE(napi->busy_poll_idle_usecs) * NSEC_PER_USEC;
+	return local_clock() - idle_since > idle_ns;
+}
+
 static void napi_threaded_poll_loop(struct napi_struct *napi)
 {
 	struct bpf_net_context __bpf_net_ctx, *bpf_net_ctx;
 	struct softnet_data *sd;
 	unsigned long last_qs = jiffies;
+	u64 idle_since = 0;
+	bool busy_poll;
+
+	/* While NAPI_STATE_IN_BUSY_POLL is set, napi_complete_done() leaves
+	 * the NAPI scheduled and the driver doesn't re-enable its IRQ.
+	 */
+	busy_poll = test_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state);
+	if (busy_poll)
+		set_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state);
 
 	for (;;) {
 		bool repoll = false;
 		void *have;
+		int work;
+
+		/* The next poll completes the NAPI as usual */
+		if (busy_poll && napi_threaded_busy_poll_stop(napi, idle_since)) {
+			clear_bit(NAPI_STATE_IN_BUSY_POLL, &napi->state);
+			busy_poll = false;
+		}
 
 		local_bh_disable();
 		bpf_net_ctx = bpf_net_ctx_set(&__bpf_net_ctx);
@@ -6915,7 +7209,13 @@ static void napi_threaded_poll_loop(struct napi_struct *napi)
 		sd->in_napi_threaded_poll = true;
 
 		have = netpoll_poll_lock(napi);
-		__napi_poll(napi, &repoll);
+		work = __napi_poll(napi, &repoll);
+		/* napi_complete_done() returned early, flush GRO here */
+		if (busy_poll && work < napi->weight) {
+			if (napi->gro_bitmask)
+				napi_gro_flush(napi, false);
+			gro_normal_list(napi);
+		}
 		netpoll_poll_unlock(have);
 
 		sd->in_napi_threaded_poll = false;
@@ -6926,9 +7226,24 @@ static void napi_threaded_poll_loop(struct napi_struct *napi)
 			net_rps_action_and_irq_enable(sd);
 		}
 		skb_defer_free_flush(sd);
+		page_pool_flush_deferred();
 		bpf_net_ctx_clear(bpf_net_ctx);
 		local_bh_enable();
 
+		if (busy_poll) {
+			if (work) {
+				WRITE_ONCE(napi->busy_poll_productive,
+					   napi->busy_poll_productive + 1);
+				idle_since = 0;
+			} else {
+				WRITE_ONCE(napi->busy_poll_empty,
+					   napi->busy_poll_empty + 1);
+				if (!idle_since)
+					idle_since = local_clock();
+			}
+			repoll = true;
+		}
+
 		if (!repoll)
 			break;
 
@@ -6968,6 +7283,7 @@ static __latent_entropy void net_rx_action(void)
 		struct napi_struct *n;
 
 		skb_defer_free_flush(sd);
+		page_pool_flush_deferred();
 
 		if (list_empty(&list)) {
 			if (list_empty(&repoll)) {
@@ -11725,6 +12041,9 @@ static int dev_cpu_dead(unsigned int oldcpu)
 		net_rps_send_ipi(remsd);
 	}
 
+	/* Recycle page_pool pages the offline CPU still had batched */
+	page_pool_flush_deferred_cpu(oldcpu);
+
 	/* Process offline CPU's input_pkt_queue */
 	while ((skb = __skb_dequeue(&oldsd->process_queue))) {
 		netif_rx(skb);
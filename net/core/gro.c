@@ -91,6 +91,18 @@ void dev_remove_offload(struct packet_offload *po)
 EXPORT_SYMBOL(dev_remove_offload);
 
 
+/* Whether the payload of @frag, past @eat bytes, directly follows @prev.
+ * With header-data split the payload buffers of a flow are often carved
+ * out of the same page back to back, and can share a single frag.
+ */
+static bool skb_gro_frag_contiguous(const skb_frag_t *prev,
+				    const skb_frag_t *frag, unsigned int eat)
+{
+	return skb_frag_netmem(prev) == skb_frag_netmem(frag) &&
+	       skb_frag_off(prev) + skb_frag_size(prev) ==
+	       skb_frag_off(frag) + eat;
+}
+
 int skb_gro_receive(struct sk_buff *p, struct sk_buff *skb)
 {
 	struct skb_shared_info *pinfo, *skbinfo = skb_shinfo(skb);
@@ -128,27 +140,40 @@ int skb_gro_receive(struct sk_buff *p, struct sk_buff *skb)
 	pinfo = skb_shinfo(lp);
 
 	if (headlen <= offset) {
-		skb_frag_t *frag;
-		skb_frag_t *frag2;
+		skb_frag_t *frag = pinfo->frags + pinfo->nr_frags;
+		skb_frag_t *frag2 = skbinfo->frags;
+		unsigned int eat = offset - headlen;
 		int i = skbinfo->nr_frags;
 		int nr_frags = pinfo->nr_frags + i;
+		bool coalesce;
+
+		/* Extending the last frag doesn't need to look at the payload,
+		 * and lets larger aggregates stay in the frags array.
+		 */
+		coalesce = pinfo->nr_frags && i &&
+			   skb_gro_frag_contiguous(frag - 1, frag2, eat);
+		if (coalesce)
+			nr_frags--;
 
 		if (nr_frags > MAX_SKB_FRAGS)
 			goto merge;
 
-		offset -= headlen;
+		if (coalesce) {
+			skb_frag_size_add(frag - 1, skb_frag_size(frag2) - eat);
+			/* the extended frag holds the page already */
+			skb_frag_unref(skb, 0);
+			frag2++;
+			i--;
+			__this_cpu_inc(softnet_data.gro_coalesced);
+		} else {
+			skb_frag_off_add(frag2, eat);
+			skb_frag_size_sub(frag2, eat);
+		}
+
+		memcpy(frag, frag2, sizeof(*frag) * i);
 		pinfo->nr_frags = nr_frags;
 		skbinfo->nr_frags = 0;
 
-		frag = pinfo->frags + nr_frags;
-		frag2 = skbinfo->frags + i;
-		do {
-			*--frag = *--frag2;
-		} while (--i);
-
-		skb_frag_off_add(frag, offset);
-		skb_frag_size_sub(frag, offset);
-
 		/* all fragments truesize : remove (head size + sk_buff) */
 		new_truesize = SKB_TRUESIZE(skb_end_offset(skb));
 		delta_truesize = skb->truesize - new_truesize;
@@ -268,6 +293,9 @@ static void napi_gro_complete(struct napi_struct *napi, struct sk_buff *skb)
 		goto out;
 	}
 
+	__this_cpu_inc(softnet_data.gro_merged);
+	__this_cpu_add(softnet_data.gro_merged_bytes, skb->len);
+
 	rcu_read_lock();
 	list_for_each_entry_rcu(ptype, head, list) {
 		if (ptype->type != type || !ptype->callbacks.gro_complete)
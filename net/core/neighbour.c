@@ -249,6 +249,18 @@ bool neigh_remove_one(struct neighbour *ndel, struct neigh_table *tbl)
 	return false;
 }
 
+/* Move the gc_list entries a forced GC run scanned and kept, the ones
+ * before @next, to the tail so the next run starts on the entries it
+ * hasn't looked at yet.
+ */
+static void neigh_gc_list_rotate(struct neigh_table *tbl,
+				 struct list_head *next)
+{
+	if (next != &tbl->gc_list && next->prev != &tbl->gc_list)
+		list_bulk_move_tail(&tbl->gc_list, tbl->gc_list.next,
+				    next->prev);
+}
+
 static int neigh_forced_gc(struct neigh_table *tbl)
 {
 	int max_clean = atomic_read(&tbl->gc_entries) -
@@ -278,11 +290,15 @@ static int neigh_forced_gc(struct neigh_table *tbl)
 
 			if (remove && neigh_remove_one(n, tbl))
 				shrunk++;
-			if (shrunk >= max_clean)
+			if (shrunk >= max_clean) {
+				neigh_gc_list_rotate(tbl, &tmp->gc_list);
 				break;
+			}
 			if (++loop == 16) {
-				if (ktime_get_ns() > tmax)
+				if (ktime_get_ns() > tmax) {
+					neigh_gc_list_rotate(tbl, &tmp->gc_list);
 					goto unlock;
+				}
 				loop = 0;
 			}
 		}
@@ -945,12 +961,16 @@ static void neigh_connect(struct neighbour *neigh)
 	WRITE_ONCE(neigh->output, neigh->ops->connected_output);
 }
 
+/* Hash buckets neigh_periodic_work() scans per run */
+#define NEIGH_GC_BUCKETS	1024
+
 static void neigh_periodic_work(struct work_struct *work)
 {
 	struct neigh_table *tbl = container_of(work, struct neigh_table, gc_work.work);
+	unsigned long delay = NEIGH_VAR(&tbl->parms, BASE_REACHABLE_TIME) >> 1;
 	struct neighbour *n;
 	struct neighbour __rcu **np;
-	unsigned int i;
+	unsigned int i, end, nr_buckets;
 	struct neigh_hash_table *nht;
 
 	NEIGH_CACHE_STAT_INC(tbl, periodic_gc_runs);
@@ -972,10 +992,23 @@ static void neigh_periodic_work(struct work_struct *work)
 				neigh_rand_reach_time(NEIGH_VAR(p, BASE_REACHABLE_TIME));
 	}
 
-	if (atomic_read(&tbl->entries) < READ_ONCE(tbl->gc_thresh1))
+	if (atomic_read(&tbl->entries) < READ_ONCE(tbl->gc_thresh1)) {
+		tbl->gc_bucket = 0;
 		goto out;
+	}
 
-	for (i = 0 ; i < (1 << nht->hash_shift); i++) {
+	/* Scan a bounded slice of the table per run, so a large table never
+	 * holds tbl->lock for long, and spread the runs so that the whole
+	 * table is still covered every BASE_REACHABLE_TIME/2.
+	 */
+	nr_buckets = 1 << nht->hash_shift;
+	i = tbl->gc_bucket < nr_buckets ? tbl->gc_bucket : 0;
+	end = min(i + NEIGH_GC_BUCKETS, nr_buckets);
+	if (nr_buckets > NEIGH_GC_BUCKETS)
+		delay = max(delay / DIV_ROUND_UP(nr_buckets, NEIGH_GC_BUCKETS),
+			    1UL);
+
+	for (; i < end && i < (1 << nht->hash_shift); i++) {
 		np = &nht->hash_buckets[i];
 
 		while ((n = rcu_dereference_protected(*np,
@@ -1022,13 +1055,13 @@ static void neigh_periodic_work(struct work_struct *work)
 		nht = rcu_dereference_protected(tbl->nht,
 						lockdep_is_held(&tbl->lock));
 	}
+	tbl->gc_bucket = i < (1 << nht->hash_shift) ? i : 0;
 out:
 	/* Cycle through all hash buckets every BASE_REACHABLE_TIME/2 ticks.
 	 * ARP entry timeouts range from 1/2 BASE_REACHABLE_TIME to 3/2
 	 * BASE_REACHABLE_TIME.
 	 */
-	queue_delayed_work(system_power_efficient_wq, &tbl->gc_work,
-			      NEIGH_VAR(&tbl->parms, BASE_REACHABLE_TIME) >> 1);
+	queue_delayed_work(system_power_efficient_wq, &tbl->gc_work, delay);
 	write_unlock_bh(&tbl->lock);
 }
 
@@ -161,6 +161,7 @@ static int
 netdev_nl_napi_fill_one(struct sk_buff *rsp, struct napi_struct *napi,
 			const struct genl_info *info)
 {
+	u32 threaded;
 	void *hdr;
 	pid_t pid;
 
@@ -186,6 +187,22 @@ netdev_nl_napi_fill_one(struct sk_buff *rsp, struct napi_struct *napi,
 			goto nla_put_failure;
 	}
 
+	if (test_bit(NAPI_STATE_THREADED_BUSY_POLL, &napi->state))
+		threaded = NETDEV_NAPI_THREADED_BUSY_POLL;
+	else if (test_bit(NAPI_STATE_THREADED, &napi->state))
+		threaded = NETDEV_NAPI_THREADED_ENABLED;
+	else
+		threaded = NETDEV_NAPI_THREADED_DISABLED;
+
+	if (nla_put_u32(rsp, NETDEV_A_NAPI_THREADED, threaded) ||
+	    nla_put_u32(rsp, NETDEV_A_NAPI_BUSY_POLL_IDLE_USECS,
+			READ_ONCE(napi->busy_poll_idle_usecs)) ||
+	    nla_put_uint(rsp, NETDEV_A_NAPI_BUSY_POLL_PRODUCTIVE,
+			 READ_ONCE(napi->busy_poll_productive)) ||
+	    nla_put_uint(rsp, NETDEV_A_NAPI_BUSY_POLL_EMPTY,
+			 READ_ONCE(napi->busy_poll_empty)))
+		goto nla_put_failure;
+
 	genlmsg_end(rsp, hdr);
 
 	return 0;
@@ -239,6 +256,68 @@ int netdev_nl_napi_get_doit(struct sk_buff *skb, struct genl_info *info)
 	return err;
 }
 
+/* Look up a NAPI that stays valid for as long as rtnl_lock() is held */
+static struct napi_struct *
+netdev_nl_napi_by_id_rtnl(struct net *net, unsigned int napi_id)
+{
+	struct net_device *netdev = NULL;
+	struct napi_struct *napi;
+
+	rcu_read_lock();
+	napi = netdev_napi_by_id(net, napi_id);
+	if (napi)
+		netdev = napi->dev;
+	rcu_read_unlock();
+
+	if (!netdev)
+		return NULL;
+
+	/* napi_list, unlike the NAPI hash, is protected by rtnl_lock() */
+	list_for_each_entry(napi, &netdev->napi_list, dev_list)
+		if (napi->napi_id == napi_id)
+			return napi;
+
+	return NULL;
+}
+
+int netdev_nl_napi_set_doit(struct sk_buff *skb, struct genl_info *info)
+{
+	struct napi_struct *napi;
+	u32 napi_id;
+	int err = 0;
+
+	if (GENL_REQ_ATTR_CHECK(info, NETDEV_A_NAPI_ID))
+		return -EINVAL;
+
+	napi_id = nla_get_u32(info->attrs[NETDEV_A_NAPI_ID]);
+
+	rtnl_lock();
+
+	napi = netdev_nl_napi_by_id_rtnl(genl_info_net(info), napi_id);
+	if (!napi) {
+		NL_SET_BAD_ATTR(info->extack, info->attrs[NETDEV_A_NAPI_ID]);
+		err = -ENOENT;
+		goto out_unlock;
+	}
+
+	if (info->attrs[NETDEV_A_NAPI_BUSY_POLL_IDLE_USECS])
+		WRITE_ONCE(napi->busy_poll_idle_usecs,
+			   nla_get_u32(info->attrs[NETDEV_A_NAPI_BUSY_POLL_IDLE_USECS]));
+
+	if (info->attrs[NETDEV_A_NAPI_THREADED]) {
+		err = napi_set_threaded(napi,
+					nla_get_u32(info->attrs[NETDEV_A_NAPI_THREADED]));
+		if (err)
+			NL_SET_ERR_MSG(info->extack,
+				       "failed to create the NAPI thread");
+	}
+
+out_unlock:
+	rtnl_unlock();
+
+	return err;
+}
+
 static int
 netdev_nl_napi_dump_one(struct net_device *netdev, struct sk_buff *rsp,
 			const struct genl_info *info,
@@ -782,7 +861,8 @@ int netdev_nl_bind_rx_doit(struct sk_buff *skb, struct genl_info *info)
 		goto err_unlock;
 	}
 
-	binding = net_devmem_bind_dmabuf(netdev, dmabuf_fd, info->extack);
+	binding = net_devmem_bind_dmabuf(netdev, DMA_FROM_DEVICE, dmabuf_fd,
+					 info->extack);
 	if (IS_ERR(binding)) {
 		err = PTR_ERR(binding);
 		goto err_unlock;
@@ -839,6 +919,82 @@ int netdev_nl_bind_rx_doit(struct sk_buff *skb, struct genl_info *info)
 	return err;
 }
 
+int netdev_nl_bind_tx_doit(struct sk_buff *skb, struct genl_info *info)
+{
+	struct net_devmem_dmabuf_binding *binding;
+	struct list_head *sock_binding_list;
+	struct net_device *netdev;
+	u32 ifindex, dmabuf_fd;
+	struct sk_buff *rsp;
+	int err = 0;
+	void *hdr;
+
+	if (GENL_REQ_ATTR_CHECK(info, NETDEV_A_DEV_IFINDEX) ||
+	    GENL_REQ_ATTR_CHECK(info, NETDEV_A_DMABUF_FD))
+		return -EINVAL;
+
+	ifindex = nla_get_u32(info->attrs[NETDEV_A_DEV_IFINDEX]);
+	dmabuf_fd = nla_get_u32(info->attrs[NETDEV_A_DMABUF_FD]);
+
+	sock_binding_list = genl_sk_priv_get(&netdev_nl_family,
+					     NETLINK_CB(skb).sk);
+	if (IS_ERR(sock_binding_list))
+		return PTR_ERR(sock_binding_list);
+
+	rsp = genlmsg_new(GENLMSG_DEFAULT_SIZE, GFP_KERNEL);
+	if (!rsp)
+		return -ENOMEM;
+
+	hdr = genlmsg_iput(rsp, info);
+	if (!hdr) {
+		err = -EMSGSIZE;
+		goto err_genlmsg_free;
+	}
+
+	rtnl_lock();
+
+	netdev = __dev_get_by_index(genl_info_net(info), ifindex);
+	if (!netdev || !netif_device_present(netdev)) {
+		err = -ENODEV;
+		goto err_unlock;
+	}
+
+	if (!netdev->netmem_tx) {
+		NL_SET_ERR_MSG(info->extack,
+			       "Driver does not support netmem TX");
+		err = -EOPNOTSUPP;
+		goto err_unlock;
+	}
+
+	binding = net_devmem_bind_dmabuf(netdev, DMA_TO_DEVICE, dmabuf_fd,
+					 info->extack);
+	if (IS_ERR(binding)) {
+		err = PTR_ERR(binding);
+		goto err_unlock;
+	}
+
+	list_add(&binding->list, sock_binding_list);
+
+	nla_put_u32(rsp, NETDEV_A_DMABUF_ID, binding->id);
+	genlmsg_end(rsp, hdr);
+
+	err = genlmsg_reply(rsp, info);
+	if (err)
+		goto err_unbind;
+
+	rtnl_unlock();
+
+	return 0;
+
+err_unbind:
+	net_devmem_unbind_dmabuf(binding);
+err_unlock:
+	rtnl_unlock();
+err_genlmsg_free:
+	nlmsg_free(rsp);
+	return err;
+}
+
 void netdev_nl_sock_priv_init(struct list_head *priv)
 {
 	INIT_LIST_HEAD(priv);
@@ -201,6 +201,7 @@ static int page_pool_init(struct page_pool *pool,
 	memcpy(&pool->slow, &params->slow, sizeof(pool->slow));
 
 	pool->cpuid = cpuid;
+	pool->alloc.target = PP_ALLOC_CACHE_DEF;
 
 	/* Validate only known flags were used */
 	if (pool->slow.flags & ~PP_FLAG_ALL)
@@ -367,11 +368,49 @@ EXPORT_SYMBOL(page_pool_create);
 
 static void page_pool_return_page(struct page_pool *pool, netmem_ref netmem);
 
+/* Number of alloc cache misses the cache target is re-evaluated after */
+#define PP_ALLOC_ADAPT_WINDOW	64
+
+/* Called on every alloc cache miss, i.e. with an empty cache, just before
+ * the miss is served either from the ptr_ring (@slow == false) or from the
+ * page allocator (@slow == true).
+ *
+ * Misses mostly served by the page allocator mean pages recycled by the
+ * driver spill past the cache and get released, so grow the cache. Misses
+ * all served from the ring mean the cache is deeper than needed to absorb
+ * the bursts of this pool, so shrink it and let the pages go back to the
+ * ring, where idle pools don't pin them per queue.
+ */
+static void page_pool_alloc_cache_adapt(struct page_pool *pool, bool slow)
+{
+	struct pp_alloc_cache *alloc = &pool->alloc;
+	u32 target = alloc->target;
+
+	if (slow)
+		alloc->nr_slow++;
+	else
+		alloc->nr_refill++;
+
+	if (alloc->nr_slow + alloc->nr_refill < PP_ALLOC_ADAPT_WINDOW)
+		return;
+
+	if (alloc->nr_slow > alloc->nr_refill)
+		target = min(target * 2, PP_ALLOC_CACHE_SIZE);
+	else if (!alloc->nr_slow)
+		target = max(target / 2, PP_ALLOC_CACHE_MIN);
+
+	alloc->nr_slow = 0;
+	alloc->nr_refill = 0;
+	/* Also read locklessly by netlink */
+	WRITE_ONCE(alloc->target, target);
+}
+
 static noinline netmem_ref page_pool_refill_alloc_cache(struct page_pool *pool)
 {
 	struct ptr_ring *r = &pool->ring;
 	netmem_ref netmem;
 	int pref_nid; /* preferred NUMA node */
+	u32 refill;
 
 	/* Quicker fallback, avoid locks when ring is empty */
 	if (__ptr_ring_empty(r)) {
@@ -379,6 +418,9 @@ static noinline netmem_ref page_pool_refill_alloc_cache(struct page_pool *pool)
 		return 0;
 	}
 
+	page_pool_alloc_cache_adapt(pool, false);
+	refill = min(pool->alloc.target, PP_ALLOC_CACHE_REFILL);
+
 	/* Softirq guarantee CPU and thus NUMA node is stable. This,
 	 * assumes CPU refilling driver RX-ring will also run RX-NAPI.
 	 */
@@ -408,7 +450,7 @@ static noinline netmem_ref page_pool_refill_alloc_cache(struct page_pool *pool)
 			netmem = 0;
 			break;
 		}
-	} while (pool->alloc.count < PP_ALLOC_CACHE_REFILL);
+	} while (pool->alloc.count < refill);
 
 	/* Return last page */
 	if (likely(pool->alloc.count > 0)) {
@@ -518,11 +560,11 @@ static struct page *__page_pool_alloc_page_order(struct page_pool *pool,
 static noinline netmem_ref __page_pool_alloc_pages_slow(struct page_pool *pool,
 							gfp_t gfp)
 {
-	const int bulk = PP_ALLOC_CACHE_REFILL;
 	unsigned int pp_order = pool->p.order;
 	bool dma_map = pool->dma_map;
 	netmem_ref netmem;
 	int i, nr_pages;
+	int bulk;
 
 	/* Don't support bulk alloc for high-order pages */
 	if (unlikely(pp_order))
@@ -532,6 +574,9 @@ static noinline netmem_ref __page_pool_alloc_pages_slow(struct page_pool *pool,
 	if (unlikely(pool->alloc.count > 0))
 		return pool->alloc.cache[--pool->alloc.count];
 
+	page_pool_alloc_cache_adapt(pool, true);
+	bulk = min(pool->alloc.target, PP_ALLOC_CACHE_REFILL);
+
 	/* Mark empty alloc.cache slots "empty" for alloc_pages_bulk_array */
 	memset(&pool->alloc.cache, 0, sizeof(void *) * bulk);
 
@@ -697,23 +742,6 @@ void page_pool_return_page(struct page_pool *pool, netmem_ref netmem)
 	 */
 }
 
-static bool page_pool_recycle_in_ring(struct page_pool *pool, netmem_ref netmem)
-{
-	int ret;
-	/* BH protection not needed if current is softirq */
-	if (in_softirq())
-		ret = ptr_ring_produce(&pool->ring, (__force void *)netmem);
-	else
-		ret = ptr_ring_produce_bh(&pool->ring, (__force void *)netmem);
-
-	if (!ret) {
-		recycle_stat_inc(pool, ring);
-		return true;
-	}
-
-	return false;
-}
-
 /* Only allow direct recycling in special circumstances, into the
  * alloc side cache.  E.g. during RX-NAPI processing for XDP_DROP use-case.
  *
@@ -722,7 +750,7 @@ static bool page_pool_recycle_in_ring(struct page_pool *pool, netmem_ref netmem)
 static bool page_pool_recycle_in_cache(netmem_ref netmem,
 				       struct page_pool *pool)
 {
-	if (unlikely(pool->alloc.count == PP_ALLOC_CACHE_SIZE)) {
+	if (unlikely(pool->alloc.count >= pool->alloc.target)) {
 		recycle_stat_inc(pool, cache_full);
 		return false;
 	}
@@ -815,6 +843,142 @@ static bool page_pool_napi_local(const struct page_pool *pool)
 	return napi && READ_ONCE(napi->list_owner) == cpuid;
 }
 
+/* Produce @count pages into the ptr_ring with a single producer lock hold,
+ * releasing to the page allocator whatever does not fit.
+ */
+static void page_pool_recycle_ring_bulk(struct page_pool *pool, void **data,
+					int count)
+{
+	bool in_softirq;
+	int i;
+
+	/* Bulk producer into ptr_ring page_pool cache */
+	in_softirq = page_pool_producer_lock(pool);
+	for (i = 0; i < count; i++) {
+		if (__ptr_ring_produce(&pool->ring, data[i])) {
+			/* ring full */
+			recycle_stat_inc(pool, ring_full);
+			break;
+		}
+	}
+	recycle_stat_add(pool, ring, i);
+	page_pool_producer_unlock(pool, in_softirq);
+
+	/* Hopefully all pages was return into ptr_ring */
+	if (likely(i == count))
+		return;
+
+	/* ptr_ring cache full, free remaining pages outside producer lock
+	 * since put_page() with refcnt == 1 can be an expensive operation
+	 */
+	for (; i < count; i++)
+		page_pool_return_page(pool, (__force netmem_ref)data[i]);
+}
+
+/* Pages that can't go to the alloc cache, typically because they are freed
+ * on another CPU than the one running the pool's NAPI, are not produced into
+ * the ptr_ring one by one. They are parked in a small per-CPU batch instead,
+ * which is produced into the ring of its pool with one producer lock hold
+ * when it fills up, when a page of a different pool comes in, at every NAPI
+ * softirq run of the CPU (see net_rx_action()) and when the pool is
+ * scrubbed on destruction.
+ *
+ * Pages not on the pool's NUMA node are released right away, since the
+ * alloc side would waive them anyway.
+ */
+#define PP_DEFER_BATCH	16
+
+struct page_pool_defer {
+	/* Only ever contended by page_pool_scrub() and CPU hotplug */
+	spinlock_t lock;
+	struct page_pool *pool;
+	unsigned int count;
+	void *data[PP_DEFER_BATCH];
+};
+
+static DEFINE_PER_CPU(struct page_pool_defer, pp_defer) = {
+	.lock = __SPIN_LOCK_UNLOCKED(pp_defer.lock),
+};
+
+static void __page_pool_defer_flush(struct page_pool_defer *defer)
+{
+	lockdep_assert_held(&defer->lock);
+
+	if (!defer->count)
+		return;
+
+	page_pool_recycle_ring_bulk(defer->pool, defer->data, defer->count);
+	defer->count = 0;
+	WRITE_ONCE(defer->pool, NULL);
+}
+
+static void page_pool_recycle_deferred(struct page_pool *pool,
+				       netmem_ref netmem)
+{
+	struct page_pool_defer *defer;
+
+	if (unlikely(!netmem_is_net_iov(netmem) &&
+		     pool->p.nid != NUMA_NO_NODE &&
+		     page_to_nid(netmem_to_page(netmem)) != pool->p.nid)) {
+		page_pool_return_page(pool, netmem);
+		return;
+	}
+
+	local_bh_disable();
+	defer = this_cpu_ptr(&pp_defer);
+	spin_lock(&defer->lock);
+
+	if (defer->count && defer->pool != pool)
+		__page_pool_defer_flush(defer);
+
+	WRITE_ONCE(defer->pool, pool);
+	defer->data[defer->count++] = (__force void *)netmem;
+	if (defer->count == PP_DEFER_BATCH)
+		__page_pool_defer_flush(defer);
+
+	spin_unlock(&defer->lock);
+	local_bh_enable();
+}
+
+static void page_pool_defer_flush_cpu(int cpu, struct page_pool *pool)
+{
+	struct page_pool_defer *defer = per_cpu_ptr(&pp_defer, cpu);
+
+	if (pool && READ_ONCE(defer->pool) != pool)
+		return;
+
+	spin_lock_bh(&defer->lock);
+	if (!pool || defer->pool == pool)
+		__page_pool_defer_flush(defer);
+	spin_unlock_bh(&defer->lock);
+}
+
+/**
+ * page_pool_flush_deferred() - recycle this CPU's deferred pages
+ *
+ * Must be called with BH disabled.
+ */
+void page_pool_flush_deferred(void)
+{
+	struct page_pool_defer *defer = this_cpu_ptr(&pp_defer);
+
+	if (!READ_ONCE(defer->count))
+		return;
+
+	spin_lock(&defer->lock);
+	__page_pool_defer_flush(defer);
+	spin_unlock(&defer->lock);
+}
+
+/**
+ * page_pool_flush_deferred_cpu() - recycle the deferred pages of a dead CPU
+ * @cpu: the CPU that went offline
+ */
+void page_pool_flush_deferred_cpu(int cpu)
+{
+	page_pool_defer_flush_cpu(cpu, NULL);
+}
+
 void page_pool_put_unrefed_netmem(struct page_pool *pool, netmem_ref netmem,
 				  unsigned int dma_sync_size, bool allow_direct)
 {
@@ -823,11 +987,8 @@ void page_pool_put_unrefed_netmem(struct page_pool *pool, netmem_ref netmem,
 
 	netmem =
 		__page_pool_put_page(pool, netmem, dma_sync_size, allow_direct);
-	if (netmem && !page_pool_recycle_in_ring(pool, netmem)) {
-		/* Cache full, fallback to free pages */
-		recycle_stat_inc(pool, ring_full);
-		page_pool_return_page(pool, netmem);
-	}
+	if (netmem)
+		page_pool_recycle_deferred(pool, netmem);
 }
 EXPORT_SYMBOL(page_pool_put_unrefed_netmem);
 
@@ -859,7 +1020,6 @@ void page_pool_put_page_bulk(struct page_pool *pool, void **data,
 {
 	int i, bulk_len = 0;
 	bool allow_direct;
-	bool in_softirq;
 
 	allow_direct = page_pool_napi_local(pool);
 
@@ -879,27 +1039,7 @@ void page_pool_put_page_bulk(struct page_pool *pool, void **data,
 	if (!bulk_len)
 		return;
 
-	/* Bulk producer into ptr_ring page_pool cache */
-	in_softirq = page_pool_producer_lock(pool);
-	for (i = 0; i < bulk_len; i++) {
-		if (__ptr_ring_produce(&pool->ring, data[i])) {
-			/* ring full */
-			recycle_stat_inc(pool, ring_full);
-			break;
-		}
-	}
-	recycle_stat_add(pool, ring, i);
-	page_pool_producer_unlock(pool, in_softirq);
-
-	/* Hopefully all pages was return into ptr_ring */
-	if (likely(i == bulk_len))
-		return;
-
-	/* ptr_ring cache full, free remaining pages outside producer lock
-	 * since put_page() with refcnt == 1 can be an expensive operation
-	 */
-	for (; i < bulk_len; i++)
-		page_pool_return_page(pool, (__force netmem_ref)data[i]);
+	page_pool_recycle_ring_bulk(pool, data, bulk_len);
 }
 EXPORT_SYMBOL(page_pool_put_page_bulk);
 
@@ -1037,9 +1177,15 @@ static void page_pool_empty_alloc_cache_once(struct page_pool *pool)
 
 static void page_pool_scrub(struct page_pool *pool)
 {
+	int cpu;
+
 	page_pool_empty_alloc_cache_once(pool);
 	pool->destroy_cnt++;
 
+	/* Deferred pages count as in-flight, get them into the ring */
+	for_each_possible_cpu(cpu)
+		page_pool_defer_flush_cpu(cpu, pool);
+
 	/* No more consumers should exist, but producers could still
 	 * be in-flight.
 	 */
@@ -40,6 +40,8 @@ void page_pool_set_pp_info(struct page_pool *pool, netmem_ref netmem);
 void page_pool_clear_pp_info(netmem_ref netmem);
 int page_pool_check_memory_provider(struct net_device *dev,
 				    struct netdev_rx_queue *rxq);
+void page_pool_flush_deferred(void);
+void page_pool_flush_deferred_cpu(int cpu);
 #else
 static inline void page_pool_set_pp_info(struct page_pool *pool,
 					 netmem_ref netmem)
@@ -53,6 +55,12 @@ static inline int page_pool_check_memory_provider(struct net_device *dev,
 {
 	return 0;
 }
+static inline void page_pool_flush_deferred(void)
+{
+}
+static inline void page_pool_flush_deferred_cpu(int cpu)
+{
+}
 #endif
 
 #endif
@@ -246,6 +246,9 @@ page_pool_nl_fill(struct sk_buff *rsp, const struct page_pool *pool,
 
 	if (binding && nla_put_u32(rsp, NETDEV_A_PAGE_POOL_DMABUF, binding->id))
 		goto err_cancel;
+	if (nla_put_u32(rsp, NETDEV_A_PAGE_POOL_ALLOC_CACHE_TARGET,
+			READ_ONCE(pool->alloc.target)))
+		goto err_cancel;
 
 	genlmsg_end(rsp, hdr);
 
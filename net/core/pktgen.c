@@ -171,7 +171,7 @@
 #include <asm/dma.h>
 #include <asm/div64.h>		/* do_div */
 
-#define VERSION	"2.75"
+#define VERSION	"2.76"
 #define IP_NAME_SZ 32
 #define MAX_MPLS_LABELS 16 /* This is the max label stack depth */
 #define MPLS_STACK_BOTTOM htonl(0x00000100)
@@ -445,11 +445,31 @@ struct pktgen_hdr {
 
 static unsigned int pg_net_id __read_mostly;
 
+/* Receive side latency of pktgen packets, bucket i counts [2^(i-1), 2^i) us */
+#define PKTGEN_RX_BUCKETS	24
+
+struct pktgen_rx_stats {
+	u64 packets;
+	u64 negative;		/* sender clock ahead of ours */
+	u64 sum_us;
+	u64 max_us;
+	u64 hist[PKTGEN_RX_BUCKETS];
+};
+
+struct pktgen_rx {
+	struct packet_type	pt_ip;
+	struct packet_type	pt_ipv6;
+	struct net_device	*dev;
+	netdevice_tracker	dev_tracker;
+	struct pktgen_rx_stats __percpu *stats;
+};
+
 struct pktgen_net {
 	struct net		*net;
 	struct proc_dir_entry	*proc_dir;
 	struct list_head	pktgen_threads;
 	bool			pktgen_exiting;
+	struct pktgen_rx	*rx;	/* protected by pktgen_rx_lock */
 };
 
 struct pktgen_thread {
@@ -497,11 +517,169 @@ static int pg_clone_skb_d  __read_mostly;
 static int debug  __read_mostly;
 
 static DEFINE_MUTEX(pktgen_thread_lock);
+static DEFINE_MUTEX(pktgen_rx_lock);
 
 static struct notifier_block pktgen_notifier_block = {
 	.notifier_call = pktgen_device_event,
 };
 
+/*
+ * Receive side latency measurement
+ *
+ * Packets carrying a pktgen header after their UDP header, received on
+ * the selected device, are timed against the transmit timestamp in that
+ * header.  The latency is one way, so unless the sender is this host
+ * both clocks must be synchronized.
+ */
+
+static int pktgen_rcv(struct sk_buff *skb, struct net_device *dev,
+		      struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct pktgen_rx *rx = pt->af_packet_priv;
+	struct pktgen_hdr _pgh, *pgh;
+	struct pktgen_rx_stats *st;
+	unsigned int off, bucket;
+	struct timespec64 now;
+	s64 lat_us;
+
+	if (skb->protocol == htons(ETH_P_IP)) {
+		struct iphdr _iph, *iph;
+
+		iph = skb_header_pointer(skb, 0, sizeof(_iph), &_iph);
+		if (!iph || iph->version != 4 || iph->protocol != IPPROTO_UDP ||
+		    ip_is_fragment(iph))
+			goto out;
+		off = iph->ihl * 4;
+	} else {
+		struct ipv6hdr _ip6h, *ip6h;
+
+		ip6h = skb_header_pointer(skb, 0, sizeof(_ip6h), &_ip6h);
+		if (!ip6h || ip6h->nexthdr != IPPROTO_UDP)
+			goto out;
+		off = sizeof(*ip6h);
+	}
+
+	pgh = skb_header_pointer(skb, off + sizeof(struct udphdr),
+				 sizeof(_pgh), &_pgh);
+	if (!pgh || pgh->pgh_magic != htonl(PKTGEN_MAGIC) ||
+	    (!pgh->tv_sec && !pgh->tv_usec))
+		goto out;
+
+	/* Prefer the driver or stack receive timestamp, if there is one. */
+	if (skb->tstamp && !skb->tstamp_type)
+		now = ktime_to_timespec64(skb->tstamp);
+	else
+		ktime_get_real_ts64(&now);
+
+	/* tv_sec is the low 32 bits of the sender's time, see finalize_skb */
+	lat_us = (s64)(s32)((u32)now.tv_sec - ntohl(pgh->tv_sec)) * USEC_PER_SEC +
+		 now.tv_nsec / NSEC_PER_USEC - ntohl(pgh->tv_usec);
+
+	st = this_cpu_ptr(rx->stats);
+	st->packets++;
+	if (lat_us < 0) {
+		st->negative++;
+		goto out;
+	}
+	st->sum_us += lat_us;
+	st->max_us = max_t(u64, st->max_us, lat_us);
+	bucket = lat_us ? min(fls64(lat_us), PKTGEN_RX_BUCKETS - 1) : 0;
+	st->hist[bucket]++;
+out:
+	consume_skb(skb);
+	return NET_RX_SUCCESS;
+}
+
+static void pktgen_rx_stop(struct pktgen_net *pn)
+{
+	struct pktgen_rx *rx = pn->rx;
+
+	lockdep_assert_held(&pktgen_rx_lock);
+
+	if (!rx)
+		return;
+	pn->rx = NULL;
+	__dev_remove_pack(&rx->pt_ip);
+	__dev_remove_pack(&rx->pt_ipv6);
+	/* Wait for pktgen_rcv() to be done with the stats. */
+	synchronize_net();
+	netdev_put(rx->dev, &rx->dev_tracker);
+	free_percpu(rx->stats);
+	kfree(rx);
+}
+
+static int pktgen_rx_start(struct pktgen_net *pn, const char *ifname)
+{
+	struct pktgen_rx *rx;
+
+	lockdep_assert_held(&pktgen_rx_lock);
+
+	rx = kzalloc(sizeof(*rx), GFP_KERNEL);
+	if (!rx)
+		return -ENOMEM;
+	rx->stats = alloc_percpu(struct pktgen_rx_stats);
+	if (!rx->stats) {
+		kfree(rx);
+		return -ENOMEM;
+	}
+	rx->dev = netdev_get_by_name(pn->net, ifname, &rx->dev_tracker,
+				     GFP_KERNEL);
+	if (!rx->dev) {
+		free_percpu(rx->stats);
+		kfree(rx);
+		return -ENODEV;
+	}
+
+	pktgen_rx_stop(pn);
+
+	rx->pt_ip.type = htons(ETH_P_IP);
+	rx->pt_ipv6.type = htons(ETH_P_IPV6);
+	rx->pt_ip.dev = rx->pt_ipv6.dev = rx->dev;
+	rx->pt_ip.func = rx->pt_ipv6.func = pktgen_rcv;
+	rx->pt_ip.af_packet_priv = rx->pt_ipv6.af_packet_priv = rx;
+	pn->rx = rx;
+	dev_add_pack(&rx->pt_ip);
+	dev_add_pack(&rx->pt_ipv6);
+	return 0;
+}
+
+static void pktgen_rx_show(struct seq_file *seq, struct pktgen_net *pn)
+{
+	struct pktgen_rx_stats sum = {};
+	struct pktgen_rx *rx;
+	int cpu, i, last = 0;
+
+	mutex_lock(&pktgen_rx_lock);
+	rx = pn->rx;
+	if (!rx)
+		goto unlock;
+
+	for_each_possible_cpu(cpu) {
+		struct pktgen_rx_stats *st = per_cpu_ptr(rx->stats, cpu);
+
+		sum.packets += READ_ONCE(st->packets);
+		sum.negative += READ_ONCE(st->negative);
+		sum.sum_us += READ_ONCE(st->sum_us);
+		sum.max_us = max(sum.max_us, READ_ONCE(st->max_us));
+		for (i = 0; i < PKTGEN_RX_BUCKETS; i++)
+			sum.hist[i] += READ_ONCE(st->hist[i]);
+	}
+
+	seq_printf(seq, "rx: %s packets: %llu negative: %llu\n",
+		   rx->dev->name, sum.packets, sum.negative);
+	if (sum.packets > sum.negative)
+		seq_printf(seq, "rx latency: avg %lluus max %lluus\n",
+			   div64_u64(sum.sum_us, sum.packets - sum.negative),
+			   sum.max_us);
+	for (i = 0; i < PKTGEN_RX_BUCKETS; i++)
+		if (sum.hist[i])
+			last = i;
+	for (i = 0; i <= last; i++)
+		seq_printf(seq, "  <%uus: %llu\n", 1U << i, sum.hist[i]);
+unlock:
+	mutex_unlock(&pktgen_rx_lock);
+}
+
 /*
  * /proc handling functions
  *
@@ -510,6 +688,7 @@ static struct notifier_block pktgen_notifier_block = {
 static int pgctrl_show(struct seq_file *seq, void *v)
 {
 	seq_puts(seq, version);
+	pktgen_rx_show(seq, seq->private);
 	return 0;
 }
 
@@ -539,7 +718,19 @@ static ssize_t pgctrl_write(struct file *file, const char __user *buf,
 		pktgen_run_all_threads(pn);
 	else if (!strcmp(data, "reset"))
 		pktgen_reset_all_threads(pn);
-	else
+	else if (!strncmp(data, "rx ", 3)) {
+		int err;
+
+		mutex_lock(&pktgen_rx_lock);
+		err = pktgen_rx_start(pn, strim(data + 3));
+		mutex_unlock(&pktgen_rx_lock);
+		if (err)
+			return err;
+	} else if (!strcmp(data, "rx_stop")) {
+		mutex_lock(&pktgen_rx_lock);
+		pktgen_rx_stop(pn);
+		mutex_unlock(&pktgen_rx_lock);
+	} else
 		return -EINVAL;
 
 	return count;
@@ -2086,6 +2277,10 @@ static int pktgen_device_event(struct notifier_block *unused,
 
 	case NETDEV_UNREGISTER:
 		pktgen_mark_device(pn, dev->name);
+		mutex_lock(&pktgen_rx_lock);
+		if (pn->rx && pn->rx->dev == dev)
+			pktgen_rx_stop(pn);
+		mutex_unlock(&pktgen_rx_lock);
 		break;
 	}
 
@@ -3982,7 +4177,7 @@ static int __net_init pg_net_init(struct net *net)
 		pr_warn("cannot create /proc/net/%s\n", PG_PROC_DIR);
 		return -ENODEV;
 	}
-	pe = proc_create(PGCTRL, 0600, pn->proc_dir, &pktgen_proc_ops);
+	pe = proc_create_data(PGCTRL, 0600, pn->proc_dir, &pktgen_proc_ops, pn);
 	if (pe == NULL) {
 		pr_err("cannot create %s procfs entry\n", PGCTRL);
 		ret = -EINVAL;
@@ -4036,6 +4231,10 @@ static void __net_exit pg_net_exit(struct net *net)
 		kfree(t);
 	}
 
+	mutex_lock(&pktgen_rx_lock);
+	pktgen_rx_stop(pn);
+	mutex_unlock(&pktgen_rx_lock);
+
 	remove_proc_entry(PGCTRL, pn->proc_dir);
 	remove_proc_entry(PG_PROC_DIR, pn->net->proc_net);
 }
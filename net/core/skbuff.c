@@ -88,6 +88,7 @@
 #include <linux/textsearch.h>
 
 #include "dev.h"
+#include "devmem.h"
 #include "netmem_priv.h"
 #include "sock_destructor.h"
 
@@ -343,13 +344,17 @@ void *__netdev_alloc_frag_align(unsigned int fragsz, unsigned int align_mask)
 }
 EXPORT_SYMBOL(__netdev_alloc_frag_align);
 
-static struct sk_buff *napi_skb_cache_get(void)
+static struct sk_buff *napi_skb_cache_get(bool alloc)
 {
 	struct napi_alloc_cache *nc = this_cpu_ptr(&napi_alloc_cache);
 	struct sk_buff *skb;
 
 	local_lock_nested_bh(&napi_alloc_cache.bh_lock);
 	if (unlikely(!nc->skb_count)) {
+		if (!alloc) {
+			local_unlock_nested_bh(&napi_alloc_cache.bh_lock);
+			return NULL;
+		}
 		nc->skb_count = kmem_cache_alloc_bulk(net_hotdata.skbuff_cache,
 						      GFP_ATOMIC | __GFP_NOWARN,
 						      NAPI_SKB_CACHE_BULK,
@@ -367,6 +372,66 @@ static struct sk_buff *napi_skb_cache_get(void)
 	return skb;
 }
 
+/* Refill the per-CPU cache with the caller's gfp mask, with BHs enabled.
+ * Returns one of the new heads, the rest go to the cache or, if it filled
+ * up meanwhile, back to the slab.
+ */
+static struct sk_buff *skb_head_cache_refill(gfp_t gfp_mask)
+{
+	struct napi_alloc_cache *nc;
+	void *skbs[NAPI_SKB_CACHE_BULK];
+	unsigned int n;
+
+	n = kmem_cache_alloc_bulk(net_hotdata.skbuff_cache,
+				  (gfp_mask & ~GFP_DMA) | __GFP_NOWARN,
+				  NAPI_SKB_CACHE_BULK, skbs);
+	if (unlikely(!n))
+		return NULL;
+
+	local_bh_disable();
+	local_lock_nested_bh(&napi_alloc_cache.bh_lock);
+	nc = this_cpu_ptr(&napi_alloc_cache);
+	while (n > 1 && nc->skb_count < NAPI_SKB_CACHE_SIZE)
+		nc->skb_cache[nc->skb_count++] = skbs[--n];
+	local_unlock_nested_bh(&napi_alloc_cache.bh_lock);
+	local_bh_enable();
+
+	if (unlikely(n > 1))
+		kmem_cache_free_bulk(net_hotdata.skbuff_cache, n - 1, skbs + 1);
+
+	return skbs[0];
+}
+
+/* Get an skbuff_head from the per-CPU cache outside of NAPI as well, e.g.
+ * for tun/tap writes from process context. The cache is refilled in bulk
+ * and shared with NAPI, which also returns consumed heads to it. Callers
+ * that may sleep refill it with their own gfp mask instead of GFP_ATOMIC.
+ * Falls back to the slab where BHs can't be disabled or the refill fails.
+ */
+static struct sk_buff *skb_head_cache_get(gfp_t gfp_mask, int node)
+{
+	bool can_sleep = gfpflags_allow_blocking(gfp_mask);
+	struct sk_buff *skb;
+
+	if (likely(!in_hardirq() && !irqs_disabled() &&
+		   (node == NUMA_NO_NODE || node == numa_mem_id()))) {
+		local_bh_disable();
+		skb = napi_skb_cache_get(!can_sleep);
+		local_bh_enable();
+		if (likely(skb))
+			return skb;
+
+		if (can_sleep) {
+			skb = skb_head_cache_refill(gfp_mask);
+			if (likely(skb))
+				return skb;
+		}
+	}
+
+	return kmem_cache_alloc_node(net_hotdata.skbuff_cache,
+				     gfp_mask & ~GFP_DMA, node);
+}
+
 static inline void __finalize_skb_around(struct sk_buff *skb, void *data,
 					 unsigned int size)
 {
@@ -420,8 +485,7 @@ struct sk_buff *slab_build_skb(void *data)
 	struct sk_buff *skb;
 	unsigned int size;
 
-	skb = kmem_cache_alloc(net_hotdata.skbuff_cache,
-			       GFP_ATOMIC | __GFP_NOWARN);
+	skb = skb_head_cache_get(GFP_ATOMIC | __GFP_NOWARN, NUMA_NO_NODE);
 	if (unlikely(!skb))
 		return NULL;
 
@@ -472,8 +536,7 @@ struct sk_buff *__build_skb(void *data, unsigned int frag_size)
 {
 	struct sk_buff *skb;
 
-	skb = kmem_cache_alloc(net_hotdata.skbuff_cache,
-			       GFP_ATOMIC | __GFP_NOWARN);
+	skb = skb_head_cache_get(GFP_ATOMIC | __GFP_NOWARN, NUMA_NO_NODE);
 	if (unlikely(!skb))
 		return NULL;
 
@@ -534,7 +597,7 @@ static struct sk_buff *__napi_build_skb(void *data, unsigned int frag_size)
 {
 	struct sk_buff *skb;
 
-	skb = napi_skb_cache_get();
+	skb = napi_skb_cache_get(true);
 	if (unlikely(!skb))
 		return NULL;
 
@@ -663,7 +726,9 @@ struct sk_buff *__alloc_skb(unsigned int size, gfp_t gfp_mask,
 	/* Get the HEAD */
 	if ((flags & (SKB_ALLOC_FCLONE | SKB_ALLOC_NAPI)) == SKB_ALLOC_NAPI &&
 	    likely(node == NUMA_NO_NODE || node == numa_mem_id()))
-		skb = napi_skb_cache_get();
+		skb = napi_skb_cache_get(true);
+	else if (!(flags & SKB_ALLOC_FCLONE))
+		skb = skb_head_cache_get(gfp_mask, node);
 	else
 		skb = kmem_cache_alloc_node(cache, gfp_mask & ~GFP_DMA, node);
 	if (unlikely(!skb))
@@ -1040,6 +1105,32 @@ bool napi_pp_put_page(netmem_ref netmem)
 EXPORT_SYMBOL(napi_pp_put_page);
 #endif
 
+/* Frag references on a net_iov, see get_netmem().  A page pool net_iov is
+ * refcounted like a page pool page, any other net_iov, e.g. one sent from
+ * a devmem TX binding, holds on to its binding.
+ */
+void __get_netmem_iov(netmem_ref netmem)
+{
+	struct net_iov *niov = netmem_to_net_iov(netmem);
+
+	if (niov->pp)
+		atomic_long_inc(&niov->pp_ref_count);
+	else
+		net_devmem_get_net_iov(niov);
+}
+EXPORT_SYMBOL(__get_netmem_iov);
+
+void __put_netmem_iov(netmem_ref netmem)
+{
+	struct net_iov *niov = netmem_to_net_iov(netmem);
+
+	if (niov->pp)
+		page_pool_put_full_netmem(niov->pp, netmem, false);
+	else
+		net_devmem_put_net_iov(niov);
+}
+EXPORT_SYMBOL(__put_netmem_iov);
+
 static bool skb_pp_recycle(struct sk_buff *skb, void *data)
 {
 	if (!IS_ENABLED(CONFIG_PAGE_POOL) || !skb->pp_recycle)
@@ -1881,7 +1972,8 @@ EXPORT_SYMBOL_GPL(msg_zerocopy_ubuf_ops);
 
 int skb_zerocopy_iter_stream(struct sock *sk, struct sk_buff *skb,
 			     struct msghdr *msg, int len,
-			     struct ubuf_info *uarg)
+			     struct ubuf_info *uarg,
+			     struct net_devmem_dmabuf_binding *binding)
 {
 	int err, orig_len = skb->len;
 
@@ -1900,7 +1992,8 @@ int skb_zerocopy_iter_stream(struct sock *sk, struct sk_buff *skb,
 			return -EEXIST;
 	}
 
-	err = __zerocopy_sg_from_iter(msg, sk, skb, &msg->msg_iter, len);
+	err = __zerocopy_sg_from_iter(msg, sk, skb, &msg->msg_iter, len,
+				      binding);
 	if (err == -EFAULT || (err == -EMSGSIZE && skb->len == orig_len)) {
 		struct sock *save_sk = skb->sk;
 
@@ -5101,14 +5194,18 @@ static void skb_extensions_init(void) {}
 
 void __init skb_init(void)
 {
-	net_hotdata.skbuff_cache = kmem_cache_create_usercopy("skbuff_head_cache",
+	struct kmem_cache_args skb_args = {
+		.useroffset	= offsetof(struct sk_buff, cb),
+		.usersize	= sizeof_field(struct sk_buff, cb),
+		/* skbs are often freed on another cpu than they were built */
+		.sheaf_capacity	= 32,
+	};
+
+	net_hotdata.skbuff_cache = kmem_cache_create("skbuff_head_cache",
 					      sizeof(struct sk_buff),
-					      0,
+					      &skb_args,
 					      SLAB_HWCACHE_ALIGN|SLAB_PANIC|
-						FLAG_SKB_NO_MERGE,
-					      offsetof(struct sk_buff, cb),
-					      sizeof_field(struct sk_buff, cb),
-					      NULL);
+						FLAG_SKB_NO_MERGE);
 	net_hotdata.skbuff_fclone_cache = kmem_cache_create("skbuff_fclone_cache",
 						sizeof(struct sk_buff_fclones),
 						0,
@@ -1554,6 +1554,9 @@ int sk_setsockopt(struct sock *sk, int level, int optname,
 			      (sk->sk_type == SOCK_DGRAM &&
 			       sk->sk_protocol == IPPROTO_UDP)))
 				ret = -EOPNOTSUPP;
+		} else if (sk->sk_family == PF_UNIX) {
+			if (sk->sk_type != SOCK_STREAM)
+				ret = -EOPNOTSUPP;
 		} else if (sk->sk_family != PF_RDS) {
 			ret = -EOPNOTSUPP;
 		}
@@ -2936,6 +2939,11 @@ int __sock_cmsg_send(struct sock *sk, struct cmsghdr *cmsg,
 			return -EINVAL;
 		sockc->transmit_time = get_unaligned((u64 *)CMSG_DATA(cmsg));
 		break;
+	case SCM_DEVMEM_DMABUF:
+		if (cmsg->cmsg_len != CMSG_LEN(sizeof(u32)))
+			return -EINVAL;
+		sockc->dmabuf_id = *(u32 *)CMSG_DATA(cmsg);
+		break;
 	/* SCM_RIGHTS and SCM_CREDENTIALS are semantically in SOL_UNIX. */
 	case SCM_RIGHTS:
 	case SCM_CREDENTIALS:
@@ -2966,12 +2974,49 @@ int sock_cmsg_send(struct sock *sk, struct msghdr *msg,
 }
 EXPORT_SYMBOL(sock_cmsg_send);
 
+/**
+ * proto_memory_pcpu_adjust - resize the per-cpu reserve of a protocol
+ * @proto: protocol, after a cpu folded its reserve into memory_allocated
+ *
+ * memory_allocated lags behind by up to a reserve per cpu. Far below
+ * sysctl_mem[0] that is harmless, so let each cpu keep up to its share of
+ * half the headroom, and fold less often. Near the limit, and under memory
+ * pressure, fall back to net.core.mem_pcpu_rsv so pressure is seen early
+ * and the reserves are returned in small batches.
+ *
+ * Every cpu reads per_cpu_fw_rsv on each charge, so the share is rounded
+ * down to a power of two: the headroom moves on every fold, the rounded
+ * reserve only when it halves or doubles, and the cache line isn't
+ * dirtied in between.
+ */
+void proto_memory_pcpu_adjust(struct proto *proto)
+{
+	long base = READ_ONCE(net_hotdata.sysctl_mem_pcpu_rsv);
+	long rsv = base, headroom;
+
+	if (proto->sysctl_mem && !proto_memory_pressure(proto)) {
+		headroom = READ_ONCE(proto->sysctl_mem[0]) -
+			   proto_memory_allocated(proto);
+		headroom /= 2 * num_online_cpus();
+		if (headroom > 0)
+			rsv = clamp((long)rounddown_pow_of_two(headroom), base,
+				    min(base * SK_MEMORY_PCPU_RESERVE_SCALE,
+					(long)INT_MAX));
+	}
+
+	if (rsv != READ_ONCE(proto->per_cpu_fw_rsv))
+		WRITE_ONCE(proto->per_cpu_fw_rsv, rsv);
+}
+EXPORT_SYMBOL(proto_memory_pcpu_adjust);
+
 static void sk_enter_memory_pressure(struct sock *sk)
 {
 	if (!sk->sk_prot->enter_memory_pressure)
 		return;
 
 	sk->sk_prot->enter_memory_pressure(sk);
+	/* Shrink the reserves right away rather than at the next fold */
+	proto_memory_pcpu_adjust(sk->sk_prot);
 }
 
 static void sk_leave_memory_pressure(struct sock *sk)
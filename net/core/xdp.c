@@ -693,6 +693,24 @@ struct xdp_frame *xdpf_clone(struct xdp_frame *xdpf)
 	return nxdpf;
 }
 
+/**
+ * xdpf_get - take another reference on the memory of an xdp_frame
+ * @xdpf: frame, which must pass xdpf_can_get()
+ *
+ * Lets the same frame be queued for transmit more than once; every holder
+ * returns it with xdp_return_frame() and the memory is released by the
+ * last one.  The frame must be treated as read-only while it is shared.
+ */
+void xdpf_get(struct xdp_frame *xdpf)
+{
+	struct page *page = virt_to_head_page(xdpf->data);
+
+	if (xdpf->mem.type == MEM_TYPE_PAGE_POOL)
+		page_pool_ref_page(page);
+	else
+		get_page(page);
+}
+
 __bpf_kfunc_start_defs();
 
 /**
@@ -20,6 +20,7 @@
 #include <linux/netlink.h>
 #include <linux/inetdevice.h>
 #include <linux/init.h>
+#include <linux/jhash.h>
 #include <linux/list.h>
 #include <linux/rcupdate.h>
 #include <linux/export.h>
@@ -79,6 +80,103 @@ unsigned int fib4_rules_seq_read(struct net *net)
 	return fib_rules_seq_read(net, AF_INET);
 }
 
+/* Per-CPU cache of rule lookup results, keyed by everything a rule or a
+ * table lookup looks at in the flow. Entries are valid for one route
+ * generation: any change to rules, routes or nexthops bumps rt_genid.
+ *
+ * A lookup tags its result with the generation it read before walking the
+ * rules. rt_genid_bump_ipv4() orders the change before the new generation
+ * and the generation is read with acquire semantics, so a lookup that saw
+ * the new generation also sees the change. A lookup racing with the bump
+ * may cache what it found under the old generation, which is never used
+ * again. Reading the current generation also means no fib_info the entry
+ * points to was unlinked since, so it is still alive within the RCU read
+ * side section implied by the disabled BHs.
+ */
+#define FIB4_LOOKUP_CACHE_SLOTS	32
+
+struct fib4_lookup_key {
+	__be32		daddr;
+	__be32		saddr;
+	int		oif;
+	int		iif;
+	int		l3mdev;
+	u32		mark;
+	kuid_t		uid;
+	unsigned int	flags;
+	__be64		tun_id;
+	__be16		dport;
+	__be16		sport;
+	u8		tos;
+	u8		scope;
+	u8		proto;
+	u8		flowi_flags;
+};
+
+struct fib4_lookup_cache_entry {
+	struct fib4_lookup_key	key;
+	int			genid;
+	bool			valid;
+	struct fib_result	res;
+};
+
+struct fib4_lookup_cache {
+	struct fib4_lookup_cache_entry	slots[FIB4_LOOKUP_CACHE_SLOTS];
+};
+
+static void fib4_lookup_cache_alloc(struct net *net)
+{
+	struct fib4_lookup_cache __percpu *cache;
+
+	if (net->ipv4.fib_lookup_cache)
+		return;
+
+	/* The cache is only an optimization, do without it on failure */
+	cache = alloc_percpu_gfp(struct fib4_lookup_cache,
+				 GFP_KERNEL_ACCOUNT | __GFP_NOWARN);
+	if (cache)
+		smp_store_release(&net->ipv4.fib_lookup_cache, cache);
+}
+
+static struct fib4_lookup_cache_entry *
+fib4_lookup_cache_slot(struct net *net, const struct flowi4 *flp,
+		       unsigned int flags, struct fib4_lookup_key *key)
+{
+	struct fib4_lookup_cache __percpu *cache;
+	u32 hash;
+
+	/* The slots are per-CPU, only use them with BHs disabled. Results
+	 * are only cached without a reference on the fib_info.
+	 */
+	if (!in_softirq() || !(flags & FIB_LOOKUP_NOREF))
+		return NULL;
+
+	cache = smp_load_acquire(&net->ipv4.fib_lookup_cache);
+	if (!cache)
+		return NULL;
+
+	/* The key is hashed and compared as a whole, padding included */
+	memset(key, 0, sizeof(*key));
+	key->daddr = flp->daddr;
+	key->saddr = flp->saddr;
+	key->oif = flp->flowi4_oif;
+	key->iif = flp->flowi4_iif;
+	key->l3mdev = flp->flowi4_l3mdev;
+	key->mark = flp->flowi4_mark;
+	key->uid = flp->flowi4_uid;
+	key->flags = flags;
+	key->tun_id = flp->flowi4_tun_key.tun_id;
+	key->dport = flp->fl4_dport;
+	key->sport = flp->fl4_sport;
+	key->tos = flp->flowi4_tos;
+	key->scope = flp->flowi4_scope;
+	key->proto = flp->flowi4_proto;
+	key->flowi_flags = flp->flowi4_flags;
+	hash = jhash2((const u32 *)key, sizeof(*key) / sizeof(u32), 0);
+
+	return &this_cpu_ptr(cache)->slots[hash & (FIB4_LOOKUP_CACHE_SLOTS - 1)];
+}
+
 int __fib_lookup(struct net *net, struct flowi4 *flp,
 		 struct fib_result *res, unsigned int flags)
 {
@@ -86,11 +184,24 @@ int __fib_lookup(struct net *net, struct flowi4 *flp,
 		.result = res,
 		.flags = flags,
 	};
-	int err;
+	struct fib4_lookup_cache_entry *slot;
+	struct fib4_lookup_key key;
+	int genid, err;
 
 	/* update flow if oif or iif point to device enslaved to l3mdev */
 	l3mdev_update_flow(net, flowi4_to_flowi(flp));
 
+	/* Sample the generation before the lookup it will validate, pairs
+	 * with the barrier in rt_genid_bump_ipv4().
+	 */
+	genid = atomic_read_acquire(&net->ipv4.rt_genid);
+	slot = fib4_lookup_cache_slot(net, flp, flags, &key);
+	if (slot && slot->valid && slot->genid == genid &&
+	    !memcmp(&slot->key, &key, sizeof(key))) {
+		*res = slot->res;
+		return 0;
+	}
+
 	err = fib_rules_lookup(net->ipv4.rules_ops, flowi4_to_flowi(flp), 0, &arg);
 #ifdef CONFIG_IP_ROUTE_CLASSID
 	if (arg.rule)
@@ -102,6 +213,13 @@ int __fib_lookup(struct net *net, struct flowi4 *flp,
 	if (err == -ESRCH)
 		err = -ENETUNREACH;
 
+	if (!err && slot) {
+		slot->key = key;
+		slot->genid = genid;
+		slot->res = *res;
+		slot->valid = true;
+	}
+
 	return err;
 }
 EXPORT_SYMBOL_GPL(__fib_lookup);
@@ -306,6 +424,7 @@ static int fib4_rule_configure(struct fib_rule *rule, struct sk_buff *skb,
 	rule4->dst_len = frh->dst_len;
 	rule4->dstmask = inet_make_mask(rule4->dst_len);
 
+	fib4_lookup_cache_alloc(net);
 	net->ipv4.fib_has_custom_rules = true;
 
 	err = 0;
@@ -327,6 +446,7 @@ static int fib4_rule_delete(struct fib_rule *rule)
 	if (((struct fib4_rule *)rule)->tclassid)
 		atomic_dec(&net->ipv4.fib_num_tclassid_users);
 #endif
+	fib4_lookup_cache_alloc(net);
 	net->ipv4.fib_has_custom_rules = true;
 
 	if (net->ipv4.fib_rules_require_fldissect &&
@@ -466,6 +586,7 @@ int __net_init fib4_rules_init(struct net *net)
 	if (err < 0)
 		goto fail;
 	net->ipv4.rules_ops = ops;
+	net->ipv4.fib_lookup_cache = NULL;
 	net->ipv4.fib_has_custom_rules = false;
 	net->ipv4.fib_rules_require_fldissect = 0;
 	return 0;
@@ -479,4 +600,5 @@ int __net_init fib4_rules_init(struct net *net)
 void __net_exit fib4_rules_exit(struct net *net)
 {
 	fib_rules_unregister(net->ipv4.rules_ops);
+	free_percpu(net->ipv4.fib_lookup_cache);
 }
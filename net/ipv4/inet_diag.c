@@ -1024,6 +1024,7 @@ void inet_diag_dump_icsk(struct inet_hashinfo *hashinfo, struct sk_buff *skb,
 	struct inet_diag_dump_data *cb_data = cb->data;
 	struct net *net = sock_net(skb->sk);
 	u32 idiag_states = r->idiag_states;
+	unsigned long e_start, e_end;
 	int i, num, s_i, s_num;
 	struct nlattr *bc;
 	struct sock *sk;
@@ -1031,6 +1032,17 @@ void inet_diag_dump_icsk(struct inet_hashinfo *hashinfo, struct sk_buff *skb,
 	bc = cb_data->inet_diag_nla_bc;
 	if (idiag_states & TCPF_SYN_RECV)
 		idiag_states |= TCPF_NEW_SYN_RECV;
+
+	/* Shards split the established hash, the first one also walks the
+	 * listening and bind hashes.
+	 */
+	netlink_dump_shard_range(cb, hashinfo->ehash_mask + 1, &e_start, &e_end);
+	if (cb->shard && cb->args[0] < 2) {
+		cb->args[0] = 2;
+		cb->args[1] = e_start;
+		cb->args[2] = 0;
+	}
+
 	s_i = cb->args[1];
 	s_num = num = cb->args[2];
 
@@ -1187,7 +1199,7 @@ void inet_diag_dump_icsk(struct inet_hashinfo *hashinfo, struct sk_buff *skb,
 	if (!(idiag_states & ~TCPF_LISTEN))
 		goto out;
 
-	for (i = s_i; i <= hashinfo->ehash_mask; i++) {
+	for (i = s_i; i < e_end; i++) {
 		struct inet_ehash_bucket *head = &hashinfo->ehash[i];
 		spinlock_t *lock = inet_ehash_lockp(hashinfo, i);
 		struct hlist_nulls_node *node;
@@ -1290,6 +1302,10 @@ static int __inet_diag_dump(struct sk_buff *skb, struct netlink_callback *cb,
 
 	protocol = inet_diag_get_protocol(r, cb_data);
 
+	/* Only inet_diag_dump_icsk() knows how to split a TCP dump */
+	if (cb->shard && protocol != IPPROTO_TCP)
+		return 0;
+
 again:
 	prev_min_dump_alloc = cb->min_dump_alloc;
 	handler = inet_diag_lock_handler(protocol);
@@ -1454,11 +1470,15 @@ static int inet_diag_handler_cmd(struct sk_buff *skb, struct nlmsghdr *h)
 
 	if (h->nlmsg_type == SOCK_DIAG_BY_FAMILY &&
 	    h->nlmsg_flags & NLM_F_DUMP) {
+		const struct inet_diag_req_v2 *r = nlmsg_data(h);
 		struct netlink_dump_control c = {
 			.start = inet_diag_dump_start,
 			.done = inet_diag_dump_done,
 			.dump = inet_diag_dump,
 		};
+
+		if (r->sdiag_protocol == IPPROTO_TCP)
+			c.nr_shards = num_online_cpus();
 		return netlink_dump_start(net->diag_nlsk, skb, h, &c);
 	}
 
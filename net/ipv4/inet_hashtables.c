@@ -76,7 +76,7 @@ struct inet_bind_bucket *inet_bind_bucket_create(struct kmem_cache *cachep,
 		tb->fastreuse = 0;
 		tb->fastreuseport = 0;
 		INIT_HLIST_HEAD(&tb->bhash2);
-		hlist_add_head(&tb->node, &head->chain);
+		hlist_add_head_rcu(&tb->node, &head->chain);
 	}
 	return tb;
 }
@@ -87,7 +87,8 @@ struct inet_bind_bucket *inet_bind_bucket_create(struct kmem_cache *cachep,
 void inet_bind_bucket_destroy(struct kmem_cache *cachep, struct inet_bind_bucket *tb)
 {
 	if (hlist_empty(&tb->bhash2)) {
-		__hlist_del(&tb->node);
+		/* The cache is SLAB_TYPESAFE_BY_RCU for __inet_hash_connect() */
+		hlist_del_rcu(&tb->node);
 		kmem_cache_free(cachep, tb);
 	}
 }
@@ -488,6 +489,119 @@ void sock_edemux(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(sock_edemux);
 
+/* Per-CPU cache of recent established TCP lookups.
+ *
+ * With RFS, a flow is looked up on the same CPU over and over, while the
+ * ehash chain it sits on is long out of the cache with millions of flows.
+ * A slot holds a reference on its socket, and is dropped again as soon as
+ * the socket leaves the ehash: the CPU which owns the slot is recorded in
+ * sk->sk_ehash_cache_cpu, so a socket is cached on one CPU at most.
+ *
+ * Readers don't take the reference of the slot, but validate the socket
+ * under RCU like an ehash walk, as a slot may be cleared concurrently.
+ */
+#define INET_EHASH_CACHE_SLOTS	256
+
+static DEFINE_PER_CPU(struct sock *[INET_EHASH_CACHE_SLOTS], inet_ehash_cache);
+static DEFINE_STATIC_KEY_FALSE(inet_ehash_cache_enabled);
+static DEFINE_MUTEX(inet_ehash_cache_mutex);
+
+static struct sock **inet_ehash_cache_slot(int cpu, unsigned int hash)
+{
+	return per_cpu_ptr(&inet_ehash_cache[hash % INET_EHASH_CACHE_SLOTS],
+			   cpu);
+}
+
+/* Drop the reference of a socket taken out of the slot of @cpu */
+static void inet_ehash_cache_release(struct sock *sk, int cpu)
+{
+	cmpxchg(&sk->sk_ehash_cache_cpu, cpu + 1, 0);
+	sock_put(sk);
+}
+
+static struct sock *inet_ehash_cache_lookup(const struct net *net,
+					    unsigned int hash,
+					    const __addrpair acookie,
+					    const __portpair ports,
+					    const int dif, const int sdif)
+{
+	struct sock *sk;
+
+	sk = READ_ONCE(*inet_ehash_cache_slot(smp_processor_id(), hash));
+	if (sk && sk->sk_hash == hash &&
+	    inet_match(net, sk, acookie, ports, dif, sdif) &&
+	    refcount_inc_not_zero(&sk->sk_refcnt)) {
+		if (likely(inet_match(net, sk, acookie, ports, dif, sdif)))
+			return sk;
+		sock_gen_put(sk);
+	}
+
+	return NULL;
+}
+
+static void inet_ehash_cache_insert(struct sock *sk, unsigned int hash)
+{
+	int cpu = smp_processor_id();
+	struct sock *old;
+
+	if (!sk_fullsock(sk) || sk->sk_protocol != IPPROTO_TCP ||
+	    cmpxchg(&sk->sk_ehash_cache_cpu, 0, cpu + 1))
+		return;
+
+	sock_hold(sk);
+	/* Implies a full barrier before the sk_unhashed() test below, and
+	 * pairs with the one in inet_ehash_cache_evict().
+	 */
+	old = xchg(inet_ehash_cache_slot(cpu, hash), sk);
+	if (old)
+		inet_ehash_cache_release(old, cpu);
+
+	if (unlikely(sk_unhashed(sk)))
+		__inet_ehash_cache_evict(sk);
+}
+
+void __inet_ehash_cache_evict(struct sock *sk)
+{
+	int cpu = READ_ONCE(sk->sk_ehash_cache_cpu) - 1;
+
+	if (cpu < 0)
+		return;
+
+	if (cmpxchg(inet_ehash_cache_slot(cpu, sk->sk_hash), sk, NULL) == sk)
+		inet_ehash_cache_release(sk, cpu);
+}
+
+/* Enable or disable the cache, an emptied cache is left behind */
+void inet_ehash_cache_set(bool enable)
+{
+	struct sock *sk;
+	int cpu, i;
+
+	mutex_lock(&inet_ehash_cache_mutex);
+	if (enable == static_key_enabled(&inet_ehash_cache_enabled))
+		goto out;
+
+	if (enable) {
+		static_branch_enable(&inet_ehash_cache_enabled);
+		goto out;
+	}
+
+	static_branch_disable(&inet_ehash_cache_enabled);
+	/* Wait for lookups that may still insert */
+	synchronize_net();
+
+	for_each_possible_cpu(cpu) {
+		for (i = 0; i < INET_EHASH_CACHE_SLOTS; i++) {
+			sk = xchg(inet_ehash_cache_slot(cpu, i), NULL);
+			if (sk)
+				inet_ehash_cache_release(sk, cpu);
+		}
+		cond_resched();
+	}
+out:
+	mutex_unlock(&inet_ehash_cache_mutex);
+}
+
 struct sock *__inet_lookup_established(const struct net *net,
 				  struct inet_hashinfo *hashinfo,
 				  const __be32 saddr, const __be16 sport,
@@ -504,6 +618,22 @@ struct sock *__inet_lookup_established(const struct net *net,
 	unsigned int hash = inet_ehashfn(net, daddr, hnum, saddr, sport);
 	unsigned int slot = hash & hashinfo->ehash_mask;
 	struct inet_ehash_bucket *head = &hashinfo->ehash[slot];
+	bool cache = false;
+
+	/* Only used from BH context, which serializes the CPU's slots.
+	 * DCCP shares the lookup, its sockets are not cached.
+	 */
+	if (static_branch_unlikely(&inet_ehash_cache_enabled) &&
+	    in_softirq() && hashinfo == net->ipv4.tcp_death_row.hashinfo) {
+		sk = inet_ehash_cache_lookup(net, hash, acookie, ports,
+					     dif, sdif);
+		if (sk) {
+			__NET_INC_STATS(net, LINUX_MIB_TCPEHASHCACHEHIT);
+			return sk;
+		}
+		__NET_INC_STATS(net, LINUX_MIB_TCPEHASHCACHEMISS);
+		cache = true;
+	}
 
 begin:
 	sk_nulls_for_each_rcu(sk, node, &head->chain) {
@@ -517,6 +647,8 @@ struct sock *__inet_lookup_established(const struct net *net,
 				sock_gen_put(sk);
 				goto begin;
 			}
+			if (cache)
+				inet_ehash_cache_insert(sk, hash);
 			goto found;
 		}
 	}
@@ -556,6 +688,17 @@ static int __inet_check_established(struct inet_timewait_death_row *death_row,
 	const struct hlist_nulls_node *node;
 	struct inet_timewait_sock *tw = NULL;
 
+	/* When connecting to a busy destination, most ports are taken by
+	 * established sockets. Skip those without the bucket lock, BHs are
+	 * disabled so the walk is RCU protected.
+	 */
+	sk_nulls_for_each_rcu(sk2, node, &head->chain) {
+		if (sk2->sk_hash == hash &&
+		    READ_ONCE(sk2->sk_state) != TCP_TIME_WAIT &&
+		    inet_match(net, sk2, acookie, ports, dif, sdif))
+			return -EADDRNOTAVAIL;
+	}
+
 	spin_lock(lock);
 
 	sk_nulls_for_each(sk2, node, &head->chain) {
@@ -808,6 +951,7 @@ void inet_unhash(struct sock *sk)
 		__sk_nulls_del_node_init_rcu(sk);
 		sock_prot_inuse_add(sock_net(sk), sk->sk_prot, -1);
 		spin_unlock_bh(lock);
+		inet_ehash_cache_evict(sk);
 	}
 }
 EXPORT_SYMBOL_GPL(inet_unhash);
@@ -991,6 +1135,26 @@ EXPORT_SYMBOL_GPL(inet_bhash2_reset_saddr);
 #define INET_TABLE_PERTURB_SIZE (1 << CONFIG_INET_TABLE_PERTURB_ORDER)
 static u32 *table_perturb;
 
+/* Histogram of the ports probed by connect(), in netstat */
+static void __inet_hash_connect_probes(struct net *net, u32 probes)
+{
+	if (probes <= 1)
+		__NET_INC_STATS(net, LINUX_MIB_TCPCONNECTPROBES1);
+	else if (probes <= 16)
+		__NET_INC_STATS(net, LINUX_MIB_TCPCONNECTPROBES16);
+	else if (probes <= 256)
+		__NET_INC_STATS(net, LINUX_MIB_TCPCONNECTPROBES256);
+	else
+		__NET_INC_STATS(net, LINUX_MIB_TCPCONNECTPROBESMORE);
+}
+
+static void inet_hash_connect_probes(struct net *net, u32 probes)
+{
+	local_bh_disable();
+	__inet_hash_connect_probes(net, probes);
+	local_bh_enable();
+}
+
 int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		struct sock *sk, u64 port_offset,
 		int (*check_established)(struct inet_timewait_death_row *,
@@ -1005,6 +1169,7 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 	struct inet_bind_bucket *tb;
 	bool tb_created = false;
 	u32 remaining, offset;
+	u32 probes = 0;
 	int ret, i, low, high;
 	bool local_ports;
 	int step, l3mdev;
@@ -1044,10 +1209,30 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 	for (i = 0; i < remaining; i += step, port += step) {
 		if (unlikely(port >= high))
 			port -= remaining;
+		probes++;
 		if (inet_is_local_reserved_port(net, port))
 			continue;
 		head = &hinfo->bhash[inet_bhashfn(net, port,
 						  hinfo->bhash_size)];
+
+		/* Skip ports bound by bind() or listeners without taking the
+		 * lock. A bucket that is reused under us may mislead this
+		 * walk, but only into skipping a port or checking it again
+		 * under the lock.
+		 */
+		rcu_read_lock();
+		hlist_for_each_entry_rcu(tb, &head->chain, node) {
+			if (inet_bind_bucket_match(tb, net, port, l3mdev)) {
+				if (READ_ONCE(tb->fastreuse) >= 0 ||
+				    READ_ONCE(tb->fastreuseport) >= 0) {
+					rcu_read_unlock();
+					goto next_port_unlocked;
+				}
+				break;
+			}
+		}
+		rcu_read_unlock();
+
 		spin_lock_bh(&head->lock);
 
 		/* Does not bother with rcv_saddr checks, because
@@ -1078,6 +1263,7 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		goto ok;
 next_port:
 		spin_unlock_bh(&head->lock);
+next_port_unlocked:
 		cond_resched();
 	}
 
@@ -1086,9 +1272,12 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		if ((offset & 1) && remaining > 1)
 			goto other_parity_scan;
 	}
+	inet_hash_connect_probes(net, probes);
 	return -EADDRNOTAVAIL;
 
 ok:
+	__inet_hash_connect_probes(net, probes);
+
 	/* Find the corresponding tb2 bucket since we need to
 	 * add the socket to the bhash2 table as well
 	 */
@@ -1138,6 +1327,7 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 		spin_lock(lock);
 		__sk_nulls_del_node_init_rcu(sk);
 		spin_unlock(lock);
+		inet_ehash_cache_evict(sk);
 
 		sk->sk_hash = 0;
 		inet_sk(sk)->inet_sport = 0;
@@ -145,6 +145,7 @@ void inet_twsk_hashdance_schedule(struct inet_timewait_sock *tw,
 	/* Step 3: Remove SK from hash chain */
 	if (__sk_nulls_del_node_init_rcu(sk))
 		sock_prot_inuse_add(sock_net(sk), sk->sk_prot, -1);
+	inet_ehash_cache_evict(sk);
 
 
 	/* Ensure above writes are committed into memory before updating the
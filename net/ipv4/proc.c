@@ -305,6 +305,12 @@ static const struct snmp_mib snmp4_net_list[] = {
 	SNMP_MIB_ITEM("TCPAOKeyNotFound", LINUX_MIB_TCPAOKEYNOTFOUND),
 	SNMP_MIB_ITEM("TCPAOGood", LINUX_MIB_TCPAOGOOD),
 	SNMP_MIB_ITEM("TCPAODroppedIcmps", LINUX_MIB_TCPAODROPPEDICMPS),
+	SNMP_MIB_ITEM("TCPEhashCacheHit", LINUX_MIB_TCPEHASHCACHEHIT),
+	SNMP_MIB_ITEM("TCPEhashCacheMiss", LINUX_MIB_TCPEHASHCACHEMISS),
+	SNMP_MIB_ITEM("TCPConnectProbes1", LINUX_MIB_TCPCONNECTPROBES1),
+	SNMP_MIB_ITEM("TCPConnectProbes16", LINUX_MIB_TCPCONNECTPROBES16),
+	SNMP_MIB_ITEM("TCPConnectProbes256", LINUX_MIB_TCPCONNECTPROBES256),
+	SNMP_MIB_ITEM("TCPConnectProbesMore", LINUX_MIB_TCPCONNECTPROBESMORE),
 	SNMP_MIB_SENTINEL
 };
 
@@ -386,6 +386,20 @@ static int proc_tcp_available_ulp(const struct ctl_table *ctl,
 	return ret;
 }
 
+static int sysctl_tcp_ehash_cache;
+
+static int proc_tcp_ehash_cache(const struct ctl_table *table, int write,
+				void *buffer, size_t *lenp, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (!ret && write)
+		inet_ehash_cache_set(READ_ONCE(sysctl_tcp_ehash_cache));
+
+	return ret;
+}
+
 static int proc_tcp_ehash_entries(const struct ctl_table *table, int write,
 				  void *buffer, size_t *lenp, loff_t *ppos)
 {
@@ -564,6 +578,15 @@ static struct ctl_table ipv4_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec
 	},
+	{
+		.procname	= "tcp_ehash_cache",
+		.data		= &sysctl_tcp_ehash_cache,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_tcp_ehash_cache,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
 #ifdef CONFIG_NETLABEL
 	{
 		.procname	= "cipso_cache_enable",
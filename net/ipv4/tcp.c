@@ -1050,6 +1050,7 @@ int tcp_sendmsg_fastopen(struct sock *sk, struct msghdr *msg, int *copied,
 
 int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 {
+	struct net_devmem_dmabuf_binding *binding = NULL;
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct ubuf_info *uarg = NULL;
 	struct sk_buff *skb;
@@ -1062,6 +1063,15 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 
 	flags = msg->msg_flags;
 
+	sockcm_init(&sockc, sk);
+	if (msg->msg_controllen) {
+		err = sock_cmsg_send(sk, msg, &sockc);
+		if (unlikely(err)) {
+			err = -EINVAL;
+			goto out_err;
+		}
+	}
+
 	if ((flags & MSG_ZEROCOPY) && size) {
 		if (msg->msg_ubuf) {
 			uarg = msg->msg_ubuf;
@@ -1078,12 +1088,28 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 				zc = MSG_ZEROCOPY;
 			else
 				uarg_to_msgzc(uarg)->zerocopy = 0;
+
+			if (sockc.dmabuf_id) {
+				binding = net_devmem_get_binding(sk,
+								 sockc.dmabuf_id);
+				if (IS_ERR(binding)) {
+					err = PTR_ERR(binding);
+					binding = NULL;
+					goto out_err;
+				}
+			}
 		}
 	} else if (unlikely(msg->msg_flags & MSG_SPLICE_PAGES) && size) {
 		if (sk->sk_route_caps & NETIF_F_SG)
 			zc = MSG_SPLICE_PAGES;
 	}
 
+	/* Device memory can only be sent with MSG_ZEROCOPY */
+	if (sockc.dmabuf_id && (!binding || zc != MSG_ZEROCOPY)) {
+		err = -EINVAL;
+		goto out_err;
+	}
+
 	if (unlikely(flags & MSG_FASTOPEN ||
 		     inet_test_bit(DEFER_CONNECT, sk)) &&
 	    !tp->repair) {
@@ -1122,15 +1148,6 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 		/* 'common' sending to sendq */
 	}
 
-	sockcm_init(&sockc, sk);
-	if (msg->msg_controllen) {
-		err = sock_cmsg_send(sk, msg, &sockc);
-		if (unlikely(err)) {
-			err = -EINVAL;
-			goto out_err;
-		}
-	}
-
 	/* This should be in poll */
 	sk_clear_bit(SOCKWQ_ASYNC_NOSPACE, sk);
 
@@ -1151,7 +1168,9 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 		if (skb)
 			copy = size_goal - skb->len;
 
-		if (copy <= 0 || !tcp_skb_can_collapse_to(skb)) {
+		/* Device memory and host memory don't share an skb */
+		if (copy <= 0 || !tcp_skb_can_collapse_to(skb) ||
+		    skb_frags_readable(skb) == !!binding) {
 			bool first_skb;
 
 new_segment:
@@ -1247,7 +1266,8 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 					goto wait_for_space;
 			}
 
-			err = skb_zerocopy_iter_stream(sk, skb, msg, copy, uarg);
+			err = skb_zerocopy_iter_stream(sk, skb, msg, copy, uarg,
+						       binding);
 			if (err == -EMSGSIZE || err == -EEXIST) {
 				tcp_mark_push(tp, skb);
 				goto new_segment;
@@ -1328,6 +1348,8 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 	/* msg->msg_ubuf is pinned by the caller so we don't take extra refs */
 	if (uarg && !msg->msg_ubuf)
 		net_zcopy_put(uarg);
+	if (binding)
+		net_devmem_dmabuf_binding_put(binding);
 	return copied + copied_syn;
 
 do_error:
@@ -1339,6 +1361,8 @@ int tcp_sendmsg_locked(struct sock *sk, struct msghdr *msg, size_t size)
 	/* msg->msg_ubuf is pinned by the caller so we don't take extra refs */
 	if (uarg && !msg->msg_ubuf)
 		net_zcopy_put_abort(uarg, true);
+	if (binding)
+		net_devmem_dmabuf_binding_put(binding);
 	err = sk_stream_error(sk, flags, err);
 	/* make sure we wake any epoll edge trigger waiter */
 	if (unlikely(tcp_rtx_and_write_queues_empty(sk) && err == -EAGAIN)) {
@@ -1955,6 +1979,66 @@ static int tcp_zc_handle_leftover(struct tcp_zerocopy_receive *zc,
 	return zc->copybuf_len < 0 ? 0 : copylen;
 }
 
+/* Bytes from @offset in @skb up to its next mappable frag, 0 if none */
+static u32 tcp_zc_head_len(struct sk_buff *skb, u32 offset)
+{
+	u32 head = 0;
+	int i;
+
+	if (skb_has_frag_list(skb) || !skb_frags_readable(skb))
+		return 0;
+
+	if (offset < skb_headlen(skb)) {
+		head = skb_headlen(skb) - offset;
+		offset = 0;
+	} else {
+		offset -= skb_headlen(skb);
+	}
+
+	for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
+		const skb_frag_t *frag = &skb_shinfo(skb)->frags[i];
+		u32 size = skb_frag_size(frag);
+
+		if (offset >= size) {
+			offset -= size;
+			continue;
+		}
+		if (!offset && can_map_frag(frag))
+			return head;
+		head += size - offset;
+		offset = 0;
+	}
+	return 0;
+}
+
+/* With TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD, copy the unaligned data in
+ * front of the first mappable page into the copybuf, so that the pages
+ * behind it can be mapped by the same call.
+ */
+static int tcp_zc_copy_head(struct tcp_zerocopy_receive *zc,
+			    struct sock *sk, u32 *seq, s32 copybuf_len,
+			    struct scm_timestamping_internal *tss)
+{
+	struct sk_buff *skb;
+	u32 offset, head;
+
+	skb = tcp_recv_skb(sk, *seq, &offset);
+	if (!skb)
+		return 0;
+
+	head = tcp_zc_head_len(skb, offset);
+	if (!head || copybuf_len <= 0 || head > copybuf_len)
+		return 0;
+
+	if (TCP_SKB_CB(skb)->has_rxtstamp) {
+		tcp_update_recv_tstamps(skb, tss);
+		zc->msg_flags |= TCP_CMSG_TS;
+	}
+
+	zc->recv_skip_hint = head;
+	return tcp_copy_straggler_data(zc, skb, head, &offset, seq);
+}
+
 static int tcp_zerocopy_vm_insert_batch_error(struct vm_area_struct *vma,
 					      struct page **pending_pages,
 					      unsigned long pages_remaining,
@@ -2104,10 +2188,12 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	u32 seq = tp->copied_seq;
 	u32 total_bytes_to_map;
 	int inq = tcp_inq(sk);
+	int headlen = 0;
 	bool mmap_locked;
 	int ret;
 
 	zc->copybuf_len = 0;
+	zc->copybuf_head_len = 0;
 	zc->msg_flags = 0;
 
 	if (address & (PAGE_SIZE - 1) || address != zc->address)
@@ -2129,9 +2215,23 @@ static int tcp_zerocopy_receive(struct sock *sk,
 		return 0;
 	}
 
+	if (zc->flags & TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD) {
+		headlen = tcp_zc_copy_head(zc, sk, &seq, copybuf_len, tss);
+		if (headlen < 0)
+			return headlen;
+		/* The tail lands in the copybuf right behind the head */
+		zc->copybuf_address += headlen;
+		copybuf_len -= headlen;
+		inq -= headlen;
+	}
+
 	vma = find_tcp_vma(current->mm, address, &mmap_locked);
-	if (!vma)
-		return -EINVAL;
+	if (!vma) {
+		if (!headlen)
+			return -EINVAL;
+		ret = -EINVAL;
+		goto out_head;
+	}
 
 	vma_len = min_t(unsigned long, zc->length, vma->vm_end - address);
 	avail_len = min_t(u32, vma_len, inq);
@@ -2220,6 +2320,16 @@ static int tcp_zerocopy_receive(struct sock *sk,
 	if (!ret)
 		copylen = tcp_zc_handle_leftover(zc, sk, skb, &seq, copybuf_len, tss);
 
+out_head:
+	if (headlen) {
+		/* A failed tail copy doesn't undo the head, report the latter */
+		zc->copybuf_address -= headlen;
+		zc->copybuf_len = headlen + (copylen ? zc->copybuf_len : 0);
+		zc->copybuf_head_len = headlen;
+		copylen += headlen;
+		ret = 0;
+	}
+
 	if (length + copylen) {
 		WRITE_ONCE(tp->copied_seq, seq);
 		tcp_rcv_space_adjust(sk);
@@ -4574,7 +4684,12 @@ int do_tcp_getsockopt(struct sock *sk, int level,
 		}
 		if (copy_from_sockptr(&zc, optval, len))
 			return -EFAULT;
-		if (zc.reserved)
+		if (zc.reserved || zc.reserved2)
+			return -EINVAL;
+		/* The head length is needed to make sense of the copybuf */
+		if (zc.flags & TCP_RECEIVE_ZEROCOPY_FLAG_COPY_HEAD &&
+		    len < offsetofend(struct tcp_zerocopy_receive,
+				      copybuf_head_len))
 			return -EINVAL;
 		if (zc.msg_flags &  ~(TCP_VALID_ZC_MSG_FLAGS))
 			return -EINVAL;
@@ -5075,7 +5190,7 @@ void __init tcp_init(void)
 		kmem_cache_create("tcp_bind_bucket",
 				  sizeof(struct inet_bind_bucket), 0,
 				  SLAB_HWCACHE_ALIGN | SLAB_PANIC |
-				  SLAB_ACCOUNT,
+				  SLAB_ACCOUNT | SLAB_TYPESAFE_BY_RCU,
 				  NULL);
 	tcp_hashinfo.bind2_bucket_cachep =
 		kmem_cache_create("tcp_bind2_bucket",
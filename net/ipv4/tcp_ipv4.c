@@ -2002,6 +2002,36 @@ int tcp_v4_early_demux(struct sk_buff *skb)
 	return 0;
 }
 
+/* Whether @th can be coalesced into @thtail as far as options go. Runs of
+ * pure ACKs usually only differ in their timestamps, the newer ones can
+ * be carried over instead, so that tcp_ack() handles the run just once.
+ */
+static bool tcp_backlog_opts_match(const struct tcphdr *thtail,
+				   const struct tcphdr *th, bool pure_acks,
+				   bool *update_ts)
+{
+	unsigned int len = th->doff * 4 - sizeof(*th);
+	const __be32 *ptail = (const __be32 *)(thtail + 1);
+	const __be32 *ptr = (const __be32 *)(th + 1);
+
+	*update_ts = false;
+	if (!memcmp(ptail, ptr, len))
+		return true;
+
+	if (!pure_acks || len < TCPOLEN_TSTAMP_ALIGNED || *ptail != *ptr ||
+	    *ptr != htonl((TCPOPT_NOP << 24) | (TCPOPT_NOP << 16) |
+			  (TCPOPT_TIMESTAMP << 8) | TCPOLEN_TIMESTAMP))
+		return false;
+
+	/* Keep reordered ACKs apart, their TSval would move backwards */
+	if (before(ntohl(ptr[1]), ntohl(ptail[1])) ||
+	    memcmp(ptail + 3, ptr + 3, len - TCPOLEN_TSTAMP_ALIGNED))
+		return false;
+
+	*update_ts = true;
+	return true;
+}
+
 bool tcp_add_backlog(struct sock *sk, struct sk_buff *skb,
 		     enum skb_drop_reason *reason)
 {
@@ -2012,6 +2042,7 @@ bool tcp_add_backlog(struct sock *sk, struct sk_buff *skb,
 	struct sk_buff *tail;
 	unsigned int hdrlen;
 	bool fragstolen;
+	bool update_ts;
 	u32 gso_segs;
 	u32 gso_size;
 	u64 limit;
@@ -2058,7 +2089,9 @@ bool tcp_add_backlog(struct sock *sk, struct sk_buff *skb,
 	      TCP_SKB_CB(skb)->tcp_flags) & (TCPHDR_ECE | TCPHDR_CWR)) ||
 	    !tcp_skb_can_collapse_rx(tail, skb) ||
 	    thtail->doff != th->doff ||
-	    memcmp(thtail + 1, th + 1, hdrlen - sizeof(*th)))
+	    !tcp_backlog_opts_match(thtail, th,
+				    tail->len == hdrlen && skb->len == hdrlen,
+				    &update_ts))
 		goto no_coalesce;
 
 	__skb_pull(skb, hdrlen);
@@ -2077,6 +2110,10 @@ bool tcp_add_backlog(struct sock *sk, struct sk_buff *skb,
 		if (likely(!before(TCP_SKB_CB(skb)->ack_seq, TCP_SKB_CB(tail)->ack_seq))) {
 			TCP_SKB_CB(tail)->ack_seq = TCP_SKB_CB(skb)->ack_seq;
 			thtail->window = th->window;
+			if (update_ts)
+				memcpy((__be32 *)(thtail + 1) + 1,
+				       (const __be32 *)(th + 1) + 1,
+				       TCPOLEN_TSTAMP_ALIGNED - 4);
 		}
 
 		/* We have to update both TCP_SKB_CB(tail)->tcp_flags and
@@ -478,6 +478,39 @@ static struct sock *udp4_lib_lookup2(const struct net *net,
 	return result;
 }
 
+/* Set once the first socket is hashed in a hash4 table */
+static DEFINE_STATIC_KEY_FALSE(udp4_hash4_enabled);
+
+/* called with rcu_read_lock() */
+static struct sock *udp4_lib_lookup4(const struct net *net,
+				     __be32 saddr, __be16 sport,
+				     __be32 daddr, unsigned int hnum,
+				     int dif, int sdif,
+				     struct udp_table *udptable)
+{
+	const __portpair ports = INET_COMBINED_PORTS(sport, hnum);
+	INET_ADDR_COOKIE(acookie, saddr, daddr);
+	struct udp_hslot *hslot4;
+	struct udp_sock *up;
+	unsigned int hash4;
+	struct sock *sk;
+
+	hash4 = udp_ehashfn(net, daddr, hnum, saddr, sport);
+	hslot4 = udp_hashslot4(udptable, hash4);
+
+	hlist_for_each_entry_rcu(up, &hslot4->head, udp_lrpa_node) {
+		sk = (struct sock *)up;
+		if (up->udp_lrpa_hash == hash4 &&
+		    net_eq(sock_net(sk), net) &&
+		    sk->sk_portpair == ports &&
+		    sk->sk_addrpair == acookie &&
+		    udp_sk_bound_dev_eq(net, READ_ONCE(sk->sk_bound_dev_if),
+					dif, sdif))
+			return sk;
+	}
+	return NULL;
+}
+
 /* UDP is nearly always wildcards out the wazoo, it makes no sense to try
  * harder than this. -DaveM
  */
@@ -490,6 +523,14 @@ struct sock *__udp4_lib_lookup(const struct net *net, __be32 saddr,
 	struct udp_hslot *hslot2;
 	struct sock *result, *sk;
 
+	/* Connected sockets take precedence, find them in O(1) */
+	if (static_branch_unlikely(&udp4_hash4_enabled)) {
+		result = udp4_lib_lookup4(net, saddr, sport, daddr, hnum,
+					  dif, sdif, udptable);
+		if (result)
+			return result;
+	}
+
 	hash2 = ipv4_portaddr_hash(net, daddr, hnum);
 	slot2 = hash2 & udptable->mask;
 	hslot2 = &udptable->hash2[slot2];
@@ -1927,6 +1968,60 @@ int udp_pre_connect(struct sock *sk, struct sockaddr *uaddr, int addr_len)
 }
 EXPORT_SYMBOL(udp_pre_connect);
 
+static void udp_unhash4(struct udp_table *udptable, struct sock *sk)
+{
+	struct udp_hslot *hslot4;
+
+	if (!udp_hashed4(sk))
+		return;
+
+	hslot4 = udp_hashslot4(udptable, udp_sk(sk)->udp_lrpa_hash);
+	spin_lock_bh(&hslot4->lock);
+	hlist_del_init_rcu(&udp_sk(sk)->udp_lrpa_node);
+	hslot4->count--;
+	spin_unlock_bh(&hslot4->lock);
+}
+
+/* Hash a connected socket in hash4, called with the socket lock held */
+static void udp4_hash4(struct sock *sk)
+{
+	struct udp_table *udptable = udp_get_table_prot(sk);
+	struct inet_sock *inet = inet_sk(sk);
+	struct udp_hslot *hslot4;
+	unsigned int hash4;
+
+	udp_unhash4(udptable, sk);
+
+	if (!sk_hashed(sk) || !inet->inet_rcv_saddr)
+		return;
+
+	if (!static_branch_unlikely(&udp4_hash4_enabled))
+		static_branch_enable(&udp4_hash4_enabled);
+
+	hash4 = udp_ehashfn(sock_net(sk), inet->inet_rcv_saddr, inet->inet_num,
+			    inet->inet_daddr, inet->inet_dport);
+	hslot4 = udp_hashslot4(udptable, hash4);
+
+	spin_lock_bh(&hslot4->lock);
+	udp_sk(sk)->udp_lrpa_hash = hash4;
+	hlist_add_head_rcu(&udp_sk(sk)->udp_lrpa_node, &hslot4->head);
+	hslot4->count++;
+	spin_unlock_bh(&hslot4->lock);
+}
+
+int udp_connect(struct sock *sk, struct sockaddr *uaddr, int addr_len)
+{
+	int res;
+
+	lock_sock(sk);
+	res = __ip4_datagram_connect(sk, uaddr, addr_len);
+	if (!res)
+		udp4_hash4(sk);
+	release_sock(sk);
+	return res;
+}
+EXPORT_SYMBOL(udp_connect);
+
 int __udp_disconnect(struct sock *sk, int flags)
 {
 	struct inet_sock *inet = inet_sk(sk);
@@ -1934,6 +2029,7 @@ int __udp_disconnect(struct sock *sk, int flags)
 	 *	1003.1g - break association.
 	 */
 
+	udp_unhash4(udp_get_table_prot(sk), sk);
 	sk->sk_state = TCP_CLOSE;
 	inet->inet_daddr = 0;
 	inet->inet_dport = 0;
@@ -1988,6 +2084,8 @@ void udp_lib_unhash(struct sock *sk)
 			spin_unlock(&hslot2->lock);
 		}
 		spin_unlock_bh(&hslot->lock);
+
+		udp_unhash4(udptable, sk);
 	}
 }
 EXPORT_SYMBOL(udp_lib_unhash);
@@ -2932,7 +3030,7 @@ struct proto udp_prot = {
 	.owner			= THIS_MODULE,
 	.close			= udp_lib_close,
 	.pre_connect		= udp_pre_connect,
-	.connect		= ip4_datagram_connect,
+	.connect		= udp_connect,
 	.disconnect		= udp_disconnect,
 	.ioctl			= udp_ioctl,
 	.init			= udp_init_sock,
@@ -3434,7 +3532,7 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 	unsigned int i;
 
 	table->hash = alloc_large_system_hash(name,
-					      2 * sizeof(struct udp_hslot),
+					      3 * sizeof(struct udp_hslot),
 					      uhash_entries,
 					      21, /* one slot per 2 MB */
 					      0,
@@ -3444,6 +3542,7 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 					      UDP_HTABLE_SIZE_MAX);
 
 	table->hash2 = table->hash + (table->mask + 1);
+	table->hash4 = table->hash2 + (table->mask + 1);
 	for (i = 0; i <= table->mask; i++) {
 		INIT_HLIST_HEAD(&table->hash[i].head);
 		table->hash[i].count = 0;
@@ -3454,6 +3553,11 @@ void __init udp_table_init(struct udp_table *table, const char *name)
 		table->hash2[i].count = 0;
 		spin_lock_init(&table->hash2[i].lock);
 	}
+	for (i = 0; i <= table->mask; i++) {
+		INIT_HLIST_HEAD(&table->hash4[i].head);
+		table->hash4[i].count = 0;
+		spin_lock_init(&table->hash4[i].lock);
+	}
 }
 
 u32 udp_flow_hashrnd(void)
@@ -3485,12 +3589,13 @@ static struct udp_table __net_init *udp_pernet_table_alloc(unsigned int hash_ent
 	if (!udptable)
 		goto out;
 
-	udptable->hash = vmalloc_huge(hash_entries * 2 * sizeof(struct udp_hslot),
+	udptable->hash = vmalloc_huge(hash_entries * 3 * sizeof(struct udp_hslot),
 				      GFP_KERNEL_ACCOUNT);
 	if (!udptable->hash)
 		goto free_table;
 
 	udptable->hash2 = udptable->hash + hash_entries;
+	udptable->hash4 = udptable->hash2 + hash_entries;
 	udptable->mask = hash_entries - 1;
 	udptable->log = ilog2(hash_entries);
 
@@ -3502,6 +3607,10 @@ static struct udp_table __net_init *udp_pernet_table_alloc(unsigned int hash_ent
 		INIT_HLIST_HEAD(&udptable->hash2[i].head);
 		udptable->hash2[i].count = 0;
 		spin_lock_init(&udptable->hash2[i].lock);
+
+		INIT_HLIST_HEAD(&udptable->hash4[i].head);
+		udptable->hash4[i].count = 0;
+		spin_lock_init(&udptable->hash4[i].lock);
 	}
 
 	return udptable;
@@ -1498,6 +1498,100 @@ struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk)
 	return ssk;
 }
 
+/* Smoothed delivery rate of the subflow in bytes per second, fed by the
+ * TCP rate samples; the pacing rate stands in until the first sample.
+ */
+static u64 mptcp_subflow_delivery_rate(struct mptcp_subflow_context *subflow)
+{
+	struct sock *ssk = mptcp_subflow_tcp_sock(subflow);
+	const struct tcp_sock *tp = tcp_sk(ssk);
+	u32 delivered = READ_ONCE(tp->delivered);
+	u32 interval = READ_ONCE(tp->rate_interval_us);
+	u64 sample;
+
+	if (delivered != subflow->delivery_seen && interval) {
+		subflow->delivery_seen = delivered;
+		sample = div_u64((u64)READ_ONCE(tp->rate_delivered) *
+				 READ_ONCE(tp->mss_cache) * USEC_PER_SEC,
+				 interval);
+		subflow->delivery_rate = subflow->delivery_rate ?
+			(subflow->delivery_rate * 7 + sample) >> 3 : sample;
+	}
+
+	return subflow->delivery_rate ? : READ_ONCE(ssk->sk_pacing_rate);
+}
+
+/* Like mptcp_subflow_get_send(), but rank the subflows by the estimated
+ * time for new data to reach the peer: the time to drain the data queued
+ * at the delivery rate, plus half the srtt and the rtt deviation. The
+ * burst is then sized to the bandwidth-delay product of the picked link.
+ */
+struct sock *mptcp_subflow_get_send_rate(struct mptcp_sock *msk)
+{
+	struct subflow_send_info send_info[SSK_MODE_MAX];
+	struct mptcp_subflow_context *subflow;
+	struct sock *sk = (struct sock *)msk;
+	u32 srtt, rttvar, burst;
+	int i, nr_active = 0;
+	const struct tcp_sock *tp;
+	u64 rate, tx_time;
+	struct sock *ssk;
+	s64 room;
+	long tout = 0;
+
+	for (i = 0; i < SSK_MODE_MAX; ++i) {
+		send_info[i].ssk = NULL;
+		send_info[i].linger_time = -1;
+	}
+
+	mptcp_for_each_subflow(msk, subflow) {
+		bool backup = subflow->backup || subflow->request_bkup;
+
+		trace_mptcp_subflow_get_send(subflow);
+		ssk = mptcp_subflow_tcp_sock(subflow);
+		if (!mptcp_subflow_active(subflow))
+			continue;
+
+		tout = max(tout, mptcp_timeout_from_subflow(subflow));
+		nr_active += !backup;
+		rate = mptcp_subflow_delivery_rate(subflow);
+		if (!rate)
+			continue;
+
+		tp = tcp_sk(ssk);
+		srtt = READ_ONCE(tp->srtt_us) >> 3;
+		rttvar = READ_ONCE(tp->mdev_us) >> 2;
+		tx_time = div64_u64((u64)READ_ONCE(ssk->sk_wmem_queued) *
+				    USEC_PER_SEC, rate) + srtt / 2 + rttvar;
+		if (tx_time < send_info[backup].linger_time) {
+			send_info[backup].ssk = ssk;
+			send_info[backup].linger_time = tx_time;
+		}
+	}
+	__mptcp_set_timeout(sk, tout);
+
+	/* pick the best backup if no other subflow is active */
+	if (!nr_active)
+		send_info[SSK_MODE_ACTIVE].ssk = send_info[SSK_MODE_BACKUP].ssk;
+
+	ssk = send_info[SSK_MODE_ACTIVE].ssk;
+	if (!ssk || !sk_stream_memory_free(ssk))
+		return NULL;
+
+	room = mptcp_wnd_end(msk) - msk->snd_nxt;
+	if (room <= 0)
+		return ssk;
+	burst = min_t(s64, room, INT_MAX);
+
+	tp = tcp_sk(ssk);
+	rate = mptcp_subflow_delivery_rate(mptcp_subflow_ctx(ssk));
+	srtt = READ_ONCE(tp->srtt_us) >> 3;
+	burst = clamp_t(u64, mul_u64_u32_div(rate, srtt, USEC_PER_SEC),
+			min(READ_ONCE(tp->mss_cache), burst), burst);
+	msk->snd_burst = burst;
+	return ssk;
+}
+
 static void mptcp_push_release(struct sock *ssk, struct mptcp_sendmsg_info *info)
 {
 	tcp_push(ssk, 0, info->mss_now, tcp_sk(ssk)->nonagle, info->size_goal);
@@ -496,6 +496,8 @@ struct mptcp_subflow_context {
 	struct_group(reset,
 
 	unsigned long avg_pacing_rate; /* protected by msk socket lock */
+	u64	delivery_rate;	/* bytes/s, for the "rate" scheduler */
+	u32	delivery_seen;	/* tcp delivered count of the last sample */
 	u64	local_key;
 	u64	remote_key;
 	u64	idsn;
@@ -749,6 +751,7 @@ void mptcp_release_sched(struct mptcp_sock *msk);
 void mptcp_subflow_set_scheduled(struct mptcp_subflow_context *subflow,
 				 bool scheduled);
 struct sock *mptcp_subflow_get_send(struct mptcp_sock *msk);
+struct sock *mptcp_subflow_get_send_rate(struct mptcp_sock *msk);
 struct sock *mptcp_subflow_get_retrans(struct mptcp_sock *msk);
 int mptcp_sched_get_send(struct mptcp_sock *msk);
 int mptcp_sched_get_retrans(struct mptcp_sock *msk);
@@ -36,6 +36,60 @@ static struct mptcp_sched_ops mptcp_sched_default = {
 	.owner		= THIS_MODULE,
 };
 
+static int mptcp_sched_rate_get_subflow(struct mptcp_sock *msk,
+					struct mptcp_sched_data *data)
+{
+	struct sock *ssk;
+
+	ssk = data->reinject ? mptcp_subflow_get_retrans(msk) :
+			       mptcp_subflow_get_send_rate(msk);
+	if (!ssk)
+		return -EINVAL;
+
+	mptcp_subflow_set_scheduled(mptcp_subflow_ctx(ssk), true);
+	return 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_rate = {
+	.get_subflow	= mptcp_sched_rate_get_subflow,
+	.name		= "rate",
+	.owner		= THIS_MODULE,
+};
+
+/* As "rate", but retransmit the head of the rtx queue on all the usable
+ * non backup subflows at once, so that the fastest link recovers it.
+ */
+static int mptcp_sched_redundant_get_subflow(struct mptcp_sock *msk,
+					     struct mptcp_sched_data *data)
+{
+	struct mptcp_subflow_context *subflow;
+	struct sock *ssk;
+
+	if (!data->reinject)
+		return mptcp_sched_rate_get_subflow(msk, data);
+
+	ssk = mptcp_subflow_get_retrans(msk);
+	if (!ssk)
+		return -EINVAL;
+
+	mptcp_for_each_subflow(msk, subflow) {
+		struct sock *tcp = mptcp_subflow_tcp_sock(subflow);
+
+		if (tcp == ssk ||
+		    (__mptcp_subflow_active(subflow) && !subflow->stale &&
+		     !subflow->backup && !subflow->request_bkup &&
+		     sk_stream_memory_free(tcp)))
+			mptcp_subflow_set_scheduled(subflow, true);
+	}
+	return 0;
+}
+
+static struct mptcp_sched_ops mptcp_sched_redundant = {
+	.get_subflow	= mptcp_sched_redundant_get_subflow,
+	.name		= "redundant",
+	.owner		= THIS_MODULE,
+};
+
 /* Must be called with rcu read lock held */
 struct mptcp_sched_ops *mptcp_sched_find(const char *name)
 {
@@ -92,7 +146,8 @@ int mptcp_register_scheduler(struct mptcp_sched_ops *sched)
 
 void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched)
 {
-	if (sched == &mptcp_sched_default)
+	if (sched == &mptcp_sched_default || sched == &mptcp_sched_rate ||
+	    sched == &mptcp_sched_redundant)
 		return;
 
 	spin_lock(&mptcp_sched_list_lock);
@@ -103,6 +158,8 @@ void mptcp_unregister_scheduler(struct mptcp_sched_ops *sched)
 void mptcp_sched_init(void)
 {
 	mptcp_register_scheduler(&mptcp_sched_default);
+	mptcp_register_scheduler(&mptcp_sched_rate);
+	mptcp_register_scheduler(&mptcp_sched_redundant);
 }
 
 int mptcp_init_sched(struct mptcp_sock *msk,
@@ -13,6 +13,7 @@
 #include <linux/skbuff.h>
 #include <linux/spinlock.h>
 #include <linux/rculist.h>
+#include <linux/percpu.h>
 #include <net/netlink.h>
 #include <net/net_namespace.h>
 #include <net/netns/generic.h>
@@ -397,6 +398,109 @@ ip_set_comment_free(struct ip_set *set, void *ptr)
 	rcu_assign_pointer(comment->c, NULL);
 }
 
+static size_t
+ip_set_percpu_counter_size(void)
+{
+	return sizeof(struct ip_set_counter_pcpu) +
+	       nr_cpu_ids * sizeof(struct ip_set_counter_cpu);
+}
+
+static void
+ip_set_percpu_counter_sum(const struct ip_set_counter_pcpu *p,
+			  u64 *bytes, u64 *packets)
+{
+	int cpu;
+
+	*bytes = 0;
+	*packets = 0;
+	if (!p)
+		return;
+	for_each_possible_cpu(cpu) {
+		const struct ip_set_counter_cpu *c = per_cpu_ptr(p->cpu, cpu);
+		unsigned int start;
+		u64 b, pkts;
+
+		do {
+			start = u64_stats_fetch_begin(&c->syncp);
+			b = u64_stats_read(&c->bytes);
+			pkts = u64_stats_read(&c->packets);
+		} while (u64_stats_fetch_retry(&c->syncp, start));
+		*bytes += b;
+		*packets += pkts;
+	}
+}
+
+static void
+ip_set_percpu_counter_free_rcu(struct rcu_head *head)
+{
+	struct ip_set_counter_pcpu *p =
+		container_of(head, struct ip_set_counter_pcpu, rcu);
+
+	free_percpu(p->cpu);
+	kfree(p);
+}
+
+/* Called with the same protection as ip_set_init_comment().
+ * Packets may be matching against the element concurrently, so the
+ * counters are never reset in place: new values come with a new
+ * per-CPU area and the old one is freed after a grace period.
+ */
+void
+ip_set_init_percpu_counter(struct ip_set *set, struct ip_set_counter *counter,
+			   const struct ip_set_ext *ext)
+{
+	struct ip_set_counter_pcpu *old, *p;
+	struct ip_set_counter_cpu *c;
+	u64 bytes, packets;
+	int cpu;
+
+	old = rcu_dereference_protected(counter->pcpu, 1);
+	if (old && ext->bytes == ULLONG_MAX && ext->packets == ULLONG_MAX)
+		return;
+
+	p = kmalloc(sizeof(*p), GFP_ATOMIC);
+	if (unlikely(!p))
+		return;
+	p->cpu = alloc_percpu_gfp(struct ip_set_counter_cpu, GFP_ATOMIC);
+	if (unlikely(!p->cpu)) {
+		kfree(p);
+		return;
+	}
+	for_each_possible_cpu(cpu)
+		u64_stats_init(&per_cpu_ptr(p->cpu, cpu)->syncp);
+
+	/* Not visible yet, any CPU's slot can hold the initial values */
+	ip_set_percpu_counter_sum(old, &bytes, &packets);
+	c = per_cpu_ptr(p->cpu, raw_smp_processor_id());
+	u64_stats_set(&c->bytes, ext->bytes != ULLONG_MAX ? ext->bytes : bytes);
+	u64_stats_set(&c->packets,
+		      ext->packets != ULLONG_MAX ? ext->packets : packets);
+
+	rcu_assign_pointer(counter->pcpu, p);
+	if (old)
+		call_rcu(&old->rcu, ip_set_percpu_counter_free_rcu);
+	else
+		set->ext_size += ip_set_percpu_counter_size();
+}
+EXPORT_SYMBOL_GPL(ip_set_init_percpu_counter);
+
+/* Called from uadd/udel, flush or the garbage collectors protected
+ * by the set spinlock, for sets with per-CPU counters only.
+ */
+static void
+ip_set_percpu_counter_free(struct ip_set *set, void *ptr)
+{
+	struct ip_set_counter *counter = ptr;
+	struct ip_set_counter_pcpu *p;
+
+	p = rcu_dereference_protected(counter->pcpu, 1);
+	if (unlikely(!p))
+		return;
+	set->ext_size -= ip_set_percpu_counter_size();
+	rcu_assign_pointer(counter->pcpu, NULL);
+	call_rcu(&p->rcu, ip_set_percpu_counter_free_rcu);
+}
+
 typedef void (*destroyer)(struct ip_set *, void *);
 /* ipset data extension types, in size order */
 
@@ -406,6 +510,7 @@ const struct ip_set_ext_type ip_set_extensions[] = {
 		.flag	= IPSET_FLAG_WITH_COUNTERS,
 		.len	= sizeof(struct ip_set_counter),
 		.align	= __alignof__(struct ip_set_counter),
+		.destroy = ip_set_percpu_counter_free,
 	},
 	[IPSET_EXT_ID_TIMEOUT] = {
 		.type	= IPSET_EXT_TIMEOUT,
@@ -459,6 +564,11 @@ ip_set_elem_len(struct ip_set *set, struct nlattr *tb[], size_t len,
 		set->extensions |= ip_set_extensions[id].type;
 		len += ip_set_extensions[id].len;
 	}
+	if (SET_WITH_COUNTER(set) &&
+	    (cadt_flags & IPSET_FLAG_WITH_PERCPU_COUNTERS)) {
+		set->flags |= IPSET_CREATE_FLAG_PERCPU_COUNTERS;
+		set->extensions |= IPSET_EXT_DESTROY;
+	}
 	return ALIGN(len, align);
 }
 EXPORT_SYMBOL_GPL(ip_set_elem_len);
@@ -532,14 +642,31 @@ ip_set_get_packets(const struct ip_set_counter *counter)
 	return (u64)atomic64_read(&(counter)->packets);
 }
 
+static void
+ip_set_get_counter(const struct ip_set *set,
+		   const struct ip_set_counter *counter,
+		   u64 *bytes, u64 *packets)
+{
+	if (SET_WITH_PERCPU_COUNTER(set)) {
+		ip_set_percpu_counter_sum(rcu_dereference_check(counter->pcpu,
+						rcu_read_lock_any_held()),
+					  bytes, packets);
+		return;
+	}
+	*bytes = ip_set_get_bytes(counter);
+	*packets = ip_set_get_packets(counter);
+}
+
 static bool
-ip_set_put_counter(struct sk_buff *skb, const struct ip_set_counter *counter)
+ip_set_put_counter(struct sk_buff *skb, const struct ip_set *set,
+		   const struct ip_set_counter *counter)
 {
-	return nla_put_net64(skb, IPSET_ATTR_BYTES,
-			     cpu_to_be64(ip_set_get_bytes(counter)),
+	u64 bytes, packets;
+
+	ip_set_get_counter(set, counter, &bytes, &packets);
+	return nla_put_net64(skb, IPSET_ATTR_BYTES, cpu_to_be64(bytes),
 			     IPSET_ATTR_PAD) ||
-	       nla_put_net64(skb, IPSET_ATTR_PACKETS,
-			     cpu_to_be64(ip_set_get_packets(counter)),
+	       nla_put_net64(skb, IPSET_ATTR_PACKETS, cpu_to_be64(packets),
 			     IPSET_ATTR_PAD);
 }
 
@@ -573,7 +700,7 @@ ip_set_put_extensions(struct sk_buff *skb, const struct ip_set *set,
 			return -EMSGSIZE;
 	}
 	if (SET_WITH_COUNTER(set) &&
-	    ip_set_put_counter(skb, ext_counter(e, set)))
+	    ip_set_put_counter(skb, set, ext_counter(e, set)))
 		return -EMSGSIZE;
 	if (SET_WITH_COMMENT(set) &&
 	    ip_set_put_comment(skb, ext_comment(e, set)))
@@ -616,11 +743,34 @@ ip_set_add_packets(u64 packets, struct ip_set_counter *counter)
 }
 
 static void
-ip_set_update_counter(struct ip_set_counter *counter,
+ip_set_update_percpu_counter(struct ip_set_counter *counter,
+			     const struct ip_set_ext *ext)
+{
+	struct ip_set_counter_pcpu *p;
+	struct ip_set_counter_cpu *c;
+	unsigned long flags;
+
+	p = rcu_dereference_check(counter->pcpu, rcu_read_lock_any_held());
+	if (unlikely(!p))
+		return;
+	c = get_cpu_ptr(p->cpu);
+	flags = u64_stats_update_begin_irqsave(&c->syncp);
+	u64_stats_add(&c->bytes, ext->bytes);
+	u64_stats_add(&c->packets, ext->packets);
+	u64_stats_update_end_irqrestore(&c->syncp, flags);
+	put_cpu_ptr(p->cpu);
+}
+
+static void
+ip_set_update_counter(struct ip_set *set, struct ip_set_counter *counter,
 		      const struct ip_set_ext *ext, u32 flags)
 {
 	if (ext->packets != ULLONG_MAX &&
 	    !(flags & IPSET_FLAG_SKIP_COUNTER_UPDATE)) {
+		if (SET_WITH_PERCPU_COUNTER(set)) {
+			ip_set_update_percpu_counter(counter, ext);
+			return;
+		}
 		ip_set_add_bytes(ext->bytes, counter);
 		ip_set_add_packets(ext->packets, counter);
 	}
@@ -643,15 +793,18 @@ ip_set_match_extensions(struct ip_set *set, const struct ip_set_ext *ext,
 		return false;
 	if (SET_WITH_COUNTER(set)) {
 		struct ip_set_counter *counter = ext_counter(data, set);
+		u64 bytes, packets;
 
-		ip_set_update_counter(counter, ext, flags);
+		ip_set_update_counter(set, counter, ext, flags);
 
-		if (flags & IPSET_FLAG_MATCH_COUNTERS &&
-		    !(ip_set_match_counter(ip_set_get_packets(counter),
-				mext->packets, mext->packets_op) &&
-		      ip_set_match_counter(ip_set_get_bytes(counter),
-				mext->bytes, mext->bytes_op)))
-			return false;
+		if (flags & IPSET_FLAG_MATCH_COUNTERS) {
+			ip_set_get_counter(set, counter, &bytes, &packets);
+			if (!(ip_set_match_counter(packets, mext->packets,
+						   mext->packets_op) &&
+			      ip_set_match_counter(bytes, mext->bytes,
+						   mext->bytes_op)))
+				return false;
+		}
 	}
 	if (SET_WITH_SKBINFO(set))
 		ip_set_get_skbinfo(ext_skbinfo(data, set),
@@ -1466,6 +1619,8 @@ ip_set_put_flags(struct sk_buff *skb, struct ip_set *set)
 		cadt_flags |= IPSET_FLAG_WITH_SKBINFO;
 	if (SET_WITH_FORCEADD(set))
 		cadt_flags |= IPSET_FLAG_WITH_FORCEADD;
+	if (SET_WITH_PERCPU_COUNTER(set))
+		cadt_flags |= IPSET_FLAG_WITH_PERCPU_COUNTERS;
 
 	if (!cadt_flags)
 		return 0;
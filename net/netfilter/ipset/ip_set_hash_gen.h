@@ -976,7 +976,7 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	mtype_data_set_flags(data, flags);
 #endif
 	if (SET_WITH_COUNTER(set))
-		ip_set_init_counter(ext_counter(data, set), ext);
+		ip_set_init_counter(set, ext_counter(data, set), ext);
 	if (SET_WITH_COMMENT(set))
 		ip_set_init_comment(set, ext_comment(data, set), ext);
 	if (SET_WITH_SKBINFO(set))
@@ -62,6 +62,7 @@
 #include <linux/net_namespace.h>
 #include <linux/nospec.h>
 #include <linux/btf_ids.h>
+#include <linux/workqueue.h>
 
 #include <net/net_namespace.h>
 #include <net/netns/generic.h>
@@ -131,6 +132,7 @@ static const char *const nlk_cb_mutex_key_strings[MAX_LINKS + 1] = {
 };
 
 static int netlink_dump(struct sock *sk, bool lock_taken);
+static void netlink_dump_free_shards(struct netlink_sock *nlk);
 
 /* nl_table locking explained:
  * Lookup and traversal are protected with an RCU read-side lock. Insertion
@@ -771,6 +773,7 @@ static int netlink_release(struct socket *sock)
 			nlk->cb.done(&nlk->cb);
 		module_put(nlk->cb.module);
 		kfree_skb(nlk->cb.skb);
+		netlink_dump_free_shards(nlk);
 	}
 
 	module_put(nlk->module);
@@ -2242,34 +2245,20 @@ static int netlink_dump_done(struct netlink_sock *nlk, struct sk_buff *skb,
 	return 0;
 }
 
-static int netlink_dump(struct sock *sk, bool lock_taken)
+static struct sk_buff *netlink_dump_alloc_skb(struct sock *sk,
+					      struct netlink_callback *cb)
 {
 	struct netlink_sock *nlk = nlk_sk(sk);
-	struct netlink_ext_ack extack = {};
-	struct netlink_callback *cb;
 	struct sk_buff *skb = NULL;
 	size_t max_recvmsg_len;
-	struct module *module;
-	int err = -ENOBUFS;
 	int alloc_min_size;
 	int alloc_size;
 
-	if (!lock_taken)
-		mutex_lock(&nlk->nl_cb_mutex);
-	if (!nlk->cb_running) {
-		err = -EINVAL;
-		goto errout_skb;
-	}
-
-	if (atomic_read(&sk->sk_rmem_alloc) >= sk->sk_rcvbuf)
-		goto errout_skb;
-
 	/* NLMSG_GOODSIZE is small to avoid high order allocations being
 	 * required, but it makes sense to _attempt_ a 16K bytes allocation
 	 * to reduce number of system calls on dump operations, if user
 	 * ever provided a big enough buffer.
 	 */
-	cb = &nlk->cb;
 	alloc_min_size = max_t(int, cb->min_dump_alloc, NLMSG_GOODSIZE);
 
 	max_recvmsg_len = READ_ONCE(nlk->max_recvmsg_len);
@@ -2284,7 +2273,7 @@ static int netlink_dump(struct sock *sk, bool lock_taken)
 		skb = alloc_skb(alloc_size, GFP_KERNEL);
 	}
 	if (!skb)
-		goto errout_skb;
+		return NULL;
 
 	/* Trim skb to allocated size. User is expected to provide buffer as
 	 * large as max(min_dump_alloc, 16KiB (mac_recvmsg_len capped at
@@ -2306,6 +2295,170 @@ static int netlink_dump(struct sock *sk, bool lock_taken)
 
 	netlink_skb_set_owner_r(skb, sk);
 
+	return skb;
+}
+
+/*
+ * A sharded dump splits the iteration of a family into nr_shards
+ * independent callbacks, each with its own cb->ctx cursor.  Every round
+ * fills one skb per unfinished shard, in parallel on unbound kworkers,
+ * and queues them to the socket in shard order.  NLMSG_DONE follows once
+ * every shard is done, carrying the first error any of them hit.
+ */
+struct netlink_dump_shard {
+	struct work_struct	work;
+	struct netlink_callback	cb;
+	struct sk_buff		*skb;
+	int			done_errno;
+};
+
+static void netlink_dump_shard_work(struct work_struct *work)
+{
+	struct netlink_dump_shard *shard =
+		container_of(work, struct netlink_dump_shard, work);
+	struct netlink_ext_ack extack = {};
+	struct netlink_callback *cb = &shard->cb;
+	struct sk_buff *skb = shard->skb;
+	int err;
+
+	cb->extack = &extack;
+	err = cb->dump(skb, cb);
+	cb->extack = NULL;
+
+	/* Same convention as the unsharded dump in netlink_dump() */
+	if (err == -EMSGSIZE && skb->len)
+		err = skb->len;
+	shard->done_errno = err;
+}
+
+static void netlink_dump_init_shards(struct netlink_sock *nlk,
+				     unsigned int nr_shards)
+{
+	struct netlink_dump_shard *shards;
+	unsigned int i;
+
+	nr_shards = min(nr_shards, NETLINK_DUMP_MAX_SHARDS);
+	if (nr_shards <= 1)
+		return;
+
+	/* Not fatal, the dump just isn't split */
+	shards = kcalloc(nr_shards, sizeof(*shards), GFP_KERNEL);
+	if (!shards)
+		return;
+
+	nlk->cb.nr_shards = nr_shards;
+	for (i = 0; i < nr_shards; i++) {
+		INIT_WORK(&shards[i].work, netlink_dump_shard_work);
+		shards[i].cb = nlk->cb;
+		shards[i].cb.shard = i;
+		shards[i].done_errno = INT_MAX;
+	}
+
+	nlk->cb_shards = shards;
+	nlk->cb_nr_shards = nr_shards;
+}
+
+static void netlink_dump_free_shards(struct netlink_sock *nlk)
+{
+	kfree(nlk->cb_shards);
+	nlk->cb_shards = NULL;
+	nlk->cb_nr_shards = 0;
+}
+
+/* Run one round of a sharded dump.  Returns > 0 if there is more to dump,
+ * 0 once every shard is done with nlk->dump_done_errno set for NLMSG_DONE,
+ * or an error if no skb could be allocated.
+ */
+static int netlink_dump_shards(struct sock *sk)
+{
+	struct netlink_sock *nlk = nlk_sk(sk);
+	struct netlink_dump_shard *shard;
+	unsigned int i, queued = 0;
+	bool more = false;
+	int err = 0;
+
+	for (i = 0; i < nlk->cb_nr_shards; i++) {
+		shard = &nlk->cb_shards[i];
+		if (shard->done_errno <= 0)
+			continue;
+
+		shard->skb = netlink_dump_alloc_skb(sk, &shard->cb);
+		if (!shard->skb)
+			break;
+		queue_work(system_unbound_wq, &shard->work);
+		queued++;
+	}
+
+	if (!queued)
+		return -ENOBUFS;
+
+	for (i = 0; i < nlk->cb_nr_shards; i++) {
+		struct sk_buff *skb;
+
+		shard = &nlk->cb_shards[i];
+		skb = shard->skb;
+		if (!skb)
+			continue;
+
+		flush_work(&shard->work);
+		shard->skb = NULL;
+
+		if (sk_filter(sk, skb))
+			kfree_skb(skb);
+		else
+			__netlink_sendskb(sk, skb);
+	}
+
+	for (i = 0; i < nlk->cb_nr_shards; i++) {
+		shard = &nlk->cb_shards[i];
+		if (shard->done_errno > 0)
+			more = true;
+		else if (shard->done_errno < 0 && !err)
+			err = shard->done_errno;
+	}
+
+	if (more)
+		return 1;
+
+	nlk->dump_done_errno = err;
+	return 0;
+}
+
+static int netlink_dump(struct sock *sk, bool lock_taken)
+{
+	struct netlink_sock *nlk = nlk_sk(sk);
+	struct netlink_ext_ack extack = {};
+	struct netlink_callback *cb;
+	struct sk_buff *skb = NULL;
+	struct module *module;
+	int err = -ENOBUFS;
+
+	if (!lock_taken)
+		mutex_lock(&nlk->nl_cb_mutex);
+	if (!nlk->cb_running) {
+		err = -EINVAL;
+		goto errout_skb;
+	}
+
+	if (atomic_read(&sk->sk_rmem_alloc) >= sk->sk_rcvbuf)
+		goto errout_skb;
+
+	if (nlk->cb_shards && nlk->dump_done_errno > 0) {
+		err = netlink_dump_shards(sk);
+		if (err < 0)
+			goto errout_skb;
+		if (err > 0) {
+			mutex_unlock(&nlk->nl_cb_mutex);
+			return 0;
+		}
+		err = -ENOBUFS;
+	}
+
+	cb = &nlk->cb;
+	skb = netlink_dump_alloc_skb(sk, cb);
+	if (!skb)
+		goto errout_skb;
+
 	if (nlk->dump_done_errno > 0) {
 		cb->extack = &extack;
 
@@ -2357,6 +2510,7 @@ static int netlink_dump(struct sock *sk, bool lock_taken)
 		cb->done(cb);
 
 	WRITE_ONCE(nlk->cb_running, false);
+	netlink_dump_free_shards(nlk);
 	module = cb->module;
 	skb = cb->skb;
 	mutex_unlock(&nlk->nl_cb_mutex);
@@ -2421,6 +2575,8 @@ int __netlink_dump_start(struct sock *ssk, struct sk_buff *skb,
 			goto error_put;
 	}
 
+	netlink_dump_init_shards(nlk, control->nr_shards);
+
 	WRITE_ONCE(nlk->cb_running, true);
 	nlk->dump_done_errno = INT_MAX;
 
@@ -38,6 +38,9 @@ struct netlink_sock {
 	bool			cb_running;
 	int			dump_done_errno;
 	struct netlink_callback	cb;
+	/* per-shard callbacks of a sharded dump, see netlink_dump_shards() */
+	struct netlink_dump_shard *cb_shards;
+	unsigned int		cb_nr_shards;
 	struct mutex		nl_cb_mutex;
 
 	void			(*netlink_rcv)(struct sk_buff *skb);
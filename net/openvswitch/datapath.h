@@ -40,6 +40,8 @@
  *   up per packet.
  * @n_cache_hit: The number of received packets that had their mask found using
  * the mask cache.
+ * @n_emc_hit: The number of received packets that had their flow found in the
+ * exact match cache, without any mask lookup.
  */
 struct dp_stats_percpu {
 	u64 n_hit;
@@ -47,6 +49,7 @@ struct dp_stats_percpu {
 	u64 n_lost;
 	u64 n_mask_hit;
 	u64 n_cache_hit;
+	u64 n_emc_hit;
 	struct u64_stats_sync syncp;
 };
 
@@ -42,6 +42,8 @@
 #define MC_HASH_SHIFT		8
 #define MC_HASH_SEGS		((sizeof(uint32_t) * 8) / MC_HASH_SHIFT)
 
+#define EMC_ENTRIES		1024
+
 static struct kmem_cache *flow_cache;
 struct kmem_cache *flow_stats_cache __read_mostly;
 
@@ -408,6 +410,46 @@ int ovs_flow_tbl_masks_cache_resize(struct flow_table *table, u32 size)
 	return 0;
 }
 
+static void emc_rcu_cb(struct rcu_head *rcu)
+{
+	struct flow_emc *emc = container_of(rcu, struct flow_emc, rcu);
+
+	free_percpu(emc->entries);
+	kfree(emc);
+}
+
+/* Must be called with OVS mutex held. */
+int ovs_flow_tbl_emc_set(struct flow_table *table, bool enable)
+{
+	struct flow_emc *emc = ovsl_dereference(table->emc);
+
+	if (!enable) {
+		if (emc) {
+			RCU_INIT_POINTER(table->emc, NULL);
+			call_rcu(&emc->rcu, emc_rcu_cb);
+		}
+		return 0;
+	}
+
+	if (emc)
+		return 0;
+
+	emc = kzalloc(sizeof(*emc), GFP_KERNEL);
+	if (!emc)
+		return -ENOMEM;
+
+	emc->entries = __alloc_percpu(array_size(sizeof(struct emc_entry),
+						 EMC_ENTRIES),
+				      __alignof__(struct emc_entry));
+	if (!emc->entries) {
+		kfree(emc);
+		return -ENOMEM;
+	}
+
+	rcu_assign_pointer(table->emc, emc);
+	return 0;
+}
+
 int ovs_flow_tbl_init(struct flow_table *table)
 {
 	struct table_instance *ti, *ufid_ti;
@@ -434,6 +476,8 @@ int ovs_flow_tbl_init(struct flow_table *table)
 	rcu_assign_pointer(table->ufid_ti, ufid_ti);
 	rcu_assign_pointer(table->mask_array, ma);
 	rcu_assign_pointer(table->mask_cache, mc);
+	RCU_INIT_POINTER(table->emc, NULL);
+	atomic64_set(&table->emc_gen, 0);
 	table->last_rehash = jiffies;
 	table->count = 0;
 	table->ufid_count = 0;
@@ -470,6 +514,10 @@ static void table_instance_flow_free(struct flow_table *table,
 	}
 
 	flow_mask_remove(table, flow->mask);
+
+	/* Pairs with smp_rmb() in ovs_flow_tbl_lookup_stats() */
+	smp_wmb();
+	atomic64_inc(&table->emc_gen);
 }
 
 /* Must be called with OVS mutex held. */
@@ -516,9 +564,12 @@ void ovs_flow_tbl_destroy(struct flow_table *table)
 	struct table_instance *ufid_ti = rcu_dereference_raw(table->ufid_ti);
 	struct mask_cache *mc = rcu_dereference_raw(table->mask_cache);
 	struct mask_array *ma = rcu_dereference_raw(table->mask_array);
+	struct flow_emc *emc = rcu_dereference_raw(table->emc);
 
 	call_rcu(&mc->rcu, mask_cache_rcu_cb);
 	call_rcu(&ma->rcu, mask_array_rcu_cb);
+	if (emc)
+		call_rcu(&emc->rcu, emc_rcu_cb);
 	table_instance_destroy(ti, ufid_ti);
 }
 
@@ -780,11 +831,11 @@ static struct sw_flow *flow_lookup(struct flow_table *tbl,
  * This is per cpu cache and is divided in MC_HASH_SEGS segments.
  * In case of a hash collision the entry is hashed in next segment.
  * */
-struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
-					  const struct sw_flow_key *key,
-					  u32 skb_hash,
-					  u32 *n_mask_hit,
-					  u32 *n_cache_hit)
+static struct sw_flow *flow_lookup_mask_cache(struct flow_table *tbl,
+					      const struct sw_flow_key *key,
+					      u32 skb_hash,
+					      u32 *n_mask_hit,
+					      u32 *n_cache_hit)
 {
 	struct mask_cache *mc = rcu_dereference(tbl->mask_cache);
 	struct mask_array *ma = rcu_dereference(tbl->mask_array);
@@ -804,12 +855,6 @@ struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
 				   &mask_index);
 	}
 
-	/* Pre and post recirulation flows usually have the same skb_hash
-	 * value. To avoid hash collisions, rehash the 'skb_hash' with
-	 * 'recirc_id'.  */
-	if (key->recirc_id)
-		skb_hash = jhash_1word(skb_hash, key->recirc_id);
-
 	ce = NULL;
 	hash = skb_hash;
 	entries = this_cpu_ptr(mc->mask_cache);
@@ -844,6 +889,67 @@ struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
 	return flow;
 }
 
+static bool emc_flow_match(const struct sw_flow *flow,
+			   const struct sw_flow_key *key)
+{
+	struct sw_flow_key masked_key;
+
+	ovs_flow_mask_key(&masked_key, key, false, flow->mask);
+	return flow_cmp_masked_key(flow, &masked_key, &flow->mask->range);
+}
+
+/*
+ * The exact match cache maps skb_hash straight to the flow, so a hit costs
+ * one masked compare against that flow instead of a probe per mask. It is
+ * per cpu and direct mapped. An entry is only trusted while emc_gen is the
+ * one it was filled under, any flow removal invalidates the whole cache.
+ */
+struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *tbl,
+					  const struct sw_flow_key *key,
+					  u32 skb_hash,
+					  u32 *n_mask_hit,
+					  u32 *n_cache_hit,
+					  u32 *n_emc_hit)
+{
+	struct flow_emc *emc = rcu_dereference(tbl->emc);
+	struct emc_entry *e = NULL;
+	struct sw_flow *flow;
+	u64 gen = 0;
+
+	*n_emc_hit = 0;
+
+	/* Pre and post recirulation flows usually have the same skb_hash
+	 * value. To avoid hash collisions, rehash the 'skb_hash' with
+	 * 'recirc_id'.  */
+	if (skb_hash && key->recirc_id)
+		skb_hash = jhash_1word(skb_hash, key->recirc_id);
+
+	if (emc && skb_hash) {
+		gen = atomic64_read(&tbl->emc_gen);
+		/* Pairs with smp_wmb() in table_instance_flow_free() */
+		smp_rmb();
+
+		e = this_cpu_ptr(emc->entries) + (skb_hash & (EMC_ENTRIES - 1));
+		flow = e->flow;
+		if (flow && e->skb_hash == skb_hash && e->gen == gen &&
+		    emc_flow_match(flow, key)) {
+			*n_mask_hit = 0;
+			*n_cache_hit = 0;
+			*n_emc_hit = 1;
+			return flow;
+		}
+	}
+
+	flow = flow_lookup_mask_cache(tbl, key, skb_hash, n_mask_hit,
+				      n_cache_hit);
+	if (e && flow) {
+		e->skb_hash = skb_hash;
+		e->gen = gen;
+		e->flow = flow;
+	}
+	return flow;
+}
+
 struct sw_flow *ovs_flow_tbl_lookup(struct flow_table *tbl,
 				    const struct sw_flow_key *key)
 {
@@ -33,6 +33,17 @@ struct mask_cache {
 	struct mask_cache_entry __percpu *mask_cache;
 };
 
+struct emc_entry {
+	u64 gen;
+	struct sw_flow *flow;
+	u32 skb_hash;
+};
+
+struct flow_emc {
+	struct rcu_head rcu;
+	struct emc_entry __percpu *entries;
+};
+
 struct mask_count {
 	int index;
 	u64 counter;
@@ -64,6 +75,12 @@ struct flow_table {
 	struct table_instance __rcu *ufid_ti;
 	struct mask_cache __rcu *mask_cache;
 	struct mask_array __rcu *mask_array;
+	struct flow_emc __rcu *emc;
+	/*
+	 * Bumped on flow removal, invalidates all emc entries.  64 bits so
+	 * that it never wraps back to the generation of a stale entry.
+	 */
+	atomic64_t emc_gen;
 	unsigned long last_rehash;
 	unsigned int count;
 	unsigned int ufid_count;
@@ -88,13 +105,15 @@ void ovs_flow_tbl_remove(struct flow_table *table, struct sw_flow *flow);
 int  ovs_flow_tbl_num_masks(const struct flow_table *table);
 u32  ovs_flow_tbl_masks_cache_size(const struct flow_table *table);
 int  ovs_flow_tbl_masks_cache_resize(struct flow_table *table, u32 size);
+int  ovs_flow_tbl_emc_set(struct flow_table *table, bool enable);
 struct sw_flow *ovs_flow_tbl_dump_next(struct table_instance *table,
 				       u32 *bucket, u32 *idx);
 struct sw_flow *ovs_flow_tbl_lookup_stats(struct flow_table *,
 					  const struct sw_flow_key *,
 					  u32 skb_hash,
 					  u32 *n_mask_hit,
-					  u32 *n_cache_hit);
+					  u32 *n_cache_hit,
+					  u32 *n_emc_hit);
 struct sw_flow *ovs_flow_tbl_lookup(struct flow_table *,
 				    const struct sw_flow_key *);
 struct sw_flow *ovs_flow_tbl_lookup_exact(struct flow_table *tbl,
@@ -204,12 +204,14 @@ static int prb_queue_frozen(struct tpacket_kbdq_core *);
 static void prb_open_block(struct tpacket_kbdq_core *,
 		struct tpacket_block_desc *);
 static void prb_retire_rx_blk_timer_expired(struct timer_list *);
+static void prb_retire_pcpu_blk_timer_expired(struct timer_list *);
 static void _prb_refresh_rx_retire_blk_timer(struct tpacket_kbdq_core *);
-static void prb_fill_rxhash(struct tpacket_kbdq_core *, struct tpacket3_hdr *);
+static void prb_fill_rxhash(struct tpacket_kbdq_core *, struct tpacket3_hdr *,
+		struct sk_buff *);
 static void prb_clear_rxhash(struct tpacket_kbdq_core *,
 		struct tpacket3_hdr *);
 static void prb_fill_vlan_info(struct tpacket_kbdq_core *,
-		struct tpacket3_hdr *);
+		struct tpacket3_hdr *, struct sk_buff *);
 static void packet_flush_mclist(struct sock *sk);
 static u16 packet_pick_tx_queue(struct sk_buff *skb);
 
@@ -603,11 +605,41 @@ static void prb_setup_retire_blk_timer(struct packet_sock *po)
 	struct tpacket_kbdq_core *pkc;
 
 	pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
-	timer_setup(&pkc->retire_blk_timer, prb_retire_rx_blk_timer_expired,
+	timer_setup(&pkc->retire_blk_timer,
+		    pkc->pcpu_blk ? prb_retire_pcpu_blk_timer_expired :
+				    prb_retire_rx_blk_timer_expired,
 		    0);
 	pkc->retire_blk_timer.expires = jiffies;
 }
 
+static int prb_alloc_pcpu_blk(struct tpacket_kbdq_core *pkc)
+{
+	int cpu;
+
+	pkc->blk_claimed = bitmap_zalloc(pkc->knum_blocks, GFP_KERNEL);
+	if (!pkc->blk_claimed)
+		return -ENOMEM;
+
+	pkc->pcpu_blk = alloc_percpu(struct tpacket_kbdq_pcpu);
+	if (!pkc->pcpu_blk) {
+		bitmap_free(pkc->blk_claimed);
+		pkc->blk_claimed = NULL;
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(pkc->pcpu_blk, cpu)->lock);
+	return 0;
+}
+
+static void prb_free_pcpu_blk(struct tpacket_kbdq_core *pkc)
+{
+	free_percpu(pkc->pcpu_blk);
+	pkc->pcpu_blk = NULL;
+	bitmap_free(pkc->blk_claimed);
+	pkc->blk_claimed = NULL;
+}
+
 static int prb_calc_retire_blk_tmo(struct packet_sock *po,
 				int blk_size_in_bytes)
 {
@@ -651,13 +683,14 @@ static void prb_init_ft_ops(struct tpacket_kbdq_core *p1,
 	p1->feature_req_word = req_u->req3.tp_feature_req_word;
 }
 
-static void init_prb_bdqc(struct packet_sock *po,
+static int init_prb_bdqc(struct packet_sock *po,
 			struct packet_ring_buffer *rb,
 			struct pgv *pg_vec,
 			union tpacket_req_u *req_u)
 {
 	struct tpacket_kbdq_core *p1 = GET_PBDQC_FROM_RB(rb);
 	struct tpacket_block_desc *pbd;
+	int err;
 
 	memset(p1, 0x0, sizeof(*p1));
 
@@ -682,8 +715,20 @@ static void init_prb_bdqc(struct packet_sock *po,
 
 	p1->max_frame_len = p1->kblk_size - BLK_PLUS_PRIV(p1->blk_sizeof_priv);
 	prb_init_ft_ops(p1, req_u);
+
+	if (p1->feature_req_word & TP_FT_REQ_PERCPU_BLK) {
+		err = prb_alloc_pcpu_blk(p1);
+		if (err)
+			return err;
+	}
+
 	prb_setup_retire_blk_timer(po);
-	prb_open_block(p1, pbd);
+	/* Per-CPU blocks are only claimed when a packet shows up */
+	if (p1->pcpu_blk)
+		_prb_refresh_rx_retire_blk_timer(p1);
+	else
+		prb_open_block(p1, pbd);
+	return 0;
 }
 
 /*  Do NOT update the last_blk_num first.
@@ -792,6 +837,39 @@ static void prb_retire_rx_blk_timer_expired(struct timer_list *t)
 	spin_unlock(&po->sk.sk_receive_queue.lock);
 }
 
+static void prb_close_pcpu_block(struct tpacket_kbdq_core *pkc,
+		struct tpacket_kbdq_pcpu *pc,
+		struct packet_sock *po, unsigned int stat);
+
+/*
+ * TP_FT_REQ_PERCPU_BLK timer: there is no single current block, so the
+ * timer fires every tov and retires whichever per-CPU blocks have been
+ * open for at least that long.
+ */
+static void prb_retire_pcpu_blk_timer_expired(struct timer_list *t)
+{
+	struct packet_sock *po =
+		from_timer(po, t, rx_ring.prb_bdqc.retire_blk_timer);
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
+	struct tpacket_kbdq_pcpu *pc;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(pkc->pcpu_blk, cpu);
+
+		spin_lock(&pc->lock);
+		if (pc->pbd &&
+		    time_after_eq(jiffies, pc->open_jiffies + pkc->tov_in_jiffies))
+			prb_close_pcpu_block(pkc, pc, po, TP_STATUS_BLK_TMO);
+		spin_unlock(&pc->lock);
+	}
+
+	spin_lock(&po->sk.sk_receive_queue.lock);
+	if (!pkc->delete_blk_timer)
+		_prb_refresh_rx_retire_blk_timer(pkc);
+	spin_unlock(&po->sk.sk_receive_queue.lock);
+}
+
 static void prb_flush_block(struct tpacket_kbdq_core *pkc1,
 		struct tpacket_block_desc *pbd1, __u32 status)
 {
@@ -805,7 +883,7 @@ static void prb_flush_block(struct tpacket_kbdq_core *pkc1,
 	/* Skip the block header(we know header WILL fit in 4K) */
 	start += PAGE_SIZE;
 
-	end = (u8 *)PAGE_ALIGN((unsigned long)pkc1->pkblk_end);
+	end = (u8 *)PAGE_ALIGN((unsigned long)pbd1 + pkc1->kblk_size);
 	for (; start < end; start += PAGE_SIZE)
 		flush_dcache_page(pgv_to_page(start));
 
@@ -835,8 +913,8 @@ static void prb_flush_block(struct tpacket_kbdq_core *pkc1,
  * Note:We DONT refresh the timer on purpose.
  *	Because almost always the next block will be opened.
  */
-static void prb_close_block(struct tpacket_kbdq_core *pkc1,
-		struct tpacket_block_desc *pbd1,
+static void __prb_close_block(struct tpacket_kbdq_core *pkc1,
+		struct tpacket_block_desc *pbd1, char *prev,
 		struct packet_sock *po, unsigned int stat)
 {
 	__u32 status = TP_STATUS_USER | stat;
@@ -848,7 +926,7 @@ static void prb_close_block(struct tpacket_kbdq_core *pkc1,
 	if (atomic_read(&po->tp_drops))
 		status |= TP_STATUS_LOSING;
 
-	last_pkt = (struct tpacket3_hdr *)pkc1->prev;
+	last_pkt = (struct tpacket3_hdr *)prev;
 	last_pkt->tp_next_offset = 0;
 
 	/* Get the ts of the last pkt */
@@ -873,7 +951,13 @@ static void prb_close_block(struct tpacket_kbdq_core *pkc1,
 	prb_flush_block(pkc1, pbd1, status);
 
 	sk->sk_data_ready(sk);
+}
 
+static void prb_close_block(struct tpacket_kbdq_core *pkc1,
+		struct tpacket_block_desc *pbd1,
+		struct packet_sock *po, unsigned int stat)
+{
+	__prb_close_block(pkc1, pbd1, pkc1->prev, po, stat);
 	pkc1->kactive_blk_num = GET_NEXT_PRB_BLK_NUM(pkc1);
 }
 
@@ -889,7 +973,7 @@ static void prb_thaw_queue(struct tpacket_kbdq_core *pkc)
  * 2) retire_blk_timer is refreshed.
  *
  */
-static void prb_open_block(struct tpacket_kbdq_core *pkc1,
+static void prb_init_block(struct tpacket_kbdq_core *pkc1,
 	struct tpacket_block_desc *pbd1)
 {
 	struct timespec64 ts;
@@ -910,13 +994,19 @@ static void prb_open_block(struct tpacket_kbdq_core *pkc1,
 	h1->ts_first_pkt.ts_sec = ts.tv_sec;
 	h1->ts_first_pkt.ts_nsec = ts.tv_nsec;
 
-	pkc1->pkblk_start = (char *)pbd1;
-	pkc1->nxt_offset = pkc1->pkblk_start + BLK_PLUS_PRIV(pkc1->blk_sizeof_priv);
-
 	BLOCK_O2FP(pbd1) = (__u32)BLK_PLUS_PRIV(pkc1->blk_sizeof_priv);
 	BLOCK_O2PRIV(pbd1) = BLK_HDR_LEN;
 
 	pbd1->version = pkc1->version;
+}
+
+static void prb_open_block(struct tpacket_kbdq_core *pkc1,
+	struct tpacket_block_desc *pbd1)
+{
+	prb_init_block(pkc1, pbd1);
+
+	pkc1->pkblk_start = (char *)pbd1;
+	pkc1->nxt_offset = pkc1->pkblk_start + BLK_PLUS_PRIV(pkc1->blk_sizeof_priv);
 	pkc1->prev = pkc1->nxt_offset;
 	pkc1->pkblk_end = pkc1->pkblk_start + pkc1->kblk_size;
 
@@ -1030,13 +1120,16 @@ static void prb_clear_blk_fill_status(struct packet_ring_buffer *rb)
 {
 	struct tpacket_kbdq_core *pkc  = GET_PBDQC_FROM_RB(rb);
 
-	read_unlock(&pkc->blk_fill_in_prog_lock);
+	if (pkc->pcpu_blk)
+		spin_unlock(&this_cpu_ptr(pkc->pcpu_blk)->lock);
+	else
+		read_unlock(&pkc->blk_fill_in_prog_lock);
 }
 
 static void prb_fill_rxhash(struct tpacket_kbdq_core *pkc,
-			struct tpacket3_hdr *ppd)
+			struct tpacket3_hdr *ppd, struct sk_buff *skb)
 {
-	ppd->hv1.tp_rxhash = skb_get_hash(pkc->skb);
+	ppd->hv1.tp_rxhash = skb_get_hash(skb);
 }
 
 static void prb_clear_rxhash(struct tpacket_kbdq_core *pkc,
@@ -1046,17 +1139,17 @@ static void prb_clear_rxhash(struct tpacket_kbdq_core *pkc,
 }
 
 static void prb_fill_vlan_info(struct tpacket_kbdq_core *pkc,
-			struct tpacket3_hdr *ppd)
+			struct tpacket3_hdr *ppd, struct sk_buff *skb)
 {
 	struct packet_sock *po = container_of(pkc, struct packet_sock, rx_ring.prb_bdqc);
 
-	if (skb_vlan_tag_present(pkc->skb)) {
-		ppd->hv1.tp_vlan_tci = skb_vlan_tag_get(pkc->skb);
-		ppd->hv1.tp_vlan_tpid = ntohs(pkc->skb->vlan_proto);
+	if (skb_vlan_tag_present(skb)) {
+		ppd->hv1.tp_vlan_tci = skb_vlan_tag_get(skb);
+		ppd->hv1.tp_vlan_tpid = ntohs(skb->vlan_proto);
 		ppd->tp_status = TP_STATUS_VLAN_VALID | TP_STATUS_VLAN_TPID_VALID;
-	} else if (unlikely(po->sk.sk_type == SOCK_DGRAM && eth_type_vlan(pkc->skb->protocol))) {
-		ppd->hv1.tp_vlan_tci = vlan_get_tci(pkc->skb, pkc->skb->dev);
-		ppd->hv1.tp_vlan_tpid = ntohs(pkc->skb->protocol);
+	} else if (unlikely(po->sk.sk_type == SOCK_DGRAM && eth_type_vlan(skb->protocol))) {
+		ppd->hv1.tp_vlan_tci = vlan_get_tci(skb, skb->dev);
+		ppd->hv1.tp_vlan_tpid = ntohs(skb->protocol);
 		ppd->tp_status = TP_STATUS_VLAN_VALID | TP_STATUS_VLAN_TPID_VALID;
 	} else {
 		ppd->hv1.tp_vlan_tci = 0;
@@ -1066,13 +1159,13 @@ static void prb_fill_vlan_info(struct tpacket_kbdq_core *pkc,
 }
 
 static void prb_run_all_ft_ops(struct tpacket_kbdq_core *pkc,
-			struct tpacket3_hdr *ppd)
+			struct tpacket3_hdr *ppd, struct sk_buff *skb)
 {
 	ppd->hv1.tp_padding = 0;
-	prb_fill_vlan_info(pkc, ppd);
+	prb_fill_vlan_info(pkc, ppd, skb);
 
 	if (pkc->feature_req_word & TP_FT_REQ_FILL_RXHASH)
-		prb_fill_rxhash(pkc, ppd);
+		prb_fill_rxhash(pkc, ppd, skb);
 	else
 		prb_clear_rxhash(pkc, ppd);
 }
@@ -1080,7 +1173,7 @@ static void prb_run_all_ft_ops(struct tpacket_kbdq_core *pkc,
 static void prb_fill_curr_block(char *curr,
 				struct tpacket_kbdq_core *pkc,
 				struct tpacket_block_desc *pbd,
-				unsigned int len)
+				unsigned int len, struct sk_buff *skb)
 	__acquires(&pkc->blk_fill_in_prog_lock)
 {
 	struct tpacket3_hdr *ppd;
@@ -1092,7 +1185,7 @@ static void prb_fill_curr_block(char *curr,
 	BLOCK_LEN(pbd) += TOTAL_PKT_LEN_INCL_ALIGN(len);
 	BLOCK_NUM_PKTS(pbd) += 1;
 	read_lock(&pkc->blk_fill_in_prog_lock);
-	prb_run_all_ft_ops(pkc, ppd);
+	prb_run_all_ft_ops(pkc, ppd, skb);
 }
 
 /* Assumes caller has the sk->rx_queue.lock */
@@ -1130,12 +1223,11 @@ static void *__packet_lookup_frame_in_block(struct packet_sock *po,
 
 	smp_mb();
 	curr = pkc->nxt_offset;
-	pkc->skb = skb;
 	end = (char *)pbd + pkc->kblk_size;
 
 	/* first try the current block */
 	if (curr+TOTAL_PKT_LEN_INCL_ALIGN(len) < end) {
-		prb_fill_curr_block(curr, pkc, pbd, len);
+		prb_fill_curr_block(curr, pkc, pbd, len, skb);
 		return (void *)curr;
 	}
 
@@ -1146,7 +1238,7 @@ static void *__packet_lookup_frame_in_block(struct packet_sock *po,
 	curr = (char *)prb_dispatch_next_block(pkc, po);
 	if (curr) {
 		pbd = GET_CURR_PBLOCK_DESC_FROM_CORE(pkc);
-		prb_fill_curr_block(curr, pkc, pbd, len);
+		prb_fill_curr_block(curr, pkc, pbd, len, skb);
 		return (void *)curr;
 	}
 
@@ -1157,6 +1249,98 @@ static void *__packet_lookup_frame_in_block(struct packet_sock *po,
 	return NULL;
 }
 
+/*
+ * TP_FT_REQ_PERCPU_BLK:
+ * Each CPU claims a whole block from the ring under sk_receive_queue.lock
+ * and then fills it under its own tpacket_kbdq_pcpu lock, so the shared
+ * lock is taken once per block rather than once per packet.  Blocks are
+ * claimed in ring order, which is also their BLOCK_SNUM order, so user
+ * space walking the ring still sees them in sequence.  A block retired
+ * before its predecessors simply waits for user space to get to it.
+ */
+static bool prb_claim_pcpu_block(struct tpacket_kbdq_core *pkc,
+		struct tpacket_kbdq_pcpu *pc,
+		struct packet_sock *po)
+{
+	struct tpacket_block_desc *pbd;
+	unsigned int blk_num;
+
+	spin_lock(&po->sk.sk_receive_queue.lock);
+	blk_num = pkc->kactive_blk_num;
+	pbd = GET_PBLOCK_DESC(pkc, blk_num);
+
+	/* Still owned by user space, or by a CPU after a wrap around */
+	if (prb_curr_blk_in_use(pbd) || test_bit(blk_num, pkc->blk_claimed)) {
+		if (!prb_queue_frozen(pkc))
+			prb_freeze_queue(pkc, po);
+		spin_unlock(&po->sk.sk_receive_queue.lock);
+		return false;
+	}
+
+	prb_thaw_queue(pkc);
+	__set_bit(blk_num, pkc->blk_claimed);
+	prb_init_block(pkc, pbd);
+	pkc->kactive_blk_num = GET_NEXT_PRB_BLK_NUM(pkc);
+	spin_unlock(&po->sk.sk_receive_queue.lock);
+
+	pc->pbd = pbd;
+	pc->blk_num = blk_num;
+	pc->nxt_offset = (char *)pbd + BLK_PLUS_PRIV(pkc->blk_sizeof_priv);
+	pc->prev = pc->nxt_offset;
+	pc->pkblk_end = (char *)pbd + pkc->kblk_size;
+	pc->open_jiffies = jiffies;
+	return true;
+}
+
+/* Caller holds pc->lock */
+static void prb_close_pcpu_block(struct tpacket_kbdq_core *pkc,
+		struct tpacket_kbdq_pcpu *pc,
+		struct packet_sock *po, unsigned int stat)
+{
+	struct tpacket_block_desc *pbd = pc->pbd;
+
+	__prb_close_block(pkc, pbd, pc->prev, po, stat);
+	pc->pbd = NULL;
+
+	spin_lock(&po->sk.sk_receive_queue.lock);
+	po->stats.stats3.tp_packets += BLOCK_NUM_PKTS(pbd);
+	__clear_bit(pc->blk_num, pkc->blk_claimed);
+	pkc->last_retired_blk_num = pc->blk_num;
+	spin_unlock(&po->sk.sk_receive_queue.lock);
+}
+
+/* On success, returns with this CPU's pc->lock held */
+static void *prb_lookup_pcpu_frame(struct packet_sock *po,
+				   struct sk_buff *skb,
+				   unsigned int len)
+{
+	struct tpacket_kbdq_core *pkc = GET_PBDQC_FROM_RB(&po->rx_ring);
+	struct tpacket_kbdq_pcpu *pc = this_cpu_ptr(pkc->pcpu_blk);
+	struct tpacket3_hdr *ppd;
+	char *curr;
+
+	spin_lock(&pc->lock);
+	if (pc->pbd &&
+	    pc->nxt_offset + TOTAL_PKT_LEN_INCL_ALIGN(len) >= pc->pkblk_end)
+		prb_close_pcpu_block(pkc, pc, po, 0);
+
+	if (!pc->pbd && !prb_claim_pcpu_block(pkc, pc, po)) {
+		spin_unlock(&pc->lock);
+		return NULL;
+	}
+
+	curr = pc->nxt_offset;
+	ppd = (struct tpacket3_hdr *)curr;
+	ppd->tp_next_offset = TOTAL_PKT_LEN_INCL_ALIGN(len);
+	pc->prev = curr;
+	pc->nxt_offset += TOTAL_PKT_LEN_INCL_ALIGN(len);
+	BLOCK_LEN(pc->pbd) += TOTAL_PKT_LEN_INCL_ALIGN(len);
+	BLOCK_NUM_PKTS(pc->pbd) += 1;
+	prb_run_all_ft_ops(pkc, ppd, skb);
+
+	return curr;
+}
+
 static void *packet_current_rx_frame(struct packet_sock *po,
 					    struct sk_buff *skb,
 					    int status, unsigned int len)
@@ -1169,6 +1353,8 @@ static void *packet_current_rx_frame(struct packet_sock *po,
 					po->rx_ring.head, status);
 		return curr;
 	case TPACKET_V3:
+		if (GET_PBDQC_FROM_RB(&po->rx_ring)->pcpu_blk)
+			return prb_lookup_pcpu_frame(po, skb, len);
 		return __packet_lookup_frame_in_block(po, skb, len);
 	default:
 		WARN(1, "TPACKET version not supported\n");
@@ -1193,6 +1379,10 @@ static void *prb_lookup_block(const struct packet_sock *po,
 static int prb_previous_blk_num(struct packet_ring_buffer *rb)
 {
 	unsigned int prev;
+
+	/* The last block claimed may still be being filled */
+	if (rb->prb_bdqc.pcpu_blk)
+		return rb->prb_bdqc.last_retired_blk_num;
 	if (rb->prb_bdqc.kactive_blk_num)
 		prev = rb->prb_bdqc.kactive_blk_num-1;
 	else
@@ -2296,6 +2486,7 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	__u32 ts_status;
 	unsigned int slot_id = 0;
 	int vnet_hdr_sz = 0;
+	bool pcpu_blk = false;
 
 	/* struct tpacket{2,3}_hdr is aligned to a multiple of TPACKET_ALIGNMENT.
 	 * We may add members to them until current aligned size without forcing
@@ -2398,7 +2589,11 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 			vnet_hdr_sz = 0;
 		}
 	}
-	spin_lock(&sk->sk_receive_queue.lock);
+	/* Per-CPU blocks only take the queue lock to claim a new block */
+	if (po->tp_version == TPACKET_V3)
+		pcpu_blk = !!GET_PBDQC_FROM_RB(&po->rx_ring)->pcpu_blk;
+	if (!pcpu_blk)
+		spin_lock(&sk->sk_receive_queue.lock);
 	h.raw = packet_current_rx_frame(po, skb,
 					TP_STATUS_KERNEL, (macoff+snaplen));
 	if (!h.raw)
@@ -2432,13 +2627,16 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 			status |= TP_STATUS_LOSING;
 	}
 
-	po->stats.stats1.tp_packets++;
-	if (copy_skb) {
-		status |= TP_STATUS_COPY;
-		skb_clear_delivery_time(copy_skb);
-		__skb_queue_tail(&sk->sk_receive_queue, copy_skb);
+	/* Per-CPU blocks account their packets when they are retired */
+	if (!pcpu_blk) {
+		po->stats.stats1.tp_packets++;
+		if (copy_skb) {
+			status |= TP_STATUS_COPY;
+			skb_clear_delivery_time(copy_skb);
+			__skb_queue_tail(&sk->sk_receive_queue, copy_skb);
+		}
+		spin_unlock(&sk->sk_receive_queue.lock);
 	}
-	spin_unlock(&sk->sk_receive_queue.lock);
 
 	skb_copy_bits(skb, 0, h.raw + macoff, snaplen);
 
@@ -2550,7 +2748,8 @@ static int tpacket_rcv(struct sk_buff *skb, struct net_device *dev,
 	return 0;
 
 drop_n_account:
-	spin_unlock(&sk->sk_receive_queue.lock);
+	if (!pcpu_blk)
+		spin_unlock(&sk->sk_receive_queue.lock);
 	atomic_inc(&po->tp_drops);
 	drop_reason = SKB_DROP_REASON_PACKET_SOCK_ERROR;
 
@@ -4529,7 +4728,9 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		case TPACKET_V3:
 			/* Block transmit is not supported yet */
 			if (!tx_ring) {
-				init_prb_bdqc(po, rb, pg_vec, req_u);
+				err = init_prb_bdqc(po, rb, pg_vec, req_u);
+				if (err)
+					goto out_free_pg_vec;
 			} else {
 				struct tpacket_req3 *req3 = &req_u->req3;
 
@@ -4605,8 +4806,10 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 	spin_unlock(&po->bind_lock);
 	if (pg_vec && (po->tp_version > TPACKET_V2)) {
 		/* Because we don't support block-based V3 on tx-ring */
-		if (!tx_ring)
+		if (!tx_ring) {
 			prb_shutdown_retire_blk_timer(po, rb_queue);
+			prb_free_pcpu_blk(GET_PBDQC_FROM_RB(rb));
+		}
 	}
 
 out_free_pg_vec:
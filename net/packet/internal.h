@@ -13,6 +13,18 @@ struct packet_mclist {
 	unsigned char		addr[MAX_ADDR_LEN];
 };
 
+/* Block a CPU fills on its own in TP_FT_REQ_PERCPU_BLK mode */
+struct tpacket_kbdq_pcpu {
+	/* held while a packet is copied into the block */
+	spinlock_t	lock;
+	struct tpacket_block_desc *pbd;
+	unsigned int	blk_num;
+	char		*prev;
+	char		*nxt_offset;
+	char		*pkblk_end;
+	unsigned long	open_jiffies;
+};
+
 /* kbdq - kernel block descriptor queue */
 struct tpacket_kbdq_core {
 	struct pgv	*pkbdq;
@@ -37,10 +49,14 @@ struct tpacket_kbdq_core {
 	uint64_t	knxt_seq_num;
 	char		*prev;
 	char		*nxt_offset;
-	struct sk_buff	*skb;
 
 	rwlock_t	blk_fill_in_prog_lock;
 
+	/* TP_FT_REQ_PERCPU_BLK: blocks handed out to the CPUs */
+	struct tpacket_kbdq_pcpu __percpu *pcpu_blk;
+	unsigned long	*blk_claimed;
+	unsigned int	last_retired_blk_num;
+
 	/* Default is set to 8ms */
 #define DEFAULT_PRB_RETIRE_TOV	(8)
 
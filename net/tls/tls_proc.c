@@ -22,6 +22,10 @@ static const struct snmp_mib tls_mib_list[] = {
 	SNMP_MIB_ITEM("TlsRxDeviceResync", LINUX_MIB_TLSRXDEVICERESYNC),
 	SNMP_MIB_ITEM("TlsDecryptRetry", LINUX_MIB_TLSDECRYPTRETRY),
 	SNMP_MIB_ITEM("TlsRxNoPadViolation", LINUX_MIB_TLSRXNOPADVIOL),
+	SNMP_MIB_ITEM("TlsRxZeroCopy", LINUX_MIB_TLSRXZEROCOPY),
+	SNMP_MIB_ITEM("TlsRxZeroCopyBytes", LINUX_MIB_TLSRXZEROCOPYBYTES),
+	SNMP_MIB_ITEM("TlsRxCopy", LINUX_MIB_TLSRXCOPY),
+	SNMP_MIB_ITEM("TlsRxStrpCopy", LINUX_MIB_TLSRXSTRPCOPY),
 	SNMP_MIB_SENTINEL
 };
 
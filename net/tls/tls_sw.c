@@ -1667,6 +1667,17 @@ tls_decrypt_sw(struct sock *sk, struct tls_context *tls_ctx,
 	rxm = strp_msg(darg->skb);
 	rxm->full_len -= pad;
 
+	/* Records decrypted straight into the user buffer vs. into an skb
+	 * which then has to be copied out.
+	 */
+	if (darg->zc) {
+		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXZEROCOPY);
+		TLS_ADD_STATS(sock_net(sk), LINUX_MIB_TLSRXZEROCOPYBYTES,
+			      rxm->full_len - prot->overhead_size);
+	} else {
+		TLS_INC_STATS(sock_net(sk), LINUX_MIB_TLSRXCOPY);
+	}
+
 	return 0;
 }
 
@@ -2684,6 +2695,27 @@ int init_prot_info(struct tls_prot_info *prot,
 	return 0;
 }
 
+/* With TLS_TX_PARALLEL, records are encrypted by the pcrypt instance of
+ * the cipher. Its requests complete asynchronously, spread over the CPUs
+ * of the pcrypt cpumask, and tls_tx_records() still transmits them in
+ * order.
+ */
+static struct crypto_aead *tls_alloc_aead(struct tls_context *ctx,
+					  const struct tls_cipher_desc *cipher_desc,
+					  int tx)
+{
+	char name[CRYPTO_MAX_ALG_NAME];
+
+	if (!tx || !ctx->tx_parallel)
+		return crypto_alloc_aead(cipher_desc->cipher_name, 0, 0);
+
+	if (snprintf(name, sizeof(name), "pcrypt(%s)",
+		     cipher_desc->cipher_name) >= sizeof(name))
+		return ERR_PTR(-ENAMETOOLONG);
+
+	return crypto_alloc_aead(name, 0, 0);
+}
+
 int tls_set_sw_offload(struct sock *sk, int tx)
 {
 	struct tls_sw_context_tx *sw_ctx_tx = NULL;
@@ -2741,7 +2773,7 @@ int tls_set_sw_offload(struct sock *sk, int tx)
 	memcpy(cctx->rec_seq, rec_seq, cipher_desc->rec_seq);
 
 	if (!*aead) {
-		*aead = crypto_alloc_aead(cipher_desc->cipher_name, 0, 0);
+		*aead = tls_alloc_aead(ctx, cipher_desc, tx);
 		if (IS_ERR(*aead)) {
 			rc = PTR_ERR(*aead);
 			*aead = NULL;
@@ -2759,6 +2791,12 @@ int tls_set_sw_offload(struct sock *sk, int tx)
 	if (rc)
 		goto free_aead;
 
+	/* Keep the records in flight from the start, rather than encrypting
+	 * straight from user pages, which has to wait for the crypto.
+	 */
+	if (sw_ctx_tx && ctx->tx_parallel)
+		sw_ctx_tx->async_capable = 1;
+
 	if (sw_ctx_rx) {
 		tfm = crypto_aead_tfm(sw_ctx_rx->aead_recv);
 
@@ -772,9 +772,50 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 	return ERR_PTR(err);
 }
 
+/* Hand the packets built by __xsk_generic_xmit() to the driver in one go.
+ * Their descriptors are the last ones consumed from the TX ring, so the
+ * ones the driver didn't take can be given back for user-space to retry.
+ */
+static int xsk_generic_xmit_list(struct xdp_sock *xs, struct sk_buff **list,
+				 bool *sent_frame)
+{
+	struct sk_buff *skb, *next;
+	u32 descs = 0;
+	int err;
+
+	if (!*list)
+		return 0;
+
+	skb = __dev_direct_xmit_list(*list, xs->queue_id, &err);
+	if (skb != *list)
+		*sent_frame = true;
+	*list = NULL;
+
+	if (skb) {
+		for (; skb; skb = next) {
+			next = skb->next;
+			skb_mark_not_on_list(skb);
+			descs += xsk_get_num_desc(skb);
+			xsk_consume_skb(skb);
+		}
+		/* Tell user-space to retry the send */
+		xskq_cons_cancel_n(xs->tx, descs);
+		return -EAGAIN;
+	}
+
+	/* Ignore NET_XMIT_CN as packet might have been sent */
+	if (err == NET_XMIT_DROP) {
+		/* SKB completed but not sent */
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
 static int __xsk_generic_xmit(struct sock *sk)
 {
 	struct xdp_sock *xs = xdp_sk(sk);
+	struct sk_buff *list = NULL, **tail = &list;
 	u32 max_batch = TX_BATCH_SIZE;
 	bool sent_frame = false;
 	struct xdp_desc desc;
@@ -798,6 +839,17 @@ static int __xsk_generic_xmit(struct sock *sk)
 			goto out;
 		}
 
+		/* Send what was built before starting a multi-buffer packet,
+		 * so that a partially built packet is never left behind the
+		 * list when its descriptors have to be given back.
+		 */
+		if (!xs->skb && xp_mb_desc(&desc) && list) {
+			err = xsk_generic_xmit_list(xs, &list, &sent_frame);
+			tail = &list;
+			if (err)
+				goto out;
+		}
+
 		/* This is the backpressure mechanism for the Tx path.
 		 * Reserve space in the completion queue and only proceed
 		 * if there is space in it. This avoids having to implement
@@ -822,27 +874,15 @@ static int __xsk_generic_xmit(struct sock *sk)
 			continue;
 		}
 
-		err = __dev_direct_xmit(skb, xs->queue_id);
-		if  (err == NETDEV_TX_BUSY) {
-			/* Tell user-space to retry the send */
-			xskq_cons_cancel_n(xs->tx, xsk_get_num_desc(skb));
-			xsk_consume_skb(skb);
-			err = -EAGAIN;
-			goto out;
-		}
-
-		/* Ignore NET_XMIT_CN as packet might have been sent */
-		if (err == NET_XMIT_DROP) {
-			/* SKB completed but not sent */
-			err = -EBUSY;
-			xs->skb = NULL;
-			goto out;
-		}
-
-		sent_frame = true;
 		xs->skb = NULL;
+		*tail = skb;
+		tail = &skb->next;
 	}
 
+	err = xsk_generic_xmit_list(xs, &list, &sent_frame);
+	if (err)
+		goto out;
+
 	if (xskq_has_descs(xs->tx)) {
 		if (xs->skb)
 			xsk_drop_skb(xs->skb);
@@ -850,6 +890,13 @@ static int __xsk_generic_xmit(struct sock *sk)
 	}
 
 out:
+	if (list) {
+		int ret = xsk_generic_xmit_list(xs, &list, &sent_frame);
+
+		if (ret)
+			err = ret;
+	}
+
 	if (sent_frame)
 		if (xsk_tx_writeable(xs))
 			sk->sk_write_space(sk);
@@ -1162,7 +1209,10 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 
 	flags = sxdp->sxdp_flags;
 	if (flags & ~(XDP_SHARED_UMEM | XDP_COPY | XDP_ZEROCOPY |
-		      XDP_USE_NEED_WAKEUP | XDP_USE_SG))
+		      XDP_USE_NEED_WAKEUP | XDP_USE_SG | XDP_SHARED_FQ))
+		return -EINVAL;
+
+	if ((flags & XDP_SHARED_FQ) && !(flags & XDP_SHARED_UMEM))
 		return -EINVAL;
 
 	bound_dev_if = READ_ONCE(sk->sk_bound_dev_if);
@@ -1231,6 +1281,19 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 				goto out_unlock;
 			}
 
+			/* Take buffers from the fill ring of umem_xs */
+			if (flags & XDP_SHARED_FQ) {
+				err = umem_xs->dev == dev ?
+				      xp_share_fq(xs->pool, umem_xs->pool) :
+				      -EINVAL;
+				if (err) {
+					xp_destroy(xs->pool);
+					xs->pool = NULL;
+					sockfd_put(sock);
+					goto out_unlock;
+				}
+			}
+
 			err = xp_assign_dev_shared(xs->pool, umem_xs, dev,
 						   qid);
 			if (err) {
@@ -1241,7 +1304,7 @@ static int xsk_bind(struct socket *sock, struct sockaddr *addr, int addr_len)
 			}
 		} else {
 			/* Share the buffer pool with the other socket. */
-			if (xs->fq_tmp || xs->cq_tmp) {
+			if (xs->fq_tmp || xs->cq_tmp || (flags & XDP_SHARED_FQ)) {
 				/* Do not allow setting your own fq or cq. */
 				err = -EINVAL;
 				sockfd_put(sock);
@@ -37,6 +37,7 @@ void xp_destroy(struct xsk_buff_pool *pool)
 	if (!pool)
 		return;
 
+	xp_put_pool(pool->fq_owner);
 	kvfree(pool->tx_descs);
 	kvfree(pool->heads);
 	kvfree(pool);
@@ -261,6 +262,35 @@ int xp_assign_dev_shared(struct xsk_buff_pool *pool, struct xdp_sock *umem_xs,
 	return xp_assign_dev(pool, dev, queue_id, flags);
 }
 
+/**
+ * xp_share_fq - take buffers from the fill queue of another pool
+ * @pool: a pool without a fill queue of its own, not yet assigned to a queue
+ * @umem_pool: the pool of the socket whose umem is shared
+ *
+ * From now on, all pools consuming the fill queue serialize on its
+ * cons_lock.
+ */
+int xp_share_fq(struct xsk_buff_pool *pool, struct xsk_buff_pool *umem_pool)
+{
+	struct xsk_buff_pool *owner = umem_pool->fq_owner ?: umem_pool;
+
+	if (pool->fq || !owner->fq)
+		return -EINVAL;
+
+	if (!owner->fq_shared) {
+		WRITE_ONCE(owner->fq_shared, true);
+		/* Wait for the owner's datapath to notice the lock */
+		synchronize_net();
+	}
+
+	xp_get_pool(owner);
+	pool->fq_owner = owner;
+	pool->fq = owner->fq;
+	pool->fq_shared = true;
+
+	return 0;
+}
+
 void xp_clear_dev(struct xsk_buff_pool *pool)
 {
 	if (!pool->netdev)
@@ -281,10 +311,9 @@ static void xp_release_deferred(struct work_struct *work)
 	xp_clear_dev(pool);
 	rtnl_unlock();
 
-	if (pool->fq) {
+	if (pool->fq && !pool->fq_owner)
 		xskq_destroy(pool->fq);
-		pool->fq = NULL;
-	}
+	pool->fq = NULL;
 
 	if (pool->cq) {
 		xskq_destroy(pool->cq);
@@ -538,12 +567,30 @@ static struct xdp_buff_xsk *__xp_alloc(struct xsk_buff_pool *pool)
 	return xskb;
 }
 
+static bool xp_fq_lock(struct xsk_buff_pool *pool)
+{
+	bool shared = READ_ONCE(pool->fq_shared);
+
+	if (shared)
+		spin_lock_bh(&pool->fq->cons_lock);
+	return shared;
+}
+
+static void xp_fq_unlock(struct xsk_buff_pool *pool, bool shared)
+{
+	if (shared)
+		spin_unlock_bh(&pool->fq->cons_lock);
+}
+
 struct xdp_buff *xp_alloc(struct xsk_buff_pool *pool)
 {
 	struct xdp_buff_xsk *xskb;
+	bool shared;
 
 	if (!pool->free_list_cnt) {
+		shared = xp_fq_lock(pool);
 		xskb = __xp_alloc(pool);
+		xp_fq_unlock(pool, shared);
 		if (!xskb)
 			return NULL;
 	} else {
@@ -648,6 +695,7 @@ static u32 xp_alloc_slow(struct xsk_buff_pool *pool, struct xdp_buff **xdp,
 u32 xp_alloc_batch(struct xsk_buff_pool *pool, struct xdp_buff **xdp, u32 max)
 {
 	u32 nb_entries1 = 0, nb_entries2;
+	bool shared;
 
 	if (unlikely(pool->dev && dma_dev_need_sync(pool->dev)))
 		return xp_alloc_slow(pool, xdp, max);
@@ -661,9 +709,11 @@ u32 xp_alloc_batch(struct xsk_buff_pool *pool, struct xdp_buff **xdp, u32 max)
 		xdp += nb_entries1;
 	}
 
+	shared = xp_fq_lock(pool);
 	nb_entries2 = xp_alloc_new_from_fq(pool, xdp, max);
 	if (!nb_entries2)
 		pool->fq->queue_empty_descs++;
+	xp_fq_unlock(pool, shared);
 
 	return nb_entries1 + nb_entries2;
 }
@@ -672,14 +722,17 @@ EXPORT_SYMBOL(xp_alloc_batch);
 bool xp_can_alloc(struct xsk_buff_pool *pool, u32 count)
 {
 	u32 req_count, avail_count;
+	bool shared;
 
 	if (pool->free_list_cnt >= count)
 		return true;
 
 	req_count = count - pool->free_list_cnt;
+	shared = xp_fq_lock(pool);
 	avail_count = xskq_cons_nb_entries(pool->fq, req_count);
 	if (!avail_count)
 		pool->fq->queue_empty_descs++;
+	xp_fq_unlock(pool, shared);
 
 	return avail_count >= req_count;
 }
@@ -32,6 +32,7 @@ struct xsk_queue *xskq_create(u32 nentries, bool umem_queue)
 
 	q->nentries = nentries;
 	q->ring_mask = nentries - 1;
+	spin_lock_init(&q->cons_lock);
 
 	size = xskq_get_ring_size(q, umem_queue);
 
@@ -46,6 +46,8 @@ struct xsk_queue {
 	u64 invalid_descs;
 	u64 queue_empty_descs;
 	size_t ring_vmalloc_size;
+	/* Serializes consumers of a fill queue shared by several pools */
+	spinlock_t cons_lock;
 };
 
 struct parsed_desc {
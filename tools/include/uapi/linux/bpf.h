@@ -1140,6 +1140,7 @@ enum bpf_link_type {
 	BPF_LINK_TYPE_UPROBE_MULTI = 12,
 	BPF_LINK_TYPE_NETKIT = 13,
 	BPF_LINK_TYPE_SOCKMAP = 14,
+	BPF_LINK_TYPE_TRACING_MULTI = 15,
 	__MAX_BPF_LINK_TYPE,
 };
 
@@ -1412,6 +1413,32 @@ enum {
 
 /* Do not translate kernel bpf_arena pointers to user pointers */
 	BPF_F_NO_USER_CONV	= (1U << 18),
+
+/* Keep a multibit index of an LPM trie for faster full-length lookups */
+	BPF_F_LPM_MULTIBIT	= (1U << 19),
+
+/* Shard the LRU list of an LRU hash map per CPU, with approximate global
+ * eviction.  Not compatible with BPF_F_NO_COMMON_LRU.
+ */
+	BPF_F_SHARDED_LRU	= (1U << 20),
+
+/* Grow and shrink the buckets of a hash map with the number of elements,
+ * instead of sizing them for max_entries.  Requires BPF_F_NO_PREALLOC.
+ */
+	BPF_F_RESIZABLE		= (1U << 21),
+
+/* Give a ring buffer map one ring of max_entries bytes per possible CPU.
+ * Programs reserve in the ring of the CPU they run on.  The rings of CPU N
+ * are mmap()'ed at page offset N * (2 + 2 * max_entries / page size) of the
+ * map fd, each laid out like a single ring buffer, and poll() reports data
+ * in any of them.  The last 8 bytes of every record hold its reserve time
+ * (CLOCK_MONOTONIC ns) after the sample padded to 8 bytes.
+ *
+ * With a value_size, BPF_MAP_LOOKUP_AND_DELETE_BATCH consumes the oldest
+ * records of all rings into value_size slots of batch.values: an 8-byte
+ * header with the record length and the CPU, then the record.
+ */
+	BPF_F_RINGBUF_PERCPU	= (1U << 22),
 };
 
 /* Flags for BPF_PROG_QUERY. */
@@ -1748,6 +1775,17 @@ union bpf_attr {
 				 * accessible through bpf_get_attach_cookie() BPF helper
 				 */
 				__u64		cookie;
+				/* With cnt != 0, attach a fentry, fexit or
+				 * fmod_ret prog to cnt kernel functions at
+				 * once. btf_ids are FUNC ids in the prog's
+				 * attach BTF, all with the prototype of its
+				 * attach_btf_id. cookies is optional, with
+				 * cnt entries. target_btf_id and cookie
+				 * must be 0.
+				 */
+				__aligned_u64	btf_ids;
+				__aligned_u64	cookies;
+				__u32		cnt;
 			} tracing;
 			struct {
 				__u32		pf;
@@ -6482,6 +6520,18 @@ struct bpf_cpumap_val {
 		int   fd;	/* prog fd on map write */
 		__u32 id;	/* prog id on map read */
 	} bpf_prog;
+	__u32 flags;	/* BPF_CPUMAP_F_* */
+	__u32 pad;
+	/* Counters of the target CPU, read-only and reset on map write */
+	__u64 packets;		/* frames and skbs taken off the queue */
+	__u64 drops;		/* dropped by the program or skb alloc/build */
+	__u64 gro_merged;	/* merged by BPF_CPUMAP_F_GRO */
+};
+
+/* Flags for bpf_cpumap_val.flags */
+enum {
+	/* Pass packets through GRO before the stack, as NAPI does */
+	BPF_CPUMAP_F_GRO	= (1U << 0),
 };
 
 enum sk_action {
@@ -74,6 +74,19 @@ enum netdev_qstats_scope {
 	NETDEV_QSTATS_SCOPE_QUEUE = 1,
 };
 
+/**
+ * enum netdev_napi_threaded - NAPI polling mode.
+ * @NETDEV_NAPI_THREADED_DISABLED: NAPI is polled from softirq context.
+ * @NETDEV_NAPI_THREADED_ENABLED: NAPI is polled by its own kthread.
+ * @NETDEV_NAPI_THREADED_BUSY_POLL: NAPI kthread busy polls with the IRQ
+ *   suspended while there is traffic.
+ */
+enum netdev_napi_threaded {
+	NETDEV_NAPI_THREADED_DISABLED,
+	NETDEV_NAPI_THREADED_ENABLED,
+	NETDEV_NAPI_THREADED_BUSY_POLL,
+};
+
 enum {
 	NETDEV_A_DEV_IFINDEX = 1,
 	NETDEV_A_DEV_PAD,
@@ -94,6 +107,7 @@ enum {
 	NETDEV_A_PAGE_POOL_INFLIGHT_MEM,
 	NETDEV_A_PAGE_POOL_DETACH_TIME,
 	NETDEV_A_PAGE_POOL_DMABUF,
+	NETDEV_A_PAGE_POOL_ALLOC_CACHE_TARGET,
 
 	__NETDEV_A_PAGE_POOL_MAX,
 	NETDEV_A_PAGE_POOL_MAX = (__NETDEV_A_PAGE_POOL_MAX - 1)
@@ -122,6 +136,10 @@ enum {
 	NETDEV_A_NAPI_ID,
 	NETDEV_A_NAPI_IRQ,
 	NETDEV_A_NAPI_PID,
+	NETDEV_A_NAPI_THREADED,
+	NETDEV_A_NAPI_BUSY_POLL_IDLE_USECS,
+	NETDEV_A_NAPI_BUSY_POLL_PRODUCTIVE,
+	NETDEV_A_NAPI_BUSY_POLL_EMPTY,
 
 	__NETDEV_A_NAPI_MAX,
 	NETDEV_A_NAPI_MAX = (__NETDEV_A_NAPI_MAX - 1)
@@ -199,6 +217,8 @@ enum {
 	NETDEV_CMD_NAPI_GET,
 	NETDEV_CMD_QSTATS_GET,
 	NETDEV_CMD_BIND_RX,
+	NETDEV_CMD_NAPI_SET,
+	NETDEV_CMD_BIND_TX,
 
 	__NETDEV_CMD_MAX,
 	NETDEV_CMD_MAX = (__NETDEV_CMD_MAX - 1)
@@ -22,6 +22,7 @@ int bench_numa(int argc, const char **argv);
 int bench_sched_messaging(int argc, const char **argv);
 int bench_sched_pipe(int argc, const char **argv);
 int bench_sched_seccomp_notify(int argc, const char **argv);
+int bench_sched_seccomp_filter(int argc, const char **argv);
 int bench_syscall_basic(int argc, const char **argv);
 int bench_syscall_getpgid(int argc, const char **argv);
 int bench_syscall_fork(int argc, const char **argv);
@@ -49,6 +50,18 @@ int bench_uprobe_trace_printk(int argc, const char **argv);
 int bench_uprobe_empty_ret(int argc, const char **argv);
 int bench_uprobe_trace_printk_ret(int argc, const char **argv);
 int bench_pmu_scan(int argc, const char **argv);
+int bench_net_tcp_stream(int argc, const char **argv);
+int bench_net_tcp_rr(int argc, const char **argv);
+int bench_net_udp_stream(int argc, const char **argv);
+int bench_net_unix_stream(int argc, const char **argv);
+int bench_net_unix_dgram(int argc, const char **argv);
+int bench_mm_fault(int argc, const char **argv);
+int bench_mm_zap(int argc, const char **argv);
+int bench_mm_mprotect(int argc, const char **argv);
+int bench_mm_swap(int argc, const char **argv);
+int bench_io_dio(int argc, const char **argv);
+int bench_io_buffered(int argc, const char **argv);
+int bench_io_poll(int argc, const char **argv);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
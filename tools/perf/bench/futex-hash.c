@@ -21,6 +21,7 @@
 #include <linux/zalloc.h>
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/prctl.h>
 #include <perf/cpumap.h>
 
 #include "../util/mutex.h"
@@ -31,6 +32,12 @@
 
 #include <err.h>
 
+#ifndef PR_FUTEX_HASH
+#define PR_FUTEX_HASH			74
+# define PR_FUTEX_HASH_SET_PRIVATE	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+#endif
+
 static bool done = false;
 static int futex_flag = 0;
 
@@ -59,6 +66,7 @@ static const struct option options[] = {
 	OPT_BOOLEAN( 's', "silent",  &params.silent, "Silent mode: do not display data/details"),
 	OPT_BOOLEAN( 'S', "shared",  &params.fshared, "Use shared futexes instead of private ones"),
 	OPT_BOOLEAN( 'm', "mlockall", &params.mlockall, "Lock all current and future memory"),
+	OPT_BOOLEAN( 'p', "private-hash", &params.private_hash, "Use a per-process hash for private futexes"),
 	OPT_END()
 };
 
@@ -162,8 +170,17 @@ int bench_futex_hash(int argc, const char **argv)
 	if (!params.fshared)
 		futex_flag = FUTEX_PRIVATE_FLAG;
 
-	printf("Run summary [PID %d]: %d threads, each operating on %d [%s] futexes for %d secs.\n\n",
+	/* Must happen before any thread is created. */
+	if (params.private_hash &&
+	    prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_SET_PRIVATE, params.nthreads, 0, 0))
+		err(EXIT_FAILURE, "prctl(PR_FUTEX_HASH)");
+
+	printf("Run summary [PID %d]: %d threads, each operating on %d [%s] futexes for %d secs.\n",
 	       getpid(), params.nthreads, params.nfutexes, params.fshared ? "shared":"private", params.runtime);
+	if (params.private_hash)
+		printf("Private futex hash: %d slots.\n",
+		       prctl(PR_FUTEX_HASH, PR_FUTEX_HASH_GET_SLOTS, 0, 0, 0));
+	printf("\n");
 
 	init_stats(&throughput_stats);
 	mutex_init(&thread_lock);
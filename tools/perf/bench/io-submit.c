@@ -0,0 +1,431 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io-submit.c
+ *
+ * Block layer and filesystem I/O submission path benchmarks:
+ *
+ *   dio       random O_DIRECT reads
+ *   buffered  sequential buffered reads through readahead
+ *   poll      random O_DIRECT reads polled with RWF_HIPRI
+ *
+ * Without -d a null_blk device is created through configfs for the
+ * duration of the run, so the numbers are block layer overhead and do
+ * not depend on any hardware.  -d takes a block device or a file, e.g.
+ * one on an ext4 or btrfs filesystem made on a null_blk device, to
+ * measure the filesystem direct I/O path on top.
+ *
+ * Every thread does synchronous reads, one at a time, and is pinned to
+ * its own CPU with -p, so per core IOPS and per I/O latency can be
+ * compared between kernels.
+ */
+#include <subcmd/parse-options.h>
+#include "../util/string2.h"
+#include "bench.h"
+#include "lat-hist.h"
+
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <linux/time64.h>
+
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef RWF_HIPRI
+#define RWF_HIPRI	0x00000001
+#endif
+
+#define NULLB_CONFIGFS	"/sys/kernel/config/nullb"
+
+static unsigned int nr_threads = 1;
+static unsigned int runtime = 5;
+static unsigned int block_size = 4096;
+static unsigned int irqmode;
+static unsigned int completion_nsec;
+static const char *size_str = "1GB";
+static const char *device;
+static bool pin_cpus;
+static bool show_hist;
+
+static const struct option options[] = {
+	OPT_STRING('d', "device", &device, "path",
+		   "Block device or file to read (default: a new null_blk device)"),
+	OPT_STRING('s', "size", &size_str, "1GB",
+		   "Specify the size of the null_blk device, or how much of the "
+		   "device or file to read. "
+		   "Available units: B, KB, MB, GB and TB (case insensitive)"),
+	OPT_UINTEGER('b', "block-size", &block_size,
+		     "Specify the I/O size in bytes (default: 4096)"),
+	OPT_UINTEGER('t', "threads", &nr_threads, "Specify amount of threads"),
+	OPT_UINTEGER('r', "runtime", &runtime, "Specify runtime (in seconds)"),
+	OPT_BOOLEAN('p', "pin", &pin_cpus, "Pin thread N to the Nth online CPU"),
+	OPT_UINTEGER('i', "irqmode", &irqmode,
+		     "null_blk completion mode: 0 none, 1 softirq, 2 timer"),
+	OPT_UINTEGER('c', "completion-nsec", &completion_nsec,
+		     "null_blk completion delay in timer irqmode"),
+	OPT_BOOLEAN('L', "histogram", &show_hist,
+		    "Print the full latency histogram"),
+	OPT_END()
+};
+
+static const char * const bench_io_usage[] = {
+	"perf bench io <dio|buffered|poll> <options>",
+	NULL
+};
+
+enum io_mode {
+	IO_DIO,
+	IO_BUFFERED,
+	IO_POLL,
+};
+
+struct io_worker {
+	pthread_t thread;
+	unsigned int id;
+	int fd;
+	struct lat_hist hist;
+};
+
+static enum io_mode mode;
+static uint64_t span;
+static volatile bool done;
+static cpu_set_t online_cpus;
+static char nullb_dir[PATH_MAX];
+static char nullb_dev[PATH_MAX];
+
+static int nullb_write(const char *attr, unsigned long val)
+{
+	char path[PATH_MAX];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s/%s", nullb_dir, attr);
+	f = fopen(path, "w");
+	if (!f)
+		return -errno;
+	ret = fprintf(f, "%lu\n", val) < 0 ? -EIO : 0;
+	if (fclose(f) && !ret)
+		ret = -errno;
+	return ret;
+}
+
+static void nullb_destroy(void)
+{
+	if (!nullb_dir[0])
+		return;
+	nullb_write("power", 0);
+	if (rmdir(nullb_dir))
+		warn("can't remove %s", nullb_dir);
+	nullb_dir[0] = '\0';
+}
+
+/* Create a memory backed blk-mq null_blk device of @bytes. */
+static int nullb_create(uint64_t bytes)
+{
+	unsigned int index;
+	char path[PATH_MAX];
+	FILE *f;
+
+	snprintf(nullb_dir, sizeof(nullb_dir), "%s/perf-bench-%d",
+		 NULLB_CONFIGFS, getpid());
+	if (mkdir(nullb_dir, 0755)) {
+		fprintf(stderr, "Can't create %s: %s\n"
+			"Is null_blk loaded and configfs mounted?\n",
+			nullb_dir, strerror(errno));
+		nullb_dir[0] = '\0';
+		return -1;
+	}
+
+	if (nullb_write("size", DIV_ROUND_UP(bytes, 1024 * 1024)) ||
+	    nullb_write("blocksize", min(block_size, 4096U)) ||
+	    nullb_write("memory_backed", 1) ||
+	    nullb_write("queue_mode", 2) ||
+	    nullb_write("submit_queues", CPU_COUNT(&online_cpus)) ||
+	    nullb_write("irqmode", irqmode) ||
+	    (irqmode == 2 && nullb_write("completion_nsec", completion_nsec)) ||
+	    (mode == IO_POLL && nullb_write("poll_queues", nr_threads)) ||
+	    nullb_write("power", 1)) {
+		fprintf(stderr, "Can't configure %s\n", nullb_dir);
+		goto err;
+	}
+
+	snprintf(path, sizeof(path), "%s/index", nullb_dir);
+	f = fopen(path, "r");
+	if (!f || fscanf(f, "%u", &index) != 1) {
+		fprintf(stderr, "Can't read %s\n", path);
+		if (f)
+			fclose(f);
+		goto err;
+	}
+	fclose(f);
+
+	snprintf(nullb_dev, sizeof(nullb_dev), "/dev/nullb%u", index);
+	device = nullb_dev;
+	return 0;
+err:
+	nullb_destroy();
+	return -1;
+}
+
+/* Fill a memory backed device, reads of unwritten blocks skip the copy. */
+static int fill_device(int fd)
+{
+	char *buf = calloc(1, 1024 * 1024);
+	uint64_t off;
+
+	if (!buf)
+		return -1;
+	memset(buf, 0x5a, 1024 * 1024);
+	for (off = 0; off < span; off += 1024 * 1024) {
+		if (pwrite(fd, buf, min_t(uint64_t, span - off, 1024 * 1024), off) < 0) {
+			free(buf);
+			return -1;
+		}
+	}
+	free(buf);
+	return fsync(fd);
+}
+
+static void pin_worker(unsigned int id)
+{
+	unsigned int cpu, n = 0;
+	cpu_set_t set;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &online_cpus))
+			continue;
+		if (n++ == id % CPU_COUNT(&online_cpus))
+			break;
+	}
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		errx(EXIT_FAILURE, "can't pin thread %u to CPU %u", id, cpu);
+}
+
+static void *workerfn(void *arg)
+{
+	struct io_worker *w = arg;
+	uint64_t nr_blocks = span / block_size;
+	uint64_t seed = 0x9e3779b97f4a7c15ULL * (w->id + 1);
+	uint64_t share = max_t(uint64_t, nr_blocks / nr_threads, 1);
+	uint64_t first = share * w->id % nr_blocks;
+	uint64_t seq = first;
+	struct iovec iov;
+	void *buf;
+
+	if (posix_memalign(&buf, 4096, block_size))
+		err(EXIT_FAILURE, "posix_memalign");
+	iov.iov_base = buf;
+	iov.iov_len = block_size;
+
+	if (pin_cpus)
+		pin_worker(w->id);
+
+	while (!done) {
+		uint64_t off, t0;
+		ssize_t ret;
+
+		if (mode == IO_BUFFERED) {
+			/*
+			 * Sequential within this thread's share of the span,
+			 * dropping it from the page cache at the end of each
+			 * pass so that every pass goes through readahead.
+			 */
+			if (seq >= min(first + share, nr_blocks)) {
+				posix_fadvise(w->fd, first * block_size,
+					      share * block_size, POSIX_FADV_DONTNEED);
+				seq = first;
+			}
+			off = seq++ * block_size;
+		} else {
+			seed ^= seed << 13;
+			seed ^= seed >> 7;
+			seed ^= seed << 17;
+			off = (seed % nr_blocks) * block_size;
+		}
+
+		t0 = lat_now_ns();
+		ret = preadv2(w->fd, &iov, 1, off, mode == IO_POLL ? RWF_HIPRI : 0);
+		if (ret != (ssize_t)block_size)
+			err(EXIT_FAILURE, "read at %" PRIu64, off);
+		lat_hist_add(&w->hist, lat_now_ns() - t0);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static int open_target(void)
+{
+	int flags = mode == IO_BUFFERED ? O_RDONLY : O_RDONLY | O_DIRECT;
+	struct stat st;
+	uint64_t dev_size = 0;
+	int fd;
+
+	fd = open(device, flags);
+	if (fd < 0) {
+		fprintf(stderr, "Can't open %s: %s\n", device, strerror(errno));
+		return -1;
+	}
+	if (fstat(fd, &st))
+		goto err;
+	if (S_ISBLK(st.st_mode)) {
+		if (ioctl(fd, BLKGETSIZE64, &dev_size))
+			goto err;
+	} else {
+		dev_size = st.st_size;
+	}
+
+	if (!span || span > dev_size)
+		span = dev_size;
+	span -= span % block_size;
+	if (!span) {
+		fprintf(stderr, "%s is smaller than one block\n", device);
+		goto err_close;
+	}
+
+	/* Start the buffered case from a cold page cache. */
+	if (mode == IO_BUFFERED)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	return fd;
+err:
+	fprintf(stderr, "Can't size %s: %s\n", device, strerror(errno));
+err_close:
+	close(fd);
+	return -1;
+}
+
+static int run_io_bench(const char *name)
+{
+	struct timeval start, stop, diff;
+	struct lat_hist hist = {};
+	struct io_worker *workers;
+	unsigned int i;
+	double secs;
+	int fd, ret = 1;
+
+	span = (uint64_t)perf_atoll((char *)size_str);
+	if ((s64)span <= 0 || !block_size || block_size % 512 || !nr_threads) {
+		fprintf(stderr, "Invalid size:%s or block size:%u\n",
+			size_str, block_size);
+		return 1;
+	}
+	if (sched_getaffinity(0, sizeof(online_cpus), &online_cpus))
+		err(EXIT_FAILURE, "sched_getaffinity");
+
+	if (!device) {
+		if (nullb_create(span))
+			return 1;
+		fd = open(device, O_WRONLY);
+		if (fd < 0 || fill_device(fd)) {
+			fprintf(stderr, "Can't fill %s: %s\n", device, strerror(errno));
+			if (fd >= 0)
+				close(fd);
+			goto out_nullb;
+		}
+		close(fd);
+	}
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		err(EXIT_FAILURE, "calloc");
+
+	for (i = 0; i < nr_threads; i++)
+		workers[i].fd = -1;
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		workers[i].fd = open_target();
+		if (workers[i].fd < 0)
+			goto out_close;
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_threads; i++) {
+		if (pthread_create(&workers[i].thread, NULL, workerfn, &workers[i]))
+			err(EXIT_FAILURE, "pthread_create");
+	}
+	sleep(runtime);
+	done = true;
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		lat_hist_merge(&hist, &workers[i].hist);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	secs = diff.tv_sec + (double)diff.tv_usec / USEC_PER_SEC;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %s: %s, %u byte reads, %u threads%s\n\n", name, device,
+		       block_size, nr_threads, pin_cpus ? ", pinned" : "");
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       (unsigned long)diff.tv_sec,
+		       (unsigned long)(diff.tv_usec / USEC_PER_MSEC));
+		printf(" %14.0lf IOPS\n", (double)hist.count / secs);
+		printf(" %14.0lf IOPS/thread\n", (double)hist.count / secs / nr_threads);
+		printf(" %14.3lf MB/sec\n\n",
+		       (double)hist.count * block_size / secs / (1024 * 1024));
+		lat_hist_print("read", &hist, show_hist);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.0lf\n", (double)hist.count / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+	ret = 0;
+
+out_close:
+	for (i = 0; i < nr_threads; i++) {
+		if (workers[i].fd >= 0)
+			close(workers[i].fd);
+	}
+	free(workers);
+out_nullb:
+	nullb_destroy();
+	return ret;
+}
+
+int bench_io_dio(int argc, const char **argv)
+{
+	argc = parse_options(argc, argv, options, bench_io_usage, 0);
+	mode = IO_DIO;
+	return run_io_bench("dio");
+}
+
+int bench_io_buffered(int argc, const char **argv)
+{
+	argc = parse_options(argc, argv, options, bench_io_usage, 0);
+	mode = IO_BUFFERED;
+	return run_io_bench("buffered");
+}
+
+int bench_io_poll(int argc, const char **argv)
+{
+	argc = parse_options(argc, argv, options, bench_io_usage, 0);
+	mode = IO_POLL;
+	return run_io_bench("poll");
+}
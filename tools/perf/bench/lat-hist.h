@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Log2 latency histograms for benchmarks which time individual operations.
+ *
+ * Bucket 0 counts latencies under 1ns and bucket i those in [2^(i-1), 2^i)
+ * ns, so percentiles are accurate to a factor of two.  Each thread fills
+ * its own histogram and they are merged at the end.
+ */
+#ifndef BENCH_LAT_HIST_H
+#define BENCH_LAT_HIST_H
+
+#include <linux/kernel.h>
+#include <linux/time64.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define LAT_HIST_BUCKETS	40
+
+struct lat_hist {
+	uint64_t buckets[LAT_HIST_BUCKETS];
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
+static inline uint64_t lat_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline void lat_hist_add(struct lat_hist *h, uint64_t ns)
+{
+	unsigned int b = ns ? min(64 - __builtin_clzll(ns), LAT_HIST_BUCKETS - 1) : 0;
+
+	h->buckets[b]++;
+	h->count++;
+	h->total_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+static inline void lat_hist_merge(struct lat_hist *dst, const struct lat_hist *src)
+{
+	unsigned int b;
+
+	for (b = 0; b < LAT_HIST_BUCKETS; b++)
+		dst->buckets[b] += src->buckets[b];
+	dst->count += src->count;
+	dst->total_ns += src->total_ns;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
+}
+
+/* Upper bound of the bucket the percentile falls into. */
+static inline uint64_t lat_hist_percentile(const struct lat_hist *h,
+					   unsigned int permille)
+{
+	uint64_t acc = 0;
+	unsigned int b;
+
+	for (b = 0; b < LAT_HIST_BUCKETS; b++) {
+		acc += h->buckets[b];
+		if (acc * 1000 >= h->count * permille)
+			break;
+	}
+	/* Never report more than the largest sample. */
+	return min_t(uint64_t, 1ULL << min(b, LAT_HIST_BUCKETS - 1U), h->max_ns);
+}
+
+static inline double lat_hist_avg_usec(const struct lat_hist *h)
+{
+	return h->count ? (double)h->total_ns / h->count / NSEC_PER_USEC : 0;
+}
+
+static inline void lat_hist_print(const char *op, const struct lat_hist *h,
+				  bool full)
+{
+	unsigned int b, last = 0;
+
+	if (!h->count)
+		return;
+
+	printf(" %14" PRIu64 " %s ops\n", h->count, op);
+	printf(" %14.3lf usecs/op avg\n", lat_hist_avg_usec(h));
+	printf(" %14.3lf usecs/op p50\n",
+	       (double)lat_hist_percentile(h, 500) / NSEC_PER_USEC);
+	printf(" %14.3lf usecs/op p99\n",
+	       (double)lat_hist_percentile(h, 990) / NSEC_PER_USEC);
+	printf(" %14.3lf usecs/op p99.9\n",
+	       (double)lat_hist_percentile(h, 999) / NSEC_PER_USEC);
+	printf(" %14.3lf usecs/op max\n\n", (double)h->max_ns / NSEC_PER_USEC);
+
+	if (!full)
+		return;
+
+	for (b = 0; b < LAT_HIST_BUCKETS; b++)
+		if (h->buckets[b])
+			last = b;
+	for (b = 0; b <= last; b++)
+		printf(" %12llu ns: %" PRIu64 "\n", 1ULL << b, h->buckets[b]);
+	printf("\n");
+}
+
+#endif /* BENCH_LAT_HIST_H */
@@ -0,0 +1,375 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mm-fault.c
+ *
+ * Page fault, unmap, mprotect and reclaim benchmarks:
+ *
+ *   fault     parallel first-touch anonymous faults, 4K or THP
+ *   zap       populate and zap with madvise(MADV_DONTNEED) or munmap()
+ *   mprotect  threads flipping the protection of their part of one mapping
+ *   swap      MADV_PAGEOUT a populated region and fault it back in
+ *
+ * Every thread works on its own memory in a shared mm, so the kernel side
+ * contention is on the mm (mmap_lock, page table locks, TLB shootdowns)
+ * and in the page allocator, not on the pages.  The latency of each
+ * operation is recorded in a log2 histogram.
+ *
+ * With -H the memory is madvise(MADV_HUGEPAGE)'d.  Which of PMD and mTHP
+ * sizes that gets is up to /sys/kernel/mm/transparent_hugepage/.  "swap"
+ * goes to whatever swap is configured, zram or a disk behind zswap.
+ */
+#include <subcmd/parse-options.h>
+#include "../util/string2.h"
+#include "bench.h"
+#include "lat-hist.h"
+
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <linux/time64.h>
+
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <err.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT	21
+#endif
+
+static unsigned int nr_threads;
+static unsigned int nr_loops = 10;
+static const char *size_str = "64MB";
+static const char *zap_str = "dontneed";
+static bool use_thp;
+static bool show_hist;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nr_threads,
+		     "Specify amount of threads (default: online CPUs)"),
+	OPT_UINTEGER('l', "nr_loops", &nr_loops,
+		     "Specify the number of loops to run (default: 10)"),
+	OPT_STRING('s', "size", &size_str, "64MB",
+		   "Specify the memory per thread. "
+		   "Available units: B, KB, MB, GB and TB (case insensitive)"),
+	OPT_BOOLEAN('H', "thp", &use_thp,
+		    "madvise(MADV_HUGEPAGE) the memory instead of MADV_NOHUGEPAGE"),
+	OPT_BOOLEAN('L', "histogram", &show_hist,
+		    "Print the full latency histogram"),
+	OPT_END()
+};
+
+static const struct option zap_options[] = {
+	OPT_UINTEGER('t', "threads", &nr_threads,
+		     "Specify amount of threads (default: online CPUs)"),
+	OPT_UINTEGER('l', "nr_loops", &nr_loops,
+		     "Specify the number of loops to run (default: 10)"),
+	OPT_STRING('s', "size", &size_str, "64MB",
+		   "Specify the memory per thread. "
+		   "Available units: B, KB, MB, GB and TB (case insensitive)"),
+	OPT_STRING('m', "mode", &zap_str, "dontneed",
+		   "How to zap the memory: dontneed or munmap"),
+	OPT_BOOLEAN('H', "thp", &use_thp,
+		    "madvise(MADV_HUGEPAGE) the memory instead of MADV_NOHUGEPAGE"),
+	OPT_BOOLEAN('L', "histogram", &show_hist,
+		    "Print the full latency histogram"),
+	OPT_END()
+};
+
+static const char * const bench_mm_usage[] = {
+	"perf bench mm <fault|zap|mprotect|swap> <options>",
+	NULL
+};
+
+struct mm_worker {
+	pthread_t thread;
+	unsigned int id;
+	char *mem;
+	struct lat_hist hist;
+	struct lat_hist hist2;
+};
+
+struct mm_bench {
+	const char *name;
+	const char *op;
+	const char *op2;
+	void (*prepare)(struct mm_worker *w);
+	void (*run)(struct mm_worker *w);
+};
+
+static size_t size;
+static size_t page_size;
+static size_t step;
+static char *shared_mem;
+static bool zap_munmap;
+static pthread_barrier_t start_barrier;
+
+static char *map_mem(size_t len)
+{
+	char *mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (mem == MAP_FAILED)
+		err(EXIT_FAILURE, "mmap");
+	madvise(mem, len, use_thp ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+	return mem;
+}
+
+/* Touch every @step bytes of @mem, timing each touch into @h if given. */
+static void touch_mem(char *mem, size_t len, struct lat_hist *h)
+{
+	size_t off;
+
+	for (off = 0; off < len; off += step) {
+		uint64_t t0;
+
+		if (!h) {
+			mem[off] = 1;
+			continue;
+		}
+		t0 = lat_now_ns();
+		mem[off] = 1;
+		lat_hist_add(h, lat_now_ns() - t0);
+	}
+}
+
+/* fault: fault the memory in, zap it untimed and repeat. */
+static void fault_run(struct mm_worker *w)
+{
+	unsigned int i;
+
+	w->mem = map_mem(size);
+	for (i = 0; i < nr_loops; i++) {
+		touch_mem(w->mem, size, &w->hist);
+		if (madvise(w->mem, size, MADV_DONTNEED))
+			err(EXIT_FAILURE, "madvise(MADV_DONTNEED)");
+	}
+	munmap(w->mem, size);
+}
+
+/* zap: populate untimed, time the zap. */
+static void zap_run(struct mm_worker *w)
+{
+	unsigned int i;
+	uint64_t t0;
+
+	if (!zap_munmap)
+		w->mem = map_mem(size);
+	for (i = 0; i < nr_loops; i++) {
+		if (zap_munmap)
+			w->mem = map_mem(size);
+		touch_mem(w->mem, size, NULL);
+
+		t0 = lat_now_ns();
+		if (zap_munmap ? munmap(w->mem, size) :
+				 madvise(w->mem, size, MADV_DONTNEED))
+			err(EXIT_FAILURE, "zap");
+		lat_hist_add(&w->hist, lat_now_ns() - t0);
+	}
+	if (!zap_munmap)
+		munmap(w->mem, size);
+}
+
+/*
+ * mprotect: all threads share one mapping.  Making a thread's part read
+ * only splits the vma and has to flush the TLBs of every CPU running a
+ * sibling, making it writable again merges it back.
+ */
+static void mprotect_prepare(struct mm_worker *w)
+{
+	w->mem = shared_mem + w->id * size;
+	touch_mem(w->mem, size, NULL);
+}
+
+static void mprotect_run(struct mm_worker *w)
+{
+	unsigned int i;
+	uint64_t t0;
+
+	for (i = 0; i < nr_loops; i++) {
+		t0 = lat_now_ns();
+		if (mprotect(w->mem, size, PROT_READ))
+			err(EXIT_FAILURE, "mprotect");
+		if (mprotect(w->mem, size, PROT_READ | PROT_WRITE))
+			err(EXIT_FAILURE, "mprotect");
+		lat_hist_add(&w->hist, lat_now_ns() - t0);
+		w->mem[i * page_size % size] = 1;
+	}
+}
+
+/* swap: time MADV_PAGEOUT of the region, then each swap-in fault. */
+static void swap_prepare(struct mm_worker *w)
+{
+	size_t off;
+
+	w->mem = map_mem(size);
+	/* Random-ish content, so zram and zswap can't just drop the pages. */
+	for (off = 0; off < size; off += sizeof(uint64_t))
+		*(uint64_t *)(w->mem + off) = off * 0x9e3779b97f4a7c15ULL + w->id;
+}
+
+static void swap_run(struct mm_worker *w)
+{
+	unsigned int i;
+	uint64_t t0;
+
+	for (i = 0; i < nr_loops; i++) {
+		t0 = lat_now_ns();
+		if (madvise(w->mem, size, MADV_PAGEOUT))
+			err(EXIT_FAILURE, "madvise(MADV_PAGEOUT)");
+		lat_hist_add(&w->hist2, lat_now_ns() - t0);
+		touch_mem(w->mem, size, &w->hist);
+	}
+	munmap(w->mem, size);
+}
+
+static const struct mm_bench *cur_bench;
+
+static void *mm_workerfn(void *arg)
+{
+	struct mm_worker *w = arg;
+
+	if (cur_bench->prepare)
+		cur_bench->prepare(w);
+	pthread_barrier_wait(&start_barrier);
+	cur_bench->run(w);
+	return NULL;
+}
+
+static int run_mm_bench(const struct mm_bench *b, int argc, const char **argv,
+			const struct option *opts)
+{
+	struct timeval start, stop, diff;
+	struct lat_hist hist = {}, hist2 = {};
+	struct mm_worker *workers;
+	unsigned int i;
+	double secs;
+
+	argc = parse_options(argc, argv, opts, bench_mm_usage, 0);
+
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	page_size = sysconf(_SC_PAGESIZE);
+	step = use_thp ? 512 * page_size : page_size;
+
+	size = (size_t)perf_atoll((char *)size_str);
+	if ((s64)size <= 0 || !nr_loops) {
+		fprintf(stderr, "Invalid size:%s\n", size_str);
+		return 1;
+	}
+	size = roundup(size, step);
+
+	if (!strcmp(zap_str, "munmap"))
+		zap_munmap = true;
+	else if (strcmp(zap_str, "dontneed"))
+		usage_with_options(bench_mm_usage, zap_options);
+
+	/* One vma to start with, not one per thread. */
+	if (b->run == mprotect_run)
+		shared_mem = map_mem(size * nr_threads);
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		err(EXIT_FAILURE, "calloc");
+	if (pthread_barrier_init(&start_barrier, NULL, nr_threads + 1))
+		err(EXIT_FAILURE, "pthread_barrier_init");
+
+	cur_bench = b;
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].id = i;
+		if (pthread_create(&workers[i].thread, NULL, mm_workerfn, &workers[i]))
+			err(EXIT_FAILURE, "pthread_create");
+	}
+
+	pthread_barrier_wait(&start_barrier);
+	gettimeofday(&start, NULL);
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		lat_hist_merge(&hist, &workers[i].hist);
+		lat_hist_merge(&hist2, &workers[i].hist2);
+	}
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	secs = diff.tv_sec + (double)diff.tv_usec / USEC_PER_SEC;
+
+	if (shared_mem)
+		munmap(shared_mem, size * nr_threads);
+	pthread_barrier_destroy(&start_barrier);
+	free(workers);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %s: %u threads, %s per thread, %u loops%s\n\n",
+		       b->name, nr_threads, size_str, nr_loops,
+		       use_thp ? ", MADV_HUGEPAGE" : "");
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       (unsigned long)diff.tv_sec,
+		       (unsigned long)(diff.tv_usec / USEC_PER_MSEC));
+		printf(" %14.0lf %s ops/sec\n\n", (double)hist.count / secs, b->op);
+		lat_hist_print(b->op, &hist, show_hist);
+		if (b->op2)
+			lat_hist_print(b->op2, &hist2, show_hist);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.3lf\n", lat_hist_avg_usec(&hist));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
+
+int bench_mm_fault(int argc, const char **argv)
+{
+	static const struct mm_bench b = {
+		.name = "fault", .op = "fault", .run = fault_run,
+	};
+
+	return run_mm_bench(&b, argc, argv, options);
+}
+
+int bench_mm_zap(int argc, const char **argv)
+{
+	static const struct mm_bench b = {
+		.name = "zap", .op = "zap", .run = zap_run,
+	};
+
+	return run_mm_bench(&b, argc, argv, zap_options);
+}
+
+int bench_mm_mprotect(int argc, const char **argv)
+{
+	static const struct mm_bench b = {
+		.name = "mprotect", .op = "mprotect pair",
+		.prepare = mprotect_prepare, .run = mprotect_run,
+	};
+
+	nr_loops = 1000;
+	return run_mm_bench(&b, argc, argv, options);
+}
+
+int bench_mm_swap(int argc, const char **argv)
+{
+	static const struct mm_bench b = {
+		.name = "swap", .op = "swap-in fault", .op2 = "pageout",
+		.prepare = swap_prepare, .run = swap_run,
+	};
+
+	return run_mm_bench(&b, argc, argv, options);
+}
@@ -0,0 +1,457 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net-loopback.c
+ *
+ * Networking stack microbenchmarks over loopback and socketpairs:
+ *
+ *   tcp-stream   bulk TCP transfer, optionally with MSG_ZEROCOPY
+ *   tcp-rr       TCP request/response transactions
+ *   udp-stream   bulk UDP transfer, optionally with UDP GSO and GRO
+ *   unix-stream  bulk AF_UNIX SOCK_STREAM transfer
+ *   unix-dgram   AF_UNIX SOCK_DGRAM messages
+ *
+ * A receiver thread and a sender thread, which can be pinned to CPUs,
+ * run for a fixed time.  Stream results are what the receiver got, so
+ * that UDP loss is not counted as throughput.
+ */
+#include <subcmd/parse-options.h>
+#include "bench.h"
+
+#include <linux/compiler.h>
+#include <linux/kernel.h>
+#include <linux/time64.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <err.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY	60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY	0x4000000
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP		17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT	103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO		104
+#endif
+
+static unsigned int runtime = 5;
+static unsigned int msg_size;
+static unsigned int gso_size;
+static int client_cpu = -1;
+static int server_cpu = -1;
+static bool zerocopy;
+
+static const struct option stream_options[] = {
+	OPT_UINTEGER('r', "runtime", &runtime, "Specify runtime (in seconds)"),
+	OPT_UINTEGER('s', "size", &msg_size, "Specify bytes per send"),
+	OPT_INTEGER('c', "client-cpu", &client_cpu, "Pin the sender to this CPU"),
+	OPT_INTEGER('S', "server-cpu", &server_cpu, "Pin the receiver to this CPU"),
+	OPT_END()
+};
+
+static const struct option tcp_stream_options[] = {
+	OPT_UINTEGER('r', "runtime", &runtime, "Specify runtime (in seconds)"),
+	OPT_UINTEGER('s', "size", &msg_size, "Specify bytes per send"),
+	OPT_INTEGER('c', "client-cpu", &client_cpu, "Pin the sender to this CPU"),
+	OPT_INTEGER('S', "server-cpu", &server_cpu, "Pin the receiver to this CPU"),
+	OPT_BOOLEAN('z', "zerocopy", &zerocopy, "Send with MSG_ZEROCOPY"),
+	OPT_END()
+};
+
+static const struct option udp_stream_options[] = {
+	OPT_UINTEGER('r', "runtime", &runtime, "Specify runtime (in seconds)"),
+	OPT_UINTEGER('s', "size", &msg_size, "Specify bytes per send"),
+	OPT_INTEGER('c', "client-cpu", &client_cpu, "Pin the sender to this CPU"),
+	OPT_INTEGER('S', "server-cpu", &server_cpu, "Pin the receiver to this CPU"),
+	OPT_UINTEGER('g', "gso", &gso_size,
+		     "Segment sends with UDP_SEGMENT of this size, receive with UDP_GRO"),
+	OPT_END()
+};
+
+static const char * const bench_net_usage[] = {
+	"perf bench net <tcp-stream|tcp-rr|udp-stream|unix-stream|unix-dgram> <options>",
+	NULL
+};
+
+enum net_bench_mode {
+	NET_BENCH_STREAM,
+	NET_BENCH_RR,
+};
+
+struct net_bench {
+	const char *name;
+	enum net_bench_mode mode;
+	int client_fd;
+	int server_fd;
+	bool dgram;
+	volatile bool done;
+	uint64_t bytes;		/* received by the server */
+	uint64_t ops;		/* sends, or transactions */
+};
+
+static void pin_to_cpu(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0)
+		return;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		errx(EXIT_FAILURE, "can't pin to CPU %d", cpu);
+}
+
+static void tcp_pair(int *client, int *server)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	int one = 1, lfd;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0)
+		err(EXIT_FAILURE, "socket");
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &len) ||
+	    listen(lfd, 1))
+		err(EXIT_FAILURE, "listen");
+
+	*client = socket(AF_INET, SOCK_STREAM, 0);
+	if (*client < 0)
+		err(EXIT_FAILURE, "socket");
+	if (connect(*client, (struct sockaddr *)&addr, sizeof(addr)))
+		err(EXIT_FAILURE, "connect");
+	*server = accept(lfd, NULL, NULL);
+	if (*server < 0)
+		err(EXIT_FAILURE, "accept");
+	close(lfd);
+
+	setsockopt(*client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	setsockopt(*server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static void udp_pair(int *client, int *server)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	struct timeval tv = { .tv_sec = 1 };
+	int one = 1;
+
+	*server = socket(AF_INET, SOCK_DGRAM, 0);
+	if (*server < 0)
+		err(EXIT_FAILURE, "socket");
+	if (bind(*server, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    getsockname(*server, (struct sockaddr *)&addr, &len))
+		err(EXIT_FAILURE, "bind");
+	*client = socket(AF_INET, SOCK_DGRAM, 0);
+	if (*client < 0)
+		err(EXIT_FAILURE, "socket");
+	/*
+	 * Neither side has an EOF to wait for, let both notice the end
+	 * instead of blocking on a peer which has stopped.
+	 */
+	setsockopt(*server, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(*client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	if (connect(*client, (struct sockaddr *)&addr, sizeof(addr)))
+		err(EXIT_FAILURE, "connect");
+
+	if (gso_size) {
+		int gso = gso_size;
+
+		if (setsockopt(*client, SOL_UDP, UDP_SEGMENT, &gso, sizeof(gso)))
+			err(EXIT_FAILURE, "UDP_SEGMENT");
+		if (setsockopt(*server, SOL_UDP, UDP_GRO, &one, sizeof(one)))
+			err(EXIT_FAILURE, "UDP_GRO");
+	}
+}
+
+static void unix_pair(int type, int *client, int *server)
+{
+	struct timeval tv = { .tv_sec = 1 };
+	int sv[2];
+
+	if (socketpair(AF_UNIX, type, 0, sv))
+		err(EXIT_FAILURE, "socketpair");
+	*client = sv[0];
+	*server = sv[1];
+	/* A full receive queue blocks the sender, as in udp_pair(). */
+	if (type == SOCK_DGRAM) {
+		setsockopt(*server, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(*client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	}
+}
+
+static ssize_t read_full(int fd, char *buf, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len) {
+		ssize_t ret = read(fd, buf + done, len - done);
+
+		if (ret <= 0)
+			return ret;
+		done += ret;
+	}
+	return done;
+}
+
+static void *server_thread(void *arg)
+{
+	struct net_bench *nb = arg;
+	size_t len = nb->mode == NET_BENCH_RR ? msg_size : max(msg_size, 65536U);
+	char *buf = calloc(1, len);
+
+	if (!buf)
+		err(EXIT_FAILURE, "calloc");
+	pin_to_cpu(server_cpu);
+
+	/*
+	 * Stream receivers run until the sender's shutdown, stopping early
+	 * could leave it blocked on a full socket buffer.  Datagram sockets
+	 * have no EOF, both ends time out instead.
+	 */
+	while (!nb->dgram || !nb->done) {
+		ssize_t ret;
+
+		if (nb->mode == NET_BENCH_RR) {
+			ret = read_full(nb->server_fd, buf, len);
+			if (ret <= 0 || write(nb->server_fd, buf, len) != (ssize_t)len)
+				break;
+			continue;
+		}
+
+		ret = recv(nb->server_fd, buf, len, 0);
+		if (ret < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+		if (ret <= 0)
+			break;
+		if (!nb->done)
+			nb->bytes += ret;
+	}
+
+	free(buf);
+	return NULL;
+}
+
+/* Release the pages of completed MSG_ZEROCOPY sends. */
+static void reap_zerocopy(int fd)
+{
+	char control[128];
+	struct msghdr msg = {
+		.msg_control = control,
+		.msg_controllen = sizeof(control),
+	};
+
+	while (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) >= 0)
+		msg.msg_controllen = sizeof(control);
+}
+
+static void *client_thread(void *arg)
+{
+	struct net_bench *nb = arg;
+	char *buf = calloc(1, msg_size);
+	int flags = 0;
+
+	if (!buf)
+		err(EXIT_FAILURE, "calloc");
+	pin_to_cpu(client_cpu);
+
+	if (zerocopy) {
+		int one = 1;
+
+		if (setsockopt(nb->client_fd, SOL_SOCKET, SO_ZEROCOPY,
+			       &one, sizeof(one)))
+			err(EXIT_FAILURE, "SO_ZEROCOPY");
+		flags = MSG_ZEROCOPY;
+	}
+
+	while (!nb->done) {
+		ssize_t ret = send(nb->client_fd, buf, msg_size, flags);
+
+		if (ret < 0) {
+			/* Out of optmem for notifications, or a full dgram queue */
+			if (errno == ENOBUFS || errno == EAGAIN || errno == EINTR) {
+				if (zerocopy)
+					reap_zerocopy(nb->client_fd);
+				continue;
+			}
+			if (errno == ECONNREFUSED)
+				continue;
+			break;
+		}
+
+		if (nb->mode == NET_BENCH_RR &&
+		    read_full(nb->client_fd, buf, msg_size) <= 0)
+			break;
+		nb->ops++;
+
+		if (zerocopy && !(nb->ops & 63))
+			reap_zerocopy(nb->client_fd);
+	}
+
+	/* Let a blocked stream receiver see EOF. */
+	if (!nb->dgram)
+		shutdown(nb->client_fd, SHUT_WR);
+	free(buf);
+	return NULL;
+}
+
+static void print_result(struct net_bench *nb, struct timeval *diff)
+{
+	double secs = diff->tv_sec + (double)diff->tv_usec / USEC_PER_SEC;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %s: %u byte sends%s%s, %.3f seconds\n\n", nb->name,
+		       msg_size, zerocopy ? ", MSG_ZEROCOPY" : "",
+		       gso_size ? ", UDP GSO/GRO" : "", secs);
+		if (nb->mode == NET_BENCH_RR) {
+			printf(" %14lf usecs/op\n",
+			       secs * USEC_PER_SEC / (double)nb->ops);
+			printf(" %14.0lf ops/sec\n", (double)nb->ops / secs);
+		} else {
+			printf(" %14.3lf Gbit/sec\n",
+			       (double)nb->bytes * 8 / secs / 1e9);
+			printf(" %14.0lf sends/sec\n", (double)nb->ops / secs);
+		}
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		if (nb->mode == NET_BENCH_RR)
+			printf("%.0lf\n", (double)nb->ops / secs);
+		else
+			printf("%.0lf\n", (double)nb->bytes / secs);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+static int run_net_bench(struct net_bench *nb)
+{
+	struct timeval start, stop, diff;
+	pthread_t server, client;
+
+	if (pthread_create(&server, NULL, server_thread, nb) ||
+	    pthread_create(&client, NULL, client_thread, nb))
+		err(EXIT_FAILURE, "pthread_create");
+
+	gettimeofday(&start, NULL);
+	sleep(runtime);
+	nb->done = true;
+	gettimeofday(&stop, NULL);
+
+	pthread_join(client, NULL);
+	pthread_join(server, NULL);
+	timersub(&stop, &start, &diff);
+
+	close(nb->client_fd);
+	close(nb->server_fd);
+
+	print_result(nb, &diff);
+	return 0;
+}
+
+int bench_net_tcp_stream(int argc, const char **argv)
+{
+	struct net_bench nb = { .name = "tcp-stream", .mode = NET_BENCH_STREAM };
+
+	msg_size = 65536;
+	argc = parse_options(argc, argv, tcp_stream_options, bench_net_usage, 0);
+	if (!msg_size)
+		usage_with_options(bench_net_usage, tcp_stream_options);
+
+	tcp_pair(&nb.client_fd, &nb.server_fd);
+	return run_net_bench(&nb);
+}
+
+int bench_net_tcp_rr(int argc, const char **argv)
+{
+	struct net_bench nb = { .name = "tcp-rr", .mode = NET_BENCH_RR };
+
+	msg_size = 1;
+	argc = parse_options(argc, argv, stream_options, bench_net_usage, 0);
+	if (!msg_size)
+		usage_with_options(bench_net_usage, stream_options);
+
+	tcp_pair(&nb.client_fd, &nb.server_fd);
+	return run_net_bench(&nb);
+}
+
+int bench_net_udp_stream(int argc, const char **argv)
+{
+	struct net_bench nb = {
+		.name = "udp-stream",
+		.mode = NET_BENCH_STREAM,
+		.dgram = true,
+	};
+
+	msg_size = 1400;
+	argc = parse_options(argc, argv, udp_stream_options, bench_net_usage, 0);
+	if (!msg_size || msg_size > 65507)
+		usage_with_options(bench_net_usage, udp_stream_options);
+
+	udp_pair(&nb.client_fd, &nb.server_fd);
+	return run_net_bench(&nb);
+}
+
+int bench_net_unix_stream(int argc, const char **argv)
+{
+	struct net_bench nb = { .name = "unix-stream", .mode = NET_BENCH_STREAM };
+
+	msg_size = 65536;
+	argc = parse_options(argc, argv, stream_options, bench_net_usage, 0);
+	if (!msg_size)
+		usage_with_options(bench_net_usage, stream_options);
+
+	unix_pair(SOCK_STREAM, &nb.client_fd, &nb.server_fd);
+	return run_net_bench(&nb);
+}
+
+int bench_net_unix_dgram(int argc, const char **argv)
+{
+	struct net_bench nb = {
+		.name = "unix-dgram",
+		.mode = NET_BENCH_STREAM,
+		.dgram = true,
+	};
+
+	msg_size = 1024;
+	argc = parse_options(argc, argv, stream_options, bench_net_usage, 0);
+	if (!msg_size)
+		usage_with_options(bench_net_usage, stream_options);
+
+	unix_pair(SOCK_DGRAM, &nb.client_fd, &nb.server_fd);
+	return run_net_bench(&nb);
+}
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * sched-seccomp-filter.c
+ *
+ * Measures the cost of a system call under a stack of seccomp filters
+ * which check a syscall argument, as container runtime profiles do for
+ * clone(), ioctl() or socket().
+ */
+#include <subcmd/parse-options.h>
+#include "bench.h"
+
+#include <uapi/linux/filter.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <linux/unistd.h>
+#include <sys/syscall.h>
+#include <linux/time64.h>
+#include <uapi/linux/seccomp.h>
+#include <sys/prctl.h>
+
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <err.h>
+#include <inttypes.h>
+
+#define LOOPS_DEFAULT 10000000UL
+static uint64_t loops = LOOPS_DEFAULT;
+static unsigned int nr_filters = 1;
+static bool nr_only;
+
+static const struct option options[] = {
+	OPT_U64('l', "loop",	&loops,		"Specify number of loops"),
+	OPT_UINTEGER('f', "filters", &nr_filters,
+		     "Specify number of stacked filters"),
+	OPT_BOOLEAN('n', "nr-only", &nr_only,
+		    "Only check the syscall number, not its argument"),
+	OPT_END()
+};
+
+static const char * const bench_seccomp_usage[] = {
+	"perf bench sched seccomp-filter <options>",
+	NULL
+};
+
+static int seccomp(unsigned int op, unsigned int flags, void *args)
+{
+	return syscall(__NR_seccomp, op, flags, args);
+}
+
+/*
+ * getpgid(0) is allowed, getpgid() of any other pid fails with EPERM,
+ * everything else is allowed.  With --nr-only getpgid() is allowed
+ * without looking at its argument.
+ */
+static int install_filter(void)
+{
+	struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, __NR_getpgid, 0, 3),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, args[0])),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 1, 0),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ERRNO | EPERM),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),
+	};
+	struct sock_filter filter_nr[] = {
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, __NR_getppid, 0, 1),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ERRNO | EPERM),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),
+	};
+	struct sock_fprog prog = {
+		.len = (unsigned short)ARRAY_SIZE(filter),
+		.filter = filter,
+	};
+
+	if (nr_only) {
+		prog.len = (unsigned short)ARRAY_SIZE(filter_nr);
+		prog.filter = filter_nr;
+	}
+
+	return seccomp(SECCOMP_SET_MODE_FILTER, 0, &prog);
+}
+
+static void print_result(struct timeval *diff)
+{
+	unsigned long long result_usec = 0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Executed %" PRIu64 " getpgid() calls under %u filters\n\n",
+			loops, nr_filters);
+
+		result_usec = diff->tv_sec * USEC_PER_SEC;
+		result_usec += diff->tv_usec;
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       (unsigned long) diff->tv_sec,
+		       (unsigned long) (diff->tv_usec / USEC_PER_MSEC));
+
+		printf(" %14lf usecs/op\n",
+		       (double)result_usec / (double)loops);
+		printf(" %14d ops/sec\n",
+		       (int)((double)loops /
+			     ((double)result_usec / (double)USEC_PER_SEC)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       (unsigned long) diff->tv_sec,
+		       (unsigned long) (diff->tv_usec / USEC_PER_MSEC));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+}
+
+int bench_sched_seccomp_filter(int argc, const char **argv)
+{
+	struct timeval start, stop, diff;
+	unsigned int i;
+	uint64_t nr;
+	int status;
+	pid_t pid;
+
+	argc = parse_options(argc, argv, options, bench_seccomp_usage, 0);
+
+	/* Filters can't be removed, keep them out of perf itself. */
+	fflush(stdout);
+	pid = fork();
+	if (pid < 0)
+		err(EXIT_FAILURE, "fork");
+	if (pid == 0) {
+		if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0))
+			err(EXIT_FAILURE, "can't set no_new_privs");
+		for (i = 0; i < nr_filters; i++) {
+			if (install_filter())
+				err(EXIT_FAILURE, "can't install filter %u", i);
+		}
+
+		gettimeofday(&start, NULL);
+		for (nr = 0; nr < loops; nr++) {
+			if (syscall(__NR_getpgid, 0) < 0)
+				err(EXIT_FAILURE, "getpgid(0) failed");
+		}
+		gettimeofday(&stop, NULL);
+		timersub(&stop, &start, &diff);
+
+		print_result(&diff);
+		fflush(stdout);
+		_exit(0);
+	}
+
+	if (waitpid(pid, &status, 0) != pid)
+		err(EXIT_FAILURE, "waitpid(%d) failed", pid);
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		errx(EXIT_FAILURE, "unexpected exit code: %d", status);
+
+	return 0;
+}
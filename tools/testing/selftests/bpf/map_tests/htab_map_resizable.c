@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define _GNU_SOURCE
+#include <linux/bpf.h>
+#include <linux/compiler.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include <bpf_util.h>
+#include <test_maps.h>
+
+/* Keys that stay in the map while the other ones make it grow and shrink */
+#define NR_STABLE	1024
+#define NR_UPDATERS	4
+#define NR_READERS	2
+#define NR_PER_UPDATER	8192
+#define NR_CYCLES	4
+#define MAX_ENTRIES	(NR_STABLE + NR_UPDATERS * NR_PER_UPDATER)
+
+struct resize_ctx {
+	int map_fd;
+	bool percpu;
+	bool stop;
+};
+
+struct updater_arg {
+	struct resize_ctx *ctx;
+	__u32 base;
+};
+
+/* A value of the map, one u64 per possible CPU for the per-CPU one */
+static __u64 *alloc_value(void)
+{
+	__u64 *value = calloc(bpf_num_possible_cpus(), sizeof(*value));
+
+	CHECK(!value, "calloc", "error:%s\n", strerror(errno));
+	return value;
+}
+
+static int nr_values(struct resize_ctx *ctx)
+{
+	return ctx->percpu ? bpf_num_possible_cpus() : 1;
+}
+
+static void set_value(struct resize_ctx *ctx, __u64 *value, __u64 val)
+{
+	int i;
+
+	for (i = 0; i < nr_values(ctx); i++)
+		value[i] = val + i;
+}
+
+static bool check_value(struct resize_ctx *ctx, __u64 *value, __u64 val)
+{
+	int i;
+
+	for (i = 0; i < nr_values(ctx); i++)
+		if (value[i] != val + i)
+			return false;
+	return true;
+}
+
+/* Elements that are not changed must always be found, even while moved */
+static void *reader_fn(void *arg)
+{
+	struct resize_ctx *ctx = arg;
+	unsigned int seed = getpid();
+	__u64 *value = alloc_value();
+	__u32 key;
+	int err;
+
+	while (!READ_ONCE(ctx->stop)) {
+		key = rand_r(&seed) % NR_STABLE;
+		err = bpf_map_lookup_elem(ctx->map_fd, &key, value);
+		CHECK(err, "lookup stable key", "key %u error:%s\n", key,
+		      strerror(errno));
+		CHECK(!check_value(ctx, value, key), "lookup stable key",
+		      "key %u: wrong value\n", key);
+	}
+	free(value);
+	return NULL;
+}
+
+/* Fill the map with keys of our own and empty it again, a few times */
+static void *updater_fn(void *_arg)
+{
+	struct updater_arg *arg = _arg;
+	struct resize_ctx *ctx = arg->ctx;
+	__u64 *value = alloc_value();
+	__u32 i, key;
+	int cycle, err;
+
+	for (cycle = 0; cycle < NR_CYCLES; cycle++) {
+		for (i = 0; i < NR_PER_UPDATER; i++) {
+			key = arg->base + i;
+			set_value(ctx, value, key + cycle);
+			err = bpf_map_update_elem(ctx->map_fd, &key, value,
+						  BPF_NOEXIST);
+			CHECK(err, "bpf_map_update_elem()", "key %u error:%s\n",
+			      key, strerror(errno));
+		}
+		for (i = 0; i < NR_PER_UPDATER; i++) {
+			key = arg->base + i;
+			err = bpf_map_lookup_elem(ctx->map_fd, &key, value);
+			CHECK(err, "bpf_map_lookup_elem()", "key %u error:%s\n",
+			      key, strerror(errno));
+			CHECK(!check_value(ctx, value, key + cycle),
+			      "bpf_map_lookup_elem()", "key %u: wrong value\n",
+			      key);
+		}
+		for (i = 0; i < NR_PER_UPDATER; i++) {
+			key = arg->base + i;
+			err = bpf_map_delete_elem(ctx->map_fd, &key);
+			CHECK(err, "bpf_map_delete_elem()", "key %u error:%s\n",
+			      key, strerror(errno));
+			err = bpf_map_lookup_elem(ctx->map_fd, &key, value);
+			CHECK(!err || errno != ENOENT, "bpf_map_lookup_elem()",
+			      "deleted key %u found\n", key);
+		}
+	}
+	free(value);
+	return NULL;
+}
+
+static void test_resize(enum bpf_map_type map_type)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, opts,
+		    .map_flags = BPF_F_NO_PREALLOC | BPF_F_RESIZABLE);
+	struct resize_ctx ctx = {
+		.percpu = map_type == BPF_MAP_TYPE_PERCPU_HASH,
+	};
+	struct updater_arg args[NR_UPDATERS];
+	pthread_t readers[NR_READERS];
+	pthread_t updaters[NR_UPDATERS];
+	__u64 *value = alloc_value();
+	__u32 key, next_key;
+	int i, err;
+
+	ctx.map_fd = bpf_map_create(map_type, "resizable", sizeof(__u32),
+				    sizeof(__u64), MAX_ENTRIES, &opts);
+	CHECK(ctx.map_fd < 0, "bpf_map_create()", "error:%s\n",
+	      strerror(errno));
+
+	for (key = 0; key < NR_STABLE; key++) {
+		set_value(&ctx, value, key);
+		err = bpf_map_update_elem(ctx.map_fd, &key, value, BPF_NOEXIST);
+		CHECK(err, "bpf_map_update_elem()", "error:%s\n",
+		      strerror(errno));
+	}
+
+	for (i = 0; i < NR_READERS; i++) {
+		err = pthread_create(&readers[i], NULL, reader_fn, &ctx);
+		CHECK(err, "pthread_create", "error %d\n", err);
+	}
+	for (i = 0; i < NR_UPDATERS; i++) {
+		args[i].ctx = &ctx;
+		args[i].base = (i + 1) << 20;
+		err = pthread_create(&updaters[i], NULL, updater_fn, &args[i]);
+		CHECK(err, "pthread_create", "error %d\n", err);
+	}
+
+	for (i = 0; i < NR_UPDATERS; i++)
+		pthread_join(updaters[i], NULL);
+	WRITE_ONCE(ctx.stop, true);
+	for (i = 0; i < NR_READERS; i++)
+		pthread_join(readers[i], NULL);
+
+	/* Only the stable keys are left, and a walk finds each of them */
+	for (key = 0; key < NR_STABLE; key++) {
+		err = bpf_map_lookup_elem(ctx.map_fd, &key, value);
+		CHECK(err || !check_value(&ctx, value, key),
+		      "bpf_map_lookup_elem()", "key %u error:%s\n", key,
+		      strerror(errno));
+	}
+	for (err = bpf_map_get_next_key(ctx.map_fd, NULL, &next_key); !err;
+	     err = bpf_map_get_next_key(ctx.map_fd, &key, &next_key)) {
+		CHECK(next_key >= NR_STABLE, "bpf_map_get_next_key()",
+		      "key %u left over\n", next_key);
+		key = next_key;
+	}
+
+	free(value);
+	close(ctx.map_fd);
+}
+
+static void test_resize_flags(void)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, opts,
+		    .map_flags = BPF_F_RESIZABLE);
+	int fd;
+
+	/* Preallocated maps cannot be resized */
+	fd = bpf_map_create(BPF_MAP_TYPE_HASH, "resizable", sizeof(__u32),
+			    sizeof(__u64), MAX_ENTRIES, &opts);
+	CHECK(fd >= 0 || errno != EINVAL, "bpf_map_create()",
+	      "prealloc: fd %d error:%s\n", fd, strerror(errno));
+	if (fd >= 0)
+		close(fd);
+
+	opts.map_flags |= BPF_F_NO_PREALLOC;
+	fd = bpf_map_create(BPF_MAP_TYPE_ARRAY, "resizable", sizeof(__u32),
+			    sizeof(__u64), MAX_ENTRIES, &opts);
+	CHECK(fd >= 0 || errno != EINVAL, "bpf_map_create()",
+	      "array: fd %d error:%s\n", fd, strerror(errno));
+	if (fd >= 0)
+		close(fd);
+}
+
+void test_htab_map_resizable(void)
+{
+	test_resize_flags();
+	test_resize(BPF_MAP_TYPE_HASH);
+	test_resize(BPF_MAP_TYPE_PERCPU_HASH);
+
+	printf("%s:PASS\n", __func__);
+}
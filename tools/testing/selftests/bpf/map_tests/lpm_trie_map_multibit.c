@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define _GNU_SOURCE
+#include <linux/bpf.h>
+#include <linux/compiler.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include <test_maps.h>
+
+#define MB_MAX_DATA	16
+#define MB_NR_OPS	4096
+#define MB_NR_LOOKUPS	16
+
+struct test_lpm_key {
+	__u32 prefix;
+	__u8 data[MB_MAX_DATA];
+};
+
+struct lookup_ctx {
+	int map_fd;
+	size_t data_size;
+	bool stop;
+};
+
+/* Keep the addresses close together, so that prefixes overlap */
+static void random_key(struct test_lpm_key *key, size_t data_size,
+		       unsigned int *seed)
+{
+	size_t i;
+
+	key->data[0] = rand_r(seed) & 1 ? 10 : 192;
+	for (i = 1; i < data_size; i++)
+		key->data[i] = i < 3 ? rand_r(seed) % 4 : rand_r(seed);
+	key->prefix = rand_r(seed) % (8 * data_size + 1);
+}
+
+/* Full-length lookups while the index is being rebuilt */
+static void *lookup_fn(void *arg)
+{
+	struct lookup_ctx *ctx = arg;
+	unsigned int seed = getpid();
+	struct test_lpm_key key;
+	__u32 val;
+
+	while (!READ_ONCE(ctx->stop)) {
+		random_key(&key, ctx->data_size, &seed);
+		key.prefix = 8 * ctx->data_size;
+		bpf_map_lookup_elem(ctx->map_fd, &key, &val);
+	}
+	return NULL;
+}
+
+static int create_trie(size_t data_size, __u32 flags)
+{
+	LIBBPF_OPTS(bpf_map_create_opts, create_opts,
+		    .map_flags = BPF_F_NO_PREALLOC | flags);
+
+	return bpf_map_create(BPF_MAP_TYPE_LPM_TRIE, "lpm_trie_map",
+			      sizeof(__u32) + data_size, sizeof(__u32),
+			      MB_NR_OPS, &create_opts);
+}
+
+/* Full-length lookups must match the ones of a trie without the index */
+static void check_lookups(int mb_fd, int ref_fd, size_t data_size,
+			  unsigned int *seed)
+{
+	struct test_lpm_key key;
+	__u32 mb_val, ref_val;
+	int mb_err, ref_err;
+	unsigned int i;
+
+	for (i = 0; i < MB_NR_LOOKUPS; i++) {
+		random_key(&key, data_size, seed);
+		key.prefix = 8 * data_size;
+		mb_err = bpf_map_lookup_elem(mb_fd, &key, &mb_val);
+		ref_err = bpf_map_lookup_elem(ref_fd, &key, &ref_val);
+		CHECK(mb_err != ref_err, "lookup", "error %d vs %d\n",
+		      mb_err, ref_err);
+		CHECK(!mb_err && mb_val != ref_val, "lookup",
+		      "value %u vs %u\n", mb_val, ref_val);
+	}
+}
+
+static void test_multibit(size_t data_size)
+{
+	struct lookup_ctx ctx = { .data_size = data_size };
+	unsigned int seed = getpid();
+	struct test_lpm_key key;
+	int mb_fd, ref_fd, err;
+	pthread_t tid;
+	unsigned int i;
+	__u32 val;
+
+	mb_fd = create_trie(data_size, BPF_F_LPM_MULTIBIT);
+	CHECK(mb_fd < 0, "bpf_map_create()", "error:%s\n", strerror(errno));
+	ref_fd = create_trie(data_size, 0);
+	CHECK(ref_fd < 0, "bpf_map_create()", "error:%s\n", strerror(errno));
+
+	ctx.map_fd = mb_fd;
+	err = pthread_create(&tid, NULL, lookup_fn, &ctx);
+	CHECK(err, "pthread_create", "error %d\n", err);
+
+	for (i = 0; i < MB_NR_OPS; i++) {
+		random_key(&key, data_size, &seed);
+		if (rand_r(&seed) % 4) {
+			val = i;
+			err = bpf_map_update_elem(mb_fd, &key, &val, BPF_ANY);
+			CHECK(err, "bpf_map_update_elem()", "error:%s\n",
+			      strerror(errno));
+			err = bpf_map_update_elem(ref_fd, &key, &val, BPF_ANY);
+			CHECK(err, "bpf_map_update_elem()", "error:%s\n",
+			      strerror(errno));
+		} else {
+			err = bpf_map_delete_elem(mb_fd, &key);
+			CHECK(err != bpf_map_delete_elem(ref_fd, &key),
+			      "bpf_map_delete_elem()", "error:%s\n",
+			      strerror(errno));
+		}
+		check_lookups(mb_fd, ref_fd, data_size, &seed);
+	}
+
+	/* Empty the tries again */
+	while (!bpf_map_get_next_key(ref_fd, NULL, &key)) {
+		CHECK(bpf_map_delete_elem(ref_fd, &key), "bpf_map_delete_elem()",
+		      "error:%s\n", strerror(errno));
+		CHECK(bpf_map_delete_elem(mb_fd, &key), "bpf_map_delete_elem()",
+		      "error:%s\n", strerror(errno));
+		check_lookups(mb_fd, ref_fd, data_size, &seed);
+	}
+
+	WRITE_ONCE(ctx.stop, true);
+	pthread_join(tid, NULL);
+	close(ref_fd);
+	close(mb_fd);
+}
+
+void test_lpm_trie_map_multibit(void)
+{
+	int fd;
+
+	test_multibit(1);
+	test_multibit(4);
+	test_multibit(MB_MAX_DATA);
+
+	/* The index is only for keys of up to 16 bytes */
+	fd = create_trie(MB_MAX_DATA + 1, BPF_F_LPM_MULTIBIT);
+	CHECK(fd >= 0 || errno != EINVAL, "bpf_map_create()",
+	      "fd %d error:%s\n", fd, strerror(errno));
+	if (fd >= 0)
+		close(fd);
+
+	printf("%s:PASS\n", __func__);
+}
@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: GPL-2.0
+#include <test_progs.h>
+#include <bpf/btf.h>
+#include "tracing_multi.skel.h"
+
+static int tracing_multi_attach(const struct bpf_program *prog, __u32 *ids,
+				__u64 *cookies, __u32 cnt)
+{
+	union bpf_attr attr;
+	int fd;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.link_create.prog_fd = bpf_program__fd(prog);
+	attr.link_create.attach_type = bpf_program__expected_attach_type(prog);
+	attr.link_create.tracing.btf_ids = ptr_to_u64(ids);
+	attr.link_create.tracing.cookies = ptr_to_u64(cookies);
+	attr.link_create.tracing.cnt = cnt;
+	fd = syscall(__NR_bpf, BPF_LINK_CREATE, &attr, sizeof(attr));
+	return fd < 0 ? -errno : fd;
+}
+
+/* bpf_prog_test_run() of a tracing prog calls each bpf_fentry_test*() once */
+static void trigger(struct tracing_multi *skel)
+{
+	LIBBPF_OPTS(bpf_test_run_opts, topts);
+	int err;
+
+	err = bpf_prog_test_run_opts(bpf_program__fd(skel->progs.fentry_multi),
+				     &topts);
+	ASSERT_OK(err, "test_run");
+}
+
+static void test_attach(struct tracing_multi *skel, __u32 *ids)
+{
+	__u64 cookies[2] = { 1, 2 };
+	int fentry_fd, fexit_fd;
+
+	fentry_fd = tracing_multi_attach(skel->progs.fentry_multi, ids,
+					 cookies, 2);
+	if (!ASSERT_GE(fentry_fd, 0, "attach fentry"))
+		return;
+	trigger(skel);
+	ASSERT_EQ(skel->bss->fentry_hits[1], 1, "fentry test7");
+	ASSERT_EQ(skel->bss->fentry_hits[2], 1, "fentry test8");
+
+	/* Updates the trampolines that already have an image */
+	fexit_fd = tracing_multi_attach(skel->progs.fexit_multi, ids, cookies,
+					2);
+	if (!ASSERT_GE(fexit_fd, 0, "attach fexit"))
+		goto close_fentry;
+	trigger(skel);
+	ASSERT_EQ(skel->bss->fentry_hits[1], 2, "fentry test7");
+	ASSERT_EQ(skel->bss->fentry_hits[2], 2, "fentry test8");
+	ASSERT_EQ(skel->bss->fexit_hits[1], 1, "fexit test7");
+	ASSERT_EQ(skel->bss->fexit_hits[2], 1, "fexit test8");
+	close(fexit_fd);
+
+close_fentry:
+	close(fentry_fd);
+
+	/* Both detached, nothing counts any more */
+	trigger(skel);
+	ASSERT_EQ(skel->bss->fentry_hits[1], 2, "fentry detached");
+	ASSERT_EQ(skel->bss->fexit_hits[1], 1, "fexit detached");
+	ASSERT_EQ(skel->bss->fentry_hits[0], 0, "no cookie");
+}
+
+static void test_attach_errors(struct tracing_multi *skel, __u32 *ids,
+			       __u32 other_proto_id)
+{
+	__u32 bad[2];
+	int fd;
+
+	bad[0] = bad[1] = ids[0];
+	fd = tracing_multi_attach(skel->progs.fentry_multi, bad, NULL, 2);
+	ASSERT_EQ(fd, -EINVAL, "duplicate target");
+
+	bad[1] = other_proto_id;
+	fd = tracing_multi_attach(skel->progs.fentry_multi, bad, NULL, 2);
+	ASSERT_EQ(fd, -EINVAL, "other prototype");
+
+	/* Nothing stays attached after a failed attach */
+	trigger(skel);
+	ASSERT_EQ(skel->bss->fentry_hits[0], 0, "rolled back");
+}
+
+void test_tracing_multi(void)
+{
+	int id7, id8, id1;
+	struct tracing_multi *skel;
+	struct btf *btf;
+	__u32 ids[2];
+
+	btf = btf__load_vmlinux_btf();
+	if (!ASSERT_OK_PTR(btf, "load_vmlinux_btf"))
+		return;
+	/* test7 and test8 share their prototype, test1 does not */
+	id7 = btf__find_by_name_kind(btf, "bpf_fentry_test7", BTF_KIND_FUNC);
+	id8 = btf__find_by_name_kind(btf, "bpf_fentry_test8", BTF_KIND_FUNC);
+	id1 = btf__find_by_name_kind(btf, "bpf_fentry_test1", BTF_KIND_FUNC);
+	btf__free(btf);
+	if (!ASSERT_GT(id7, 0, "bpf_fentry_test7") ||
+	    !ASSERT_GT(id8, 0, "bpf_fentry_test8") ||
+	    !ASSERT_GT(id1, 0, "bpf_fentry_test1"))
+		return;
+	ids[0] = id7;
+	ids[1] = id8;
+
+	skel = tracing_multi__open_and_load();
+	if (!ASSERT_OK_PTR(skel, "tracing_multi__open_and_load"))
+		return;
+
+	if (test__start_subtest("attach"))
+		test_attach(skel, ids);
+	if (test__start_subtest("attach_errors"))
+		test_attach_errors(skel, ids, id1);
+
+	tracing_multi__destroy(skel);
+}
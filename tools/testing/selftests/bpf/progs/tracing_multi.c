@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+char _license[] SEC("license") = "GPL";
+
+/* Hits per attach cookie, the test gives each target its own */
+#define NR_COOKIES	4
+
+__u64 fentry_hits[NR_COOKIES];
+__u64 fexit_hits[NR_COOKIES];
+
+/* Attached by the test to bpf_fentry_test7 and bpf_fentry_test8 */
+SEC("fentry/bpf_fentry_test7")
+int BPF_PROG(fentry_multi, struct bpf_fentry_test_t *arg)
+{
+	__u64 cookie = bpf_get_attach_cookie(ctx);
+
+	if (cookie < NR_COOKIES)
+		fentry_hits[cookie]++;
+	return 0;
+}
+
+SEC("fexit/bpf_fentry_test7")
+int BPF_PROG(fexit_multi, struct bpf_fentry_test_t *arg, int ret)
+{
+	__u64 cookie = bpf_get_attach_cookie(ctx);
+
+	if (cookie < NR_COOKIES && !ret)
+		fexit_hits[cookie]++;
+	return 0;
+}
@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * futex_wakev() test
+ *
+ * Park waiters on a list of futexes, wake them with futex_wakev() and check
+ * the number of woken waiters, then check that malformed lists are rejected.
+ */
+
+#include <errno.h>
+#include <error.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "futextest.h"
+#include "futex2test.h"
+#include "logging.h"
+
+#define TEST_NAME "futex-wakev"
+#define WAKE_WAIT_US 10000
+#define NR_FUTEXES 8
+#define WAITERS_PER_FUTEX 2
+#define NR_WAITERS (NR_FUTEXES * WAITERS_PER_FUTEX)
+
+static u_int32_t futexes[NR_FUTEXES];
+static struct futex_waitv wakev[NR_FUTEXES + 1];
+static struct futex_waitv waiter_waitv[NR_WAITERS];
+static pthread_t waiters[NR_WAITERS];
+static int ret = RET_PASS;
+
+void usage(char *prog)
+{
+	printf("Usage: %s\n", prog);
+	printf("  -c	Use color\n");
+	printf("  -h	Display this help message\n");
+	printf("  -v L	Verbosity level: %d=QUIET %d=CRITICAL %d=INFO\n",
+	       VQUIET, VCRITICAL, VINFO);
+}
+
+void *waiterfn(void *arg)
+{
+	struct futex_waitv *waitv = arg;
+	struct timespec to;
+	int res;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &to))
+		error("gettime64 failed\n", errno);
+
+	to.tv_sec += 2;
+
+	res = futex_waitv(waitv, 1, 0, &to, CLOCK_MONOTONIC);
+	if (res != 0) {
+		ksft_print_msg("futex_waitv returned: %d %s\n",
+			       res ? errno : res, res ? strerror(errno) : "");
+		ret = RET_FAIL;
+	}
+
+	return NULL;
+}
+
+static void init_wakev(unsigned int flags)
+{
+	int i;
+
+	for (i = 0; i < NR_FUTEXES; i++) {
+		wakev[i].uaddr = (uintptr_t)&futexes[i];
+		wakev[i].flags = FUTEX_32 | flags;
+		wakev[i].val = FUTEX_BITSET_MATCH_ANY;
+		wakev[i].__reserved = 0;
+	}
+}
+
+/* Park WAITERS_PER_FUTEX waiters on each futex of wakev[] */
+static void start_waiters(void)
+{
+	int i;
+
+	for (i = 0; i < NR_WAITERS; i++) {
+		waiter_waitv[i] = wakev[i % NR_FUTEXES];
+		waiter_waitv[i].val = 0;
+		if (pthread_create(&waiters[i], NULL, waiterfn, &waiter_waitv[i]))
+			error("pthread_create failed\n", errno);
+	}
+
+	usleep(WAKE_WAIT_US);
+}
+
+static void join_waiters(void)
+{
+	int i;
+
+	for (i = 0; i < NR_WAITERS; i++)
+		pthread_join(waiters[i], NULL);
+}
+
+static void test_wake(const char *name, int nr, int nr_wake, int expected)
+{
+	int res;
+
+	res = futex_wakev(wakev, nr, 0, nr_wake);
+	if (res != expected) {
+		ksft_test_result_fail("futex_wakev %s returned: %d %s, expecting %d\n",
+				      name, res, res < 0 ? strerror(errno) : "",
+				      expected);
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("futex_wakev %s\n", name);
+	}
+}
+
+static void test_einval(const char *name, volatile struct futex_waitv *list,
+			unsigned long nr, unsigned long flags)
+{
+	int res;
+
+	res = futex_wakev(list, nr, flags, 1);
+	if (res != -1 || errno != EINVAL) {
+		ksft_test_result_fail("futex_wakev %s returned: %d %s, expecting EINVAL\n",
+				      name, res, res < 0 ? strerror(errno) : "");
+		ret = RET_FAIL;
+	} else {
+		ksft_test_result_pass("futex_wakev %s\n", name);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct futex_waitv saved;
+	u_int32_t *shared;
+	int c, i, res;
+
+	while ((c = getopt(argc, argv, "cht:v:")) != -1) {
+		switch (c) {
+		case 'c':
+			log_color(1);
+			break;
+		case 'h':
+			usage(basename(argv[0]));
+			exit(0);
+		case 'v':
+			log_verbosity(atoi(optarg));
+			break;
+		default:
+			usage(basename(argv[0]));
+			exit(1);
+		}
+	}
+
+	ksft_print_header();
+	ksft_set_plan(17);
+	ksft_print_msg("%s: Test FUTEX_WAKEV\n",
+		       basename(argv[0]));
+
+	init_wakev(FUTEX_PRIVATE_FLAG);
+	res = futex_wakev(wakev, NR_FUTEXES, 0, 1);
+	if (res < 0 && errno == ENOSYS)
+		ksft_exit_skip("futex_wakev not supported\n");
+
+	/* Nothing waits yet */
+	test_wake("without waiters", NR_FUTEXES, 1, 0);
+
+	/* One waiter per futex, then the rest, then none are left */
+	start_waiters();
+	test_wake("one waiter each", NR_FUTEXES, 1, NR_FUTEXES);
+	test_wake("remaining waiters", NR_FUTEXES, INT_MAX,
+		  NR_WAITERS - NR_FUTEXES);
+	test_wake("after all woken", NR_FUTEXES, INT_MAX, 0);
+	join_waiters();
+
+	/* A futex listed twice wakes nr_wake waiters for each entry */
+	start_waiters();
+	wakev[NR_FUTEXES] = wakev[0];
+	test_wake("duplicate futex", NR_FUTEXES + 1, 1,
+		  NR_FUTEXES + 1);
+	test_wake("nr_wake 0", NR_FUTEXES, 0, 0);
+	test_wake("remaining after duplicate", NR_FUTEXES, INT_MAX,
+		  NR_WAITERS - NR_FUTEXES - 1);
+	join_waiters();
+
+	/* Shared futexes, mixed with a private one */
+	shared = mmap(NULL, NR_FUTEXES * sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		error("mmap failed\n", errno);
+	init_wakev(0);
+	for (i = 0; i < NR_FUTEXES - 1; i++)
+		wakev[i].uaddr = (uintptr_t)&shared[i];
+	wakev[NR_FUTEXES - 1].flags |= FUTEX_PRIVATE_FLAG;
+	start_waiters();
+	test_wake("shared and private", NR_FUTEXES, INT_MAX, NR_WAITERS);
+	join_waiters();
+	munmap(shared, NR_FUTEXES * sizeof(*shared));
+
+	/* Malformed lists are rejected as a whole */
+	init_wakev(FUTEX_PRIVATE_FLAG);
+	test_einval("with flags", wakev, NR_FUTEXES, 1);
+	test_einval("with no futexes", wakev, 0, 0);
+	test_einval("with too many futexes", wakev, FUTEX_WAITV_MAX + 1, 0);
+	test_einval("NULL address in *waiters", NULL, NR_FUTEXES, 0);
+
+	saved = wakev[NR_FUTEXES - 1];
+	wakev[NR_FUTEXES - 1].flags = FUTEX2_SIZE_U8 | FUTEX_PRIVATE_FLAG;
+	test_einval("mixed with a u8 futex", wakev, NR_FUTEXES, 0);
+	wakev[NR_FUTEXES - 1].flags = FUTEX2_SIZE_U64 | FUTEX_PRIVATE_FLAG;
+	test_einval("mixed with a u64 futex", wakev, NR_FUTEXES, 0);
+
+	wakev[NR_FUTEXES - 1] = saved;
+	wakev[NR_FUTEXES - 1].val = 0;
+	test_einval("empty bitset", wakev, NR_FUTEXES, 0);
+
+	wakev[NR_FUTEXES - 1] = saved;
+	wakev[NR_FUTEXES - 1].uaddr = (uintptr_t)&futexes[0] + 1;
+	test_einval("unaligned address", wakev, NR_FUTEXES, 0);
+
+	wakev[NR_FUTEXES - 1] = saved;
+	wakev[NR_FUTEXES - 1].__reserved = 1;
+	test_einval("reserved field set", wakev, NR_FUTEXES, 0);
+
+	ksft_print_cnts();
+	return ret;
+}
@@ -20,3 +20,20 @@ static inline int futex_waitv(volatile struct futex_waitv *waiters, unsigned lon
 {
 	return syscall(__NR_futex_waitv, waiters, nr_waiters, flags, timo, clockid);
 }
+
+#ifndef __NR_futex_wakev
+#define __NR_futex_wakev 463
+#endif
+
+/**
+ * futex_wakev - Wake waiters on multiple futexes
+ * @waiters:    Array of futexes, with the wake bitset in val
+ * @nr_futexes: Length of waiters array
+ * @flags: Operation flags
+ * @nr_wake: Number of waiters to wake on each futex
+ */
+static inline int futex_wakev(volatile struct futex_waitv *waiters, unsigned long nr_futexes,
+			      unsigned long flags, int nr_wake)
+{
+	return syscall(__NR_futex_wakev, waiters, nr_futexes, flags, nr_wake);
+}
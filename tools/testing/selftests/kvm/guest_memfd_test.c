@@ -170,6 +170,85 @@ static void test_create_guest_memfd_multiple(struct kvm_vm *vm)
 	close(fd1);
 }
 
+#ifdef __x86_64__
+static void test_create_guest_memfd_hugepage(struct kvm_vm *vm, size_t pmd_size)
+{
+	size_t page_size = getpagesize();
+	size_t size;
+	int fd;
+
+	for (size = page_size; size < pmd_size; size += page_size) {
+		fd = __vm_create_guest_memfd(vm, size,
+					     KVM_GUEST_MEMFD_ALLOW_HUGEPAGE);
+		TEST_ASSERT(fd == -1 && errno == EINVAL,
+			    "guest_memfd() with hugepages and size '0x%lx' should fail with EINVAL",
+			    size);
+	}
+
+	fd = __vm_create_guest_memfd(vm, pmd_size + page_size,
+				     KVM_GUEST_MEMFD_ALLOW_HUGEPAGE);
+	TEST_ASSERT(fd == -1 && errno == EINVAL,
+		    "guest_memfd() with hugepages and non-PMD-aligned size should fail with EINVAL");
+}
+
+/*
+ * Punch holes that start, end and lie in the middle of PMD sized folios, so
+ * that the folios must be split, and fill them in again.
+ */
+static void test_hugepage_punch_hole(size_t pmd_size)
+{
+	size_t page_size = getpagesize();
+	size_t total_size = pmd_size * 2;
+	struct {
+		off_t offset;
+		off_t len;
+	} testcases[] = {
+		{ 0, page_size },
+		{ pmd_size - page_size, page_size },
+		{ page_size, page_size * 2 },
+		{ pmd_size - page_size, page_size * 2 },
+		{ page_size, pmd_size },
+		{ 0, pmd_size },
+	};
+	struct kvm_vm *vm;
+	int fd, ret, i;
+
+	vm = vm_create_barebones_type(KVM_X86_SW_PROTECTED_VM);
+
+	test_create_guest_memfd_hugepage(vm, pmd_size);
+
+	fd = vm_create_guest_memfd(vm, total_size, KVM_GUEST_MEMFD_ALLOW_HUGEPAGE);
+	vm_set_user_memory_region2(vm, 0, KVM_MEM_GUEST_MEMFD, pmd_size * 2,
+				   total_size, 0, fd, 0);
+
+	for (i = 0; i < ARRAY_SIZE(testcases); i++) {
+		ret = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, total_size);
+		TEST_ASSERT(!ret, "fallocate of huge guest_memfd should succeed");
+
+		ret = fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+				testcases[i].offset, testcases[i].len);
+		TEST_ASSERT(!ret,
+			    "PUNCH_HOLE at offset (%lx) length (%lx) of huge guest_memfd should succeed, errno %d",
+			    testcases[i].offset, testcases[i].len, errno);
+
+		ret = fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+				testcases[i].offset, testcases[i].len);
+		TEST_ASSERT(!ret, "PUNCH_HOLE of an existing hole should succeed");
+
+		ret = fallocate(fd, FALLOC_FL_KEEP_SIZE,
+				testcases[i].offset, testcases[i].len);
+		TEST_ASSERT(!ret, "fallocate to restore punched hole should succeed");
+
+		ret = fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+				0, total_size);
+		TEST_ASSERT(!ret, "PUNCH_HOLE of the whole huge guest_memfd should succeed");
+	}
+
+	close(fd);
+	kvm_vm_free(vm);
+}
+#endif
+
 int main(int argc, char *argv[])
 {
 	size_t page_size;
@@ -196,4 +275,12 @@ int main(int argc, char *argv[])
 	test_invalid_punch_hole(fd, page_size, total_size);
 
 	close(fd);
+
+#ifdef __x86_64__
+	if ((kvm_check_cap(KVM_CAP_VM_TYPES) & BIT(KVM_X86_SW_PROTECTED_VM)) &&
+	    thp_configured())
+		test_hugepage_punch_hole(get_trans_hugepagesz());
+	else
+		pr_info("Skipping tests for huge guest_memfd\n");
+#endif
 }
@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Test attr::callchain_dedup by decoding the callchains of the samples: every
+ * PERF_CONTEXT_STACK_ID reference must name a callchain that an earlier
+ * record of the same ring buffer defined.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../kselftest_harness.h"
+
+#define DATA_PAGES	64
+#define NR_FAULTS	256
+#define MAX_STACK_IDS	256
+
+struct stack_ids {
+	unsigned int nr;
+	__u64 ids[MAX_STACK_IDS];
+	__u64 nr_ips[MAX_STACK_IDS];
+	unsigned int defs, refs, full;
+};
+
+static int stack_ids_find(struct stack_ids *s, __u64 id)
+{
+	unsigned int i;
+
+	for (i = 0; i < s->nr; i++)
+		if (s->ids[i] == id)
+			return i;
+	return -1;
+}
+
+/*
+ * Decode the callchain of a sample: returns 0 if it is a full callchain, a
+ * definition, or a reference to a stack id defined before.
+ */
+static int decode_callchain(struct stack_ids *s, const __u64 *chain)
+{
+	__u64 nr = chain[0];
+	const __u64 *ips = chain + 1;
+	int i;
+
+	if (nr < 2 || ips[0] != PERF_CONTEXT_STACK_ID) {
+		s->full++;
+		return 0;
+	}
+
+	/* Ids are never 0, and 0 only reports a lost callchain. */
+	if (ips[1] == 0)
+		return -1;
+
+	i = stack_ids_find(s, ips[1]);
+	if (nr == 2) {
+		s->refs++;
+		return i < 0 ? -1 : 0;
+	}
+
+	s->defs++;
+	if (i >= 0)
+		return s->nr_ips[i] == nr - 2 ? 0 : -1;
+	if (s->nr == MAX_STACK_IDS)
+		return -1;
+	s->ids[s->nr] = ips[1];
+	s->nr_ips[s->nr] = nr - 2;
+	s->nr++;
+	return 0;
+}
+
+/* Decode all samples in the buffer, which only has PERF_SAMPLE_CALLCHAIN. */
+static int decode_buffer(struct perf_event_mmap_page *p, long page_size,
+			 struct stack_ids *s)
+{
+	unsigned char *data = (unsigned char *)p + page_size;
+	__u64 size = DATA_PAGES * page_size;
+	__u64 head = __atomic_load_n(&p->data_head, __ATOMIC_ACQUIRE);
+	__u64 tail = p->data_tail;
+	static __u64 buf[4096];
+	int ret = 0;
+
+	while (tail < head) {
+		struct perf_event_header *hdr = (void *)buf;
+		__u64 off = tail % size, len, i;
+
+		memcpy(hdr, data + off, sizeof(*hdr));
+		len = hdr->size;
+		if (len < sizeof(*hdr) || len > sizeof(buf))
+			return -1;
+		for (i = 0; i < len; i++)
+			((unsigned char *)buf)[i] = data[(off + i) % size];
+
+		if (hdr->type == PERF_RECORD_SAMPLE &&
+		    decode_callchain(s, (__u64 *)(hdr + 1)))
+			ret = -1;
+		tail += len;
+	}
+	__atomic_store_n(&p->data_tail, tail, __ATOMIC_RELEASE);
+
+	return ret;
+}
+
+static int open_event(int cpu, bool dedup, __u64 sample_type)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_SOFTWARE;
+	attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+	attr.sample_period = 1;
+	attr.sample_type = sample_type;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.exclude_callchain_kernel = 1;
+	attr.callchain_dedup = dedup;
+
+	return syscall(__NR_perf_event_open, &attr, 0, cpu, -1,
+		       PERF_FLAG_FD_CLOEXEC);
+}
+
+/* Take page faults, all from the same callchain. */
+static void __attribute__((noinline)) fault_pages(long page_size)
+{
+	volatile char *mem;
+	int i;
+
+	mem = mmap(NULL, NR_FAULTS * page_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return;
+	for (i = 0; i < NR_FAULTS; i++)
+		mem[i * page_size] = 1;
+	munmap((void *)mem, NR_FAULTS * page_size);
+}
+
+FIXTURE(callchain_dedup)
+{
+	long page_size;
+	int cpu;
+	int fd;
+	struct perf_event_mmap_page *p;
+};
+
+FIXTURE_SETUP(callchain_dedup)
+{
+	cpu_set_t set;
+
+	self->page_size = sysconf(_SC_PAGE_SIZE);
+	self->p = MAP_FAILED;
+
+	/* Stay on the cpu of the event. */
+	self->cpu = sched_getcpu();
+	ASSERT_GE(self->cpu, 0);
+	CPU_ZERO(&set);
+	CPU_SET(self->cpu, &set);
+	ASSERT_EQ(sched_setaffinity(0, sizeof(set), &set), 0);
+
+	self->fd = open_event(self->cpu, true, PERF_SAMPLE_CALLCHAIN);
+	if (self->fd < 0 && errno == EINVAL)
+		SKIP(return, "attr::callchain_dedup not supported");
+	if (self->fd < 0 && (errno == EACCES || errno == EPERM))
+		SKIP(return, "no permission to open the event");
+	ASSERT_GE(self->fd, 0);
+
+	self->p = mmap(NULL, (DATA_PAGES + 1) * self->page_size,
+		       PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+	ASSERT_NE(self->p, MAP_FAILED);
+}
+
+FIXTURE_TEARDOWN(callchain_dedup)
+{
+	if (self->p != MAP_FAILED)
+		munmap(self->p, (DATA_PAGES + 1) * self->page_size);
+	if (self->fd >= 0)
+		close(self->fd);
+}
+
+TEST_F(callchain_dedup, references_are_defined)
+{
+	struct stack_ids s = {};
+
+	ASSERT_EQ(ioctl(self->fd, PERF_EVENT_IOC_ENABLE, 0), 0);
+	fault_pages(self->page_size);
+	ASSERT_EQ(ioctl(self->fd, PERF_EVENT_IOC_DISABLE, 0), 0);
+
+	ASSERT_EQ(decode_buffer(self->p, self->page_size, &s), 0);
+	EXPECT_GE(s.defs + s.full, 1);
+	/* The same callchain repeats, so most samples must be references. */
+	EXPECT_GT(s.refs, s.defs);
+}
+
+TEST_F(callchain_dedup, set_output)
+{
+	struct stack_ids s = {};
+	int fd2;
+
+	/* A second event on the same cpu shares the buffer and its ids. */
+	fd2 = open_event(self->cpu, true, PERF_SAMPLE_CALLCHAIN);
+	ASSERT_GE(fd2, 0);
+	ASSERT_EQ(ioctl(fd2, PERF_EVENT_IOC_SET_OUTPUT, self->fd), 0);
+
+	ASSERT_EQ(ioctl(self->fd, PERF_EVENT_IOC_ENABLE, 0), 0);
+	ASSERT_EQ(ioctl(fd2, PERF_EVENT_IOC_ENABLE, 0), 0);
+	fault_pages(self->page_size);
+	ASSERT_EQ(ioctl(fd2, PERF_EVENT_IOC_DISABLE, 0), 0);
+	ASSERT_EQ(ioctl(self->fd, PERF_EVENT_IOC_DISABLE, 0), 0);
+
+	ASSERT_EQ(decode_buffer(self->p, self->page_size, &s), 0);
+	EXPECT_GT(s.refs, s.defs);
+	close(fd2);
+}
+
+TEST_F(callchain_dedup, invalid_attr)
+{
+	int fd;
+
+	/* Only per-cpu events may deduplicate. */
+	fd = open_event(-1, true, PERF_SAMPLE_CALLCHAIN);
+	EXPECT_EQ(fd, -1);
+	EXPECT_EQ(errno, EINVAL);
+
+	/* Deduplication needs callchains. */
+	fd = open_event(self->cpu, true, PERF_SAMPLE_IP);
+	EXPECT_EQ(fd, -1);
+	EXPECT_EQ(errno, EINVAL);
+}
+
+TEST_HARNESS_MAIN
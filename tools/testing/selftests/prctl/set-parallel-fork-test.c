@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * This test covers the PR_SET_PARALLEL_FORK functionality of prctl calls,
+ * and that fork() still copies large anonymous mappings correctly with it.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../kselftest_harness.h"
+
+#ifndef PR_SET_PARALLEL_FORK
+#define PR_SET_PARALLEL_FORK 75
+#define PR_GET_PARALLEL_FORK 76
+#endif
+
+/* Large enough for the page tables to be copied in parallel */
+#define PUD_SIZE (1UL << 30)
+#define MAP_SIZE (5 * PUD_SIZE)
+/* Touch one page per PMD, to have page tables all over the mapping */
+#define STRIDE (2UL << 20)
+
+static int get_parallel_fork(void)
+{
+	return prctl(PR_GET_PARALLEL_FORK, 0, 0, 0, 0);
+}
+
+static int set_parallel_fork(unsigned long on)
+{
+	return prctl(PR_SET_PARALLEL_FORK, on, 0, 0, 0);
+}
+
+FIXTURE(parallel_fork) {
+	char *map;
+};
+
+FIXTURE_SETUP(parallel_fork)
+{
+	if (get_parallel_fork() < 0 && errno == EINVAL)
+		SKIP(return, "PR_SET_PARALLEL_FORK not supported");
+	ASSERT_EQ(set_parallel_fork(0), 0);
+
+	self->map = mmap(NULL, MAP_SIZE, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	ASSERT_NE(self->map, MAP_FAILED);
+}
+
+FIXTURE_TEARDOWN(parallel_fork)
+{
+	if (self->map && self->map != MAP_FAILED)
+		munmap(self->map, MAP_SIZE);
+}
+
+TEST_F(parallel_fork, set_and_get)
+{
+	EXPECT_EQ(get_parallel_fork(), 0);
+	EXPECT_EQ(set_parallel_fork(1), 0);
+	EXPECT_EQ(get_parallel_fork(), 1);
+	EXPECT_EQ(set_parallel_fork(0), 0);
+	EXPECT_EQ(get_parallel_fork(), 0);
+}
+
+TEST_F(parallel_fork, invalid_args)
+{
+	EXPECT_EQ(prctl(PR_GET_PARALLEL_FORK, 1, 0, 0, 0), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(prctl(PR_SET_PARALLEL_FORK, 1, 1, 0, 0), -1);
+	EXPECT_EQ(errno, EINVAL);
+	EXPECT_EQ(get_parallel_fork(), 0);
+}
+
+TEST_F(parallel_fork, not_inherited)
+{
+	int status;
+	pid_t pid;
+
+	ASSERT_EQ(set_parallel_fork(1), 0);
+
+	pid = fork();
+	ASSERT_GE(pid, 0);
+	if (pid == 0)
+		_exit(get_parallel_fork() == 0 ? 0 : 1);
+
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+	EXPECT_EQ(get_parallel_fork(), 1);
+}
+
+TEST_F(parallel_fork, copy)
+{
+	unsigned long off;
+	int status;
+	pid_t pid;
+
+	for (off = 0; off < MAP_SIZE; off += STRIDE)
+		*(unsigned long *)(self->map + off) = off ^ 0x5a5a5a5a;
+
+	ASSERT_EQ(set_parallel_fork(1), 0);
+
+	pid = fork();
+	ASSERT_GE(pid, 0);
+	if (pid == 0) {
+		/* The child sees the parent's data, and writes break COW */
+		for (off = 0; off < MAP_SIZE; off += STRIDE) {
+			unsigned long *p = (unsigned long *)(self->map + off);
+
+			if (*p != (off ^ 0x5a5a5a5a))
+				_exit(1);
+			*p = ~off;
+		}
+		if (*(unsigned long *)(self->map + STRIDE / 2))
+			_exit(2);
+		_exit(0);
+	}
+
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+
+	/* The child's writes didn't reach the parent */
+	for (off = 0; off < MAP_SIZE; off += STRIDE)
+		ASSERT_EQ(*(unsigned long *)(self->map + off),
+			  off ^ 0x5a5a5a5a);
+}
+
+TEST_HARNESS_MAIN
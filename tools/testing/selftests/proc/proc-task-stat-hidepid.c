@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Test that /proc/task_stat follows the hidepid= mount option: it must only
+ * have records of the tasks whose /proc/<pid>/stat the reader may open.
+ */
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mount.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <linux/proc_task_stat.h>
+
+static void mount_private_proc(const char *options)
+{
+	if (mount(NULL, "/proc", "proc", 0, options) == -1)
+		exit(1);
+}
+
+static bool task_stat_has(pid_t pid)
+{
+	static char buf[64 * sizeof(struct proc_task_stat)];
+	bool found = false;
+	ssize_t rv, off;
+	int fd;
+
+	fd = open("/proc/task_stat", O_RDONLY);
+	assert(fd >= 0);
+
+	while ((rv = read(fd, buf, sizeof(buf))) > 0) {
+		for (off = 0; off < rv;) {
+			struct proc_task_stat *st = (void *)(buf + off);
+
+			assert(st->size >= sizeof(*st));
+			if (st->pid == pid)
+				found = true;
+			off += st->size;
+		}
+	}
+	assert(rv == 0);
+	assert(!close(fd));
+
+	return found;
+}
+
+static bool stat_readable(pid_t pid)
+{
+	char path[64];
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	fd = open(path, O_RDONLY);
+	if (fd >= 0)
+		assert(!close(fd));
+	return fd >= 0;
+}
+
+/* As an unprivileged user, look for the tasks of root and for itself. */
+static void check(const char *options, pid_t root_pid, bool root_visible)
+{
+	pid_t pid;
+	int status;
+
+	mount_private_proc(options);
+
+	pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		assert(!setgroups(0, NULL));
+		assert(!setgid(65534));
+		assert(!setuid(65534));
+
+		assert(task_stat_has(getpid()));
+		assert(task_stat_has(root_pid) == root_visible);
+		assert(stat_readable(root_pid) == root_visible);
+		exit(0);
+	}
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(void)
+{
+	pid_t root_pid;
+
+	if (unshare(CLONE_NEWNS) == -1) {
+		if (errno == ENOSYS || errno == EPERM)
+			return 4;
+		return 1;
+	}
+	if (mount(NULL, "/", NULL, MS_PRIVATE | MS_REC, NULL) == -1)
+		return 1;
+	mount_private_proc("hidepid=0");
+	if (access("/proc/task_stat", R_OK) == -1)
+		return 4;
+
+	root_pid = fork();
+	assert(root_pid >= 0);
+	if (root_pid == 0) {
+		pause();
+		exit(0);
+	}
+
+	check("hidepid=0", root_pid, true);
+	check("hidepid=1", root_pid, false);
+	check("hidepid=2", root_pid, false);
+
+	kill(root_pid, SIGKILL);
+	waitpid(root_pid, NULL, 0);
+	return 0;
+}
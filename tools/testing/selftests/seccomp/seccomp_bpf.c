@@ -21,6 +21,7 @@
 #endif
 
 #include <errno.h>
+#include <linux/audit.h>
 #include <linux/filter.h>
 #include <sys/prctl.h>
 #include <sys/ptrace.h>
@@ -4888,6 +4889,183 @@ TEST(tsync_vs_dead_thread_leader)
 	EXPECT_EQ(0, status);
 }
 
+/*
+ * Allow getpgid() only for pid @allowed, making getpgid() a syscall that the
+ * action cache handles by argument value.
+ */
+#define GETPGID_FILTER(name, allowed, action)				\
+	struct sock_filter _getpgid_filter_##name[] = {			\
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,				\
+			offsetof(struct seccomp_data, nr)),		\
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, __NR_getpgid, 1, 0),	\
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),		\
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, syscall_arg(0)),		\
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, allowed, 0, 1),		\
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),		\
+		BPF_STMT(BPF_RET|BPF_K, action),			\
+	};								\
+	struct sock_fprog prog_##name = {				\
+		.len = (unsigned short)ARRAY_SIZE(_getpgid_filter_##name), \
+		.filter = _getpgid_filter_##name,			\
+	}
+
+/* An argument value the filter allows runs, any other value doesn't. */
+TEST(cache_arg_value)
+{
+	GETPGID_FILTER(zero, 0, SECCOMP_RET_ERRNO | EPERM);
+	long ret;
+
+	ret = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+	ASSERT_EQ(0, ret);
+
+	ret = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog_zero);
+	ASSERT_EQ(0, ret);
+
+	EXPECT_EQ(getpgid(0), syscall(__NR_getpgid, 0));
+	EXPECT_LE(0, syscall(__NR_getpgid, 0));
+	EXPECT_EQ(-1, syscall(__NR_getpgid, 1));
+	EXPECT_EQ(EPERM, errno);
+	EXPECT_EQ(-1, syscall(__NR_getpgid, getpid()));
+	EXPECT_EQ(EPERM, errno);
+	/* Only the low half is tested, so the high half may be anything. */
+	if (sizeof(long) == 8)
+		EXPECT_LE(0, syscall(__NR_getpgid, 1L << 36));
+}
+
+/* A later filter rejecting a value that an earlier one allows wins. */
+TEST(cache_arg_value_stacked)
+{
+	GETPGID_FILTER(zero, 0, SECCOMP_RET_ERRNO | EPERM);
+	GETPGID_FILTER(none, 0x7fffffff, SECCOMP_RET_ERRNO | EACCES);
+	long ret;
+
+	ret = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+	ASSERT_EQ(0, ret);
+
+	ret = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog_zero);
+	ASSERT_EQ(0, ret);
+	EXPECT_LE(0, syscall(__NR_getpgid, 0));
+
+	ret = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog_none);
+	ASSERT_EQ(0, ret);
+	EXPECT_EQ(-1, syscall(__NR_getpgid, 0));
+	EXPECT_EQ(EACCES, errno);
+	EXPECT_EQ(-1, syscall(__NR_getpgid, 1));
+	EXPECT_EQ(EACCES, errno);
+}
+
+/*
+ * A filter comparing both halves of an argument against -1 allows -1, but
+ * not 0xffffffff, which has the same low half.
+ */
+TEST(cache_arg_value_sign_extended)
+{
+	struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, __NR_personality, 1, 0),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, args[0])),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0xffffffff, 0, 3),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, args[0]) + sizeof(__u32)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0xffffffff, 0, 1),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ERRNO | EPERM),
+	};
+	struct sock_fprog prog = {
+		.len = (unsigned short)ARRAY_SIZE(filter),
+		.filter = filter,
+	};
+	long ret;
+
+	if (sizeof(long) != 8)
+		SKIP(return, "arguments are not sign extended on 32-bit");
+
+	ret = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+	ASSERT_EQ(0, ret);
+
+	ret = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog);
+	ASSERT_EQ(0, ret);
+
+	/* personality(0xffffffff) only queries the personality. */
+	EXPECT_LE(0, syscall(__NR_personality, -1L));
+	EXPECT_EQ(-1, syscall(__NR_personality, 0xffffffffUL));
+	EXPECT_EQ(EPERM, errno);
+}
+
+#if defined(__x86_64__)
+static long int80_syscall(long nr, long arg0)
+{
+	long ret;
+
+	asm volatile ("int $0x80"
+		      : "=a" (ret)
+		      : "a" (nr), "b" (arg0)
+		      : "memory", "r8", "r9", "r10", "r11");
+	return ret;
+}
+
+/*
+ * A value cached for a native syscall must not allow the compat syscall
+ * with the same number: native getpid is i386 mkdir.
+ */
+TEST(cache_arg_value_compat)
+{
+	struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, arch)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, AUDIT_ARCH_X86_64, 1, 0),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ERRNO | EACCES),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS,
+			offsetof(struct seccomp_data, nr)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, __NR_getpid, 1, 0),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),
+		BPF_STMT(BPF_LD|BPF_W|BPF_ABS, syscall_arg(0)),
+		BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 0, 0, 1),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ALLOW),
+		BPF_STMT(BPF_RET|BPF_K, SECCOMP_RET_ERRNO | EPERM),
+	};
+	struct sock_fprog prog = {
+		.len = (unsigned short)ARRAY_SIZE(filter),
+		.filter = filter,
+	};
+	int status;
+	pid_t pid;
+	long ret;
+
+	pid = fork();
+	ASSERT_LE(0, pid);
+	if (pid == 0) {
+		pid_t self = getpid();
+
+		/* Without ia32 emulation, int $0x80 raises SIGSEGV. */
+		if (int80_syscall(20 /* i386 getpid */, 0) <= 0)
+			_exit(2);
+
+		ret = prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+		if (ret)
+			_exit(3);
+		ret = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog);
+		if (ret)
+			_exit(4);
+
+		if (syscall(__NR_getpid, 0) != self)
+			_exit(5);
+		if (int80_syscall(__NR_getpid, 0) != -EACCES)
+			_exit(6);
+		_exit(0);
+	}
+
+	ASSERT_EQ(pid, waitpid(pid, &status, 0));
+	if (WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV)
+		SKIP(return, "no ia32 emulation");
+	ASSERT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(0, WEXITSTATUS(status));
+}
+#endif
+
 /*
  * TODO:
  * - expand NNP testing
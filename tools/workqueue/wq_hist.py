@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0
+
+desc = """
+Live view of workqueue latency and execution time histograms
+
+Reads /sys/kernel/debug/workqueue/hist (CONFIG_WQ_LATENCY_HIST) and shows,
+per workqueue and interval, how many work items started and the 50th, 99th
+percentile and maximum of their queueing latency and execution time.
+
+Bucket 0 of a histogram counts durations under 1us and bucket i those in
+[2^(i-1), 2^i) us.  Percentiles are reported as the upper bound of the bucket
+they fall into, so they are accurate to a factor of two.
+
+  name      Workqueue name
+  started   Number of work items which started executing in the interval
+  lat50/99  Queueing latency percentiles
+  lat-max   Largest queueing latency bucket with samples
+  exec50/99 Execution time percentiles
+  exec-max  Largest execution time bucket with samples
+
+Collection has to be switched on with
+
+  echo 1 > /sys/kernel/debug/workqueue/hist_enable
+"""
+
+import argparse
+import re
+import signal
+import sys
+import time
+
+HIST_PATH = '/sys/kernel/debug/workqueue/hist'
+ENABLE_PATH = '/sys/kernel/debug/workqueue/hist_enable'
+HISTS = ('latency', 'exec')
+
+parser = argparse.ArgumentParser(description=desc,
+                                 formatter_class=argparse.RawTextHelpFormatter)
+parser.add_argument('workqueue', metavar='REGEX', nargs='*',
+                    help='Target workqueue name patterns (all if empty)')
+parser.add_argument('-i', '--interval', metavar='SECS', type=float, default=1,
+                    help='Monitoring interval (0 to print once and exit)')
+parser.add_argument('-e', '--enable', action='store_true',
+                    help='Switch collection on before and off after monitoring')
+parser.add_argument('-a', '--all', action='store_true',
+                    help='Also show workqueues without new samples')
+args = parser.parse_args()
+
+def read_hists():
+    hists = {}
+    with open(HIST_PATH) as f:
+        for line in f:
+            parts = line.split()
+            # The name is everything before the histogram name and counts.
+            for i in range(len(parts) - 1, 0, -1):
+                if parts[i] in HISTS:
+                    break
+            else:
+                continue
+            name = ' '.join(parts[:i])
+            hists.setdefault(name, {})[parts[i]] = \
+                [int(c) for c in parts[i + 1:]]
+    return hists
+
+def bucket_str(b):
+    if b == 0:
+        return '<1us'
+    us = 1 << b
+    if us >= 1000000:
+        return f'{us // 1000000}s'
+    if us >= 1000:
+        return f'{us // 1000}ms'
+    return f'{us}us'
+
+def percentile(counts, pct):
+    total = sum(counts)
+    if not total:
+        return '-'
+    acc = 0
+    for b, c in enumerate(counts):
+        acc += c
+        if acc * 100 >= total * pct:
+            return bucket_str(b)
+    return bucket_str(len(counts) - 1)
+
+def max_bucket(counts):
+    for b in range(len(counts) - 1, -1, -1):
+        if counts[b]:
+            return bucket_str(b)
+    return '-'
+
+def delta(cur, prev):
+    if prev is None:
+        return cur
+    return [c - p for c, p in zip(cur, prev)]
+
+def set_enable(val):
+    with open(ENABLE_PATH, 'w') as f:
+        f.write(f'{val}\n')
+
+def main():
+    filter_re = None
+    if args.workqueue:
+        filter_re = re.compile('|'.join(f'(?:{p})' for p in args.workqueue))
+
+    if args.enable:
+        set_enable(1)
+        signal.signal(signal.SIGINT, lambda *a: (set_enable(0), sys.exit(0)))
+
+    prev = {}
+    if args.interval:
+        prev = read_hists()
+        time.sleep(args.interval)
+
+    while True:
+        cur = read_hists()
+
+        print(f'{"":>24} {"started":>10} {"lat50":>7} {"lat99":>7} '
+              f'{"lat-max":>7} {"exec50":>7} {"exec99":>7} {"exec-max":>8}')
+        for name in sorted(cur):
+            if filter_re and not filter_re.search(name):
+                continue
+
+            h = {}
+            for hist in HISTS:
+                h[hist] = delta(cur[name].get(hist, [0]),
+                                prev.get(name, {}).get(hist))
+            started = sum(h['latency'])
+            if not started and not args.all:
+                continue
+
+            print(f'{name[-24:]:>24} {started:>10} '
+                  f'{percentile(h["latency"], 50):>7} '
+                  f'{percentile(h["latency"], 99):>7} '
+                  f'{max_bucket(h["latency"]):>7} '
+                  f'{percentile(h["exec"], 50):>7} '
+                  f'{percentile(h["exec"], 99):>7} '
+                  f'{max_bucket(h["exec"]):>8}')
+
+        if not args.interval:
+            break
+        print()
+        prev = cur
+        time.sleep(args.interval)
+
+if __name__ == '__main__':
+    main()
@@ -69,6 +69,21 @@ static void kvm_reset_dirty_gfn(struct kvm *kvm, u32 slot, u64 offset, u64 mask)
 	if (!memslot || (offset + __fls(mask)) >= memslot->npages)
 		return;
 
+	/*
+	 * Allow the GFNs to be pushed again before write protecting them,
+	 * so that the write fault that follows is not coalesced away.
+	 */
+	if (memslot->dirty_ring_bitmap) {
+		u64 bits = mask;
+
+		while (bits) {
+			clear_bit_le(offset + __ffs64(bits),
+				     memslot->dirty_ring_bitmap);
+			bits &= bits - 1;
+		}
+		smp_mb__after_atomic();
+	}
+
 	KVM_MMU_LOCK(kvm);
 	kvm_arch_mmu_enable_log_dirty_pt_masked(kvm, memslot, offset, mask);
 	KVM_MMU_UNLOCK(kvm);
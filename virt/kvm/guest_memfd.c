@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include <linux/backing-dev.h>
 #include <linux/falloc.h>
+#include <linux/huge_mm.h>
 #include <linux/kvm_host.h>
 #include <linux/pagemap.h>
 #include <linux/anon_inodes.h>
@@ -65,17 +66,10 @@ static int kvm_gmem_prepare_folio(struct kvm *kvm, struct kvm_memory_slot *slot,
 		clear_highpage(folio_page(folio, i));
 
 	/*
-	 * Preparing huge folios should always be safe, since it should
-	 * be possible to split them later if needed.
-	 *
-	 * Right now the folio order is always going to be zero, but the
-	 * code is ready for huge folios.  The only assumption is that
-	 * the base pgoff of memslots is naturally aligned with the
-	 * requested page order, ensuring that huge folios can also use
-	 * huge page table entries for GPA->HPA mapping.
-	 *
-	 * The order will be passed when creating the guest_memfd, and
-	 * checked when creating memslots.
+	 * Huge folios are only prepared while they fit the memslot as a
+	 * whole, see kvm_gmem_huge_folio_fits(), so the base pgoff of the
+	 * memslot is naturally aligned with the folio order and the folio
+	 * can also use huge page table entries for GPA->HPA mapping.
 	 */
 	WARN_ON(!IS_ALIGNED(slot->gmem.pgoff, 1 << folio_order(folio)));
 	index = gfn - slot->base_gfn + slot->gmem.pgoff;
@@ -87,6 +81,76 @@ static int kvm_gmem_prepare_folio(struct kvm *kvm, struct kvm_memory_slot *slot,
 	return r;
 }
 
+/*
+ * A folio of @nr pages containing @index can be used as a whole by @slot if
+ * it is entirely bound to @slot and the GFNs and file offsets of @slot are
+ * aligned alike, so that it can be prepared at once and mapped with a huge
+ * page table entry.
+ */
+static bool kvm_gmem_huge_folio_fits(struct kvm_memory_slot *slot,
+				     pgoff_t index, unsigned long nr)
+{
+	pgoff_t start = ALIGN_DOWN(index, nr);
+
+	return IS_ALIGNED(slot->gmem.pgoff, nr) &&
+	       IS_ALIGNED(slot->base_gfn, nr) &&
+	       start >= slot->gmem.pgoff &&
+	       start + nr <= slot->gmem.pgoff + slot->npages;
+}
+
+static struct kvm_memory_slot *kvm_gmem_get_binding(struct inode *inode,
+						    pgoff_t index)
+{
+	struct list_head *gmem_list = &inode->i_mapping->i_private_list;
+	struct kvm_memory_slot *slot;
+	struct kvm_gmem *gmem;
+
+	list_for_each_entry(gmem, gmem_list, entry) {
+		slot = xa_load(&gmem->bindings, index);
+		if (slot)
+			return slot;
+	}
+
+	return NULL;
+}
+
+static struct folio *kvm_gmem_get_huge_folio(struct inode *inode,
+					     pgoff_t index,
+					     struct kvm_memory_slot *slot)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	unsigned long flags = (unsigned long)inode->i_private;
+	pgoff_t huge_index = round_down(index, HPAGE_PMD_NR);
+	struct address_space *mapping = inode->i_mapping;
+	gfp_t gfp = mapping_gfp_mask(mapping);
+	struct folio *folio;
+
+	if (!(flags & KVM_GUEST_MEMFD_ALLOW_HUGEPAGE))
+		return NULL;
+
+	if (!slot || !kvm_gmem_huge_folio_fits(slot, index, HPAGE_PMD_NR))
+		return NULL;
+
+	if (filemap_range_has_page(mapping, (loff_t)huge_index << PAGE_SHIFT,
+				   ((loff_t)(huge_index + HPAGE_PMD_NR) << PAGE_SHIFT) - 1))
+		return NULL;
+
+	folio = filemap_alloc_folio(gfp | __GFP_NORETRY | __GFP_NOWARN,
+				    HPAGE_PMD_ORDER);
+	if (!folio)
+		return NULL;
+
+	if (filemap_add_folio(mapping, folio, huge_index, gfp)) {
+		folio_put(folio);
+		return NULL;
+	}
+
+	return folio;
+#else
+	return NULL;
+#endif
+}
+
 /*
  * Returns a locked folio on success.  The caller is responsible for
  * setting the up-to-date flag before the memory is mapped into the guest.
@@ -95,13 +159,38 @@ static int kvm_gmem_prepare_folio(struct kvm *kvm, struct kvm_memory_slot *slot,
  *
  * Ignore accessed, referenced, and dirty flags.  The memory is
  * unevictable and there is no storage to write back to.
+ *
+ * If the guest_memfd allows huge pages and @slot can map a whole PMD sized
+ * folio at @index, try that first.  Huge folios are split later only when
+ * a range of them is punched out, e.g. after a conversion to shared, or
+ * when they must be prepared in smaller pieces.
  */
-static struct folio *kvm_gmem_get_folio(struct inode *inode, pgoff_t index)
+static struct folio *kvm_gmem_get_folio(struct inode *inode, pgoff_t index,
+					struct kvm_memory_slot *slot)
 {
-	/* TODO: Support huge pages. */
+	struct folio *folio;
+
+	folio = kvm_gmem_get_huge_folio(inode, index, slot);
+	if (folio)
+		return folio;
+
 	return filemap_grab_folio(inode->i_mapping, index);
 }
 
+/*
+ * Split a locked huge folio that has not been prepared yet and drop the
+ * caller's reference to it.  Fails if someone else holds a reference.
+ */
+static int kvm_gmem_split_folio(struct folio *folio)
+{
+	int r = split_folio(folio);
+
+	folio_unlock(folio);
+	folio_put(folio);
+
+	return r ? -EAGAIN : 0;
+}
+
 static void kvm_gmem_invalidate_begin(struct kvm_gmem *gmem, pgoff_t start,
 				      pgoff_t end)
 {
@@ -149,12 +238,38 @@ static void kvm_gmem_invalidate_end(struct kvm_gmem *gmem, pgoff_t start,
 	}
 }
 
+/*
+ * Split the huge folio that straddles @index, if any, so that truncation
+ * can free the pages on one side of it.  The partial truncate path would
+ * only zero them if the split fails, leaving the hole allocated.
+ */
+static int kvm_gmem_split_at(struct inode *inode, pgoff_t index)
+{
+	struct folio *folio;
+	int r = 0;
+
+	folio = filemap_lock_folio(inode->i_mapping, index);
+	if (IS_ERR(folio))
+		return 0;
+
+	if (folio_test_large(folio) && folio->index != index) {
+		r = split_folio(folio);
+		if (r && r != -ENOMEM)
+			r = -EAGAIN;
+	}
+
+	folio_unlock(folio);
+	folio_put(folio);
+	return r;
+}
+
 static long kvm_gmem_punch_hole(struct inode *inode, loff_t offset, loff_t len)
 {
 	struct list_head *gmem_list = &inode->i_mapping->i_private_list;
 	pgoff_t start = offset >> PAGE_SHIFT;
 	pgoff_t end = (offset + len) >> PAGE_SHIFT;
 	struct kvm_gmem *gmem;
+	int r;
 
 	/*
 	 * Bindings must be stable across invalidation to ensure the start+end
@@ -165,14 +280,19 @@ static long kvm_gmem_punch_hole(struct inode *inode, loff_t offset, loff_t len)
 	list_for_each_entry(gmem, gmem_list, entry)
 		kvm_gmem_invalidate_begin(gmem, start, end);
 
-	truncate_inode_pages_range(inode->i_mapping, offset, offset + len - 1);
+	r = kvm_gmem_split_at(inode, start);
+	if (!r)
+		r = kvm_gmem_split_at(inode, end);
+	if (!r)
+		truncate_inode_pages_range(inode->i_mapping, offset,
+					   offset + len - 1);
 
 	list_for_each_entry(gmem, gmem_list, entry)
 		kvm_gmem_invalidate_end(gmem, start, end);
 
 	filemap_invalidate_unlock(inode->i_mapping);
 
-	return 0;
+	return r;
 }
 
 static long kvm_gmem_allocate(struct inode *inode, loff_t offset, loff_t len)
@@ -199,7 +319,8 @@ static long kvm_gmem_allocate(struct inode *inode, loff_t offset, loff_t len)
 			break;
 		}
 
-		folio = kvm_gmem_get_folio(inode, index);
+		folio = kvm_gmem_get_folio(inode, index,
+					   kvm_gmem_get_binding(inode, index));
 		if (IS_ERR(folio)) {
 			r = PTR_ERR(folio);
 			break;
@@ -428,6 +549,8 @@ static int __kvm_gmem_create(struct kvm *kvm, loff_t size, u64 flags)
 	inode->i_mode |= S_IFREG;
 	inode->i_size = size;
 	mapping_set_gfp_mask(inode->i_mapping, GFP_HIGHUSER);
+	if (flags & KVM_GUEST_MEMFD_ALLOW_HUGEPAGE)
+		mapping_set_large_folios(inode->i_mapping);
 	mapping_set_inaccessible(inode->i_mapping);
 	/* Unmovable mappings are supposed to be marked unevictable as well. */
 	WARN_ON_ONCE(!mapping_unevictable(inode->i_mapping));
@@ -453,12 +576,21 @@ int kvm_gmem_create(struct kvm *kvm, struct kvm_create_guest_memfd *args)
 	u64 flags = args->flags;
 	u64 valid_flags = 0;
 
+	if (IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE))
+		valid_flags |= KVM_GUEST_MEMFD_ALLOW_HUGEPAGE;
+
 	if (flags & ~valid_flags)
 		return -EINVAL;
 
 	if (size <= 0 || !PAGE_ALIGNED(size))
 		return -EINVAL;
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if ((flags & KVM_GUEST_MEMFD_ALLOW_HUGEPAGE) &&
+	    !IS_ALIGNED(size, HPAGE_PMD_SIZE))
+		return -EINVAL;
+#endif
+
 	return __kvm_gmem_create(kvm, size, flags);
 }
 
@@ -571,7 +703,8 @@ __kvm_gmem_get_pfn(struct file *file, struct kvm_memory_slot *slot,
 		return ERR_PTR(-EIO);
 	}
 
-	folio = kvm_gmem_get_folio(file_inode(file), index);
+retry:
+	folio = kvm_gmem_get_folio(file_inode(file), index, slot);
 	if (IS_ERR(folio))
 		return folio;
 
@@ -581,9 +714,27 @@ __kvm_gmem_get_pfn(struct file *file, struct kvm_memory_slot *slot,
 		return ERR_PTR(-EHWPOISON);
 	}
 
+	/*
+	 * The memslot that the huge folio was allocated for may be gone, if
+	 * so split it before it is prepared for the current one.
+	 */
+	if (folio_test_large(folio) && !folio_test_uptodate(folio) &&
+	    !kvm_gmem_huge_folio_fits(slot, index, folio_nr_pages(folio))) {
+		int r = kvm_gmem_split_folio(folio);
+
+		if (r)
+			return ERR_PTR(r);
+		goto retry;
+	}
+
 	*pfn = folio_file_pfn(folio, index);
-	if (max_order)
-		*max_order = 0;
+	if (max_order) {
+		if (folio_test_large(folio) &&
+		    kvm_gmem_huge_folio_fits(slot, index, folio_nr_pages(folio)))
+			*max_order = folio_order(folio);
+		else
+			*max_order = 0;
+	}
 
 	*is_prepared = folio_test_uptodate(folio);
 	return folio;
@@ -656,6 +807,7 @@ long kvm_gmem_populate(struct kvm *kvm, gfn_t start_gfn, void __user *src, long
 			break;
 		}
 
+retry:
 		folio = __kvm_gmem_get_pfn(file, slot, gfn, &pfn, &is_prepared, &max_order);
 		if (IS_ERR(folio)) {
 			ret = PTR_ERR(folio);
@@ -669,6 +821,22 @@ long kvm_gmem_populate(struct kvm *kvm, gfn_t start_gfn, void __user *src, long
 			break;
 		}
 
+		/*
+		 * Huge folios are populated as a whole, or split first so that
+		 * only the pages in the range are prepared.
+		 */
+		if (max_order &&
+		    (!IS_ALIGNED(gfn, 1 << max_order) ||
+		     (npages - i) < (1 << max_order) ||
+		     !kvm_range_has_memory_attributes(kvm, gfn, gfn + (1 << max_order),
+						      KVM_MEMORY_ATTRIBUTE_PRIVATE,
+						      KVM_MEMORY_ATTRIBUTE_PRIVATE))) {
+			ret = kvm_gmem_split_folio(folio);
+			if (ret)
+				break;
+			goto retry;
+		}
+
 		folio_unlock(folio);
 		WARN_ON(!IS_ALIGNED(gfn, 1 << max_order) ||
 			(npages - i) < (1 << max_order));
@@ -976,6 +976,15 @@ static void kvm_destroy_dirty_bitmap(struct kvm_memory_slot *memslot)
 	memslot->dirty_bitmap = NULL;
 }
 
+static void kvm_destroy_dirty_ring_bitmap(struct kvm_memory_slot *memslot)
+{
+	if (!memslot->dirty_ring_bitmap)
+		return;
+
+	vfree(memslot->dirty_ring_bitmap);
+	memslot->dirty_ring_bitmap = NULL;
+}
+
 /* This does not remove the slot from struct kvm_memslots data structures */
 static void kvm_free_memslot(struct kvm *kvm, struct kvm_memory_slot *slot)
 {
@@ -983,6 +992,7 @@ static void kvm_free_memslot(struct kvm *kvm, struct kvm_memory_slot *slot)
 		kvm_gmem_unbind(slot);
 
 	kvm_destroy_dirty_bitmap(slot);
+	kvm_destroy_dirty_ring_bitmap(slot);
 
 	kvm_arch_free_memslot(kvm, slot);
 
@@ -1425,6 +1435,18 @@ static int kvm_alloc_dirty_bitmap(struct kvm_memory_slot *memslot)
 	return 0;
 }
 
+static int kvm_alloc_dirty_ring_bitmap(struct kvm_memory_slot *memslot)
+{
+	unsigned long dirty_bytes = kvm_dirty_bitmap_bytes(memslot);
+
+	memslot->dirty_ring_bitmap = __vcalloc(1, dirty_bytes,
+					       GFP_KERNEL_ACCOUNT);
+	if (!memslot->dirty_ring_bitmap)
+		return -ENOMEM;
+
+	return 0;
+}
+
 static struct kvm_memslots *kvm_get_inactive_memslots(struct kvm *kvm, int as_id)
 {
 	struct kvm_memslots *active = __kvm_memslots(kvm, as_id);
@@ -1678,13 +1700,28 @@ static int kvm_prepare_memory_region(struct kvm *kvm,
 			if (kvm_dirty_log_manual_protect_and_init_set(kvm))
 				bitmap_set(new->dirty_bitmap, 0, new->npages);
 		}
+
+		/* Same for the bitmap of GFNs waiting in the dirty rings. */
+		if (!(new->flags & KVM_MEM_LOG_DIRTY_PAGES))
+			new->dirty_ring_bitmap = NULL;
+		else if (old && old->dirty_ring_bitmap)
+			new->dirty_ring_bitmap = old->dirty_ring_bitmap;
+		else if (kvm->dirty_ring_coalesce) {
+			r = kvm_alloc_dirty_ring_bitmap(new);
+			if (r)
+				goto out;
+		}
 	}
 
 	r = kvm_arch_prepare_memory_region(kvm, old, new, change);
 
-	/* Free the bitmap on failure if it was allocated above. */
+out:
+	/* Free the bitmaps on failure if they were allocated above. */
 	if (r && new && new->dirty_bitmap && (!old || !old->dirty_bitmap))
 		kvm_destroy_dirty_bitmap(new);
+	if (r && new && new->dirty_ring_bitmap &&
+	    (!old || !old->dirty_ring_bitmap))
+		kvm_destroy_dirty_ring_bitmap(new);
 
 	return r;
 }
@@ -1729,6 +1766,8 @@ static void kvm_commit_memory_region(struct kvm *kvm,
 		 */
 		if (old->dirty_bitmap && !new->dirty_bitmap)
 			kvm_destroy_dirty_bitmap(old);
+		if (old->dirty_ring_bitmap && !new->dirty_ring_bitmap)
+			kvm_destroy_dirty_ring_bitmap(old);
 
 		/*
 		 * The final quirk.  Free the detached, old slot, but only its
@@ -3601,9 +3640,16 @@ void mark_page_dirty_in_slot(struct kvm *kvm,
 		unsigned long rel_gfn = gfn - memslot->base_gfn;
 		u32 slot = (memslot->as_id << 16) | memslot->id;
 
-		if (kvm->dirty_ring_size && vcpu)
-			kvm_dirty_ring_push(vcpu, slot, rel_gfn);
-		else if (memslot->dirty_bitmap)
+		if (kvm->dirty_ring_size && vcpu) {
+			/*
+			 * With KVM_CAP_DIRTY_LOG_RING_COALESCE, a GFN that is
+			 * already in a ring is not pushed again until that
+			 * entry is reset, e.g. for repeated writes by KVM.
+			 */
+			if (!memslot->dirty_ring_bitmap ||
+			    !test_and_set_bit_le(rel_gfn, memslot->dirty_ring_bitmap))
+				kvm_dirty_ring_push(vcpu, slot, rel_gfn);
+		} else if (memslot->dirty_bitmap)
 			set_bit_le(rel_gfn, memslot->dirty_bitmap);
 	}
 }
@@ -4915,6 +4961,9 @@ static int kvm_vm_ioctl_check_extension_generic(struct kvm *kvm, long arg)
 #endif
 #ifdef CONFIG_NEED_KVM_DIRTY_RING_WITH_BITMAP
 	case KVM_CAP_DIRTY_LOG_RING_WITH_BITMAP:
+#endif
+#ifdef CONFIG_HAVE_KVM_DIRTY_RING
+	case KVM_CAP_DIRTY_LOG_RING_COALESCE:
 #endif
 	case KVM_CAP_BINARY_STATS_FD:
 	case KVM_CAP_SYSTEM_EVENT_DATA:
@@ -5078,6 +5127,28 @@ static int kvm_vm_ioctl_enable_cap_generic(struct kvm *kvm,
 
 		return r;
 	}
+	case KVM_CAP_DIRTY_LOG_RING_COALESCE: {
+		int r = -EINVAL;
+
+		if (!IS_ENABLED(CONFIG_HAVE_KVM_DIRTY_RING) ||
+		    !kvm->dirty_ring_size || cap->flags)
+			return r;
+
+		mutex_lock(&kvm->slots_lock);
+
+		/*
+		 * As above, every memslot with dirty logging enabled must
+		 * track which of its GFNs are in a ring.
+		 */
+		if (kvm_are_all_memslots_empty(kvm)) {
+			kvm->dirty_ring_coalesce = true;
+			r = 0;
+		}
+
+		mutex_unlock(&kvm->slots_lock);
+
+		return r;
+	}
 	default:
 		return kvm_vm_ioctl_enable_cap(kvm, cap);
 	}